@@ -12,6 +12,95 @@ using namespace DirectX::SimpleMath;
 
 using Microsoft::WRL::ComPtr;
 
+namespace
+{
+    constexpr int c_tileSize = 16;
+    constexpr int c_tileCount = 4;
+
+    // The near layer scrolls with the camera, the far layer at half speed behind it.
+    constexpr int c_nearWidth = 1024;
+    constexpr int c_nearHeight = 16;
+    constexpr int c_farWidth = 640;
+    constexpr int c_farHeight = 20;
+
+    constexpr float c_cameraSpeed = 120.f;
+
+    // Small ships drifting over the whole level, kept in a SpriteGrid so only the ones in
+    // view are drawn.
+    constexpr int c_escortCount = 4000;
+    constexpr float c_escortScale = 0.25f;
+    constexpr float c_escortSize = 64.f * c_escortScale;
+    constexpr float c_worldWidth = float(c_nearWidth * c_tileSize);
+    constexpr float c_worldHeight = 1024.f;
+
+    // Tiles 1 and 2 are dirt and grass-topped dirt for the near layer, 3 and 4 are the
+    // body and top of the far hills.
+    void CreateTileSetTexture(ID3D11Device* device, ID3D11ShaderResourceView** textureView)
+    {
+        constexpr int width = c_tileSize * c_tileCount;
+        constexpr int height = c_tileSize;
+
+        std::vector<uint32_t> pixels(size_t(width * height));
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                const int tile = x / c_tileSize;
+                const int tx = x % c_tileSize;
+
+                const bool speck = ((tx * 7 + y * 13) % 5) == 0;
+
+                uint32_t color = 0;
+                switch (tile)
+                {
+                case 0: color = speck ? 0xFF1F3A5Au : 0xFF2B5A8Bu; break;
+                case 1: color = (y < 4) ? 0xFF3CB43Cu : (speck ? 0xFF1F3A5Au : 0xFF2B5A8Bu); break;
+                case 2: color = 0xFF5A3228u; break;
+                default: color = (y < 8) ? 0u : 0xFF5A3228u; break;
+                }
+
+                pixels[size_t(y * width + x)] = color;
+            }
+        }
+
+        D3D11_TEXTURE2D_DESC desc = {};
+        desc.Width = width;
+        desc.Height = height;
+        desc.MipLevels = desc.ArraySize = 1;
+        desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        desc.SampleDesc.Count = 1;
+        desc.Usage = D3D11_USAGE_IMMUTABLE;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+        D3D11_SUBRESOURCE_DATA initData = {};
+        initData.pSysMem = pixels.data();
+        initData.SysMemPitch = UINT(width * sizeof(uint32_t));
+
+        ComPtr<ID3D11Texture2D> texture;
+        DX::ThrowIfFailed(device->CreateTexture2D(&desc, &initData, texture.GetAddressOf()));
+        DX::ThrowIfFailed(device->CreateShaderResourceView(texture.Get(), nullptr, textureView));
+    }
+
+    // Rolling terrain of 'height' rows, 'minHeight' to 'minHeight + range' rows tall,
+    // with a top tile over body tiles.
+    std::vector<uint16_t> BuildTerrain(int width, int height, int minHeight, float range, float frequency,
+        uint16_t top, uint16_t body)
+    {
+        std::vector<uint16_t> tiles(size_t(width * height), 0);
+        for (int x = 0; x < width; ++x)
+        {
+            const float wave = 0.625f * (1.f + sinf(float(x) * frequency)) + 0.375f * (1.f + sinf(float(x) * frequency * 0.33f));
+            const int columnHeight = std::min(minHeight + int(wave * 0.5f * range), height);
+
+            for (int y = height - columnHeight; y < height; ++y)
+            {
+                tiles[size_t(y * width + x)] = (y == height - columnHeight) ? top : body;
+            }
+        }
+        return tiles;
+    }
+}
+
 Game::Game() noexcept(false)
 {
     m_deviceResources = std::make_unique<DX::DeviceResources>();
@@ -57,6 +146,37 @@ void Game::Update(DX::StepTimer const& timer)
     // TODO: Add your game logic here.
     m_stars->Update(elapsedTime * 500 );
     m_ship->Update(elapsedTime);
+    m_escort->Update(elapsedTime);
+
+    for (size_t j = 0; j < m_escortHandles.size(); ++j)
+    {
+        const SpriteGrid::Handle handle = m_escortHandles[j];
+        const SpriteGrid::Point& pos = m_escorts.GetMinBounds(handle);
+        Vector2& velocity = m_escortVelocity[j];
+
+        float x = pos.x + velocity.x * elapsedTime;
+        float y = pos.y + velocity.y * elapsedTime;
+        if (x < 0.f || x > c_worldWidth - c_escortSize)
+        {
+            velocity.x = -velocity.x;
+            x = std::min(std::max(x, 0.f), c_worldWidth - c_escortSize);
+        }
+        if (y < 0.f || y > c_worldHeight - c_escortSize)
+        {
+            velocity.y = -velocity.y;
+            y = std::min(std::max(y, 0.f), c_worldHeight - c_escortSize);
+        }
+
+        m_escorts.Move(handle, { x, y }, { x + c_escortSize, y + c_escortSize });
+    }
+
+    // Scroll across the level and start over at the end of the near layer.
+    auto size = m_deviceResources->GetOutputSize();
+    m_tileMap->Update(elapsedTime * c_cameraSpeed, 0.f);
+    if (m_tileMap->GetCamera().x > float(c_nearWidth * c_tileSize - size.right))
+    {
+        m_tileMap->SetCamera(XMFLOAT2(0.f, 0.f));
+    }
 }
 #pragma endregion
 
@@ -73,14 +193,30 @@ void Game::Render()
     Clear();
 
     m_deviceResources->PIXBeginEvent(L"Render");
-    //auto context = m_deviceResources->GetD3DDeviceContext();
+    auto context = m_deviceResources->GetD3DDeviceContext();
 
     // TODO: Add your rendering code here.
     m_spriteBatch->Begin();
-
     m_stars->Draw(m_spriteBatch.get());
+    m_spriteBatch->End();
+
+    // One draw per visible chunk of each layer, between the starfield and the ship.
+    m_tileMap->Draw(context);
+
+    // Only the escorts inside the view are submitted.
+    auto size = m_deviceResources->GetOutputSize();
+    const XMFLOAT2 camera = m_tileMap->GetCamera();
+    m_escorts.Query({ camera.x, camera.y }, { camera.x + float(size.right), camera.y + float(size.bottom) },
+        m_visibleEscorts);
+
+    m_spriteBatch->Begin();
+    for (const SpriteGrid::Handle handle : m_visibleEscorts)
+    {
+        const SpriteGrid::Point& pos = m_escorts.GetMinBounds(handle);
+        m_escort->Draw(m_spriteBatch.get(), int(m_escorts.GetUserData(handle) % 4),
+            XMFLOAT2(pos.x - camera.x, pos.y - camera.y));
+    }
     m_ship->Draw( m_spriteBatch.get(), m_shipPos );
-    
     m_spriteBatch->End();
 
     // Show the new frame.
@@ -173,9 +309,59 @@ void Game::CreateDeviceDependentResources()
 
     m_ship = std::make_unique<AnimatedTexture>();
     m_ship->Load(m_texture.Get(), 4, 20);
+
+    m_escort = std::make_unique<AnimatedTexture>(XMFLOAT2(0.f, 0.f), 0.f, c_escortScale, 0.f);
+    m_escort->Load(m_texture.Get(), 4, 20);
+
+    {
+        m_escorts.Create({ 0.f, 0.f }, { c_worldWidth, c_worldHeight }, 256.f, c_escortCount);
+        m_escortHandles.clear();
+        m_escortVelocity.clear();
+
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> xDist(0.f, c_worldWidth - c_escortSize);
+        std::uniform_real_distribution<float> yDist(0.f, c_worldHeight - c_escortSize);
+        std::uniform_real_distribution<float> speedDist(-60.f, 60.f);
+
+        for (int j = 0; j < c_escortCount; ++j)
+        {
+            const float x = xDist(rng);
+            const float y = yDist(rng);
+            m_escortHandles.push_back(m_escorts.Insert({ x, y }, { x + c_escortSize, y + c_escortSize }, 0, uint32_t(j)));
+            m_escortVelocity.emplace_back(speedDist(rng), speedDist(rng));
+        }
+    }
     
     m_stars = std::make_unique<ScrollingBackground>();
     m_stars->Load(m_backgroundTex.Get());
+
+    CreateTileSetTexture(device, m_tileSetTex.ReleaseAndGetAddressOf());
+
+    m_tileSet = std::make_unique<TileSet>();
+    m_tileSet->Load(m_tileSetTex.Get(), c_tileSize, c_tileSize);
+
+    m_tileMap = std::make_unique<ParallaxTileMap>();
+    m_tileMap->CreateDeviceResources(device);
+
+    {
+        auto tiles = BuildTerrain(c_farWidth, c_farHeight, 6, 8.f, 0.05f, 4, 3);
+        m_tileMap->AddLayer(0.5f, 1.f).Load(m_tileSet.get(), c_farWidth, c_farHeight, tiles.data());
+    }
+
+    {
+        auto tiles = BuildTerrain(c_nearWidth, c_nearHeight, 2, 6.f, 0.07f, 2, 1);
+        TileMapLayer& layer = m_tileMap->AddLayer(1.f, 1.f);
+        layer.Load(m_tileSet.get(), c_nearWidth, c_nearHeight, tiles.data());
+
+        // Floating platforms, edited after the load so their chunks are rebuilt on first draw.
+        for (int x = 20; x + 6 < c_nearWidth; x += 40)
+        {
+            for (int j = 0; j < 6; ++j)
+            {
+                layer.SetTile(x + j, 4, 2);
+            }
+        }
+    }
 }
 
 // Allocate all memory resources that change on a window SizeChanged event.
@@ -187,14 +373,23 @@ void Game::CreateWindowSizeDependentResources()
     m_shipPos.y = float((size.bottom / 2) + (size.bottom / 4));
 
     m_stars->SetWindow(size.right, size.bottom);
+
+    // Keep the bottom of each layer on the bottom of the window.
+    m_tileMap->SetWindow(size.right, size.bottom);
+    m_tileMap->GetLayer(0).SetOffset(0.f, float(size.bottom - c_farHeight * c_tileSize));
+    m_tileMap->GetLayer(1).SetOffset(0.f, float(size.bottom - c_nearHeight * c_tileSize));
 }
 
 void Game::OnDeviceLost()
 {
     m_ship.reset();
+    m_escort.reset();
     m_stars.reset();
+    m_tileMap.reset();
+    m_tileSet.reset();
     m_spriteBatch.reset();
 
+    m_tileSetTex.Reset();
     m_backgroundTex.Reset();
     m_texture.Reset();
     // TODO: Add Direct3D resource cleanup here
@@ -7,6 +7,8 @@
 #include "DeviceResources.h"
 #include "StepTimer.h"
 #include "ScrollingBackground.h"
+#include "SpriteGrid.h"
+#include "TileMap.h"
 #include "AnimatedTexture.h"
 
 
@@ -65,9 +67,18 @@ private:
     // Test
     std::unique_ptr<DirectX::SpriteBatch>               m_spriteBatch;
     std::unique_ptr<AnimatedTexture>                    m_ship;
+    std::unique_ptr<AnimatedTexture>                    m_escort;
     std::unique_ptr<ScrollingBackground>                m_stars;
+    std::unique_ptr<TileSet>                            m_tileSet;
+    std::unique_ptr<ParallaxTileMap>                    m_tileMap;
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_texture;
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_backgroundTex;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_tileSetTex;
 
     DirectX::SimpleMath::Vector2                        m_shipPos;
+
+    SpriteGrid                                          m_escorts;
+    std::vector<SpriteGrid::Handle>                     m_escortHandles;
+    std::vector<DirectX::SimpleMath::Vector2>           m_escortVelocity;
+    std::vector<SpriteGrid::Handle>                     m_visibleEscorts;
 };
\ No newline at end of file
@@ -0,0 +1,381 @@
+//--------------------------------------------------------------------------------------
+// File: SpriteGrid.h
+//
+// Uniform grid spatial index for large 2D sprite worlds. Sprites are inserted into every
+// cell their bounds overlap so a camera query only visits the cells in view. Moves that
+// stay inside the same cells only update the stored bounds. Handles carry a generation
+// count, so a handle kept after Remove is rejected even once its slot has been reused.
+//
+// This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <stdexcept>
+#include <vector>
+
+class SpriteGrid
+{
+public:
+    // The low IndexBits are the sprite slot and the high bits count how often the slot has
+    // been freed. The count wraps after 256 reuses of one slot.
+    using Handle = uint32_t;
+
+    static constexpr uint32_t IndexBits = 24;
+    static constexpr Handle IndexMask = (Handle(1) << IndexBits) - 1;
+    static constexpr Handle InvalidHandle = UINT32_MAX;
+
+    // The last index is never used, so InvalidHandle can't match a sprite.
+    static constexpr size_t MaxSprites = IndexMask;
+
+    static uint32_t GetIndex(Handle handle) noexcept { return handle & IndexMask; }
+
+    // Layout-compatible with DirectX::XMFLOAT2.
+    struct Point
+    {
+        float x;
+        float y;
+    };
+
+    // Upper limit on the number of cells Create will allocate.
+    static constexpr size_t MaxCells = size_t(1) << 24;
+
+    SpriteGrid() noexcept :
+        m_cellSize(0.f),
+        m_invCellSize(0.f),
+        m_worldOrigin{},
+        m_cellsX(0),
+        m_cellsY(0),
+        m_queryMark(0),
+        m_freeList(InvalidHandle),
+        m_count(0)
+    {
+    }
+
+    SpriteGrid(SpriteGrid&&) = default;
+    SpriteGrid& operator= (SpriteGrid&&) = default;
+
+    SpriteGrid(SpriteGrid const&) = delete;
+    SpriteGrid& operator= (SpriteGrid const&) = delete;
+
+    // Sprites outside of the world rectangle are clamped into the border cells.
+    void Create(const Point& worldMin, const Point& worldMax, float cellSize, size_t reserve = 0)
+    {
+        if (!std::isfinite(cellSize) || cellSize <= 0.f
+            || !std::isfinite(worldMin.x) || !std::isfinite(worldMin.y)
+            || !std::isfinite(worldMax.x) || !std::isfinite(worldMax.y)
+            || worldMax.x <= worldMin.x || worldMax.y <= worldMin.y)
+            throw std::invalid_argument("SpriteGrid");
+
+        // Count the cells in double so a tiny cell size can't overflow the conversion.
+        const double cellsX = std::max(std::ceil((double(worldMax.x) - double(worldMin.x)) / double(cellSize)), 1.0);
+        const double cellsY = std::max(std::ceil((double(worldMax.y) - double(worldMin.y)) / double(cellSize)), 1.0);
+        if (cellsX * cellsY > double(MaxCells))
+            throw std::out_of_range("SpriteGrid has too many cells");
+
+        m_cellSize = cellSize;
+        m_invCellSize = 1.f / cellSize;
+        m_worldOrigin = worldMin;
+        m_cellsX = int(cellsX);
+        m_cellsY = int(cellsY);
+
+        m_cells.clear();
+        m_cells.resize(size_t(m_cellsX) * size_t(m_cellsY));
+
+        m_sprites.clear();
+        m_sprites.reserve(reserve);
+        m_freeList = InvalidHandle;
+        m_count = 0;
+        m_queryMark = 0;
+    }
+
+    // 'texture' is an application defined key (e.g. an index into a texture table) used to
+    // order query results for SpriteSortMode_Texture style batching. Bounds must have
+    // min <= max on both axes; they may be infinite but not NaN.
+    Handle Insert(const Point& minBounds, const Point& maxBounds, uint32_t texture, uint32_t userData = 0)
+    {
+        if (m_cells.empty())
+            throw std::runtime_error("SpriteGrid::Create must be called before Insert");
+
+        ValidateBounds(minBounds, maxBounds);
+
+        uint32_t index;
+        if (m_freeList != InvalidHandle)
+        {
+            index = m_freeList;
+            m_freeList = m_sprites[index].userData;
+        }
+        else
+        {
+            if (m_sprites.size() >= MaxSprites)
+                throw std::out_of_range("SpriteGrid is full");
+
+            index = uint32_t(m_sprites.size());
+            m_sprites.emplace_back();
+        }
+
+        Sprite& sprite = m_sprites[index];
+        const Handle handle = MakeHandle(index, sprite.generation);
+        sprite.minBounds = minBounds;
+        sprite.maxBounds = maxBounds;
+        sprite.texture = texture;
+        sprite.userData = userData;
+        sprite.mark = 0;
+        sprite.alive = true;
+        sprite.cells = ComputeCells(minBounds, maxBounds);
+
+        AddToCells(handle, sprite.cells);
+        ++m_count;
+
+        return handle;
+    }
+
+    void Move(Handle handle, const Point& minBounds, const Point& maxBounds)
+    {
+        ValidateBounds(minBounds, maxBounds);
+
+        Sprite& sprite = Get(handle);
+
+        sprite.minBounds = minBounds;
+        sprite.maxBounds = maxBounds;
+
+        const CellRange cells = ComputeCells(minBounds, maxBounds);
+        if (cells == sprite.cells)
+            return;
+
+        // Only touch cells which were entered or left.
+        const CellRange old = sprite.cells;
+        for (int y = old.y0; y <= old.y1; ++y)
+        {
+            for (int x = old.x0; x <= old.x1; ++x)
+            {
+                if (!cells.Contains(x, y))
+                    RemoveFromCell(handle, x, y);
+            }
+        }
+
+        for (int y = cells.y0; y <= cells.y1; ++y)
+        {
+            for (int x = cells.x0; x <= cells.x1; ++x)
+            {
+                if (!old.Contains(x, y))
+                    m_cells[CellIndex(x, y)].push_back(handle);
+            }
+        }
+
+        sprite.cells = cells;
+    }
+
+    void Remove(Handle handle)
+    {
+        Sprite& sprite = Get(handle);
+
+        for (int y = sprite.cells.y0; y <= sprite.cells.y1; ++y)
+        {
+            for (int x = sprite.cells.x0; x <= sprite.cells.x1; ++x)
+            {
+                RemoveFromCell(handle, x, y);
+            }
+        }
+
+        sprite.alive = false;
+        ++sprite.generation;
+        sprite.userData = m_freeList;
+        m_freeList = GetIndex(handle);
+        --m_count;
+    }
+
+    // Returns the handles of all sprites overlapping the rectangle, ordered by texture key
+    // then index. The results vector is reused to avoid per-frame allocations. A rectangle
+    // with min > max or NaN bounds overlaps nothing.
+    void Query(const Point& minBounds, const Point& maxBounds, std::vector<Handle>& results)
+    {
+        results.clear();
+        m_sortKeys.clear();
+
+        if (m_cells.empty()
+            || !(minBounds.x <= maxBounds.x) || !(minBounds.y <= maxBounds.y))
+            return;
+
+        if (++m_queryMark == 0)
+        {
+            // Wrapped; clear the stale marks.
+            for (auto& it : m_sprites)
+                it.mark = 0;
+            m_queryMark = 1;
+        }
+
+        const CellRange cells = ComputeCells(minBounds, maxBounds);
+        for (int y = cells.y0; y <= cells.y1; ++y)
+        {
+            for (int x = cells.x0; x <= cells.x1; ++x)
+            {
+                for (const Handle handle : m_cells[CellIndex(x, y)])
+                {
+                    Sprite& sprite = m_sprites[GetIndex(handle)];
+                    if (sprite.mark == m_queryMark)
+                        continue;
+
+                    sprite.mark = m_queryMark;
+
+                    if (sprite.maxBounds.x < minBounds.x || sprite.minBounds.x > maxBounds.x
+                        || sprite.maxBounds.y < minBounds.y || sprite.minBounds.y > maxBounds.y)
+                        continue;
+
+                    m_sortKeys.push_back((uint64_t(sprite.texture) << 32) | GetIndex(handle));
+                }
+            }
+        }
+
+        std::sort(m_sortKeys.begin(), m_sortKeys.end());
+
+        results.reserve(m_sortKeys.size());
+        for (const uint64_t key : m_sortKeys)
+        {
+            const uint32_t index = uint32_t(key & 0xFFFFFFFF);
+            results.push_back(MakeHandle(index, m_sprites[index].generation));
+        }
+    }
+
+    uint32_t GetTexture(Handle handle) const { return Get(handle).texture; }
+    uint32_t GetUserData(Handle handle) const { return Get(handle).userData; }
+    const Point& GetMinBounds(Handle handle) const { return Get(handle).minBounds; }
+    const Point& GetMaxBounds(Handle handle) const { return Get(handle).maxBounds; }
+
+    size_t GetCount() const noexcept { return m_count; }
+    float GetCellSize() const noexcept { return m_cellSize; }
+
+private:
+    struct CellRange
+    {
+        int x0;
+        int y0;
+        int x1;
+        int y1;
+
+        bool Contains(int x, int y) const noexcept { return x >= x0 && x <= x1 && y >= y0 && y <= y1; }
+        bool operator== (const CellRange& other) const noexcept
+        {
+            return x0 == other.x0 && y0 == other.y0 && x1 == other.x1 && y1 == other.y1;
+        }
+    };
+
+    struct Sprite
+    {
+        Point               minBounds;
+        Point               maxBounds;
+        uint32_t            texture;
+        uint32_t            userData;   // Next free handle when not alive
+        uint32_t            mark;
+        bool                alive;
+        uint8_t             generation; // High bits of the handle
+        CellRange           cells;
+    };
+
+    Sprite& Get(Handle handle)
+    {
+        const uint32_t index = GetIndex(handle);
+        if (index >= m_sprites.size() || !m_sprites[index].alive
+            || m_sprites[index].generation != (handle >> IndexBits))
+            throw std::out_of_range("SpriteGrid invalid handle");
+
+        return m_sprites[index];
+    }
+
+    const Sprite& Get(Handle handle) const
+    {
+        const uint32_t index = GetIndex(handle);
+        if (index >= m_sprites.size() || !m_sprites[index].alive
+            || m_sprites[index].generation != (handle >> IndexBits))
+            throw std::out_of_range("SpriteGrid invalid handle");
+
+        return m_sprites[index];
+    }
+
+    static Handle MakeHandle(uint32_t index, uint8_t generation) noexcept
+    {
+        return (Handle(generation) << IndexBits) | index;
+    }
+
+    static void ValidateBounds(const Point& minBounds, const Point& maxBounds)
+    {
+        // Also rejects NaN.
+        if (!(minBounds.x <= maxBounds.x) || !(minBounds.y <= maxBounds.y))
+            throw std::invalid_argument("SpriteGrid bounds");
+    }
+
+    // Clamps in float before converting, so coordinates far outside the world (or infinite)
+    // land in the border cells instead of overflowing the int conversion.
+    static int ClampCell(float cell, int count) noexcept
+    {
+        if (!(cell >= 0.f))
+            return 0;
+
+        if (cell >= float(count - 1))
+            return count - 1;
+
+        return int(cell);
+    }
+
+    int ClampX(float x) const noexcept
+    {
+        return ClampCell(floorf((x - m_worldOrigin.x) * m_invCellSize), m_cellsX);
+    }
+
+    int ClampY(float y) const noexcept
+    {
+        return ClampCell(floorf((y - m_worldOrigin.y) * m_invCellSize), m_cellsY);
+    }
+
+    CellRange ComputeCells(const Point& minBounds, const Point& maxBounds) const noexcept
+    {
+        return CellRange{ ClampX(minBounds.x), ClampY(minBounds.y), ClampX(maxBounds.x), ClampY(maxBounds.y) };
+    }
+
+    size_t CellIndex(int x, int y) const noexcept
+    {
+        return size_t(y) * size_t(m_cellsX) + size_t(x);
+    }
+
+    void AddToCells(Handle handle, const CellRange& cells)
+    {
+        for (int y = cells.y0; y <= cells.y1; ++y)
+        {
+            for (int x = cells.x0; x <= cells.x1; ++x)
+            {
+                m_cells[CellIndex(x, y)].push_back(handle);
+            }
+        }
+    }
+
+    void RemoveFromCell(Handle handle, int x, int y)
+    {
+        auto& cell = m_cells[CellIndex(x, y)];
+        auto it = std::find(cell.begin(), cell.end(), handle);
+        if (it != cell.end())
+        {
+            *it = cell.back();
+            cell.pop_back();
+        }
+    }
+
+    float                                   m_cellSize;
+    float                                   m_invCellSize;
+    Point                                   m_worldOrigin;
+    int                                     m_cellsX;
+    int                                     m_cellsY;
+    uint32_t                                m_queryMark;
+    Handle                                  m_freeList;
+    size_t                                  m_count;
+    std::vector<Sprite>                     m_sprites;
+    std::vector<std::vector<Handle>>        m_cells;
+    std::vector<uint64_t>                   m_sortKeys;
+};
@@ -0,0 +1,434 @@
+//--------------------------------------------------------------------------------------
+// File: SpriteGridCheck.cpp
+//
+// Checks SpriteGrid.h against a brute-force overlap scan: random inserts, small moves,
+// jumps across and far outside the world (including infinite bounds), removes with handle
+// reuse, and queries must return exactly the sprites the scan finds, in texture then handle
+// order. Inverted or NaN bounds are rejected without changing the grid, and bad Create
+// arguments throw. Finally 100000 sprites are queried with a screen-sized view and the
+// time is compared with the scan.
+//
+// This is a standalone console tool with no Windows or Direct3D dependencies:
+//
+//   g++ -std=c++14 -O2 -I.. -I../../Common -o SpriteGridCheck SpriteGridCheck.cpp
+//   cl /std:c++14 /O2 /EHsc /I.. /I..\..\Common SpriteGridCheck.cpp
+//
+// Pass -nobench to skip the timing.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "SpriteGrid.h"
+#include "CheckHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    using Point = SpriteGrid::Point;
+    using Handle = SpriteGrid::Handle;
+
+    // Indexed by SpriteGrid::GetIndex.
+    struct Reference
+    {
+        bool        alive;
+        Handle      handle;
+        Point       minBounds;
+        Point       maxBounds;
+        uint32_t    texture;
+    };
+
+    template<typename Func>
+    bool Throws(Func&& func)
+    {
+        try
+        {
+            func();
+        }
+        catch (const std::exception&)
+        {
+            return true;
+        }
+        return false;
+    }
+
+    void BruteForce(const std::vector<Reference>& sprites, const Point& minBounds, const Point& maxBounds,
+        std::vector<Handle>& results)
+    {
+        results.clear();
+        if (!(minBounds.x <= maxBounds.x) || !(minBounds.y <= maxBounds.y))
+            return;
+
+        for (size_t j = 0; j < sprites.size(); ++j)
+        {
+            const Reference& it = sprites[j];
+            if (!it.alive)
+                continue;
+
+            if (it.maxBounds.x < minBounds.x || it.minBounds.x > maxBounds.x
+                || it.maxBounds.y < minBounds.y || it.minBounds.y > maxBounds.y)
+                continue;
+
+            results.push_back(it.handle);
+        }
+
+        std::stable_sort(results.begin(), results.end(), [&](Handle a, Handle b)
+            {
+                return sprites[SpriteGrid::GetIndex(a)].texture < sprites[SpriteGrid::GetIndex(b)].texture;
+            });
+    }
+
+    class RandomBounds
+    {
+    public:
+        explicit RandomBounds(uint32_t seed) : mRng(seed) {}
+
+        // Mostly inside the 4096 x 2048 world, some straddling or far outside it.
+        void Make(Point& minBounds, Point& maxBounds)
+        {
+            std::uniform_int_distribution<int> kind(0, 19);
+            std::uniform_real_distribution<float> inside(-100.f, 4200.f);
+            std::uniform_real_distribution<float> size(0.f, 150.f);
+            std::uniform_real_distribution<float> huge(-1e30f, 1e30f);
+
+            const float inf = std::numeric_limits<float>::infinity();
+
+            switch (kind(mRng))
+            {
+            case 0:
+                minBounds = { huge(mRng), huge(mRng) };
+                maxBounds = { minBounds.x + size(mRng), minBounds.y + size(mRng) };
+                break;
+
+            case 1:
+                minBounds = { -inf, inside(mRng) * 0.5f };
+                maxBounds = { inside(mRng), minBounds.y + size(mRng) };
+                break;
+
+            case 2:
+                minBounds = { inside(mRng), -inf };
+                maxBounds = { inf, inf };
+                break;
+
+            case 3:
+                // Large sprites covering many cells.
+                minBounds = { inside(mRng), inside(mRng) * 0.5f };
+                maxBounds = { minBounds.x + size(mRng) * 10.f, minBounds.y + size(mRng) * 10.f };
+                break;
+
+            case 4:
+                // Zero-size sprites sitting exactly on cell edges.
+                minBounds = { float(int(inside(mRng)) / 64 * 64), float(int(inside(mRng) * 0.5f) / 64 * 64) };
+                maxBounds = minBounds;
+                break;
+
+            default:
+                minBounds = { inside(mRng), inside(mRng) * 0.5f };
+                maxBounds = { minBounds.x + size(mRng), minBounds.y + size(mRng) };
+                break;
+            }
+        }
+
+        std::mt19937& Rng() noexcept { return mRng; }
+
+    private:
+        std::mt19937 mRng;
+    };
+
+    void CheckAgainstBruteForce()
+    {
+        SpriteGrid grid;
+        grid.Create({ 0.f, 0.f }, { 4096.f, 2048.f }, 64.f);
+
+        std::vector<Reference> sprites;
+        std::vector<Handle> live;
+        std::vector<Handle> results;
+        std::vector<Handle> expected;
+
+        RandomBounds bounds(2024);
+        std::uniform_int_distribution<int> opDist(0, 99);
+        std::uniform_int_distribution<uint32_t> textureDist(0, 7);
+        std::uniform_real_distribution<float> nudge(-20.f, 20.f);
+
+        size_t queries = 0;
+        size_t mismatches = 0;
+        size_t hits = 0;
+        size_t reused = 0;
+        size_t staleRejected = 0;
+
+        for (int step = 0; step < 60000; ++step)
+        {
+            const int op = opDist(bounds.Rng());
+
+            if (op < 30 || live.empty())
+            {
+                Point minBounds, maxBounds;
+                bounds.Make(minBounds, maxBounds);
+                const uint32_t texture = textureDist(bounds.Rng());
+
+                const Handle handle = grid.Insert(minBounds, maxBounds, texture, uint32_t(step));
+                const uint32_t slot = SpriteGrid::GetIndex(handle);
+                if (slot < sprites.size())
+                {
+                    const Handle stale = sprites[slot].handle;
+                    if (sprites[slot].alive || stale == handle)
+                    {
+                        Fail("Insert returned the handle %08x again", handle);
+                        return;
+                    }
+                    ++reused;
+
+                    // The removed sprite's handle must not reach the sprite now in its slot.
+                    if (Throws([&]() { grid.Move(stale, { 0.f, 0.f }, { 1.f, 1.f }); })
+                        && Throws([&]() { grid.Remove(stale); })
+                        && Throws([&]() { grid.GetTexture(stale); }))
+                        ++staleRejected;
+                }
+                else
+                {
+                    sprites.resize(size_t(slot) + 1, Reference{ false, SpriteGrid::InvalidHandle, {}, {}, 0 });
+                }
+
+                sprites[slot] = Reference{ true, handle, minBounds, maxBounds, texture };
+                live.push_back(handle);
+            }
+            else if (op < 70)
+            {
+                const size_t index = bounds.Rng()() % live.size();
+                const Handle handle = live[index];
+                Reference& ref = sprites[SpriteGrid::GetIndex(handle)];
+
+                Point minBounds, maxBounds;
+                if (op < 55 && std::isfinite(ref.minBounds.x) && std::isfinite(ref.maxBounds.x)
+                    && std::isfinite(ref.minBounds.y) && std::isfinite(ref.maxBounds.y))
+                {
+                    // Small step, which often stays inside the same cells.
+                    const float dx = nudge(bounds.Rng());
+                    const float dy = nudge(bounds.Rng());
+                    minBounds = { ref.minBounds.x + dx, ref.minBounds.y + dy };
+                    maxBounds = { ref.maxBounds.x + dx, ref.maxBounds.y + dy };
+                }
+                else
+                {
+                    bounds.Make(minBounds, maxBounds);
+                }
+
+                grid.Move(handle, minBounds, maxBounds);
+                ref.minBounds = minBounds;
+                ref.maxBounds = maxBounds;
+            }
+            else if (op < 85)
+            {
+                const size_t index = bounds.Rng()() % live.size();
+                const Handle handle = live[index];
+
+                grid.Remove(handle);
+                sprites[SpriteGrid::GetIndex(handle)].alive = false;
+                live[index] = live.back();
+                live.pop_back();
+            }
+            else
+            {
+                Point minBounds, maxBounds;
+                bounds.Make(minBounds, maxBounds);
+                if (op >= 95)
+                {
+                    // Screen-sized views.
+                    maxBounds = { minBounds.x + 800.f, minBounds.y + 600.f };
+                }
+
+                grid.Query(minBounds, maxBounds, results);
+                BruteForce(sprites, minBounds, maxBounds, expected);
+
+                ++queries;
+                hits += expected.size();
+                if (results != expected)
+                    ++mismatches;
+            }
+
+            if (grid.GetCount() != live.size())
+            {
+                Fail("GetCount is %zu after step %d, expected %zu", grid.GetCount(), step, live.size());
+                return;
+            }
+        }
+
+        if (mismatches)
+            Fail("%zu of %zu queries differ from the brute-force scan", mismatches, queries);
+
+        Check(queries > 5000 && hits > queries && reused > 1000, "Random test covers queries, hits and handle reuse");
+        Check(staleRejected == reused, "Handles of removed sprites are rejected after their slot is reused");
+
+        // Stored bounds and keys come back unchanged.
+        bool stored = true;
+        for (const Handle handle : live)
+        {
+            const Reference& ref = sprites[SpriteGrid::GetIndex(handle)];
+            if (memcmp(&grid.GetMinBounds(handle), &ref.minBounds, sizeof(Point)) != 0
+                || memcmp(&grid.GetMaxBounds(handle), &ref.maxBounds, sizeof(Point)) != 0
+                || grid.GetTexture(handle) != ref.texture)
+                stored = false;
+        }
+        Check(stored, "Bounds and texture keys are stored as given");
+
+        // The whole plane finds every live sprite.
+        const float inf = std::numeric_limits<float>::infinity();
+        grid.Query({ -inf, -inf }, { inf, inf }, results);
+        Check(results.size() == live.size(), "An infinite query finds every sprite");
+    }
+
+    void CheckInvalidBounds()
+    {
+        SpriteGrid grid;
+
+        Check(Throws([&]() { grid.Insert({ 0.f, 0.f }, { 1.f, 1.f }, 0); }), "Insert before Create throws");
+
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        const float inf = std::numeric_limits<float>::infinity();
+
+        Check(Throws([&]() { grid.Create({ 0.f, 0.f }, { 100.f, 100.f }, 0.f); }), "Create with a zero cell size throws");
+        Check(Throws([&]() { grid.Create({ 0.f, 0.f }, { 100.f, 100.f }, nan); }), "Create with a NaN cell size throws");
+        Check(Throws([&]() { grid.Create({ 0.f, 0.f }, { inf, 100.f }, 10.f); }), "Create with an infinite world throws");
+        Check(Throws([&]() { grid.Create({ 0.f, 0.f }, { -1.f, 100.f }, 10.f); }), "Create with an inverted world throws");
+        Check(Throws([&]() { grid.Create({ 0.f, 0.f }, { 1e30f, 1e30f }, 1.f); }), "Create with too many cells throws");
+
+        grid.Create({ -500.f, -500.f }, { 500.f, 500.f }, 100.f);
+
+        const Handle handle = grid.Insert({ 10.f, 10.f }, { 20.f, 20.f }, 1);
+
+        const Point invalid[][2] =
+        {
+            { { 20.f, 10.f }, { 10.f, 20.f } },
+            { { 10.f, 20.f }, { 20.f, 10.f } },
+            { { nan, 10.f }, { 20.f, 20.f } },
+            { { 10.f, 10.f }, { 20.f, nan } },
+            { { inf, 10.f }, { -inf, 20.f } },
+        };
+
+        std::vector<Handle> results;
+        bool rejected = true;
+        for (const auto& it : invalid)
+        {
+            if (!Throws([&]() { grid.Insert(it[0], it[1], 0); }))
+                rejected = false;
+            if (!Throws([&]() { grid.Move(handle, it[0], it[1]); }))
+                rejected = false;
+
+            grid.Query(it[0], it[1], results);
+            if (!results.empty())
+                rejected = false;
+        }
+        Check(rejected, "Inverted or NaN bounds are rejected by Insert and Move and match nothing in Query");
+
+        Check(grid.GetCount() == 1 && grid.GetMinBounds(handle).x == 10.f && grid.GetMaxBounds(handle).y == 20.f,
+            "Rejected calls leave the grid unchanged");
+
+        grid.Query({ 0.f, 0.f }, { 15.f, 15.f }, results);
+        Check(results.size() == 1 && results[0] == handle, "The sprite is still found after rejected moves");
+
+        grid.Remove(handle);
+        Check(Throws([&]() { grid.Remove(handle); }), "Removing twice throws");
+        Check(Throws([&]() { grid.Move(handle, { 0.f, 0.f }, { 1.f, 1.f }); }), "Moving a removed sprite throws");
+        Check(Throws([&]() { grid.GetTexture(12345); }), "Unknown handles throw");
+
+        // Reinserting reuses the slot with a new generation.
+        const Handle reinserted = grid.Insert({ 30.f, 30.f }, { 40.f, 40.f }, 2);
+        Check(SpriteGrid::GetIndex(reinserted) == SpriteGrid::GetIndex(handle) && reinserted != handle,
+            "A reused slot gets a new handle");
+        Check(Throws([&]() { grid.Remove(handle); }) && Throws([&]() { grid.Move(handle, { 0.f, 0.f }, { 1.f, 1.f }); }),
+            "The old handle is rejected after its slot is reused");
+        Check(grid.GetCount() == 1 && grid.GetTexture(reinserted) == 2 && grid.GetMinBounds(reinserted).x == 30.f,
+            "Rejected stale handles leave the new sprite unchanged");
+
+        // The generation count wraps after 256 reuses of a slot.
+        Handle current = reinserted;
+        for (int j = 0; j < 255; ++j)
+        {
+            grid.Remove(current);
+            current = grid.Insert({ 30.f, 30.f }, { 40.f, 40.f }, 2);
+        }
+        Check(current == handle,
+            "Generations wrap after 256 reuses");
+        Check(!Throws([&]() { grid.Remove(current); }) && grid.GetCount() == 0, "The wrapped handle is valid");
+    }
+
+    void CheckPerformance(bool bench)
+    {
+        constexpr int count = 100000;
+
+        SpriteGrid grid;
+        grid.Create({ 0.f, 0.f }, { 32768.f, 32768.f }, 128.f, count);
+
+        std::vector<Reference> sprites(count);
+        std::mt19937 rng(99);
+        std::uniform_real_distribution<float> pos(0.f, 32768.f);
+        std::uniform_real_distribution<float> size(8.f, 64.f);
+
+        for (int j = 0; j < count; ++j)
+        {
+            const Point minBounds = { pos(rng), pos(rng) };
+            const Point maxBounds = { minBounds.x + size(rng), minBounds.y + size(rng) };
+            const uint32_t texture = uint32_t(j % 16);
+            const Handle handle = grid.Insert(minBounds, maxBounds, texture);
+            sprites[size_t(j)] = Reference{ true, handle, minBounds, maxBounds, texture };
+        }
+
+        std::vector<Handle> results;
+        std::vector<Handle> expected;
+
+        constexpr int queries = 200;
+        double gridTime = 0.0;
+        double bruteTime = 0.0;
+        size_t found = 0;
+        bool same = true;
+
+        for (int j = 0; j < queries; ++j)
+        {
+            const Point minBounds = { pos(rng), pos(rng) };
+            const Point maxBounds = { minBounds.x + 1920.f, minBounds.y + 1080.f };
+
+            auto start = std::chrono::high_resolution_clock::now();
+            grid.Query(minBounds, maxBounds, results);
+            auto mid = std::chrono::high_resolution_clock::now();
+            BruteForce(sprites, minBounds, maxBounds, expected);
+            auto end = std::chrono::high_resolution_clock::now();
+
+            gridTime += std::chrono::duration<double, std::milli>(mid - start).count();
+            bruteTime += std::chrono::duration<double, std::milli>(end - mid).count();
+            found += results.size();
+
+            if (results != expected)
+                same = false;
+        }
+        Check(same, "Large grid queries match the brute-force scan");
+
+        if (bench)
+        {
+            printf("%d sprites, 1920 x 1080 view (%.0f sprites on average): grid %.4f ms, brute force %.4f ms per query\n",
+                count, double(found) / queries, gridTime / queries, bruteTime / queries);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const bool bench = !(argc > 1 && strcmp(argv[1], "-nobench") == 0);
+
+    return RunChecks([&]()
+    {
+        CheckAgainstBruteForce();
+        CheckInvalidBounds();
+        CheckPerformance(bench);
+    });
+}
@@ -0,0 +1,381 @@
+//--------------------------------------------------------------------------------------
+// File: TileChunks.h
+//
+// Tile storage and view math for TileMap.h. A layer is split into ChunkSize x ChunkSize
+// chunks which hold only their non-empty tiles in row-major order and are marked dirty
+// when edited. GetVisibleChunks returns the chunks a view rectangle overlaps, and
+// BuildVertices writes the quads of one chunk so it can be drawn from a vertex buffer
+// built once instead of one sprite per tile per frame.
+//
+// This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+
+// Where the tiles are in the tile set texture. Tile ids are numbered left-to-right,
+// top-to-bottom starting at 1; tile id 0 is reserved for 'empty'.
+struct TileSetLayout
+{
+    int tileWidth;
+    int tileHeight;
+    int columns;
+    int rows;
+    int textureWidth;
+    int textureHeight;
+
+    size_t GetTileCount() const noexcept { return size_t(columns) * size_t(rows); }
+
+    static TileSetLayout Create(int textureWidth, int textureHeight, int tileWidth, int tileHeight)
+    {
+        if (tileWidth <= 0 || tileHeight <= 0 || textureWidth < tileWidth || textureHeight < tileHeight)
+            throw std::invalid_argument("TileSetLayout");
+
+        TileSetLayout layout;
+        layout.tileWidth = tileWidth;
+        layout.tileHeight = tileHeight;
+        layout.columns = textureWidth / tileWidth;
+        layout.rows = textureHeight / tileHeight;
+        layout.textureWidth = textureWidth;
+        layout.textureHeight = textureHeight;
+
+        if (layout.GetTileCount() >= UINT16_MAX)
+            throw std::out_of_range("TileSetLayout has too many tiles");
+
+        return layout;
+    }
+};
+
+
+// Matches the layout of DirectX::VertexPositionTexture.
+struct TileVertex
+{
+    float x;
+    float y;
+    float z;
+    float u;
+    float v;
+};
+
+
+// Inclusive chunk coordinates; empty when x0 > x1 or y0 > y1.
+struct ChunkRange
+{
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+
+    bool IsEmpty() const noexcept { return x0 > x1 || y0 > y1; }
+    size_t GetCount() const noexcept { return IsEmpty() ? 0 : size_t(x1 - x0 + 1) * size_t(y1 - y0 + 1); }
+};
+
+
+class TileChunkGrid
+{
+public:
+    // Chunks are ChunkSize x ChunkSize tiles, so a chunk has at most 4096 vertices and
+    // can be drawn with 16-bit indices.
+    static constexpr int ChunkSize = 32;
+
+    // Each tile is a quad of four vertices and six indices.
+    static constexpr int VerticesPerTile = 4;
+    static constexpr int IndicesPerTile = 6;
+
+    TileChunkGrid() noexcept :
+        m_width(0),
+        m_height(0),
+        m_chunksX(0),
+        m_chunksY(0),
+        m_tileCount(0)
+    {
+    }
+
+    TileChunkGrid(TileChunkGrid&&) = default;
+    TileChunkGrid& operator= (TileChunkGrid&&) = default;
+
+    TileChunkGrid(TileChunkGrid const&) = delete;
+    TileChunkGrid& operator= (TileChunkGrid const&) = delete;
+
+    // 'tileCount' is the number of tiles in the tile set; larger tile ids are rejected.
+    void Create(int width, int height, size_t tileCount)
+    {
+        if (width <= 0 || height <= 0 || !tileCount)
+            throw std::invalid_argument("TileChunkGrid");
+
+        m_width = width;
+        m_height = height;
+        m_chunksX = (width + ChunkSize - 1) / ChunkSize;
+        m_chunksY = (height + ChunkSize - 1) / ChunkSize;
+        m_tileCount = tileCount;
+
+        m_chunks.clear();
+        m_chunks.resize(size_t(m_chunksX) * size_t(m_chunksY));
+    }
+
+    // Bulk load from a row-major array of width * height tile ids (0 is empty).
+    void Load(int width, int height, size_t tileCount, const uint16_t* tiles)
+    {
+        Create(width, height, tileCount);
+
+        if (!tiles)
+            return;
+
+        for (int cy = 0; cy < m_chunksY; ++cy)
+        {
+            for (int cx = 0; cx < m_chunksX; ++cx)
+            {
+                Chunk& chunk = GetChunk(cx, cy);
+
+                const int x0 = cx * ChunkSize;
+                const int y0 = cy * ChunkSize;
+                const int x1 = std::min(x0 + ChunkSize, width);
+                const int y1 = std::min(y0 + ChunkSize, height);
+
+                for (int y = y0; y < y1; ++y)
+                {
+                    const uint16_t* row = tiles + size_t(y) * size_t(width);
+                    for (int x = x0; x < x1; ++x)
+                    {
+                        if (row[x])
+                        {
+                            if (row[x] > tileCount)
+                                throw std::out_of_range("Load: invalid tile id");
+
+                            chunk.tiles.push_back(MakeTile(x - x0, y - y0, row[x]));
+                        }
+                    }
+                }
+
+                chunk.tiles.shrink_to_fit();
+            }
+        }
+    }
+
+    void SetTile(int x, int y, uint16_t tile)
+    {
+        if (x < 0 || y < 0 || x >= m_width || y >= m_height)
+            throw std::out_of_range("SetTile");
+
+        if (tile > m_tileCount)
+            throw std::out_of_range("SetTile: invalid tile id");
+
+        Chunk& chunk = GetChunk(x / ChunkSize, y / ChunkSize);
+
+        // Chunk tiles are kept in row-major order so Load and SetTile produce identical data.
+        const Tile key = MakeTile(x % ChunkSize, y % ChunkSize, 0);
+        auto it = std::lower_bound(chunk.tiles.begin(), chunk.tiles.end(), key,
+            [](const Tile& a, const Tile& b) { return a.SortKey() < b.SortKey(); });
+
+        const bool found = (it != chunk.tiles.end() && it->SortKey() == key.SortKey());
+        if (tile)
+        {
+            if (found)
+            {
+                if (it->tile == tile)
+                    return;
+
+                it->tile = tile;
+            }
+            else
+            {
+                chunk.tiles.insert(it, MakeTile(key.x, key.y, tile));
+            }
+        }
+        else if (found)
+        {
+            chunk.tiles.erase(it);
+        }
+        else
+        {
+            return;
+        }
+
+        chunk.dirty = true;
+    }
+
+    uint16_t GetTile(int x, int y) const noexcept
+    {
+        if (x < 0 || y < 0 || x >= m_width || y >= m_height)
+            return 0;
+
+        const Chunk& chunk = GetChunk(x / ChunkSize, y / ChunkSize);
+
+        const Tile key = MakeTile(x % ChunkSize, y % ChunkSize, 0);
+        auto it = std::lower_bound(chunk.tiles.cbegin(), chunk.tiles.cend(), key,
+            [](const Tile& a, const Tile& b) { return a.SortKey() < b.SortKey(); });
+
+        return (it != chunk.tiles.cend() && it->SortKey() == key.SortKey()) ? it->tile : uint16_t(0);
+    }
+
+    // Chunks overlapped by a view whose top-left corner is at (viewX, viewY) in layer pixels.
+    // The bounds are clamped in float before they are converted, so views far outside the
+    // layer (or non-finite ones) give an empty range rather than an out-of-range cast.
+    ChunkRange GetVisibleChunks(float viewX, float viewY, float viewWidth, float viewHeight,
+        int tileWidth, int tileHeight) const noexcept
+    {
+        ChunkRange range = { 0, 0, -1, -1 };
+
+        if (m_chunks.empty() || tileWidth <= 0 || tileHeight <= 0
+            || !std::isfinite(viewX) || !std::isfinite(viewY)
+            || !std::isfinite(viewWidth) || !std::isfinite(viewHeight)
+            || viewWidth <= 0.f || viewHeight <= 0.f)
+            return range;
+
+        const float chunkWidth = float(tileWidth) * float(ChunkSize);
+        const float chunkHeight = float(tileHeight) * float(ChunkSize);
+
+        range.x0 = ClampChunk(std::floor(viewX / chunkWidth), m_chunksX);
+        range.y0 = ClampChunk(std::floor(viewY / chunkHeight), m_chunksY);
+        range.x1 = ClampChunk(std::ceil((viewX + viewWidth) / chunkWidth), m_chunksX) - 1;
+        range.y1 = ClampChunk(std::ceil((viewY + viewHeight) / chunkHeight), m_chunksY) - 1;
+
+        return range;
+    }
+
+    // Top-left corner of the view in layer pixels. A scroll factor of 1 moves with the
+    // camera, smaller values give distant parallax layers.
+    static float GetViewOrigin(float camera, float scrollFactor, float offset) noexcept
+    {
+        return camera * scrollFactor - offset;
+    }
+
+    // Appends VerticesPerTile vertices per tile in pixels relative to the chunk's top-left
+    // corner, in the order top-left, top-right, bottom-left, bottom-right.
+    void BuildVertices(int cx, int cy, const TileSetLayout& tileSet, std::vector<TileVertex>& vertices) const
+    {
+        if (tileSet.GetTileCount() < m_tileCount)
+            throw std::invalid_argument("BuildVertices: tile set is smaller than the layer's");
+
+        const Chunk& chunk = GetChunk(cx, cy);
+
+        const float invWidth = 1.f / float(tileSet.textureWidth);
+        const float invHeight = 1.f / float(tileSet.textureHeight);
+
+        vertices.reserve(vertices.size() + chunk.tiles.size() * VerticesPerTile);
+
+        for (const auto& it : chunk.tiles)
+        {
+            const float x0 = float(it.x * tileSet.tileWidth);
+            const float y0 = float(it.y * tileSet.tileHeight);
+            const float x1 = x0 + float(tileSet.tileWidth);
+            const float y1 = y0 + float(tileSet.tileHeight);
+
+            const int index = int(it.tile) - 1;
+            const int sx = (index % tileSet.columns) * tileSet.tileWidth;
+            const int sy = (index / tileSet.columns) * tileSet.tileHeight;
+
+            const float u0 = float(sx) * invWidth;
+            const float v0 = float(sy) * invHeight;
+            const float u1 = float(sx + tileSet.tileWidth) * invWidth;
+            const float v1 = float(sy + tileSet.tileHeight) * invHeight;
+
+            vertices.push_back({ x0, y0, 0.f, u0, v0 });
+            vertices.push_back({ x1, y0, 0.f, u1, v0 });
+            vertices.push_back({ x0, y1, 0.f, u0, v1 });
+            vertices.push_back({ x1, y1, 0.f, u1, v1 });
+        }
+    }
+
+    // Indices for 'tiles' quads laid out by BuildVertices; one buffer serves every chunk.
+    static std::vector<uint16_t> BuildIndices(size_t tiles = size_t(ChunkSize) * size_t(ChunkSize))
+    {
+        if (tiles * VerticesPerTile > size_t(UINT16_MAX) + 1)
+            throw std::out_of_range("BuildIndices");
+
+        std::vector<uint16_t> indices;
+        indices.reserve(tiles * IndicesPerTile);
+
+        for (size_t j = 0; j < tiles; ++j)
+        {
+            const auto base = uint16_t(j * VerticesPerTile);
+            indices.push_back(base);
+            indices.push_back(uint16_t(base + 1));
+            indices.push_back(uint16_t(base + 2));
+            indices.push_back(uint16_t(base + 1));
+            indices.push_back(uint16_t(base + 3));
+            indices.push_back(uint16_t(base + 2));
+        }
+
+        return indices;
+    }
+
+    size_t GetChunkTileCount(int cx, int cy) const { return GetChunk(cx, cy).tiles.size(); }
+
+    // A chunk is dirty from creation until ClearDirty, and again after SetTile changes it.
+    bool IsDirty(int cx, int cy) const { return GetChunk(cx, cy).dirty; }
+    void ClearDirty(int cx, int cy) { GetChunk(cx, cy).dirty = false; }
+
+    int GetWidth() const noexcept { return m_width; }
+    int GetHeight() const noexcept { return m_height; }
+    int GetChunksX() const noexcept { return m_chunksX; }
+    int GetChunksY() const noexcept { return m_chunksY; }
+
+private:
+    struct Tile
+    {
+        uint8_t     x;
+        uint8_t     y;
+        uint16_t    tile;
+
+        uint16_t SortKey() const noexcept { return uint16_t((y << 8) | x); }
+    };
+
+    static_assert(ChunkSize <= 256, "Chunk local coordinates must fit in a byte");
+    static_assert(ChunkSize * ChunkSize * VerticesPerTile <= UINT16_MAX + 1, "Chunk vertices must fit 16-bit indices");
+
+    struct Chunk
+    {
+        Chunk() noexcept : dirty(true) {}
+
+        std::vector<Tile>   tiles;
+        bool                dirty;
+    };
+
+    static Tile MakeTile(int x, int y, uint16_t tile) noexcept
+    {
+        Tile t;
+        t.x = uint8_t(x);
+        t.y = uint8_t(y);
+        t.tile = tile;
+        return t;
+    }
+
+    static int ClampChunk(float value, int count) noexcept
+    {
+        return int(std::min(std::max(value, 0.f), float(count)));
+    }
+
+    Chunk& GetChunk(int cx, int cy)
+    {
+        if (cx < 0 || cy < 0 || cx >= m_chunksX || cy >= m_chunksY)
+            throw std::out_of_range("TileChunkGrid chunk");
+
+        return m_chunks[size_t(cy) * size_t(m_chunksX) + size_t(cx)];
+    }
+
+    const Chunk& GetChunk(int cx, int cy) const
+    {
+        if (cx < 0 || cy < 0 || cx >= m_chunksX || cy >= m_chunksY)
+            throw std::out_of_range("TileChunkGrid chunk");
+
+        return m_chunks[size_t(cy) * size_t(m_chunksX) + size_t(cx)];
+    }
+
+    int                 m_width;
+    int                 m_height;
+    int                 m_chunksX;
+    int                 m_chunksY;
+    size_t              m_tileCount;
+    std::vector<Chunk>  m_chunks;
+};
@@ -0,0 +1,385 @@
+//--------------------------------------------------------------------------------------
+// File: TileMap.h
+//
+// Chunked, multi-layer parallax tile map renderer. Extends the idea of ScrollingBackground
+// to very large maps: tiles are stored in fixed-size chunks (see TileChunks.h) and each
+// chunk's quads are prebuilt into an immutable vertex buffer the first time it comes into
+// view, so a frame costs one draw per visible chunk rather than one sprite per tile.
+// Chunks edited with SetTile are rebuilt the next time they are drawn, and buffers of
+// chunks that have not been drawn for a while are released.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "BufferHelpers.h"
+#include "CommonStates.h"
+#include "DirectXHelpers.h"
+#include "Effects.h"
+#include "VertexTypes.h"
+
+#include "TileChunks.h"
+
+#include <wrl/client.h>
+
+static_assert(sizeof(TileVertex) == sizeof(DirectX::VertexPositionTexture), "TileVertex must match VertexPositionTexture");
+
+
+class TileSet
+{
+public:
+    TileSet() noexcept :
+        m_layout{}
+    {
+    }
+
+    TileSet(TileSet&&) = default;
+    TileSet& operator= (TileSet&&) = default;
+
+    TileSet(TileSet const&) = default;
+    TileSet& operator= (TileSet const&) = default;
+
+    // Tile ids are numbered left-to-right, top-to-bottom in the texture starting at 1.
+    // Tile id 0 is reserved for 'empty'.
+    void Load(ID3D11ShaderResourceView* texture, int tileWidth, int tileHeight)
+    {
+        if (!texture)
+            throw std::invalid_argument("TileSet");
+
+        Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+        texture->GetResource(resource.GetAddressOf());
+
+        D3D11_RESOURCE_DIMENSION dim;
+        resource->GetType(&dim);
+
+        if (dim != D3D11_RESOURCE_DIMENSION_TEXTURE2D)
+            throw std::runtime_error("TileSet expects a Texture2D");
+
+        Microsoft::WRL::ComPtr<ID3D11Texture2D> tex2D;
+        resource.As(&tex2D);
+
+        D3D11_TEXTURE2D_DESC desc;
+        tex2D->GetDesc(&desc);
+
+        m_layout = TileSetLayout::Create(int(desc.Width), int(desc.Height), tileWidth, tileHeight);
+        m_texture = texture;
+    }
+
+    int GetTileWidth() const noexcept { return m_layout.tileWidth; }
+    int GetTileHeight() const noexcept { return m_layout.tileHeight; }
+    size_t GetTileCount() const noexcept { return m_texture ? m_layout.GetTileCount() : 0; }
+
+    const TileSetLayout& GetLayout() const noexcept { return m_layout; }
+    ID3D11ShaderResourceView* GetTexture() const noexcept { return m_texture.Get(); }
+
+private:
+    TileSetLayout                                       m_layout;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_texture;
+};
+
+
+class TileMapLayer
+{
+public:
+    static constexpr int ChunkSize = TileChunkGrid::ChunkSize;
+
+    // A chunk's vertex buffer is released once the layer has been drawn this many times
+    // without it, so only the chunks around the view stay resident however far it scrolls.
+    static constexpr uint32_t EvictFrames = 120;
+
+    TileMapLayer() noexcept :
+        m_tileSet(nullptr),
+        m_scrollFactor(1.f, 1.f),
+        m_offset{},
+        m_frame(0)
+    {
+    }
+
+    TileMapLayer(TileMapLayer&&) = default;
+    TileMapLayer& operator= (TileMapLayer&&) = default;
+
+    TileMapLayer(TileMapLayer const&) = delete;
+    TileMapLayer& operator= (TileMapLayer const&) = delete;
+
+    void Create(const TileSet* tileSet, int width, int height)
+    {
+        if (!tileSet)
+            throw std::invalid_argument("TileMapLayer");
+
+        m_grid.Create(width, height, tileSet->GetTileCount());
+        m_tileSet = tileSet;
+        ResetVertexBuffers();
+    }
+
+    // Bulk load from a row-major array of width * height tile ids (0 is empty).
+    void Load(const TileSet* tileSet, int width, int height, const uint16_t* tiles)
+    {
+        if (!tileSet)
+            throw std::invalid_argument("TileMapLayer");
+
+        m_grid.Load(width, height, tileSet->GetTileCount(), tiles);
+        m_tileSet = tileSet;
+        ResetVertexBuffers();
+    }
+
+    void SetTile(int x, int y, uint16_t tile) { m_grid.SetTile(x, y, tile); }
+    uint16_t GetTile(int x, int y) const noexcept { return m_grid.GetTile(x, y); }
+
+    void SetScrollFactor(float x, float y) noexcept { m_scrollFactor.x = x; m_scrollFactor.y = y; }
+    void SetOffset(float x, float y) noexcept { m_offset.x = x; m_offset.y = y; }
+
+    // Draws the chunks which intersect the view with the effect, input layout, index buffer
+    // and states already set by ParallaxTileMap::Draw. Returns the number of tiles drawn.
+    size_t Draw(ID3D11DeviceContext* context, DirectX::BasicEffect* effect,
+        const DirectX::XMFLOAT2& camera, int screenWidth, int screenHeight)
+    {
+        if (!m_tileSet || m_vertexBuffers.empty())
+            return 0;
+
+        ++m_frame;
+        EvictVertexBuffers();
+
+        const int tileWidth = m_tileSet->GetTileWidth();
+        const int tileHeight = m_tileSet->GetTileHeight();
+        const float chunkWidth = float(tileWidth * ChunkSize);
+        const float chunkHeight = float(tileHeight * ChunkSize);
+
+        const float viewX = TileChunkGrid::GetViewOrigin(camera.x, m_scrollFactor.x, m_offset.x);
+        const float viewY = TileChunkGrid::GetViewOrigin(camera.y, m_scrollFactor.y, m_offset.y);
+
+        const ChunkRange range = m_grid.GetVisibleChunks(viewX, viewY, float(screenWidth), float(screenHeight),
+            tileWidth, tileHeight);
+        if (range.IsEmpty())
+            return 0;
+
+        effect->SetTexture(m_tileSet->GetTexture());
+
+        size_t count = 0;
+        for (int cy = range.y0; cy <= range.y1; ++cy)
+        {
+            for (int cx = range.x0; cx <= range.x1; ++cx)
+            {
+                const size_t tiles = m_grid.GetChunkTileCount(cx, cy);
+                if (!tiles)
+                    continue;
+
+                ID3D11Buffer* vertexBuffer = GetVertexBuffer(context, cx, cy);
+
+                // Whole-pixel chunk origins keep point-sampled tiles from shimmering.
+                const float originX = std::floor(float(cx) * chunkWidth - viewX + 0.5f);
+                const float originY = std::floor(float(cy) * chunkHeight - viewY + 0.5f);
+
+                effect->SetWorld(DirectX::XMMatrixTranslation(originX, originY, 0.f));
+                effect->Apply(context);
+
+                const UINT stride = sizeof(DirectX::VertexPositionTexture);
+                const UINT offset = 0;
+                context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+
+                context->DrawIndexed(UINT(tiles * TileChunkGrid::IndicesPerTile), 0, 0);
+
+                count += tiles;
+            }
+        }
+
+        return count;
+    }
+
+    int GetWidth() const noexcept { return m_grid.GetWidth(); }
+    int GetHeight() const noexcept { return m_grid.GetHeight(); }
+
+private:
+    struct ChunkBuffer
+    {
+        Microsoft::WRL::ComPtr<ID3D11Buffer>    buffer;
+        uint32_t                                lastFrame;
+    };
+
+    void ResetVertexBuffers()
+    {
+        m_vertexBuffers.clear();
+        m_vertexBuffers.resize(size_t(m_grid.GetChunksX()) * size_t(m_grid.GetChunksY()));
+        m_resident.clear();
+        m_frame = 0;
+    }
+
+    // Only the resident list is walked, so the cost follows the chunks around the view
+    // rather than the size of the map.
+    void EvictVertexBuffers() noexcept
+    {
+        for (size_t j = 0; j < m_resident.size(); )
+        {
+            auto& chunk = m_vertexBuffers[m_resident[j]];
+            if (m_frame - chunk.lastFrame > EvictFrames)
+            {
+                chunk.buffer.Reset();
+                m_resident[j] = m_resident.back();
+                m_resident.pop_back();
+            }
+            else
+            {
+                ++j;
+            }
+        }
+    }
+
+    ID3D11Buffer* GetVertexBuffer(ID3D11DeviceContext* context, int cx, int cy)
+    {
+        const size_t index = size_t(cy) * size_t(m_grid.GetChunksX()) + size_t(cx);
+        auto& chunk = m_vertexBuffers[index];
+        auto& buffer = chunk.buffer;
+
+        if (!buffer || m_grid.IsDirty(cx, cy))
+        {
+            const bool resident = (buffer != nullptr);
+
+            m_scratch.clear();
+            m_grid.BuildVertices(cx, cy, m_tileSet->GetLayout(), m_scratch);
+
+            Microsoft::WRL::ComPtr<ID3D11Device> device;
+            context->GetDevice(device.GetAddressOf());
+
+            DX::ThrowIfFailed(
+                DirectX::CreateStaticBuffer(device.Get(),
+                    reinterpret_cast<const DirectX::VertexPositionTexture*>(m_scratch.data()), m_scratch.size(),
+                    D3D11_BIND_VERTEX_BUFFER, buffer.ReleaseAndGetAddressOf()));
+
+            m_grid.ClearDirty(cx, cy);
+
+            if (!resident)
+            {
+                m_resident.push_back(index);
+            }
+        }
+
+        chunk.lastFrame = m_frame;
+        return buffer.Get();
+    }
+
+    const TileSet*                                      m_tileSet;
+    DirectX::XMFLOAT2                                   m_scrollFactor;
+    DirectX::XMFLOAT2                                   m_offset;
+    TileChunkGrid                                       m_grid;
+    std::vector<ChunkBuffer>                            m_vertexBuffers;
+    std::vector<size_t>                                 m_resident;
+    uint32_t                                            m_frame;
+    std::vector<TileVertex>                             m_scratch;
+};
+
+
+class ParallaxTileMap
+{
+public:
+    ParallaxTileMap() noexcept :
+        m_screenWidth(0),
+        m_screenHeight(0),
+        m_camera{},
+        m_tileCount(0)
+    {
+    }
+
+    ParallaxTileMap(ParallaxTileMap&&) = default;
+    ParallaxTileMap& operator= (ParallaxTileMap&&) = default;
+
+    ParallaxTileMap(ParallaxTileMap const&) = delete;
+    ParallaxTileMap& operator= (ParallaxTileMap const&) = delete;
+
+    void CreateDeviceResources(ID3D11Device* device)
+    {
+        m_states = std::make_unique<DirectX::CommonStates>(device);
+
+        m_effect = std::make_unique<DirectX::BasicEffect>(device);
+        m_effect->SetTextureEnabled(true);
+        m_effect->SetView(DirectX::XMMatrixIdentity());
+
+        DX::ThrowIfFailed(
+            DirectX::CreateInputLayoutFromEffect<DirectX::VertexPositionTexture>(device,
+                m_effect.get(), m_inputLayout.ReleaseAndGetAddressOf()));
+
+        const auto indices = TileChunkGrid::BuildIndices();
+
+        DX::ThrowIfFailed(
+            DirectX::CreateStaticBuffer(device, indices.data(), indices.size(),
+                D3D11_BIND_INDEX_BUFFER, m_indexBuffer.ReleaseAndGetAddressOf()));
+    }
+
+    // Layers are drawn in the order they are added (back to front). The returned
+    // reference is invalidated by the next call to AddLayer.
+    TileMapLayer& AddLayer(float scrollFactorX, float scrollFactorY)
+    {
+        m_layers.emplace_back();
+        TileMapLayer& layer = m_layers.back();
+        layer.SetScrollFactor(scrollFactorX, scrollFactorY);
+        return layer;
+    }
+
+    TileMapLayer& GetLayer(size_t index) { return m_layers.at(index); }
+    size_t GetLayerCount() const noexcept { return m_layers.size(); }
+
+    void SetWindow(int screenWidth, int screenHeight) noexcept
+    {
+        m_screenWidth = screenWidth;
+        m_screenHeight = screenHeight;
+    }
+
+    void SetCamera(const DirectX::XMFLOAT2& camera) noexcept { m_camera = camera; }
+    const DirectX::XMFLOAT2& GetCamera() const noexcept { return m_camera; }
+
+    void Update(float deltaX, float deltaY) noexcept
+    {
+        m_camera.x += deltaX;
+        m_camera.y += deltaY;
+    }
+
+    // Draws outside of any SpriteBatch Begin/End; sprites drawn afterwards appear on top.
+    void Draw(ID3D11DeviceContext* context)
+    {
+        m_tileCount = 0;
+
+        if (!m_effect || m_screenWidth <= 0 || m_screenHeight <= 0)
+            return;
+
+        m_effect->SetProjection(DirectX::XMMatrixOrthographicOffCenterRH(
+            0.f, float(m_screenWidth), float(m_screenHeight), 0.f, 0.f, 1.f));
+
+        context->OMSetBlendState(m_states->NonPremultiplied(), nullptr, 0xFFFFFFFF);
+        context->OMSetDepthStencilState(m_states->DepthNone(), 0);
+        context->RSSetState(m_states->CullNone());
+
+        ID3D11SamplerState* sampler = m_states->PointClamp();
+        context->PSSetSamplers(0, 1, &sampler);
+
+        context->IASetInputLayout(m_inputLayout.Get());
+        context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        context->IASetIndexBuffer(m_indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+
+        for (auto& layer : m_layers)
+        {
+            m_tileCount += layer.Draw(context, m_effect.get(), m_camera, m_screenWidth, m_screenHeight);
+        }
+    }
+
+    // Number of tiles drawn by the last Draw.
+    size_t GetTileCount() const noexcept { return m_tileCount; }
+
+private:
+    int                                                 m_screenWidth;
+    int                                                 m_screenHeight;
+    DirectX::XMFLOAT2                                   m_camera;
+    size_t                                              m_tileCount;
+    std::vector<TileMapLayer>                           m_layers;
+
+    std::unique_ptr<DirectX::CommonStates>              m_states;
+    std::unique_ptr<DirectX::BasicEffect>               m_effect;
+    Microsoft::WRL::ComPtr<ID3D11InputLayout>           m_inputLayout;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>                m_indexBuffer;
+};
@@ -0,0 +1,462 @@
+//--------------------------------------------------------------------------------------
+// File: TileMapCheck.cpp
+//
+// Checks TileChunks.h, the storage and view math behind TileMap.h: Load and SetTile give
+// identical chunks and mark edited chunks dirty, GetVisibleChunks matches a brute-force
+// overlap test for random cameras, parallax scroll factors and offsets (and is empty for
+// views far outside the layer or non-finite ones), every on-screen tile falls in the
+// visible range, and chunk vertices and the shared index buffer are exact. Finally a
+// 10000 x 10000 tile layer is loaded and the time to build one screen of chunks is shown.
+//
+// This is a standalone console tool with no Windows or Direct3D dependencies:
+//
+//   g++ -std=c++14 -O2 -I.. -I../../Common -o TileMapCheck TileMapCheck.cpp
+//   cl /std:c++14 /O2 /EHsc /I.. /I..\..\Common TileMapCheck.cpp
+//
+// Pass -nobench to skip the timing.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "TileChunks.h"
+#include "CheckHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    constexpr int c_chunkSize = TileChunkGrid::ChunkSize;
+
+    template<typename Func>
+    bool Throws(Func&& func)
+    {
+        try
+        {
+            func();
+        }
+        catch (const std::exception&)
+        {
+            return true;
+        }
+        return false;
+    }
+
+    bool SameVertices(const std::vector<TileVertex>& a, const std::vector<TileVertex>& b)
+    {
+        return a.size() == b.size()
+            && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(TileVertex)) == 0);
+    }
+
+    void CheckStorage()
+    {
+        constexpr int width = 200;
+        constexpr int height = 150;
+        constexpr size_t tileCount = 20;
+
+        const TileSetLayout tileSet = TileSetLayout::Create(80, 64, 16, 16);
+
+        std::mt19937 rng(12345);
+        std::uniform_int_distribution<int> tileDist(0, int(tileCount));
+
+        std::vector<uint16_t> tiles(size_t(width * height));
+        for (auto& it : tiles)
+        {
+            // Roughly half empty so chunks hold sparse tile lists.
+            const int t = tileDist(rng);
+            it = uint16_t((t & 1) ? t : 0);
+        }
+
+        TileChunkGrid loaded;
+        loaded.Load(width, height, tileCount, tiles.data());
+
+        TileChunkGrid edited;
+        edited.Create(width, height, tileCount);
+
+        // Fill in a scrambled order, with overwrites and clears along the way.
+        std::vector<int> order(tiles.size());
+        for (size_t j = 0; j < order.size(); ++j)
+            order[j] = int(j);
+        std::shuffle(order.begin(), order.end(), rng);
+
+        for (int j : order)
+        {
+            edited.SetTile(j % width, j / width, uint16_t(1 + (j % int(tileCount))));
+        }
+        for (int j : order)
+        {
+            edited.SetTile(j % width, j / width, tiles[size_t(j)]);
+        }
+
+        bool sameTiles = true;
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                if (loaded.GetTile(x, y) != tiles[size_t(y * width + x)]
+                    || edited.GetTile(x, y) != tiles[size_t(y * width + x)])
+                    sameTiles = false;
+            }
+        }
+        Check(sameTiles, "Load and SetTile must store the same tiles");
+
+        Check(loaded.GetChunksX() == 7 && loaded.GetChunksY() == 5, "Chunk counts round up");
+
+        bool sameChunks = true;
+        std::vector<TileVertex> a, b;
+        for (int cy = 0; cy < loaded.GetChunksY(); ++cy)
+        {
+            for (int cx = 0; cx < loaded.GetChunksX(); ++cx)
+            {
+                a.clear();
+                b.clear();
+                loaded.BuildVertices(cx, cy, tileSet, a);
+                edited.BuildVertices(cx, cy, tileSet, b);
+                if (!SameVertices(a, b) || a.size() != loaded.GetChunkTileCount(cx, cy) * 4)
+                    sameChunks = false;
+            }
+        }
+        Check(sameChunks, "Load and SetTile must build identical chunk vertices");
+
+        Check(loaded.GetTile(-1, 0) == 0 && loaded.GetTile(0, height) == 0, "GetTile outside the layer is empty");
+
+        // Dirty tracking: new chunks are dirty, and only real edits dirty them again.
+        Check(loaded.IsDirty(0, 0) && loaded.IsDirty(6, 4), "New chunks are dirty");
+        for (int cy = 0; cy < loaded.GetChunksY(); ++cy)
+            for (int cx = 0; cx < loaded.GetChunksX(); ++cx)
+                loaded.ClearDirty(cx, cy);
+
+        loaded.SetTile(40, 70, loaded.GetTile(40, 70));
+        Check(!loaded.IsDirty(1, 2), "Setting a tile to its current id leaves the chunk clean");
+
+        loaded.SetTile(40, 70, uint16_t(loaded.GetTile(40, 70) ? 0 : 1));
+        Check(loaded.IsDirty(1, 2), "Editing a tile dirties its chunk");
+        Check(!loaded.IsDirty(0, 2) && !loaded.IsDirty(1, 1), "Editing a tile leaves other chunks clean");
+
+        // Invalid arguments.
+        Check(Throws([&]() { loaded.SetTile(width, 0, 1); }), "SetTile past the right edge throws");
+        Check(Throws([&]() { loaded.SetTile(0, -1, 1); }), "SetTile above the top throws");
+        Check(Throws([&]() { loaded.SetTile(0, 0, uint16_t(tileCount + 1)); }), "SetTile with an unknown id throws");
+        Check(Throws([&]() { loaded.IsDirty(7, 0); }), "Chunk access out of range throws");
+        Check(Throws([&]() { TileChunkGrid g; g.Create(0, 10, tileCount); }), "Create with no width throws");
+        Check(Throws([&]() { TileChunkGrid g; g.Create(10, 10, 0); }), "Create with no tile set throws");
+        Check(Throws([&]()
+            {
+                std::vector<uint16_t> bad(16, uint16_t(tileCount + 1));
+                TileChunkGrid g;
+                g.Load(4, 4, tileCount, bad.data());
+            }), "Load with an unknown id throws");
+        Check(Throws([&]() { TileSetLayout::Create(8, 8, 16, 16); }), "Tile set smaller than a tile throws");
+        Check(Throws([&]() { TileSetLayout::Create(4096, 4096, 1, 1); }), "Tile set with too many tiles throws");
+        Check(Throws([&]()
+            {
+                std::vector<TileVertex> v;
+                loaded.BuildVertices(0, 0, TileSetLayout::Create(32, 16, 16, 16), v);
+            }), "BuildVertices with a smaller tile set throws");
+    }
+
+    // Distance from 'value' to the nearest chunk edge, to skip cases where float and
+    // double rounding legitimately disagree.
+    double EdgeDistance(double value, double chunk)
+    {
+        const double k = std::floor(value / chunk + 0.5);
+        return std::fabs(value - k * chunk);
+    }
+
+    void CheckVisibleChunks()
+    {
+        std::mt19937 rng(4242);
+
+        const int tileSizes[] = { 16, 24, 13, 32 };
+        const float scrollFactors[] = { 0.f, 0.25f, 0.5f, 1.f, 1.5f };
+
+        std::uniform_real_distribution<float> cameraDist(-6000.f, 24000.f);
+        std::uniform_real_distribution<float> offsetDist(-800.f, 800.f);
+        std::uniform_real_distribution<float> viewDist(1.f, 2500.f);
+        std::uniform_int_distribution<int> sizeDist(1, 400);
+
+        size_t mismatches = 0;
+        size_t missing = 0;
+        size_t tested = 0;
+        size_t empty = 0;
+
+        for (int trial = 0; trial < 400; ++trial)
+        {
+            const int width = sizeDist(rng);
+            const int height = sizeDist(rng);
+
+            TileChunkGrid grid;
+            grid.Create(width, height, 1);
+
+            const int tileWidth = tileSizes[trial % 4];
+            const int tileHeight = tileSizes[(trial / 4) % 4];
+            const double chunkWidth = double(tileWidth) * c_chunkSize;
+            const double chunkHeight = double(tileHeight) * c_chunkSize;
+
+            for (int view = 0; view < 50; ++view)
+            {
+                const float scrollX = scrollFactors[size_t(view) % 5];
+                const float scrollY = scrollFactors[size_t(view / 5) % 5];
+
+                const float viewX = TileChunkGrid::GetViewOrigin(cameraDist(rng), scrollX, offsetDist(rng));
+                const float viewY = TileChunkGrid::GetViewOrigin(cameraDist(rng) * 0.25f, scrollY, offsetDist(rng));
+                const float viewWidth = viewDist(rng);
+                const float viewHeight = viewDist(rng);
+
+                if (EdgeDistance(viewX, chunkWidth) < 1e-2 || EdgeDistance(double(viewX) + viewWidth, chunkWidth) < 1e-2
+                    || EdgeDistance(viewY, chunkHeight) < 1e-2 || EdgeDistance(double(viewY) + viewHeight, chunkHeight) < 1e-2)
+                    continue;
+
+                const ChunkRange range = grid.GetVisibleChunks(viewX, viewY, viewWidth, viewHeight, tileWidth, tileHeight);
+                ++tested;
+                if (range.IsEmpty())
+                    ++empty;
+
+                for (int cy = 0; cy < grid.GetChunksY(); ++cy)
+                {
+                    for (int cx = 0; cx < grid.GetChunksX(); ++cx)
+                    {
+                        const bool overlaps = double(cx) * chunkWidth < double(viewX) + viewWidth
+                            && double(cx + 1) * chunkWidth > viewX
+                            && double(cy) * chunkHeight < double(viewY) + viewHeight
+                            && double(cy + 1) * chunkHeight > viewY;
+
+                        const bool inRange = !range.IsEmpty()
+                            && cx >= range.x0 && cx <= range.x1 && cy >= range.y0 && cy <= range.y1;
+
+                        if (overlaps != inRange)
+                            ++mismatches;
+                    }
+                }
+
+                // Every tile that lands on screen must come from a chunk in the range.
+                for (int sample = 0; sample < 16; ++sample)
+                {
+                    const float sx = viewWidth * float(sample % 4) / 4.f;
+                    const float sy = viewHeight * float(sample / 4) / 4.f;
+                    const int tx = int(std::floor((viewX + sx) / float(tileWidth)));
+                    const int ty = int(std::floor((viewY + sy) / float(tileHeight)));
+                    if (tx < 0 || ty < 0 || tx >= width || ty >= height)
+                        continue;
+
+                    const int cx = tx / c_chunkSize;
+                    const int cy = ty / c_chunkSize;
+                    if (range.IsEmpty() || cx < range.x0 || cx > range.x1 || cy < range.y0 || cy > range.y1)
+                        ++missing;
+                }
+            }
+        }
+
+        if (mismatches)
+            Fail("GetVisibleChunks disagrees with the brute-force overlap test for %zu chunks", mismatches);
+        if (missing)
+            Fail("%zu on-screen tiles fall outside the visible chunk range", missing);
+        Check(tested > 15000 && empty > 0 && empty < tested, "Visible chunk test covers both empty and non-empty views");
+
+        // Views far outside the layer, and non-finite ones, are empty without overflowing the casts.
+        TileChunkGrid grid;
+        grid.Create(100, 100, 1);
+
+        const float inf = std::numeric_limits<float>::infinity();
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        const float extremes[][4] =
+        {
+            { 1e30f, 0.f, 800.f, 600.f },
+            { -1e30f, 0.f, 800.f, 600.f },
+            { 0.f, 3e38f, 800.f, 600.f },
+            { -3e38f, -3e38f, 800.f, 600.f },
+            { inf, 0.f, 800.f, 600.f },
+            { 0.f, -inf, 800.f, 600.f },
+            { nan, 0.f, 800.f, 600.f },
+            { 0.f, 0.f, nan, 600.f },
+            { 0.f, 0.f, 800.f, 0.f },
+            { 0.f, 0.f, -800.f, 600.f },
+        };
+        bool extremesEmpty = true;
+        for (const auto& it : extremes)
+        {
+            if (!grid.GetVisibleChunks(it[0], it[1], it[2], it[3], 16, 16).IsEmpty())
+                extremesEmpty = false;
+        }
+        Check(extremesEmpty, "Views far outside the layer or non-finite are empty");
+
+        // A huge view from far away covers the whole layer.
+        const ChunkRange all = grid.GetVisibleChunks(-1e30f, -1e30f, 3e30f, 3e30f, 16, 16);
+        Check(all.x0 == 0 && all.y0 == 0 && all.x1 == grid.GetChunksX() - 1 && all.y1 == grid.GetChunksY() - 1,
+            "A view larger than the layer covers every chunk");
+
+        // Exact chunk edges: a view ending on an edge excludes the next chunk, one starting on it
+        // excludes the previous one.
+        const ChunkRange edge = grid.GetVisibleChunks(512.f, 0.f, 512.f, 512.f, 16, 16);
+        Check(edge.x0 == 1 && edge.x1 == 1 && edge.y0 == 0 && edge.y1 == 0, "Views on chunk edges cover one chunk");
+    }
+
+    void CheckParallax()
+    {
+        // A layer with scroll factor s moves s pixels per camera pixel, and the offset shifts
+        // it on screen.
+        const float cameras[] = { 0.f, 100.f, 1234.5f, -640.f };
+        const float scrolls[] = { 0.f, 0.5f, 1.f, 2.f };
+
+        bool exact = true;
+        for (float camera : cameras)
+        {
+            for (float scroll : scrolls)
+            {
+                const float viewX = TileChunkGrid::GetViewOrigin(camera, scroll, 40.f);
+                const float screenX = 320.f - viewX;
+                if (screenX != 320.f + 40.f - camera * scroll)
+                    exact = false;
+
+                const float moved = TileChunkGrid::GetViewOrigin(camera + 10.f, scroll, 40.f);
+                if (moved - viewX != 10.f * scroll)
+                    exact = false;
+            }
+        }
+        Check(exact, "Parallax view origins follow camera * scroll - offset");
+
+        // With a scroll factor of 0 the layer never leaves the view.
+        TileChunkGrid grid;
+        grid.Create(64, 64, 1);
+        const float viewX = TileChunkGrid::GetViewOrigin(1e9f, 0.f, 0.f);
+        const ChunkRange range = grid.GetVisibleChunks(viewX, 0.f, 800.f, 600.f, 16, 16);
+        Check(range.x0 == 0 && range.x1 == 1 && range.y0 == 0 && range.y1 == 1, "Scroll factor 0 pins the layer");
+    }
+
+    void CheckVertices()
+    {
+        // 4 x 2 tiles of 16 x 8 in a 64 x 16 texture.
+        const TileSetLayout tileSet = TileSetLayout::Create(64, 16, 16, 8);
+        Check(tileSet.columns == 4 && tileSet.rows == 2 && tileSet.GetTileCount() == 8, "Tile set layout");
+
+        TileChunkGrid grid;
+        grid.Create(40, 40, tileSet.GetTileCount());
+        grid.SetTile(3, 5, 6);
+        grid.SetTile(1, 5, 1);
+        grid.SetTile(33, 34, 8);
+
+        std::vector<TileVertex> vertices;
+        grid.BuildVertices(0, 0, tileSet, vertices);
+
+        // Row-major order: (1, 5) then (3, 5).
+        const TileVertex expected[] =
+        {
+            { 16.f, 40.f, 0.f, 0.f, 0.f },
+            { 32.f, 40.f, 0.f, 0.25f, 0.f },
+            { 16.f, 48.f, 0.f, 0.f, 0.5f },
+            { 32.f, 48.f, 0.f, 0.25f, 0.5f },
+
+            { 48.f, 40.f, 0.f, 0.25f, 0.5f },
+            { 64.f, 40.f, 0.f, 0.5f, 0.5f },
+            { 48.f, 48.f, 0.f, 0.25f, 1.f },
+            { 64.f, 48.f, 0.f, 0.5f, 1.f },
+        };
+        Check(SameVertices(vertices, std::vector<TileVertex>(std::begin(expected), std::end(expected))),
+            "Chunk vertices have exact positions and texture coordinates");
+
+        // Chunk-local positions: tile (33, 34) is (1, 2) in chunk (1, 1).
+        vertices.clear();
+        grid.BuildVertices(1, 1, tileSet, vertices);
+        Check(vertices.size() == 4
+            && vertices[0].x == 16.f && vertices[0].y == 16.f && vertices[3].x == 32.f && vertices[3].y == 24.f
+            && vertices[0].u == 0.75f && vertices[0].v == 0.5f && vertices[3].u == 1.f && vertices[3].v == 1.f,
+            "Chunk vertices are relative to the chunk corner");
+
+        vertices.clear();
+        grid.BuildVertices(1, 0, tileSet, vertices);
+        Check(vertices.empty(), "Empty chunks build no vertices");
+
+        // The shared index buffer covers a full chunk with two triangles per tile.
+        const auto indices = TileChunkGrid::BuildIndices();
+        bool indicesOk = indices.size() == size_t(c_chunkSize * c_chunkSize * 6);
+        for (size_t j = 0; indicesOk && j < indices.size(); j += 6)
+        {
+            const auto base = uint16_t(j / 6 * 4);
+            indicesOk = indices[j] == base && indices[j + 1] == base + 1 && indices[j + 2] == base + 2
+                && indices[j + 3] == base + 1 && indices[j + 4] == base + 3 && indices[j + 5] == base + 2;
+        }
+        Check(indicesOk, "Shared index buffer has two triangles per tile");
+        Check(indices.back() == uint16_t(c_chunkSize * c_chunkSize * 4 - 2), "Shared index buffer fits 16-bit indices");
+        Check(Throws([]() { TileChunkGrid::BuildIndices(16385); }), "Too many tiles for 16-bit indices throws");
+    }
+
+    void CheckLargeMap(bool bench)
+    {
+        constexpr int size = 10000;
+        constexpr int screenWidth = 1920;
+        constexpr int screenHeight = 1080;
+
+        const TileSetLayout tileSet = TileSetLayout::Create(256, 256, 16, 16);
+
+        std::vector<uint16_t> tiles(size_t(size) * size_t(size));
+        for (size_t j = 0; j < tiles.size(); ++j)
+        {
+            tiles[j] = uint16_t(1 + (j * 2654435761u >> 8) % tileSet.GetTileCount());
+        }
+
+        TileChunkGrid grid;
+        grid.Load(size, size, tileSet.GetTileCount(), tiles.data());
+        tiles.clear();
+        tiles.shrink_to_fit();
+
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> cameraDist(-1000.f, float(size * 16));
+
+        const size_t maxChunks = size_t((screenWidth + 511) / 512 + 1) * size_t((screenHeight + 511) / 512 + 1);
+
+        bool bounded = true;
+        std::vector<TileVertex> vertices;
+        double buildTime = 0.0;
+        size_t builds = 0;
+        for (int j = 0; j < 200; ++j)
+        {
+            const ChunkRange range = grid.GetVisibleChunks(cameraDist(rng), cameraDist(rng),
+                float(screenWidth), float(screenHeight), 16, 16);
+            if (range.GetCount() > maxChunks)
+                bounded = false;
+
+            if (range.IsEmpty())
+                continue;
+
+            const auto start = std::chrono::high_resolution_clock::now();
+            vertices.clear();
+            for (int cy = range.y0; cy <= range.y1; ++cy)
+                for (int cx = range.x0; cx <= range.x1; ++cx)
+                    grid.BuildVertices(cx, cy, tileSet, vertices);
+            buildTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            ++builds;
+        }
+        Check(bounded, "Visible chunks on a 10000 x 10000 layer are bounded by the view size");
+
+        if (bench && builds)
+        {
+            printf("10000 x 10000 tiles: at most %zu chunks in a %d x %d view, %.3f ms to build a full view of vertices\n",
+                maxChunks, screenWidth, screenHeight, buildTime / double(builds));
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const bool bench = !(argc > 1 && strcmp(argv[1], "-nobench") == 0);
+
+    return RunChecks([&]()
+    {
+        CheckStorage();
+        CheckVisibleChunks();
+        CheckParallax();
+        CheckVertices();
+        CheckLargeMap(bench);
+    });
+}
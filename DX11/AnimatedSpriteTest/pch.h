@@ -47,9 +47,11 @@
 #include <exception>
 #include <iterator>
 #include <memory>
+#include <random>
 #include <stdexcept>
 #include <system_error>
 #include <tuple>
+#include <vector>
 
 #ifdef _DEBUG
 #include <dxgidebug.h>
@@ -0,0 +1,871 @@
+//--------------------------------------------------------------------------------------
+// File: BoundingVolumeHierarchy.h
+//
+// A bounding volume hierarchy over axis-aligned boxes, for frustum culling and ray casts.
+//
+// This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define BOUNDINGVOLUMEHIERARCHY_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "Frustum.h"
+#include "ParallelFor.h"
+
+namespace DX
+{
+    struct AxisAlignedBox
+    {
+        float minimum[3];
+        float maximum[3];
+
+        // Grows to contain anything.
+        static AxisAlignedBox Empty() noexcept
+        {
+            const float infinity = std::numeric_limits<float>::infinity();
+            return { { infinity, infinity, infinity }, { -infinity, -infinity, -infinity } };
+        }
+
+        static AxisAlignedBox FromCenterExtents(const float center[3], const float extents[3]) noexcept
+        {
+            AxisAlignedBox box;
+            for (size_t j = 0; j < 3; ++j)
+            {
+                box.minimum[j] = center[j] - extents[j];
+                box.maximum[j] = center[j] + extents[j];
+            }
+            return box;
+        }
+
+        bool IsValid() const noexcept
+        {
+            return minimum[0] <= maximum[0] && minimum[1] <= maximum[1] && minimum[2] <= maximum[2];
+        }
+
+        void Grow(const AxisAlignedBox& box) noexcept
+        {
+            for (size_t j = 0; j < 3; ++j)
+            {
+                minimum[j] = std::min(minimum[j], box.minimum[j]);
+                maximum[j] = std::max(maximum[j], box.maximum[j]);
+            }
+        }
+
+        void Grow(const float point[3]) noexcept
+        {
+            for (size_t j = 0; j < 3; ++j)
+            {
+                minimum[j] = std::min(minimum[j], point[j]);
+                maximum[j] = std::max(maximum[j], point[j]);
+            }
+        }
+
+        // Half the surface area, which is all the heuristic needs; 0 when empty.
+        float HalfArea() const noexcept
+        {
+            if (!IsValid())
+                return 0.f;
+
+            const float dx = maximum[0] - minimum[0];
+            const float dy = maximum[1] - minimum[1];
+            const float dz = maximum[2] - minimum[2];
+            return dx * dy + dy * dz + dz * dx;
+        }
+
+        // False only when the box is entirely outside one of the planes. Tests the corner
+        // furthest along each plane's normal, as the node tests do.
+        bool IntersectsFrustum(const Frustum& frustum) const noexcept
+        {
+            for (const auto& plane : frustum.planes)
+            {
+                const float x = (plane[0] >= 0.f) ? maximum[0] : minimum[0];
+                const float y = (plane[1] >= 0.f) ? maximum[1] : minimum[1];
+                const float z = (plane[2] >= 0.f) ? maximum[2] : minimum[2];
+                if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0.f)
+                    return false;
+            }
+            return true;
+        }
+
+        // Slab test of the ray origin + t * direction for t in [0, distance], given the
+        // reciprocal of the direction; entry receives where the ray enters.
+        bool IntersectsRay(const float origin[3], const float inverseDirection[3], float distance, float& entry) const noexcept
+        {
+            float enter = 0.f;
+            float leave = distance;
+            for (size_t j = 0; j < 3; ++j)
+            {
+                const float t0 = (minimum[j] - origin[j]) * inverseDirection[j];
+                const float t1 = (maximum[j] - origin[j]) * inverseDirection[j];
+                enter = Max(enter, Min(t0, t1));
+                leave = Min(leave, Max(t0, t1));
+            }
+            entry = enter;
+            return enter <= leave;
+        }
+
+        // _mm_min_ps and _mm_max_ps semantics, so that the scalar and SIMD slab tests
+        // treat a NaN from 0 * infinity alike.
+        static float Min(float a, float b) noexcept { return (a < b) ? a : b; }
+        static float Max(float a, float b) noexcept { return (a > b) ? a : b; }
+    };
+
+    class BoundingVolumeHierarchy
+    {
+    public:
+        // Most boxes the heuristic may leave in one leaf.
+        static constexpr size_t MaxLeafSize = 4;
+
+        // Raycast's result when nothing is hit.
+        static constexpr uint32_t Miss = UINT32_MAX;
+
+        explicit BoundingVolumeHierarchy(WorkerPool* pool = nullptr) noexcept :
+            m_pool(pool)
+        {
+        }
+
+        BoundingVolumeHierarchy(BoundingVolumeHierarchy&&) = default;
+        BoundingVolumeHierarchy& operator= (BoundingVolumeHierarchy&&) = default;
+
+        BoundingVolumeHierarchy(BoundingVolumeHierarchy const&) = default;
+        BoundingVolumeHierarchy& operator= (BoundingVolumeHierarchy const&) = default;
+
+        // Builds the tree over count boxes; box j is reported as index j. The binary tree is
+        // split with the surface area heuristic over binned box centers, its subtrees below
+        // the top few levels built in parallel on the WorkerPool, then collapsed into
+        // four-wide nodes.
+        void Build(const AxisAlignedBox* boxes, size_t count)
+        {
+            if (count > INT32_MAX)
+                throw std::invalid_argument("Too many boxes");
+
+            if (count && !boxes)
+                throw std::invalid_argument("Boxes must not be null");
+
+            for (size_t j = 0; j < count; ++j)
+            {
+                if (!boxes[j].IsValid())
+                    throw std::invalid_argument("Box minimum exceeds maximum");
+            }
+
+            m_boxes.assign(boxes, boxes + count);
+            m_nodes.clear();
+            m_indices.resize(count);
+            m_centers.resize(count * 3);
+            for (size_t j = 0; j < count; ++j)
+            {
+                m_indices[j] = uint32_t(j);
+                for (size_t axis = 0; axis < 3; ++axis)
+                {
+                    m_centers[j * 3 + axis] = (boxes[j].minimum[axis] + boxes[j].maximum[axis]) * 0.5f;
+                }
+            }
+
+            if (!count)
+                return;
+
+            // The top of the tree is split here until the ranges are small enough to hand out
+            // one per task; each task then builds its subtree into its own array.
+            const size_t threads = m_pool ? m_pool->GetThreadCount() : 1;
+            const size_t taskSize = std::max(size_t(c_minTaskSize), count / (threads * 4));
+
+            Subtrees trees;
+            std::vector<Task> tasks;
+            trees.top.reserve(count / MaxLeafSize * 2 + 1);
+            Subdivide(trees.top, 0, uint32_t(count), 0, (threads > 1) ? &tasks : nullptr, taskSize);
+
+            trees.tasks.resize(tasks.size());
+            auto build = [&](size_t begin, size_t end, size_t)
+            {
+                for (size_t j = begin; j < end; ++j)
+                {
+                    trees.tasks[j].reserve(tasks[j].count / MaxLeafSize * 2 + 1);
+                    Subdivide(trees.tasks[j], tasks[j].first, tasks[j].count, tasks[j].depth, nullptr, 0);
+                }
+            };
+
+            if (!tasks.empty())
+            {
+                m_pool->Run(tasks.size(), 1, build);
+            }
+
+            m_nodes.reserve(count / 2 + 1);
+            Collapse(trees, Resolve(trees, &trees.top, 0));
+        }
+
+        // Replaces the box of an object; call Refit once all have been updated. A refitted
+        // tree gets slower as objects drift from where they were when it was built; Build
+        // again after large changes.
+        void Update(size_t index, const AxisAlignedBox& box)
+        {
+            if (index >= m_boxes.size())
+                throw std::out_of_range("Index out of range");
+
+            if (!box.IsValid())
+                throw std::invalid_argument("Box minimum exceeds maximum");
+
+            m_boxes[index] = box;
+        }
+
+        // Recomputes every node box from the current object boxes. Children follow their
+        // parents in the array, so one pass from the end sees each child before its parent.
+        void Refit() noexcept
+        {
+            for (size_t j = m_nodes.size(); j-- > 0;)
+            {
+                Node& node = m_nodes[j];
+                for (size_t k = 0; k < 4; ++k)
+                {
+                    if (!node.count[k])
+                        continue;
+
+                    AxisAlignedBox box = AxisAlignedBox::Empty();
+                    if (node.child[k] == c_leaf)
+                    {
+                        for (uint32_t i = node.first[k]; i < node.first[k] + node.count[k]; ++i)
+                        {
+                            box.Grow(m_boxes[m_indices[i]]);
+                        }
+                    }
+                    else
+                    {
+                        box = GetNodeBox(m_nodes[node.child[k]]);
+                    }
+                    SetChildBox(node, k, box);
+                }
+            }
+        }
+
+        size_t GetCount() const noexcept { return m_boxes.size(); }
+
+        size_t GetNodeCount() const noexcept { return m_nodes.size(); }
+
+        const AxisAlignedBox& GetBox(size_t index) const { return m_boxes.at(index); }
+
+        // The box around everything; empty when there is nothing.
+        AxisAlignedBox GetBounds() const noexcept
+        {
+            return m_nodes.empty() ? AxisAlignedBox::Empty() : GetNodeBox(m_nodes[0]);
+        }
+
+        // Writes the indices of the boxes that intersect the frustum to visible, which must
+        // have room for GetCount(), in tree order. Returns how many there are. The result is
+        // exactly the boxes for which AxisAlignedBox::IntersectsFrustum is true. A child
+        // entirely inside the frustum is emitted without being visited.
+        size_t CullFrustum(const Frustum& frustum, uint32_t* visible) const noexcept
+        {
+            if (m_nodes.empty())
+                return 0;
+
+            uint32_t stack[c_stackSize];
+            size_t top = 0;
+            stack[top++] = 0;
+
+            uint32_t* out = visible;
+            while (top)
+            {
+                const Node& node = m_nodes[stack[--top]];
+
+                unsigned intersects;
+                unsigned inside;
+                TestFrustum(node, frustum, intersects, inside);
+
+                for (size_t k = 0; intersects; ++k, intersects >>= 1, inside >>= 1)
+                {
+                    if (!(intersects & 1))
+                        continue;
+
+                    if (inside & 1)
+                    {
+                        // The whole subtree, without visiting it.
+                        memcpy(out, m_indices.data() + node.first[k], node.count[k] * sizeof(uint32_t));
+                        out += node.count[k];
+                    }
+                    else if (node.child[k] == c_leaf)
+                    {
+                        for (uint32_t i = node.first[k]; i < node.first[k] + node.count[k]; ++i)
+                        {
+                            const uint32_t index = m_indices[i];
+                            if (m_boxes[index].IntersectsFrustum(frustum))
+                            {
+                                *out++ = index;
+                            }
+                        }
+                    }
+                    else
+                    {
+                        stack[top++] = node.child[k];
+                    }
+                }
+            }
+
+            return size_t(out - visible);
+        }
+
+        // Casts the ray origin + t * direction for t in [0, distance]. For each object whose
+        // box the ray enters before distance, intersect(index, distance) tests the object
+        // itself and, on a hit, lowers distance to it and returns true. Nodes are visited
+        // nearest first. Returns the index of the nearest hit, with distance set to it, or
+        // Miss with distance unchanged.
+        template<typename Intersect>
+        uint32_t Raycast(const float origin[3], const float direction[3], float& distance, Intersect&& intersect) const
+        {
+            uint32_t hit = Miss;
+            if (m_nodes.empty())
+                return hit;
+
+            const float inverse[3] = { 1.f / direction[0], 1.f / direction[1], 1.f / direction[2] };
+
+            struct Entry
+            {
+                uint32_t node;
+                float enter;
+            };
+
+            Entry stack[c_stackSize];
+            size_t top = 0;
+            stack[top++] = { 0, 0.f };
+
+            while (top)
+            {
+                const Entry entry = stack[--top];
+                if (entry.enter > distance)
+                    continue;
+
+                const Node& node = m_nodes[entry.node];
+
+                float nears[4];
+                unsigned hits = TestRay(node, origin, inverse, distance, nears);
+
+                // Leaves are tested right away; nodes are pushed far to near.
+                size_t order[4];
+                size_t pending = 0;
+                for (size_t k = 0; hits; ++k, hits >>= 1)
+                {
+                    if (!(hits & 1))
+                        continue;
+
+                    if (node.child[k] != c_leaf)
+                    {
+                        size_t slot = pending++;
+                        for (; slot > 0 && nears[order[slot - 1]] < nears[k]; --slot)
+                        {
+                            order[slot] = order[slot - 1];
+                        }
+                        order[slot] = k;
+                    }
+                    else if (nears[k] <= distance)
+                    {
+                        for (uint32_t i = node.first[k]; i < node.first[k] + node.count[k]; ++i)
+                        {
+                            const uint32_t index = m_indices[i];
+                            if (intersect(index, distance))
+                            {
+                                hit = index;
+                            }
+                        }
+                    }
+                }
+
+                for (size_t j = 0; j < pending; ++j)
+                {
+                    stack[top++] = { node.child[order[j]], nears[order[j]] };
+                }
+            }
+
+            return hit;
+        }
+
+        // As above, with the boxes themselves as the objects.
+        uint32_t Raycast(const float origin[3], const float direction[3], float& distance) const
+        {
+            const float inverse[3] = { 1.f / direction[0], 1.f / direction[1], 1.f / direction[2] };
+            return Raycast(origin, direction, distance, [&](uint32_t index, float& nearest) -> bool
+            {
+                float enter;
+                if (!m_boxes[index].IntersectsRay(origin, inverse, nearest, enter) || enter >= nearest)
+                    return false;
+
+                nearest = enter;
+                return true;
+            });
+        }
+
+    private:
+        // Child value of a leaf. The root is never a child, so 0 would do, but this is clearer.
+        static constexpr uint32_t c_leaf = UINT32_MAX;
+
+        // Left value of a binary node whose subtree is built by task number right.
+        static constexpr uint32_t c_task = UINT32_MAX - 1;
+
+        // Centers are sorted into this many bins per axis to evaluate splits.
+        static constexpr size_t c_bins = 16;
+
+        // Below this depth splits fall back to the median, which bounds the depth of the
+        // tree, and so the traversal stacks, at c_maxSahDepth + 32 for 2^32 boxes. Each
+        // node visited adds at most three entries.
+        static constexpr size_t c_maxSahDepth = 48;
+        static constexpr size_t c_stackSize = 256;
+
+        // Subtrees smaller than this are not worth a task of their own.
+        static constexpr size_t c_minTaskSize = 4096;
+
+        // Four children, their boxes as structures of arrays so that one frustum plane or one
+        // ray slab is tested against all four at once with SSE2; empty slots have a count of
+        // 0. Nodes sit in a single array, each ahead of its descendants, and the boxes under
+        // any child are a contiguous range of m_indices.
+        struct alignas(16) Node
+        {
+            float       minX[4];
+            float       minY[4];
+            float       minZ[4];
+            float       maxX[4];
+            float       maxY[4];
+            float       maxZ[4];
+            uint32_t    child[4];   // node index, or c_leaf
+            uint32_t    first[4];   // objects under the child: m_indices[first, first + count)
+            uint32_t    count[4];
+        };
+
+        static_assert(sizeof(Node) == 144, "Node layout");
+
+        struct BuildNode
+        {
+            AxisAlignedBox  box;
+            uint32_t        left;   // node index, c_leaf or c_task
+            uint32_t        right;
+            uint32_t        first;
+            uint32_t        count;
+        };
+
+        struct Task
+        {
+            uint32_t    first;
+            uint32_t    count;
+            size_t      depth;
+        };
+
+        struct Subtrees
+        {
+            std::vector<BuildNode>              top;
+            std::vector<std::vector<BuildNode>> tasks;
+        };
+
+        // A binary node in one of the arrays of a Subtrees.
+        struct BuildRef
+        {
+            const std::vector<BuildNode>*   nodes;
+            uint32_t                        index;
+
+            const BuildNode& Get() const noexcept { return (*nodes)[index]; }
+        };
+
+        static BuildRef Resolve(const Subtrees& trees, const std::vector<BuildNode>* nodes, uint32_t index) noexcept
+        {
+            const BuildNode& node = (*nodes)[index];
+            if (node.left == c_task)
+                return { &trees.tasks[node.right], 0 };
+
+            return { nodes, index };
+        }
+
+        // Appends the binary subtree over m_indices[first, first + count) to nodes and
+        // returns the index of its root. With tasks, ranges of up to taskSize are left to a
+        // task instead.
+        uint32_t Subdivide(std::vector<BuildNode>& nodes, uint32_t first, uint32_t count, size_t depth,
+            std::vector<Task>* tasks, size_t taskSize)
+        {
+            const auto index = uint32_t(nodes.size());
+            nodes.emplace_back();
+
+            BuildNode node = {};
+            node.first = first;
+            node.count = count;
+            node.box = AxisAlignedBox::Empty();
+            AxisAlignedBox centers = AxisAlignedBox::Empty();
+            for (uint32_t j = first; j < first + count; ++j)
+            {
+                const uint32_t object = m_indices[j];
+                node.box.Grow(m_boxes[object]);
+                centers.Grow(&m_centers[size_t(object) * 3]);
+            }
+
+            uint32_t middle = 0;
+            if (tasks && count <= taskSize)
+            {
+                node.left = c_task;
+                node.right = uint32_t(tasks->size());
+                tasks->push_back({ first, count, depth });
+            }
+            else if (!Split(first, count, depth, node.box, centers, middle))
+            {
+                node.left = c_leaf;
+                node.right = c_leaf;
+            }
+            else
+            {
+                node.left = Subdivide(nodes, first, middle - first, depth + 1, tasks, taskSize);
+                node.right = Subdivide(nodes, middle, first + count - middle, depth + 1, tasks, taskSize);
+            }
+
+            nodes[index] = node;
+            return index;
+        }
+
+        // Partitions m_indices[first, first + count) at middle, or returns false when it is
+        // cheaper as a leaf. Splits are evaluated along the axis where the centers spread
+        // the most, which is nearly always where the best split is, for a third of the work.
+        bool Split(uint32_t first, uint32_t count, size_t depth, const AxisAlignedBox& box, const AxisAlignedBox& centers,
+            uint32_t& middle)
+        {
+            if (count <= 1)
+                return false;
+
+            size_t widest = 0;
+            for (size_t axis = 1; axis < 3; ++axis)
+            {
+                if (centers.maximum[axis] - centers.minimum[axis] > centers.maximum[widest] - centers.minimum[widest])
+                {
+                    widest = axis;
+                }
+            }
+
+            auto begin = m_indices.begin() + first;
+            auto end = begin + count;
+
+            if (!(centers.maximum[widest] > centers.minimum[widest]))
+            {
+                // All centers coincide: no split separates them, so just halve the range.
+                if (count <= MaxLeafSize)
+                    return false;
+
+                middle = first + count / 2;
+                return true;
+            }
+
+            if (depth >= c_maxSahDepth)
+            {
+                middle = first + count / 2;
+                std::nth_element(begin, begin + count / 2, end, [&](uint32_t a, uint32_t b)
+                {
+                    return m_centers[size_t(a) * 3 + widest] < m_centers[size_t(b) * 3 + widest];
+                });
+                return true;
+            }
+
+            struct Bin
+            {
+                AxisAlignedBox  box;
+                uint32_t        count;
+            };
+
+            // Cost of each split, relative to the box, is 1 for the node plus the objects on
+            // each side weighted by the area of their box; a leaf costs one per object.
+            const size_t axis = widest;
+            const float scale = float(c_bins) / (centers.maximum[axis] - centers.minimum[axis]);
+            const float origin = centers.minimum[axis];
+
+            Bin bins[c_bins];
+            for (auto& bin : bins)
+            {
+                bin.box = AxisAlignedBox::Empty();
+                bin.count = 0;
+            }
+
+            for (uint32_t j = first; j < first + count; ++j)
+            {
+                const uint32_t index = m_indices[j];
+                Bin& bin = bins[BinOf(m_centers[size_t(index) * 3 + axis], origin, scale)];
+                bin.box.Grow(m_boxes[index]);
+                ++bin.count;
+            }
+
+            // Right to left for the areas above each split, then left to right.
+            float rightCosts[c_bins];
+            AxisAlignedBox right = AxisAlignedBox::Empty();
+            uint32_t rightCount = 0;
+            for (size_t j = c_bins - 1; j > 0; --j)
+            {
+                right.Grow(bins[j].box);
+                rightCount += bins[j].count;
+                rightCosts[j] = rightCount ? right.HalfArea() * float(rightCount) : -1.f;
+            }
+
+            float bestCost = std::numeric_limits<float>::infinity();
+            size_t bestBin = 0;
+            AxisAlignedBox left = AxisAlignedBox::Empty();
+            uint32_t leftCount = 0;
+            for (size_t j = 0; j + 1 < c_bins; ++j)
+            {
+                left.Grow(bins[j].box);
+                leftCount += bins[j].count;
+                if (!leftCount || rightCosts[j + 1] < 0.f)
+                    continue;
+
+                const float cost = left.HalfArea() * float(leftCount) + rightCosts[j + 1];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestBin = j;
+                }
+            }
+
+            const float area = box.HalfArea();
+            if (count <= MaxLeafSize && area * float(count) <= area + bestCost)
+                return false;
+
+            auto split = std::partition(begin, end, [&](uint32_t index)
+            {
+                return BinOf(m_centers[size_t(index) * 3 + axis], origin, scale) <= bestBin;
+            });
+
+            middle = first + uint32_t(split - begin);
+            if (middle == first || middle == first + count)
+            {
+                middle = first + count / 2;
+            }
+            return true;
+        }
+
+        static size_t BinOf(float center, float origin, float scale) noexcept
+        {
+            const float bin = (center - origin) * scale;
+            return (bin < float(c_bins - 1)) ? size_t(std::max(bin, 0.f)) : c_bins - 1;
+        }
+
+        // Appends the four-wide node for a binary node, then its descendants, and returns its
+        // index. Each child is one of the binary node's descendants: the child with the
+        // largest box is opened until there are four.
+        uint32_t Collapse(const Subtrees& trees, BuildRef ref)
+        {
+            const auto index = uint32_t(m_nodes.size());
+            m_nodes.emplace_back();
+
+            BuildRef slots[4];
+            size_t used = 0;
+            if (ref.Get().left == c_leaf)
+            {
+                // Only when the whole tree is one leaf.
+                slots[used++] = ref;
+            }
+            else
+            {
+                slots[used++] = Resolve(trees, ref.nodes, ref.Get().left);
+                slots[used++] = Resolve(trees, ref.nodes, ref.Get().right);
+
+                while (used < 4)
+                {
+                    size_t largest = used;
+                    float largestArea = -1.f;
+                    for (size_t k = 0; k < used; ++k)
+                    {
+                        const BuildNode& node = slots[k].Get();
+                        if (node.left != c_leaf && node.box.HalfArea() > largestArea)
+                        {
+                            largest = k;
+                            largestArea = node.box.HalfArea();
+                        }
+                    }
+
+                    if (largest == used)
+                        break;
+
+                    const BuildRef open = slots[largest];
+                    slots[largest] = Resolve(trees, open.nodes, open.Get().left);
+                    slots[used++] = Resolve(trees, open.nodes, open.Get().right);
+                }
+            }
+
+            Node node = {};
+            for (size_t k = 0; k < 4; ++k)
+            {
+                node.child[k] = c_leaf;
+                if (k >= used)
+                    continue;
+
+                const BuildNode& child = slots[k].Get();
+                SetChildBox(node, k, child.box);
+                node.first[k] = child.first;
+                node.count[k] = child.count;
+                if (child.left != c_leaf)
+                {
+                    node.child[k] = Collapse(trees, slots[k]);
+                }
+            }
+
+            m_nodes[index] = node;
+            return index;
+        }
+
+        static void SetChildBox(Node& node, size_t k, const AxisAlignedBox& box) noexcept
+        {
+            node.minX[k] = box.minimum[0];
+            node.minY[k] = box.minimum[1];
+            node.minZ[k] = box.minimum[2];
+            node.maxX[k] = box.maximum[0];
+            node.maxY[k] = box.maximum[1];
+            node.maxZ[k] = box.maximum[2];
+        }
+
+        static AxisAlignedBox GetNodeBox(const Node& node) noexcept
+        {
+            AxisAlignedBox box = AxisAlignedBox::Empty();
+            for (size_t k = 0; k < 4; ++k)
+            {
+                if (node.count[k])
+                {
+                    const AxisAlignedBox child = { { node.minX[k], node.minY[k], node.minZ[k] }, { node.maxX[k], node.maxY[k], node.maxZ[k] } };
+                    box.Grow(child);
+                }
+            }
+            return box;
+        }
+
+        static unsigned GetUsedMask(const Node& node) noexcept
+        {
+            return (node.count[0] ? 1u : 0u) | (node.count[1] ? 2u : 0u) | (node.count[2] ? 4u : 0u) | (node.count[3] ? 8u : 0u);
+        }
+
+    #if defined(BOUNDINGVOLUMEHIERARCHY_SSE2)
+        // Bit k of intersects is set unless child k is outside a plane, and of inside when
+        // it is also entirely on the inner side of all of them.
+        static void TestFrustum(const Node& node, const Frustum& frustum, unsigned& intersects, unsigned& inside) noexcept
+        {
+            const __m128 minX = _mm_load_ps(node.minX);
+            const __m128 minY = _mm_load_ps(node.minY);
+            const __m128 minZ = _mm_load_ps(node.minZ);
+            const __m128 maxX = _mm_load_ps(node.maxX);
+            const __m128 maxY = _mm_load_ps(node.maxY);
+            const __m128 maxZ = _mm_load_ps(node.maxZ);
+            const __m128 zero = _mm_setzero_ps();
+
+            __m128 outside = zero;
+            __m128 crossing = zero;
+            for (const auto& plane : frustum.planes)
+            {
+                // The corner furthest along the normal decides outside, the nearest inside.
+                const bool px = plane[0] >= 0.f;
+                const bool py = plane[1] >= 0.f;
+                const bool pz = plane[2] >= 0.f;
+
+                const __m128 a = _mm_set1_ps(plane[0]);
+                const __m128 b = _mm_set1_ps(plane[1]);
+                const __m128 c = _mm_set1_ps(plane[2]);
+                const __m128 d = _mm_set1_ps(plane[3]);
+
+                const __m128 furthest = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                    _mm_mul_ps(a, px ? maxX : minX), _mm_mul_ps(b, py ? maxY : minY)), _mm_mul_ps(c, pz ? maxZ : minZ)), d);
+                const __m128 nearest = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                    _mm_mul_ps(a, px ? minX : maxX), _mm_mul_ps(b, py ? minY : maxY)), _mm_mul_ps(c, pz ? minZ : maxZ)), d);
+
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(furthest, zero));
+                crossing = _mm_or_ps(crossing, _mm_cmplt_ps(nearest, zero));
+            }
+
+            intersects = ~unsigned(_mm_movemask_ps(outside)) & GetUsedMask(node);
+            inside = intersects & ~unsigned(_mm_movemask_ps(crossing));
+        }
+
+        // Bit k is set when the ray enters child k before distance, at nears[k].
+        static unsigned TestRay(const Node& node, const float origin[3], const float inverse[3], float distance, float nears[4]) noexcept
+        {
+            const __m128 ox = _mm_set1_ps(origin[0]);
+            const __m128 oy = _mm_set1_ps(origin[1]);
+            const __m128 oz = _mm_set1_ps(origin[2]);
+            const __m128 ix = _mm_set1_ps(inverse[0]);
+            const __m128 iy = _mm_set1_ps(inverse[1]);
+            const __m128 iz = _mm_set1_ps(inverse[2]);
+
+            const __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), ox), ix);
+            const __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), ox), ix);
+            const __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), oy), iy);
+            const __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), oy), iy);
+            const __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), oz), iz);
+            const __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), oz), iz);
+
+            __m128 enter = _mm_setzero_ps();
+            __m128 leave = _mm_set1_ps(distance);
+            enter = _mm_max_ps(enter, _mm_min_ps(x0, x1));
+            leave = _mm_min_ps(leave, _mm_max_ps(x0, x1));
+            enter = _mm_max_ps(enter, _mm_min_ps(y0, y1));
+            leave = _mm_min_ps(leave, _mm_max_ps(y0, y1));
+            enter = _mm_max_ps(enter, _mm_min_ps(z0, z1));
+            leave = _mm_min_ps(leave, _mm_max_ps(z0, z1));
+
+            _mm_storeu_ps(nears, enter);
+            return unsigned(_mm_movemask_ps(_mm_cmple_ps(enter, leave))) & GetUsedMask(node);
+        }
+    #else
+        static void TestFrustum(const Node& node, const Frustum& frustum, unsigned& intersects, unsigned& inside) noexcept
+        {
+            intersects = 0;
+            inside = 0;
+            for (size_t k = 0; k < 4; ++k)
+            {
+                if (!node.count[k])
+                    continue;
+
+                bool outside = false;
+                bool crossing = false;
+                for (const auto& plane : frustum.planes)
+                {
+                    const bool px = plane[0] >= 0.f;
+                    const bool py = plane[1] >= 0.f;
+                    const bool pz = plane[2] >= 0.f;
+
+                    const float furthest = plane[0] * (px ? node.maxX[k] : node.minX[k]) + plane[1] * (py ? node.maxY[k] : node.minY[k])
+                        + plane[2] * (pz ? node.maxZ[k] : node.minZ[k]) + plane[3];
+                    const float nearest = plane[0] * (px ? node.minX[k] : node.maxX[k]) + plane[1] * (py ? node.minY[k] : node.maxY[k])
+                        + plane[2] * (pz ? node.minZ[k] : node.maxZ[k]) + plane[3];
+
+                    outside |= (furthest < 0.f);
+                    crossing |= (nearest < 0.f);
+                }
+
+                if (!outside)
+                {
+                    intersects |= 1u << k;
+                    inside |= crossing ? 0u : (1u << k);
+                }
+            }
+        }
+
+        static unsigned TestRay(const Node& node, const float origin[3], const float inverse[3], float distance, float nears[4]) noexcept
+        {
+            unsigned hits = 0;
+            for (size_t k = 0; k < 4; ++k)
+            {
+                const AxisAlignedBox box = { { node.minX[k], node.minY[k], node.minZ[k] }, { node.maxX[k], node.maxY[k], node.maxZ[k] } };
+                if (node.count[k] && box.IntersectsRay(origin, inverse, distance, nears[k]))
+                {
+                    hits |= 1u << k;
+                }
+            }
+            return hits;
+        }
+    #endif
+
+        WorkerPool*                 m_pool;
+        std::vector<Node>           m_nodes;
+        std::vector<AxisAlignedBox> m_boxes;
+
+        // Objects in tree order, and the center of each object's box as built.
+        std::vector<uint32_t>       m_indices;
+        std::vector<float>          m_centers;
+    };
+}
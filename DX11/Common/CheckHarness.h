@@ -0,0 +1,71 @@
+//--------------------------------------------------------------------------------------
+// File: CheckHarness.h
+//
+// Pass and fail bookkeeping for the standalone check tools next to the samples. Check and
+// Fail print a line starting with ERROR: and count a failure; RunChecks runs a tool's
+// checks, reports an exception that escapes them as a failure, prints the summary and
+// returns the exit code for main.
+//
+// This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdarg>
+#include <cstdio>
+#include <exception>
+
+namespace DX
+{
+    inline int& GetCheckFailures() noexcept
+    {
+        static int s_failures = 0;
+        return s_failures;
+    }
+
+    inline void Fail(const char* format, ...)
+    {
+        va_list args;
+        va_start(args, format);
+        printf("ERROR: ");
+        vprintf(format, args);
+        printf("\n");
+        va_end(args);
+
+        ++GetCheckFailures();
+    }
+
+    inline void Check(bool condition, const char* what)
+    {
+        if (!condition)
+        {
+            Fail("%s", what);
+        }
+    }
+
+    template<typename Func>
+    int RunChecks(Func&& checks)
+    {
+        try
+        {
+            checks();
+        }
+        catch (const std::exception& e)
+        {
+            printf("ERROR: %s\n", e.what());
+            return 1;
+        }
+
+        if (GetCheckFailures())
+        {
+            printf("%d check(s) failed\n", GetCheckFailures());
+            return 1;
+        }
+
+        printf("All checks passed\n");
+        return 0;
+    }
+}
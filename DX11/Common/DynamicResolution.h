@@ -0,0 +1,287 @@
+//--------------------------------------------------------------------------------------
+// File: DynamicResolution.h
+//
+// Frame-time driven render scale controller for dynamic resolution.
+//
+// This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+namespace DX
+{
+    class DynamicResolution
+    {
+    public:
+        static constexpr size_t MaxHistory = 16;
+
+        DynamicResolution() noexcept :
+            m_targetFrameTime(1.0 / 60.0),
+            m_headroom(0.1f),
+            m_minScale(0.5f),
+            m_maxScale(1.f),
+            m_kp(0.6f),
+            m_ki(0.05f),
+            m_kd(0.2f),
+            m_deadband(0.04f),
+            m_maxStepUp(0.02f),
+            m_maxStepDown(0.1f),
+            m_increaseDelay(8),
+            m_historyLength(6),
+            m_granularity(8),
+            m_history{},
+            m_historyCount(0),
+            m_historyNext(0),
+            m_scale(1.f),
+            m_filtered(0.0),
+            m_integral(0.f),
+            m_previousError(0.f),
+            m_increaseFrames(0),
+            m_changeCount(0)
+        {
+        }
+
+        DynamicResolution(DynamicResolution&&) = default;
+        DynamicResolution& operator= (DynamicResolution&&) = default;
+
+        DynamicResolution(DynamicResolution const&) = default;
+        DynamicResolution& operator= (DynamicResolution const&) = default;
+
+        // The frame budget in seconds, e.g. 1/60.
+        void SetTargetFrameTime(double seconds)
+        {
+            if (!(seconds > 0.0))
+                throw std::invalid_argument("Invalid target frame time");
+
+            m_targetFrameTime = seconds;
+        }
+
+        // Fraction of the budget kept free to absorb spikes.
+        void SetHeadroom(float fraction)
+        {
+            if (!(fraction >= 0.f && fraction < 1.f))
+                throw std::invalid_argument("Invalid headroom");
+
+            m_headroom = fraction;
+        }
+
+        void SetScaleRange(float minScale, float maxScale)
+        {
+            if (!(minScale > 0.f && minScale <= maxScale && maxScale <= 1.f))
+                throw std::invalid_argument("Invalid scale range");
+
+            m_minScale = minScale;
+            m_maxScale = maxScale;
+            m_scale = std::min(std::max(m_scale, minScale), maxScale);
+        }
+
+        void SetGains(float kp, float ki, float kd)
+        {
+            if (!(kp >= 0.f && ki >= 0.f && kd >= 0.f))
+                throw std::invalid_argument("Invalid gains");
+
+            m_kp = kp;
+            m_ki = ki;
+            m_kd = kd;
+        }
+
+        // Errors smaller than this fraction of the aim leave the scale alone.
+        void SetDeadband(float fraction)
+        {
+            if (!(fraction >= 0.f))
+                throw std::invalid_argument("Invalid dead band");
+
+            m_deadband = fraction;
+        }
+
+        // Largest change in scale per update in each direction.
+        void SetMaxStep(float up, float down)
+        {
+            if (!(up >= 0.f && down >= 0.f))
+                throw std::invalid_argument("Invalid step");
+
+            m_maxStepUp = up;
+            m_maxStepDown = down;
+        }
+
+        // Consecutive updates asking for a higher scale before it is raised. Lowering the
+        // scale is never delayed.
+        void SetIncreaseDelay(uint32_t frames) noexcept { m_increaseDelay = frames; }
+
+        void SetHistoryLength(size_t frames)
+        {
+            if (!frames || frames > MaxHistory)
+                throw std::invalid_argument("Invalid history length");
+
+            m_historyLength = frames;
+            m_historyCount = std::min(m_historyCount, frames);
+            m_historyNext = m_historyCount % frames;
+        }
+
+        // GetRenderSize rounds to multiples of this many pixels.
+        void SetGranularity(size_t pixels)
+        {
+            if (!pixels)
+                throw std::invalid_argument("Invalid granularity");
+
+            m_granularity = pixels;
+        }
+
+        // Forgets the history and restarts at maxScale.
+        void Reset() noexcept
+        {
+            m_historyCount = 0;
+            m_historyNext = 0;
+            m_scale = m_maxScale;
+            m_filtered = 0.0;
+            m_integral = 0.f;
+            m_previousError = 0.f;
+            m_increaseFrames = 0;
+        }
+
+        // Takes the time of the last frame in seconds and returns the scale for the next.
+        // The time is averaged over a short history, and the scale moves so the frame lands
+        // a little under the budget. The correction is PID-style on the ratio between the aim
+        // and the measured time, treating cost as proportional to pixel count, with a dead
+        // band, a delay before scaling up, and per-update step limits so the scale does not
+        // hunt.
+        //
+        // Feed it GPU timings where possible: with vsync the CPU frame time from StepTimer
+        // reads as the refresh interval whenever the budget is met, which hides any headroom.
+        float Update(double frameSeconds) noexcept
+        {
+            if (!(frameSeconds > 0.0) || !std::isfinite(frameSeconds))
+                return m_scale;
+
+            m_history[m_historyNext] = frameSeconds;
+            m_historyNext = (m_historyNext + 1) % m_historyLength;
+            m_historyCount = std::min(m_historyCount + 1, m_historyLength);
+
+            double sum = 0.0;
+            for (size_t j = 0; j < m_historyCount; ++j)
+            {
+                sum += m_history[j];
+            }
+            m_filtered = sum / double(m_historyCount);
+
+            // Positive when there is time to spare; the ratio is the ideal change in pixel count.
+            const double aim = m_targetFrameTime * double(1.f - m_headroom);
+            const float error = std::min(std::max(float(aim / m_filtered) - 1.f, -0.5f), 1.f);
+
+            if (std::fabs(error) < m_deadband)
+            {
+                m_increaseFrames = 0;
+                m_previousError = error;
+                return m_scale;
+            }
+
+            const float limit = c_integralLimit;
+            const float integral = std::min(std::max(m_integral + error, -limit), limit);
+            const float derivative = error - m_previousError;
+            m_previousError = error;
+
+            const float output = m_kp * error + m_ki * integral + m_kd * derivative;
+
+            // At the limits of the range the integral is cleared, so it does not wind up.
+            if ((output > 0.f) ? (m_scale >= m_maxScale) : (m_scale <= m_minScale))
+            {
+                m_integral = 0.f;
+                m_increaseFrames = 0;
+                return m_scale;
+            }
+
+            m_integral = integral;
+
+            if (output > 0.f)
+            {
+                if (++m_increaseFrames <= m_increaseDelay)
+                    return m_scale;
+            }
+            else
+            {
+                m_increaseFrames = 0;
+            }
+
+            const float area = m_scale * m_scale * std::max(1.f + output, 0.25f);
+            float scale = std::sqrt(area);
+            scale = std::min(std::max(scale, m_scale - m_maxStepDown), m_scale + m_maxStepUp);
+            scale = std::min(std::max(scale, m_minScale), m_maxScale);
+
+            if (scale != m_scale)
+            {
+                // Predict the history at the new scale, so the next updates do not correct
+                // for the same error again.
+                const double factor = double(scale * scale) / double(m_scale * m_scale);
+                for (size_t j = 0; j < m_historyCount; ++j)
+                {
+                    m_history[j] *= factor;
+                }
+                m_filtered *= factor;
+
+                m_scale = scale;
+                m_increaseFrames = 0;
+                ++m_changeCount;
+            }
+
+            return m_scale;
+        }
+
+        // The viewport for the given scale 1 size, never smaller than one granule. Render
+        // targets are sized for scale 1 once; the frame is rendered into this viewport and
+        // upscaled to the output in a final pass.
+        void GetRenderSize(size_t maxWidth, size_t maxHeight, size_t& width, size_t& height) const noexcept
+        {
+            width = ScaleDimension(maxWidth);
+            height = ScaleDimension(maxHeight);
+        }
+
+        float GetScale() const noexcept { return m_scale; }
+        double GetFilteredFrameTime() const noexcept { return m_filtered; }
+        double GetTargetFrameTime() const noexcept { return m_targetFrameTime; }
+        uint32_t GetChangeCount() const noexcept { return m_changeCount; }
+
+    private:
+        static constexpr float c_integralLimit = 4.f;
+
+        size_t ScaleDimension(size_t size) const noexcept
+        {
+            if (m_scale >= 1.f || size <= m_granularity)
+                return size;
+
+            const size_t granules = size_t(std::lround(double(size) * double(m_scale) / double(m_granularity)));
+            return std::min(std::max<size_t>(granules, 1) * m_granularity, size);
+        }
+
+        double      m_targetFrameTime;
+        float       m_headroom;
+        float       m_minScale;
+        float       m_maxScale;
+        float       m_kp;
+        float       m_ki;
+        float       m_kd;
+        float       m_deadband;
+        float       m_maxStepUp;
+        float       m_maxStepDown;
+        uint32_t    m_increaseDelay;
+        size_t      m_historyLength;
+        size_t      m_granularity;
+        double      m_history[MaxHistory];
+        size_t      m_historyCount;
+        size_t      m_historyNext;
+        float       m_scale;
+        double      m_filtered;
+        float       m_integral;
+        float       m_previousError;
+        uint32_t    m_increaseFrames;
+        uint32_t    m_changeCount;
+    };
+}
@@ -0,0 +1,83 @@
+//--------------------------------------------------------------------------------------
+// File: LodSelector.h
+//
+// Picks a level of detail from the distance to the eye. Thresholds are given as projected
+// sizes, the diameter of a bounding sphere over the height of the view, and turned into
+// squared distances once per frame: a sphere of radius r at distance d covers about
+// r * proj._22 / d of the height, where proj._22 is the vertical scale of a perspective
+// projection (1 / tan(fovY / 2)). Level 0 is the most detailed.
+//
+// This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+
+namespace DX
+{
+    struct LodSelector
+    {
+        static constexpr size_t MaxLevels = 4;
+
+        float eye[3];
+
+        // Level j + 1 starts at a squared distance of limits[j]; increasing.
+        float limits[MaxLevels - 1];
+        size_t levels;
+
+        // A single level: everything is level 0.
+        LodSelector() noexcept :
+            eye{},
+            limits{},
+            levels(1)
+        {
+        }
+
+        // screenSizes holds, for each level after the first, the projected size below
+        // which it is used; decreasing. There are count + 1 levels.
+        static LodSelector FromScreenSizes(const float eyePosition[3], float projectionScale, float radius,
+            const float* screenSizes, size_t count)
+        {
+            if (count >= MaxLevels)
+                throw std::invalid_argument("Too many levels");
+
+            LodSelector lods;
+            for (size_t j = 0; j < 3; ++j)
+            {
+                lods.eye[j] = eyePosition[j];
+            }
+
+            for (size_t j = 0; j < count; ++j)
+            {
+                if (!(screenSizes[j] > 0.f) || (j && screenSizes[j] >= screenSizes[j - 1]))
+                    throw std::invalid_argument("Screen sizes must be positive and decreasing");
+
+                const float distance = radius * projectionScale / screenSizes[j];
+                lods.limits[j] = distance * distance;
+            }
+            lods.levels = count + 1;
+            return lods;
+        }
+
+        // The level of a sphere centered at x, y, z.
+        size_t Select(float x, float y, float z) const noexcept
+        {
+            const float dx = x - eye[0];
+            const float dy = y - eye[1];
+            const float dz = z - eye[2];
+            const float distance = dx * dx + dy * dy + dz * dz;
+
+            size_t level = 0;
+            for (size_t j = 0; j + 1 < levels; ++j)
+            {
+                level += (distance >= limits[j]) ? 1 : 0;
+            }
+            return level;
+        }
+    };
+}
@@ -0,0 +1,229 @@
+//--------------------------------------------------------------------------------------
+// File: MSAAPolicy.h
+//
+// Chooses an MSAA sample count of 1x, 2x, 4x or 8x from a rolling frame-time budget. Once a
+// window of frames at the current count is collected, the policy steps down a level if the
+// average is over the down threshold or too many frames missed the budget, and steps up a
+// level if the predicted cost there is under the up threshold. The prediction uses the
+// cost ratio between neighboring levels, learned by comparing the windows either side of
+// each switch. After stepping down it waits before stepping up again.
+//
+// Frames are reported with the sample count they were rendered at, so timings that arrive
+// late or while new targets are still being created do not count toward the new level.
+//
+// This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+namespace DX
+{
+    class MSAAPolicy
+    {
+    public:
+        explicit MSAAPolicy(unsigned int sampleCount = 4, unsigned int maxSampleCount = 8) :
+            m_targetFrameTime(1.0 / 60.0),
+            m_downThreshold(0.95f),
+            m_upThreshold(0.75f),
+            m_windowLength(30),
+            m_upHold(180),
+            m_maxLevel(0),
+            m_level(0),
+            m_windowSum(0.0),
+            m_windowCount(0),
+            m_overBudget(0),
+            m_average(0.0),
+            m_upHoldRemaining(0),
+            m_switchLevel(c_noLevel),
+            m_switchAverage(0.0),
+            m_switchCount(0)
+        {
+            for (size_t j = 0; j < c_levelCount; ++j)
+            {
+                m_ratio[j] = c_defaultRatio;
+            }
+
+            SetMaxSampleCount(maxSampleCount);
+            m_level = std::min(LevelFromSampleCount(sampleCount), m_maxLevel);
+        }
+
+        MSAAPolicy(MSAAPolicy&&) = default;
+        MSAAPolicy& operator= (MSAAPolicy&&) = default;
+
+        MSAAPolicy(MSAAPolicy const&) = default;
+        MSAAPolicy& operator= (MSAAPolicy const&) = default;
+
+        // The frame budget in seconds, e.g. 1/60.
+        void SetTargetFrameTime(double seconds)
+        {
+            if (!(seconds > 0.0))
+                throw std::invalid_argument("Invalid target frame time");
+
+            m_targetFrameTime = seconds;
+        }
+
+        // Fractions of the budget: step down when the average is above down, and up when the
+        // predicted average at the next level is below up.
+        void SetThresholds(float down, float up)
+        {
+            if (!(up > 0.f && up < down))
+                throw std::invalid_argument("Invalid thresholds");
+
+            m_downThreshold = down;
+            m_upThreshold = up;
+        }
+
+        // Frames at the current sample count averaged for each decision.
+        void SetWindow(size_t frames)
+        {
+            if (!frames)
+                throw std::invalid_argument("Invalid window");
+
+            m_windowLength = frames;
+            ClearWindow();
+        }
+
+        // Frames after stepping down before the policy may step up again.
+        void SetUpHold(uint32_t frames) noexcept { m_upHold = frames; }
+
+        // The highest count the device supports: 1, 2, 4 or 8.
+        void SetMaxSampleCount(unsigned int sampleCount)
+        {
+            m_maxLevel = LevelFromSampleCount(sampleCount);
+            m_level = std::min(m_level, m_maxLevel);
+        }
+
+        // Reports the time of a frame rendered with the given sample count, and returns the
+        // count to use from now on. Changes are at most one level at a time.
+        unsigned int Update(double frameSeconds, unsigned int sampleCount) noexcept
+        {
+            if (!(frameSeconds > 0.0) || !std::isfinite(frameSeconds) || sampleCount != GetSampleCount())
+                return GetSampleCount();
+
+            if (m_upHoldRemaining)
+            {
+                --m_upHoldRemaining;
+            }
+
+            m_windowSum += frameSeconds;
+            ++m_windowCount;
+            if (frameSeconds > m_targetFrameTime)
+            {
+                ++m_overBudget;
+            }
+
+            if (m_windowCount < m_windowLength)
+                return GetSampleCount();
+
+            m_average = m_windowSum / double(m_windowCount);
+
+            // The first full window after a switch gives the cost ratio between the levels.
+            if (m_switchLevel != c_noLevel)
+            {
+                const size_t upper = std::max(m_switchLevel, m_level);
+                const double ratio = (m_level > m_switchLevel) ? (m_average / m_switchAverage) : (m_switchAverage / m_average);
+                const double maxRatio = c_maxRatio;
+                m_ratio[upper] = std::min(std::max((m_ratio[upper] + ratio) * 0.5, 1.0), maxRatio);
+                m_switchLevel = c_noLevel;
+            }
+
+            const bool over = (m_average > m_targetFrameTime * double(m_downThreshold))
+                || (m_overBudget * 4 > m_windowCount);
+
+            if (over && m_level > 0)
+            {
+                Switch(m_level - 1);
+                m_upHoldRemaining = m_upHold;
+            }
+            else if (!over && m_level < m_maxLevel && !m_upHoldRemaining
+                && m_average * m_ratio[m_level + 1] < m_targetFrameTime * double(m_upThreshold))
+            {
+                Switch(m_level + 1);
+            }
+            else
+            {
+                ClearWindow();
+            }
+
+            return GetSampleCount();
+        }
+
+        unsigned int GetSampleCount() const noexcept { return 1u << m_level; }
+        unsigned int GetMaxSampleCount() const noexcept { return 1u << m_maxLevel; }
+
+        // Average of the last full window.
+        double GetAverageFrameTime() const noexcept { return m_average; }
+
+        // Estimated cost of a sample count relative to half as many samples.
+        double GetCostRatio(unsigned int sampleCount) const
+        {
+            const size_t level = LevelFromSampleCount(sampleCount);
+            if (!level)
+                throw std::invalid_argument("No lower sample count");
+
+            return m_ratio[level];
+        }
+
+        uint32_t GetSwitchCount() const noexcept { return m_switchCount; }
+
+    private:
+        static constexpr size_t c_levelCount = 4;
+        static constexpr size_t c_noLevel = SIZE_MAX;
+        static constexpr double c_defaultRatio = 1.25;
+        static constexpr double c_maxRatio = 4.0;
+
+        static size_t LevelFromSampleCount(unsigned int sampleCount)
+        {
+            switch (sampleCount)
+            {
+            case 1: return 0;
+            case 2: return 1;
+            case 4: return 2;
+            case 8: return 3;
+            default: throw std::invalid_argument("Sample count must be 1, 2, 4 or 8");
+            }
+        }
+
+        void Switch(size_t level) noexcept
+        {
+            m_switchLevel = m_level;
+            m_switchAverage = m_average;
+            m_level = level;
+            ++m_switchCount;
+            ClearWindow();
+        }
+
+        void ClearWindow() noexcept
+        {
+            m_windowSum = 0.0;
+            m_windowCount = 0;
+            m_overBudget = 0;
+        }
+
+        double      m_targetFrameTime;
+        float       m_downThreshold;
+        float       m_upThreshold;
+        size_t      m_windowLength;
+        uint32_t    m_upHold;
+        size_t      m_maxLevel;
+        size_t      m_level;
+        double      m_windowSum;
+        size_t      m_windowCount;
+        size_t      m_overBudget;
+        double      m_average;
+        uint32_t    m_upHoldRemaining;
+        size_t      m_switchLevel;
+        double      m_switchAverage;
+        uint32_t    m_switchCount;
+        double      m_ratio[c_levelCount];
+    };
+}
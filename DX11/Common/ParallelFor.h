@@ -0,0 +1,272 @@
+//--------------------------------------------------------------------------------------
+// File: ParallelFor.h
+//
+// Minimal portable helpers for splitting a range of work across hardware threads. ParallelFor
+// starts threads for each call; WorkerPool keeps them running for per-frame work.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//-------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace DX
+{
+    inline size_t GetWorkerCount() noexcept
+    {
+        const unsigned int count = std::thread::hardware_concurrency();
+        return (count > 0) ? size_t(count) : 1u;
+    }
+
+    // Invokes func(begin, end) over contiguous sub-ranges of [0, count). Ranges smaller than
+    // minBatch are not split. The calling thread processes the first range. If func throws,
+    // the first exception is rethrown once every range has finished.
+    template<typename Func>
+    void ParallelFor(size_t count, size_t minBatch, Func&& func)
+    {
+        if (!count)
+            return;
+
+        minBatch = std::max<size_t>(minBatch, 1);
+
+        const size_t workers = std::min(GetWorkerCount(), (count + minBatch - 1) / minBatch);
+        if (workers <= 1)
+        {
+            func(size_t(0), count);
+            return;
+        }
+
+        const size_t batch = (count + workers - 1) / workers;
+
+        std::mutex mutex;
+        std::exception_ptr error;
+        auto guarded = [&](size_t begin, size_t end)
+        {
+            try
+            {
+                func(begin, end);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(workers - 1);
+
+        for (size_t j = 1; j < workers; ++j)
+        {
+            const size_t begin = j * batch;
+            const size_t end = std::min(begin + batch, count);
+            if (begin >= end)
+                break;
+
+            try
+            {
+                threads.emplace_back([&guarded, begin, end]() { guarded(begin, end); });
+            }
+            catch (...)
+            {
+                // Could not start a thread: run the range here instead.
+                guarded(begin, end);
+            }
+        }
+
+        guarded(size_t(0), std::min(batch, count));
+
+        for (auto& it : threads)
+        {
+            it.join();
+        }
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Worker threads that wait for Run calls. Run splits [0, count) into one contiguous range
+    // per thread, calls func(begin, end, worker) on each with worker < GetThreadCount(), and
+    // returns when all are done. The calling thread is worker 0. Run does not allocate, and
+    // is not reentrant. If func throws, on any thread, Run still waits for every range and
+    // then rethrows the first exception.
+    class WorkerPool
+    {
+    public:
+        explicit WorkerPool(size_t threadCount = GetWorkerCount()) :
+            m_generation(0),
+            m_pending(0),
+            m_count(0),
+            m_batch(0),
+            m_context(nullptr),
+            m_invoke(nullptr),
+            m_stop(false)
+        {
+            threadCount = std::max<size_t>(threadCount, 1);
+
+            m_threads.reserve(threadCount - 1);
+            for (size_t j = 1; j < threadCount; ++j)
+            {
+                m_threads.emplace_back([this, j]() { WorkerMain(j); });
+            }
+        }
+
+        WorkerPool(WorkerPool const&) = delete;
+        WorkerPool& operator= (WorkerPool const&) = delete;
+
+        ~WorkerPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_start.notify_all();
+
+            for (auto& it : m_threads)
+            {
+                it.join();
+            }
+        }
+
+        size_t GetThreadCount() const noexcept { return m_threads.size() + 1; }
+
+        // Ranges smaller than minBatch are not split.
+        template<typename Func>
+        void Run(size_t count, size_t minBatch, Func& func)
+        {
+            if (!count)
+                return;
+
+            minBatch = std::max<size_t>(minBatch, 1);
+
+            const size_t workers = std::min(GetThreadCount(), (count + minBatch - 1) / minBatch);
+            const size_t batch = (count + workers - 1) / workers;
+            if (workers <= 1 || batch >= count)
+            {
+                func(size_t(0), count, size_t(0));
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_count = count;
+                m_batch = batch;
+                m_context = &func;
+                m_invoke = &Invoke<Func>;
+                m_pending = m_threads.size();
+                ++m_generation;
+            }
+            m_start.notify_all();
+
+            // The workers call through m_context, which points at func: wait for them even
+            // when the first range throws.
+            try
+            {
+                func(size_t(0), batch, size_t(0));
+            }
+            catch (...)
+            {
+                SetError(std::current_exception());
+            }
+
+            std::exception_ptr error;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_done.wait(lock, [this]() { return !m_pending; });
+                std::swap(error, m_error);
+            }
+
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+
+    private:
+        template<typename Func>
+        static void Invoke(void* context, size_t begin, size_t end, size_t worker)
+        {
+            (*static_cast<Func*>(context))(begin, end, worker);
+        }
+
+        // Keeps the first exception of a Run.
+        void SetError(std::exception_ptr error)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_error)
+            {
+                m_error = std::move(error);
+            }
+        }
+
+        void WorkerMain(size_t worker)
+        {
+            uint64_t generation = 0;
+
+            for (;;)
+            {
+                size_t begin;
+                size_t end;
+                void* context;
+                void (*invoke)(void*, size_t, size_t, size_t);
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_start.wait(lock, [this, generation]() { return m_stop || m_generation != generation; });
+                    if (m_stop)
+                        return;
+
+                    generation = m_generation;
+                    begin = std::min(worker * m_batch, m_count);
+                    end = std::min(begin + m_batch, m_count);
+                    context = m_context;
+                    invoke = m_invoke;
+                }
+
+                if (begin < end)
+                {
+                    try
+                    {
+                        invoke(context, begin, end, worker);
+                    }
+                    catch (...)
+                    {
+                        SetError(std::current_exception());
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!--m_pending)
+                {
+                    m_done.notify_one();
+                }
+            }
+        }
+
+        std::mutex                  m_mutex;
+        std::condition_variable     m_start;
+        std::condition_variable     m_done;
+        uint64_t                    m_generation;
+        size_t                      m_pending;
+        size_t                      m_count;
+        size_t                      m_batch;
+        void*                       m_context;
+        void                        (*m_invoke)(void*, size_t, size_t, size_t);
+        std::exception_ptr          m_error;
+        bool                        m_stop;
+        std::vector<std::thread>    m_threads;
+    };
+}
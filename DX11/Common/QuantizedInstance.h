@@ -0,0 +1,352 @@
+//--------------------------------------------------------------------------------------
+// File: QuantizedInstance.h
+//
+// A 16-byte instance format, a third of an XMFLOAT3X4, with SSE2 encoding into mapped
+// upload or dynamic buffers.
+//
+// This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define QUANTIZEDINSTANCE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace DX
+{
+    // Positions of a cluster's instances are origin + (q - 32768) * step for q in [1, 65535],
+    // so instances close together get fine steps.
+    struct InstanceCluster
+    {
+        float origin[4];
+        float step[4];
+
+        // Steps just fine enough to reach the bounds from their center.
+        static InstanceCluster FromBounds(const float minimum[3], const float maximum[3]) noexcept
+        {
+            InstanceCluster cluster = {};
+            for (size_t j = 0; j < 3; ++j)
+            {
+                const float extent = (maximum[j] - minimum[j]) * 0.5f;
+                cluster.origin[j] = (minimum[j] + maximum[j]) * 0.5f;
+                cluster.step[j] = (extent > 0.f) ? extent / 32767.f : 1.f;
+            }
+            return cluster;
+        }
+    };
+
+    // As four 32-bit words this is (x | y << 16, z | scale << 16, rotation, cluster), which
+    // is what the vertex shaders read as one R32G32B32A32_UINT instance element.
+    struct QuantizedInstance
+    {
+        uint16_t position[3];   // fixed point steps from the origin of the cluster
+        uint16_t scale;         // uniform, as a half
+        uint32_t rotation;      // smallest-three quaternion, see PackRotation
+        uint32_t cluster;       // index into a table of InstanceCluster
+
+        // Floats Decode writes: three rows of an XMFLOAT3X4.
+        static constexpr size_t TransformFloats = 12;
+
+        // rotation is a unit quaternion as x, y, z, w.
+        static QuantizedInstance Encode(const InstanceCluster& cluster, uint32_t clusterIndex,
+            const float position[3], const float rotation[4], float scale) noexcept
+        {
+            QuantizedInstance result = {};
+            for (size_t j = 0; j < 3; ++j)
+            {
+                const float steps = (position[j] - cluster.origin[j]) * (1.f / cluster.step[j]);
+                result.position[j] = uint16_t(int32_t(std::nearbyint(std::min(std::max(steps, -32767.f), 32767.f))) + 32768);
+            }
+            result.scale = PackHalf(scale);
+            result.rotation = PackRotation(rotation);
+            result.cluster = clusterIndex;
+            return result;
+        }
+
+        // The rows of scale * rotation with the position in w, as the vertex shaders decode
+        // them, for reference.
+        void Decode(const InstanceCluster& cluster, float transform[TransformFloats]) const noexcept
+        {
+            float q[4];
+            UnpackRotation(rotation, q);
+
+            const float s = UnpackHalf(scale);
+            const float x2 = q[0] + q[0];
+            const float y2 = q[1] + q[1];
+            const float z2 = q[2] + q[2];
+
+            const float rows[TransformFloats] =
+            {
+                (1.f - q[1] * y2 - q[2] * z2) * s, (q[0] * y2 - q[3] * z2) * s, (q[0] * z2 + q[3] * y2) * s, GetPosition(cluster, 0),
+                (q[0] * y2 + q[3] * z2) * s, (1.f - q[0] * x2 - q[2] * z2) * s, (q[1] * z2 - q[3] * x2) * s, GetPosition(cluster, 1),
+                (q[0] * z2 - q[3] * y2) * s, (q[1] * z2 + q[3] * x2) * s, (1.f - q[0] * x2 - q[1] * y2) * s, GetPosition(cluster, 2),
+            };
+            memcpy(transform, rows, sizeof(rows));
+        }
+
+        float GetPosition(const InstanceCluster& cluster, size_t axis) const noexcept
+        {
+            return cluster.origin[axis] + float(int32_t(position[axis]) - 32768) * cluster.step[axis];
+        }
+
+        // Round to nearest even; values below the smallest normal half flush to zero, and
+        // values past the largest (and NaN) clamp to +-65504.
+        static uint16_t PackHalf(float value) noexcept
+        {
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+
+            const uint32_t sign = (bits >> 16) & 0x8000u;
+            const uint32_t magnitude = bits & 0x7fffffffu;
+
+            uint32_t half;
+            if (magnitude < 0x38800000u)
+            {
+                half = 0;
+            }
+            else if (magnitude > 0x477fe000u)
+            {
+                half = 0x7bffu;
+            }
+            else
+            {
+                half = (magnitude - 0x38000000u + 0xfffu + ((magnitude >> 13) & 1u)) >> 13;
+            }
+            return uint16_t(half | sign);
+        }
+
+        static float UnpackHalf(uint16_t half) noexcept
+        {
+            const uint32_t sign = uint32_t(half & 0x8000u) << 16;
+            const uint32_t exponent = (half >> 10) & 0x1fu;
+            const uint32_t mantissa = half & 0x3ffu;
+
+            if (!exponent)
+            {
+                // Zero or denormal.
+                const float value = float(mantissa) * 5.9604645e-08f;
+                return sign ? -value : value;
+            }
+
+            const uint32_t bits = sign | ((exponent == 0x1fu) ? (0x7f800000u | (mantissa << 13)) : (((exponent + 112u) << 23) | (mantissa << 13)));
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        // The index of the largest component goes in bits 30-31, and the other three in 10
+        // bits each, in x, y, z, w order. They lie within +-1/sqrt(2) once the largest is made
+        // positive; they map to 1 to 1021 around 511, so 0 is exact and identity survives.
+        static uint32_t PackRotation(const float rotation[4]) noexcept
+        {
+            uint32_t largest = 0;
+            float magnitude = std::abs(rotation[0]);
+            for (uint32_t j = 1; j < 4; ++j)
+            {
+                if (std::abs(rotation[j]) > magnitude)
+                {
+                    magnitude = std::abs(rotation[j]);
+                    largest = j;
+                }
+            }
+
+            const float sign = (rotation[largest] < 0.f) ? -1.f : 1.f;
+
+            uint32_t packed = largest << 30;
+            uint32_t shift = 20;
+            for (uint32_t j = 0; j < 4; ++j)
+            {
+                if (j == largest)
+                    continue;
+
+                const float scaled = std::min(std::max(rotation[j] * sign * c_rotationScale, -511.f), 511.f);
+                packed |= uint32_t(int32_t(std::nearbyint(scaled)) + 511) << shift;
+                shift -= 10;
+            }
+            return packed;
+        }
+
+        static void UnpackRotation(uint32_t packed, float rotation[4]) noexcept
+        {
+            const uint32_t largest = packed >> 30;
+
+            float sum = 0.f;
+            uint32_t shift = 20;
+            for (uint32_t j = 0; j < 4; ++j)
+            {
+                if (j == largest)
+                    continue;
+
+                rotation[j] = float(int32_t((packed >> shift) & 0x3ffu) - 511) * (1.f / c_rotationScale);
+                sum += rotation[j] * rotation[j];
+                shift -= 10;
+            }
+            rotation[largest] = std::sqrt(std::max(1.f - sum, 0.f));
+        }
+
+        // Encodes count instances of one cluster into dest, which must be 16-byte aligned.
+        // positions holds x, y, z and a float of padding per instance; rotations holds
+        // x, y, z, w per instance, or is null for identity; scales holds a float per
+        // instance, or is null for 1. Four instances are quantized per step with SSE2 and
+        // streamed into dest, meant to be a mapped upload or dynamic buffer; the bits match
+        // Encode.
+        static void EncodeInstances(const InstanceCluster& cluster, uint32_t clusterIndex, size_t count,
+            const float* positions, const float* rotations, const float* scales, QuantizedInstance* dest)
+        {
+            if (reinterpret_cast<uintptr_t>(dest) & 15)
+                throw std::invalid_argument("Destination must be 16-byte aligned");
+
+            const float identity[4] = { 0.f, 0.f, 0.f, 1.f };
+            size_t j = 0;
+
+        #if defined(QUANTIZEDINSTANCE_SSE2)
+            const __m128 origin = _mm_loadu_ps(cluster.origin);
+            const __m128 inverseStep = _mm_div_ps(_mm_set1_ps(1.f), _mm_loadu_ps(cluster.step));
+            const __m128i packedIdentity = _mm_set1_epi32(int32_t(PackRotation(identity)));
+            const __m128i packedOne = _mm_set1_epi32(PackHalf(1.f));
+            const __m128i clusterWord = _mm_set1_epi32(int32_t(clusterIndex));
+
+            for (; j + 4 <= count; j += 4)
+            {
+                __m128 p0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(positions + j * 4), origin), inverseStep);
+                __m128 p1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(positions + j * 4 + 4), origin), inverseStep);
+                __m128 p2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(positions + j * 4 + 8), origin), inverseStep);
+                __m128 p3 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(positions + j * 4 + 12), origin), inverseStep);
+                _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+
+                const __m128i x = _mm_add_epi32(Round(p0, 32767.f), _mm_set1_epi32(32768));
+                const __m128i y = _mm_add_epi32(Round(p1, 32767.f), _mm_set1_epi32(32768));
+                const __m128i z = _mm_add_epi32(Round(p2, 32767.f), _mm_set1_epi32(32768));
+
+                const __m128i scale = scales ? PackHalf4(_mm_loadu_ps(scales + j)) : packedOne;
+                const __m128i rotation = rotations ? PackRotation4(rotations + j * 4) : packedIdentity;
+
+                // The words are rows of four instances; transpose to an instance per register.
+                __m128 w0 = _mm_castsi128_ps(_mm_or_si128(x, _mm_slli_epi32(y, 16)));
+                __m128 w1 = _mm_castsi128_ps(_mm_or_si128(z, _mm_slli_epi32(scale, 16)));
+                __m128 w2 = _mm_castsi128_ps(rotation);
+                __m128 w3 = _mm_castsi128_ps(clusterWord);
+                _MM_TRANSPOSE4_PS(w0, w1, w2, w3);
+
+                auto out = reinterpret_cast<__m128i*>(dest + j);
+                _mm_stream_si128(out, _mm_castps_si128(w0));
+                _mm_stream_si128(out + 1, _mm_castps_si128(w1));
+                _mm_stream_si128(out + 2, _mm_castps_si128(w2));
+                _mm_stream_si128(out + 3, _mm_castps_si128(w3));
+            }
+        #endif
+
+            for (; j < count; ++j)
+            {
+                const auto instance = Encode(cluster, clusterIndex, positions + j * 4,
+                    rotations ? rotations + j * 4 : identity, scales ? scales[j] : 1.f);
+                memcpy(dest + j, &instance, sizeof(instance));
+            }
+
+        #if defined(QUANTIZEDINSTANCE_SSE2)
+            // Streaming stores are weakly ordered; make them visible before the GPU reads.
+            _mm_sfence();
+        #endif
+        }
+
+    private:
+        // 511 * sqrt(2)
+        static constexpr float c_rotationScale = 722.66315f;
+
+    #if defined(QUANTIZEDINSTANCE_SSE2)
+        // Clamps to +-limit and rounds to nearest even, as std::nearbyint.
+        static __m128i Round(__m128 value, float limit) noexcept
+        {
+            return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(value, _mm_set1_ps(-limit)), _mm_set1_ps(limit)));
+        }
+
+        // PackHalf on four lanes.
+        static __m128i PackHalf4(__m128 value) noexcept
+        {
+            const __m128i bits = _mm_castps_si128(value);
+            const __m128i sign = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(0x8000));
+            const __m128i magnitude = _mm_and_si128(bits, _mm_set1_epi32(0x7fffffff));
+
+            __m128i half = _mm_add_epi32(_mm_sub_epi32(magnitude, _mm_set1_epi32(0x38000000)), _mm_set1_epi32(0xfff));
+            half = _mm_srli_epi32(_mm_add_epi32(half, _mm_and_si128(_mm_srli_epi32(magnitude, 13), _mm_set1_epi32(1))), 13);
+
+            const __m128i tiny = _mm_cmplt_epi32(magnitude, _mm_set1_epi32(0x38800000));
+            const __m128i huge = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(0x477fe000));
+            half = _mm_andnot_si128(tiny, half);
+            half = Select(huge, _mm_set1_epi32(0x7bff), half);
+            return _mm_or_si128(half, sign);
+        }
+
+        // PackRotation on the four quaternions from rotations.
+        static __m128i PackRotation4(const float* rotations) noexcept
+        {
+            __m128 qx = _mm_loadu_ps(rotations);
+            __m128 qy = _mm_loadu_ps(rotations + 4);
+            __m128 qz = _mm_loadu_ps(rotations + 8);
+            __m128 qw = _mm_loadu_ps(rotations + 12);
+            _MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+
+            // The first of equal magnitudes wins, as in the scalar loop.
+            const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+            __m128 magnitude = _mm_and_ps(qx, absMask);
+            __m128 value = qx;
+            __m128i largest = _mm_setzero_si128();
+
+            __m128 greater = _mm_cmpgt_ps(_mm_and_ps(qy, absMask), magnitude);
+            magnitude = Select(greater, _mm_and_ps(qy, absMask), magnitude);
+            value = Select(greater, qy, value);
+            largest = Select(_mm_castps_si128(greater), _mm_set1_epi32(1), largest);
+
+            greater = _mm_cmpgt_ps(_mm_and_ps(qz, absMask), magnitude);
+            magnitude = Select(greater, _mm_and_ps(qz, absMask), magnitude);
+            value = Select(greater, qz, value);
+            largest = Select(_mm_castps_si128(greater), _mm_set1_epi32(2), largest);
+
+            greater = _mm_cmpgt_ps(_mm_and_ps(qw, absMask), magnitude);
+            value = Select(greater, qw, value);
+            largest = Select(_mm_castps_si128(greater), _mm_set1_epi32(3), largest);
+
+            // Negating the scale makes the largest component positive.
+            const __m128 negative = _mm_and_ps(_mm_cmplt_ps(value, _mm_setzero_ps()), _mm_set1_ps(-0.f));
+            const __m128 scale = _mm_xor_ps(_mm_set1_ps(c_rotationScale), negative);
+
+            // The other three in order: a is x unless x is the largest, and so on.
+            const __m128 a = Select(_mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_setzero_si128())), qy, qx);
+            const __m128 b = Select(_mm_castsi128_ps(_mm_cmplt_epi32(largest, _mm_set1_epi32(2))), qz, qy);
+            const __m128 c = Select(_mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(3))), qz, qw);
+
+            const __m128i bias = _mm_set1_epi32(511);
+            const __m128i ia = _mm_add_epi32(Round(_mm_mul_ps(a, scale), 511.f), bias);
+            const __m128i ib = _mm_add_epi32(Round(_mm_mul_ps(b, scale), 511.f), bias);
+            const __m128i ic = _mm_add_epi32(Round(_mm_mul_ps(c, scale), 511.f), bias);
+
+            return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(largest, 30), _mm_slli_epi32(ia, 20)),
+                _mm_or_si128(_mm_slli_epi32(ib, 10), ic));
+        }
+
+        static __m128 Select(__m128 mask, __m128 a, __m128 b) noexcept
+        {
+            return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+        }
+
+        static __m128i Select(__m128i mask, __m128i a, __m128i b) noexcept
+        {
+            return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+        }
+    #endif
+    };
+
+    static_assert(sizeof(QuantizedInstance) == 16, "QuantizedInstance must be 16 bytes");
+}
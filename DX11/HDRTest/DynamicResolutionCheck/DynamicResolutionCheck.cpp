@@ -0,0 +1,188 @@
+//--------------------------------------------------------------------------------------
+// File: DynamicResolutionCheck.cpp
+//
+// Runs DynamicResolution.h against synthetic GPU timing traces: a fixed cost plus a cost
+// per pixel that follows a load curve, with noise, and the timings arriving a few frames
+// late as they do from timestamp queries. Checks that light load stays at full scale,
+// heavy load settles under budget without hunting, and load steps are followed both
+// ways. -trace prints the frame-by-frame scale of each scenario.
+//
+// This is a standalone console tool with no Windows or Direct3D dependencies:
+//
+//   g++ -std=c++14 -O2 -I../../Common -o DynamicResolutionCheck DynamicResolutionCheck.cpp
+//   cl /std:c++14 /O2 /EHsc /I..\..\Common DynamicResolutionCheck.cpp
+//
+//   DynamicResolutionCheck [-trace]
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "DynamicResolution.h"
+#include "CheckHarness.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <random>
+
+using namespace DX;
+
+namespace
+{
+    bool g_trace = false;
+
+    constexpr double Budget = 1.0 / 60.0;
+    constexpr size_t Latency = 2;
+
+    struct Result
+    {
+        double  finalScale;
+        size_t  overBudget;         // frames over budget after the settle period
+        size_t  changes;            // scale changes after the settle period
+        double  meanFrameTime;      // after the settle period
+    };
+
+    // perPixel(frame) is the cost in seconds of a frame at scale 1, excluding fixed.
+    Result Simulate(const char* name, size_t frames, size_t settle, double fixed,
+        const std::function<double(size_t)>& perPixel, double noise)
+    {
+        DynamicResolution controller;
+        controller.SetTargetFrameTime(Budget);
+
+        std::mt19937 rng(7);
+        std::normal_distribution<double> jitter(1.0, noise);
+
+        std::deque<double> pending;
+        Result result = {};
+        uint32_t changesAtSettle = 0;
+        double total = 0.0;
+
+        for (size_t frame = 0; frame < frames; ++frame)
+        {
+            const double scale = controller.GetScale();
+            const double time = (fixed + perPixel(frame) * scale * scale) * std::max(jitter(rng), 0.5);
+
+            pending.push_back(time);
+            if (pending.size() > Latency)
+            {
+                controller.Update(pending.front());
+                pending.pop_front();
+            }
+
+            if (frame == settle)
+            {
+                changesAtSettle = controller.GetChangeCount();
+            }
+
+            if (frame >= settle)
+            {
+                result.overBudget += (time > Budget) ? 1 : 0;
+                total += time;
+            }
+
+            if (g_trace && !(frame % 10))
+            {
+                printf("%s %5zu scale %.3f frame %6.2f ms\n", name, frame, scale, time * 1000.0);
+            }
+        }
+
+        result.finalScale = controller.GetScale();
+        result.changes = controller.GetChangeCount() - changesAtSettle;
+        result.meanFrameTime = total / double(frames - settle);
+
+        printf("%-12s scale %.3f  mean %5.2f ms  over budget %3zu/%zu  changes %zu\n",
+            name, result.finalScale, result.meanFrameTime * 1000.0, result.overBudget, frames - settle, result.changes);
+        return result;
+    }
+
+    void CheckRenderSize()
+    {
+        DynamicResolution controller;
+        controller.SetScaleRange(0.5f, 1.f);
+
+        size_t width = 0;
+        size_t height = 0;
+        controller.GetRenderSize(1920, 1080, width, height);
+        Check(width == 1920 && height == 1080, "Scale 1 does not give the full size");
+
+        // Drive the scale to the minimum with a load far over budget.
+        for (int j = 0; j < 100; ++j)
+        {
+            controller.Update(Budget * 4.0);
+        }
+        Check(controller.GetScale() == 0.5f, "Overload does not reach the minimum scale");
+
+        controller.GetRenderSize(1920, 1080, width, height);
+        printf("Render size at scale 0.5: %zux%zu\n", width, height);
+        Check(width == 960 && height == 544, "Render size is not rounded to the granularity");
+        Check(!(width % 8) && !(height % 8), "Render size is not a multiple of 8");
+
+        controller.GetRenderSize(5, 3, width, height);
+        Check(width == 5 && height == 3, "Sizes below one granule are not kept");
+
+        controller.Reset();
+        Check(controller.GetScale() == 1.f, "Reset does not return to the maximum scale");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    for (int j = 1; j < argc; ++j)
+    {
+        if (!strcmp(argv[j], "-trace"))
+        {
+            g_trace = true;
+        }
+        else
+        {
+            printf("Usage: DynamicResolutionCheck [-trace]\n");
+            return 1;
+        }
+    }
+
+    return RunChecks([&]()
+    {
+        const double fixed = 0.002;
+
+        // 8 ms at full resolution: nothing to do.
+        auto light = Simulate("light", 600, 60, fixed, [](size_t) { return 0.006; }, 0.03);
+        Check(light.finalScale == 1.0, "Light load leaves full scale");
+        Check(light.changes == 0, "Light load changes scale");
+
+        // 25 ms at full resolution: the aim of 15 ms needs about 0.75.
+        auto heavy = Simulate("heavy", 1200, 240, fixed, [](size_t) { return 0.023; }, 0.03);
+        Check(heavy.finalScale > 0.65 && heavy.finalScale < 0.85, "Heavy load settles at the wrong scale");
+        Check(heavy.overBudget < 12, "Heavy load still misses the budget after settling");
+        Check(heavy.changes < 20, "Heavy load hunts");
+
+        // Noisy heavy load: the dead band and delay keep the changes down.
+        auto noisy = Simulate("noisy", 1200, 240, fixed, [](size_t) { return 0.023; }, 0.08);
+        Check(noisy.changes < 60, "Noisy load hunts");
+
+        // Load steps up at 2s and back down at 6s.
+        auto step = Simulate("step", 900, 0, fixed, [](size_t frame)
+        {
+            return (frame >= 120 && frame < 360) ? 0.028 : 0.006;
+        }, 0.03);
+        Check(step.finalScale == 1.0, "Scale does not recover after the load drops");
+
+        // Frames over budget after the step up are limited to the reaction time.
+        auto reaction = Simulate("reaction", 360, 150, fixed, [](size_t frame)
+        {
+            return (frame >= 120) ? 0.028 : 0.006;
+        }, 0.0);
+        Check(reaction.overBudget == 0, "Still over budget a half second after a load step");
+
+        // Slowly varying load.
+        auto wave = Simulate("wave", 1800, 120, fixed, [](size_t frame)
+        {
+            return 0.015 + 0.008 * std::sin(double(frame) * 0.01);
+        }, 0.03);
+        Check(wave.overBudget < 36, "Slowly varying load misses the budget too often");
+
+        CheckRenderSize();
+    });
+}
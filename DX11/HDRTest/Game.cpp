@@ -12,7 +12,16 @@ using namespace DirectX::SimpleMath;
 
 using Microsoft::WRL::ComPtr;
 
-Game::Game() noexcept(false)
+Game::Game() noexcept(false) :
+    m_colorScale(1.f),
+    m_exposureCopied{},
+    m_exposureFrame(0),
+    m_exposureWidth(0),
+    m_exposureHeight(0),
+    m_exposureElapsed(0.f),
+    m_histogram(&m_workerPool),
+    m_frameTimed{},
+    m_frameTimer(0)
 {
 #if 0
     m_deviceResources = std::make_unique<DX::DeviceResources>(DXGI_FORMAT_R10G10B10A2_UNORM,
@@ -34,6 +43,8 @@ Game::Game() noexcept(false)
     m_deviceResources->RegisterDeviceNotify(this);
 
     m_hdrScene = std::make_unique<DX::RenderTexture>(DXGI_FORMAT_R16G16B16A16_FLOAT);
+    m_exposureTarget = std::make_unique<DX::RenderTexture>(DXGI_FORMAT_R16G16B16A16_FLOAT);
+    m_upscaled = std::make_unique<DX::RenderTexture>(DXGI_FORMAT_R16G16B16A16_FLOAT);
 }
 
 // Initialize the Direct3D resources required to run.
@@ -88,21 +99,96 @@ void Game::Render()
         return;
     }
 
+    UpdateExposure();
+    UpdateResolution();
+
+    auto context = m_deviceResources->GetD3DDeviceContext();
+
+    context->Begin(m_frameDisjoint[m_frameTimer].Get());
+    context->End(m_frameBegin[m_frameTimer].Get());
+
     Clear();
 
     m_deviceResources->PIXBeginEvent(L"Render");
-    auto context = m_deviceResources->GetD3DDeviceContext();
+
+    const auto output = m_deviceResources->GetOutputSize();
+    const auto outputWidth = size_t(output.right - output.left);
+    const auto outputHeight = size_t(output.bottom - output.top);
+
+    size_t sceneWidth, sceneHeight;
+    m_dynamicResolution.GetRenderSize(outputWidth, outputHeight, sceneWidth, sceneHeight);
+
+    const CD3D11_VIEWPORT sceneViewport(0.f, 0.f, float(sceneWidth), float(sceneHeight));
+    context->RSSetViewports(1, &sceneViewport);
 
     // TODO: Add your rendering code here.
     m_shape->Draw(m_world, m_view, m_proj, XMVectorSetW(Colors::White * m_colorScale, 1.f));
 
     m_deviceResources->PIXEndEvent();
 
+    auto scene = m_hdrScene->GetShaderResourceView();
+
+    if (sceneWidth != outputWidth || sceneHeight != outputHeight)
+    {
+        m_deviceResources->PIXBeginEvent(L"Upscale");
+
+        auto upscaled = m_upscaled->GetRenderTargetView();
+        context->OMSetRenderTargets(1, &upscaled, nullptr);
+
+        auto viewport = m_deviceResources->GetScreenViewport();
+        context->RSSetViewports(1, &viewport);
+
+        // The scene only fills part of m_hdrScene, and the texels past it are stale. Map the
+        // output edges to the centers of the outer scene texels so the bilinear footprint
+        // never reaches past the sub-rect; the quad overhangs the viewport by half a texel.
+        const RECT source = { 0, 0, LONG(sceneWidth), LONG(sceneHeight) };
+        const XMFLOAT2 scale(float(outputWidth) / float(std::max<size_t>(sceneWidth, 2) - 1),
+            float(outputHeight) / float(std::max<size_t>(sceneHeight, 2) - 1));
+        m_spriteBatch->Begin(SpriteSortMode_Immediate, m_states->Opaque(), m_states->LinearClamp());
+        m_spriteBatch->Draw(scene, XMFLOAT2(0.f, 0.f), &source, Colors::White, 0.f, XMFLOAT2(0.5f, 0.5f), scale);
+        m_spriteBatch->End();
+
+        ID3D11ShaderResourceView* nullsrv[] = { nullptr };
+        context->PSSetShaderResources(0, 1, nullsrv);
+
+        scene = m_upscaled->GetShaderResourceView();
+
+        m_deviceResources->PIXEndEvent();
+    }
+
+    m_downScale->SetSourceTexture(scene);
+    m_toneMap->SetHDRSourceTexture(scene);
+
+    m_deviceResources->PIXBeginEvent(L"Exposure");
+
+    // Downscale the scene and queue a copy for the CPU histogram.
+    {
+        auto exposureTarget = m_exposureTarget->GetRenderTargetView();
+        context->OMSetRenderTargets(1, &exposureTarget, nullptr);
+
+        const CD3D11_VIEWPORT viewport(0.f, 0.f, float(m_exposureWidth), float(m_exposureHeight));
+        context->RSSetViewports(1, &viewport);
+
+        m_downScale->Process(context);
+
+        ID3D11ShaderResourceView* nullsrv[] = { nullptr };
+        context->PSSetShaderResources(0, 1, nullsrv);
+
+        context->CopyResource(m_exposureStaging[m_exposureFrame].Get(), m_exposureTarget->GetRenderTarget());
+        m_exposureCopied[m_exposureFrame] = true;
+        m_exposureFrame = (m_exposureFrame + 1) % c_exposureLatency;
+    }
+
+    m_deviceResources->PIXEndEvent();
+
     m_deviceResources->PIXBeginEvent(L"Tonemap");
 
     auto renderTarget = m_deviceResources->GetRenderTargetView();
     context->OMSetRenderTargets(1, &renderTarget, nullptr);
 
+    auto viewport = m_deviceResources->GetScreenViewport();
+    context->RSSetViewports(1, &viewport);
+
 #if 1
     switch (m_deviceResources->GetColorSpace())
     {
@@ -134,6 +220,11 @@ void Game::Render()
 
     m_deviceResources->PIXEndEvent();
 
+    context->End(m_frameEnd[m_frameTimer].Get());
+    context->End(m_frameDisjoint[m_frameTimer].Get());
+    m_frameTimed[m_frameTimer] = true;
+    m_frameTimer = (m_frameTimer + 1) % c_timerLatency;
+
     // Show the new frame.
     m_deviceResources->Present();
 }
@@ -162,6 +253,65 @@ void Game::Clear()
 
     m_deviceResources->PIXEndEvent();
 }
+
+// Histograms the oldest copy in the ring, unless the GPU has not reached it yet, and adapts
+// the tone-map exposure.
+void Game::UpdateExposure()
+{
+    m_exposureElapsed += static_cast<float>(m_timer.GetElapsedSeconds());
+
+    if (!m_exposureCopied[m_exposureFrame])
+        return;
+
+    auto context = m_deviceResources->GetD3DDeviceContext();
+    auto staging = m_exposureStaging[m_exposureFrame].Get();
+
+    D3D11_MAPPED_SUBRESOURCE mapped = {};
+    const HRESULT hr = context->Map(staging, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+    if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+        return;
+
+    DX::ThrowIfFailed(hr);
+
+    m_histogram.Build(mapped.pData, mapped.RowPitch, m_exposureWidth, m_exposureHeight,
+        DX::LuminanceHistogram::Format_R16G16B16A16_FLOAT);
+
+    context->Unmap(staging, 0);
+
+    m_autoExposure.Update(m_histogram, m_exposureElapsed);
+    m_exposureElapsed = 0.f;
+
+    // Only the ACES filmic operator applies exposure; the HDR10 and linear paths use None.
+    m_toneMap->SetExposure(m_autoExposure.GetExposure());
+}
+
+// Feeds the GPU time of the oldest timed frame, once its queries are ready, to the dynamic
+// resolution controller.
+void Game::UpdateResolution()
+{
+    if (!m_frameTimed[m_frameTimer])
+        return;
+
+    auto context = m_deviceResources->GetD3DDeviceContext();
+
+    D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint = {};
+    UINT64 begin = 0;
+    UINT64 end = 0;
+    if (context->GetData(m_frameDisjoint[m_frameTimer].Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK
+        || context->GetData(m_frameBegin[m_frameTimer].Get(), &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK
+        || context->GetData(m_frameEnd[m_frameTimer].Get(), &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+    {
+        // Not ready; this frame's queries replace them.
+        return;
+    }
+
+    m_frameTimed[m_frameTimer] = false;
+
+    if (disjoint.Disjoint || end <= begin || !disjoint.Frequency)
+        return;
+
+    m_dynamicResolution.Update(double(end - begin) / double(disjoint.Frequency));
+}
 #pragma endregion
 
 #pragma region Message Handlers
@@ -230,6 +380,24 @@ void Game::CreateDeviceDependentResources()
 
     m_toneMap = std::make_unique<ToneMapPostProcess>(device);
 
+    m_exposureTarget->SetDevice(device);
+
+    m_downScale = std::make_unique<BasicPostProcess>(device);
+    m_downScale->SetEffect(BasicPostProcess::DownScale_4x4);
+
+    m_upscaled->SetDevice(device);
+    m_states = std::make_unique<CommonStates>(device);
+
+    const CD3D11_QUERY_DESC disjointDesc(D3D11_QUERY_TIMESTAMP_DISJOINT);
+    const CD3D11_QUERY_DESC timestampDesc(D3D11_QUERY_TIMESTAMP);
+    for (size_t j = 0; j < c_timerLatency; ++j)
+    {
+        DX::ThrowIfFailed(device->CreateQuery(&disjointDesc, m_frameDisjoint[j].ReleaseAndGetAddressOf()));
+        DX::ThrowIfFailed(device->CreateQuery(&timestampDesc, m_frameBegin[j].ReleaseAndGetAddressOf()));
+        DX::ThrowIfFailed(device->CreateQuery(&timestampDesc, m_frameEnd[j].ReleaseAndGetAddressOf()));
+        m_frameTimed[j] = false;
+    }
+
 #if 0
     // Set tone-mapper as 'pass-through' for now...
     m_toneMap->SetOperator(ToneMapPostProcess::None);
@@ -250,6 +418,7 @@ void Game::CreateDeviceDependentResources()
 
     auto context = m_deviceResources->GetD3DDeviceContext();
     m_shape = GeometricPrimitive::CreateTeapot(context);
+    m_spriteBatch = std::make_unique<SpriteBatch>(context);
 
     m_world = Matrix::Identity;
 }
@@ -261,9 +430,27 @@ void Game::CreateWindowSizeDependentResources()
 
     auto size = m_deviceResources->GetOutputSize();
     m_hdrScene->SetWindow(size);
+    m_upscaled->SetWindow(size);
 
     m_toneMap->SetHDRSourceTexture(m_hdrScene->GetShaderResourceView());
 
+    // Auto-exposure reads back a quarter-size copy of the scene.
+    m_exposureWidth = std::max<UINT>(UINT(size.right - size.left) / 4, 1);
+    m_exposureHeight = std::max<UINT>(UINT(size.bottom - size.top) / 4, 1);
+    m_exposureTarget->SizeResources(m_exposureWidth, m_exposureHeight);
+
+    auto device = m_deviceResources->GetD3DDevice();
+
+    const CD3D11_TEXTURE2D_DESC stagingDesc(m_exposureTarget->GetFormat(),
+        m_exposureWidth, m_exposureHeight, 1, 1, 0, D3D11_USAGE_STAGING, D3D11_CPU_ACCESS_READ);
+
+    for (size_t j = 0; j < c_exposureLatency; ++j)
+    {
+        DX::ThrowIfFailed(device->CreateTexture2D(&stagingDesc, nullptr,
+            m_exposureStaging[j].ReleaseAndGetAddressOf()));
+        m_exposureCopied[j] = false;
+    }
+
     m_view = Matrix::CreateLookAt(Vector3(2.f, 2.f, 2.f),
         Vector3::Zero, Vector3::UnitY);
     m_proj = Matrix::CreatePerspectiveFieldOfView(XM_PI / 4.f,
@@ -275,6 +462,25 @@ void Game::OnDeviceLost()
     // TODO: Add Direct3D resource cleanup here.
 
     m_hdrScene->ReleaseDevice();
+    m_exposureTarget->ReleaseDevice();
+    m_downScale.reset();
+    for (size_t j = 0; j < c_exposureLatency; ++j)
+    {
+        m_exposureStaging[j].Reset();
+        m_exposureCopied[j] = false;
+    }
+    m_autoExposure.Reset();
+    m_upscaled->ReleaseDevice();
+    m_spriteBatch.reset();
+    m_states.reset();
+    for (size_t j = 0; j < c_timerLatency; ++j)
+    {
+        m_frameDisjoint[j].Reset();
+        m_frameBegin[j].Reset();
+        m_frameEnd[j].Reset();
+        m_frameTimed[j] = false;
+    }
+    m_dynamicResolution.Reset();
     m_toneMap.reset();
     m_shape.reset();
 }
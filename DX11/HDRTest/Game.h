@@ -7,6 +7,8 @@
 #include "DeviceResources.h"
 #include "StepTimer.h"
 #include "RenderTexture.h"
+#include "AutoExposure.h"
+#include "DynamicResolution.h"
 
 // A basic game implementation that creates a D3D11 device and
 // provides a game loop.
@@ -51,6 +53,8 @@ private:
     void Render();
 
     void Clear();
+    void UpdateExposure();
+    void UpdateResolution();
 
     void CreateDeviceDependentResources();
     void CreateWindowSizeDependentResources();
@@ -71,4 +75,36 @@ private:
     std::unique_ptr<DirectX::GeometricPrimitive>    m_shape;
 
     float                                           m_colorScale;
+
+    // Automatic exposure: the scene is downscaled 4x4 and copied to a ring of staging
+    // textures, which are mapped without waiting a few frames later and histogrammed.
+    static constexpr size_t c_exposureLatency = 3;
+
+    std::unique_ptr<DX::RenderTexture>              m_exposureTarget;
+    std::unique_ptr<DirectX::BasicPostProcess>      m_downScale;
+    Microsoft::WRL::ComPtr<ID3D11Texture2D>         m_exposureStaging[c_exposureLatency];
+    bool                                            m_exposureCopied[c_exposureLatency];
+    size_t                                          m_exposureFrame;
+    UINT                                            m_exposureWidth;
+    UINT                                            m_exposureHeight;
+    float                                           m_exposureElapsed;
+
+    DX::WorkerPool                                  m_workerPool;
+    DX::LuminanceHistogram                          m_histogram;
+    DX::AutoExposure                                m_autoExposure;
+
+    // Dynamic resolution: the scene renders into the top-left of m_hdrScene at the scale
+    // picked from GPU frame times, and is upscaled into m_upscaled when below full size.
+    static constexpr size_t c_timerLatency = 3;
+
+    std::unique_ptr<DX::RenderTexture>              m_upscaled;
+    std::unique_ptr<DirectX::SpriteBatch>           m_spriteBatch;
+    std::unique_ptr<DirectX::CommonStates>          m_states;
+    Microsoft::WRL::ComPtr<ID3D11Query>             m_frameDisjoint[c_timerLatency];
+    Microsoft::WRL::ComPtr<ID3D11Query>             m_frameBegin[c_timerLatency];
+    Microsoft::WRL::ComPtr<ID3D11Query>             m_frameEnd[c_timerLatency];
+    bool                                            m_frameTimed[c_timerLatency];
+    size_t                                          m_frameTimer;
+
+    DX::DynamicResolution                           m_dynamicResolution;
 };
@@ -0,0 +1,594 @@
+//--------------------------------------------------------------------------------------
+// File: BoundingVolumeHierarchyCheck.cpp
+//
+// Checks BoundingVolumeHierarchy.h: frustum culls give exactly the boxes a test of every
+// box gives, ray casts find the same nearest hit as a test of every box, after building
+// serially and on a WorkerPool, for uniform, clustered, coincident and flat boxes, and
+// again after moving boxes and refitting. Then times building, culling, refitting and ray
+// casting 100k objects against testing every one.
+//
+// This is a standalone console tool with no Windows or Direct3D dependencies:
+//
+//   g++ -std=c++14 -O2 -msse2 -pthread -I../../Common -o BoundingVolumeHierarchyCheck BoundingVolumeHierarchyCheck.cpp
+//   cl /std:c++14 /O2 /EHsc /I..\..\Common BoundingVolumeHierarchyCheck.cpp
+//
+//   BoundingVolumeHierarchyCheck [-nobench]
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "BoundingVolumeHierarchy.h"
+#include "CheckHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    // Row-vector, right-handed matrices as SimpleMath::Matrix::CreateLookAt and
+    // CreatePerspectiveFieldOfView make them.
+    struct Matrix
+    {
+        float m[16];
+
+        Matrix operator* (const Matrix& other) const
+        {
+            Matrix result = {};
+            for (size_t r = 0; r < 4; ++r)
+            {
+                for (size_t c = 0; c < 4; ++c)
+                {
+                    for (size_t k = 0; k < 4; ++k)
+                    {
+                        result.m[r * 4 + c] += m[r * 4 + k] * other.m[k * 4 + c];
+                    }
+                }
+            }
+            return result;
+        }
+    };
+
+    Matrix LookAt(const float eye[3], const float target[3])
+    {
+        auto normalize = [](float v[3])
+        {
+            const float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+            v[0] /= length;
+            v[1] /= length;
+            v[2] /= length;
+        };
+
+        float z[3] = { eye[0] - target[0], eye[1] - target[1], eye[2] - target[2] };
+        normalize(z);
+        float x[3] = { z[2], 0.f, -z[0] };          // cross((0, 1, 0), z)
+        normalize(x);
+        const float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+
+        auto dot = [&](const float* a) { return a[0] * eye[0] + a[1] * eye[1] + a[2] * eye[2]; };
+
+        return Matrix{ {
+            x[0], y[0], z[0], 0.f,
+            x[1], y[1], z[1], 0.f,
+            x[2], y[2], z[2], 0.f,
+            -dot(x), -dot(y), -dot(z), 1.f } };
+    }
+
+    Matrix Perspective(float fov, float aspect, float nearZ, float farZ)
+    {
+        const float yScale = 1.f / std::tan(fov * 0.5f);
+        const float range = farZ / (nearZ - farZ);
+        return Matrix{ {
+            yScale / aspect, 0.f, 0.f, 0.f,
+            0.f, yScale, 0.f, 0.f,
+            0.f, 0.f, range, -1.f,
+            0.f, 0.f, range * nearZ, 0.f } };
+    }
+
+    Frustum MakeFrustum(const float eye[3], const float target[3], float farZ)
+    {
+        const Matrix viewProj = LookAt(eye, target) * Perspective(0.9f, 16.f / 9.f, 0.1f, farZ);
+        return Frustum::FromViewProjection(viewProj.m);
+    }
+
+    enum class Layout
+    {
+        Uniform,        // scattered through a cube
+        Clustered,      // tight clumps far apart
+        Coincident,     // all at the same center
+        Flat,           // zero thickness in y, as on a floor
+    };
+
+    const char* GetName(Layout layout)
+    {
+        switch (layout)
+        {
+        case Layout::Uniform: return "uniform";
+        case Layout::Clustered: return "clustered";
+        case Layout::Coincident: return "coincident";
+        default: return "flat";
+        }
+    }
+
+    std::vector<AxisAlignedBox> MakeBoxes(size_t count, Layout layout, std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> position(-500.f, 500.f);
+        std::uniform_real_distribution<float> size(0.1f, 4.f);
+        std::normal_distribution<float> spread(0.f, 2.f);
+
+        float clusters[16][3];
+        for (auto& cluster : clusters)
+        {
+            for (float& c : cluster)
+            {
+                c = position(rng);
+            }
+        }
+
+        std::vector<AxisAlignedBox> boxes(count);
+        for (auto& box : boxes)
+        {
+            float center[3] = {};
+            float extents[3] = { size(rng), size(rng), size(rng) };
+            switch (layout)
+            {
+            case Layout::Uniform:
+                center[0] = position(rng);
+                center[1] = position(rng);
+                center[2] = position(rng);
+                break;
+
+            case Layout::Clustered:
+            {
+                const auto& cluster = clusters[rng() % 16];
+                center[0] = cluster[0] + spread(rng);
+                center[1] = cluster[1] + spread(rng);
+                center[2] = cluster[2] + spread(rng);
+                break;
+            }
+
+            case Layout::Coincident:
+                center[0] = 10.f;
+                center[1] = -3.f;
+                center[2] = 7.f;
+                break;
+
+            case Layout::Flat:
+                center[0] = position(rng);
+                center[2] = position(rng);
+                extents[1] = 0.f;
+                break;
+            }
+            box = AxisAlignedBox::FromCenterExtents(center, extents);
+        }
+        return boxes;
+    }
+
+    std::vector<uint32_t> CullAll(const std::vector<AxisAlignedBox>& boxes, const Frustum& frustum)
+    {
+        std::vector<uint32_t> visible;
+        for (size_t j = 0; j < boxes.size(); ++j)
+        {
+            if (boxes[j].IntersectsFrustum(frustum))
+            {
+                visible.push_back(uint32_t(j));
+            }
+        }
+        return visible;
+    }
+
+    float RaycastAll(const std::vector<AxisAlignedBox>& boxes, const float origin[3], const float direction[3], float distance)
+    {
+        const float inverse[3] = { 1.f / direction[0], 1.f / direction[1], 1.f / direction[2] };
+        float nearest = distance;
+        for (const auto& box : boxes)
+        {
+            float enter;
+            if (box.IntersectsRay(origin, inverse, nearest, enter) && enter < nearest)
+            {
+                nearest = enter;
+            }
+        }
+        return nearest;
+    }
+
+    // Frustum culls and ray casts from random views agree with testing every box.
+    void CheckQueries(const BoundingVolumeHierarchy& tree, const std::vector<AxisAlignedBox>& boxes, std::mt19937& rng,
+        bool& cullMatch, bool& rayMatch)
+    {
+        std::uniform_real_distribution<float> position(-700.f, 700.f);
+        std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+        std::vector<uint32_t> visible(boxes.size());
+        for (int view = 0; view < 8; ++view)
+        {
+            const float eye[3] = { position(rng), position(rng), position(rng) };
+            const float target[3] = { position(rng), position(rng) * 0.5f, position(rng) };
+            const auto frustum = MakeFrustum(eye, target, (view & 1) ? 300.f : 2000.f);
+
+            const size_t count = tree.CullFrustum(frustum, visible.data());
+            std::vector<uint32_t> culled(visible.begin(), visible.begin() + ptrdiff_t(count));
+            std::sort(culled.begin(), culled.end());
+            cullMatch &= (culled == CullAll(boxes, frustum));
+        }
+
+        for (int ray = 0; ray < 200; ++ray)
+        {
+            const float origin[3] = { position(rng), position(rng), position(rng) };
+            float direction[3] = { unit(rng), unit(rng), unit(rng) };
+            if (ray % 4 == 0)
+            {
+                // Along an axis, where the other reciprocals are infinite.
+                const size_t axis = size_t(ray / 4) % 3;
+                for (size_t j = 0; j < 3; ++j)
+                {
+                    direction[j] = (j == axis) ? ((ray & 8) ? -1.f : 1.f) : 0.f;
+                }
+            }
+
+            const float limit = (ray & 1) ? 400.f : std::numeric_limits<float>::infinity();
+            float distance = limit;
+            const uint32_t hit = tree.Raycast(origin, direction, distance);
+            const float expected = RaycastAll(boxes, origin, direction, limit);
+
+            if (hit == BoundingVolumeHierarchy::Miss)
+            {
+                rayMatch &= (expected == limit) && (distance == limit);
+            }
+            else
+            {
+                float enter;
+                const float inverse[3] = { 1.f / direction[0], 1.f / direction[1], 1.f / direction[2] };
+                rayMatch &= (distance == expected) && boxes[hit].IntersectsRay(origin, inverse, limit, enter) && (enter == distance);
+            }
+        }
+    }
+
+    void CheckLayout(size_t count, Layout layout, WorkerPool& pool)
+    {
+        std::mt19937 rng(uint32_t(count) * 7 + uint32_t(layout));
+        auto boxes = MakeBoxes(count, layout, rng);
+
+        BoundingVolumeHierarchy serial;
+        serial.Build(boxes.data(), boxes.size());
+
+        BoundingVolumeHierarchy threaded(&pool);
+        threaded.Build(boxes.data(), boxes.size());
+
+        // Everything is reported once by a frustum around the whole scene.
+        const float eye[3] = { 0.f, 0.f, 5000.f };
+        const float target[3] = {};
+        const auto all = MakeFrustum(eye, target, 20000.f);
+        std::vector<uint32_t> visible(count);
+        const size_t allCount = serial.CullFrustum(all, visible.data());
+        std::sort(visible.begin(), visible.end());
+        bool once = (allCount == count);
+        for (size_t j = 0; once && j < count; ++j)
+        {
+            once &= (visible[j] == j);
+        }
+
+        // Tasks build the same subtrees the serial build does.
+        std::vector<uint32_t> threadedVisible(count);
+        const size_t threadedCount = threaded.CullFrustum(all, threadedVisible.data());
+        std::vector<uint32_t> serialVisible(count);
+        serial.CullFrustum(all, serialVisible.data());
+        const bool same = (threaded.GetNodeCount() == serial.GetNodeCount()) && (threadedCount == allCount)
+            && (threadedVisible == serialVisible);
+
+        bool cullMatch = true;
+        bool rayMatch = true;
+        CheckQueries(serial, boxes, rng, cullMatch, rayMatch);
+        CheckQueries(threaded, boxes, rng, cullMatch, rayMatch);
+
+        // Move a third of the boxes, some far, and refit.
+        std::uniform_real_distribution<float> offset(-50.f, 50.f);
+        for (size_t j = 0; j < count; j += 3)
+        {
+            const float delta[3] = { offset(rng), offset(rng) * ((j % 9) ? 1.f : 10.f), offset(rng) };
+            for (size_t axis = 0; axis < 3; ++axis)
+            {
+                boxes[j].minimum[axis] += delta[axis];
+                boxes[j].maximum[axis] += delta[axis];
+            }
+            threaded.Update(j, boxes[j]);
+        }
+        threaded.Refit();
+
+        bool refitMatch = true;
+        CheckQueries(threaded, boxes, rng, refitMatch, refitMatch);
+
+        const auto bounds = threaded.GetBounds();
+        auto expected = AxisAlignedBox::Empty();
+        for (const auto& box : boxes)
+        {
+            expected.Grow(box);
+        }
+        refitMatch &= !memcmp(&bounds, &expected, sizeof(bounds));
+
+        printf("%-10s %7zu boxes  %7zu nodes\n", GetName(layout), count, serial.GetNodeCount());
+
+        Check(once, "Culling everything does not report each box once");
+        Check(same, "Threaded build differs from the serial one");
+        Check(cullMatch, "Frustum cull differs from testing every box");
+        Check(rayMatch, "Ray cast differs from testing every box");
+        Check(refitMatch, "Refitted tree differs from testing every box");
+    }
+
+    void CheckEmpty()
+    {
+        BoundingVolumeHierarchy tree;
+        tree.Build(nullptr, 0);
+
+        const float eye[3] = { 0.f, 0.f, 10.f };
+        const float target[3] = {};
+        uint32_t visible = 0;
+        Check(tree.CullFrustum(MakeFrustum(eye, target, 100.f), &visible) == 0, "Empty tree culled to something");
+
+        const float direction[3] = { 0.f, 0.f, -1.f };
+        float distance = 100.f;
+        Check(tree.Raycast(eye, direction, distance) == BoundingVolumeHierarchy::Miss && distance == 100.f, "Empty tree hit");
+
+        tree.Refit();
+        Check(!tree.GetBounds().IsValid(), "Empty tree has bounds");
+    }
+
+    // The callback sees only boxes the ray enters, and its hits decide the result.
+    void CheckCallback()
+    {
+        std::mt19937 rng(3);
+        const auto boxes = MakeBoxes(1000, Layout::Uniform, rng);
+
+        BoundingVolumeHierarchy tree;
+        tree.Build(boxes.data(), boxes.size());
+
+        // Spheres inscribed in the boxes, and a ray through the first.
+        const float origin[3] = { -600.f, 1.f, 2.f };
+        const float direction[3] =
+        {
+            (boxes[0].minimum[0] + boxes[0].maximum[0]) * 0.5f - origin[0],
+            (boxes[0].minimum[1] + boxes[0].maximum[1]) * 0.5f - origin[1],
+            (boxes[0].minimum[2] + boxes[0].maximum[2]) * 0.5f - origin[2],
+        };
+        const float inverse[3] = { 1.f / direction[0], 1.f / direction[1], 1.f / direction[2] };
+        const float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+
+        auto sphere = [&](uint32_t index, float& distance) -> bool
+        {
+            const auto& box = boxes[index];
+            float center[3];
+            float radius = std::numeric_limits<float>::infinity();
+            for (size_t j = 0; j < 3; ++j)
+            {
+                center[j] = (box.minimum[j] + box.maximum[j]) * 0.5f;
+                radius = std::min(radius, (box.maximum[j] - box.minimum[j]) * 0.5f);
+            }
+
+            const float oc[3] = { origin[0] - center[0], origin[1] - center[1], origin[2] - center[2] };
+            const float b = (oc[0] * direction[0] + oc[1] * direction[1] + oc[2] * direction[2]) / length;
+            const float c = oc[0] * oc[0] + oc[1] * oc[1] + oc[2] * oc[2] - radius * radius;
+            const float discriminant = b * b - c;
+            if (discriminant < 0.f)
+                return false;
+
+            const float t = (-b - std::sqrt(discriminant)) / length;
+            if (t < 0.f || t >= distance)
+                return false;
+
+            distance = t;
+            return true;
+        };
+
+        size_t calls = 0;
+        bool entered = true;
+        float distance = std::numeric_limits<float>::infinity();
+        const uint32_t hit = tree.Raycast(origin, direction, distance, [&](uint32_t index, float& nearest)
+        {
+            ++calls;
+            float enter;
+            entered &= boxes[index].IntersectsRay(origin, inverse, nearest, enter);
+            return sphere(index, nearest);
+        });
+
+        float expected = std::numeric_limits<float>::infinity();
+        uint32_t expectedHit = BoundingVolumeHierarchy::Miss;
+        for (uint32_t j = 0; j < boxes.size(); ++j)
+        {
+            if (sphere(j, expected))
+            {
+                expectedHit = j;
+            }
+        }
+
+        printf("Sphere ray: %u at %.3f after %zu of %zu objects\n", hit, double(distance), calls, boxes.size());
+        Check(entered, "Callback called for a box the ray misses");
+        Check(hit == expectedHit && distance == expected, "Callback ray cast differs from testing every sphere");
+    }
+
+    void CheckErrors()
+    {
+        BoundingVolumeHierarchy tree;
+
+        bool threw = false;
+        try
+        {
+            const AxisAlignedBox inverted = { { 1.f, 0.f, 0.f }, { 0.f, 1.f, 1.f } };
+            tree.Build(&inverted, 1);
+        }
+        catch (const std::invalid_argument&)
+        {
+            threw = true;
+        }
+        Check(threw, "Inverted box accepted");
+
+        threw = false;
+        try
+        {
+            const float nan = std::numeric_limits<float>::quiet_NaN();
+            const AxisAlignedBox box = { { 0.f, 0.f, 0.f }, { 1.f, nan, 1.f } };
+            tree.Build(&box, 1);
+        }
+        catch (const std::invalid_argument&)
+        {
+            threw = true;
+        }
+        Check(threw, "NaN box accepted");
+
+        threw = false;
+        try
+        {
+            const AxisAlignedBox box = { { 0.f, 0.f, 0.f }, { 1.f, 1.f, 1.f } };
+            tree.Build(&box, 1);
+            tree.Update(1, box);
+        }
+        catch (const std::out_of_range&)
+        {
+            threw = true;
+        }
+        Check(threw, "Update out of range accepted");
+    }
+
+    template<typename Func>
+    double Time(Func&& func, int repeat = 20)
+    {
+        func();
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int j = 0; j < repeat; ++j)
+        {
+            func();
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(stop - start).count() / repeat;
+    }
+
+    void Benchmark()
+    {
+        constexpr size_t Count = 100000;
+
+        std::mt19937 rng(11);
+        auto boxes = MakeBoxes(Count, Layout::Uniform, rng);
+
+        WorkerPool pool;
+        BoundingVolumeHierarchy serial;
+        BoundingVolumeHierarchy threaded(&pool);
+        const double buildSerial = Time([&]() { serial.Build(boxes.data(), boxes.size()); }, 5);
+        const double buildThreaded = Time([&]() { threaded.Build(boxes.data(), boxes.size()); }, 5);
+
+        printf("100k objects: build %.2f ms, on %zu threads %.2f ms, %zu nodes\n",
+            buildSerial, pool.GetThreadCount(), buildThreaded, serial.GetNodeCount());
+
+        const float eye[3] = { -400.f, 50.f, -450.f };
+        const float target[3] = { 0.f, 0.f, 0.f };
+        const auto frustum = MakeFrustum(eye, target, 600.f);
+
+        std::vector<uint32_t> visible(Count);
+        size_t count = 0;
+        const double cull = Time([&]() { count = serial.CullFrustum(frustum, visible.data()); }, 200);
+
+        size_t bruteCount = 0;
+        const double brute = Time([&]()
+        {
+            bruteCount = 0;
+            for (uint32_t j = 0; j < Count; ++j)
+            {
+                if (boxes[j].IntersectsFrustum(frustum))
+                {
+                    visible[bruteCount++] = j;
+                }
+            }
+        }, 50);
+
+        printf("100k objects culled to %zu: tree %.3f ms, every box %.3f ms\n", count, cull, brute);
+        Check(count == bruteCount, "Benchmark cull differs from testing every box");
+
+        std::uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+        for (auto& box : boxes)
+        {
+            const float dy = jitter(rng);
+            box.minimum[1] += dy;
+            box.maximum[1] += dy;
+        }
+        const double refit = Time([&]()
+        {
+            for (size_t j = 0; j < Count; ++j)
+            {
+                serial.Update(j, boxes[j]);
+            }
+            serial.Refit();
+        });
+
+        std::uniform_real_distribution<float> position(-500.f, 500.f);
+        std::uniform_real_distribution<float> unit(-1.f, 1.f);
+        std::vector<float> rays(1000 * 6);
+        for (float& r : rays)
+        {
+            r = (&r - rays.data()) % 6 < 3 ? position(rng) : unit(rng);
+        }
+
+        size_t hits = 0;
+        const double cast = Time([&]()
+        {
+            hits = 0;
+            for (size_t j = 0; j < 1000; ++j)
+            {
+                float distance = std::numeric_limits<float>::infinity();
+                hits += (serial.Raycast(&rays[j * 6], &rays[j * 6 + 3], distance) != BoundingVolumeHierarchy::Miss) ? 1 : 0;
+            }
+        }, 5);
+
+        printf("100k objects: update and refit all %.2f ms, 1000 rays %.3f ms (%zu hits)\n", refit, cast, hits);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    bool bench = true;
+    for (int j = 1; j < argc; ++j)
+    {
+        if (!strcmp(argv[j], "-nobench"))
+        {
+            bench = false;
+        }
+        else
+        {
+            printf("Usage: BoundingVolumeHierarchyCheck [-nobench]\n");
+            return 1;
+        }
+    }
+
+#if defined(BOUNDINGVOLUMEHIERARCHY_SSE2)
+    printf("SSE2 path\n");
+#else
+    printf("Scalar path\n");
+#endif
+
+    return RunChecks([&]()
+    {
+        CheckEmpty();
+        CheckErrors();
+        CheckCallback();
+
+        WorkerPool pool(4);
+        for (auto layout : { Layout::Uniform, Layout::Clustered, Layout::Coincident, Layout::Flat })
+        {
+            for (size_t count : { 1, 2, 5, 17, 1000, 30000 })
+            {
+                CheckLayout(count, layout, pool);
+            }
+        }
+
+        if (bench)
+        {
+            Benchmark();
+        }
+    });
+}
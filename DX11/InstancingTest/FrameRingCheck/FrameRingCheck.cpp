@@ -0,0 +1,272 @@
+//--------------------------------------------------------------------------------------
+// File: FrameRingCheck.cpp
+//
+// Checks FrameRingAllocator.h against a mock fence: a simulated GPU completes frames a
+// few frames behind the CPU, and every live allocation is tracked so overlaps, writes out
+// of bounds, and regions freed before their fence are caught. Also covers alignment,
+// wrap-around, a full ring, and the error cases.
+//
+// This is a standalone console tool with no Windows or Direct3D dependencies:
+//
+//   g++ -std=c++14 -O2 -I../../Common -o FrameRingCheck FrameRingCheck.cpp
+//   cl /std:c++14 /O2 /EHsc /I..\..\Common FrameRingCheck.cpp
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "FrameRingAllocator.h"
+#include "CheckHarness.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    // Stands in for ID3D12Fence or a ring of event queries: Signal is queued on the CPU and
+    // the GPU reaches it latency frames later.
+    class MockFence
+    {
+    public:
+        explicit MockFence(size_t latency) : m_latency(latency), m_completed(0) {}
+
+        void Signal(uint64_t value)
+        {
+            m_queued.push_back(value);
+            if (m_queued.size() > m_latency)
+            {
+                m_completed = m_queued.front();
+                m_queued.pop_front();
+            }
+        }
+
+        // Blocks until the given value completes.
+        void Wait(uint64_t value)
+        {
+            while (m_completed < value && !m_queued.empty())
+            {
+                m_completed = m_queued.front();
+                m_queued.pop_front();
+            }
+        }
+
+        uint64_t GetCompletedValue() const { return m_completed; }
+
+    private:
+        size_t                  m_latency;
+        uint64_t                m_completed;
+        std::deque<uint64_t>    m_queued;
+    };
+
+    struct Region
+    {
+        size_t      begin;
+        size_t      end;
+        uint64_t    fenceValue;     // 0 while the frame is open
+    };
+
+    struct Stats
+    {
+        size_t  allocations;
+        size_t  waits;
+        size_t  wraps;
+    };
+
+    Stats Simulate(const char* name, size_t capacity, size_t latency, size_t frames, size_t maxDraws, size_t maxSize, unsigned int seed)
+    {
+        FrameRingAllocator ring(capacity, latency + 2);
+        MockFence fence(latency);
+
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<size_t> draws(1, maxDraws);
+        std::uniform_int_distribution<size_t> sizes(1, maxSize);
+        std::uniform_int_distribution<int> alignments(0, 8);
+
+        std::vector<Region> live;
+        Stats stats = {};
+        uint64_t fenceValue = 0;
+        size_t lastOffset = 0;
+        bool overlap = false;
+        bool bounds = false;
+        bool alignment = true;
+
+        for (size_t frame = 0; frame < frames; ++frame)
+        {
+            // Free whatever the GPU has finished with.
+            ring.Retire(fence.GetCompletedValue());
+            live.erase(std::remove_if(live.begin(), live.end(), [&](const Region& r)
+            {
+                return r.fenceValue && r.fenceValue <= fence.GetCompletedValue();
+            }), live.end());
+
+            const size_t count = draws(rng);
+            for (size_t j = 0; j < count; ++j)
+            {
+                const size_t size = sizes(rng);
+                const size_t align = size_t(1) << alignments(rng);
+
+                size_t offset = ring.Allocate(size, align);
+                while (offset == FrameRingAllocator::Invalid && ring.GetFramesInFlight())
+                {
+                    // Full: wait for the oldest frame, as the DX12 sample does.
+                    ++stats.waits;
+                    fence.Wait(ring.GetOldestFenceValue());
+                    ring.Retire(fence.GetCompletedValue());
+                    live.erase(std::remove_if(live.begin(), live.end(), [&](const Region& r)
+                    {
+                        return r.fenceValue && r.fenceValue <= fence.GetCompletedValue();
+                    }), live.end());
+                    offset = ring.Allocate(size, align);
+                }
+
+                if (offset == FrameRingAllocator::Invalid)
+                {
+                    // The open frame alone fills the ring; a real caller would end the frame.
+                    break;
+                }
+
+                ++stats.allocations;
+                stats.wraps += (offset < lastOffset) ? 1 : 0;
+                lastOffset = offset;
+
+                bounds |= (offset + size > capacity);
+                alignment &= !(offset % align);
+                for (auto& it : live)
+                {
+                    overlap |= (offset < it.end && it.begin < offset + size);
+                }
+
+                live.push_back({ offset, offset + size, 0 });
+            }
+
+            ++fenceValue;
+            ring.EndFrame(fenceValue);
+            fence.Signal(fenceValue);
+            for (auto& it : live)
+            {
+                if (!it.fenceValue)
+                {
+                    it.fenceValue = fenceValue;
+                }
+            }
+        }
+
+        printf("%-10s allocations %6zu  wraps %5zu  waits %5zu\n", name, stats.allocations, stats.wraps, stats.waits);
+
+        Check(!overlap, "Live allocations overlap");
+        Check(!bounds, "Allocation past the end of the ring");
+        Check(alignment, "Allocation not aligned");
+
+        // Once the GPU is idle everything is free again.
+        fence.Wait(fenceValue);
+        ring.Retire(fence.GetCompletedValue());
+        Check(!ring.GetUsedBytes() && !ring.GetFramesInFlight(), "Bytes still in use after the GPU is idle");
+
+        return stats;
+    }
+
+    void CheckBasics()
+    {
+        FrameRingAllocator ring(1024, 4);
+
+        Check(ring.Allocate(100) == 0, "First allocation is not at 0");
+        Check(ring.Allocate(10, 64) == 128, "Alignment not applied");
+        ring.EndFrame(1);
+
+        Check(ring.Allocate(800) == 144, "Second frame does not follow the first");
+        ring.EndFrame(2);
+
+        // 80 bytes are left at the end but the first frame is still in flight.
+        Check(ring.Allocate(100) == FrameRingAllocator::Invalid, "Allocation overwrites a frame in flight");
+
+        ring.Retire(1);
+        Check(ring.GetFramesInFlight() == 1, "Retire did not free the first frame");
+
+        // Does not fit at the end, so wraps to 0 and skips the last 80 bytes. The second
+        // frame took 806 bytes including the padding after the first.
+        Check(ring.Allocate(100) == 0, "Allocation does not wrap");
+        Check(ring.GetUsedBytes() == 806 + 80 + 100, "Skipped bytes not accounted");
+
+        // The tail is at 138, where the first frame ended.
+        Check(ring.Allocate(39, 4) == FrameRingAllocator::Invalid, "Wrapped allocation runs into the tail");
+        Check(ring.Allocate(38, 4) == 100, "Wrapped allocation does not use the space before the tail");
+        ring.EndFrame(3);
+
+        ring.Retire(3);
+        Check(!ring.GetUsedBytes() && !ring.GetFramesInFlight(), "Retire did not free everything");
+        Check(ring.Allocate(1024) == 0, "Empty ring does not restart at 0");
+
+        // Frames with no allocations take no slot.
+        ring.Reset();
+        for (uint64_t j = 1; j < 20; ++j)
+        {
+            ring.EndFrame(j);
+        }
+        Check(!ring.GetFramesInFlight(), "Empty frames are tracked");
+
+        // An allocation that exactly fills the end leaves the head at 0.
+        ring.Reset();
+        Check(ring.Allocate(1000) == 0 && ring.Allocate(24, 4) == 1000, "Exact fill failed");
+        ring.EndFrame(30);
+        ring.Retire(30);
+        Check(ring.Allocate(16) == 0, "Head does not wrap after an exact fill");
+    }
+
+    template<typename Exception, typename Func>
+    void CheckThrows(const char* what, Func&& func)
+    {
+        bool threw = false;
+        try
+        {
+            func();
+        }
+        catch (const Exception&)
+        {
+            threw = true;
+        }
+        Check(threw, what);
+    }
+
+    void CheckErrors()
+    {
+        FrameRingAllocator ring(256, 2);
+
+        CheckThrows<std::invalid_argument>("Oversized allocation accepted", [&]() { ring.Allocate(257); });
+        CheckThrows<std::invalid_argument>("Empty allocation accepted", [&]() { ring.Allocate(0); });
+        CheckThrows<std::invalid_argument>("Bad alignment accepted", [&]() { ring.Allocate(4, 12); });
+
+        ring.Allocate(16);
+        ring.EndFrame(5);
+        ring.Allocate(16);
+        CheckThrows<std::invalid_argument>("Decreasing fence value accepted", [&]() { ring.EndFrame(5); });
+        ring.EndFrame(6);
+
+        ring.Allocate(16);
+        CheckThrows<std::logic_error>("Too many frames in flight accepted", [&]() { ring.EndFrame(7); });
+    }
+}
+
+int main()
+{
+    return RunChecks([&]()
+    {
+        CheckBasics();
+        CheckErrors();
+
+        // Instance data: one large block per frame, three frames of latency.
+        Simulate("instances", 48 * 64 * 4, 3, 2000, 1, 48 * 64, 1);
+
+        // Many small dynamic draws with mixed alignment.
+        auto small = Simulate("small", 64 * 1024, 2, 5000, 200, 256, 2);
+        Check(small.wraps > 100, "Small draws never wrap");
+
+        // A ring too small for the latency: allocations wait on the fence instead of overlapping.
+        auto tight = Simulate("tight", 16 * 1024, 3, 2000, 40, 512, 3);
+        Check(tight.waits > 0, "Tight ring never waits");
+    });
+}
@@ -12,8 +12,40 @@ using namespace DirectX::SimpleMath;
 
 using Microsoft::WRL::ComPtr;
 
+namespace
+{
+    // The grid is c_gridSize instances square; raise it (e.g. to 1024 for 1M instances) to
+    // stress the per-frame instance update.
+    constexpr size_t c_gridSize = 8;
+    constexpr float c_gridSpacing = 1.5f;
+
+    // Bounding sphere of GeometricPrimitive::CreateSphere's unit diameter.
+    constexpr float c_instanceRadius = 0.5f;
+
+    // Tessellation of each level of detail, and the projected size (fraction of the view
+    // height) below which each level after the first takes over. Drop entries from both to use
+    // fewer levels. The size is about c_instanceRadius * m_proj._22 / distance, with _22 about
+    // 2.41, and the instances are 10 to 16 units from the eye. These switch levels at about
+    // 12, 13 and 14 units, near the quartiles of those distances, so each level draws about
+    // a quarter of the grid. Rescale them if the camera or the grid changes.
+    constexpr size_t c_lodTessellation[] = { 16, 10, 6, 4 };
+    constexpr float c_lodScreenSizes[] = { 0.1f, 0.093f, 0.087f };
+
+    static_assert(std::size(c_lodScreenSizes) + 1 == std::size(c_lodTessellation), "One tessellation per level");
+    static_assert(std::size(c_lodTessellation) <= DX::LodSelector::MaxLevels, "Too many levels of detail");
+
+    // Frames between reports of the cull ratio.
+    constexpr uint64_t c_cullReportFrames = 300;
+}
+
 Game::Game() noexcept(false) :
-    m_instanceCount(0)
+    m_instanceCount(0),
+    m_visibleCount(0),
+    m_levelCounts{},
+    m_animator(&m_workerPool),
+    m_frameFence(0),
+    m_completedFence(0),
+    m_discardRing(true)
 {
     m_deviceResources = std::make_unique<DX::DeviceResources>();
     m_deviceResources->RegisterDeviceNotify(this);
@@ -57,24 +89,6 @@ void Game::Update(DX::StepTimer const& timer)
 
     // TODO: Add your game logic here.
     elapsedTime;
-
-    // Update instance transforms.
-#if 1
-    auto time = static_cast<float>(m_timer.GetTotalSeconds());
-
-    size_t j = 0;
-    for (float y = -6.f; y < 6.f; y += 1.5f)
-    {
-        for (float x = -6.f; x < 6.f; x += 1.5f)
-        {
-            XMMATRIX m = XMMatrixTranslation(x, y, cos(time + float(x) * XM_PIDIV4) * sin(time + float(y) * XM_PIDIV4) * 2.f);
-            XMStoreFloat3x4(&m_instanceTransforms[j], m);
-            ++j;
-        }
-    }
-
-    assert(j == m_instanceCount);
-#endif
 }
 #pragma endregion
 
@@ -94,19 +108,83 @@ void Game::Render()
     auto context = m_deviceResources->GetD3DDeviceContext();
 
     // TODO: Add your rendering code here.
+    // Free the instance data of the frames the GPU has finished.
+    while (m_completedFence < m_frameFence)
+    {
+        BOOL done = FALSE;
+        if (context->GetData(m_frameQueries[(m_completedFence + 1) % c_ringFrames].Get(),
+            &done, sizeof(done), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+            break;
+
+        ++m_completedFence;
+    }
+    m_instanceRing.Retire(m_completedFence);
+
+    size_t instOffset = DX::FrameRingAllocator::Invalid;
+    if (!m_discardRing && (m_frameFence - m_completedFence) < c_ringFrames)
+    {
+        instOffset = m_instanceRing.Allocate(m_animator.GetQuantizedSizeInBytes());
+    }
+
+    D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+    if (instOffset == DX::FrameRingAllocator::Invalid)
+    {
+        // No room, or no free query: let the driver rename the buffer and start over.
+        m_instanceRing.Reset();
+        m_completedFence = m_frameFence;
+        m_discardRing = false;
+        instOffset = m_instanceRing.Allocate(m_animator.GetQuantizedSizeInBytes());
+        mapType = D3D11_MAP_WRITE_DISCARD;
+    }
+
 #if 1
     {
-        MapGuard map(context, m_instancedVB.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0);
-        memcpy(map.pData, m_instanceTransforms.get(), m_instanceCount * sizeof(XMFLOAT3X4));
+        // The instances in view are quantized straight into the mapping, 16 bytes each,
+        // grouped by level of detail.
+        const Matrix viewProj = m_view * m_proj;
+        const auto frustum = DX::Frustum::FromViewProjection(&viewProj._11);
+
+        const Vector3 eye = m_view.Invert().Translation();
+        const auto lods = DX::LodSelector::FromScreenSizes(&eye.x, m_proj._22, c_instanceRadius,
+            c_lodScreenSizes, std::size(c_lodScreenSizes));
+
+        MapGuard map(context, m_quantizedRing.Get(), 0, mapType, 0);
+        m_visibleCount = static_cast<UINT>(m_animator.WriteVisibleQuantized(static_cast<float>(m_timer.GetTotalSeconds()),
+            frustum, c_instanceRadius, static_cast<uint8_t*>(map.pData) + instOffset, lods, m_levelCounts));
     }
 #endif
 
-    m_shape->DrawInstanced(m_effect.get(), m_instanceLayout.Get(), m_instanceCount, false, false, 0, [=]()
-        {
-            UINT stride = sizeof(XMFLOAT3X4);
-            UINT offset = 0;
-            context->IASetVertexBuffers(1, 1, m_instancedVB.GetAddressOf(), &stride, &offset);
-        });
+    if (!(m_timer.GetFrameCount() % c_cullReportFrames))
+    {
+        char buff[160] = {};
+        sprintf_s(buff, "Culling: %u of %u instances visible (%.1f%% culled), per LOD %zu/%zu/%zu/%zu\n",
+            m_visibleCount, m_instanceCount,
+            m_instanceCount ? 100.0 * double(m_instanceCount - m_visibleCount) / double(m_instanceCount) : 0.0,
+            m_levelCounts[0], m_levelCounts[1], m_levelCounts[2], m_levelCounts[3]);
+        OutputDebugStringA(buff);
+    }
+
+    // One draw per level of detail, each from its range of the frame's instances. They are
+    // read from the ring as they were written and decoded by the vertex shader.
+    UINT startInstance = 0;
+    for (size_t level = 0; level < std::size(c_lodTessellation); ++level)
+    {
+        const auto count = static_cast<UINT>(m_levelCounts[level]);
+        if (!count)
+            continue;
+
+        m_shapes[level]->DrawInstanced(m_effect.get(), m_instanceLayout.Get(), count, false, false, startInstance, [=]()
+            {
+                UINT stride = sizeof(DX::QuantizedInstance);
+                UINT offset = static_cast<UINT>(instOffset);
+                context->IASetVertexBuffers(1, 1, m_quantizedRing.GetAddressOf(), &stride, &offset);
+            });
+        startInstance += count;
+    }
+
+    ++m_frameFence;
+    context->End(m_frameQueries[m_frameFence % c_ringFrames].Get());
+    m_instanceRing.EndFrame(m_frameFence);
 
     m_deviceResources->PIXEndEvent();
 
@@ -193,7 +271,10 @@ void Game::CreateDeviceDependentResources()
 
     // TODO: Initialize device dependent objects here (independent of window size).
     auto context = m_deviceResources->GetD3DDeviceContext();
-    m_shape = GeometricPrimitive::CreateSphere(context);
+    for (size_t level = 0; level < std::size(c_lodTessellation); ++level)
+    {
+        m_shapes[level] = GeometricPrimitive::CreateSphere(context, 1.f, c_lodTessellation[level]);
+    }
 
     DX::ThrowIfFailed(CreateDDSTextureFromFile(device, L"spnza_bricks_a.DDS",
         nullptr, m_brickDiffuse.ReleaseAndGetAddressOf()));
@@ -204,21 +285,18 @@ void Game::CreateDeviceDependentResources()
     DX::ThrowIfFailed(CreateDDSTextureFromFile(device, L"spnza_bricks_a_specular.DDS",
         nullptr, m_brickSpecular.ReleaseAndGetAddressOf()));
 
-    m_effect = std::make_unique<NormalMapEffect>(device);
+    m_effect = std::make_unique<DX::QuantizedInstanceEffect>(device);
     m_effect->EnableDefaultLighting();
     m_effect->SetTexture(m_brickDiffuse.Get());
     m_effect->SetNormalTexture(m_brickNormal.Get());
     m_effect->SetSpecularTexture(m_brickSpecular.Get());
-    m_effect->SetInstancingEnabled(true);
 
     const D3D11_INPUT_ELEMENT_DESC c_InputElements[] =
     {
-        { "SV_Position", 0, DXGI_FORMAT_R32G32B32_FLOAT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA,   0 },
-        { "NORMAL",      0, DXGI_FORMAT_R32G32B32_FLOAT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA,   0 },
-        { "TEXCOORD",    0, DXGI_FORMAT_R32G32_FLOAT,       0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA,   0 },
-        { "InstMatrix",  0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
-        { "InstMatrix",  1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
-        { "InstMatrix",  2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "SV_Position",   0, DXGI_FORMAT_R32G32B32_FLOAT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA,   0 },
+        { "NORMAL",        0, DXGI_FORMAT_R32G32B32_FLOAT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA,   0 },
+        { "TEXCOORD",      0, DXGI_FORMAT_R32G32_FLOAT,       0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA,   0 },
+        { "InstQuantized", 0, DXGI_FORMAT_R32G32B32A32_UINT,  1, 0,                            D3D11_INPUT_PER_INSTANCE_DATA, 1 },
     };
 
     DX::ThrowIfFailed(
@@ -228,43 +306,60 @@ void Game::CreateDeviceDependentResources()
 
     // Create instance transforms.
     {
-        size_t j = 0;
-        for (float y = -6.f; y < 6.f; y += 1.5f)
-        {
-            for (float x = -6.f; x < 6.f; x += 1.5f)
-            {
-                ++j;
-            }
-        }
-        m_instanceCount = static_cast<UINT>(j);
+        const float origin = -c_gridSpacing * float(c_gridSize) * 0.5f;
+        m_animator.SetGrid(c_gridSize, c_gridSize, origin, origin, c_gridSpacing);
+        m_animator.SetWave(XM_PIDIV4, 2.f);
+
+        m_instanceCount = static_cast<UINT>(m_animator.GetCount());
 
-        m_instanceTransforms = std::make_unique<XMFLOAT3X4[]>(j);
+        static_assert(sizeof(DX::QuantizedInstance) == 4 * sizeof(uint32_t), "Instance layout mismatch");
 
-        constexpr XMFLOAT3X4 s_identity = { 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f };
+        // Room for a frame of instances per query; each Render writes its own region.
+        const size_t ringBytes = m_animator.GetQuantizedSizeInBytes() * c_ringFrames;
+        m_instanceRing = DX::FrameRingAllocator(ringBytes, c_ringFrames);
+        m_frameFence = m_completedFence = 0;
+        m_discardRing = true;
 
-        j = 0;
-        for (float y = -6.f; y < 6.f; y += 1.5f)
+        const CD3D11_QUERY_DESC queryDesc(D3D11_QUERY_EVENT);
+        for (size_t j = 0; j < c_ringFrames; ++j)
         {
-            for (float x = -6.f; x < 6.f; x += 1.5f)
-            {
-                m_instanceTransforms[j] = s_identity;
-                m_instanceTransforms[j]._14 = x;
-                m_instanceTransforms[j]._24 = y;
-                ++j;
-            }
+            DX::ThrowIfFailed(device->CreateQuery(&queryDesc, m_frameQueries[j].ReleaseAndGetAddressOf()));
         }
 
+        // The ring is the instance vertex buffer.
         auto desc = CD3D11_BUFFER_DESC(
-            static_cast<UINT>(j * sizeof(XMFLOAT3X4)),
+            static_cast<UINT>(ringBytes),
             D3D11_BIND_VERTEX_BUFFER,
             D3D11_USAGE_DYNAMIC,
             D3D11_CPU_ACCESS_WRITE);
 
-        D3D11_SUBRESOURCE_DATA initData = { m_instanceTransforms.get(), 0, 0 };
+        DX::ThrowIfFailed(
+            device->CreateBuffer(&desc, nullptr, m_quantizedRing.ReleaseAndGetAddressOf())
+        );
+    }
+
+    // Create the cluster table. The clusters only change with the grid.
+    {
+        static_assert(sizeof(DX::InstanceCluster) == 2 * sizeof(XMFLOAT4), "Cluster layout mismatch");
+
+        const auto& clusters = m_animator.GetClusters();
+        const auto elements = static_cast<UINT>(clusters.size() * 2);
+        auto desc = CD3D11_BUFFER_DESC(elements * static_cast<UINT>(sizeof(XMFLOAT4)),
+            D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_IMMUTABLE);
 
+        const D3D11_SUBRESOURCE_DATA initData = { clusters.data(), 0, 0 };
         DX::ThrowIfFailed(
-            device->CreateBuffer(&desc, &initData, m_instancedVB.ReleaseAndGetAddressOf())
+            device->CreateBuffer(&desc, &initData, m_clusters.ReleaseAndGetAddressOf())
         );
+
+        const auto srvDesc = CD3D11_SHADER_RESOURCE_VIEW_DESC(D3D11_SRV_DIMENSION_BUFFER,
+            DXGI_FORMAT_R32G32B32A32_FLOAT, 0, elements);
+
+        DX::ThrowIfFailed(
+            device->CreateShaderResourceView(m_clusters.Get(), &srvDesc, m_clustersSRV.ReleaseAndGetAddressOf())
+        );
+
+        m_effect->SetClusters(m_clustersSRV.Get());
     }
 }
 
@@ -286,9 +381,18 @@ void Game::OnDeviceLost()
 {
     // TODO: Add Direct3D resource cleanup here.
     m_effect.reset();
-    m_shape.reset();
+    for (auto& shape : m_shapes)
+    {
+        shape.reset();
+    }
     m_instanceLayout.Reset();
-    m_instancedVB.Reset();
+    m_quantizedRing.Reset();
+    m_clusters.Reset();
+    m_clustersSRV.Reset();
+    for (auto& it : m_frameQueries)
+    {
+        it.Reset();
+    }
     m_brickDiffuse.Reset();
     m_brickNormal.Reset();
     m_brickSpecular.Reset();
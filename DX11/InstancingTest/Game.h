@@ -6,6 +6,9 @@
 
 #include "DeviceResources.h"
 #include "StepTimer.h"
+#include "InstanceAnimator.h"
+#include "FrameRingAllocator.h"
+#include "QuantizedInstanceEffect.h"
 
 
 // A basic game implementation that creates a D3D11 device and
@@ -63,15 +66,37 @@ private:
     DirectX::SimpleMath::Matrix                         m_view;
     DirectX::SimpleMath::Matrix                         m_proj;
 
-    std::unique_ptr<DirectX::NormalMapEffect>           m_effect;
-    std::unique_ptr<DirectX::GeometricPrimitive>        m_shape;
+    std::unique_ptr<DX::QuantizedInstanceEffect>        m_effect;
+
+    // Spheres from most to least detailed; instances are bucketed by projected size and
+    // each level is drawn from its own contiguous range of the frame's instances.
+    std::unique_ptr<DirectX::GeometricPrimitive>        m_shapes[DX::LodSelector::MaxLevels];
 
     Microsoft::WRL::ComPtr<ID3D11InputLayout>           m_instanceLayout;
-    Microsoft::WRL::ComPtr<ID3D11Buffer>                m_instancedVB;
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_brickDiffuse;
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_brickNormal;
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_brickSpecular;
 
     UINT                                                m_instanceCount;
-    std::unique_ptr<DirectX::XMFLOAT3X4[]>              m_instanceTransforms;
+    UINT                                                m_visibleCount;
+    size_t                                              m_levelCounts[DX::LodSelector::MaxLevels];
+    DX::WorkerPool                                      m_workerPool;
+    DX::InstanceAnimator                                m_animator;
+
+    // Quantized instances are suballocated from a ring over m_quantizedRing, mapped
+    // NO_OVERWRITE, and drawn straight from it as 16-byte instance data that the effect's
+    // vertex shader decodes. Each frame ends with an event query whose fence value retires
+    // its region.
+    static constexpr size_t c_ringFrames = 4;
+
+    DX::FrameRingAllocator                              m_instanceRing;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>                m_quantizedRing;
+    Microsoft::WRL::ComPtr<ID3D11Query>                 m_frameQueries[c_ringFrames];
+    uint64_t                                            m_frameFence;
+    uint64_t                                            m_completedFence;
+    bool                                                m_discardRing;
+
+    // The position origin and step of each cluster, read by the vertex shader.
+    Microsoft::WRL::ComPtr<ID3D11Buffer>                m_clusters;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_clustersSRV;
 };
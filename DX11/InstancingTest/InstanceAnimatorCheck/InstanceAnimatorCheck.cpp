@@ -0,0 +1,608 @@
+//--------------------------------------------------------------------------------------
+// File: InstanceAnimatorCheck.cpp
+//
+// Checks InstanceAnimator.h: the batched SIMD writer against the per-instance reference
+// and against std::cos/std::sin, grids whose counts are not a multiple of the batch, bytes
+// past the end left untouched, and identical output when split across a WorkerPool. The
+// culled writer is checked against Frustum::IntersectsSphere instance by instance, and the
+// frustum planes against clip space, and the quantized writer against the culled one
+// through QuantizedInstance::Decode. With a LodSelector, each level's range is checked to
+// hold exactly the survivors LodSelector::Select puts there, in instance order. Then times a million instances against the scalar
+// loop plus copy that InstancingTest used, with and without culling and LOD bucketing.
+//
+// This is a standalone console tool with no Windows or Direct3D dependencies:
+//
+//   g++ -std=c++14 -O2 -msse2 -pthread -I../../Common -o InstanceAnimatorCheck InstanceAnimatorCheck.cpp
+//   cl /std:c++14 /O2 /EHsc /I..\..\Common InstanceAnimatorCheck.cpp
+//
+// Add -mavx (or /arch:AVX) to check the AVX path.
+//
+//   InstanceAnimatorCheck [-nobench]
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "InstanceAnimator.h"
+#include "CheckHarness.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    constexpr float Spacing = 1.5f;
+    constexpr float Frequency = 0.78539816f;
+    constexpr float Amplitude = 2.f;
+    constexpr float Guard = -12345.f;
+
+    // 16-byte aligned floats with a guard band after the transforms.
+    struct Buffer
+    {
+        explicit Buffer(size_t count) :
+            m_storage(count * InstanceAnimator::TransformFloats + 64 + 4, Guard)
+        {
+            auto address = reinterpret_cast<uintptr_t>(m_storage.data());
+            m_data = m_storage.data() + ((16 - (address & 15)) & 15) / sizeof(float);
+            m_count = count;
+        }
+
+        float* Get() { return m_data; }
+
+        bool GuardIntact() const
+        {
+            for (size_t j = m_count * InstanceAnimator::TransformFloats; j < m_count * InstanceAnimator::TransformFloats + 60; ++j)
+            {
+                if (m_data[j] != Guard)
+                    return false;
+            }
+            return true;
+        }
+
+        std::vector<float>  m_storage;
+        float*              m_data;
+        size_t              m_count;
+    };
+
+    InstanceAnimator MakeAnimator(size_t columns, size_t rows, WorkerPool* pool = nullptr)
+    {
+        InstanceAnimator animator(pool);
+        animator.SetGrid(columns, rows, -6.f, -6.f, Spacing);
+        animator.SetWave(Frequency, Amplitude);
+        return animator;
+    }
+
+    void CheckGrid(size_t columns, size_t rows, float time)
+    {
+        const auto animator = MakeAnimator(columns, rows);
+        const size_t count = animator.GetCount();
+
+        Buffer buffer(count);
+        animator.Write(time, buffer.Get());
+
+        double maxReference = 0.0;
+        double maxExact = 0.0;
+        bool layout = true;
+
+        for (size_t j = 0; j < count; ++j)
+        {
+            const float* t = buffer.Get() + j * InstanceAnimator::TransformFloats;
+
+            float expected[InstanceAnimator::TransformFloats];
+            animator.GetTransform(j, time, expected);
+
+            for (size_t k = 0; k < InstanceAnimator::TransformFloats; ++k)
+            {
+                if (k != 11 && t[k] != expected[k])
+                {
+                    layout = false;
+                }
+            }
+            maxReference = std::max(maxReference, double(std::fabs(t[11] - expected[11])));
+
+            const float x = -6.f + Spacing * float(j % columns);
+            const float y = -6.f + Spacing * float(j / columns);
+            const double exact = double(Amplitude) * std::cos(double(time + x * Frequency)) * std::sin(double(time + y * Frequency));
+            maxExact = std::max(maxExact, std::fabs(double(t[11]) - exact));
+        }
+
+        printf("%4zux%-4zu t=%8.2f  vs reference %.2e  vs exact %.2e\n", columns, rows, time, maxReference, maxExact);
+
+        Check(layout, "Rows or positions differ from the reference");
+        Check(maxReference < 1e-6, "SIMD and scalar waves differ");
+        Check(maxExact < 2e-6, "Wave differs from std::cos and std::sin");
+        Check(buffer.GuardIntact(), "Write went past the end of the buffer");
+    }
+
+    void CheckThreaded()
+    {
+        WorkerPool pool(4);
+        const auto threaded = MakeAnimator(1000, 1001, &pool);
+        const auto single = MakeAnimator(1000, 1001);
+
+        Buffer a(threaded.GetCount());
+        Buffer b(single.GetCount());
+
+        for (float time : { 0.f, 2.5f, 77.f })
+        {
+            threaded.Write(time, a.Get());
+            single.Write(time, b.Get());
+            Check(!memcmp(a.Get(), b.Get(), threaded.GetSizeInBytes()), "Threaded output differs");
+            Check(a.GuardIntact(), "Threaded write went past the end of the buffer");
+        }
+    }
+
+    void CheckErrors()
+    {
+        const auto animator = MakeAnimator(8, 8);
+        Buffer buffer(animator.GetCount() + 1);
+
+        bool threw = false;
+        try
+        {
+            animator.Write(0.f, buffer.Get() + 1);
+        }
+        catch (const std::invalid_argument&)
+        {
+            threw = true;
+        }
+        Check(threw, "Unaligned destination accepted");
+
+        threw = false;
+        try
+        {
+            InstanceAnimator empty;
+            empty.SetGrid(0, 8, 0.f, 0.f, 1.f);
+        }
+        catch (const std::invalid_argument&)
+        {
+            threw = true;
+        }
+        Check(threw, "Empty grid accepted");
+    }
+
+    // Row-vector, right-handed matrices as SimpleMath::Matrix::CreateLookAt and
+    // CreatePerspectiveFieldOfView make them.
+    struct Matrix
+    {
+        float m[16];
+
+        Matrix operator* (const Matrix& other) const
+        {
+            Matrix result = {};
+            for (size_t r = 0; r < 4; ++r)
+            {
+                for (size_t c = 0; c < 4; ++c)
+                {
+                    for (size_t k = 0; k < 4; ++k)
+                    {
+                        result.m[r * 4 + c] += m[r * 4 + k] * other.m[k * 4 + c];
+                    }
+                }
+            }
+            return result;
+        }
+    };
+
+    Matrix LookAt(const float eye[3], const float target[3])
+    {
+        auto normalize = [](float v[3])
+        {
+            const float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+            v[0] /= length;
+            v[1] /= length;
+            v[2] /= length;
+        };
+
+        float z[3] = { eye[0] - target[0], eye[1] - target[1], eye[2] - target[2] };
+        normalize(z);
+        float x[3] = { z[2], 0.f, -z[0] };          // cross((0, 1, 0), z)
+        normalize(x);
+        const float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+
+        auto dot = [&](const float* a) { return a[0] * eye[0] + a[1] * eye[1] + a[2] * eye[2]; };
+
+        return Matrix{ {
+            x[0], y[0], z[0], 0.f,
+            x[1], y[1], z[1], 0.f,
+            x[2], y[2], z[2], 0.f,
+            -dot(x), -dot(y), -dot(z), 1.f } };
+    }
+
+    Matrix Perspective(float fov, float aspect, float nearZ, float farZ)
+    {
+        const float yScale = 1.f / std::tan(fov * 0.5f);
+        const float range = farZ / (nearZ - farZ);
+        return Matrix{ {
+            yScale / aspect, 0.f, 0.f, 0.f,
+            0.f, yScale, 0.f, 0.f,
+            0.f, 0.f, range, -1.f,
+            0.f, 0.f, range * nearZ, 0.f } };
+    }
+
+    // The sample's camera.
+    Matrix SampleViewProjection()
+    {
+        const float eye[3] = { 0.f, 0.f, 12.f };
+        const float target[3] = {};
+        return LookAt(eye, target) * Perspective(0.78539816f, 800.f / 600.f, 0.1f, 25.f);
+    }
+
+    // Looking across a large grid from above one corner.
+    Matrix OpenWorldViewProjection()
+    {
+        const float eye[3] = { 100.f, 100.f, 40.f };
+        const float target[3] = { 200.f, 160.f, 0.f };
+        return LookAt(eye, target) * Perspective(0.9f, 16.f / 9.f, 0.1f, 400.f);
+    }
+
+    void CheckFrustum()
+    {
+        const Matrix viewProj = SampleViewProjection();
+        const auto frustum = Frustum::FromViewProjection(viewProj.m);
+
+        std::mt19937 rng(5);
+        std::uniform_real_distribution<float> coordinate(-30.f, 30.f);
+
+        size_t inside = 0;
+        bool agree = true;
+        for (int j = 0; j < 100000; ++j)
+        {
+            const float p[4] = { coordinate(rng), coordinate(rng), coordinate(rng), 1.f };
+            float clip[4] = {};
+            for (size_t c = 0; c < 4; ++c)
+            {
+                for (size_t k = 0; k < 4; ++k)
+                {
+                    clip[c] += p[k] * viewProj.m[k * 4 + c];
+                }
+            }
+
+            // Skip points within a rounding error of a plane.
+            const float w = clip[3];
+            const float margin = 1e-3f * std::fabs(w) + 1e-4f;
+            const float distances[] = { w + clip[0], w - clip[0], w + clip[1], w - clip[1], clip[2], w - clip[2] };
+            bool near = false;
+            bool clipInside = true;
+            for (float d : distances)
+            {
+                near |= std::fabs(d) < margin;
+                clipInside &= (d >= 0.f);
+            }
+            if (near)
+                continue;
+
+            inside += clipInside ? 1 : 0;
+            agree &= (frustum.IntersectsSphere(p[0], p[1], p[2], 0.f) == clipInside);
+        }
+
+        printf("Frustum: %zu of 100000 random points inside\n", inside);
+        Check(inside > 0, "No points inside the frustum");
+        Check(agree, "Frustum planes disagree with clip space");
+    }
+
+    void CheckCull(const char* name, size_t columns, size_t rows, const Matrix& viewProj, float time, WorkerPool* pool)
+    {
+        auto animator = MakeAnimator(columns, rows, pool);
+        const auto frustum = Frustum::FromViewProjection(viewProj.m);
+        const float radius = 0.5f;
+
+        Buffer buffer(animator.GetCount());
+        const size_t visible = animator.WriteVisible(time, frustum, radius, buffer.Get());
+
+        // The survivors in instance order, as the scalar test picks them.
+        size_t expected = 0;
+        bool match = true;
+        for (size_t j = 0; j < animator.GetCount(); ++j)
+        {
+            float t[InstanceAnimator::TransformFloats];
+            animator.GetTransform(j, time, t);
+            if (!frustum.IntersectsSphere(t[3], t[7], t[11], radius))
+                continue;
+
+            if (expected < visible)
+            {
+                match &= !memcmp(t, buffer.Get() + expected * InstanceAnimator::TransformFloats, sizeof(t));
+            }
+            ++expected;
+        }
+
+        const size_t count = animator.GetCount();
+        printf("%-10s %7zu instances  %7zu visible  %5.1f%% culled\n",
+            name, count, visible, 100.0 * double(count - visible) / double(count));
+
+        Check(visible == expected, "Visible count differs from the scalar test");
+        Check(match, "Visible transforms differ from the scalar test");
+
+        // Bytes after the survivors are not touched.
+        bool untouched = true;
+        for (size_t j = visible * InstanceAnimator::TransformFloats; j < count * InstanceAnimator::TransformFloats; ++j)
+        {
+            untouched &= (buffer.Get()[j] == Guard);
+        }
+        Check(untouched && buffer.GuardIntact(), "Culled write went past the visible transforms");
+
+        // The same survivors in the quantized format, each within half a step of its cluster.
+        std::vector<QuantizedInstance> quantized(count + 1);
+        const size_t quantizedVisible = animator.WriteVisibleQuantized(time, frustum, radius, quantized.data());
+
+        const auto& clusters = animator.GetClusters();
+        bool close = quantizedVisible == visible;
+        for (size_t j = 0; close && j < visible; ++j)
+        {
+            const auto& instance = quantized[j];
+            close &= (instance.cluster < clusters.size());
+            if (!close)
+                break;
+
+            float t[InstanceAnimator::TransformFloats];
+            instance.Decode(clusters[instance.cluster], t);
+
+            const float* expected = buffer.Get() + j * InstanceAnimator::TransformFloats;
+            for (size_t k = 0; k < InstanceAnimator::TransformFloats; ++k)
+            {
+                const float tolerance = (k % 4 == 3) ? clusters[instance.cluster].step[k / 4] * 0.51f : 0.f;
+                close &= (std::fabs(t[k] - expected[k]) <= tolerance);
+            }
+        }
+        Check(close, "Quantized instances differ from the culled transforms");
+    }
+
+    void CheckLods(const char* name, size_t columns, size_t rows, const Matrix& viewProj, const float eye[3],
+        float fovY, const std::vector<float>& screenSizes, float time, WorkerPool* pool)
+    {
+        auto animator = MakeAnimator(columns, rows, pool);
+        const auto frustum = Frustum::FromViewProjection(viewProj.m);
+        const float radius = 0.5f;
+        const auto lods = LodSelector::FromScreenSizes(eye, 1.f / std::tan(fovY * 0.5f), radius,
+            screenSizes.data(), screenSizes.size());
+
+        const size_t count = animator.GetCount();
+        Buffer buffer(count);
+        size_t levelCounts[LodSelector::MaxLevels] = {};
+        const size_t visible = animator.WriteVisible(time, frustum, radius, buffer.Get(), lods, levelCounts);
+
+        size_t total = 0;
+        for (size_t level = 0; level < lods.levels; ++level)
+        {
+            total += levelCounts[level];
+        }
+        Check(total == visible, "Level counts do not add up to the visible count");
+
+        // Each level, in instance order, then the next.
+        bool match = true;
+        size_t offset = 0;
+        for (size_t level = 0; level < lods.levels; ++level)
+        {
+            size_t expected = 0;
+            for (size_t j = 0; j < count; ++j)
+            {
+                float t[InstanceAnimator::TransformFloats];
+                animator.GetTransform(j, time, t);
+                if (!frustum.IntersectsSphere(t[3], t[7], t[11], radius) || lods.Select(t[3], t[7], t[11]) != level)
+                    continue;
+
+                if (expected < levelCounts[level] && offset + expected < visible)
+                {
+                    match &= !memcmp(t, buffer.Get() + (offset + expected) * InstanceAnimator::TransformFloats, sizeof(t));
+                }
+                ++expected;
+            }
+            match &= (expected == levelCounts[level]);
+            offset += levelCounts[level];
+        }
+
+        printf("%-10s %7zu visible in %zu levels:", name, visible, lods.levels);
+        for (size_t level = 0; level < lods.levels; ++level)
+        {
+            printf(" %zu", levelCounts[level]);
+        }
+        printf("\n");
+
+        Check(match, "Level ranges differ from LodSelector::Select");
+        Check(buffer.GuardIntact(), "LOD write went past the buffer");
+
+        // The quantized writer orders the same way.
+        std::vector<QuantizedInstance> quantized(count);
+        size_t quantizedCounts[LodSelector::MaxLevels] = {};
+        const size_t quantizedVisible = animator.WriteVisibleQuantized(time, frustum, radius, quantized.data(), lods, quantizedCounts);
+
+        bool same = (quantizedVisible == visible) && !memcmp(quantizedCounts, levelCounts, sizeof(levelCounts));
+        const auto& clusters = animator.GetClusters();
+        for (size_t j = 0; same && j < visible; ++j)
+        {
+            const auto& instance = quantized[j];
+            const float* expected = buffer.Get() + j * InstanceAnimator::TransformFloats;
+            for (size_t axis = 0; axis < 3; ++axis)
+            {
+                const auto& cluster = clusters[instance.cluster];
+                same &= (std::fabs(instance.GetPosition(cluster, axis) - expected[axis * 4 + 3]) <= cluster.step[axis] * 0.51f);
+            }
+        }
+        Check(same, "Quantized levels differ from the culled ones");
+    }
+
+    void CheckLodErrors()
+    {
+        const float eye[3] = {};
+        bool threw = false;
+        try
+        {
+            const float sizes[] = { 0.1f, 0.2f };
+            LodSelector::FromScreenSizes(eye, 1.f, 1.f, sizes, 2);
+        }
+        catch (const std::invalid_argument&)
+        {
+            threw = true;
+        }
+        Check(threw, "Increasing screen sizes accepted");
+
+        threw = false;
+        try
+        {
+            const float sizes[] = { 0.4f, 0.2f, 0.1f, 0.05f };
+            LodSelector::FromScreenSizes(eye, 1.f, 1.f, sizes, 4);
+        }
+        catch (const std::invalid_argument&)
+        {
+            threw = true;
+        }
+        Check(threw, "Too many levels accepted");
+    }
+
+    template<typename Func>
+    double Time(Func&& func)
+    {
+        constexpr int Repeat = 20;
+
+        func();
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int j = 0; j < Repeat; ++j)
+        {
+            func();
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(stop - start).count() / Repeat;
+    }
+
+    void Benchmark()
+    {
+        constexpr size_t Columns = 1024;
+        constexpr size_t Rows = 1024;
+        constexpr size_t Count = Columns * Rows;
+
+        Buffer mapped(Count);
+        std::unique_ptr<float[]> transforms(new float[Count * InstanceAnimator::TransformFloats]);
+
+        // The previous per-frame work: scalar transforms into an array, then a copy into the mapping.
+        const double scalar = Time([&]()
+        {
+            const float time = 1.f;
+            float* t = transforms.get();
+            for (size_t row = 0; row < Rows; ++row)
+            {
+                for (size_t column = 0; column < Columns; ++column)
+                {
+                    const float x = -6.f + Spacing * float(column);
+                    const float y = -6.f + Spacing * float(row);
+                    const float rows[InstanceAnimator::TransformFloats] =
+                    {
+                        1.f, 0.f, 0.f, x,
+                        0.f, 1.f, 0.f, y,
+                        0.f, 0.f, 1.f, std::cos(time + x * Frequency) * std::sin(time + y * Frequency) * Amplitude,
+                    };
+                    memcpy(t, rows, sizeof(rows));
+                    t += InstanceAnimator::TransformFloats;
+                }
+            }
+            memcpy(mapped.Get(), transforms.get(), Count * InstanceAnimator::TransformFloats * sizeof(float));
+        });
+
+        const auto animator = MakeAnimator(Columns, Rows);
+        const double batched = Time([&]() { animator.Write(1.f, mapped.Get()); });
+
+        WorkerPool pool;
+        const auto threadedAnimator = MakeAnimator(Columns, Rows, &pool);
+        const double threaded = Time([&]() { threadedAnimator.Write(1.f, mapped.Get()); });
+
+        printf("1M instances: scalar + copy %.2f ms, batched %.2f ms, batched on %zu threads %.2f ms\n",
+            scalar, batched, pool.GetThreadCount(), threaded);
+
+        auto culling = MakeAnimator(Columns, Rows, &pool);
+        const auto frustum = Frustum::FromViewProjection(OpenWorldViewProjection().m);
+        size_t visible = 0;
+        const double culled = Time([&]() { visible = culling.WriteVisible(1.f, frustum, 0.5f, mapped.Get()); });
+
+        std::vector<QuantizedInstance> quantized(Count);
+        const double culledQuantized = Time([&]() { visible = culling.WriteVisibleQuantized(1.f, frustum, 0.5f, quantized.data()); });
+
+        printf("1M instances culled to %zu on %zu threads: %.2f ms, quantized %.2f ms (%zu bytes a frame instead of %zu)\n",
+            visible, pool.GetThreadCount(), culled, culledQuantized,
+            visible * sizeof(QuantizedInstance), visible * InstanceAnimator::TransformFloats * sizeof(float));
+
+        const float eye[3] = { 100.f, 100.f, 40.f };
+        const float screenSizes[] = { 0.02f, 0.01f, 0.005f };
+        const auto lods = LodSelector::FromScreenSizes(eye, 1.f / std::tan(0.45f), 0.5f, screenSizes, 3);
+        size_t levelCounts[LodSelector::MaxLevels] = {};
+        const double bucketed = Time([&]() { visible = culling.WriteVisibleQuantized(1.f, frustum, 0.5f, quantized.data(), lods, levelCounts); });
+
+        printf("1M instances culled to %zu and bucketed into %zu levels: %.2f ms\n", visible, lods.levels, bucketed);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    bool bench = true;
+    for (int j = 1; j < argc; ++j)
+    {
+        if (!strcmp(argv[j], "-nobench"))
+        {
+            bench = false;
+        }
+        else
+        {
+            printf("Usage: InstanceAnimatorCheck [-nobench]\n");
+            return 1;
+        }
+    }
+
+#if defined(INSTANCEANIMATOR_AVX)
+    printf("AVX path\n");
+#elif defined(INSTANCEANIMATOR_SSE2)
+    printf("SSE2 path\n");
+#else
+    printf("Scalar path\n");
+#endif
+
+    return RunChecks([&]()
+    {
+        // The sample's grid, then counts that leave a partial batch.
+        for (float time : { 0.f, 1.3f, -7.9f, 1000.7f })
+        {
+            CheckGrid(8, 8, time);
+            CheckGrid(1, 1, time);
+            CheckGrid(7, 13, time);
+            CheckGrid(3, 5, time);
+            CheckGrid(1000, 3, time);
+        }
+
+        CheckThreaded();
+        CheckErrors();
+
+        CheckFrustum();
+
+        WorkerPool pool(4);
+        for (float time : { 0.f, 1.3f })
+        {
+            CheckCull("sample", 8, 8, SampleViewProjection(), time, nullptr);
+            CheckCull("odd", 37, 29, SampleViewProjection(), time, nullptr);
+            CheckCull("open", 1024, 1024, OpenWorldViewProjection(), time, nullptr);
+            CheckCull("threaded", 1024, 1024, OpenWorldViewProjection(), time, &pool);
+        }
+
+        CheckLodErrors();
+
+        const float sampleEye[3] = { 0.f, 0.f, 12.f };
+        const float openEye[3] = { 100.f, 100.f, 40.f };
+        for (float time : { 0.f, 1.3f })
+        {
+            CheckLods("sample", 8, 8, SampleViewProjection(), sampleEye, 0.78539816f, { 0.1f, 0.095f }, time, nullptr);
+            CheckLods("one", 37, 29, SampleViewProjection(), sampleEye, 0.78539816f, {}, time, nullptr);
+            CheckLods("open", 1024, 1024, OpenWorldViewProjection(), openEye, 0.9f, { 0.02f, 0.01f, 0.005f }, time, nullptr);
+            CheckLods("threaded", 1024, 1024, OpenWorldViewProjection(), openEye, 0.9f, { 0.02f, 0.01f, 0.005f }, time, &pool);
+        }
+
+        if (bench)
+        {
+            Benchmark();
+        }
+    });
+}
@@ -0,0 +1,321 @@
+//--------------------------------------------------------------------------------------
+// File: QuantizedInstanceCheck.cpp
+//
+// Checks QuantizedInstance.h: every half round trips and floats round to the nearest half,
+// positions land within half a step, and decoded transforms stay close to the matrix of the
+// original quaternion, scale and position, with identity and unit scale exact. The batched
+// SSE2 encoder must give the same bits as the scalar Encode for every count, with and
+// without rotations and scales, and leave the bytes past the end alone.
+//
+// This is a standalone console tool with no Windows or Direct3D dependencies:
+//
+//   g++ -std=c++14 -O2 -msse2 -I../../Common -o QuantizedInstanceCheck QuantizedInstanceCheck.cpp
+//   cl /std:c++14 /O2 /EHsc /I..\..\Common QuantizedInstanceCheck.cpp
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "QuantizedInstance.h"
+#include "CheckHarness.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    void CheckHalf()
+    {
+        // Every finite half that is not a denormal comes back as the same bits.
+        bool roundTrip = true;
+        for (uint32_t h = 0; h < 0x10000; ++h)
+        {
+            const uint32_t exponent = (h >> 10) & 0x1f;
+            if (!exponent || exponent == 0x1f)
+                continue;
+
+            roundTrip &= (QuantizedInstance::PackHalf(QuantizedInstance::UnpackHalf(uint16_t(h))) == h);
+        }
+        Check(roundTrip, "Half does not round trip");
+
+        // Random floats go to the nearest half, ties to even.
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> exponents(-14.f, 15.9f);
+        std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+        bool nearest = true;
+        for (size_t j = 0; j < 100000; ++j)
+        {
+            const float value = std::copysign(std::exp2(exponents(rng)), unit(rng));
+            const uint16_t half = QuantizedInstance::PackHalf(value);
+            const double error = std::fabs(double(QuantizedInstance::UnpackHalf(half)) - double(value));
+
+            for (int step : { -1, 1 })
+            {
+                const uint16_t neighbor = uint16_t(half + step);
+                if (((neighbor >> 10) & 0x1f) == 0x1f)
+                    continue;
+
+                nearest &= (error <= std::fabs(double(QuantizedInstance::UnpackHalf(neighbor)) - double(value)));
+            }
+        }
+        Check(nearest, "Half is not the nearest");
+
+        Check(QuantizedInstance::UnpackHalf(QuantizedInstance::PackHalf(1.f)) == 1.f, "Scale of 1 is not exact");
+        Check(QuantizedInstance::PackHalf(1e-6f) == 0, "Tiny value not flushed");
+        Check(QuantizedInstance::PackHalf(1e6f) == 0x7bff && QuantizedInstance::PackHalf(-1e6f) == 0xfbff, "Huge value not clamped");
+        Check(QuantizedInstance::PackHalf(1.00048828125f) == 0x3c00 && QuantizedInstance::PackHalf(1.00146484375f) == 0x3c02,
+            "Ties do not round to even");
+    }
+
+    void RandomQuaternion(std::mt19937& rng, float q[4])
+    {
+        std::normal_distribution<float> normal;
+        double length = 0.0;
+        for (size_t j = 0; j < 4; ++j)
+        {
+            q[j] = normal(rng);
+            length += double(q[j]) * double(q[j]);
+        }
+        for (size_t j = 0; j < 4; ++j)
+        {
+            q[j] = float(double(q[j]) / std::sqrt(length));
+        }
+    }
+
+    // The rows of scale * rotation with the position in w, in double.
+    void Reference(const float q[4], float scale, const float p[3], double rows[12])
+    {
+        const double x = q[0], y = q[1], z = q[2], w = q[3];
+        const double r[12] =
+        {
+            1 - 2 * (y * y + z * z), 2 * (x * y - z * w), 2 * (x * z + y * w), p[0],
+            2 * (x * y + z * w), 1 - 2 * (x * x + z * z), 2 * (y * z - x * w), p[1],
+            2 * (x * z - y * w), 2 * (y * z + x * w), 1 - 2 * (x * x + y * y), p[2],
+        };
+        for (size_t j = 0; j < 12; ++j)
+        {
+            rows[j] = (j % 4 == 3) ? r[j] : r[j] * scale;
+        }
+    }
+
+    void CheckDecode()
+    {
+        const float minimum[3] = { -40.f, 10.f, -2.f };
+        const float maximum[3] = { 56.f, 16.f, 2.f };
+        const auto cluster = InstanceCluster::FromBounds(minimum, maximum);
+
+        std::mt19937 rng(11);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        std::uniform_real_distribution<float> scales(0.25f, 4.f);
+
+        double maxPosition[3] = {};
+        double maxRotation = 0.0;
+        bool sameSign = true;
+
+        for (size_t j = 0; j < 100000; ++j)
+        {
+            float p[3], q[4];
+            for (size_t k = 0; k < 3; ++k)
+            {
+                p[k] = minimum[k] + (maximum[k] - minimum[k]) * unit(rng);
+            }
+            RandomQuaternion(rng, q);
+            const float scale = scales(rng);
+
+            const auto instance = QuantizedInstance::Encode(cluster, 3, p, q, scale);
+            Check(instance.cluster == 3, "Cluster index lost");
+
+            float t[12];
+            instance.Decode(cluster, t);
+
+            double expected[12];
+            Reference(q, QuantizedInstance::UnpackHalf(instance.scale), p, expected);
+
+            for (size_t k = 0; k < 3; ++k)
+            {
+                maxPosition[k] = std::max(maxPosition[k], std::fabs(double(t[k * 4 + 3]) - expected[k * 4 + 3]) / cluster.step[k]);
+            }
+
+            // Relative to the scale, so the error is that of the rotation alone.
+            const double unpackedScale = QuantizedInstance::UnpackHalf(instance.scale);
+            for (size_t k = 0; k < 12; ++k)
+            {
+                if (k % 4 != 3)
+                {
+                    maxRotation = std::max(maxRotation, std::fabs(double(t[k]) - expected[k]) / unpackedScale);
+                }
+            }
+
+            // q and -q are the same rotation; the decoded one has its largest component positive.
+            float decoded[4];
+            QuantizedInstance::UnpackRotation(instance.rotation, decoded);
+            double dot = 0.0;
+            for (size_t k = 0; k < 4; ++k)
+            {
+                dot += double(decoded[k]) * double(q[k]);
+            }
+            sameSign &= (std::fabs(dot) > 0.999);
+        }
+
+        printf("Decode: position error %.3f %.3f %.3f steps, rotation error %.2e\n",
+            maxPosition[0], maxPosition[1], maxPosition[2], maxRotation);
+
+        // Half a step, and a little for float rounding far from the origin.
+        Check(maxPosition[0] < 0.51 && maxPosition[1] < 0.51 && maxPosition[2] < 0.51, "Position off by more than half a step");
+        Check(maxRotation < 5e-3, "Rotation error too large");
+        Check(sameSign, "Rotation does not decode to the same quaternion");
+
+        // Identity and a unit scale are exact, as are the bounds.
+        const float identity[4] = { 0.f, 0.f, 0.f, 1.f };
+        const float center[3] = { cluster.origin[0], cluster.origin[1], cluster.origin[2] };
+        float t[12];
+        QuantizedInstance::Encode(cluster, 0, center, identity, 1.f).Decode(cluster, t);
+
+        const float rows[12] =
+        {
+            1.f, 0.f, 0.f, center[0],
+            0.f, 1.f, 0.f, center[1],
+            0.f, 0.f, 1.f, center[2],
+        };
+        Check(!memcmp(t, rows, sizeof(rows)), "Identity does not decode exactly");
+
+        const auto low = QuantizedInstance::Encode(cluster, 0, minimum, identity, 1.f);
+        const auto high = QuantizedInstance::Encode(cluster, 0, maximum, identity, 1.f);
+        bool bounds = true;
+        for (size_t k = 0; k < 3; ++k)
+        {
+            bounds &= (low.position[k] == 1 && high.position[k] == 65535);
+            bounds &= std::fabs(low.GetPosition(cluster, k) - minimum[k]) <= cluster.step[k];
+            bounds &= std::fabs(high.GetPosition(cluster, k) - maximum[k]) <= cluster.step[k];
+        }
+        Check(bounds, "Bounds do not map to the ends of the range");
+
+        // Outside the bounds clamps.
+        const float far[3] = { 1000.f, -1000.f, 0.f };
+        const auto clamped = QuantizedInstance::Encode(cluster, 0, far, identity, 1.f);
+        Check(clamped.position[0] == 65535 && clamped.position[1] == 1, "Position outside the cluster not clamped");
+    }
+
+    void CheckBatch(size_t count, bool withRotations, bool withScales, std::mt19937& rng)
+    {
+        const float minimum[3] = { -100.f, -3.f, -2.f };
+        const float maximum[3] = { 100.f, 3.f, 2.f };
+        const auto cluster = InstanceCluster::FromBounds(minimum, maximum);
+
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        std::uniform_real_distribution<float> scaleDistribution(0.f, 3.f);
+
+        std::vector<float> positions(count * 4 + 4);
+        std::vector<float> rotations(count * 4 + 4);
+        std::vector<float> scales(count + 1);
+        for (size_t j = 0; j < count; ++j)
+        {
+            for (size_t k = 0; k < 3; ++k)
+            {
+                // A few fall outside the cluster to exercise the clamp.
+                positions[j * 4 + k] = minimum[k] + (maximum[k] - minimum[k]) * (unit(rng) * 1.1f - 0.05f);
+            }
+            RandomQuaternion(rng, rotations.data() + j * 4);
+            scales[j] = scaleDistribution(rng);
+        }
+
+        // Exact ties and signed zeros in the rotations.
+        if (withRotations && count > 2)
+        {
+            const float tie[4] = { 0.5f, -0.5f, 0.5f, -0.5f };
+            const float axis[4] = { 0.f, -1.f, 0.f, 0.f };
+            memcpy(rotations.data(), tie, sizeof(tie));
+            memcpy(rotations.data() + 4, axis, sizeof(axis));
+        }
+
+        // 16-byte aligned, with a guard band after.
+        std::vector<QuantizedInstance> storage(count + 4);
+        memset(storage.data(), 0xcd, storage.size() * sizeof(QuantizedInstance));
+
+        QuantizedInstance::EncodeInstances(cluster, 9, count, positions.data(),
+            withRotations ? rotations.data() : nullptr, withScales ? scales.data() : nullptr, storage.data());
+
+        const float identity[4] = { 0.f, 0.f, 0.f, 1.f };
+        bool match = true;
+        for (size_t j = 0; j < count; ++j)
+        {
+            const auto expected = QuantizedInstance::Encode(cluster, 9, positions.data() + j * 4,
+                withRotations ? rotations.data() + j * 4 : identity, withScales ? scales[j] : 1.f);
+            match &= !memcmp(&expected, storage.data() + j, sizeof(expected));
+        }
+
+        bool guard = true;
+        const auto bytes = reinterpret_cast<const uint8_t*>(storage.data() + count);
+        for (size_t j = 0; j < 4 * sizeof(QuantizedInstance); ++j)
+        {
+            guard &= (bytes[j] == 0xcd);
+        }
+
+        if (!match)
+        {
+            Fail("Batched encoder differs from Encode: count %zu rotations %d scales %d", count, int(withRotations), int(withScales));
+        }
+        Check(guard, "Batched encoder went past the end");
+    }
+
+    void CheckErrors()
+    {
+        const float minimum[3] = {};
+        const float maximum[3] = { 1.f, 1.f, 1.f };
+        const auto cluster = InstanceCluster::FromBounds(minimum, maximum);
+
+        std::vector<QuantizedInstance> storage(2);
+        const float positions[4] = {};
+
+        bool threw = false;
+        try
+        {
+            QuantizedInstance::EncodeInstances(cluster, 0, 1, positions, nullptr, nullptr,
+                reinterpret_cast<QuantizedInstance*>(reinterpret_cast<uint8_t*>(storage.data()) + 4));
+        }
+        catch (const std::invalid_argument&)
+        {
+            threw = true;
+        }
+        Check(threw, "Unaligned destination accepted");
+
+        // A flat cluster still encodes.
+        const float flat[3] = { 2.f, 2.f, 2.f };
+        const auto point = InstanceCluster::FromBounds(flat, flat);
+        Check(point.step[0] > 0.f && QuantizedInstance::Encode(point, 0, flat, positions, 1.f).GetPosition(point, 0) == 2.f,
+            "Flat cluster does not encode");
+    }
+}
+
+int main()
+{
+#if defined(QUANTIZEDINSTANCE_SSE2)
+    printf("SSE2 path\n");
+#else
+    printf("Scalar path\n");
+#endif
+
+    return RunChecks([&]()
+    {
+        CheckHalf();
+        CheckDecode();
+
+        std::mt19937 rng(5);
+        for (size_t count = 0; count < 20; ++count)
+        {
+            for (int flags = 0; flags < 4; ++flags)
+            {
+                CheckBatch(count, (flags & 1) != 0, (flags & 2) != 0, rng);
+            }
+        }
+        CheckBatch(4099, true, true, rng);
+
+        CheckErrors();
+    });
+}
@@ -0,0 +1,177 @@
+//--------------------------------------------------------------------------------------
+// QuantizedInstanceEffect.cpp
+//
+// A normal mapped effect for DirectX 11 that decodes QuantizedInstance.h instances in the
+// vertex shader.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "pch.h"
+#include "QuantizedInstanceEffect.h"
+
+#include "ReadData.h"
+
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+    constexpr uint32_t DirtyConstantBuffer = 0x1;
+    constexpr uint32_t DirtyViewProjMatrix = 0x2;
+
+    constexpr float c_specularPower = 16.f;
+}
+
+QuantizedInstanceEffect::QuantizedInstanceEffect(_In_ ID3D11Device* device) :
+        m_dirtyFlags(uint32_t(-1)),
+        m_constants{},
+        m_constantBuffer(device)
+{
+    static_assert((sizeof(QuantizedInstanceEffect::QuantizedInstanceEffectConstants) % 16) == 0, "CB size alignment");
+
+    // Get shaders
+    m_vsBlob = DX::ReadData(L"QuantizedInstanceEffect_VS.cso");
+
+    DX::ThrowIfFailed(
+        device->CreateVertexShader(m_vsBlob.data(), m_vsBlob.size(),
+            nullptr, m_vs.ReleaseAndGetAddressOf()));
+
+    auto psBlob = DX::ReadData(L"QuantizedInstanceEffect_PS.cso");
+
+    DX::ThrowIfFailed(
+        device->CreatePixelShader(psBlob.data(), psBlob.size(),
+            nullptr, m_ps.ReleaseAndGetAddressOf()));
+}
+
+
+// IEffect methods.
+void QuantizedInstanceEffect::Apply(_In_ ID3D11DeviceContext* deviceContext)
+{
+    if (m_dirtyFlags & DirtyViewProjMatrix)
+    {
+        m_constants.viewProj = XMMatrixTranspose(XMMatrixMultiply(m_view, m_proj));
+
+        const XMMATRIX invView = XMMatrixInverse(nullptr, m_view);
+        m_constants.eyePosition = XMVectorSetW(invView.r[3], c_specularPower);
+
+        m_dirtyFlags &= ~DirtyViewProjMatrix;
+        m_dirtyFlags |= DirtyConstantBuffer;
+    }
+
+    if (m_dirtyFlags & DirtyConstantBuffer)
+    {
+        m_constantBuffer.SetData(deviceContext, m_constants);
+
+        m_dirtyFlags &= ~DirtyConstantBuffer;
+    }
+
+    auto cb = m_constantBuffer.GetBuffer();
+    deviceContext->VSSetConstantBuffers(0, 1, &cb);
+    deviceContext->PSSetConstantBuffers(0, 1, &cb);
+    deviceContext->VSSetShaderResources(3, 1, m_clusters.GetAddressOf());
+
+    ID3D11ShaderResourceView* textures[] = { m_texture.Get(), m_normalTexture.Get(), m_specularTexture.Get() };
+    deviceContext->PSSetShaderResources(0, static_cast<UINT>(std::size(textures)), textures);
+
+    deviceContext->VSSetShader(m_vs.Get(), nullptr, 0);
+    deviceContext->PSSetShader(m_ps.Get(), nullptr, 0);
+}
+
+void QuantizedInstanceEffect::GetVertexShaderBytecode(
+    _Out_ void const** pShaderByteCode,
+    _Out_ size_t* pByteCodeLength)
+{
+    assert(pShaderByteCode != nullptr && pByteCodeLength != nullptr);
+    *pShaderByteCode = m_vsBlob.data();
+    *pByteCodeLength = m_vsBlob.size();
+}
+
+
+// Camera settings.
+void QuantizedInstanceEffect::SetWorld(FXMMATRIX /*value*/)
+{
+}
+
+void QuantizedInstanceEffect::SetView(FXMMATRIX value)
+{
+    m_view = value;
+    m_dirtyFlags |= DirtyViewProjMatrix;
+}
+
+void QuantizedInstanceEffect::SetProjection(FXMMATRIX value)
+{
+    m_proj = value;
+    m_dirtyFlags |= DirtyViewProjMatrix;
+}
+
+void QuantizedInstanceEffect::SetMatrices(FXMMATRIX /*world*/, CXMMATRIX view, CXMMATRIX projection)
+{
+    m_view = view;
+    m_proj = projection;
+    m_dirtyFlags |= DirtyViewProjMatrix;
+}
+
+
+// Light settings.
+void QuantizedInstanceEffect::EnableDefaultLighting()
+{
+    static const XMVECTORF32 defaultDirections[3] =
+    {
+        { { { -0.5265408f, -0.5735765f, -0.6275069f, 0 } } },
+        { { {  0.7198464f,  0.3420201f,  0.6040227f, 0 } } },
+        { { {  0.4545195f, -0.7660444f,  0.4545195f, 0 } } },
+    };
+
+    static const XMVECTORF32 defaultDiffuse[3] =
+    {
+        { { { 1.0000000f, 0.9607844f, 0.8078432f, 0 } } },
+        { { { 0.9647059f, 0.7607844f, 0.4078432f, 0 } } },
+        { { { 0.3231373f, 0.3607844f, 0.3937255f, 0 } } },
+    };
+
+    static const XMVECTORF32 defaultSpecular[3] =
+    {
+        { { { 1.0000000f, 0.9607844f, 0.8078432f, 0 } } },
+        { { { 0.0000000f, 0.0000000f, 0.0000000f, 0 } } },
+        { { { 0.3231373f, 0.3607844f, 0.3937255f, 0 } } },
+    };
+
+    static const XMVECTORF32 defaultAmbient = { { { 0.05333332f, 0.09882354f, 0.1819608f, 0 } } };
+
+    for (size_t j = 0; j < 3; ++j)
+    {
+        m_constants.lightDirection[j] = defaultDirections[j];
+        m_constants.lightDiffuseColor[j] = defaultDiffuse[j];
+        m_constants.lightSpecularColor[j] = defaultSpecular[j];
+    }
+    m_constants.ambientColor = defaultAmbient;
+
+    m_dirtyFlags |= DirtyConstantBuffer;
+}
+
+
+// Texture settings.
+void QuantizedInstanceEffect::SetTexture(_In_opt_ ID3D11ShaderResourceView* value)
+{
+    m_texture = value;
+}
+
+void QuantizedInstanceEffect::SetNormalTexture(_In_opt_ ID3D11ShaderResourceView* value)
+{
+    m_normalTexture = value;
+}
+
+void QuantizedInstanceEffect::SetSpecularTexture(_In_opt_ ID3D11ShaderResourceView* value)
+{
+    m_specularTexture = value;
+}
+
+
+// Instance settings.
+void QuantizedInstanceEffect::SetClusters(_In_opt_ ID3D11ShaderResourceView* value)
+{
+    m_clusters = value;
+}
@@ -0,0 +1,85 @@
+//--------------------------------------------------------------------------------------
+// QuantizedInstanceEffect.h
+//
+// A normal mapped effect for DirectX 11 that decodes QuantizedInstance.h instances in the
+// vertex shader. Each instance is one 16-byte R32G32B32A32_UINT element, InstQuantized,
+// and the clusters are read from a Buffer<float4> of origin and step pairs. The instances
+// carry the world transform, so SetWorld is ignored.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <BufferHelpers.h>
+#include <Effects.h>
+#include <SimpleMath.h>
+
+#include <vector>
+
+
+namespace DX
+{
+    class QuantizedInstanceEffect : public DirectX::IEffect, public DirectX::IEffectMatrices
+    {
+    public:
+        explicit QuantizedInstanceEffect(_In_ ID3D11Device* device);
+
+        QuantizedInstanceEffect(QuantizedInstanceEffect&&) = default;
+        QuantizedInstanceEffect& operator= (QuantizedInstanceEffect&&) = default;
+
+        QuantizedInstanceEffect(QuantizedInstanceEffect const&) = delete;
+        QuantizedInstanceEffect& operator= (QuantizedInstanceEffect const&) = delete;
+
+        // IEffect methods.
+        virtual void __cdecl Apply(_In_ ID3D11DeviceContext* deviceContext) override;
+        virtual void __cdecl GetVertexShaderBytecode(
+            _Out_ void const** pShaderByteCode, _Out_ size_t* pByteCodeLength) override;
+
+        // Camera settings.
+        void XM_CALLCONV SetWorld(DirectX::FXMMATRIX value) override;
+        void XM_CALLCONV SetView(DirectX::FXMMATRIX value) override;
+        void XM_CALLCONV SetProjection(DirectX::FXMMATRIX value) override;
+        void XM_CALLCONV SetMatrices(DirectX::FXMMATRIX world, DirectX::CXMMATRIX view, DirectX::CXMMATRIX projection) override;
+
+        // Light settings, the same three lights as IEffectLights::EnableDefaultLighting.
+        void __cdecl EnableDefaultLighting();
+
+        // Texture settings.
+        void __cdecl SetTexture(_In_opt_ ID3D11ShaderResourceView* value);
+        void __cdecl SetNormalTexture(_In_opt_ ID3D11ShaderResourceView* value);
+        void __cdecl SetSpecularTexture(_In_opt_ ID3D11ShaderResourceView* value);
+
+        // Instance settings.
+        void __cdecl SetClusters(_In_opt_ ID3D11ShaderResourceView* value);
+
+    private:
+        Microsoft::WRL::ComPtr<ID3D11VertexShader>  m_vs;
+        Microsoft::WRL::ComPtr<ID3D11PixelShader>   m_ps;
+
+        uint32_t m_dirtyFlags;
+
+        DirectX::SimpleMath::Matrix m_view;
+        DirectX::SimpleMath::Matrix m_proj;
+
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_texture;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_normalTexture;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_specularTexture;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_clusters;
+        std::vector<uint8_t>                                m_vsBlob;
+
+        struct __declspec(align(16)) QuantizedInstanceEffectConstants
+        {
+            DirectX::XMMATRIX viewProj;
+            DirectX::XMVECTOR eyePosition;
+            DirectX::XMVECTOR ambientColor;
+            DirectX::XMVECTOR lightDirection[3];
+            DirectX::XMVECTOR lightDiffuseColor[3];
+            DirectX::XMVECTOR lightSpecularColor[3];
+        };
+
+        QuantizedInstanceEffectConstants                    m_constants;
+        DirectX::ConstantBuffer<QuantizedInstanceEffectConstants> m_constantBuffer;
+    };
+}
@@ -0,0 +1,32 @@
+//--------------------------------------------------------------------------------------
+// QuantizedInstanceEffect_Common.hlsli
+//
+// A normal mapped effect for DirectX 11 that decodes QuantizedInstance.h instances in the
+// vertex shader.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#ifndef __QUANTIZEDINSTANCEEFFECT_COMMON_HLSLI__
+#define __QUANTIZEDINSTANCEEFFECT_COMMON_HLSLI__
+
+cbuffer Parameters : register(b0)
+{
+    float4x4 ViewProj;
+    float4 EyePosition;         // w is the specular power
+    float4 AmbientColor;
+    float4 LightDirection[3];
+    float4 LightDiffuseColor[3];
+    float4 LightSpecularColor[3];
+}
+
+struct VSOutput
+{
+    float3 PositionWS : TEXCOORD0;
+    float3 NormalWS : TEXCOORD1;
+    float2 TexCoord : TEXCOORD2;
+    float4 PositionPS : SV_Position;
+};
+
+#endif
@@ -0,0 +1,46 @@
+//--------------------------------------------------------------------------------------
+// QuantizedInstanceEffect_VS.hlsl
+//
+// A normal mapped effect for DirectX 11 that decodes QuantizedInstance.h instances in the
+// vertex shader.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "QuantizedInstanceEffect_Common.hlsli"
+#include "InstanceDecode_Common.hlsli"
+
+// Each InstanceCluster is two elements: origin, then step.
+Buffer<float4> Clusters : register(t3);
+
+struct VSInput
+{
+    float4 Position : SV_Position;
+    float3 Normal : NORMAL;
+    float2 TexCoord : TEXCOORD0;
+    uint4 Instance : InstQuantized;
+};
+
+VSOutput main(VSInput vin)
+{
+    InstanceCluster cluster;
+    cluster.origin = Clusters[vin.Instance.w * 2];
+    cluster.step = Clusters[vin.Instance.w * 2 + 1];
+
+    float4 rows[3];
+    DecodeInstance(vin.Instance, cluster, rows);
+
+    const float4 position = float4(vin.Position.xyz, 1.f);
+    const float3 positionWS = float3(dot(rows[0], position), dot(rows[1], position), dot(rows[2], position));
+
+    // The scale is uniform, so the rotation rows also transform normals.
+    const float3 normalWS = float3(dot(rows[0].xyz, vin.Normal), dot(rows[1].xyz, vin.Normal), dot(rows[2].xyz, vin.Normal));
+
+    VSOutput vout;
+    vout.PositionWS = positionWS;
+    vout.NormalWS = normalize(normalWS);
+    vout.TexCoord = vin.TexCoord;
+    vout.PositionPS = mul(float4(positionWS, 1.f), ViewProj);
+    return vout;
+}
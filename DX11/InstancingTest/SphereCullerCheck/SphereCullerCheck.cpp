@@ -0,0 +1,373 @@
+//--------------------------------------------------------------------------------------
+// File: SphereCullerCheck.cpp
+//
+// Checks SphereCuller.h: for scattered and clustered spheres, counts around the batch and
+// chunk sizes, one to four levels of detail, serially and on a WorkerPool, the output is
+// exactly the spheres Frustum::IntersectsSphere keeps, in index order within each level,
+// with the level LodSelector::Select picks and the per-level counts. Then times culling
+// 1M spheres against testing every one.
+//
+// This is a standalone console tool with no Windows or Direct3D dependencies:
+//
+//   g++ -std=c++14 -O2 -msse2 -pthread -I../../Common -o SphereCullerCheck SphereCullerCheck.cpp
+//   cl /std:c++14 /O2 /EHsc /I..\..\Common SphereCullerCheck.cpp
+//
+//   SphereCullerCheck [-nobench]
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "SphereCuller.h"
+#include "CheckHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    // Row-vector, right-handed matrices as SimpleMath::Matrix::CreateLookAt and
+    // CreatePerspectiveFieldOfView make them.
+    struct Matrix
+    {
+        float m[16];
+
+        Matrix operator* (const Matrix& other) const
+        {
+            Matrix result = {};
+            for (size_t r = 0; r < 4; ++r)
+            {
+                for (size_t c = 0; c < 4; ++c)
+                {
+                    for (size_t k = 0; k < 4; ++k)
+                    {
+                        result.m[r * 4 + c] += m[r * 4 + k] * other.m[k * 4 + c];
+                    }
+                }
+            }
+            return result;
+        }
+    };
+
+    Matrix LookAt(const float eye[3], const float target[3])
+    {
+        auto normalize = [](float v[3])
+        {
+            const float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+            v[0] /= length;
+            v[1] /= length;
+            v[2] /= length;
+        };
+
+        float z[3] = { eye[0] - target[0], eye[1] - target[1], eye[2] - target[2] };
+        normalize(z);
+        float x[3] = { z[2], 0.f, -z[0] };          // cross((0, 1, 0), z)
+        normalize(x);
+        const float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+
+        auto dot = [&](const float* a) { return a[0] * eye[0] + a[1] * eye[1] + a[2] * eye[2]; };
+
+        return Matrix{ {
+            x[0], y[0], z[0], 0.f,
+            x[1], y[1], z[1], 0.f,
+            x[2], y[2], z[2], 0.f,
+            -dot(x), -dot(y), -dot(z), 1.f } };
+    }
+
+    Matrix Perspective(float fov, float aspect, float nearZ, float farZ)
+    {
+        const float yScale = 1.f / std::tan(fov * 0.5f);
+        const float range = farZ / (nearZ - farZ);
+        return Matrix{ {
+            yScale / aspect, 0.f, 0.f, 0.f,
+            0.f, yScale, 0.f, 0.f,
+            0.f, 0.f, range, -1.f,
+            0.f, 0.f, range * nearZ, 0.f } };
+    }
+
+    constexpr float c_fov = 0.9f;
+    constexpr float c_radius = 0.75f;
+
+    const float c_eye[3] = { 0.f, 20.f, 60.f };
+    const float c_target[3] = { 5.f, 0.f, -20.f };
+
+    Frustum MakeFrustum(float farZ)
+    {
+        const Matrix viewProj = LookAt(c_eye, c_target) * Perspective(c_fov, 16.f / 9.f, 0.1f, farZ);
+        return Frustum::FromViewProjection(viewProj.m);
+    }
+
+    LodSelector MakeLods(size_t levels)
+    {
+        const float sizes[] = { 0.08f, 0.04f, 0.02f };
+        return (levels > 1) ? LodSelector::FromScreenSizes(c_eye, 1.f / std::tan(c_fov * 0.5f), c_radius, sizes, levels - 1) : LodSelector();
+    }
+
+    // Centers stored as the culler asks for them, with tight bounds for each chunk.
+    struct Spheres
+    {
+        std::vector<float> x, y, z;
+        std::vector<AxisAlignedBox> bounds;
+
+        Spheres(size_t count, bool clustered, std::mt19937& rng) :
+            x(count), y(count), z(count)
+        {
+            std::uniform_real_distribution<float> position(-120.f, 120.f);
+            std::normal_distribution<float> spread(0.f, 3.f);
+
+            for (size_t j = 0; j < count; ++j)
+            {
+                if (clustered && (j % SphereCuller::ChunkSize))
+                {
+                    // The rest of a chunk crowds around its first sphere.
+                    const size_t first = j - j % SphereCuller::ChunkSize;
+                    x[j] = x[first] + spread(rng);
+                    y[j] = y[first] + spread(rng);
+                    z[j] = z[first] + spread(rng);
+                }
+                else
+                {
+                    x[j] = position(rng);
+                    y[j] = position(rng) * 0.25f;
+                    z[j] = position(rng);
+                }
+            }
+
+            bounds.resize(SphereCuller::GetChunkCount(count), AxisAlignedBox::Empty());
+            for (size_t j = 0; j < count; ++j)
+            {
+                AxisAlignedBox& box = bounds[j / SphereCuller::ChunkSize];
+                const float c[3] = { x[j], y[j], z[j] };
+                for (size_t axis = 0; axis < 3; ++axis)
+                {
+                    box.minimum[axis] = std::min(box.minimum[axis], c[axis]);
+                    box.maximum[axis] = std::max(box.maximum[axis], c[axis]);
+                }
+            }
+        }
+
+        void operator() (size_t begin, size_t end, float* xs, float* ys, float* zs) const
+        {
+            memcpy(xs, x.data() + begin, (end - begin) * sizeof(float));
+            memcpy(ys, y.data() + begin, (end - begin) * sizeof(float));
+            memcpy(zs, z.data() + begin, (end - begin) * sizeof(float));
+        }
+    };
+
+    // Runs the culler and gathers its output as x, y, z, level per visible sphere.
+    size_t Cull(SphereCuller& culler, const Spheres& spheres, const Frustum& frustum, const LodSelector& lods,
+        std::vector<float>& out, size_t* levelCounts)
+    {
+        out.assign(spheres.x.size() * 4, -1.f);
+        return culler.Cull(frustum, c_radius, lods, levelCounts, spheres, [&](size_t, const float* visible, size_t offset, size_t n)
+        {
+            memcpy(out.data() + offset * 4, visible, n * 4 * sizeof(float));
+        });
+    }
+
+    void CheckLayout(size_t count, bool clustered, WorkerPool& pool)
+    {
+        std::mt19937 rng(uint32_t(count * 2 + (clustered ? 1 : 0)));
+        const Spheres spheres(count, clustered, rng);
+        const Frustum frustum = MakeFrustum(150.f);
+
+        SphereCuller serial;
+        SphereCuller threaded(&pool);
+        serial.SetSpheres(count, spheres.bounds.data());
+        threaded.SetSpheres(count, spheres.bounds.data());
+
+        for (size_t levels = 1; levels <= LodSelector::MaxLevels; ++levels)
+        {
+            const LodSelector lods = MakeLods(levels);
+
+            // Every sphere, in index order, bucketed by level.
+            std::vector<float> expected;
+            size_t expectedCounts[LodSelector::MaxLevels] = {};
+            for (size_t level = 0; level < levels; ++level)
+            {
+                for (size_t j = 0; j < count; ++j)
+                {
+                    const float x = spheres.x[j], y = spheres.y[j], z = spheres.z[j];
+                    if (frustum.IntersectsSphere(x, y, z, c_radius) && lods.Select(x, y, z) == level)
+                    {
+                        const float row[4] = { x, y, z, float(level) };
+                        expected.insert(expected.end(), row, row + 4);
+                        ++expectedCounts[level];
+                    }
+                }
+            }
+
+            for (SphereCuller* culler : { &serial, &threaded })
+            {
+                std::vector<float> out;
+                size_t counts[LodSelector::MaxLevels] = {};
+                const size_t visible = Cull(*culler, spheres, frustum, lods, out, counts);
+
+                const bool same = visible * 4 == expected.size()
+                    && (expected.empty() || !memcmp(out.data(), expected.data(), expected.size() * sizeof(float)))
+                    && !memcmp(counts, expectedCounts, sizeof(counts));
+
+                if (!same)
+                {
+                    Fail("%s %zu spheres, %zu levels, %s: %zu visible, expected %zu",
+                        clustered ? "clustered" : "scattered", count, levels,
+                        (culler == &serial) ? "serial" : "threaded", visible, expected.size() / 4);
+                }
+            }
+        }
+    }
+
+    void CheckEdges()
+    {
+        SphereCuller empty;
+        empty.SetSpheres(0, nullptr);
+        Check(empty.Cull(MakeFrustum(150.f), c_radius, LodSelector(), nullptr,
+            [](size_t, size_t, float*, float*, float*) {},
+            [](size_t, const float*, size_t, size_t) {}) == 0, "No spheres, nothing visible");
+
+        std::mt19937 rng(5);
+        const Spheres spheres(100, false, rng);
+        SphereCuller culler;
+        culler.SetSpheres(100, spheres.bounds.data());
+
+        LodSelector bad;
+        bad.levels = 0;
+        Check([&]()
+            {
+                try
+                {
+                    std::vector<float> out;
+                    Cull(culler, spheres, MakeFrustum(150.f), bad, out, nullptr);
+                }
+                catch (const std::invalid_argument&)
+                {
+                    return true;
+                }
+                return false;
+            }(), "Zero levels throws");
+
+        // A frustum that sees nothing gets every chunk dropped by the tree.
+        size_t calls = 0;
+        const Frustum away = [&]()
+        {
+            Frustum frustum = MakeFrustum(150.f);
+            frustum.planes[Frustum::Near][3] -= 1e6f;
+            return frustum;
+        }();
+        const size_t visible = culler.Cull(away, c_radius, LodSelector(), nullptr,
+            [&](size_t begin, size_t end, float* x, float* y, float* z) { ++calls; spheres(begin, end, x, y, z); },
+            [](size_t, const float*, size_t, size_t) {});
+        Check(visible == 0 && calls == 0, "Chunks outside the frustum are not asked for centers");
+    }
+
+    template<typename Func>
+    double Time(Func&& func, int repeat = 20)
+    {
+        func();
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int j = 0; j < repeat; ++j)
+        {
+            func();
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(stop - start).count() / repeat;
+    }
+
+    void Benchmark()
+    {
+        constexpr size_t Count = 1 << 20;
+
+        std::mt19937 rng(17);
+        const Spheres spheres(Count, true, rng);
+        const Frustum frustum = MakeFrustum(60.f);
+        const LodSelector lods = MakeLods(4);
+
+        std::vector<float> out(Count * 4);
+        size_t bruteCount = 0;
+        const double brute = Time([&]()
+        {
+            bruteCount = 0;
+            for (size_t j = 0; j < Count; ++j)
+            {
+                const float x = spheres.x[j], y = spheres.y[j], z = spheres.z[j];
+                if (frustum.IntersectsSphere(x, y, z, c_radius))
+                {
+                    float* row = out.data() + bruteCount++ * 4;
+                    row[0] = x;
+                    row[1] = y;
+                    row[2] = z;
+                    row[3] = float(lods.Select(x, y, z));
+                }
+            }
+        });
+
+        WorkerPool pool;
+        SphereCuller culler(&pool);
+        culler.SetSpheres(Count, spheres.bounds.data());
+
+        size_t visible = 0;
+        const double culled = Time([&]()
+        {
+            visible = culler.Cull(frustum, c_radius, lods, nullptr, spheres, [&](size_t, const float* rows, size_t offset, size_t n)
+            {
+                memcpy(out.data() + offset * 4, rows, n * 4 * sizeof(float));
+            });
+        });
+
+        Check(visible == bruteCount, "Benchmark cull differs from testing every sphere");
+        printf("1M spheres culled to %zu in 4 levels: %.2f ms on %zu threads, testing every sphere %.2f ms\n",
+            visible, culled, pool.GetThreadCount(), brute);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    bool bench = true;
+    for (int j = 1; j < argc; ++j)
+    {
+        if (!strcmp(argv[j], "-nobench"))
+        {
+            bench = false;
+        }
+        else
+        {
+            printf("Usage: SphereCullerCheck [-nobench]\n");
+            return 1;
+        }
+    }
+
+#if defined(SPHERECULLER_AVX)
+    printf("AVX path\n");
+#elif defined(SPHERECULLER_SSE2)
+    printf("SSE2 path\n");
+#else
+    printf("Scalar path\n");
+#endif
+
+    return RunChecks([&]()
+    {
+        CheckEdges();
+
+        WorkerPool pool(4);
+        for (bool clustered : { false, true })
+        {
+            for (size_t count : { 1, 7, 8, 9, 4095, 4096, 4097, 50000 })
+            {
+                CheckLayout(count, clustered, pool);
+            }
+        }
+
+        if (bench)
+        {
+            Benchmark();
+        }
+    });
+}
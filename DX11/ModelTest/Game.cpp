@@ -12,7 +12,19 @@ using namespace DirectX::SimpleMath;
 
 using Microsoft::WRL::ComPtr;
 
-Game::Game() noexcept(false)
+// Comment out to draw every mesh in the frustum, hidden or not.
+#define USE_OCCLUSION_CULLING
+
+namespace
+{
+    // The occlusion buffer is much smaller than the window; it only has to be fine enough
+    // for the panels to hide whole meshes.
+    constexpr size_t c_occlusionWidth = 256;
+    constexpr size_t c_occlusionHeight = 192;
+}
+
+Game::Game() noexcept(false) :
+    m_occlusion(c_occlusionWidth, c_occlusionHeight)
 {
     m_deviceResources = std::make_unique<DX::DeviceResources>();
     m_deviceResources->RegisterDeviceNotify(this);
@@ -55,6 +67,17 @@ void Game::Update(DX::StepTimer const& timer)
     float time = float(timer.GetTotalSeconds());
 
     m_world = Matrix::CreateRotationZ(cosf(time) * 2.f);
+
+    // Halfway to the eye, facing it: one panel sweeps across the view, the other up and down.
+    const Vector3 eye(2.f, 2.f, 2.f);
+    const Vector3 forward = -eye / eye.Length();
+    Vector3 right = forward.Cross(Vector3::UnitY);
+    right.Normalize();
+    const Vector3 up = right.Cross(forward);
+
+    const float sweep = sinf(time * 0.5f) * 1.2f;
+    m_occluderWorld[0] = Matrix::CreateWorld(eye * 0.5f + right * sweep, forward, up);
+    m_occluderWorld[1] = Matrix::CreateWorld(eye * 0.5f - up * sweep, forward, up);
 }
 #pragma endregion
 
@@ -74,12 +97,17 @@ void Game::Render()
     auto context = m_deviceResources->GetD3DDeviceContext();
 
     // TODO: Add your rendering code here
+    for (const auto& world : m_occluderWorld)
+    {
+        m_occluder->Draw(world, m_view, m_proj, Colors::DimGray);
+    }
+
 #if 1
-    m_model->Draw(context, *m_states, m_world, m_view, m_proj);
+    DrawVisibleMeshes(context);
 #elif 0
-    m_model->Draw(context, *m_states, m_world, m_view, m_proj, true);
+    DrawVisibleMeshes(context, true);
 #else
-    m_model->Draw(context, *m_states, m_world, m_view, m_proj, false, [&]() -> void
+    DrawVisibleMeshes(context, false, [&]() -> void
     {
         auto sampler = m_states->PointClamp();
         context->PSSetSamplers(0, 1, &sampler);
@@ -92,6 +120,38 @@ void Game::Render()
     m_deviceResources->Present();
 }
 
+// Draws the meshes whose bounds intersect the view frustum and are not hidden behind the
+// occluder panels, as Model::Draw does: opaque parts first, then alpha.
+void Game::DrawVisibleMeshes(ID3D11DeviceContext* context, bool wireframe, std::function<void __cdecl()> setCustomState)
+{
+    const Matrix worldViewProj = m_world * m_view * m_proj;
+    const auto frustum = DX::Frustum::FromViewProjection(&worldViewProj._11);
+    size_t visible = m_meshTree.CullFrustum(frustum, m_visibleMeshes.data());
+
+#ifdef USE_OCCLUSION_CULLING
+    m_occlusion.Clear();
+    for (const auto& world : m_occluderWorld)
+    {
+        const Matrix occluderWorldViewProj = world * m_view * m_proj;
+        m_occlusion.RenderOccluder(&m_occluderVertices[0].position.x, sizeof(VertexPositionNormalTexture), m_occluderVertices.size(),
+            m_occluderIndices.data(), m_occluderIndices.size(), &occluderWorldViewProj._11);
+    }
+    m_occlusion.Flush();
+
+    visible = m_occlusion.CullOccluded(m_meshBoxes.data(), m_visibleMeshes.data(), visible, &worldViewProj._11, m_visibleMeshes.data());
+#endif
+
+    for (const bool alpha : { false, true })
+    {
+        for (size_t j = 0; j < visible; ++j)
+        {
+            const auto& mesh = m_model->meshes[m_visibleMeshes[j]];
+            mesh->PrepareForRendering(context, *m_states, alpha, wireframe);
+            mesh->Draw(context, m_world, m_view, m_proj, alpha, setCustomState);
+        }
+    }
+}
+
 // Helper method to clear the back buffers.
 void Game::Clear()
 {
@@ -205,6 +265,19 @@ void Game::CreateDeviceDependentResources()
     });
 #endif
 
+    m_meshBoxes.clear();
+    for (const auto& mesh : m_model->meshes)
+    {
+        m_meshBoxes.push_back(DX::AxisAlignedBox::FromCenterExtents(&mesh->boundingBox.Center.x, &mesh->boundingBox.Extents.x));
+    }
+    m_meshTree.Build(m_meshBoxes.data(), m_meshBoxes.size());
+    m_visibleMeshes.resize(m_meshBoxes.size());
+
+    // The same box is drawn and rasterized as an occluder. Its default winding is front
+    // facing, so the culler can drop its back faces.
+    GeometricPrimitive::CreateBox(m_occluderVertices, m_occluderIndices, XMFLOAT3(0.8f, 0.8f, 0.02f));
+    m_occluder = GeometricPrimitive::CreateCustom(m_deviceResources->GetD3DDeviceContext(), m_occluderVertices, m_occluderIndices);
+
     m_world = Matrix::Identity;
 }
 
@@ -223,6 +296,7 @@ void Game::OnDeviceLost()
     m_states.reset();
     m_fxFactory.reset();
     m_model.reset();
+    m_occluder.reset();
 }
 
 void Game::OnDeviceRestored()
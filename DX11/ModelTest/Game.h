@@ -6,6 +6,8 @@
 
 #include "DeviceResources.h"
 #include "StepTimer.h"
+#include "BoundingVolumeHierarchy.h"
+#include "OcclusionCuller.h"
 
 
 // A basic game implementation that creates a D3D11 device and
@@ -50,6 +52,8 @@ private:
     void Render();
 
     void Clear();
+    void DrawVisibleMeshes(ID3D11DeviceContext* context, bool wireframe = false,
+        std::function<void __cdecl()> setCustomState = nullptr);
 
     void CreateDeviceDependentResources();
     void CreateWindowSizeDependentResources();
@@ -67,4 +71,20 @@ private:
     std::unique_ptr<DirectX::CommonStates> m_states;
     std::unique_ptr<DirectX::IEffectFactory> m_fxFactory;
     std::unique_ptr<DirectX::Model> m_model;
+
+    // Model-space boxes of the meshes. The frustum is taken into model space instead, so
+    // the tree does not change as the model turns.
+    DX::BoundingVolumeHierarchy m_meshTree;
+    std::vector<DX::AxisAlignedBox> m_meshBoxes;
+    std::vector<uint32_t> m_visibleMeshes;
+
+    // Panels that slide in front of the model. They are rasterized into m_occlusion each
+    // frame, and the meshes left by the tree are tested against them before drawing.
+    static constexpr size_t c_occluderCount = 2;
+
+    DirectX::SimpleMath::Matrix m_occluderWorld[c_occluderCount];
+    std::vector<DirectX::VertexPositionNormalTexture> m_occluderVertices;
+    std::vector<uint16_t> m_occluderIndices;
+    std::unique_ptr<DirectX::GeometricPrimitive> m_occluder;
+    DX::OcclusionCuller m_occlusion;
 };
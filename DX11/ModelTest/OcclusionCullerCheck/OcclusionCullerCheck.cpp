@@ -0,0 +1,709 @@
+//--------------------------------------------------------------------------------------
+// File: OcclusionCullerCheck.cpp
+//
+// Checks OcclusionCuller.h: no pixel of the depth buffer is ever nearer than the occluders
+// there, measured against casting a ray through every pixel into every occluder triangle;
+// no box reported occluded can be seen past them; rasterizing on a WorkerPool gives the
+// same buffer as rasterizing serially. Occluders are boxes laid out the way
+// GeometricPrimitive::CreateBox lays them out, walls of a grid of rooms seen from inside.
+// Then times rasterizing the walls of a larger grid and testing 100k objects against it.
+//
+// This is a standalone console tool with no Windows or Direct3D dependencies:
+//
+//   g++ -std=c++14 -O2 -mavx -pthread -I../../Common -o OcclusionCullerCheck OcclusionCullerCheck.cpp
+//   cl /std:c++14 /O2 /EHsc /arch:AVX2 /I..\..\Common OcclusionCullerCheck.cpp
+//
+//   OcclusionCullerCheck [-nobench] [-dump file.ppm]
+//
+// -dump writes the depth buffer of the first room scene as an image, nearer brighter,
+// with the rectangles of the boxes tested outlined: green visible, red occluded.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "OcclusionCuller.h"
+#include "CheckHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    constexpr float c_nearZ = 0.1f;
+    constexpr float c_farZ = 200.f;
+
+    // Row-vector, right-handed matrices as SimpleMath::Matrix::CreateLookAt and
+    // CreatePerspectiveFieldOfView make them.
+    struct Matrix
+    {
+        float m[16];
+
+        Matrix operator* (const Matrix& other) const
+        {
+            Matrix result = {};
+            for (size_t r = 0; r < 4; ++r)
+            {
+                for (size_t c = 0; c < 4; ++c)
+                {
+                    for (size_t k = 0; k < 4; ++k)
+                    {
+                        result.m[r * 4 + c] += m[r * 4 + k] * other.m[k * 4 + c];
+                    }
+                }
+            }
+            return result;
+        }
+    };
+
+    Matrix LookAt(const float eye[3], const float target[3])
+    {
+        auto normalize = [](float v[3])
+        {
+            const float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+            v[0] /= length;
+            v[1] /= length;
+            v[2] /= length;
+        };
+
+        float z[3] = { eye[0] - target[0], eye[1] - target[1], eye[2] - target[2] };
+        normalize(z);
+        float x[3] = { z[2], 0.f, -z[0] };          // cross((0, 1, 0), z)
+        normalize(x);
+        const float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+
+        auto dot = [&](const float* a) { return a[0] * eye[0] + a[1] * eye[1] + a[2] * eye[2]; };
+
+        return Matrix{ {
+            x[0], y[0], z[0], 0.f,
+            x[1], y[1], z[1], 0.f,
+            x[2], y[2], z[2], 0.f,
+            -dot(x), -dot(y), -dot(z), 1.f } };
+    }
+
+    Matrix Perspective(float fov, float aspect, float nearZ, float farZ)
+    {
+        const float yScale = 1.f / std::tan(fov * 0.5f);
+        const float range = farZ / (nearZ - farZ);
+        return Matrix{ {
+            yScale / aspect, 0.f, 0.f, 0.f,
+            0.f, yScale, 0.f, 0.f,
+            0.f, 0.f, range, -1.f,
+            0.f, 0.f, range * nearZ, 0.f } };
+    }
+
+    Matrix ViewProjection(const float eye[3], const float target[3], size_t width, size_t height)
+    {
+        return LookAt(eye, target) * Perspective(1.2f, float(width) / float(height), c_nearZ, c_farZ);
+    }
+
+    // GeometricPrimitive::VertexType.
+    struct Vertex
+    {
+        float position[3];
+        float normal[3];
+        float textureCoordinate[2];
+    };
+
+    // A box as GeometricPrimitive::CreateBox builds it with right-handed coordinates: four
+    // vertices a face, front faces clockwise on screen.
+    struct Mesh
+    {
+        std::vector<Vertex>     vertices;
+        std::vector<uint16_t>   indices;
+
+        void AddBox(const AxisAlignedBox& box)
+        {
+            static const float normals[6][3] =
+            {
+                { 0, 0, 1 }, { 0, 0, -1 }, { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 },
+            };
+
+            float center[3], extents[3];
+            for (size_t k = 0; k < 3; ++k)
+            {
+                center[k] = (box.minimum[k] + box.maximum[k]) * 0.5f;
+                extents[k] = (box.maximum[k] - box.minimum[k]) * 0.5f;
+            }
+
+            for (const auto& n : normals)
+            {
+                const float side1[3] = { n[1], n[2], n[0] };
+                const float side2[3] = { n[1] * side1[2] - n[2] * side1[1], n[2] * side1[0] - n[0] * side1[2], n[0] * side1[1] - n[1] * side1[0] };
+                const auto base = uint16_t(vertices.size());
+
+                // Right-handed keeps the order; left-handed would reverse it.
+                for (uint16_t index : { 0, 1, 2, 0, 2, 3 })
+                {
+                    indices.push_back(uint16_t(base + index));
+                }
+
+                const float signs[4][2] = { { -1, -1 }, { -1, 1 }, { 1, 1 }, { 1, -1 } };
+                for (const auto& s : signs)
+                {
+                    Vertex vertex = {};
+                    for (size_t k = 0; k < 3; ++k)
+                    {
+                        vertex.position[k] = center[k] + (n[k] + side1[k] * s[0] + side2[k] * s[1]) * extents[k];
+                        vertex.normal[k] = n[k];
+                    }
+                    vertices.push_back(vertex);
+                }
+            }
+        }
+
+        void Render(OcclusionCuller& culler, const Matrix& viewProj, OcclusionCuller::CullMode cull = OcclusionCuller::CullMode::BackFaces) const
+        {
+            culler.RenderOccluder(vertices[0].position, sizeof(Vertex), vertices.size(), indices.data(), indices.size(), viewProj.m, cull);
+        }
+    };
+
+    // Walls of rooms x rooms rooms of the given size, each wall with a doorway in its middle,
+    // split into meshes that fit 16-bit indices.
+    std::vector<Mesh> MakeRooms(size_t rooms, float size)
+    {
+        constexpr float Height = 3.f;
+        constexpr float Thickness = 0.2f;
+        constexpr float Door = 1.2f;
+
+        std::vector<Mesh> meshes(1);
+        auto add = [&](const AxisAlignedBox& box)
+        {
+            if (meshes.back().vertices.size() + 24 > 65536)
+            {
+                meshes.emplace_back();
+            }
+            meshes.back().AddBox(box);
+        };
+
+        for (size_t line = 0; line <= rooms; ++line)
+        {
+            const float at = float(line) * size;
+            for (size_t room = 0; room < rooms; ++room)
+            {
+                const float start = float(room) * size;
+                const float middle = start + size * 0.5f;
+                const float spans[2][2] = { { start, middle - Door * 0.5f }, { middle + Door * 0.5f, start + size } };
+                for (const auto& span : spans)
+                {
+                    add(AxisAlignedBox{ { span[0], 0.f, at - Thickness }, { span[1], Height, at + Thickness } });
+                    add(AxisAlignedBox{ { at - Thickness, 0.f, span[0] }, { at + Thickness, Height, span[1] } });
+                }
+            }
+        }
+        return meshes;
+    }
+
+    std::vector<AxisAlignedBox> MakeObjects(size_t count, float extent, std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> position(0.f, extent);
+        std::uniform_real_distribution<float> size(0.1f, 0.8f);
+        std::uniform_real_distribution<float> height(0.f, 2.f);
+
+        std::vector<AxisAlignedBox> boxes(count);
+        for (auto& box : boxes)
+        {
+            const float x = position(rng);
+            const float z = position(rng);
+            const float y = height(rng);
+            const float s = size(rng);
+            box = AxisAlignedBox{ { x - s, y, z - s }, { x + s, y + s, z + s } };
+        }
+        return boxes;
+    }
+
+    void Transform(const float p[3], const Matrix& m, float clip[4])
+    {
+        for (size_t j = 0; j < 4; ++j)
+        {
+            clip[j] = p[0] * m.m[j] + p[1] * m.m[4 + j] + p[2] * m.m[8 + j] + m.m[12 + j];
+        }
+    }
+
+    // The nearest depth of any occluder triangle along the ray through each pixel center,
+    // counting points slightly outside the triangles so that it can only be nearer than
+    // the exact answer.
+    std::vector<float> Reference(const std::vector<Mesh>& meshes, const Matrix& viewProj, size_t width, size_t height)
+    {
+        std::vector<float> depths(width * height, std::numeric_limits<float>::infinity());
+
+        for (const auto& mesh : meshes)
+        {
+            std::vector<float> clip(mesh.vertices.size() * 4);
+            for (size_t j = 0; j < mesh.vertices.size(); ++j)
+            {
+                Transform(mesh.vertices[j].position, viewProj, &clip[j * 4]);
+            }
+
+            for (size_t t = 0; t < mesh.indices.size(); t += 3)
+            {
+                const float* v[3] = { &clip[mesh.indices[t] * 4], &clip[mesh.indices[t + 1] * 4], &clip[mesh.indices[t + 2] * 4] };
+                if (v[0][3] <= 0.f && v[1][3] <= 0.f && v[2][3] <= 0.f)
+                    continue;
+
+                for (size_t py = 0; py < height; ++py)
+                {
+                    const float ny = 1.f - (float(py) + 0.5f) / float(height) * 2.f;
+                    for (size_t px = 0; px < width; ++px)
+                    {
+                        const float nx = (float(px) + 0.5f) / float(width) * 2.f - 1.f;
+
+                        // Weights a, b, c with a + b + c = 1 of the point of the triangle's
+                        // plane that projects to the pixel center.
+                        double u[3], w[3];
+                        for (size_t k = 0; k < 3; ++k)
+                        {
+                            u[k] = double(v[k][0]) - double(nx) * v[k][3];
+                            w[k] = double(v[k][1]) - double(ny) * v[k][3];
+                        }
+                        double weights[3] = { u[1] * w[2] - u[2] * w[1], u[2] * w[0] - u[0] * w[2], u[0] * w[1] - u[1] * w[0] };
+                        const double sum = weights[0] + weights[1] + weights[2];
+                        if (std::fabs(sum) < 1e-12)
+                            continue;
+
+                        bool inside = true;
+                        double point[4] = {};
+                        for (size_t k = 0; k < 3; ++k)
+                        {
+                            weights[k] /= sum;
+                            inside &= (weights[k] >= -1e-3);
+                            for (size_t c = 0; c < 4; ++c)
+                            {
+                                point[c] += weights[k] * v[k][c];
+                            }
+                        }
+                        if (!inside || point[3] <= 0.0 || point[2] < -1e-6 * point[3] || point[2] > point[3])
+                            continue;
+
+                        float& depth = depths[py * width + px];
+                        depth = std::min(depth, float(point[2] / point[3]));
+                    }
+                }
+            }
+        }
+        return depths;
+    }
+
+    struct Rect
+    {
+        float left, top, right, bottom, minDepth;
+    };
+
+    // The projected rectangle of a box entirely in front of the near plane.
+    bool Project(const AxisAlignedBox& box, const Matrix& viewProj, size_t width, size_t height, Rect& rect)
+    {
+        rect = { 1e30f, 1e30f, -1e30f, -1e30f, 1e30f };
+        for (size_t j = 0; j < 8; ++j)
+        {
+            const float corner[3] =
+            {
+                (j & 1) ? box.maximum[0] : box.minimum[0],
+                (j & 2) ? box.maximum[1] : box.minimum[1],
+                (j & 4) ? box.maximum[2] : box.minimum[2],
+            };
+            float clip[4];
+            Transform(corner, viewProj, clip);
+            if (!(clip[2] > 0.f && clip[3] > 0.f))
+                return false;
+
+            const float x = (clip[0] / clip[3] * 0.5f + 0.5f) * float(width);
+            const float y = (0.5f - clip[1] / clip[3] * 0.5f) * float(height);
+            rect.left = std::min(rect.left, x);
+            rect.right = std::max(rect.right, x);
+            rect.top = std::min(rect.top, y);
+            rect.bottom = std::max(rect.bottom, y);
+            rect.minDepth = std::min(rect.minDepth, clip[2] / clip[3]);
+        }
+        return true;
+    }
+
+    uint32_t Hash(const OcclusionCuller& culler)
+    {
+        uint32_t hash = 2166136261u;
+        for (size_t y = 0; y < culler.GetHeight(); ++y)
+        {
+            for (size_t x = 0; x < culler.GetWidth(); ++x)
+            {
+                const float depth = culler.GetPixelDepth(x, y);
+                uint32_t bits;
+                memcpy(&bits, &depth, sizeof(bits));
+                hash = (hash ^ bits) * 16777619u;
+            }
+        }
+        return hash;
+    }
+
+    void Dump(const char* path, const OcclusionCuller& culler, const std::vector<Rect>& rects, const std::vector<bool>& occluded)
+    {
+        const size_t width = culler.GetWidth();
+        const size_t height = culler.GetHeight();
+        std::vector<uint8_t> image(width * height * 3);
+        for (size_t y = 0; y < height; ++y)
+        {
+            for (size_t x = 0; x < width; ++x)
+            {
+                // Back to the distance from the eye, then nearer brighter.
+                const float depth = culler.GetPixelDepth(x, y);
+                const float distance = c_farZ * c_nearZ / (c_farZ - std::min(depth, 1.f) * (c_farZ - c_nearZ));
+                const auto gray = uint8_t(std::isinf(depth) ? 0.f : 255.f * (1.f - std::sqrt(distance / c_farZ)));
+                std::fill_n(&image[(y * width + x) * 3], 3, gray);
+            }
+        }
+
+        for (size_t j = 0; j < rects.size(); ++j)
+        {
+            const uint8_t color[3] = { uint8_t(occluded[j] ? 255 : 0), uint8_t(occluded[j] ? 0 : 255), 0 };
+            const auto clampX = [&](float x) { return size_t(std::min(std::max(x, 0.f), float(width - 1))); };
+            const auto clampY = [&](float y) { return size_t(std::min(std::max(y, 0.f), float(height - 1))); };
+            const size_t x0 = clampX(rects[j].left), x1 = clampX(rects[j].right);
+            const size_t y0 = clampY(rects[j].top), y1 = clampY(rects[j].bottom);
+            for (size_t x = x0; x <= x1; ++x)
+            {
+                memcpy(&image[(y0 * width + x) * 3], color, 3);
+                memcpy(&image[(y1 * width + x) * 3], color, 3);
+            }
+            for (size_t y = y0; y <= y1; ++y)
+            {
+                memcpy(&image[(y * width + x0) * 3], color, 3);
+                memcpy(&image[(y * width + x1) * 3], color, 3);
+            }
+        }
+
+        FILE* file = fopen(path, "wb");
+        if (!file)
+            throw std::runtime_error("Can't write the dump");
+
+        fprintf(file, "P6\n%zu %zu\n255\n", width, height);
+        const bool written = fwrite(image.data(), 1, image.size(), file) == image.size();
+        fclose(file);
+        if (!written)
+            throw std::runtime_error("Can't write the dump");
+
+        printf("Wrote %s\n", path);
+    }
+
+    void CheckErrors()
+    {
+        auto throwsInvalid = [](size_t width, size_t height)
+        {
+            try
+            {
+                OcclusionCuller culler(width, height);
+            }
+            catch (const std::invalid_argument&)
+            {
+                return true;
+            }
+            return false;
+        };
+        Check(throwsInvalid(0, 64), "Zero width accepted");
+        Check(throwsInvalid(100, 64), "Width off the tile size accepted");
+        Check(throwsInvalid(64, 30), "Height off the tile size accepted");
+        Check(throwsInvalid(16384, 64), "Width over the limit accepted");
+
+        OcclusionCuller culler(64, 32);
+        const float position[3] = {};
+        const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+        const uint16_t indices[4] = { 0, 0, 0, 1 };
+
+        bool thrown = false;
+        try
+        {
+            culler.RenderOccluder(position, sizeof(position), 1, indices, 2, identity);
+        }
+        catch (const std::invalid_argument&)
+        {
+            thrown = true;
+        }
+        Check(thrown, "Index count off a triangle accepted");
+
+        thrown = false;
+        try
+        {
+            culler.RenderOccluder(position, sizeof(position), 1, indices + 1, 3, identity);
+        }
+        catch (const std::out_of_range&)
+        {
+            thrown = true;
+        }
+        Check(thrown, "Index past the vertices accepted");
+
+        thrown = false;
+        try
+        {
+            culler.GetPixelDepth(64, 0);
+        }
+        catch (const std::out_of_range&)
+        {
+            thrown = true;
+        }
+        Check(thrown, "Pixel out of range accepted");
+    }
+
+    // A single wall that fills the view, with boxes behind, in front of and through it.
+    void CheckWall()
+    {
+        constexpr size_t Width = 128;
+        constexpr size_t Height = 64;
+
+        const float eye[3] = { 0.f, 1.f, 10.f };
+        const float target[3] = { 0.f, 1.f, 0.f };
+        const Matrix viewProj = ViewProjection(eye, target, Width, Height);
+
+        using Visibility = OcclusionCuller::Visibility;
+        OcclusionCuller culler(Width, Height);
+
+        const AxisAlignedBox behind = { { -1.f, 0.f, -5.f }, { 1.f, 2.f, -3.f } };
+        const AxisAlignedBox front = { { -1.f, 0.f, 3.f }, { 1.f, 2.f, 5.f } };
+        const AxisAlignedBox through = { { -1.f, 0.f, -2.f }, { 1.f, 2.f, 2.f } };
+        const AxisAlignedBox crossing = { { -1.f, 0.f, 8.f }, { 1.f, 2.f, 12.f } };
+        const AxisAlignedBox back = { { -1.f, 0.f, 20.f }, { 1.f, 2.f, 22.f } };
+        const AxisAlignedBox aside = { { 100.f, 0.f, 0.f }, { 102.f, 2.f, 2.f } };
+
+        Check(culler.TestBox(behind, viewProj.m) == Visibility::Visible, "Box occluded in an empty buffer");
+        Check(culler.TestBox(crossing, viewProj.m) == Visibility::Visible, "Box across the near plane not visible");
+        Check(culler.TestBox(back, viewProj.m) == Visibility::ViewCulled, "Box behind the eye not view culled");
+        Check(culler.TestBox(aside, viewProj.m) == Visibility::ViewCulled, "Box aside not view culled");
+
+        Mesh wall;
+        wall.AddBox(AxisAlignedBox{ { -50.f, -50.f, -0.5f }, { 50.f, 50.f, 0.5f } });
+        wall.Render(culler, viewProj);
+        const size_t faces = culler.GetQueuedTriangleCount();
+        culler.Flush();
+
+        Check(culler.TestBox(behind, viewProj.m) == Visibility::Occluded, "Box behind the wall not occluded");
+        Check(culler.TestBox(front, viewProj.m) == Visibility::Visible, "Box in front of the wall not visible");
+        Check(culler.TestBox(through, viewProj.m) == Visibility::Visible, "Box through the wall not visible");
+        Check(culler.TestBox(crossing, viewProj.m) == Visibility::Visible, "Box across the near plane not visible");
+
+        // The front face alone gives the same depth as all of the faces.
+        OcclusionCuller both(Width, Height);
+        wall.Render(both, viewProj, OcclusionCuller::CullMode::None);
+        Check(both.GetQueuedTriangleCount() == 2 * faces, "Back faces of the wall not culled");
+        both.Flush();
+        Check(Hash(both) == Hash(culler), "Culling back faces changes the depth");
+
+        std::vector<AxisAlignedBox> boxes = { behind, front, through, aside };
+        const uint32_t candidates[4] = { 0, 1, 2, 3 };
+        uint32_t visible[4];
+        const size_t count = culler.CullOccluded(boxes.data(), candidates, 4, viewProj.m, visible);
+        Check(count == 2 && visible[0] == 1 && visible[1] == 2, "CullOccluded kept the wrong boxes");
+
+        culler.Clear();
+        Check(culler.TestBox(behind, viewProj.m) == Visibility::Visible, "Clear left depth behind");
+    }
+
+    void CheckRooms(size_t scene, const char* dumpPath)
+    {
+        constexpr size_t Width = 256;
+        constexpr size_t Height = 144;
+        constexpr size_t Rooms = 5;
+        constexpr float Size = 8.f;
+
+        std::mt19937 rng(uint32_t(scene) * 7 + 3);
+        std::uniform_real_distribution<float> position(1.f, float(Rooms) * Size - 1.f);
+        std::uniform_real_distribution<float> eyeHeight(0.3f, 2.5f);
+
+        // Off the walls, so that the eye is never inside one.
+        float eye[3];
+        do
+        {
+            eye[0] = position(rng);
+            eye[2] = position(rng);
+        } while (std::fabs(std::remainder(eye[0], Size)) < 0.5f || std::fabs(std::remainder(eye[2], Size)) < 0.5f);
+        eye[1] = eyeHeight(rng);
+        const float target[3] = { position(rng), eyeHeight(rng), position(rng) };
+        const Matrix viewProj = ViewProjection(eye, target, Width, Height);
+
+        const auto walls = MakeRooms(Rooms, Size);
+        WorkerPool pool(4);
+        OcclusionCuller serial(Width, Height);
+        OcclusionCuller threaded(Width, Height, &pool);
+        for (const auto& mesh : walls)
+        {
+            mesh.Render(serial, viewProj);
+            mesh.Render(threaded, viewProj);
+        }
+        serial.Flush();
+        threaded.Flush();
+        Check(Hash(serial) == Hash(threaded), "Rasterizing on a WorkerPool changes the depth");
+
+        const auto reference = Reference(walls, viewProj, Width, Height);
+        size_t covered = 0;
+        size_t nearer = 0;
+        for (size_t y = 0; y < Height; ++y)
+        {
+            for (size_t x = 0; x < Width; ++x)
+            {
+                const float depth = serial.GetPixelDepth(x, y);
+                covered += std::isinf(depth) ? 0 : 1;
+                nearer += (depth < reference[y * Width + x] - 1e-5f) ? 1 : 0;
+            }
+        }
+        Check(nearer == 0, "Depth nearer than the occluders");
+
+        const auto objects = MakeObjects(2000, float(Rooms) * Size, rng);
+        std::vector<Rect> rects;
+        std::vector<bool> occluded;
+        size_t counts[3] = {};
+        size_t seen = 0;
+        for (const auto& box : objects)
+        {
+            const auto visibility = serial.TestBox(box, viewProj.m);
+            ++counts[size_t(visibility)];
+
+            Rect rect;
+            if (visibility == OcclusionCuller::Visibility::ViewCulled || !Project(box, viewProj, Width, Height, rect))
+                continue;
+
+            rects.push_back(rect);
+            occluded.push_back(visibility == OcclusionCuller::Visibility::Occluded);
+            if (visibility != OcclusionCuller::Visibility::Occluded)
+                continue;
+
+            // Some pixel of the rectangle would have to show the box.
+            const size_t x0 = size_t(std::max(rect.left, 0.f));
+            const size_t y0 = size_t(std::max(rect.top, 0.f));
+            const size_t x1 = std::min(size_t(std::max(rect.right, 0.f)), Width - 1);
+            const size_t y1 = std::min(size_t(std::max(rect.bottom, 0.f)), Height - 1);
+            bool hidden = true;
+            for (size_t y = y0; y <= y1; ++y)
+            {
+                for (size_t x = x0; x <= x1; ++x)
+                {
+                    hidden &= (rect.minDepth >= reference[y * Width + x] - 1e-5f);
+                }
+            }
+            seen += hidden ? 0 : 1;
+        }
+        Check(seen == 0, "Box occluded that can be seen");
+
+        printf("Rooms %zu: %5zu of %zu pixels covered, %zu visible, %zu occluded, %zu view culled, depth %08x\n",
+            scene, covered, Width * Height, counts[0], counts[1], counts[2], Hash(serial));
+
+        if (dumpPath)
+        {
+            Dump(dumpPath, serial, rects, occluded);
+        }
+    }
+
+    template<typename Func>
+    double Time(Func func, size_t repeat = 1)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t j = 0; j < repeat; ++j)
+        {
+            func();
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(stop - start).count() / repeat;
+    }
+
+    void Benchmark()
+    {
+        constexpr size_t Width = 640;
+        constexpr size_t Height = 360;
+        constexpr size_t Rooms = 25;
+        constexpr float Size = 8.f;
+        constexpr size_t Count = 100000;
+
+        const auto walls = MakeRooms(Rooms, Size);
+        size_t triangles = 0;
+        for (const auto& mesh : walls)
+        {
+            triangles += mesh.indices.size() / 3;
+        }
+
+        std::mt19937 rng(5);
+        const auto objects = MakeObjects(Count, float(Rooms) * Size, rng);
+        BoundingVolumeHierarchy tree;
+        tree.Build(objects.data(), objects.size());
+
+        const float eye[3] = { 3.f, 1.6f, 2.f };
+        const float target[3] = { 60.f, 1.2f, 45.f };
+        const Matrix viewProj = ViewProjection(eye, target, Width, Height);
+        const Frustum frustum = Frustum::FromViewProjection(viewProj.m);
+
+        WorkerPool pool;
+        OcclusionCuller serial(Width, Height);
+        OcclusionCuller threaded(Width, Height, &pool);
+        auto render = [&](OcclusionCuller& culler)
+        {
+            culler.Clear();
+            for (const auto& mesh : walls)
+            {
+                mesh.Render(culler, viewProj);
+            }
+            culler.Flush();
+        };
+        const double rasterSerial = Time([&]() { render(serial); }, 20);
+        const double rasterThreaded = Time([&]() { render(threaded); }, 20);
+
+        std::vector<uint32_t> candidates(Count);
+        std::vector<uint32_t> visible(Count);
+        size_t inFrustum = 0;
+        size_t count = 0;
+        const double cull = Time([&]() { inFrustum = tree.CullFrustum(frustum, candidates.data()); }, 20);
+        const double test = Time([&]()
+        {
+            count = serial.CullOccluded(objects.data(), candidates.data(), inFrustum, viewProj.m, visible.data());
+        }, 20);
+
+        printf("%zu wall triangles at %zux%zu: %.3f ms, on %zu threads %.3f ms\n",
+            triangles, Width, Height, rasterSerial, pool.GetThreadCount(), rasterThreaded);
+        printf("100k objects: %zu in the frustum (%.3f ms), %zu of them not occluded (%.3f ms)\n", inFrustum, cull, count, test);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    bool bench = true;
+    const char* dumpPath = nullptr;
+    for (int j = 1; j < argc; ++j)
+    {
+        if (!strcmp(argv[j], "-nobench"))
+        {
+            bench = false;
+        }
+        else if (!strcmp(argv[j], "-dump") && j + 1 < argc)
+        {
+            dumpPath = argv[++j];
+        }
+        else
+        {
+            printf("Usage: OcclusionCullerCheck [-nobench] [-dump file.ppm]\n");
+            return 1;
+        }
+    }
+
+#if defined(OCCLUSIONCULLER_AVX)
+    printf("AVX path\n");
+#elif defined(OCCLUSIONCULLER_SSE2)
+    printf("SSE2 path\n");
+#else
+    printf("Scalar path\n");
+#endif
+
+    return RunChecks([&]()
+    {
+        CheckErrors();
+        CheckWall();
+        for (size_t scene = 0; scene < 4; ++scene)
+        {
+            CheckRooms(scene, scene ? nullptr : dumpPath);
+        }
+
+        if (bench)
+        {
+            Benchmark();
+        }
+    });
+}
@@ -0,0 +1,607 @@
+//--------------------------------------------------------------------------------------
+// File: BloomCPU.h
+//
+// CPU implementation of the bloom in Game::PostProcess: BloomExtract.hlsl into a half size
+// target, GaussianBlur.hlsl horizontally then vertically, and BloomCombine.hlsl back at
+// full size. Sampling follows the GPU passes (bilinear, clamp addressing) and by default
+// intermediates are rounded to 8 bits like the UNORM render targets, so results can be
+// compared with GPU captures. Work is split into row bands across threads; the vertical
+// blur is tiled by columns so its input rows stay in cache. With AVX2 enabled the passes
+// are vectorized. SetDualFilter replaces the blur with the DualFilter.h mip chain.
+//
+// This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "BloomPresets.h"
+#include "DualFilter.h"
+#include "ParallelFor.h"
+
+namespace Bloom
+{
+    class BloomProcessor
+    {
+    public:
+        enum PixelOrder
+        {
+            PixelOrder_RGBA,
+            PixelOrder_BGRA,
+        };
+
+        BloomProcessor() noexcept :
+            m_parameters(g_BloomPresets[Default]),
+            m_passThrough(false),
+            m_emulateUnorm8(true),
+            m_kernel{},
+            m_grey{},
+            m_halfWidth(0),
+            m_halfHeight(0),
+            m_dualLevels(0),
+            m_scatter(DUAL_FILTER_DEFAULT_SCATTER)
+        {
+            BuildKernel();
+        }
+
+        BloomProcessor(BloomProcessor&&) = default;
+        BloomProcessor& operator= (BloomProcessor&&) = default;
+
+        BloomProcessor(BloomProcessor const&) = delete;
+        BloomProcessor& operator= (BloomProcessor const&) = delete;
+
+        // None copies the source, like the pass-through path in Game::PostProcess.
+        void SetPreset(BloomPresets preset)
+        {
+            if (preset < 0 || preset >= BloomPresets_Count)
+                throw std::out_of_range("SetPreset");
+
+            m_parameters = g_BloomPresets[preset];
+            m_passThrough = (preset == None);
+            BuildKernel();
+        }
+
+        void SetParameters(const VS_BLOOM_PARAMETERS& parameters)
+        {
+            if (parameters.bloomThreshold >= 1.f || parameters.blurAmount <= 0.f)
+                throw std::invalid_argument("SetParameters");
+
+            m_parameters = parameters;
+            m_passThrough = false;
+            BuildKernel();
+        }
+
+        // Rounds intermediate results to 8 bits, matching the back buffer format targets.
+        void SetEmulateUnorm8(bool value) noexcept { m_emulateUnorm8 = value; }
+
+        // Blurs with a dual filter chain of the given number of levels instead of the
+        // Gaussian; 0 restores the Gaussian. The count is clamped to the image size.
+        void SetDualFilter(uint32_t levels, float scatter = DUAL_FILTER_DEFAULT_SCATTER)
+        {
+            if (levels > DUAL_FILTER_MAX_LEVELS || scatter < 0.f || scatter > 1.f)
+                throw std::invalid_argument("SetDualFilter");
+
+            m_dualLevels = levels;
+            m_scatter = scatter;
+        }
+
+        // Applies bloom to a 4 channel, 8 bits per channel image. dest may not alias source.
+        void Process(const uint8_t* source, size_t sourcePitch, uint32_t width, uint32_t height,
+            uint8_t* dest, size_t destPitch, PixelOrder order = PixelOrder_RGBA)
+        {
+            if (!source || !dest || width < 4 || height < 4)
+                throw std::invalid_argument("Process");
+
+            if (m_passThrough)
+            {
+                for (uint32_t y = 0; y < height; ++y)
+                {
+                    memcpy(dest + y * destPitch, source + y * sourcePitch, size_t(width) * 4);
+                }
+                return;
+            }
+
+            Resize(width, height);
+
+            // Luminance weights for AdjustSaturation in memory order.
+            if (order == PixelOrder_BGRA)
+            {
+                m_grey[0] = 0.11f; m_grey[1] = 0.59f; m_grey[2] = 0.3f;
+            }
+            else
+            {
+                m_grey[0] = 0.3f; m_grey[1] = 0.59f; m_grey[2] = 0.11f;
+            }
+            m_grey[3] = 0.f;
+
+            DX::ParallelFor(m_halfHeight, 16, [&](size_t begin, size_t end)
+            {
+                Extract(source, sourcePitch, begin, end);
+            });
+
+            if (m_dualLevels)
+            {
+                DualFilter(width, height);
+            }
+            else
+            {
+                DX::ParallelFor(m_halfHeight, 16, [&](size_t begin, size_t end)
+                {
+                    BlurHorizontal(begin, end);
+                });
+
+                DX::ParallelFor(m_halfHeight, 16, [&](size_t begin, size_t end)
+                {
+                    BlurVertical(begin, end);
+                });
+            }
+
+            DX::ParallelFor(height, 16, [&](size_t begin, size_t end)
+            {
+                Combine(source, sourcePitch, dest, destPitch, begin, end);
+            });
+        }
+
+        uint32_t GetHalfWidth() const noexcept { return m_halfWidth; }
+        uint32_t GetHalfHeight() const noexcept { return m_halfHeight; }
+
+    private:
+        static constexpr int KernelRadius = int(BLUR_SAMPLE_COUNT / 2) * 2;  // 14 texels
+        static constexpr int KernelSize = KernelRadius * 2 + 1;
+        static constexpr size_t TileFloats = 256;
+
+        struct Tap
+        {
+            uint32_t    index;      // First texel
+            float       weight;     // Weight of the second texel
+        };
+
+        // The 15 bilinear taps land halfway between texels, so the blur is a 29 texel kernel
+        // where each tap weight is split evenly between its two texels.
+        void BuildKernel()
+        {
+            float weights[BLUR_SAMPLE_COUNT];
+            float offsets[BLUR_SAMPLE_COUNT];
+            ComputeBlurKernel(m_parameters.blurAmount, weights, offsets);
+
+            std::fill(std::begin(m_kernel), std::end(m_kernel), 0.f);
+            m_kernel[KernelRadius] = weights[0];
+            for (size_t i = 1; i < BLUR_SAMPLE_COUNT; ++i)
+            {
+                const int lo = int(std::floor(offsets[i]));
+                m_kernel[KernelRadius + lo] += weights[i] * 0.5f;
+                m_kernel[KernelRadius + lo + 1] += weights[i] * 0.5f;
+            }
+        }
+
+        // Texel and weight pairs for bilinear sampling of srcSize texels at the centers of
+        // destSize pixels covering the same range, with clamp addressing.
+        static void BuildTaps(uint32_t destSize, uint32_t srcSize, std::vector<Tap>& taps)
+        {
+            taps.resize(destSize);
+            const float scale = float(srcSize) / float(destSize);
+            for (uint32_t i = 0; i < destSize; ++i)
+            {
+                const float t = (float(i) + 0.5f) * scale - 0.5f;
+                const float f = std::floor(t);
+                if (f < 0.f)
+                {
+                    taps[i] = Tap{ 0, 0.f };
+                }
+                else if (uint32_t(f) >= srcSize - 1)
+                {
+                    taps[i] = Tap{ srcSize - 2, 1.f };
+                }
+                else
+                {
+                    taps[i] = Tap{ uint32_t(f), t - f };
+                }
+            }
+        }
+
+        void Resize(uint32_t width, uint32_t height)
+        {
+            // Matches m_bloomRect.
+            const uint32_t halfWidth = width / 2;
+            const uint32_t halfHeight = height / 2;
+
+            if (halfWidth != m_halfWidth || halfHeight != m_halfHeight || m_upX.size() != width || m_upY.size() != height)
+            {
+                m_halfWidth = halfWidth;
+                m_halfHeight = halfHeight;
+
+                const size_t floats = size_t(halfWidth) * halfHeight * 4;
+                m_half1.resize(floats);
+                m_half2.resize(floats);
+
+                BuildTaps(halfWidth, width, m_downX);
+                BuildTaps(halfHeight, height, m_downY);
+                BuildTaps(width, halfWidth, m_upX);
+                BuildTaps(height, halfHeight, m_upY);
+            }
+        }
+
+        float Quantize(float value) const noexcept
+        {
+            if (!m_emulateUnorm8)
+                return value;
+
+            value = std::min(std::max(value, 0.f), 1.f);
+            return std::nearbyint(value * 255.f) * (1.f / 255.f);
+        }
+
+    #if defined(__AVX2__)
+        __m128 Quantize4(__m128 value) const noexcept
+        {
+            if (!m_emulateUnorm8)
+                return value;
+
+            value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.f));
+            return _mm_mul_ps(_mm_round_ps(_mm_mul_ps(value, _mm_set1_ps(255.f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC),
+                _mm_set1_ps(1.f / 255.f));
+        }
+
+        __m256 Quantize8(__m256 value) const noexcept
+        {
+            if (!m_emulateUnorm8)
+                return value;
+
+            value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+            return _mm256_mul_ps(_mm256_round_ps(_mm256_mul_ps(value, _mm256_set1_ps(255.f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC),
+                _mm256_set1_ps(1.f / 255.f));
+        }
+
+        static __m128 LoadPixel(const uint8_t* pixel) noexcept
+        {
+            int32_t bits;
+            memcpy(&bits, pixel, sizeof(bits));
+            return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(bits)));
+        }
+    #endif
+
+        // BloomExtract.hlsl: saturate((c - BloomThreshold) / (1 - BloomThreshold)).
+        void Extract(const uint8_t* source, size_t pitch, size_t begin, size_t end)
+        {
+            const float threshold = m_parameters.bloomThreshold;
+            const float scale = 1.f / (255.f * (1.f - threshold));
+
+            for (size_t y = begin; y < end; ++y)
+            {
+                const Tap ty = m_downY[y];
+                const uint8_t* row0 = source + size_t(ty.index) * pitch;
+                const uint8_t* row1 = row0 + pitch;
+                float* out = &m_half1[y * m_halfWidth * 4];
+
+            #if defined(__AVX2__)
+                const __m128 wy = _mm_set1_ps(ty.weight);
+                const __m128 t = _mm_set1_ps(threshold * 255.f);
+                const __m128 s = _mm_set1_ps(scale);
+                for (uint32_t x = 0; x < m_halfWidth; ++x)
+                {
+                    const Tap tx = m_downX[x];
+                    const __m128 wx = _mm_set1_ps(tx.weight);
+                    const uint8_t* p0 = row0 + size_t(tx.index) * 4;
+                    const uint8_t* p1 = row1 + size_t(tx.index) * 4;
+
+                    const __m128 a = _mm_add_ps(LoadPixel(p0), _mm_mul_ps(_mm_sub_ps(LoadPixel(p0 + 4), LoadPixel(p0)), wx));
+                    const __m128 b = _mm_add_ps(LoadPixel(p1), _mm_mul_ps(_mm_sub_ps(LoadPixel(p1 + 4), LoadPixel(p1)), wx));
+                    const __m128 c = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), wy));
+
+                    __m128 v = _mm_mul_ps(_mm_sub_ps(c, t), s);
+                    v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.f));
+                    _mm_storeu_ps(out + x * 4, Quantize4(v));
+                }
+            #else
+                for (uint32_t x = 0; x < m_halfWidth; ++x)
+                {
+                    const Tap tx = m_downX[x];
+                    const uint8_t* p0 = row0 + size_t(tx.index) * 4;
+                    const uint8_t* p1 = row1 + size_t(tx.index) * 4;
+
+                    for (size_t c = 0; c < 4; ++c)
+                    {
+                        const float a = float(p0[c]) + (float(p0[c + 4]) - float(p0[c])) * tx.weight;
+                        const float b = float(p1[c]) + (float(p1[c + 4]) - float(p1[c])) * tx.weight;
+                        const float v = (a + (b - a) * ty.weight - threshold * 255.f) * scale;
+                        out[x * 4 + c] = Quantize(std::min(std::max(v, 0.f), 1.f));
+                    }
+                }
+            #endif
+            }
+        }
+
+        // GaussianBlur.hlsl with horizontal offsets, m_half1 -> m_half2.
+        void BlurHorizontal(size_t begin, size_t end)
+        {
+            // Row copy with the edge texels replicated, so every output uses the full kernel.
+            std::vector<float> padded((size_t(m_halfWidth) + 2 * KernelRadius) * 4);
+
+            for (size_t y = begin; y < end; ++y)
+            {
+                const float* in = &m_half1[y * m_halfWidth * 4];
+                float* out = &m_half2[y * m_halfWidth * 4];
+
+                for (int x = 0; x < KernelRadius; ++x)
+                {
+                    memcpy(&padded[size_t(x) * 4], in, 4 * sizeof(float));
+                    memcpy(&padded[(size_t(m_halfWidth) + KernelRadius + x) * 4], in + (m_halfWidth - 1) * 4, 4 * sizeof(float));
+                }
+                memcpy(&padded[KernelRadius * 4], in, size_t(m_halfWidth) * 4 * sizeof(float));
+
+                const size_t count = size_t(m_halfWidth) * 4;
+                size_t i = 0;
+
+            #if defined(__AVX2__)
+                for (; i + 8 <= count; i += 8)
+                {
+                    // The kernel is symmetric, so mirrored texels share a multiply.
+                    const float* center = &padded[size_t(KernelRadius) * 4 + i];
+                    __m256 acc = _mm256_mul_ps(_mm256_set1_ps(m_kernel[KernelRadius]), _mm256_loadu_ps(center));
+                    for (int k = 1; k <= KernelRadius; ++k)
+                    {
+                        const __m256 pair = _mm256_add_ps(_mm256_loadu_ps(center - k * 4), _mm256_loadu_ps(center + k * 4));
+                        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(m_kernel[KernelRadius + k]), pair));
+                    }
+                    _mm256_storeu_ps(out + i, Quantize8(acc));
+                }
+            #endif
+
+                for (; i < count; ++i)
+                {
+                    const float* center = &padded[size_t(KernelRadius) * 4 + i];
+                    float acc = m_kernel[KernelRadius] * center[0];
+                    for (int k = 1; k <= KernelRadius; ++k)
+                    {
+                        acc += m_kernel[KernelRadius + k] * (center[-k * 4] + center[k * 4]);
+                    }
+                    out[i] = Quantize(acc);
+                }
+            }
+        }
+
+        // GaussianBlur.hlsl with vertical offsets, m_half2 -> m_half1. Column tiles keep the
+        // kernel's input rows in cache while a band of output rows is produced.
+        void BlurVertical(size_t begin, size_t end)
+        {
+            const size_t rowFloats = size_t(m_halfWidth) * 4;
+            const int lastRow = int(m_halfHeight) - 1;
+
+            for (size_t tile = 0; tile < rowFloats; tile += TileFloats)
+            {
+                const size_t tileEnd = std::min(rowFloats, tile + TileFloats);
+
+                for (size_t y = begin; y < end; ++y)
+                {
+                    const float* rows[KernelSize];
+                    for (int k = 0; k < KernelSize; ++k)
+                    {
+                        const int row = std::min(std::max(int(y) + k - KernelRadius, 0), lastRow);
+                        rows[k] = &m_half2[size_t(row) * rowFloats];
+                    }
+
+                    float* out = &m_half1[y * rowFloats];
+                    size_t i = tile;
+
+                #if defined(__AVX2__)
+                    for (; i + 8 <= tileEnd; i += 8)
+                    {
+                        __m256 acc = _mm256_mul_ps(_mm256_set1_ps(m_kernel[KernelRadius]), _mm256_loadu_ps(rows[KernelRadius] + i));
+                        for (int k = 1; k <= KernelRadius; ++k)
+                        {
+                            const __m256 pair = _mm256_add_ps(_mm256_loadu_ps(rows[KernelRadius - k] + i), _mm256_loadu_ps(rows[KernelRadius + k] + i));
+                            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(m_kernel[KernelRadius + k]), pair));
+                        }
+                        _mm256_storeu_ps(out + i, Quantize8(acc));
+                    }
+                #endif
+
+                    for (; i < tileEnd; ++i)
+                    {
+                        float acc = m_kernel[KernelRadius] * rows[KernelRadius][i];
+                        for (int k = 1; k <= KernelRadius; ++k)
+                        {
+                            acc += m_kernel[KernelRadius + k] * (rows[KernelRadius - k][i] + rows[KernelRadius + k][i]);
+                        }
+                        out[i] = Quantize(acc);
+                    }
+                }
+            }
+        }
+
+        // DualDownsample.hlsl down the chain from m_half1, then DualUpsample.hlsl blended back
+        // up into m_half1.
+        void DualFilter(uint32_t width, uint32_t height)
+        {
+            const uint32_t levels = ClampDualFilterLevels(width, height, m_dualLevels);
+            if (m_levels.size() < levels)
+            {
+                m_levels.resize(levels);
+            }
+
+            for (uint32_t i = 1; i < levels; ++i)
+            {
+                m_levels[i].resize(size_t(DualFilterLevelSize(width, i)) * DualFilterLevelSize(height, i) * 4);
+            }
+
+            auto level = [&](uint32_t i) { return i ? m_levels[i].data() : m_half1.data(); };
+
+            for (uint32_t i = 1; i < levels; ++i)
+            {
+                const uint32_t sw = DualFilterLevelSize(width, i - 1);
+                const uint32_t sh = DualFilterLevelSize(height, i - 1);
+                const uint32_t dw = DualFilterLevelSize(width, i);
+                const uint32_t dh = DualFilterLevelSize(height, i);
+
+                DX::ParallelFor(dh, 16, [&](size_t begin, size_t end)
+                {
+                    DualDownsample(level(i - 1), sw, sh, level(i), dw, dh, begin, end);
+                    QuantizeRows(level(i), dw, begin, end);
+                });
+            }
+
+            for (uint32_t i = levels - 1; i > 0; --i)
+            {
+                const uint32_t sw = DualFilterLevelSize(width, i);
+                const uint32_t sh = DualFilterLevelSize(height, i);
+                const uint32_t dw = DualFilterLevelSize(width, i - 1);
+                const uint32_t dh = DualFilterLevelSize(height, i - 1);
+
+                DX::ParallelFor(dh, 16, [&](size_t begin, size_t end)
+                {
+                    DualUpsample(level(i), sw, sh, level(i - 1), dw, dh, m_scatter, begin, end);
+                    QuantizeRows(level(i - 1), dw, begin, end);
+                });
+            }
+        }
+
+        void QuantizeRows(float* texels, uint32_t width, size_t begin, size_t end) const noexcept
+        {
+            if (!m_emulateUnorm8)
+                return;
+
+            const size_t count = end * width * 4;
+            size_t i = begin * width * 4;
+
+        #if defined(__AVX2__)
+            for (; i + 8 <= count; i += 8)
+            {
+                _mm256_storeu_ps(texels + i, Quantize8(_mm256_loadu_ps(texels + i)));
+            }
+        #endif
+
+            for (; i < count; ++i)
+            {
+                texels[i] = Quantize(texels[i]);
+            }
+        }
+
+        // BloomCombine.hlsl: the full size source plus the bilinear upsampled bloom in m_half1.
+        void Combine(const uint8_t* source, size_t sourcePitch, uint8_t* dest, size_t destPitch, size_t begin, size_t end)
+        {
+            const float bloomSaturation = m_parameters.bloomSaturation;
+            const float bloomIntensity = m_parameters.bloomIntensity;
+            const float baseSaturation = m_parameters.baseSaturation;
+            const float baseIntensity = m_parameters.baseIntensity;
+            const size_t rowFloats = size_t(m_halfWidth) * 4;
+
+            // Bloom rows blended vertically, then sampled horizontally per pixel.
+            std::vector<float> bloomRow(rowFloats);
+
+            for (size_t y = begin; y < end; ++y)
+            {
+                const Tap ty = m_upY[y];
+                const float* r0 = &m_half1[size_t(ty.index) * rowFloats];
+                const float* r1 = r0 + rowFloats;
+                for (size_t i = 0; i < rowFloats; ++i)
+                {
+                    bloomRow[i] = r0[i] + (r1[i] - r0[i]) * ty.weight;
+                }
+
+                const uint8_t* base = source + y * sourcePitch;
+                uint8_t* out = dest + y * destPitch;
+                const uint32_t width = uint32_t(m_upX.size());
+                uint32_t x = 0;
+
+            #if defined(__AVX2__)
+                const __m256 grey = _mm256_setr_ps(m_grey[0], m_grey[1], m_grey[2], 0.f, m_grey[0], m_grey[1], m_grey[2], 0.f);
+                const __m256 one = _mm256_set1_ps(1.f);
+                const __m256 zero = _mm256_setzero_ps();
+                const __m256 inv255 = _mm256_set1_ps(1.f / 255.f);
+
+                for (; x + 2 <= width; x += 2)
+                {
+                    const Tap ta = m_upX[x];
+                    const Tap tb = m_upX[x + 1];
+
+                    const __m256 left = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&bloomRow[size_t(ta.index) * 4])),
+                        _mm_loadu_ps(&bloomRow[size_t(tb.index) * 4]), 1);
+                    const __m256 right = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&bloomRow[size_t(ta.index) * 4 + 4])),
+                        _mm_loadu_ps(&bloomRow[size_t(tb.index) * 4 + 4]), 1);
+                    const __m256 wx = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(ta.weight)), _mm_set1_ps(tb.weight), 1);
+
+                    __m256 bloom = _mm256_add_ps(left, _mm256_mul_ps(_mm256_sub_ps(right, left), wx));
+
+                    const __m128i baseBytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(base + size_t(x) * 4));
+                    __m256 basePixel = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(baseBytes)), inv255);
+
+                    // AdjustSaturation: lerp(dot(rgb, weights), color, saturation).
+                    const __m256 bloomGrey = _mm256_dp_ps(bloom, grey, 0x7F);
+                    bloom = _mm256_mul_ps(_mm256_add_ps(bloomGrey, _mm256_mul_ps(_mm256_sub_ps(bloom, bloomGrey), _mm256_set1_ps(bloomSaturation))),
+                        _mm256_set1_ps(bloomIntensity));
+
+                    const __m256 baseGrey = _mm256_dp_ps(basePixel, grey, 0x7F);
+                    basePixel = _mm256_mul_ps(_mm256_add_ps(baseGrey, _mm256_mul_ps(_mm256_sub_ps(basePixel, baseGrey), _mm256_set1_ps(baseSaturation))),
+                        _mm256_set1_ps(baseIntensity));
+
+                    // base *= (1 - saturate(bloom))
+                    basePixel = _mm256_mul_ps(basePixel, _mm256_sub_ps(one, _mm256_min_ps(_mm256_max_ps(bloom, zero), one)));
+
+                    __m256 result = _mm256_add_ps(basePixel, bloom);
+                    result = _mm256_min_ps(_mm256_max_ps(result, zero), one);
+                    const __m256i ints = _mm256_cvtps_epi32(_mm256_mul_ps(result, _mm256_set1_ps(255.f)));
+
+                    const __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(ints), _mm256_extracti128_si256(ints, 1));
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + size_t(x) * 4), _mm_packus_epi16(words, words));
+                }
+            #endif
+
+                for (; x < width; ++x)
+                {
+                    const Tap tx = m_upX[x];
+                    const float* b0 = &bloomRow[size_t(tx.index) * 4];
+
+                    float bloom[4];
+                    float basePixel[4];
+                    for (size_t c = 0; c < 4; ++c)
+                    {
+                        bloom[c] = b0[c] + (b0[c + 4] - b0[c]) * tx.weight;
+                        basePixel[c] = float(base[size_t(x) * 4 + c]) * (1.f / 255.f);
+                    }
+
+                    const float bloomGrey = bloom[0] * m_grey[0] + bloom[1] * m_grey[1] + bloom[2] * m_grey[2];
+                    const float baseGrey = basePixel[0] * m_grey[0] + basePixel[1] * m_grey[1] + basePixel[2] * m_grey[2];
+
+                    for (size_t c = 0; c < 4; ++c)
+                    {
+                        const float b = (bloomGrey + (bloom[c] - bloomGrey) * bloomSaturation) * bloomIntensity;
+                        float a = (baseGrey + (basePixel[c] - baseGrey) * baseSaturation) * baseIntensity;
+                        a *= 1.f - std::min(std::max(b, 0.f), 1.f);
+
+                        const float result = std::min(std::max(a + b, 0.f), 1.f);
+                        out[size_t(x) * 4 + c] = uint8_t(std::nearbyint(result * 255.f));
+                    }
+                }
+            }
+        }
+
+        VS_BLOOM_PARAMETERS     m_parameters;
+        bool                    m_passThrough;
+        bool                    m_emulateUnorm8;
+        float                   m_kernel[KernelSize];
+        float                   m_grey[4];
+        uint32_t                m_halfWidth;
+        uint32_t                m_halfHeight;
+        std::vector<Tap>        m_downX;
+        std::vector<Tap>        m_downY;
+        std::vector<Tap>        m_upX;
+        std::vector<Tap>        m_upY;
+        std::vector<float>      m_half1;
+        std::vector<float>      m_half2;
+        uint32_t                m_dualLevels;
+        float                   m_scatter;
+        std::vector<std::vector<float>> m_levels;    // Dual filter levels; level 0 is m_half1
+    };
+}
@@ -0,0 +1,107 @@
+//--------------------------------------------------------------------------------------
+// File: BloomPresets.h
+//
+// Bloom parameters shared by the shaders in Game.cpp and the CPU implementation in
+// BloomCPU.h. This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace Bloom
+{
+    // Matches the VS_BLOOM_PARAMETERS constant buffer in Bloom.hlsli.
+    struct VS_BLOOM_PARAMETERS
+    {
+        float bloomThreshold;
+        float blurAmount;
+        float bloomIntensity;
+        float baseIntensity;
+        float bloomSaturation;
+        float baseSaturation;
+        uint8_t na[8];
+    };
+
+    static_assert(!(sizeof(VS_BLOOM_PARAMETERS) % 16), "VS_BLOOM_PARAMETERS needs to be 16 bytes aligned");
+
+    enum BloomPresets
+    {
+        Default = 0,
+        Soft,
+        Desaturated,
+        Saturated,
+        Blurry,
+        Subtle,
+        None,
+        BloomPresets_Count
+    };
+
+    constexpr VS_BLOOM_PARAMETERS g_BloomPresets[] =
+    {
+        //Thresh  Blur Bloom  Base  BloomSat BaseSat na
+        { 0.25f,  4,   1.25f, 1,    1,       1, {} }, // Default
+        { 0,      3,   1,     1,    1,       1, {} }, // Soft
+        { 0.5f,   8,   2,     1,    0,       1, {} }, // Desaturated
+        { 0.25f,  4,   2,     1,    2,       0, {} }, // Saturated
+        { 0,      2,   1,     0.1f, 1,       1, {} }, // Blurry
+        { 0.5f,   2,   1,     1,    1,       1, {} }, // Subtle
+        { 0.25f,  4,   1.25f, 1,    1,       1, {} }, // None
+    };
+
+    static_assert(sizeof(g_BloomPresets) / sizeof(g_BloomPresets[0]) == BloomPresets_Count, "Missing bloom preset");
+
+    // Number of taps in GaussianBlur.hlsl.
+    constexpr size_t BLUR_SAMPLE_COUNT = 15;
+
+    inline float ComputeGaussian(float n, float theta)
+    {
+        return (float)((1.0 / sqrtf(2 * 3.141592654f * theta)) * expf(-(n * n) / (2 * theta * theta)));
+    }
+
+    // Normalized weights and offsets in texels for the GaussianBlur.hlsl taps. Tap 0 is the
+    // center; taps 2i+1 and 2i+2 are the pair at +/-(2i + 1.5).
+    inline void ComputeBlurKernel(float blurAmount, float weights[BLUR_SAMPLE_COUNT], float offsets[BLUR_SAMPLE_COUNT])
+    {
+        weights[0] = ComputeGaussian(0, blurAmount);
+        offsets[0] = 0.f;
+
+        float totalWeights = weights[0];
+
+        // Add pairs of additional sample taps, positioned
+        // along a line in both directions from the center.
+        for (size_t i = 0; i < BLUR_SAMPLE_COUNT / 2; i++)
+        {
+            // Store weights for the positive and negative taps.
+            float weight = ComputeGaussian(float(i + 1.f), blurAmount);
+
+            weights[i * 2 + 1] = weight;
+            weights[i * 2 + 2] = weight;
+
+            totalWeights += weight * 2;
+
+            // To get the maximum amount of blurring from a limited number of
+            // pixel shader samples, we take advantage of the bilinear filtering
+            // hardware inside the texture fetch unit. If we position our texture
+            // coordinates exactly halfway between two texels, the filtering unit
+            // will average them for us, giving two samples for the price of one.
+            // This allows us to step in units of two texels per sample, rather
+            // than just one at a time. The 1.5 offset kicks things off by
+            // positioning us nicely in between two texels.
+            float sampleOffset = float(i) * 2.f + 1.5f;
+
+            offsets[i * 2 + 1] = sampleOffset;
+            offsets[i * 2 + 2] = -sampleOffset;
+        }
+
+        for (size_t i = 0; i < BLUR_SAMPLE_COUNT; i++)
+        {
+            weights[i] /= totalWeights;
+        }
+    }
+}
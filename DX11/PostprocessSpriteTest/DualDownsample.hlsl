@@ -0,0 +1,19 @@
+Texture2D<float4> Texture : register(t0);
+sampler TextureSampler : register(s0);
+
+// Dual filter downsample: the center plus four diagonal fetches one source texel away.
+// Each fetch lands on a texel corner, so the bilinear filter averages a 2x2 block.
+float4 main(float4 color : COLOR0, float2 texCoord : TEXCOORD0) : SV_Target0
+{
+    float2 size;
+    Texture.GetDimensions(size.x, size.y);
+    float2 offset = 1 / size;
+
+    float4 c = Texture.Sample(TextureSampler, texCoord) * 4;
+    c += Texture.Sample(TextureSampler, texCoord - offset);
+    c += Texture.Sample(TextureSampler, texCoord + offset);
+    c += Texture.Sample(TextureSampler, texCoord + float2(offset.x, -offset.y));
+    c += Texture.Sample(TextureSampler, texCoord - float2(offset.x, -offset.y));
+
+    return c / 8;
+}
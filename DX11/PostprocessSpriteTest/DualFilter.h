@@ -0,0 +1,300 @@
+//--------------------------------------------------------------------------------------
+// File: DualFilter.h
+//
+// Dual filter (dual Kawase) bloom: the extracted image is halved level by level with a
+// 5 tap filter (DualDownsample.hlsl), then each level is upsampled with a 4 tap filter
+// (DualUpsample.hlsl) and blended into the level above it. This header holds the level
+// layout, a texel fetch cost model for comparing against the separable Gaussian, and a CPU
+// reference of both filters. It has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "BloomPresets.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace Bloom
+{
+    constexpr uint32_t DUAL_FILTER_MAX_LEVELS = 8;
+    constexpr uint32_t DUAL_FILTER_DOWNSAMPLE_TAPS = 5;
+    constexpr uint32_t DUAL_FILTER_UPSAMPLE_TAPS = 4;
+
+    // Default weight of the upsampled lower level when it is blended into the level above.
+    // Larger values spread the bloom further.
+    constexpr float DUAL_FILTER_DEFAULT_SCATTER = 0.7f;
+
+    // Level 0 is the half size bloom extract target; each further level halves it again.
+    inline uint32_t DualFilterLevelSize(uint32_t fullSize, uint32_t level) noexcept
+    {
+        return std::max(fullSize >> (level + 1), 1u);
+    }
+
+    // Limits the level count so that the smallest level is at least 2x2 texels.
+    inline uint32_t ClampDualFilterLevels(uint32_t width, uint32_t height, uint32_t levels) noexcept
+    {
+        levels = std::min(std::max(levels, 1u), DUAL_FILTER_MAX_LEVELS);
+        while (levels > 1
+            && (DualFilterLevelSize(width, levels - 1) < 2 || DualFilterLevelSize(height, levels - 1) < 2))
+        {
+            --levels;
+        }
+        return levels;
+    }
+
+    // Distance in full resolution texels from a pixel to the furthest texel that can
+    // contribute to its bloom. Downsampling to level i reaches 2 texels of level i - 1, and
+    // upsampling from level i + 1 reaches 1.5 of its texels.
+    inline float DualFilterSupportRadius(uint32_t levels) noexcept
+    {
+        float radius = 0.f;
+        for (uint32_t i = 1; i < levels; ++i)
+        {
+            radius += 2.f * float(2u << (i - 1));
+            radius += 1.5f * float(2u << i);
+        }
+        return radius;
+    }
+
+    inline float GaussianSupportRadius() noexcept
+    {
+        // 14 texels plus the bilinear footprint at half resolution.
+        return float(BLUR_SAMPLE_COUNT / 2 * 2 + 1) * 2.f;
+    }
+
+    // Texel fetches and shaded pixels for one frame of bloom. The combine pass is the same
+    // for every mode and is included so the totals are per frame.
+    struct BloomCost
+    {
+        double  fetches;
+        double  pixels;
+        double  blendReads;     // Render target reads by the accumulating blend
+    };
+
+    inline BloomCost GaussianBloomCost(uint32_t width, uint32_t height, uint32_t blurTaps = BLUR_SAMPLE_COUNT) noexcept
+    {
+        const double full = double(width) * double(height);
+        const double half = double(width / 2) * double(height / 2);
+
+        BloomCost cost = {};
+        cost.fetches = half + 2.0 * half * blurTaps + 2.0 * full;
+        cost.pixels = 3.0 * half + full;
+        return cost;
+    }
+
+    inline BloomCost DualBloomCost(uint32_t width, uint32_t height, uint32_t levels) noexcept
+    {
+        const double full = double(width) * double(height);
+        const double half = double(width / 2) * double(height / 2);
+
+        BloomCost cost = {};
+        cost.fetches = half + 2.0 * full;
+        cost.pixels = half + full;
+
+        for (uint32_t i = 1; i < levels; ++i)
+        {
+            const double lower = double(DualFilterLevelSize(width, i)) * double(DualFilterLevelSize(height, i));
+            const double upper = double(DualFilterLevelSize(width, i - 1)) * double(DualFilterLevelSize(height, i - 1));
+
+            cost.fetches += lower * DUAL_FILTER_DOWNSAMPLE_TAPS + upper * DUAL_FILTER_UPSAMPLE_TAPS;
+            cost.pixels += lower + upper;
+            cost.blendReads += upper;
+        }
+
+        return cost;
+    }
+
+    namespace Internal
+    {
+        // Destination columns per tile in the CPU filters.
+        constexpr uint32_t TileTexels = 64;
+
+        // Clamped texel pair and weight along one axis for Texture.Sample with a linear filter;
+        // coord is in texels.
+        struct BilinearTap
+        {
+            size_t  i0;     // Offset of the first texel in floats
+            size_t  i1;     // Offset of the second texel in floats
+            float   t;      // Weight of the second texel
+        };
+
+        inline BilinearTap MakeBilinearTap(float coord, uint32_t size, size_t stride) noexcept
+        {
+            const float x = coord - 0.5f;
+            const float f = std::floor(x);
+            const int last = int(size) - 1;
+
+            BilinearTap tap;
+            tap.i0 = size_t(std::min(std::max(int(f), 0), last)) * stride;
+            tap.i1 = size_t(std::min(std::max(int(f) + 1, 0), last)) * stride;
+            tap.t = x - f;
+            return tap;
+        }
+
+        // Bilinear sample of RGBA float texels from a row tap and a column tap.
+        inline void SampleBilinear(const float* texels, const BilinearTap& row, const BilinearTap& column, float result[4]) noexcept
+        {
+            const float* r0 = texels + row.i0;
+            const float* r1 = texels + row.i1;
+
+            for (size_t c = 0; c < 4; ++c)
+            {
+                const float top = r0[column.i0 + c] + (r0[column.i1 + c] - r0[column.i0 + c]) * column.t;
+                const float bottom = r1[column.i0 + c] + (r1[column.i1 + c] - r1[column.i0 + c]) * column.t;
+                result[c] = top + (bottom - top) * row.t;
+            }
+        }
+
+    #if defined(__AVX2__)
+        // SampleBilinear with the four channels in one register; the arithmetic is the same,
+        // so results match the scalar path exactly.
+        inline __m128 SampleBilinear4(const float* texels, const BilinearTap& row, const BilinearTap& column) noexcept
+        {
+            const float* r0 = texels + row.i0;
+            const float* r1 = texels + row.i1;
+            const __m128 tx = _mm_set1_ps(column.t);
+
+            const __m128 a = _mm_loadu_ps(r0 + column.i0);
+            const __m128 c = _mm_loadu_ps(r1 + column.i0);
+            const __m128 top = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(r0 + column.i1), a), tx));
+            const __m128 bottom = _mm_add_ps(c, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(r1 + column.i1), c), tx));
+            return _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), _mm_set1_ps(row.t)));
+        }
+    #endif
+    }
+
+    // DualDownsample.hlsl for destination rows [begin, end): the center plus four diagonal
+    // fetches one source texel away, weighted 4:1:1:1:1. Column taps are found once per tile
+    // of columns and row taps once per row, so the inner loop only fetches and blends.
+    inline void DualDownsample(const float* source, uint32_t sourceWidth, uint32_t sourceHeight,
+        float* dest, uint32_t destWidth, uint32_t destHeight, size_t begin, size_t end) noexcept
+    {
+        using Internal::BilinearTap;
+        using Internal::MakeBilinearTap;
+
+        const float sx = float(sourceWidth) / float(destWidth);
+        const float sy = float(sourceHeight) / float(destHeight);
+        const size_t rowFloats = size_t(sourceWidth) * 4;
+
+        for (uint32_t tile = 0; tile < destWidth; tile += Internal::TileTexels)
+        {
+            const uint32_t tileEnd = std::min(destWidth, tile + Internal::TileTexels);
+
+            BilinearTap left[Internal::TileTexels], center[Internal::TileTexels], right[Internal::TileTexels];
+            for (uint32_t x = tile; x < tileEnd; ++x)
+            {
+                const float u = (float(x) + 0.5f) * sx;
+                left[x - tile] = MakeBilinearTap(u - 1.f, sourceWidth, 4);
+                center[x - tile] = MakeBilinearTap(u, sourceWidth, 4);
+                right[x - tile] = MakeBilinearTap(u + 1.f, sourceWidth, 4);
+            }
+
+            for (size_t y = begin; y < end; ++y)
+            {
+                const float v = (float(y) + 0.5f) * sy;
+                const BilinearTap above = MakeBilinearTap(v - 1.f, sourceHeight, rowFloats);
+                const BilinearTap middle = MakeBilinearTap(v, sourceHeight, rowFloats);
+                const BilinearTap below = MakeBilinearTap(v + 1.f, sourceHeight, rowFloats);
+                float* out = dest + y * destWidth * 4;
+
+                for (uint32_t x = tile; x < tileEnd; ++x)
+                {
+                    const uint32_t i = x - tile;
+
+                #if defined(__AVX2__)
+                    __m128 sum = _mm_mul_ps(Internal::SampleBilinear4(source, middle, center[i]), _mm_set1_ps(4.f));
+                    sum = _mm_add_ps(sum, Internal::SampleBilinear4(source, above, left[i]));
+                    sum = _mm_add_ps(sum, Internal::SampleBilinear4(source, above, right[i]));
+                    sum = _mm_add_ps(sum, Internal::SampleBilinear4(source, below, left[i]));
+                    sum = _mm_add_ps(sum, Internal::SampleBilinear4(source, below, right[i]));
+                    _mm_storeu_ps(out + x * 4, _mm_mul_ps(sum, _mm_set1_ps(1.f / 8.f)));
+                #else
+                    float m[4], a[4], b[4], c[4], d[4];
+                    Internal::SampleBilinear(source, middle, center[i], m);
+                    Internal::SampleBilinear(source, above, left[i], a);
+                    Internal::SampleBilinear(source, above, right[i], b);
+                    Internal::SampleBilinear(source, below, left[i], c);
+                    Internal::SampleBilinear(source, below, right[i], d);
+
+                    for (size_t k = 0; k < 4; ++k)
+                    {
+                        out[x * 4 + k] = (m[k] * 4.f + a[k] + b[k] + c[k] + d[k]) * (1.f / 8.f);
+                    }
+                #endif
+                }
+            }
+        }
+    }
+
+    // DualUpsample.hlsl for destination rows [begin, end): four diagonal fetches half a
+    // source texel away, blended into dest as lerp(dest, upsampled, scatter).
+    inline void DualUpsample(const float* source, uint32_t sourceWidth, uint32_t sourceHeight,
+        float* dest, uint32_t destWidth, uint32_t destHeight, float scatter, size_t begin, size_t end) noexcept
+    {
+        using Internal::BilinearTap;
+        using Internal::MakeBilinearTap;
+
+        const float sx = float(sourceWidth) / float(destWidth);
+        const float sy = float(sourceHeight) / float(destHeight);
+        const size_t rowFloats = size_t(sourceWidth) * 4;
+
+        for (uint32_t tile = 0; tile < destWidth; tile += Internal::TileTexels)
+        {
+            const uint32_t tileEnd = std::min(destWidth, tile + Internal::TileTexels);
+
+            BilinearTap left[Internal::TileTexels], right[Internal::TileTexels];
+            for (uint32_t x = tile; x < tileEnd; ++x)
+            {
+                const float u = (float(x) + 0.5f) * sx;
+                left[x - tile] = MakeBilinearTap(u - 0.5f, sourceWidth, 4);
+                right[x - tile] = MakeBilinearTap(u + 0.5f, sourceWidth, 4);
+            }
+
+            for (size_t y = begin; y < end; ++y)
+            {
+                const float v = (float(y) + 0.5f) * sy;
+                const BilinearTap above = MakeBilinearTap(v - 0.5f, sourceHeight, rowFloats);
+                const BilinearTap below = MakeBilinearTap(v + 0.5f, sourceHeight, rowFloats);
+                float* out = dest + y * destWidth * 4;
+
+                for (uint32_t x = tile; x < tileEnd; ++x)
+                {
+                    const uint32_t i = x - tile;
+
+                #if defined(__AVX2__)
+                    __m128 up = Internal::SampleBilinear4(source, above, left[i]);
+                    up = _mm_add_ps(up, Internal::SampleBilinear4(source, above, right[i]));
+                    up = _mm_add_ps(up, Internal::SampleBilinear4(source, below, left[i]));
+                    up = _mm_add_ps(up, Internal::SampleBilinear4(source, below, right[i]));
+                    up = _mm_mul_ps(up, _mm_set1_ps(0.25f));
+
+                    const __m128 current = _mm_loadu_ps(out + x * 4);
+                    _mm_storeu_ps(out + x * 4, _mm_add_ps(current, _mm_mul_ps(_mm_sub_ps(up, current), _mm_set1_ps(scatter))));
+                #else
+                    float a[4], b[4], c[4], d[4];
+                    Internal::SampleBilinear(source, above, left[i], a);
+                    Internal::SampleBilinear(source, above, right[i], b);
+                    Internal::SampleBilinear(source, below, left[i], c);
+                    Internal::SampleBilinear(source, below, right[i], d);
+
+                    for (size_t k = 0; k < 4; ++k)
+                    {
+                        const float up = (a[k] + b[k] + c[k] + d[k]) * 0.25f;
+                        out[x * 4 + k] += (up - out[x * 4 + k]) * scatter;
+                    }
+                #endif
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,18 @@
+Texture2D<float4> Texture : register(t0);
+sampler TextureSampler : register(s0);
+
+// Dual filter upsample: four diagonal fetches half a source texel away. The result is
+// blended into the level above with the blend factor (see DualFilter.h).
+float4 main(float4 color : COLOR0, float2 texCoord : TEXCOORD0) : SV_Target0
+{
+    float2 size;
+    Texture.GetDimensions(size.x, size.y);
+    float2 offset = 0.5 / size;
+
+    float4 c = Texture.Sample(TextureSampler, texCoord - offset);
+    c += Texture.Sample(TextureSampler, texCoord + offset);
+    c += Texture.Sample(TextureSampler, texCoord + float2(offset.x, -offset.y));
+    c += Texture.Sample(TextureSampler, texCoord - float2(offset.x, -offset.y));
+
+    return c / 4;
+}
@@ -5,127 +5,93 @@
 #include "pch.h"
 #include "Game.h"
 
+#include "BloomPresets.h"
+#include "DualFilter.h"
+#include "GaussianKernel.h"
 #include "ReadData.h"
 
 extern void ExitGame() noexcept;
 
 using namespace DirectX;
 using namespace DirectX::SimpleMath;
+using namespace Bloom;
 
 using Microsoft::WRL::ComPtr;
 
 namespace
 {
-    struct VS_BLOOM_PARAMETERS
-    {
-        float bloomThreshold;
-        float blurAmount;
-        float bloomIntensity;
-        float baseIntensity;
-        float bloomSaturation;
-        float baseSaturation;
-        uint8_t na[8];
-    };
-
-    static_assert(!(sizeof(VS_BLOOM_PARAMETERS) % 16), "VS_BLOOM_PARAMETERS needs to be 16 bytes aligned");
-
     struct VS_BLUR_PARAMETERS
     {
-        static constexpr size_t SAMPLE_COUNT = 15;
+        static constexpr size_t SAMPLE_COUNT = BLUR_SAMPLE_COUNT;
 
         XMFLOAT4 sampleOffsets[SAMPLE_COUNT];
         XMFLOAT4 sampleWeights[SAMPLE_COUNT];
 
         void SetBlurEffectParameters(float dx, float dy, const VS_BLOOM_PARAMETERS& params)
         {
-            sampleWeights[0].x = ComputeGaussian(0, params.blurAmount);
-            sampleOffsets[0].x = sampleOffsets[0].y = 0.f;
-
-            float totalWeights = sampleWeights[0].x;
-
-            // Add pairs of additional sample taps, positioned
-            // along a line in both directions from the center.
-            for (size_t i = 0; i < SAMPLE_COUNT / 2; i++)
-            {
-                // Store weights for the positive and negative taps.
-                float weight = ComputeGaussian( float(i + 1.f), params.blurAmount);
-
-                sampleWeights[i * 2 + 1].x = weight;
-                sampleWeights[i * 2 + 2].x = weight;
-
-                totalWeights += weight * 2;
-
-                // To get the maximum amount of blurring from a limited number of
-                // pixel shader samples, we take advantage of the bilinear filtering
-                // hardware inside the texture fetch unit. If we position our texture
-                // coordinates exactly halfway between two texels, the filtering unit
-                // will average them for us, giving two samples for the price of one.
-                // This allows us to step in units of two texels per sample, rather
-                // than just one at a time. The 1.5 offset kicks things off by
-                // positioning us nicely in between two texels.
-                float sampleOffset = float(i) * 2.f + 1.5f;
-
-                Vector2 delta = Vector2(dx, dy) * sampleOffset;
-
-                // Store texture coordinate offsets for the positive and negative taps.
-                sampleOffsets[i * 2 + 1].x = delta.x;
-                sampleOffsets[i * 2 + 1].y = delta.y;
-                sampleOffsets[i * 2 + 2].x = -delta.x;
-                sampleOffsets[i * 2 + 2].y = -delta.y;
-            }
+            float weights[SAMPLE_COUNT];
+            float offsets[SAMPLE_COUNT];
+            ComputeBlurKernel(params.blurAmount, weights, offsets);
 
             for (size_t i = 0; i < SAMPLE_COUNT; i++)
             {
-                sampleWeights[i].x /= totalWeights;
-            }
-        }
+                // Convert texel offsets to texture coordinate offsets.
+                Vector2 delta = Vector2(dx, dy) * offsets[i];
 
-    private:
-        float ComputeGaussian(float n, float theta)
-        {
-            return (float)((1.0 / sqrtf(2 * XM_PI * theta)) * expf(-(n * n) / (2 * theta * theta)));
+                sampleOffsets[i].x = delta.x;
+                sampleOffsets[i].y = delta.y;
+                sampleWeights[i].x = weights[i];
+            }
         }
     };
 
     static_assert(!(sizeof(VS_BLUR_PARAMETERS) % 16), "VS_BLUR_PARAMETERS needs to be 16 bytes aligned");
 
-    enum BloomPresets
+    struct VS_LINEAR_BLUR_PARAMETERS
     {
-        Default = 0,
-        Soft,
-        Desaturated,
-        Saturated,
-        Blurry,
-        Subtle,
-        None
+        XMFLOAT2 texelStep;
+        float centerWeight;
+        uint32_t tapCount;
+        XMFLOAT4 taps[LINEAR_BLUR_MAX_TAPS];
+
+        void SetBlurEffectParameters(float dx, float dy, const LinearKernel& kernel)
+        {
+            texelStep = XMFLOAT2(dx, dy);
+            centerWeight = kernel.centerWeight;
+            tapCount = kernel.tapCount;
+
+            for (size_t i = 0; i < LINEAR_BLUR_MAX_TAPS; i++)
+            {
+                taps[i] = XMFLOAT4(kernel.offsets[i], kernel.weights[i], 0.f, 0.f);
+            }
+        }
     };
 
+    static_assert(!(sizeof(VS_LINEAR_BLUR_PARAMETERS) % 16), "VS_LINEAR_BLUR_PARAMETERS needs to be 16 bytes aligned");
+
     BloomPresets g_Bloom = Default;
+    bool g_LinearBlur = false;
+    bool g_DualFilter = false;
+    uint32_t g_DualLevels = 5;
 
-    static const VS_BLOOM_PARAMETERS g_BloomPresets[] = 
+    RECT DualFilterLevelRect(const RECT& fullscreen, uint32_t level) noexcept
     {
-        //Thresh  Blur Bloom  Base  BloomSat BaseSat
-        { 0.25f,  4,   1.25f, 1,    1,       1 }, // Default
-        { 0,      3,   1,     1,    1,       1 }, // Soft
-        { 0.5f,   8,   2,     1,    0,       1 }, // Desaturated
-        { 0.25f,  4,   2,     1,    2,       0 }, // Saturated
-        { 0,      2,   1,     0.1f, 1,       1 }, // Blurry
-        { 0.5f,   2,   1,     1,    1,       1 }, // Subtle
-        { 0.25f,  4,   1.25f, 1,    1,       1 }, // None
-    };
+        return RECT{ 0, 0,
+            LONG(DualFilterLevelSize(uint32_t(fullscreen.right), level)),
+            LONG(DualFilterLevelSize(uint32_t(fullscreen.bottom), level)) };
+    }
 }
 
 Game::Game() noexcept(false) :
     m_fullscreenRect{},
-    m_bloomRect{}
+    m_bloomRect{},
+    m_offscreenTexture(nullptr),
+    m_renderTarget1(nullptr),
+    m_renderTarget2(nullptr),
+    m_targetPoolBytes(0)
 {
     m_deviceResources = std::make_unique<DX::DeviceResources>();
     m_deviceResources->RegisterDeviceNotify(this);
-
-    const auto format = m_deviceResources->GetBackBufferFormat();
-    m_offscreenTexture = std::make_unique<DX::RenderTexture>(format);
-    m_renderTarget1 = std::make_unique<DX::RenderTexture>(format);
-    m_renderTarget2 = std::make_unique<DX::RenderTexture>(format);
 }
 
 // Initialize the Direct3D resources required to run.
@@ -181,6 +147,8 @@ void Game::Render()
         return;
     }
 
+    PlanRenderTargets();
+
     Clear();
 
     m_deviceResources->PIXBeginEvent(L"Render");
@@ -264,17 +232,29 @@ void Game::PostProcess()
         m_spriteBatch->Draw(m_renderTarget1->GetShaderResourceView(), m_bloomRect);
         m_spriteBatch->End();
         #else
-        // RT1 -> RT2 (blur horizontal)
-        auto rt2RT = m_renderTarget2->GetRenderTargetView();
-        context->OMSetRenderTargets(1, &rt2RT, nullptr);
-        m_spriteBatch->Begin(SpriteSortMode_Immediate, nullptr, nullptr, nullptr, nullptr,
-            [=](){
-                context->PSSetShader(m_gaussianBlurPS.Get(), nullptr, 0);
-                context->PSSetConstantBuffers(0, 1, m_blurParamsWidth.GetAddressOf());
-            });
+        auto blurPS = g_LinearBlur ? m_gaussianBlurLinearPS.Get() : m_gaussianBlurPS.Get();
+        auto blurParamsWidth = g_LinearBlur ? m_linearBlurParamsWidth.Get() : m_blurParamsWidth.Get();
+        auto blurParamsHeight = g_LinearBlur ? m_linearBlurParamsHeight.Get() : m_blurParamsHeight.Get();
         auto rt1SRV = m_renderTarget1->GetShaderResourceView();
-        m_spriteBatch->Draw(rt1SRV, m_bloomRect);
-        m_spriteBatch->End();
+
+        if (g_DualFilter)
+        {
+            // RT1 -> mip chain -> RT1 (dual filter)
+            DualFilterBlur();
+        }
+        else
+        {
+            // RT1 -> RT2 (blur horizontal)
+            auto rt2RT = m_renderTarget2->GetRenderTargetView();
+            context->OMSetRenderTargets(1, &rt2RT, nullptr);
+            m_spriteBatch->Begin(SpriteSortMode_Immediate, nullptr, nullptr, nullptr, nullptr,
+                [=](){
+                    context->PSSetShader(blurPS, nullptr, 0);
+                    context->PSSetConstantBuffers(0, 1, &blurParamsWidth);
+                });
+            m_spriteBatch->Draw(rt1SRV, m_bloomRect);
+            m_spriteBatch->End();
+        }
 
         context->PSSetShaderResources(0, 2, null);
 
@@ -286,15 +266,18 @@ void Game::PostProcess()
         m_spriteBatch->End();
         #else
         // RT2 -> RT1 (blur vertical)
-        context->OMSetRenderTargets(1, &rt1RT, nullptr);
-        m_spriteBatch->Begin(SpriteSortMode_Immediate, nullptr, nullptr, nullptr, nullptr,
-            [=](){
-                context->PSSetShader(m_gaussianBlurPS.Get(), nullptr, 0);
-                context->PSSetConstantBuffers(0, 1, m_blurParamsHeight.GetAddressOf());
-            });
-        auto rt2SRV = m_renderTarget2->GetShaderResourceView();
-        m_spriteBatch->Draw(rt2SRV, m_bloomRect);
-        m_spriteBatch->End();
+        if (!g_DualFilter)
+        {
+            context->OMSetRenderTargets(1, &rt1RT, nullptr);
+            m_spriteBatch->Begin(SpriteSortMode_Immediate, nullptr, nullptr, nullptr, nullptr,
+                [=](){
+                    context->PSSetShader(blurPS, nullptr, 0);
+                    context->PSSetConstantBuffers(0, 1, &blurParamsHeight);
+                });
+            auto rt2SRV = m_renderTarget2->GetShaderResourceView();
+            m_spriteBatch->Draw(rt2SRV, m_bloomRect);
+            m_spriteBatch->End();
+        }
 
         #if 0
         // RT1 (2nd) screenshot
@@ -320,6 +303,144 @@ void Game::PostProcess()
 
     context->PSSetShaderResources(0, 2, null);
 }
+
+// Dual filter blur of the bloom extract in RT1: downsample through the chain, then upsample
+// back up, blending each level into the one above by the scatter factor.
+void Game::DualFilterBlur()
+{
+    auto context = m_deviceResources->GetD3DDeviceContext();
+
+    ID3D11ShaderResourceView* null[] = { nullptr };
+
+    const uint32_t levels = ClampDualFilterLevels(uint32_t(m_fullscreenRect.right), uint32_t(m_fullscreenRect.bottom), g_DualLevels);
+
+    auto level = [&](uint32_t i) { return i ? m_bloomChain[i - 1] : m_renderTarget1; };
+
+    for (uint32_t i = 1; i < levels; ++i)
+    {
+        auto rt = level(i)->GetRenderTargetView();
+        context->OMSetRenderTargets(1, &rt, nullptr);
+        m_spriteBatch->Begin(SpriteSortMode_Immediate, nullptr, nullptr, nullptr, nullptr,
+            [=](){
+                context->PSSetShader(m_dualDownsamplePS.Get(), nullptr, 0);
+            });
+        m_spriteBatch->Draw(level(i - 1)->GetShaderResourceView(), DualFilterLevelRect(m_fullscreenRect, i));
+        m_spriteBatch->End();
+
+        context->PSSetShaderResources(0, 1, null);
+    }
+
+    const float scatter[4] = { DUAL_FILTER_DEFAULT_SCATTER, DUAL_FILTER_DEFAULT_SCATTER, DUAL_FILTER_DEFAULT_SCATTER, DUAL_FILTER_DEFAULT_SCATTER };
+
+    for (uint32_t i = levels - 1; i > 0; --i)
+    {
+        auto rt = level(i - 1)->GetRenderTargetView();
+        context->OMSetRenderTargets(1, &rt, nullptr);
+        m_spriteBatch->Begin(SpriteSortMode_Immediate, nullptr, nullptr, nullptr, nullptr,
+            [=](){
+                context->OMSetBlendState(m_dualBlendState.Get(), scatter, 0xFFFFFFFF);
+                context->PSSetShader(m_dualUpsamplePS.Get(), nullptr, 0);
+            });
+        m_spriteBatch->Draw(level(i)->GetShaderResourceView(), DualFilterLevelRect(m_fullscreenRect, i - 1));
+        m_spriteBatch->End();
+
+        context->PSSetShaderResources(0, 1, null);
+    }
+}
+
+// Requests this frame's targets from the pool. Passes are numbered in PostProcess order so
+// targets whose pass ranges don't overlap can share a texture. In this chain they all
+// overlap: the scene is read by the combine pass, RT1 is both the blur source and its
+// destination, and each dual filter level is blended into on the way up. Nothing aliases
+// within a frame, so the saving over owning every target is only that the other mode's
+// targets are freed: RT2 in dual filter mode (about 16% less) or the mip chain in
+// separable mode (about 5% less). TargetPoolSim measures aliasing on a longer chain.
+void Game::PlanRenderTargets()
+{
+    const auto format = m_deviceResources->GetBackBufferFormat();
+    const auto width = uint32_t(m_fullscreenRect.right);
+    const auto height = uint32_t(m_fullscreenRect.bottom);
+
+    m_targetPool.BeginFrame();
+
+    uint32_t bloomRT1 = 0;
+    uint32_t bloomRT2 = 0;
+    uint32_t lastPass = 1;
+    m_chainTargets.clear();
+
+    if (g_Bloom != None)
+    {
+        const auto half = DX::MakeTargetDesc(format, uint32_t(m_bloomRect.right), uint32_t(m_bloomRect.bottom));
+
+        if (g_DualFilter)
+        {
+            // Extract, one downsample per level, one upsample per level, combine.
+            const uint32_t levels = ClampDualFilterLevels(width, height, g_DualLevels);
+            lastPass = 2 * levels;
+            bloomRT1 = m_targetPool.Request(half, 1, lastPass);
+
+            for (uint32_t i = 1; i < levels; ++i)
+            {
+                const auto rect = DualFilterLevelRect(m_fullscreenRect, i);
+                const auto desc = DX::MakeTargetDesc(format, uint32_t(rect.right), uint32_t(rect.bottom));
+                m_chainTargets.push_back(m_targetPool.Request(desc, 1 + i, 2 * levels - i));
+            }
+        }
+        else
+        {
+            // Extract, blur horizontal, blur vertical, combine.
+            lastPass = 4;
+            bloomRT1 = m_targetPool.Request(half, 1, lastPass);
+            bloomRT2 = m_targetPool.Request(half, 2, 3);
+        }
+    }
+
+    const uint32_t scene = m_targetPool.Request(DX::MakeTargetDesc(format, width, height), 0, lastPass);
+
+    m_targetPool.Plan();
+
+    m_offscreenTexture = m_targetPool.Get(scene);
+    m_renderTarget1 = (g_Bloom != None) ? m_targetPool.Get(bloomRT1) : nullptr;
+    m_renderTarget2 = (g_Bloom != None && !g_DualFilter) ? m_targetPool.Get(bloomRT2) : nullptr;
+
+    m_bloomChain.clear();
+    for (const auto it : m_chainTargets)
+    {
+        m_bloomChain.push_back(m_targetPool.Get(it));
+    }
+
+    const auto& planner = m_targetPool.GetPlanner();
+    if (planner.GetAllocatedBytes() != m_targetPoolBytes)
+    {
+        m_targetPoolBytes = planner.GetAllocatedBytes();
+
+        char buff[128] = {};
+        sprintf_s(buff, "Render targets: %zu textures, %.1f MB (%.1f MB requested this frame)\n",
+            planner.GetLiveSlotCount(), double(m_targetPoolBytes) / (1024. * 1024.),
+            double(planner.GetRequestedBytes()) / (1024. * 1024.));
+        OutputDebugStringA(buff);
+    }
+}
+
+void Game::LogBloomCost() const
+{
+    const auto width = uint32_t(m_fullscreenRect.right);
+    const auto height = uint32_t(m_fullscreenRect.bottom);
+    if (!width || !height)
+        return;
+
+    const double pixels = double(width) * double(height);
+    const uint32_t levels = ClampDualFilterLevels(width, height, g_DualLevels);
+    const BloomCost gaussian = GaussianBloomCost(width, height);
+    const BloomCost dual = DualBloomCost(width, height, levels);
+
+    char buff[256] = {};
+    sprintf_s(buff, "Bloom %ux%u: %s; Gaussian %.2f fetches/pixel (radius %.0f), dual filter %u levels %.2f fetches/pixel (radius %.0f)\n",
+        width, height, g_DualFilter ? "dual filter" : "Gaussian",
+        gaussian.fetches / pixels, GaussianSupportRadius(),
+        levels, dual.fetches / pixels, DualFilterSupportRadius(levels));
+    OutputDebugStringA(buff);
+}
 #endif
 #pragma endregion
 
@@ -367,6 +488,29 @@ void Game::OnKeyPress(int vk)
 {
     auto context = m_deviceResources->GetD3DDeviceContext();
 
+    switch (vk)
+    {
+    case 'L':
+        // Toggle between the 15 tap GaussianBlur.hlsl and the GaussianKernel.h kernels.
+        g_LinearBlur = !g_LinearBlur;
+        return;
+
+    case 'D':
+        // Toggle between the separable Gaussian and the dual filter mip chain.
+        g_DualFilter = !g_DualFilter;
+        LogBloomCost();
+        return;
+
+    case VK_PRIOR:
+    case VK_NEXT:
+        g_DualLevels = (vk == VK_PRIOR) ? std::min(g_DualLevels + 1, DUAL_FILTER_MAX_LEVELS) : std::max(g_DualLevels - 1, 1u);
+        LogBloomCost();
+        return;
+
+    default:
+        break;
+    }
+
     BloomPresets preset;
 
     switch (vk)
@@ -399,6 +543,10 @@ void Game::OnKeyPress(int vk)
         VS_BLUR_PARAMETERS blurData;
         blurData.SetBlurEffectParameters(1.f / m_bloomRect.right, 0, g_BloomPresets[preset]);
         context->UpdateSubresource(m_blurParamsWidth.Get(), 0, nullptr, &blurData, 0, 0);
+
+        VS_LINEAR_BLUR_PARAMETERS linearBlurData;
+        linearBlurData.SetBlurEffectParameters(1.f / m_bloomRect.right, 0, g_LinearKernels[preset]);
+        context->UpdateSubresource(m_linearBlurParamsWidth.Get(), 0, nullptr, &linearBlurData, 0, 0);
     }
 
     if (m_bloomRect.bottom && m_blurParamsHeight)
@@ -406,6 +554,10 @@ void Game::OnKeyPress(int vk)
         VS_BLUR_PARAMETERS blurData;
         blurData.SetBlurEffectParameters(0, 1.f / m_bloomRect.bottom, g_BloomPresets[preset]);
         context->UpdateSubresource(m_blurParamsHeight.Get(), 0, nullptr, &blurData, sizeof(VS_BLUR_PARAMETERS), 0);
+
+        VS_LINEAR_BLUR_PARAMETERS linearBlurData;
+        linearBlurData.SetBlurEffectParameters(0, 1.f / m_bloomRect.bottom, g_LinearKernels[preset]);
+        context->UpdateSubresource(m_linearBlurParamsHeight.Get(), 0, nullptr, &linearBlurData, 0, 0);
     }
 #endif
 }
@@ -444,6 +596,24 @@ void Game::CreateDeviceDependentResources()
     blob = DX::ReadData( L"GaussianBlur.cso" );
     DX::ThrowIfFailed(device->CreatePixelShader( &blob.front(), blob.size(), nullptr, m_gaussianBlurPS.ReleaseAndGetAddressOf()));
 
+    blob = DX::ReadData( L"GaussianBlurLinear.cso" );
+    DX::ThrowIfFailed(device->CreatePixelShader( &blob.front(), blob.size(), nullptr, m_gaussianBlurLinearPS.ReleaseAndGetAddressOf()));
+
+    blob = DX::ReadData( L"DualDownsample.cso" );
+    DX::ThrowIfFailed(device->CreatePixelShader( &blob.front(), blob.size(), nullptr, m_dualDownsamplePS.ReleaseAndGetAddressOf()));
+
+    blob = DX::ReadData( L"DualUpsample.cso" );
+    DX::ThrowIfFailed(device->CreatePixelShader( &blob.front(), blob.size(), nullptr, m_dualUpsamplePS.ReleaseAndGetAddressOf()));
+
+    {
+        // lerp(dest, source, blend factor) for accumulating dual filter levels.
+        CD3D11_BLEND_DESC blendDesc(D3D11_DEFAULT);
+        blendDesc.RenderTarget[0].BlendEnable = TRUE;
+        blendDesc.RenderTarget[0].SrcBlend = blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_BLEND_FACTOR;
+        blendDesc.RenderTarget[0].DestBlend = blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_BLEND_FACTOR;
+        DX::ThrowIfFailed(device->CreateBlendState(&blendDesc, m_dualBlendState.ReleaseAndGetAddressOf()));
+    }
+
     {
         CD3D11_BUFFER_DESC cbDesc(sizeof(VS_BLOOM_PARAMETERS), D3D11_BIND_CONSTANT_BUFFER);
         D3D11_SUBRESOURCE_DATA initData = { &g_BloomPresets[g_Bloom], 0, 0 };
@@ -456,9 +626,13 @@ void Game::CreateDeviceDependentResources()
         DX::ThrowIfFailed(device->CreateBuffer(&cbDesc, nullptr, m_blurParamsHeight.ReleaseAndGetAddressOf()));
     }
 
-    m_offscreenTexture->SetDevice(device);
-    m_renderTarget1->SetDevice(device);
-    m_renderTarget2->SetDevice(device);
+    {
+        CD3D11_BUFFER_DESC cbDesc(sizeof(VS_LINEAR_BLUR_PARAMETERS), D3D11_BIND_CONSTANT_BUFFER);
+        DX::ThrowIfFailed(device->CreateBuffer(&cbDesc, nullptr, m_linearBlurParamsWidth.ReleaseAndGetAddressOf()));
+        DX::ThrowIfFailed(device->CreateBuffer(&cbDesc, nullptr, m_linearBlurParamsHeight.ReleaseAndGetAddressOf()));
+    }
+
+    m_targetPool.GetFactory().SetDevice(device);
 #endif
 
     m_view = Matrix::CreateLookAt(Vector3(0.f, 3.f, -3.f), Vector3::Zero, Vector3::UnitY);
@@ -483,16 +657,23 @@ void Game::CreateWindowSizeDependentResources()
 
     blurData.SetBlurEffectParameters(0, 1.f / (size.bottom / 2), g_BloomPresets[g_Bloom]);
     context->UpdateSubresource(m_blurParamsHeight.Get(), 0, nullptr, &blurData, sizeof(VS_BLUR_PARAMETERS), 0);
+
+    VS_LINEAR_BLUR_PARAMETERS linearBlurData = {};
+    linearBlurData.SetBlurEffectParameters(1.f / (float(size.right) / 2), 0, g_LinearKernels[g_Bloom]);
+    context->UpdateSubresource(m_linearBlurParamsWidth.Get(), 0, nullptr, &linearBlurData, 0, 0);
+
+    linearBlurData.SetBlurEffectParameters(0, 1.f / (float(size.bottom) / 2), g_LinearKernels[g_Bloom]);
+    context->UpdateSubresource(m_linearBlurParamsHeight.Get(), 0, nullptr, &linearBlurData, 0, 0);
 #endif
 
 #if 1
-    m_offscreenTexture->SetWindow(size);
-
     // Half-size blurring render targets
     m_bloomRect = { 0, 0, size.right / 2, size.bottom / 2 };
 
-    m_renderTarget1->SetWindow(m_bloomRect);
-    m_renderTarget2->SetWindow(m_bloomRect);
+    // Targets of the old size won't be requested again.
+    m_targetPool.Clear();
+
+    LogBloomCost();
 #endif
 }
 
@@ -508,16 +689,24 @@ void Game::OnDeviceLost()
     m_bloomExtractPS.Reset();
     m_bloomCombinePS.Reset();
     m_gaussianBlurPS.Reset();
+    m_gaussianBlurLinearPS.Reset();
+    m_dualDownsamplePS.Reset();
+    m_dualUpsamplePS.Reset();
+    m_dualBlendState.Reset();
 
     m_bloomParams.Reset();
     m_blurParamsWidth.Reset();
     m_blurParamsHeight.Reset();
+    m_linearBlurParamsWidth.Reset();
+    m_linearBlurParamsHeight.Reset();
 #endif
 
 #if 1
-    m_offscreenTexture->ReleaseDevice();
-    m_renderTarget1->ReleaseDevice();
-    m_renderTarget2->ReleaseDevice();
+    m_offscreenTexture = m_renderTarget1 = m_renderTarget2 = nullptr;
+    m_bloomChain.clear();
+    m_targetPool.Clear();
+    m_targetPool.GetFactory().SetDevice(nullptr);
+    m_targetPoolBytes = 0;
 #endif
 }
 
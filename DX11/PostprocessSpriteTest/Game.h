@@ -6,7 +6,7 @@
 
 #include "DeviceResources.h"
 #include "StepTimer.h"
-#include "RenderTexture.h"
+#include "RenderTargetPool.h"
 
 
 // A basic game implementation that creates a D3D11 device and
@@ -56,7 +56,10 @@ private:
     void CreateDeviceDependentResources();
     void CreateWindowSizeDependentResources();
 
+    void PlanRenderTargets();
     void PostProcess();
+    void DualFilterBlur();
+    void LogBloomCost() const;
 
     // Device resources.
     std::unique_ptr<DX::DeviceResources>    m_deviceResources;
@@ -81,15 +84,26 @@ private:
     Microsoft::WRL::ComPtr<ID3D11PixelShader>        m_bloomExtractPS;
     Microsoft::WRL::ComPtr<ID3D11PixelShader>        m_bloomCombinePS;
     Microsoft::WRL::ComPtr<ID3D11PixelShader>        m_gaussianBlurPS;
+    Microsoft::WRL::ComPtr<ID3D11PixelShader>        m_gaussianBlurLinearPS;
+    Microsoft::WRL::ComPtr<ID3D11PixelShader>        m_dualDownsamplePS;
+    Microsoft::WRL::ComPtr<ID3D11PixelShader>        m_dualUpsamplePS;
+    Microsoft::WRL::ComPtr<ID3D11BlendState>         m_dualBlendState;
 
     Microsoft::WRL::ComPtr<ID3D11Buffer>             m_bloomParams;
     Microsoft::WRL::ComPtr<ID3D11Buffer>             m_blurParamsWidth;
     Microsoft::WRL::ComPtr<ID3D11Buffer>             m_blurParamsHeight;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>             m_linearBlurParamsWidth;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>             m_linearBlurParamsHeight;
 #endif
 
 #if 1
-    std::unique_ptr<DX::RenderTexture>               m_offscreenTexture;
-    std::unique_ptr<DX::RenderTexture>               m_renderTarget1;
-    std::unique_ptr<DX::RenderTexture>               m_renderTarget2;
+    // Transient targets from m_targetPool, valid for the current frame.
+    DX::RenderTargetPool                             m_targetPool;
+    DX::RenderTexture*                               m_offscreenTexture;
+    DX::RenderTexture*                               m_renderTarget1;
+    DX::RenderTexture*                               m_renderTarget2;
+    std::vector<DX::RenderTexture*>                  m_bloomChain;
+    std::vector<uint32_t>                            m_chainTargets;
+    uint64_t                                         m_targetPoolBytes;
 #endif
 };
@@ -0,0 +1,29 @@
+Texture2D<float4> Texture : register(t0);
+sampler TextureSampler : register(s0);
+
+#define MAX_TAP_COUNT 32
+
+// Kernels from GaussianKernel.h: a center texel plus TapCount bilinear fetches, each
+// applied on both sides of it.
+cbuffer VS_LINEAR_BLUR_PARAMETERS : register(b0)
+{
+    float2 TexelStep;
+    float CenterWeight;
+    uint TapCount;
+    float4 Taps[MAX_TAP_COUNT]; // x = offset in texels, y = weight
+}
+
+float4 main(float4 color : COLOR0, float2 texCoord : TEXCOORD0) : SV_Target0
+{
+    float4 c = Texture.Sample(TextureSampler, texCoord) * CenterWeight;
+
+    [loop]
+    for (uint i = 0; i < TapCount; i++)
+    {
+        float2 offset = TexelStep * Taps[i].x;
+        c += (Texture.Sample(TextureSampler, texCoord + offset)
+            + Texture.Sample(TextureSampler, texCoord - offset)) * Taps[i].y;
+    }
+
+    return c;
+}
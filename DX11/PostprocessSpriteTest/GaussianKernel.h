@@ -0,0 +1,153 @@
+//--------------------------------------------------------------------------------------
+// File: GaussianKernel.h
+//
+// Gaussian blur kernels for GaussianBlurLinear.hlsl. Each pair of adjacent texels is
+// merged into one bilinear fetch, so a radius R kernel costs 1 + 2 * ceil(R / 2) fetches.
+// GaussianBlur.hlsl already fetches texel pairs, but at fixed offsets that split the pair
+// weights evenly; these kernels place each fetch so the split is exact for the sigma, at
+// the same fetch count for the presets. The generator is constexpr: the preset tables are
+// built at compile time, and the same function builds kernels for custom sigmas at runtime.
+// This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "BloomPresets.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Bloom
+{
+    // Matches MAX_TAP_COUNT in GaussianBlurLinear.hlsl.
+    constexpr size_t LINEAR_BLUR_MAX_TAPS = 32;
+
+    // Largest radius in texels that fits in LINEAR_BLUR_MAX_TAPS fetches per side.
+    constexpr int LINEAR_BLUR_MAX_RADIUS = int(LINEAR_BLUR_MAX_TAPS) * 2;
+
+    // One side of a symmetric kernel: the center texel, then tapCount fetches that are each
+    // applied at +offset and -offset texels.
+    struct LinearKernel
+    {
+        float       centerWeight;
+        uint32_t    tapCount;
+        float       offsets[LINEAR_BLUR_MAX_TAPS];
+        float       weights[LINEAR_BLUR_MAX_TAPS];
+    };
+
+    namespace Internal
+    {
+        // std::exp is not constexpr. Halving the argument keeps the series short, and the
+        // result is squared back up.
+        constexpr double ConstExp(double x)
+        {
+            int halvings = 0;
+            while (x < -0.5 || x > 0.5)
+            {
+                x *= 0.5;
+                ++halvings;
+            }
+
+            double term = 1.0;
+            double sum = 1.0;
+            for (int n = 1; n < 16; ++n)
+            {
+                term *= x / n;
+                sum += term;
+            }
+
+            while (halvings-- > 0)
+            {
+                sum *= sum;
+            }
+
+            return sum;
+        }
+
+        constexpr double Gaussian(int x, double sigma)
+        {
+            return ConstExp(-double(x) * double(x) / (2.0 * sigma * sigma));
+        }
+    }
+
+    // Radius that keeps all but ~0.3% of the Gaussian's weight.
+    constexpr int LinearKernelRadius(float sigma)
+    {
+        int radius = int(3.f * sigma);
+        if (float(radius) < 3.f * sigma)
+            ++radius;
+        return (radius < LINEAR_BLUR_MAX_RADIUS) ? radius : LINEAR_BLUR_MAX_RADIUS;
+    }
+
+    // Texel weights are the Gaussian at integer offsets, normalized over [-radius, radius].
+    // Texels i and i + 1 with weights w0 and w1 become one fetch at i + w1 / (w0 + w1) with
+    // weight w0 + w1, which the bilinear filter splits back exactly (to the hardware's
+    // subtexel precision). An odd radius leaves the last texel as a single point fetch.
+    constexpr LinearKernel MakeLinearKernel(float sigma, int radius)
+    {
+        LinearKernel kernel = {};
+
+        if (!(sigma > 0.f) || radius < 1)
+        {
+            kernel.centerWeight = 1.f;
+            return kernel;
+        }
+
+        if (radius > LINEAR_BLUR_MAX_RADIUS)
+            radius = LINEAR_BLUR_MAX_RADIUS;
+
+        double total = 1.0;
+        for (int i = 1; i <= radius; ++i)
+        {
+            total += 2.0 * Internal::Gaussian(i, sigma);
+        }
+
+        kernel.centerWeight = float(1.0 / total);
+
+        uint32_t count = 0;
+        for (int i = 1; i <= radius; i += 2)
+        {
+            const double w0 = Internal::Gaussian(i, sigma) / total;
+            const double w1 = (i + 1 <= radius) ? Internal::Gaussian(i + 1, sigma) / total : 0.0;
+
+            kernel.weights[count] = float(w0 + w1);
+            kernel.offsets[count] = float(double(i) + w1 / (w0 + w1));
+            ++count;
+        }
+
+        kernel.tapCount = count;
+        return kernel;
+    }
+
+    constexpr LinearKernel MakeLinearKernel(float sigma)
+    {
+        return MakeLinearKernel(sigma, LinearKernelRadius(sigma));
+    }
+
+    // The ComputeBlurKernel taps step two texels per Gaussian unit of blurAmount, so the
+    // presets blur with sigma = 2 * blurAmount texels. The radius stays at that kernel's 14
+    // texel footprint, which takes the same 15 fetches with exact weights.
+    constexpr int PRESET_BLUR_RADIUS = int(BLUR_SAMPLE_COUNT / 2) * 2;
+
+    constexpr LinearKernel MakePresetKernel(BloomPresets preset)
+    {
+        return MakeLinearKernel(2.f * g_BloomPresets[preset].blurAmount, PRESET_BLUR_RADIUS);
+    }
+
+    constexpr LinearKernel g_LinearKernels[] =
+    {
+        MakePresetKernel(Default),
+        MakePresetKernel(Soft),
+        MakePresetKernel(Desaturated),
+        MakePresetKernel(Saturated),
+        MakePresetKernel(Blurry),
+        MakePresetKernel(Subtle),
+        MakePresetKernel(None),
+    };
+
+    static_assert(sizeof(g_LinearKernels) / sizeof(g_LinearKernels[0]) == BloomPresets_Count, "Missing linear kernel");
+    static_assert(g_LinearKernels[Default].tapCount == PRESET_BLUR_RADIUS / 2, "Preset kernels should take 15 fetches");
+}
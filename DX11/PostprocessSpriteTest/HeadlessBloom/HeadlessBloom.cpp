@@ -0,0 +1,293 @@
+//--------------------------------------------------------------------------------------
+// File: HeadlessBloom.cpp
+//
+// Runs the CPU bloom from BloomCPU.h on an image without a GPU, for golden image tests and
+// offline thumbnails. Images are binary PPM (P6) or PAM (P7, RGB_ALPHA) files. Without an
+// input file a synthetic test pattern of the given size is used, which together with
+// -bench measures frame times. -dual switches to the dual filter blur with the given number
+// of levels and prints the texel fetch cost model for both modes.
+//
+// This is a standalone console tool with no Windows or Direct3D dependencies:
+//
+//   g++ -std=c++14 -O2 -mavx2 -pthread -I../../Common -o HeadlessBloom HeadlessBloom.cpp
+//   cl /std:c++14 /O2 /arch:AVX2 /EHsc /I..\..\Common HeadlessBloom.cpp
+//
+//   HeadlessBloom [-preset 0-6] [-in <file>] [-out <file>] [-size WxH] [-bench N] [-dual levels] [-exact]
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "../BloomCPU.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace Bloom;
+
+namespace
+{
+    const char* PresetNames[] = { "Default", "Soft", "Desaturated", "Saturated", "Blurry", "Subtle", "None" };
+
+    struct Image
+    {
+        uint32_t                width;
+        uint32_t                height;
+        std::vector<uint8_t>    pixels;     // RGBA
+    };
+
+    std::string ReadToken(std::istream& in)
+    {
+        std::string token;
+        int c = in.get();
+        while (c != EOF)
+        {
+            if (c == '#')
+            {
+                while (c != EOF && c != '\n')
+                    c = in.get();
+            }
+            else if (!isspace(c))
+            {
+                token.push_back(char(c));
+            }
+            else if (!token.empty())
+            {
+                break;
+            }
+            c = in.get();
+        }
+        return token;
+    }
+
+    Image LoadImage(const char* fileName)
+    {
+        std::ifstream in(fileName, std::ios::in | std::ios::binary);
+        if (!in)
+            throw std::runtime_error("Failed to open input image");
+
+        Image image = {};
+        uint32_t channels = 3;
+
+        const std::string magic = ReadToken(in);
+        if (magic == "P6")
+        {
+            image.width = uint32_t(atoi(ReadToken(in).c_str()));
+            image.height = uint32_t(atoi(ReadToken(in).c_str()));
+            if (ReadToken(in) != "255")
+                throw std::runtime_error("Only 8-bit PPM images are supported");
+        }
+        else if (magic == "P7")
+        {
+            for (std::string token = ReadToken(in); token != "ENDHDR"; token = ReadToken(in))
+            {
+                if (token.empty())
+                    throw std::runtime_error("Truncated PAM header");
+                else if (token == "WIDTH")
+                    image.width = uint32_t(atoi(ReadToken(in).c_str()));
+                else if (token == "HEIGHT")
+                    image.height = uint32_t(atoi(ReadToken(in).c_str()));
+                else if (token == "DEPTH")
+                    channels = uint32_t(atoi(ReadToken(in).c_str()));
+                else if (token == "MAXVAL" && ReadToken(in) != "255")
+                    throw std::runtime_error("Only 8-bit PAM images are supported");
+            }
+
+            if (channels != 3 && channels != 4)
+                throw std::runtime_error("PAM images must be RGB or RGB_ALPHA");
+        }
+        else
+        {
+            throw std::runtime_error("Input must be a binary PPM or PAM image");
+        }
+
+        if (image.width < 4 || image.height < 4 || image.width > 16384 || image.height > 16384)
+            throw std::runtime_error("Invalid image size");
+
+        std::vector<uint8_t> data(size_t(image.width) * image.height * channels);
+        in.read(reinterpret_cast<char*>(data.data()), std::streamsize(data.size()));
+        if (!in)
+            throw std::runtime_error("Truncated image data");
+
+        image.pixels.resize(size_t(image.width) * image.height * 4);
+        for (size_t i = 0; i < size_t(image.width) * image.height; ++i)
+        {
+            for (size_t c = 0; c < 3; ++c)
+            {
+                image.pixels[i * 4 + c] = data[i * channels + c];
+            }
+            image.pixels[i * 4 + 3] = (channels == 4) ? data[i * 4 + 3] : 255;
+        }
+
+        return image;
+    }
+
+    void SaveImage(const char* fileName, const Image& image)
+    {
+        std::ofstream out(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out)
+            throw std::runtime_error("Failed to create output image");
+
+        const std::string header = "P7\nWIDTH " + std::to_string(image.width) + "\nHEIGHT " + std::to_string(image.height)
+            + "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+        out.write(header.data(), std::streamsize(header.size()));
+        out.write(reinterpret_cast<const char*>(image.pixels.data()), std::streamsize(image.pixels.size()));
+
+        if (!out)
+            throw std::runtime_error("Failed to write output image");
+    }
+
+    // Gradient with bright spots, so every preset has something above its threshold.
+    Image MakeTestPattern(uint32_t width, uint32_t height)
+    {
+        Image image = { width, height, std::vector<uint8_t>(size_t(width) * height * 4) };
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                uint8_t* p = &image.pixels[(size_t(y) * width + x) * 4];
+                const bool spot = ((x / 64) + (y / 64)) % 5 == 0 && (x % 64) < 16 && (y % 64) < 16;
+                p[0] = spot ? 255 : uint8_t(x * 255 / width);
+                p[1] = spot ? 240 : uint8_t(y * 255 / height);
+                p[2] = spot ? 200 : uint8_t(64);
+                p[3] = 255;
+            }
+        }
+        return image;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int preset = Default;
+    const char* inFile = nullptr;
+    const char* outFile = nullptr;
+    uint32_t width = 1920;
+    uint32_t height = 1080;
+    int iterations = 0;
+    int dualLevels = 0;
+    bool exact = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-preset") && i + 1 < argc)
+        {
+            preset = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-in") && i + 1 < argc)
+        {
+            inFile = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-out") && i + 1 < argc)
+        {
+            outFile = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-size") && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%ux%u", &width, &height) != 2)
+            {
+                printf("ERROR: -size expects WxH\n");
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-bench") && i + 1 < argc)
+        {
+            iterations = std::max(atoi(argv[++i]), 1);
+        }
+        else if (!strcmp(argv[i], "-dual") && i + 1 < argc)
+        {
+            dualLevels = atoi(argv[++i]);
+            if (dualLevels < 1 || dualLevels > int(DUAL_FILTER_MAX_LEVELS))
+            {
+                printf("ERROR: -dual must be 1 to %u\n", DUAL_FILTER_MAX_LEVELS);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-exact"))
+        {
+            exact = true;
+        }
+        else
+        {
+            printf("Usage: HeadlessBloom [-preset 0-6] [-in <file>] [-out <file>] [-size WxH] [-bench N] [-dual levels] [-exact]\n");
+            return 1;
+        }
+    }
+
+    if (preset < 0 || preset >= BloomPresets_Count)
+    {
+        printf("ERROR: -preset must be 0 to %d\n", BloomPresets_Count - 1);
+        return 1;
+    }
+
+    try
+    {
+        const Image source = inFile ? LoadImage(inFile) : MakeTestPattern(width, height);
+        Image result = { source.width, source.height, std::vector<uint8_t>(source.pixels.size()) };
+
+        BloomProcessor bloom;
+        bloom.SetPreset(BloomPresets(preset));
+        bloom.SetEmulateUnorm8(!exact);
+        bloom.SetDualFilter(uint32_t(dualLevels));
+
+        if (dualLevels)
+        {
+            const uint32_t levels = ClampDualFilterLevels(source.width, source.height, uint32_t(dualLevels));
+            const BloomCost gaussian = GaussianBloomCost(source.width, source.height);
+            const BloomCost dual = DualBloomCost(source.width, source.height, levels);
+
+            printf("Gaussian:      %6.2f fetches/pixel, %4.2f pixels/pixel, support radius %.0f texels\n",
+                gaussian.fetches / (double(source.width) * source.height), gaussian.pixels / (double(source.width) * source.height),
+                GaussianSupportRadius());
+            printf("Dual %u levels: %6.2f fetches/pixel, %4.2f pixels/pixel, support radius %.0f texels\n",
+                levels, dual.fetches / (double(source.width) * source.height), dual.pixels / (double(source.width) * source.height),
+                DualFilterSupportRadius(levels));
+        }
+
+        const size_t pitch = size_t(source.width) * 4;
+        bloom.Process(source.pixels.data(), pitch, source.width, source.height, result.pixels.data(), pitch);
+
+        if (iterations)
+        {
+            double best = 1e30;
+            double total = 0;
+            for (int k = 0; k < iterations; ++k)
+            {
+                const auto start = std::chrono::high_resolution_clock::now();
+                bloom.Process(source.pixels.data(), pitch, source.width, source.height, result.pixels.data(), pitch);
+                const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+                best = std::min(best, seconds);
+                total += seconds;
+            }
+
+        #if defined(__AVX2__)
+            const char* simd = "AVX2";
+        #else
+            const char* simd = "scalar";
+        #endif
+
+            printf("%ux%u %s (%s, %zu threads): best %.3f ms, average %.3f ms, %.1f fps\n",
+                source.width, source.height, PresetNames[preset], simd, DX::GetWorkerCount(),
+                best * 1e3, total / iterations * 1e3, 1.0 / best);
+        }
+
+        if (outFile)
+        {
+            SaveImage(outFile, result);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        printf("ERROR: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
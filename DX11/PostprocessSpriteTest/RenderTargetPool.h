@@ -0,0 +1,70 @@
+//--------------------------------------------------------------------------------------
+// File: RenderTargetPool.h
+//
+// TransientTargetPool backed by DX::RenderTexture.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "RenderTexture.h"
+#include "TransientTargetPool.h"
+
+namespace DX
+{
+    inline uint32_t BytesPerTexel(DXGI_FORMAT format) noexcept
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+            return 16;
+
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        case DXGI_FORMAT_R16G16B16A16_UNORM:
+        case DXGI_FORMAT_R32G32_FLOAT:
+            return 8;
+
+        case DXGI_FORMAT_R16_FLOAT:
+        case DXGI_FORMAT_R16_UNORM:
+        case DXGI_FORMAT_R8G8_UNORM:
+            return 2;
+
+        case DXGI_FORMAT_R8_UNORM:
+        case DXGI_FORMAT_A8_UNORM:
+            return 1;
+
+        default:
+            return 4;
+        }
+    }
+
+    inline TargetDesc MakeTargetDesc(DXGI_FORMAT format, uint32_t width, uint32_t height) noexcept
+    {
+        return TargetDesc{ width, height, uint32_t(format), BytesPerTexel(format) };
+    }
+
+    class RenderTextureFactory
+    {
+    public:
+        using Texture = RenderTexture;
+
+        RenderTextureFactory() noexcept : m_device(nullptr) {}
+
+        void SetDevice(_In_opt_ ID3D11Device* device) noexcept { m_device = device; }
+
+        std::unique_ptr<RenderTexture> CreateTarget(const TargetDesc& desc) const
+        {
+            auto target = std::make_unique<RenderTexture>(DXGI_FORMAT(desc.format));
+            target->SetDevice(m_device);
+            target->SizeResources(desc.width, desc.height);
+            return target;
+        }
+
+    private:
+        ID3D11Device* m_device;
+    };
+
+    using RenderTargetPool = TransientTargetPool<RenderTextureFactory>;
+}
@@ -0,0 +1,327 @@
+//--------------------------------------------------------------------------------------
+// File: TargetPoolSim.cpp
+//
+// Runs TransientTargetPool.h against a mock device for a frame graph of a dozen post
+// effects, checks that no two requests with overlapping pass ranges share a texture, that
+// idle targets are freed and that the same frame reuses the same textures, and reports the
+// render target memory with and without aliasing.
+//
+// This is a standalone console tool with no Windows or Direct3D dependencies:
+//
+//   g++ -std=c++14 -O2 -o TargetPoolSim TargetPoolSim.cpp
+//   cl /std:c++14 /O2 /EHsc TargetPoolSim.cpp
+//
+//   TargetPoolSim [-size WxH] [-idle frames]
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "../TransientTargetPool.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    // DXGI_FORMAT values, so the tool doesn't need the Windows headers.
+    enum Format : uint32_t
+    {
+        Format_RGBA16F = 10,    // DXGI_FORMAT_R16G16B16A16_FLOAT
+        Format_RGBA8 = 28,      // DXGI_FORMAT_R8G8B8A8_UNORM
+        Format_R16F = 54,       // DXGI_FORMAT_R16_FLOAT
+        Format_R8 = 61,         // DXGI_FORMAT_R8_UNORM
+    };
+
+    uint32_t BytesPerTexel(uint32_t format)
+    {
+        switch (format)
+        {
+        case Format_RGBA16F:    return 8;
+        case Format_R16F:       return 2;
+        case Format_R8:         return 1;
+        default:                return 4;
+        }
+    }
+
+    struct DeviceStats
+    {
+        uint64_t    liveBytes;
+        uint64_t    peakBytes;
+        uint32_t    created;
+        uint32_t    released;
+    };
+
+    // Stands in for a RenderTexture: records its allocation against the mock device.
+    class MockTexture
+    {
+    public:
+        MockTexture(DeviceStats* stats, const TargetDesc& desc, uint32_t id) noexcept :
+            mStats(stats),
+            mDesc(desc),
+            mId(id)
+        {
+            mStats->liveBytes += desc.GetBytes();
+            mStats->peakBytes = std::max(mStats->peakBytes, mStats->liveBytes);
+            ++mStats->created;
+        }
+
+        ~MockTexture()
+        {
+            mStats->liveBytes -= mDesc.GetBytes();
+            ++mStats->released;
+        }
+
+        MockTexture(MockTexture const&) = delete;
+        MockTexture& operator= (MockTexture const&) = delete;
+
+        const TargetDesc& GetDesc() const noexcept { return mDesc; }
+        uint32_t GetId() const noexcept { return mId; }
+
+    private:
+        DeviceStats*    mStats;
+        TargetDesc      mDesc;
+        uint32_t        mId;
+    };
+
+    class MockDevice
+    {
+    public:
+        using Texture = MockTexture;
+
+        explicit MockDevice(DeviceStats* stats = nullptr) noexcept : mStats(stats), mNextId(1) {}
+
+        std::unique_ptr<MockTexture> CreateTarget(const TargetDesc& desc)
+        {
+            return std::make_unique<MockTexture>(mStats, desc, mNextId++);
+        }
+
+    private:
+        DeviceStats*    mStats;
+        uint32_t        mNextId;
+    };
+
+    struct EffectTarget
+    {
+        const char* name;
+        uint32_t    divisor;    // 1 = full size, 2 = half size, ...
+        uint32_t    format;
+        uint32_t    firstPass;
+        uint32_t    lastPass;
+        bool        depthOfField;
+    };
+
+    // Scene, SSAO, bloom, depth of field, motion blur, tone mapping and the LDR chain.
+    const EffectTarget c_frame[] =
+    {
+        { "Scene HDR",          1, Format_RGBA16F,  0,  8, false },
+        { "SSAO",               2, Format_R8,       1,  2, false },
+        { "SSAO blur",          2, Format_R8,       2,  3, false },
+        { "Bloom extract",      2, Format_RGBA16F,  4,  5, false },
+        { "Bloom blur H",       2, Format_RGBA16F,  5,  6, false },
+        { "Bloom blur V",       2, Format_RGBA16F,  6, 11, false },
+        { "DoF CoC",            2, Format_R16F,     7,  9, true },
+        { "DoF near",           2, Format_RGBA16F,  8,  9, true },
+        { "DoF far",            2, Format_RGBA16F,  8,  9, true },
+        { "DoF composite",      1, Format_RGBA16F,  9, 10, true },
+        { "Motion blur",        1, Format_RGBA16F, 10, 11, false },
+        { "Tone mapped",        1, Format_RGBA8,   11, 12, false },
+        { "FXAA",               1, Format_RGBA8,   12, 13, false },
+        { "Sharpen",            1, Format_RGBA8,   13, 14, false },
+    };
+
+    constexpr size_t c_targetCount = sizeof(c_frame) / sizeof(c_frame[0]);
+
+    struct FrameResult
+    {
+        const MockTexture*  textures[c_targetCount];
+        uint64_t            requestedBytes;
+        uint64_t            allocatedBytes;
+    };
+
+    FrameResult RunFrame(TransientTargetPool<MockDevice>& pool, uint32_t width, uint32_t height, bool depthOfField)
+    {
+        pool.BeginFrame();
+
+        uint32_t requests[c_targetCount] = {};
+        for (size_t i = 0; i < c_targetCount; ++i)
+        {
+            const auto& target = c_frame[i];
+            if (target.depthOfField && !depthOfField)
+                continue;
+
+            const TargetDesc desc = { width / target.divisor, height / target.divisor, target.format, BytesPerTexel(target.format) };
+            requests[i] = pool.Request(desc, target.firstPass, target.lastPass);
+        }
+
+        pool.Plan();
+
+        FrameResult result = {};
+        for (size_t i = 0; i < c_targetCount; ++i)
+        {
+            if (c_frame[i].depthOfField && !depthOfField)
+                continue;
+
+            result.textures[i] = pool.Get(requests[i]);
+            if (!result.textures[i])
+                throw std::runtime_error("Missing texture");
+        }
+
+        result.requestedBytes = pool.GetPlanner().GetRequestedBytes();
+        result.allocatedBytes = pool.GetPlanner().GetAllocatedBytes();
+        return result;
+    }
+
+    // Returns the number of targets that share a texture with an overlapping request or got a
+    // texture of the wrong size or format.
+    int CheckFrame(const FrameResult& frame, uint32_t width, uint32_t height)
+    {
+        int errors = 0;
+        for (size_t i = 0; i < c_targetCount; ++i)
+        {
+            const auto a = frame.textures[i];
+            if (!a)
+                continue;
+
+            const auto& target = c_frame[i];
+            const TargetDesc desc = { width / target.divisor, height / target.divisor, target.format, 0 };
+            if (!a->GetDesc().Matches(desc))
+            {
+                printf("ERROR: %s got a %ux%u texture\n", target.name, a->GetDesc().width, a->GetDesc().height);
+                ++errors;
+            }
+
+            for (size_t j = i + 1; j < c_targetCount; ++j)
+            {
+                if (frame.textures[j] == a
+                    && c_frame[j].firstPass <= target.lastPass && target.firstPass <= c_frame[j].lastPass)
+                {
+                    printf("ERROR: %s and %s overlap but share texture %u\n", target.name, c_frame[j].name, a->GetId());
+                    ++errors;
+                }
+            }
+        }
+        return errors;
+    }
+
+    double MB(uint64_t bytes)
+    {
+        return double(bytes) / (1024. * 1024.);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t width = 1920;
+    uint32_t height = 1080;
+    uint32_t idleFrames = TransientTargetPlanner::DefaultMaxIdleFrames;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-size") && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%ux%u", &width, &height) != 2 || width < 8 || height < 8)
+            {
+                printf("ERROR: -size expects WxH\n");
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-idle") && i + 1 < argc)
+        {
+            idleFrames = uint32_t(atoi(argv[++i]));
+        }
+        else
+        {
+            printf("Usage: TargetPoolSim [-size WxH] [-idle frames]\n");
+            return 1;
+        }
+    }
+
+    try
+    {
+        DeviceStats stats = {};
+        TransientTargetPool<MockDevice> pool(idleFrames, MockDevice(&stats));
+        int errors = 0;
+
+        // Steady state: the same frame should reuse the same textures without new allocations.
+        FrameResult first = RunFrame(pool, width, height, true);
+        errors += CheckFrame(first, width, height);
+        const uint32_t created = stats.created;
+
+        for (int frame = 0; frame < 10; ++frame)
+        {
+            const FrameResult result = RunFrame(pool, width, height, true);
+            errors += CheckFrame(result, width, height);
+            if (memcmp(result.textures, first.textures, sizeof(first.textures)) != 0)
+            {
+                printf("ERROR: frame %d changed its texture assignment\n", frame + 2);
+                ++errors;
+            }
+        }
+
+        if (stats.created != created)
+        {
+            printf("ERROR: steady state frames allocated %u textures\n", stats.created - created);
+            ++errors;
+        }
+
+        printf("%ux%u, %zu targets from %u textures: %.1f MB requested, %.1f MB allocated (%.0f%%)\n",
+            width, height, c_targetCount, created, MB(first.requestedBytes), MB(first.allocatedBytes),
+            100. * double(first.allocatedBytes) / double(first.requestedBytes));
+
+        // Turning depth of field off: its textures go idle and are freed after idleFrames.
+        uint32_t freedAfter = 0;
+        FrameResult result = {};
+        for (uint32_t frame = 1; frame <= idleFrames + 2; ++frame)
+        {
+            const uint64_t before = stats.liveBytes;
+            result = RunFrame(pool, width, height, false);
+            errors += CheckFrame(result, width, height);
+            if (stats.liveBytes < before && !freedAfter)
+            {
+                freedAfter = frame;
+            }
+        }
+
+        if (freedAfter != idleFrames + 1)
+        {
+            printf("ERROR: idle textures were freed after %u frames, expected %u\n", freedAfter, idleFrames + 1);
+            ++errors;
+        }
+
+        printf("Depth of field off: %.1f MB requested, %.1f MB allocated, freed on frame %u\n",
+            MB(result.requestedBytes), MB(result.allocatedBytes), freedAfter);
+
+        // Resizing: the caller clears the pool and every target is created at the new size.
+        pool.Clear();
+        if (stats.liveBytes)
+        {
+            printf("ERROR: Clear left %.1f MB allocated\n", MB(stats.liveBytes));
+            ++errors;
+        }
+
+        result = RunFrame(pool, width / 2, height / 2, true);
+        errors += CheckFrame(result, width / 2, height / 2);
+
+        printf("Resized to %ux%u: %.1f MB allocated, %u textures created and %u released in total, peak %.1f MB\n",
+            width / 2, height / 2, MB(result.allocatedBytes), stats.created, stats.released, MB(stats.peakBytes));
+
+        if (errors)
+        {
+            printf("ERROR: %d check(s) failed\n", errors);
+            return 1;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        printf("ERROR: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,308 @@
+//--------------------------------------------------------------------------------------
+// File: TransientTargetPool.h
+//
+// Per-frame render target pool for post processing. Each frame the passes request targets by
+// size and format along with the range of passes that use them; the planner then assigns
+// requests to pooled slots so that requests whose pass ranges don't overlap share a target.
+// Slots that go unused for a number of frames are freed.
+//
+// The planner and pool have no Windows dependencies: textures come from a factory type, so
+// RenderTargetPool.h plugs in DX::RenderTexture and tools can plug in a mock device.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace DX
+{
+    struct TargetDesc
+    {
+        uint32_t    width;
+        uint32_t    height;
+        uint32_t    format;         // DXGI_FORMAT
+        uint32_t    bytesPerTexel;  // For memory statistics only
+
+        bool Matches(const TargetDesc& other) const noexcept
+        {
+            return width == other.width && height == other.height && format == other.format;
+        }
+
+        uint64_t GetBytes() const noexcept
+        {
+            return uint64_t(width) * height * bytesPerTexel;
+        }
+    };
+
+    class TransientTargetPlanner
+    {
+    public:
+        static constexpr uint32_t DefaultMaxIdleFrames = 3;
+
+        explicit TransientTargetPlanner(uint32_t maxIdleFrames = DefaultMaxIdleFrames) noexcept :
+            m_maxIdleFrames(maxIdleFrames),
+            m_frame(0),
+            m_planned(false)
+        {
+        }
+
+        TransientTargetPlanner(TransientTargetPlanner&&) = default;
+        TransientTargetPlanner& operator= (TransientTargetPlanner&&) = default;
+
+        TransientTargetPlanner(TransientTargetPlanner const&) = delete;
+        TransientTargetPlanner& operator= (TransientTargetPlanner const&) = delete;
+
+        void BeginFrame() noexcept
+        {
+            ++m_frame;
+            m_requests.clear();
+            m_planned = false;
+        }
+
+        // Declares a target written or read by passes firstPass through lastPass of this
+        // frame. Returns the request index to pass to GetSlot after Plan.
+        uint32_t Request(const TargetDesc& desc, uint32_t firstPass, uint32_t lastPass)
+        {
+            if (!desc.width || !desc.height || firstPass > lastPass)
+                throw std::invalid_argument("Request");
+
+            if (m_planned)
+                throw std::logic_error("Request after Plan");
+
+            m_requests.push_back(PendingRequest{ desc, firstPass, lastPass, 0 });
+            return uint32_t(m_requests.size() - 1);
+        }
+
+        // Assigns every request to a slot, then frees slots idle for more than the limit.
+        // Requests are placed in order of their first pass into the lowest numbered free slot
+        // of the same size and format, which keeps assignments stable from frame to frame
+        // and needs no more slots per size and format than the peak number of overlapping
+        // requests.
+        void Plan()
+        {
+            m_order.resize(m_requests.size());
+            for (uint32_t i = 0; i < m_order.size(); ++i)
+            {
+                m_order[i] = i;
+            }
+
+            std::stable_sort(m_order.begin(), m_order.end(), [this](uint32_t a, uint32_t b)
+            {
+                return m_requests[a].firstPass < m_requests[b].firstPass;
+            });
+
+            for (auto& slot : m_slots)
+            {
+                slot.busy = false;
+            }
+
+            for (const uint32_t index : m_order)
+            {
+                auto& request = m_requests[index];
+                request.slot = FindSlot(request);
+
+                auto& slot = m_slots[request.slot];
+                slot.busy = true;
+                slot.busyUntil = request.lastPass;
+                slot.lastUsedFrame = m_frame;
+            }
+
+            for (auto& slot : m_slots)
+            {
+                if (slot.live && m_frame - slot.lastUsedFrame > m_maxIdleFrames)
+                {
+                    slot.live = false;
+                }
+            }
+
+            m_planned = true;
+        }
+
+        // Drops all slots, for example when the device is lost or the window is resized.
+        void Clear() noexcept
+        {
+            m_slots.clear();
+            m_requests.clear();
+            m_planned = false;
+        }
+
+        uint32_t GetSlot(uint32_t request) const
+        {
+            if (!m_planned || request >= m_requests.size())
+                throw std::out_of_range("GetSlot");
+
+            return m_requests[request].slot;
+        }
+
+        size_t GetSlotCount() const noexcept { return m_slots.size(); }
+        bool IsSlotLive(size_t slot) const noexcept { return m_slots[slot].live; }
+        const TargetDesc& GetSlotDesc(size_t slot) const noexcept { return m_slots[slot].desc; }
+
+        size_t GetRequestCount() const noexcept { return m_requests.size(); }
+        uint64_t GetFrame() const noexcept { return m_frame; }
+
+        // Memory the requests of this frame would take without aliasing.
+        uint64_t GetRequestedBytes() const noexcept
+        {
+            uint64_t bytes = 0;
+            for (const auto& request : m_requests)
+            {
+                bytes += request.desc.GetBytes();
+            }
+            return bytes;
+        }
+
+        // Memory held by live slots, including idle ones not yet freed.
+        uint64_t GetAllocatedBytes() const noexcept
+        {
+            uint64_t bytes = 0;
+            for (const auto& slot : m_slots)
+            {
+                if (slot.live)
+                {
+                    bytes += slot.desc.GetBytes();
+                }
+            }
+            return bytes;
+        }
+
+        size_t GetLiveSlotCount() const noexcept
+        {
+            return size_t(std::count_if(m_slots.cbegin(), m_slots.cend(), [](const Slot& slot) { return slot.live; }));
+        }
+
+    private:
+        struct PendingRequest
+        {
+            TargetDesc  desc;
+            uint32_t    firstPass;
+            uint32_t    lastPass;
+            uint32_t    slot;
+        };
+
+        struct Slot
+        {
+            TargetDesc  desc;
+            uint64_t    lastUsedFrame;
+            uint32_t    busyUntil;
+            bool        busy;
+            bool        live;
+        };
+
+        uint32_t FindSlot(const PendingRequest& request)
+        {
+            uint32_t freeIndex = UINT32_MAX;
+
+            for (uint32_t i = 0; i < m_slots.size(); ++i)
+            {
+                const auto& slot = m_slots[i];
+                if (slot.live)
+                {
+                    if (slot.desc.Matches(request.desc) && (!slot.busy || slot.busyUntil < request.firstPass))
+                        return i;
+                }
+                else if (freeIndex == UINT32_MAX)
+                {
+                    freeIndex = i;
+                }
+            }
+
+            const Slot slot = { request.desc, m_frame, 0, false, true };
+            if (freeIndex != UINT32_MAX)
+            {
+                m_slots[freeIndex] = slot;
+                return freeIndex;
+            }
+
+            m_slots.push_back(slot);
+            return uint32_t(m_slots.size() - 1);
+        }
+
+        uint32_t                    m_maxIdleFrames;
+        uint64_t                    m_frame;
+        bool                        m_planned;
+        std::vector<PendingRequest> m_requests;
+        std::vector<uint32_t>       m_order;
+        std::vector<Slot>           m_slots;
+    };
+
+    // Owns a texture per live planner slot. Factory provides a Texture type and
+    // std::unique_ptr<Texture> CreateTarget(const TargetDesc&).
+    template<typename Factory>
+    class TransientTargetPool
+    {
+    public:
+        using Texture = typename Factory::Texture;
+
+        explicit TransientTargetPool(uint32_t maxIdleFrames = TransientTargetPlanner::DefaultMaxIdleFrames, Factory factory = Factory()) :
+            m_planner(maxIdleFrames),
+            m_factory(std::move(factory))
+        {
+        }
+
+        TransientTargetPool(TransientTargetPool&&) = default;
+        TransientTargetPool& operator= (TransientTargetPool&&) = default;
+
+        TransientTargetPool(TransientTargetPool const&) = delete;
+        TransientTargetPool& operator= (TransientTargetPool const&) = delete;
+
+        void BeginFrame() noexcept { m_planner.BeginFrame(); }
+
+        uint32_t Request(const TargetDesc& desc, uint32_t firstPass, uint32_t lastPass)
+        {
+            return m_planner.Request(desc, firstPass, lastPass);
+        }
+
+        // Plans the frame, then creates textures for new slots and releases freed ones.
+        void Plan()
+        {
+            m_planner.Plan();
+
+            const size_t count = m_planner.GetSlotCount();
+            m_textures.resize(count);
+            m_descs.resize(count);
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (!m_planner.IsSlotLive(i))
+                {
+                    m_textures[i].reset();
+                }
+                else if (!m_textures[i] || !m_descs[i].Matches(m_planner.GetSlotDesc(i)))
+                {
+                    m_descs[i] = m_planner.GetSlotDesc(i);
+                    m_textures[i] = m_factory.CreateTarget(m_descs[i]);
+                }
+            }
+        }
+
+        Texture* Get(uint32_t request) const
+        {
+            return m_textures[m_planner.GetSlot(request)].get();
+        }
+
+        void Clear() noexcept
+        {
+            m_planner.Clear();
+            m_textures.clear();
+            m_descs.clear();
+        }
+
+        const TransientTargetPlanner& GetPlanner() const noexcept { return m_planner; }
+        Factory& GetFactory() noexcept { return m_factory; }
+
+    private:
+        TransientTargetPlanner                  m_planner;
+        Factory                                 m_factory;
+        std::vector<std::unique_ptr<Texture>>   m_textures;
+        std::vector<TargetDesc>                 m_descs;
+    };
+}
@@ -23,7 +23,9 @@ namespace
 }
 #endif
 
-Game::Game() noexcept(false)
+Game::Game() noexcept(false) :
+    m_frameSampleCount{},
+    m_frameTimer(0)
 {
 #ifdef MSAA
     m_deviceResources = std::make_unique<DX::DeviceResources>(DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_FORMAT_UNKNOWN);
@@ -37,6 +39,8 @@ Game::Game() noexcept(false)
         m_deviceResources->GetBackBufferFormat(),
         DXGI_FORMAT_D32_FLOAT,
         MSAA_COUNT);
+
+    m_msaaPolicy = DX::MSAAPolicy(MSAA_COUNT);
 #endif
 }
 
@@ -105,10 +109,18 @@ void Game::Render()
         return;
     }
 
+    auto context = m_deviceResources->GetD3DDeviceContext();
+
+#if defined(MSAA) && defined(MSAA_HELPER)
+    UpdateMSAA();
+
+    context->Begin(m_frameDisjoint[m_frameTimer].Get());
+    context->End(m_frameBegin[m_frameTimer].Get());
+#endif
+
     Clear();
 
     m_deviceResources->PIXBeginEvent(L"Render");
-    auto context = m_deviceResources->GetD3DDeviceContext();
 
     // TODO: Add your rendering code here.
 #if 0
@@ -212,7 +224,10 @@ void Game::Render()
 
 #ifdef MSAA
 #ifdef MSAA_HELPER
-    m_msaaHelper->Resolve(context, m_deviceResources->GetRenderTarget());
+    if (m_msaaHelper)
+    {
+        m_msaaHelper->Resolve(context, m_deviceResources->GetRenderTarget());
+    }
 #else
     context->ResolveSubresource(m_deviceResources->GetRenderTarget(), 0,
         m_offscreenRenderTarget.Get(), 0,
@@ -222,6 +237,13 @@ void Game::Render()
 
     m_deviceResources->PIXEndEvent();
 
+#if defined(MSAA) && defined(MSAA_HELPER)
+    context->End(m_frameEnd[m_frameTimer].Get());
+    context->End(m_frameDisjoint[m_frameTimer].Get());
+    m_frameSampleCount[m_frameTimer] = m_msaaHelper ? m_msaaHelper->GetSampleCount() : 1;
+    m_frameTimer = (m_frameTimer + 1) % c_timerLatency;
+#endif
+
     // Show the new frame.
     m_deviceResources->Present();
 }
@@ -236,8 +258,8 @@ void Game::Clear()
 
 #ifdef MSAA
 #ifdef MSAA_HELPER
-    auto renderTarget = m_msaaHelper->GetMSAARenderTargetView();
-    auto depthStencil = m_msaaHelper->GetMSAADepthStencilView();
+    auto renderTarget = m_msaaHelper ? m_msaaHelper->GetMSAARenderTargetView() : m_deviceResources->GetRenderTargetView();
+    auto depthStencil = m_msaaHelper ? m_msaaHelper->GetMSAADepthStencilView() : m_deviceResources->GetDepthStencilView();
 #else
     auto renderTarget = m_offscreenRenderTargetSRV.Get();
     auto depthStencil = m_depthStencilSRV.Get();
@@ -248,7 +270,10 @@ void Game::Clear()
 #endif
 
     context->ClearRenderTargetView(renderTarget, Colors::CornflowerBlue);
-    context->ClearDepthStencilView(depthStencil, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+    if (depthStencil)
+    {
+        context->ClearDepthStencilView(depthStencil, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+    }
     context->OMSetRenderTargets(1, &renderTarget, depthStencil);
 
     // Set the viewport.
@@ -257,6 +282,74 @@ void Game::Clear()
 
     m_deviceResources->PIXEndEvent();
 }
+
+#if defined(MSAA) && defined(MSAA_HELPER)
+// Swaps in targets that finished creating, feeds the GPU time of the oldest timed frame to
+// the policy, and starts creating targets when the policy picks a new sample count.
+void Game::UpdateMSAA()
+{
+    const unsigned int active = m_msaaHelper ? m_msaaHelper->GetSampleCount() : 1;
+
+    if (m_pendingMSAA.valid()
+        && m_pendingMSAA.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        m_msaaHelper = m_pendingMSAA.get();
+        if (m_msaaHelper)
+        {
+            // The window may have been resized while the targets were created.
+            m_msaaHelper->SetWindow(m_deviceResources->GetOutputSize());
+        }
+
+        char buff[128] = {};
+        sprintf_s(buff, "MSAA: %ux -> %ux (GPU frame average %.2f ms)\n",
+            active, m_msaaHelper ? m_msaaHelper->GetSampleCount() : 1u,
+            m_msaaPolicy.GetAverageFrameTime() * 1000.0);
+        OutputDebugStringA(buff);
+        return;
+    }
+
+    if (m_frameSampleCount[m_frameTimer])
+    {
+        auto context = m_deviceResources->GetD3DDeviceContext();
+
+        D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint = {};
+        UINT64 begin = 0;
+        UINT64 end = 0;
+        if (context->GetData(m_frameDisjoint[m_frameTimer].Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK
+            && context->GetData(m_frameBegin[m_frameTimer].Get(), &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK
+            && context->GetData(m_frameEnd[m_frameTimer].Get(), &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK)
+        {
+            if (!disjoint.Disjoint && end > begin && disjoint.Frequency)
+            {
+                m_msaaPolicy.Update(double(end - begin) / double(disjoint.Frequency), m_frameSampleCount[m_frameTimer]);
+            }
+        }
+
+        // Results not ready yet are dropped; this frame's queries reuse the slot.
+        m_frameSampleCount[m_frameTimer] = 0;
+    }
+
+    const unsigned int sampleCount = m_msaaPolicy.GetSampleCount();
+    if (sampleCount == active || m_pendingMSAA.valid())
+        return;
+
+    ComPtr<ID3D11Device> device = m_deviceResources->GetD3DDevice();
+    const auto backBufferFormat = m_deviceResources->GetBackBufferFormat();
+    const auto size = m_deviceResources->GetOutputSize();
+
+    m_pendingMSAA = std::async(std::launch::async, [device, backBufferFormat, size, sampleCount]()
+    {
+        std::unique_ptr<DX::MSAAHelper> helper;
+        if (sampleCount > 1)
+        {
+            helper = std::make_unique<DX::MSAAHelper>(backBufferFormat, DXGI_FORMAT_D32_FLOAT, sampleCount);
+            helper->SetDevice(device.Get());
+            helper->SetWindow(size);
+        }
+        return helper;
+    });
+}
+#endif
 #pragma endregion
 
 #pragma region Message Handlers
@@ -378,7 +471,35 @@ void Game::CreateDeviceDependentResources()
 #endif
 
 #if defined(MSAA) && defined(MSAA_HELPER)
-    m_msaaHelper->SetDevice(device);
+    if (m_msaaHelper)
+    {
+        m_msaaHelper->SetDevice(device);
+    }
+
+    // The policy never picks a count above the first unsupported one.
+    unsigned int maxSampleCount = 1;
+    for (unsigned int count = 2; count <= 8; count *= 2)
+    {
+        UINT colorLevels = 0;
+        UINT depthLevels = 0;
+        if (FAILED(device->CheckMultisampleQualityLevels(m_deviceResources->GetBackBufferFormat(), count, &colorLevels))
+            || FAILED(device->CheckMultisampleQualityLevels(DXGI_FORMAT_D32_FLOAT, count, &depthLevels))
+            || !colorLevels || !depthLevels)
+            break;
+
+        maxSampleCount = count;
+    }
+    m_msaaPolicy.SetMaxSampleCount(maxSampleCount);
+
+    const CD3D11_QUERY_DESC disjointDesc(D3D11_QUERY_TIMESTAMP_DISJOINT);
+    const CD3D11_QUERY_DESC timestampDesc(D3D11_QUERY_TIMESTAMP);
+    for (size_t j = 0; j < c_timerLatency; ++j)
+    {
+        DX::ThrowIfFailed(device->CreateQuery(&disjointDesc, m_frameDisjoint[j].ReleaseAndGetAddressOf()));
+        DX::ThrowIfFailed(device->CreateQuery(&timestampDesc, m_frameBegin[j].ReleaseAndGetAddressOf()));
+        DX::ThrowIfFailed(device->CreateQuery(&timestampDesc, m_frameEnd[j].ReleaseAndGetAddressOf()));
+        m_frameSampleCount[j] = 0;
+    }
 #endif
 }
 
@@ -406,7 +527,10 @@ void Game::CreateWindowSizeDependentResources()
 
 #ifdef MSAA
 #ifdef MSAA_HELPER
-    m_msaaHelper->SetWindow(size);
+    if (m_msaaHelper)
+    {
+        m_msaaHelper->SetWindow(size);
+    }
 #else
     auto device = m_deviceResources->GetD3DDevice();
     auto width = static_cast<UINT>(size.right);
@@ -459,7 +583,25 @@ void Game::OnDeviceLost()
     m_normalMap.Reset();
 
 #if defined(MSAA) && defined(MSAA_HELPER)
-    m_msaaHelper->ReleaseDevice();
+    // Targets still being created belong to the lost device.
+    if (m_pendingMSAA.valid())
+    {
+        m_pendingMSAA.wait();
+        m_pendingMSAA = {};
+    }
+
+    if (m_msaaHelper)
+    {
+        m_msaaHelper->ReleaseDevice();
+    }
+
+    for (size_t j = 0; j < c_timerLatency; ++j)
+    {
+        m_frameDisjoint[j].Reset();
+        m_frameBegin[j].Reset();
+        m_frameEnd[j].Reset();
+        m_frameSampleCount[j] = 0;
+    }
 #else
     m_offscreenRenderTarget.Reset();
     m_offscreenRenderTargetSRV.Reset();
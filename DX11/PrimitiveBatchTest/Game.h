@@ -7,6 +7,7 @@
 #include "DeviceResources.h"
 #include "StepTimer.h"
 #include "MSAAHelper.h"
+#include "MSAAPolicy.h"
 
 
 // A basic game implementation that creates a D3D11 device and
@@ -51,6 +52,7 @@ private:
     void Render();
 
     void Clear();
+    void UpdateMSAA();
 
     void CreateDeviceDependentResources();
     void CreateWindowSizeDependentResources();
@@ -95,4 +97,18 @@ private:
     Microsoft::WRL::ComPtr<ID3D11DepthStencilView>  m_depthStencilSRV;
 
     std::unique_ptr<DX::MSAAHelper> m_msaaHelper;
+
+    // Adaptive MSAA: GPU frame times pick the sample count, and the targets for a new count
+    // are created on a worker thread and swapped in at the start of a frame. At 1x there is
+    // no helper and the scene renders to the back buffer.
+    static constexpr size_t c_timerLatency = 3;
+
+    Microsoft::WRL::ComPtr<ID3D11Query>             m_frameDisjoint[c_timerLatency];
+    Microsoft::WRL::ComPtr<ID3D11Query>             m_frameBegin[c_timerLatency];
+    Microsoft::WRL::ComPtr<ID3D11Query>             m_frameEnd[c_timerLatency];
+    unsigned int                                    m_frameSampleCount[c_timerLatency];
+    size_t                                          m_frameTimer;
+
+    DX::MSAAPolicy                                  m_msaaPolicy;
+    std::future<std::unique_ptr<DX::MSAAHelper>>    m_pendingMSAA;
 };
\ No newline at end of file
@@ -0,0 +1,265 @@
+//--------------------------------------------------------------------------------------
+// File: MSAAPolicyCheck.cpp
+//
+// Replays frame traces through MSAAPolicy.h. A trace gives the GPU time of each frame at
+// 1x, 2x, 4x and 8x; the replay renders each frame at the active count, switches only
+// after the new targets take a few frames to create, and reports timings two frames late
+// as timestamp queries do. Built-in traces cover light, heavy, phased and noisy load and
+// check the chosen counts and the number of switches. Trace files given on the command
+// line hold one frame per line as four comma-separated millisecond values and are replayed
+// with the switches printed.
+//
+// This is a standalone console tool with no Windows or Direct3D dependencies:
+//
+//   g++ -std=c++14 -O2 -I../../Common -o MSAAPolicyCheck MSAAPolicyCheck.cpp
+//   cl /std:c++14 /O2 /EHsc /I..\..\Common MSAAPolicyCheck.cpp
+//
+//   MSAAPolicyCheck [-verbose] [traces...]
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "MSAAPolicy.h"
+#include "CheckHarness.h"
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    bool g_verbose = false;
+
+    struct Frame
+    {
+        double ms[4];   // 1x, 2x, 4x, 8x
+    };
+
+    using Trace = std::vector<Frame>;
+
+    constexpr size_t CreateLatency = 3;
+    constexpr size_t TimerLatency = 2;
+
+    size_t Level(unsigned int sampleCount)
+    {
+        return (sampleCount == 1) ? 0 : (sampleCount == 2) ? 1 : (sampleCount == 4) ? 2 : 3;
+    }
+
+    struct Result
+    {
+        unsigned int                final;
+        uint32_t                    switches;
+        size_t                      overBudget;
+        std::vector<unsigned int>   counts;     // active count per frame
+    };
+
+    Result Replay(const char* name, const Trace& trace, unsigned int initial, unsigned int maxCount = 8)
+    {
+        MSAAPolicy policy(initial, maxCount);
+
+        unsigned int active = policy.GetSampleCount();
+        unsigned int creating = active;
+        size_t readyFrame = 0;
+
+        std::deque<std::pair<double, unsigned int>> timings;
+        Result result = {};
+
+        for (size_t frame = 0; frame < trace.size(); ++frame)
+        {
+            // Targets created off the critical path become active on a frame boundary.
+            if (creating != active && frame >= readyFrame)
+            {
+                if (g_verbose)
+                {
+                    printf("%s frame %zu: %ux -> %ux (average %.2f ms)\n",
+                        name, frame, active, creating, policy.GetAverageFrameTime() * 1000.0);
+                }
+                active = creating;
+            }
+
+            const double ms = trace[frame].ms[Level(active)];
+            result.counts.push_back(active);
+            result.overBudget += (ms > 1000.0 / 60.0) ? 1 : 0;
+
+            timings.emplace_back(ms / 1000.0, active);
+            if (timings.size() > TimerLatency)
+            {
+                const unsigned int wanted = policy.Update(timings.front().first, timings.front().second);
+                timings.pop_front();
+
+                if (wanted != creating)
+                {
+                    creating = wanted;
+                    readyFrame = frame + CreateLatency;
+                }
+            }
+        }
+
+        result.final = active;
+        result.switches = policy.GetSwitchCount();
+
+        printf("%-10s frames %5zu  final %ux  switches %2u  over budget %zu\n",
+            name, trace.size(), result.final, result.switches, result.overBudget);
+        return result;
+    }
+
+    // Cost at 1x plus the extra for each doubling of samples.
+    Frame MakeFrame(double base, double perLevel)
+    {
+        Frame frame;
+        double ms = base;
+        for (size_t j = 0; j < 4; ++j)
+        {
+            frame.ms[j] = ms;
+            ms *= perLevel;
+        }
+        return frame;
+    }
+
+    Trace Constant(size_t frames, double base, double perLevel)
+    {
+        return Trace(frames, MakeFrame(base, perLevel));
+    }
+
+    void Append(Trace& trace, const Trace& more)
+    {
+        trace.insert(trace.end(), more.begin(), more.end());
+    }
+
+    Trace Noisy(Trace trace, double sigma, unsigned int seed)
+    {
+        std::mt19937 rng(seed);
+        std::normal_distribution<double> noise(1.0, sigma);
+        for (auto& it : trace)
+        {
+            const double scale = std::max(noise(rng), 0.5);
+            for (double& ms : it.ms)
+            {
+                ms *= scale;
+            }
+        }
+        return trace;
+    }
+
+    Trace Load(const char* fileName)
+    {
+        std::ifstream in(fileName);
+        if (!in)
+            throw std::runtime_error(std::string("Failed to open ") + fileName);
+
+        Trace trace;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (line.empty() || line[0] == '#')
+                continue;
+
+            for (char& c : line)
+            {
+                if (c == ',')
+                    c = ' ';
+            }
+
+            std::istringstream fields(line);
+            Frame frame;
+            if (!(fields >> frame.ms[0] >> frame.ms[1] >> frame.ms[2] >> frame.ms[3]))
+                throw std::runtime_error(std::string("Bad line in ") + fileName + ": " + line);
+
+            trace.push_back(frame);
+        }
+
+        return trace;
+    }
+
+    void RunBuiltIn()
+    {
+        // 4 ms at 1x growing 30% per doubling: every level fits, so it climbs to 8x.
+        auto light = Replay("light", Constant(600, 4.0, 1.3), 4);
+        Check(light.final == 8, "Light load does not reach 8x");
+        Check(light.switches == 1, "Light load switches more than needed");
+
+        // 11 ms at 1x: 2x is 13.75 ms and 4x 16.5 ms, over the down threshold.
+        auto heavy = Replay("heavy", Constant(1200, 11.0, 1.25), 4);
+        Check(heavy.final == 2, "Heavy load does not settle at 2x");
+        Check(heavy.switches == 1, "Heavy load flaps between levels");
+
+        // 8x is not supported: light load stops at 4x.
+        auto capped = Replay("capped", Constant(300, 4.0, 1.3), 2, 4);
+        Check(capped.final == 4, "Supported maximum is not respected");
+
+        // Light, then a heavy phase, then light again.
+        Trace phased = Constant(600, 4.0, 1.3);
+        Append(phased, Constant(600, 10.0, 1.3));
+        Append(phased, Constant(900, 4.0, 1.3));
+        auto phases = Replay("phased", phased, 4);
+
+        size_t reaction = 0;
+        while (600 + reaction < phases.counts.size() && phases.counts[600 + reaction] > 2)
+        {
+            ++reaction;
+        }
+        printf("           reached 2x %zu frames into the heavy phase\n", reaction);
+        Check(phases.counts[1199] <= 2, "Heavy phase does not step down to 2x");
+        Check(reaction < 120, "Heavy phase takes too long to step down");
+        Check(phases.final == 8, "Light phase does not return to 8x");
+
+        // Frame times right at the boundary between 2x and 4x with 10% noise.
+        auto noisy = Replay("noisy", Noisy(Constant(3600, 10.5, 1.3), 0.1, 11), 4);
+        Check(noisy.switches <= 4, "Noisy load flaps between levels");
+        Check(noisy.final <= 2, "Noisy load over budget at 4x");
+
+        // Timings from frames at an old count are ignored.
+        MSAAPolicy policy(4);
+        for (int j = 0; j < 200; ++j)
+        {
+            policy.Update(0.030, 8);
+        }
+        Check(policy.GetSampleCount() == 4 && policy.GetSwitchCount() == 0, "Stale timings change the count");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<const char*> files;
+    for (int j = 1; j < argc; ++j)
+    {
+        if (!strcmp(argv[j], "-verbose"))
+        {
+            g_verbose = true;
+        }
+        else if (argv[j][0] == '-')
+        {
+            printf("Usage: MSAAPolicyCheck [-verbose] [traces...]\n");
+            return 1;
+        }
+        else
+        {
+            files.push_back(argv[j]);
+        }
+    }
+
+    return RunChecks([&]()
+    {
+        if (files.empty())
+        {
+            RunBuiltIn();
+        }
+        else
+        {
+            g_verbose = true;
+            for (auto it : files)
+            {
+                Replay(it, Load(it), 4);
+            }
+        }
+    });
+}
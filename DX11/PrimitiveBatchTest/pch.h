@@ -45,6 +45,7 @@
 #include <cstdio>
 #include <cwchar>
 #include <exception>
+#include <future>
 #include <iterator>
 #include <memory>
 #include <stdexcept>
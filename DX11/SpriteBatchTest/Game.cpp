@@ -12,7 +12,8 @@ using namespace DirectX::SimpleMath;
 
 using Microsoft::WRL::ComPtr;
 
-Game::Game() noexcept(false)
+Game::Game() noexcept(false) :
+    m_spriteSort(&m_workerPool)
 {
     m_deviceResources = std::make_unique<DX::DeviceResources>();
     m_deviceResources->RegisterDeviceNotify(this);
@@ -35,6 +36,11 @@ void Game::Initialize(HWND window, int width, int height)
     m_timer.SetFixedTimeStep(true);
     m_timer.SetTargetElapsedSeconds(1.0 / 60);
     */
+
+    // To capture sprite traffic for offline replay with SpriteReplay, call:
+    /*
+    m_recorder->StartCapture(L"SpriteBatchTest.sprs", 60);
+    */
 }
 
 #pragma region Frame Update
@@ -75,17 +81,17 @@ void Game::Render()
     //auto context = m_deviceResources->GetD3DDeviceContext();
 
 #if 1
-    m_spriteBatch->Begin();
+    m_recorder->Begin();
     //m_spriteBatch->Begin( SpriteSortMode_Deferred, m_states->NonPremultiplied() );
     //m_spriteBatch->Begin(SpriteSortMode_Deferred, nullptr, m_states->LinearWrap());
     //m_spriteBatch->Begin(SpriteSortMode_Deferred, m_states->AlphaBlend(), m_states->PointClamp());
 
 #if 1
-    m_spriteBatch->Draw(m_background.Get(), m_fullscreenRect);
+    m_recorder->Draw(m_background.Get(), m_fullscreenRect);
 #endif
 
 
-    m_spriteBatch->Draw(m_texture.Get(), m_screenPos, nullptr, Colors::White, 0.f, m_origin);
+    m_recorder->Draw(m_texture.Get(), m_screenPos, nullptr, Colors::White, 0.f, m_origin);
     //m_spriteBatch->Draw(m_texture.Get(), m_screenPos, nullptr, Colors::White, cosf(time) * 4.f, m_origin);
 
     //float time = float(m_timer.GetTotalSeconds());
@@ -94,6 +100,32 @@ void Game::Render()
     //m_spriteBatch->Draw(m_texture.Get(), m_screenPos, nullptr, Colors::Green, 0.f, m_origin);
     //m_spriteBatch->Draw(m_texture.Get(), m_screenPos, &m_tileRect, Colors::White, 0.f, m_origin);
     //m_spriteBatch->Draw(m_texture.Get(), m_stretchRect, nullptr, Colors::White);
+
+    m_recorder->End();
+
+    // Layered sprites are ordered back to front by SpriteSortStage and submitted in that
+    // order with SpriteSortMode_Deferred, so SpriteBatch::End doesn't sort them again.
+    float time = float(m_timer.GetTotalSeconds());
+
+    const size_t layerCount = m_layerSprites.size();
+    m_sortKeys.resize(layerCount);
+    for (size_t i = 0; i < layerCount; ++i)
+    {
+        LayerSprite& sprite = m_layerSprites[i];
+        sprite.depth = 0.5f + 0.5f * sinf(time + sprite.phase);
+        m_sortKeys[i] = SpriteSortStage::MakeKey(SpriteSortStage::SortOrder_BackToFront, sprite.depth, 0);
+    }
+
+    const uint32_t* order = m_spriteSort.Sort(m_sortKeys.data(), layerCount);
+
+    m_recorder->Begin(SpriteSortMode_Deferred, m_states->NonPremultiplied());
+
+    for (size_t i = 0; i < layerCount; ++i)
+    {
+        const LayerSprite& sprite = m_layerSprites[order[i]];
+        const float scale = 0.25f + 0.5f * (1.f - sprite.depth);
+        m_recorder->Draw(m_texture.Get(), sprite.position, nullptr, sprite.color, 0.f, m_origin, scale, SpriteEffects_None, sprite.depth);
+    }
 #else
     m_spriteBatch->Begin(SpriteSortMode_BackToFront, m_states->NonPremultiplied());
     
@@ -108,7 +140,8 @@ void Game::Render()
     // TODO: Add your rendering code here
 #endif
     
-    m_spriteBatch->End();
+    m_recorder->End();
+    m_recorder->EndFrame();
 
     m_deviceResources->PIXEndEvent();
 
@@ -198,6 +231,7 @@ void Game::CreateDeviceDependentResources()
 
     auto context = m_deviceResources->GetD3DDeviceContext();
     m_spriteBatch = std::make_unique<SpriteBatch>(context);
+    m_recorder = std::make_unique<SpriteRecorder>(m_spriteBatch.get());
 
     ComPtr<ID3D11Resource> resource;
 #if 1
@@ -238,6 +272,21 @@ void Game::CreateWindowSizeDependentResources()
 
     m_fullscreenRect = size;
 
+    // A ring of tinted sprites whose depths cycle over time, drawn by the sorted layer.
+    constexpr size_t layerCount = 24;
+    m_layerSprites.resize(layerCount);
+    for (size_t i = 0; i < layerCount; ++i)
+    {
+        const float angle = XM_2PI * float(i) / float(layerCount);
+
+        LayerSprite& sprite = m_layerSprites[i];
+        sprite.position.x = m_screenPos.x + cosf(angle) * m_screenPos.x * 0.6f;
+        sprite.position.y = m_screenPos.y + sinf(angle) * m_screenPos.y * 0.6f;
+        sprite.color = Color::Lerp(Color(Colors::White), Color(Colors::Orange), float(i & 3) / 3.f);
+        sprite.phase = angle * 2.f;
+        sprite.depth = 0.f;
+    }
+
 #if 0
     m_stretchRect.left = size.right / 4;
     m_stretchRect.top   = size.bottom / 4;
@@ -255,6 +304,7 @@ void Game::OnDeviceLost()
 {
     // TODO: Add Direct3D resource cleanup here.
     m_states.reset();
+    m_recorder.reset();
     m_spriteBatch.reset();
     m_texture.Reset();
     m_background.Reset();
@@ -6,6 +6,8 @@
 
 #include "DeviceResources.h"
 #include "StepTimer.h"
+#include "SpriteRecorder.h"
+#include "SpriteSortStage.h"
 
 
 // A basic game implementation that creates a D3D11 device and
@@ -65,6 +67,7 @@ private:
 
     std::unique_ptr<DirectX::CommonStates>              m_states;
     std::unique_ptr<DirectX::SpriteBatch>               m_spriteBatch;
+    std::unique_ptr<SpriteRecorder>                     m_recorder;
     DirectX::SimpleMath::Vector2                        m_screenPos;
     DirectX::SimpleMath::Vector2                        m_origin;
     
@@ -73,4 +76,17 @@ private:
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_background;
 
     RECT                                                m_stretchRect;
+
+    struct LayerSprite
+    {
+        DirectX::SimpleMath::Vector2    position;
+        DirectX::SimpleMath::Color      color;
+        float                           phase;
+        float                           depth;
+    };
+
+    std::vector<LayerSprite>                            m_layerSprites;
+    std::vector<uint64_t>                               m_sortKeys;
+    DX::WorkerPool                                      m_workerPool;
+    SpriteSortStage                                     m_spriteSort;
 };
\ No newline at end of file
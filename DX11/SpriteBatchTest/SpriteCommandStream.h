@@ -0,0 +1,208 @@
+//--------------------------------------------------------------------------------------
+// File: SpriteCommandStream.h
+//
+// Compact binary format for captured SpriteBatch traffic. Each command holds the same
+// data SpriteBatch keeps per sprite after Draw, so a capture can be replayed through
+// sorting and vertex generation offline. This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+namespace SpriteCapture
+{
+    // Matches the values of DirectX::SpriteSortMode.
+    enum SortMode : uint32_t
+    {
+        SortMode_Deferred = 0,
+        SortMode_Immediate,
+        SortMode_Texture,
+        SortMode_BackToFront,
+        SortMode_FrontToBack,
+    };
+
+    // Matches the SpriteBatch internal flags: the low two bits are DirectX::SpriteEffects.
+    enum CommandFlags : uint32_t
+    {
+        Flags_FlipHorizontally = 0x1,
+        Flags_FlipVertically = 0x2,
+        Flags_SourceInTexels = 0x4,
+        Flags_DestSizeInPixels = 0x8,
+    };
+
+    struct SpriteCommand
+    {
+        float       source[4];              // x, y, w, h in texels, or 0,0,1,1 for the whole texture
+        float       destination[4];         // x, y and either a scale or a size in pixels
+        float       color[4];
+        float       originRotationDepth[4]; // origin x, origin y, rotation, layer depth
+        uint32_t    texture;                // Index into the stream texture table
+        uint32_t    flags;
+    };
+
+    static_assert(sizeof(SpriteCommand) == 72, "SpriteCommand size mismatch");
+
+    struct TextureDesc
+    {
+        uint32_t    width;
+        uint32_t    height;
+    };
+
+    struct BatchDesc
+    {
+        uint32_t    frame;
+        uint32_t    sortMode;
+        uint32_t    firstCommand;
+        uint32_t    commandCount;
+        float       transform[16];          // Row-major transformMatrix passed to Begin
+    };
+
+    class SpriteCommandStream
+    {
+    public:
+        static constexpr uint32_t Magic = 0x53525053; // 'SPRS'
+        static constexpr uint32_t Version = 1;
+
+        SpriteCommandStream() = default;
+
+        SpriteCommandStream(SpriteCommandStream&&) = default;
+        SpriteCommandStream& operator= (SpriteCommandStream&&) = default;
+
+        SpriteCommandStream(SpriteCommandStream const&) = default;
+        SpriteCommandStream& operator= (SpriteCommandStream const&) = default;
+
+        void Clear() noexcept
+        {
+            textures.clear();
+            batches.clear();
+            commands.clear();
+        }
+
+        void Save(std::ostream& out) const
+        {
+            const uint32_t header[4] = { Magic, Version, uint32_t(textures.size()), uint32_t(batches.size()) };
+            out.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+            if (!textures.empty())
+            {
+                out.write(reinterpret_cast<const char*>(textures.data()), std::streamsize(textures.size() * sizeof(TextureDesc)));
+            }
+
+            for (const auto& batch : batches)
+            {
+                const uint32_t batchHeader[4] = { batch.frame, batch.sortMode, batch.commandCount, 0 };
+                out.write(reinterpret_cast<const char*>(batchHeader), sizeof(batchHeader));
+                out.write(reinterpret_cast<const char*>(batch.transform), sizeof(batch.transform));
+
+                if (batch.commandCount)
+                {
+                    out.write(reinterpret_cast<const char*>(&commands[batch.firstCommand]),
+                        std::streamsize(batch.commandCount * sizeof(SpriteCommand)));
+                }
+            }
+
+            if (!out)
+                throw std::runtime_error("SpriteCommandStream failed to write");
+        }
+
+        void Load(std::istream& in)
+        {
+            Clear();
+
+            uint32_t header[4] = {};
+            in.read(reinterpret_cast<char*>(header), sizeof(header));
+            if (!in || header[0] != Magic)
+                throw std::runtime_error("SpriteCommandStream invalid file");
+
+            if (header[1] != Version)
+                throw std::runtime_error("SpriteCommandStream unsupported version");
+
+            // Every count is checked against the bytes left before anything is allocated
+            // for it, so a corrupt header cannot ask for more memory than the file holds.
+            uint64_t remaining = GetRemainingBytes(in);
+
+            const uint64_t textureBytes = uint64_t(header[2]) * sizeof(TextureDesc);
+            if (textureBytes > remaining)
+                throw std::runtime_error("SpriteCommandStream invalid file");
+            remaining -= textureBytes;
+
+            if (uint64_t(header[3]) * BatchHeaderSize > remaining)
+                throw std::runtime_error("SpriteCommandStream invalid file");
+
+            textures.resize(header[2]);
+            if (!textures.empty())
+            {
+                in.read(reinterpret_cast<char*>(textures.data()), std::streamsize(textures.size() * sizeof(TextureDesc)));
+            }
+
+            batches.reserve(header[3]);
+            for (uint32_t j = 0; j < header[3]; ++j)
+            {
+                uint32_t batchHeader[4] = {};
+                in.read(reinterpret_cast<char*>(batchHeader), sizeof(batchHeader));
+
+                BatchDesc batch = { batchHeader[0], batchHeader[1], uint32_t(commands.size()), batchHeader[2], {} };
+                in.read(reinterpret_cast<char*>(batch.transform), sizeof(batch.transform));
+                if (!in)
+                    throw std::runtime_error("SpriteCommandStream truncated file");
+                remaining -= BatchHeaderSize;
+
+                if (batch.sortMode > SortMode_FrontToBack)
+                    throw std::runtime_error("SpriteCommandStream invalid sort mode");
+
+                const uint64_t commandBytes = uint64_t(batch.commandCount) * sizeof(SpriteCommand);
+                if (commandBytes > remaining)
+                    throw std::runtime_error("SpriteCommandStream invalid file");
+                remaining -= commandBytes;
+
+                commands.resize(commands.size() + batch.commandCount);
+                if (batch.commandCount)
+                {
+                    in.read(reinterpret_cast<char*>(&commands[batch.firstCommand]),
+                        std::streamsize(batch.commandCount * sizeof(SpriteCommand)));
+                }
+
+                if (!in)
+                    throw std::runtime_error("SpriteCommandStream truncated file");
+
+                for (uint32_t i = 0; i < batch.commandCount; ++i)
+                {
+                    if (commands[batch.firstCommand + i].texture >= textures.size())
+                        throw std::runtime_error("SpriteCommandStream invalid texture index");
+                }
+
+                batches.push_back(batch);
+            }
+        }
+
+        std::vector<TextureDesc>    textures;
+        std::vector<BatchDesc>      batches;
+        std::vector<SpriteCommand>  commands;
+
+    private:
+        // Four uint32_t and the transform precede the commands of each batch.
+        static constexpr uint64_t BatchHeaderSize = sizeof(uint32_t) * 4 + sizeof(float) * 16;
+
+        static uint64_t GetRemainingBytes(std::istream& in)
+        {
+            const std::streampos current = in.tellg();
+            in.seekg(0, std::ios::end);
+            const std::streampos end = in.tellg();
+            in.seekg(current);
+
+            if (!in || current < 0 || end < current)
+                throw std::runtime_error("SpriteCommandStream invalid file");
+
+            return uint64_t(end - current);
+        }
+    };
+}
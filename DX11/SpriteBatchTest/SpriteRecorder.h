@@ -0,0 +1,245 @@
+//--------------------------------------------------------------------------------------
+// File: SpriteRecorder.h
+//
+// Forwards Begin/Draw/End to a SpriteBatch and, while capturing, records every sprite into
+// a SpriteCommandStream so real frames can be replayed offline (see SpriteReplay).
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#include "SpriteBatch.h"
+#include "SpriteCommandStream.h"
+
+#include <wrl/client.h>
+
+class SpriteRecorder
+{
+public:
+    explicit SpriteRecorder(DirectX::SpriteBatch* batch) :
+        m_batch(batch),
+        m_framesRemaining(0),
+        m_frame(0),
+        m_inBatch(false),
+        m_currentBatch{}
+    {
+        if (!batch)
+            throw std::invalid_argument("SpriteRecorder");
+    }
+
+    SpriteRecorder(SpriteRecorder&&) = default;
+    SpriteRecorder& operator= (SpriteRecorder&&) = default;
+
+    SpriteRecorder(SpriteRecorder const&) = delete;
+    SpriteRecorder& operator= (SpriteRecorder const&) = delete;
+
+    // Captures the next frameCount frames and writes them to fileName on the last EndFrame.
+    void StartCapture(const wchar_t* fileName, uint32_t frameCount)
+    {
+        if (!fileName || !frameCount)
+            throw std::invalid_argument("StartCapture");
+
+        m_fileName = fileName;
+        m_framesRemaining = frameCount;
+        m_frame = 0;
+        m_stream.Clear();
+        m_textures.clear();
+    }
+
+    bool IsCapturing() const noexcept { return m_framesRemaining > 0; }
+
+    void EndFrame()
+    {
+        if (!m_framesRemaining)
+            return;
+
+        ++m_frame;
+        if (--m_framesRemaining == 0)
+        {
+            std::ofstream outFile(m_fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!outFile)
+                throw std::runtime_error("SpriteRecorder failed to create capture file");
+
+            m_stream.Save(outFile);
+            m_stream.Clear();
+            m_textures.clear();
+        }
+    }
+
+    void XM_CALLCONV Begin(DirectX::SpriteSortMode sortMode = DirectX::SpriteSortMode_Deferred,
+        ID3D11BlendState* blendState = nullptr,
+        ID3D11SamplerState* samplerState = nullptr,
+        ID3D11DepthStencilState* depthStencilState = nullptr,
+        ID3D11RasterizerState* rasterizerState = nullptr,
+        std::function<void()> setCustomShaders = nullptr,
+        DirectX::FXMMATRIX transformMatrix = DirectX::XMMatrixIdentity())
+    {
+        m_batch->Begin(sortMode, blendState, samplerState, depthStencilState, rasterizerState, setCustomShaders, transformMatrix);
+
+        if (IsCapturing())
+        {
+            m_inBatch = true;
+            m_currentBatch.frame = m_frame;
+            m_currentBatch.sortMode = uint32_t(sortMode);
+            m_currentBatch.firstCommand = uint32_t(m_stream.commands.size());
+            m_currentBatch.commandCount = 0;
+            DirectX::XMStoreFloat4x4(reinterpret_cast<DirectX::XMFLOAT4X4*>(m_currentBatch.transform), transformMatrix);
+        }
+    }
+
+    void End()
+    {
+        m_batch->End();
+
+        if (m_inBatch)
+        {
+            m_currentBatch.commandCount = uint32_t(m_stream.commands.size()) - m_currentBatch.firstCommand;
+            m_stream.batches.push_back(m_currentBatch);
+            m_inBatch = false;
+        }
+    }
+
+    // Draw overloads specifying position, origin and scale as XMFLOAT2.
+    void XM_CALLCONV Draw(ID3D11ShaderResourceView* texture, DirectX::XMFLOAT2 const& position, DirectX::FXMVECTOR color = DirectX::Colors::White)
+    {
+        m_batch->Draw(texture, position, color);
+        Record(texture, position.x, position.y, 1.f, 1.f, false, nullptr, color, 0.f, DirectX::XMFLOAT2(0, 0), DirectX::SpriteEffects_None, 0.f);
+    }
+
+    void XM_CALLCONV Draw(ID3D11ShaderResourceView* texture, DirectX::XMFLOAT2 const& position, RECT const* sourceRectangle,
+        DirectX::FXMVECTOR color = DirectX::Colors::White, float rotation = 0, DirectX::XMFLOAT2 const& origin = DirectX::XMFLOAT2(0, 0),
+        float scale = 1, DirectX::SpriteEffects effects = DirectX::SpriteEffects_None, float layerDepth = 0)
+    {
+        m_batch->Draw(texture, position, sourceRectangle, color, rotation, origin, scale, effects, layerDepth);
+        Record(texture, position.x, position.y, scale, scale, false, sourceRectangle, color, rotation, origin, effects, layerDepth);
+    }
+
+    void XM_CALLCONV Draw(ID3D11ShaderResourceView* texture, DirectX::XMFLOAT2 const& position, RECT const* sourceRectangle,
+        DirectX::FXMVECTOR color, float rotation, DirectX::XMFLOAT2 const& origin, DirectX::XMFLOAT2 const& scale,
+        DirectX::SpriteEffects effects = DirectX::SpriteEffects_None, float layerDepth = 0)
+    {
+        m_batch->Draw(texture, position, sourceRectangle, color, rotation, origin, scale, effects, layerDepth);
+        Record(texture, position.x, position.y, scale.x, scale.y, false, sourceRectangle, color, rotation, origin, effects, layerDepth);
+    }
+
+    // Draw overloads specifying position as a RECT.
+    void XM_CALLCONV Draw(ID3D11ShaderResourceView* texture, RECT const& destinationRectangle, DirectX::FXMVECTOR color = DirectX::Colors::White)
+    {
+        m_batch->Draw(texture, destinationRectangle, color);
+        RecordRect(texture, destinationRectangle, nullptr, color, 0.f, DirectX::XMFLOAT2(0, 0), DirectX::SpriteEffects_None, 0.f);
+    }
+
+    void XM_CALLCONV Draw(ID3D11ShaderResourceView* texture, RECT const& destinationRectangle, RECT const* sourceRectangle,
+        DirectX::FXMVECTOR color = DirectX::Colors::White, float rotation = 0, DirectX::XMFLOAT2 const& origin = DirectX::XMFLOAT2(0, 0),
+        DirectX::SpriteEffects effects = DirectX::SpriteEffects_None, float layerDepth = 0)
+    {
+        m_batch->Draw(texture, destinationRectangle, sourceRectangle, color, rotation, origin, effects, layerDepth);
+        RecordRect(texture, destinationRectangle, sourceRectangle, color, rotation, origin, effects, layerDepth);
+    }
+
+    DirectX::SpriteBatch* GetSpriteBatch() const noexcept { return m_batch; }
+
+private:
+    void XM_CALLCONV RecordRect(ID3D11ShaderResourceView* texture, RECT const& dest, RECT const* sourceRectangle,
+        DirectX::FXMVECTOR color, float rotation, DirectX::XMFLOAT2 const& origin, DirectX::SpriteEffects effects, float layerDepth)
+    {
+        Record(texture, float(dest.left), float(dest.top), float(dest.right - dest.left), float(dest.bottom - dest.top),
+            true, sourceRectangle, color, rotation, origin, effects, layerDepth);
+    }
+
+    // Mirrors the normalization SpriteBatch::Draw applies before queuing a sprite.
+    void XM_CALLCONV Record(ID3D11ShaderResourceView* texture, float x, float y, float w, float h, bool destSizeInPixels,
+        RECT const* sourceRectangle, DirectX::FXMVECTOR color, float rotation, DirectX::XMFLOAT2 const& origin,
+        DirectX::SpriteEffects effects, float layerDepth)
+    {
+        using namespace SpriteCapture;
+
+        if (!m_inBatch)
+            return;
+
+        SpriteCommand cmd = {};
+        cmd.texture = GetTextureIndex(texture);
+        cmd.flags = uint32_t(effects) | (destSizeInPixels ? Flags_DestSizeInPixels : 0u);
+
+        cmd.destination[0] = x;
+        cmd.destination[1] = y;
+        cmd.destination[2] = w;
+        cmd.destination[3] = h;
+
+        if (sourceRectangle)
+        {
+            cmd.source[0] = float(sourceRectangle->left);
+            cmd.source[1] = float(sourceRectangle->top);
+            cmd.source[2] = float(sourceRectangle->right - sourceRectangle->left);
+            cmd.source[3] = float(sourceRectangle->bottom - sourceRectangle->top);
+
+            if (!destSizeInPixels)
+            {
+                cmd.destination[2] *= cmd.source[2];
+                cmd.destination[3] *= cmd.source[3];
+            }
+
+            cmd.flags |= Flags_SourceInTexels | Flags_DestSizeInPixels;
+        }
+        else
+        {
+            cmd.source[2] = cmd.source[3] = 1.f;
+        }
+
+        DirectX::XMStoreFloat4(reinterpret_cast<DirectX::XMFLOAT4*>(cmd.color), color);
+
+        cmd.originRotationDepth[0] = origin.x;
+        cmd.originRotationDepth[1] = origin.y;
+        cmd.originRotationDepth[2] = rotation;
+        cmd.originRotationDepth[3] = layerDepth;
+
+        m_stream.commands.push_back(cmd);
+    }
+
+    uint32_t GetTextureIndex(ID3D11ShaderResourceView* texture)
+    {
+        auto it = m_textures.find(texture);
+        if (it != m_textures.cend())
+            return it->second;
+
+        SpriteCapture::TextureDesc desc = {};
+        if (texture)
+        {
+            Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+            texture->GetResource(resource.GetAddressOf());
+
+            Microsoft::WRL::ComPtr<ID3D11Texture2D> tex2D;
+            if (SUCCEEDED(resource.As(&tex2D)))
+            {
+                D3D11_TEXTURE2D_DESC texDesc;
+                tex2D->GetDesc(&texDesc);
+
+                desc.width = texDesc.Width;
+                desc.height = texDesc.Height;
+            }
+        }
+
+        const auto index = uint32_t(m_stream.textures.size());
+        m_stream.textures.push_back(desc);
+        m_textures[texture] = index;
+        return index;
+    }
+
+    DirectX::SpriteBatch*                               m_batch;
+    uint32_t                                            m_framesRemaining;
+    uint32_t                                            m_frame;
+    bool                                                m_inBatch;
+    SpriteCapture::BatchDesc                            m_currentBatch;
+    std::wstring                                        m_fileName;
+    std::map<ID3D11ShaderResourceView*, uint32_t>       m_textures;
+    SpriteCapture::SpriteCommandStream                  m_stream;
+};
@@ -0,0 +1,421 @@
+//--------------------------------------------------------------------------------------
+// File: SpriteReplay.cpp
+//
+// Headless replayer for SpriteRecorder captures. Runs each captured batch through the
+// same sorting and vertex generation that SpriteBatch performs on the CPU and reports
+// timings, so changes to sort and batching can be measured against real workloads.
+// Sorted batches are also run through SpriteSortStage for comparison.
+//
+// This is a standalone console tool with no Windows or Direct3D dependencies:
+//
+//   g++ -std=c++14 -O2 -pthread -I../../Common -o SpriteReplay SpriteReplay.cpp
+//   cl /std:c++14 /O2 /EHsc /I..\..\Common SpriteReplay.cpp
+//
+//   SpriteReplay <capture file> [iterations]
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "../SpriteCommandStream.h"
+#include "../SpriteSortStage.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <vector>
+
+using namespace SpriteCapture;
+
+namespace
+{
+    // Matches SpriteBatch::MaxBatchSize.
+    constexpr size_t MaxBatchSize = 2048;
+
+    struct VertexPositionColorTexture
+    {
+        float position[3];
+        float color[4];
+        float textureCoordinate[2];
+    };
+
+    struct ReplayStats
+    {
+        size_t sprites;
+        size_t drawCalls;
+        double sortSeconds;
+        double vertexSeconds;
+    };
+
+    // Same ordering rules as SpriteBatch::Impl::SortSprites.
+    void SortSprites(uint32_t sortMode, std::vector<const SpriteCommand*>& sorted)
+    {
+        switch (sortMode)
+        {
+        case SortMode_Texture:
+            std::sort(sorted.begin(), sorted.end(), [](const SpriteCommand* x, const SpriteCommand* y) noexcept
+            {
+                return x->texture < y->texture;
+            });
+            break;
+
+        case SortMode_BackToFront:
+            std::sort(sorted.begin(), sorted.end(), [](const SpriteCommand* x, const SpriteCommand* y) noexcept
+            {
+                return x->originRotationDepth[3] > y->originRotationDepth[3];
+            });
+            break;
+
+        case SortMode_FrontToBack:
+            std::sort(sorted.begin(), sorted.end(), [](const SpriteCommand* x, const SpriteCommand* y) noexcept
+            {
+                return x->originRotationDepth[3] < y->originRotationDepth[3];
+            });
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    bool IsSortedMode(uint32_t sortMode) noexcept
+    {
+        return sortMode == SortMode_Texture || sortMode == SortMode_BackToFront || sortMode == SortMode_FrontToBack;
+    }
+
+    void RadixSortSprites(uint32_t sortMode, const SpriteCommand* commands, size_t count,
+        SpriteSortStage& sorter, std::vector<uint64_t>& keys, std::vector<const SpriteCommand*>& sorted)
+    {
+        SpriteSortStage::SortOrder order;
+        switch (sortMode)
+        {
+        case SortMode_BackToFront:  order = SpriteSortStage::SortOrder_BackToFront; break;
+        case SortMode_FrontToBack:  order = SpriteSortStage::SortOrder_FrontToBack; break;
+        default:                    order = SpriteSortStage::SortOrder_Texture; break;
+        }
+
+        keys.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            keys[i] = SpriteSortStage::MakeKey(order, commands[i].originRotationDepth[3], commands[i].texture);
+        }
+
+        const uint32_t* permutation = sorter.Sort(keys.data(), count);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            sorted[i] = &commands[permutation[i]];
+        }
+    }
+
+    // Checks the primary ordering SpriteBatch guarantees for the sort mode.
+    bool ValidateOrder(uint32_t sortMode, const std::vector<const SpriteCommand*>& sorted) noexcept
+    {
+        for (size_t i = 1; i < sorted.size(); ++i)
+        {
+            const SpriteCommand* x = sorted[i - 1];
+            const SpriteCommand* y = sorted[i];
+
+            switch (sortMode)
+            {
+            case SortMode_BackToFront:
+                if (x->originRotationDepth[3] < y->originRotationDepth[3])
+                    return false;
+                break;
+
+            case SortMode_FrontToBack:
+                if (x->originRotationDepth[3] > y->originRotationDepth[3])
+                    return false;
+                break;
+
+            case SortMode_Texture:
+                // Each texture must appear as a single contiguous run.
+                if (x->texture > y->texture)
+                    return false;
+                break;
+
+            default:
+                break;
+            }
+        }
+
+        return true;
+    }
+
+    // Same math as SpriteBatch::Impl::RenderSprite.
+    void RenderSprite(const SpriteCommand& sprite, const TextureDesc& texture, VertexPositionColorTexture* vertices) noexcept
+    {
+        static const float cornerOffsets[4][2] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } };
+
+        const float textureSize[2] = { float(texture.width), float(texture.height) };
+        const float inverseTextureSize[2] =
+        {
+            texture.width ? 1.f / textureSize[0] : 0.f,
+            texture.height ? 1.f / textureSize[1] : 0.f
+        };
+
+        float source[2] = { sprite.source[0], sprite.source[1] };
+        float sourceSize[2] = { sprite.source[2], sprite.source[3] };
+        float destinationSize[2] = { sprite.destination[2], sprite.destination[3] };
+
+        // Scale the origin offset by source size, taking care to avoid overflow if the source region is zero.
+        float origin[2] =
+        {
+            sprite.originRotationDepth[0] / ((sourceSize[0] != 0.f) ? sourceSize[0] : 1.192092896e-7f),
+            sprite.originRotationDepth[1] / ((sourceSize[1] != 0.f) ? sourceSize[1] : 1.192092896e-7f)
+        };
+
+        // Convert the source region from texels to mod-1 texture coordinate format.
+        if (sprite.flags & Flags_SourceInTexels)
+        {
+            for (size_t j = 0; j < 2; ++j)
+            {
+                source[j] *= inverseTextureSize[j];
+                sourceSize[j] *= inverseTextureSize[j];
+            }
+        }
+        else
+        {
+            origin[0] *= inverseTextureSize[0];
+            origin[1] *= inverseTextureSize[1];
+        }
+
+        // If the destination size is relative to the source region, convert it to pixels.
+        if (!(sprite.flags & Flags_DestSizeInPixels))
+        {
+            destinationSize[0] *= textureSize[0];
+            destinationSize[1] *= textureSize[1];
+        }
+
+        // Compute a 2x2 rotation matrix.
+        float rotationMatrix1[2] = { 1, 0 };
+        float rotationMatrix2[2] = { 0, 1 };
+
+        const float rotation = sprite.originRotationDepth[2];
+        if (rotation != 0.f)
+        {
+            const float sinV = sinf(rotation);
+            const float cosV = cosf(rotation);
+
+            rotationMatrix1[0] = cosV;
+            rotationMatrix1[1] = sinV;
+            rotationMatrix2[0] = -sinV;
+            rotationMatrix2[1] = cosV;
+        }
+
+        // The mirror bits flip the texture coordinates.
+        const unsigned int mirrorBits = sprite.flags & 3u;
+
+        for (size_t i = 0; i < 4; ++i)
+        {
+            const float cornerX = (cornerOffsets[i][0] - origin[0]) * destinationSize[0];
+            const float cornerY = (cornerOffsets[i][1] - origin[1]) * destinationSize[1];
+
+            VertexPositionColorTexture& v = vertices[i];
+            v.position[0] = sprite.destination[0] + cornerX * rotationMatrix1[0] + cornerY * rotationMatrix2[0];
+            v.position[1] = sprite.destination[1] + cornerX * rotationMatrix1[1] + cornerY * rotationMatrix2[1];
+            v.position[2] = sprite.originRotationDepth[3];
+
+            v.color[0] = sprite.color[0];
+            v.color[1] = sprite.color[1];
+            v.color[2] = sprite.color[2];
+            v.color[3] = sprite.color[3];
+
+            const float* texCorner = cornerOffsets[i ^ mirrorBits];
+            v.textureCoordinate[0] = texCorner[0] * sourceSize[0] + source[0];
+            v.textureCoordinate[1] = texCorner[1] * sourceSize[1] + source[1];
+        }
+    }
+
+    struct ReplayContext
+    {
+        ReplayContext() : sorter(&pool) {}
+
+        DX::WorkerPool                              pool;
+        SpriteSortStage                             sorter;
+        std::vector<uint64_t>                       keys;
+        std::vector<const SpriteCommand*>           sorted;
+        std::vector<VertexPositionColorTexture>     vertices;
+    };
+
+    ReplayStats ReplayBatch(const SpriteCommandStream& stream, const BatchDesc& batch, bool radix, ReplayContext& context)
+    {
+        auto& sorted = context.sorted;
+        auto& vertices = context.vertices;
+
+        using clock = std::chrono::high_resolution_clock;
+
+        ReplayStats stats = {};
+        stats.sprites = batch.commandCount;
+
+        const SpriteCommand* commands = stream.commands.data() + batch.firstCommand;
+
+        auto t0 = clock::now();
+
+        sorted.resize(batch.commandCount);
+        if (radix && IsSortedMode(batch.sortMode))
+        {
+            RadixSortSprites(batch.sortMode, commands, batch.commandCount, context.sorter, context.keys, sorted);
+        }
+        else
+        {
+            for (size_t i = 0; i < batch.commandCount; ++i)
+            {
+                sorted[i] = &commands[i];
+            }
+
+            SortSprites(batch.sortMode, sorted);
+        }
+
+        auto t1 = clock::now();
+
+        // Walk runs of sprites that share a texture, splitting runs at MaxBatchSize. Immediate
+        // mode issues a draw for every sprite.
+        vertices.resize(size_t(batch.commandCount) * 4);
+
+        size_t batchStart = 0;
+        while (batchStart < sorted.size())
+        {
+            const uint32_t texture = sorted[batchStart]->texture;
+
+            size_t batchEnd = batchStart + 1;
+            if (batch.sortMode != SortMode_Immediate)
+            {
+                while (batchEnd < sorted.size() && sorted[batchEnd]->texture == texture)
+                    ++batchEnd;
+            }
+
+            for (size_t pos = batchStart; pos < batchEnd; pos += MaxBatchSize)
+            {
+                const size_t end = std::min(pos + MaxBatchSize, batchEnd);
+                for (size_t i = pos; i < end; ++i)
+                {
+                    RenderSprite(*sorted[i], stream.textures[texture], &vertices[i * 4]);
+                }
+                ++stats.drawCalls;
+            }
+
+            batchStart = batchEnd;
+        }
+
+        auto t2 = clock::now();
+
+        stats.sortSeconds = std::chrono::duration<double>(t1 - t0).count();
+        stats.vertexSeconds = std::chrono::duration<double>(t2 - t1).count();
+
+        return stats;
+    }
+
+    const char* SortModeName(uint32_t sortMode) noexcept
+    {
+        switch (sortMode)
+        {
+        case SortMode_Deferred:     return "Deferred";
+        case SortMode_Immediate:    return "Immediate";
+        case SortMode_Texture:      return "Texture";
+        case SortMode_BackToFront:  return "BackToFront";
+        case SortMode_FrontToBack:  return "FrontToBack";
+        default:                    return "?";
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        printf("Usage: SpriteReplay <capture file> [iterations]\n");
+        return 1;
+    }
+
+    const int iterations = (argc > 2) ? std::max(atoi(argv[2]), 1) : 10;
+
+    SpriteCommandStream stream;
+
+    try
+    {
+        std::ifstream inFile(argv[1], std::ios::in | std::ios::binary);
+        if (!inFile)
+        {
+            printf("ERROR: Failed to open %s\n", argv[1]);
+            return 1;
+        }
+
+        stream.Load(inFile);
+    }
+    catch (const std::exception& e)
+    {
+        printf("ERROR: %s\n", e.what());
+        return 1;
+    }
+
+    printf("%zu textures, %zu batches, %zu sprites, %d iterations\n",
+        stream.textures.size(), stream.batches.size(), stream.commands.size(), iterations);
+
+    ReplayContext context;
+
+    auto runBest = [&](const BatchDesc& batch, bool radix)
+    {
+        ReplayStats best = {};
+        best.sortSeconds = best.vertexSeconds = 1e30;
+
+        for (int k = 0; k < iterations; ++k)
+        {
+            const ReplayStats stats = ReplayBatch(stream, batch, radix, context);
+
+            best.sprites = stats.sprites;
+            best.drawCalls = stats.drawCalls;
+            best.sortSeconds = std::min(best.sortSeconds, stats.sortSeconds);
+            best.vertexSeconds = std::min(best.vertexSeconds, stats.vertexSeconds);
+        }
+
+        return best;
+    };
+
+    double totalSort = 0;
+    double totalRadixSort = 0;
+    double totalVertex = 0;
+    bool valid = true;
+
+    for (size_t j = 0; j < stream.batches.size(); ++j)
+    {
+        const BatchDesc& batch = stream.batches[j];
+
+        const ReplayStats best = runBest(batch, false);
+
+        printf("frame %4u batch %4zu %-12s %8zu sprites %6zu draws  sort %9.3f us  vertices %9.3f us",
+            batch.frame, j, SortModeName(batch.sortMode), best.sprites, best.drawCalls,
+            best.sortSeconds * 1e6, best.vertexSeconds * 1e6);
+
+        totalSort += best.sortSeconds;
+        totalVertex += best.vertexSeconds;
+
+        if (IsSortedMode(batch.sortMode))
+        {
+            const ReplayStats radix = runBest(batch, true);
+
+            const bool ok = ValidateOrder(batch.sortMode, context.sorted);
+            valid &= ok;
+
+            printf("  radix %9.3f us (%.2fx) %6zu draws%s",
+                radix.sortSeconds * 1e6, best.sortSeconds / std::max(radix.sortSeconds, 1e-12),
+                radix.drawCalls, ok ? "" : "  INVALID ORDER");
+
+            totalRadixSort += radix.sortSeconds;
+        }
+        else
+        {
+            totalRadixSort += best.sortSeconds;
+        }
+
+        printf("\n");
+    }
+
+    printf("total sort %.3f ms (radix %.3f ms), vertices %.3f ms\n", totalSort * 1e3, totalRadixSort * 1e3, totalVertex * 1e3);
+
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+//--------------------------------------------------------------------------------------
+// File: SpriteSortStage.h
+//
+// LSD radix sort for sprite ordering. Sprites get a 64-bit key built from their layer
+// depth and texture id; sorting the keys produces the draw order for the BackToFront,
+// FrontToBack and Texture modes. Submitting the result with SpriteSortMode_Deferred
+// avoids the comparison sort SpriteBatch runs inside End. Large batches are sorted
+// across a WorkerPool when one is given.
+//
+// This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "ParallelFor.h"
+
+class SpriteSortStage
+{
+public:
+    enum SortOrder
+    {
+        SortOrder_Texture,
+        SortOrder_BackToFront,
+        SortOrder_FrontToBack,
+    };
+
+    // A null pool sorts everything on the calling thread.
+    explicit SpriteSortStage(DX::WorkerPool* pool = nullptr) noexcept :
+        m_pool(pool),
+        m_parallelThreshold(65536)
+    {
+    }
+
+    SpriteSortStage(SpriteSortStage&&) = default;
+    SpriteSortStage& operator= (SpriteSortStage&&) = default;
+
+    SpriteSortStage(SpriteSortStage const&) = delete;
+    SpriteSortStage& operator= (SpriteSortStage const&) = delete;
+
+    // Maps a float to a uint32_t with the same ordering (including negative values).
+    static uint32_t QuantizeDepth(float depth) noexcept
+    {
+        uint32_t bits;
+        memcpy(&bits, &depth, sizeof(bits));
+        return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    }
+
+    // The primary field selects the draw order. Sprites with equal primary fields are
+    // grouped by the secondary field so fewer texture changes are needed.
+    static uint64_t MakeKey(SortOrder order, float depth, uint32_t texture) noexcept
+    {
+        const uint32_t q = QuantizeDepth(depth);
+        switch (order)
+        {
+        case SortOrder_BackToFront: return (uint64_t(~q) << 32) | texture;
+        case SortOrder_FrontToBack: return (uint64_t(q) << 32) | texture;
+        default:                    return (uint64_t(texture) << 32) | q;
+        }
+    }
+
+    // Batches at least this large use the multithreaded path.
+    void SetParallelThreshold(size_t count) noexcept { m_parallelThreshold = count; }
+
+    // Sorts keys ascending (stable) and returns the permutation of [0, count). The returned
+    // pointer is valid until the next call; internal buffers are reused between calls.
+    const uint32_t* Sort(const uint64_t* keys, size_t count)
+    {
+        if (!count)
+            return m_values.data();
+
+        if (m_keys.size() < count)
+        {
+            m_keys.resize(count);
+            m_keysScratch.resize(count);
+            m_values.resize(count);
+            m_valuesScratch.resize(count);
+        }
+
+        memcpy(m_keys.data(), keys, count * sizeof(uint64_t));
+        for (size_t i = 0; i < count; ++i)
+        {
+            m_values[i] = uint32_t(i);
+        }
+
+        if (m_pool && count >= m_parallelThreshold && m_pool->GetThreadCount() > 1)
+        {
+            SortParallel(count);
+        }
+        else
+        {
+            SortSerial(count);
+        }
+
+        return m_values.data();
+    }
+
+private:
+    static constexpr size_t Passes = 8;
+    static constexpr size_t Buckets = 256;
+
+    void SortSerial(size_t count)
+    {
+        // Build all histograms in a single read of the keys.
+        size_t histograms[Passes][Buckets] = {};
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint64_t key = m_keys[i];
+            for (size_t pass = 0; pass < Passes; ++pass)
+            {
+                ++histograms[pass][key & 0xFF];
+                key >>= 8;
+            }
+        }
+
+        for (size_t pass = 0; pass < Passes; ++pass)
+        {
+            size_t* histogram = histograms[pass];
+
+            // Skip digits where every key has the same value.
+            const uint64_t first = (m_keys[0] >> (pass * 8)) & 0xFF;
+            if (histogram[first] == count)
+                continue;
+
+            size_t offset = 0;
+            for (size_t j = 0; j < Buckets; ++j)
+            {
+                const size_t n = histogram[j];
+                histogram[j] = offset;
+                offset += n;
+            }
+
+            const unsigned int shift = unsigned(pass * 8);
+            for (size_t i = 0; i < count; ++i)
+            {
+                const uint64_t key = m_keys[i];
+                const size_t dest = histogram[(key >> shift) & 0xFF]++;
+                m_keysScratch[dest] = key;
+                m_valuesScratch[dest] = m_values[i];
+            }
+
+            std::swap(m_keys, m_keysScratch);
+            std::swap(m_values, m_valuesScratch);
+        }
+    }
+
+    void SortParallel(size_t count)
+    {
+        const size_t chunks = std::min(m_pool->GetThreadCount(), count);
+        const size_t chunkSize = (count + chunks - 1) / chunks;
+
+        m_chunkHistograms.resize(chunks * Buckets);
+
+        unsigned int shift = 0;
+
+        // Per-chunk histograms of the current digit.
+        auto histogram = [&](size_t begin, size_t end, size_t)
+        {
+            for (size_t c = begin; c < end; ++c)
+            {
+                size_t* counts = &m_chunkHistograms[c * Buckets];
+                std::fill(counts, counts + Buckets, size_t(0));
+
+                const size_t last = std::min(count, (c + 1) * chunkSize);
+                for (size_t i = c * chunkSize; i < last; ++i)
+                {
+                    ++counts[(m_keys[i] >> shift) & 0xFF];
+                }
+            }
+        };
+
+        // Each chunk scatters to the offsets the prefix sum left in its histogram.
+        auto scatter = [&](size_t begin, size_t end, size_t)
+        {
+            for (size_t c = begin; c < end; ++c)
+            {
+                size_t* offsets = &m_chunkHistograms[c * Buckets];
+
+                const size_t last = std::min(count, (c + 1) * chunkSize);
+                for (size_t i = c * chunkSize; i < last; ++i)
+                {
+                    const uint64_t key = m_keys[i];
+                    const size_t dest = offsets[(key >> shift) & 0xFF]++;
+                    m_keysScratch[dest] = key;
+                    m_valuesScratch[dest] = m_values[i];
+                }
+            }
+        };
+
+        for (size_t pass = 0; pass < Passes; ++pass)
+        {
+            shift = unsigned(pass * 8);
+
+            m_pool->Run(chunks, 1, histogram);
+
+            const uint64_t first = (m_keys[0] >> shift) & 0xFF;
+            size_t firstTotal = 0;
+            for (size_t c = 0; c < chunks; ++c)
+            {
+                firstTotal += m_chunkHistograms[c * Buckets + first];
+            }
+
+            if (firstTotal == count)
+                continue;
+
+            // Exclusive prefix sum in (digit, chunk) order keeps the sort stable.
+            size_t offset = 0;
+            for (size_t j = 0; j < Buckets; ++j)
+            {
+                for (size_t c = 0; c < chunks; ++c)
+                {
+                    const size_t n = m_chunkHistograms[c * Buckets + j];
+                    m_chunkHistograms[c * Buckets + j] = offset;
+                    offset += n;
+                }
+            }
+
+            m_pool->Run(chunks, 1, scatter);
+
+            std::swap(m_keys, m_keysScratch);
+            std::swap(m_values, m_valuesScratch);
+        }
+    }
+
+    DX::WorkerPool*         m_pool;
+    size_t                  m_parallelThreshold;
+    std::vector<uint64_t>   m_keys;
+    std::vector<uint64_t>   m_keysScratch;
+    std::vector<uint32_t>   m_values;
+    std::vector<uint32_t>   m_valuesScratch;
+    std::vector<size_t>     m_chunkHistograms;
+};
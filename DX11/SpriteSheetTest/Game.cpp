@@ -62,7 +62,7 @@ void Game::Update(DX::StepTimer const& timer)
     float elapsedTime = float(timer.GetElapsedSeconds());
 
     // TODO: Add your game logic here.
-    elapsedTime;
+    m_particles->Update(elapsedTime);
 }
 #pragma endregion
 
@@ -137,6 +137,11 @@ void Game::Render()
 
     m_spriteBatch->End();
 
+    // Particles.
+    m_spriteBatch->Begin(SpriteSortMode_Deferred, m_states->Additive());
+    m_particles->Draw(m_spriteBatch.get(), *m_sprites);
+    m_spriteBatch->End();
+
     m_deviceResources->PIXEndEvent();
 
     // Show the new frame.
@@ -251,6 +256,27 @@ void Game::CreateDeviceDependentResources()
 #endif
 
     m_sprites->Load(m_texture.Get(), L"SpriteSheetSample.txt");
+
+    m_states = std::make_unique<CommonStates>(device);
+
+    ParticleEmitterDesc desc = {};
+    desc.position = { 512.f, 700.f };
+    desc.positionVariance = { 16.f, 4.f };
+    desc.velocityMin = { -60.f, -320.f };
+    desc.velocityMax = { 60.f, -200.f };
+    desc.acceleration = { 0.f, 98.f };
+    desc.colorStart = { 1.f, 0.8f, 0.3f, 1.f };
+    desc.colorEnd = { 0.5f, 0.1f, 0.f, 0.f };
+    desc.lifetimeMin = 1.f;
+    desc.lifetimeMax = 2.5f;
+    desc.rotationSpeedMin = -XM_PI;
+    desc.rotationSpeedMax = XM_PI;
+    desc.scale = 0.25f;
+    desc.spawnRate = 1000.f;
+    desc.capacity = 4096;
+
+    m_particles = std::make_unique<ParticleSystem>(&m_workerPool);
+    m_particles->AddEmitter(desc, m_sprites->Find(L"glow1"));
 }
 
 // Allocate all memory resources that change on a window SizeChanged event.
@@ -262,6 +288,8 @@ void Game::CreateWindowSizeDependentResources()
 void Game::OnDeviceLost()
 {
     // TODO: Add Direct3D resource cleanup here.
+    m_particles.reset();
+    m_states.reset();
     m_spriteBatch.reset();
     m_texture.Reset();
 }
@@ -7,6 +7,7 @@
 #include "DeviceResources.h"
 #include "StepTimer.h"
 #include "SpriteSheet.h"
+#include "ParticleSystem.h"
 
 // A basic game implementation that creates a D3D11 device and
 // provides a game loop.
@@ -62,5 +63,8 @@ private:
 
     std::unique_ptr<DirectX::SpriteBatch>               m_spriteBatch;
     std::unique_ptr<SpriteSheet>                        m_sprites;
+    std::unique_ptr<DirectX::CommonStates>              m_states;
+    DX::WorkerPool                                      m_workerPool;
+    std::unique_ptr<ParticleSystem>                     m_particles;
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_texture;
 };
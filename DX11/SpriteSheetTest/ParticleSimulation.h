@@ -0,0 +1,390 @@
+//--------------------------------------------------------------------------------------
+// File: ParticleSimulation.h
+//
+// CPU particle simulation behind ParticleSystem.h, using structure-of-arrays storage that
+// is allocated once from each emitter's capacity. Only the streams the motion needs are
+// integrated; colors are derived from age when drawing. The integrate loop is 8-wide with AVX when
+// the compiler targets it, 4-wide with SSE2 otherwise (the sample projects build with
+// /arch:SSE2, so that is the path they run). Each frame the live particles of every emitter
+// are cut into fixed-size blocks that are integrated across a WorkerPool, then expired
+// particles are removed per emitter.
+//
+// This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define PARTICLESIMULATION_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(PARTICLESIMULATION_SSE2) && defined(__AVX__)
+#define PARTICLESIMULATION_AVX
+#include <immintrin.h>
+#endif
+
+#include "ParallelFor.h"
+
+// Layout-compatible with DirectX::XMFLOAT2 and XMFLOAT4.
+struct ParticleFloat2
+{
+    float x;
+    float y;
+};
+
+struct ParticleFloat4
+{
+    float x;
+    float y;
+    float z;
+    float w;
+};
+
+struct ParticleEmitterDesc
+{
+    ParticleFloat2                      position;
+    ParticleFloat2                      positionVariance;
+    ParticleFloat2                      velocityMin;
+    ParticleFloat2                      velocityMax;
+    ParticleFloat2                      acceleration;
+    ParticleFloat4                      colorStart;
+    ParticleFloat4                      colorEnd;
+    float                               lifetimeMin;
+    float                               lifetimeMax;
+    float                               rotationSpeedMin;
+    float                               rotationSpeedMax;
+    float                               scale;
+    float                               spawnRate;      // Particles per second
+    size_t                              capacity;
+};
+
+class ParticleEmitter
+{
+public:
+    // Integrate works on multiples of this many particles.
+    static constexpr size_t Width = 8;
+
+    explicit ParticleEmitter(const ParticleEmitterDesc& desc, uint32_t seed = 1) :
+        m_desc(desc),
+        m_count(0),
+        m_spawnAccumulator(0.f),
+        m_random(seed ? seed : 1)
+    {
+        if (!desc.capacity || desc.lifetimeMin <= 0.f || desc.lifetimeMax < desc.lifetimeMin)
+            throw std::invalid_argument("ParticleEmitter");
+
+        // Pad so the vector loop never needs a separate tail for the storage arrays.
+        const size_t padded = (desc.capacity + Width - 1) & ~(Width - 1);
+        for (auto& it : m_streams)
+        {
+            it.resize(padded, 0.f);
+        }
+    }
+
+    ParticleEmitter(ParticleEmitter&&) = default;
+    ParticleEmitter& operator= (ParticleEmitter&&) = default;
+
+    ParticleEmitter(ParticleEmitter const&) = delete;
+    ParticleEmitter& operator= (ParticleEmitter const&) = delete;
+
+    void SetPosition(const ParticleFloat2& position) noexcept { m_desc.position = position; }
+    void SetSpawnRate(float rate) noexcept { m_desc.spawnRate = rate; }
+
+    // Spawns up to count particles from the preallocated pool.
+    void Burst(size_t count)
+    {
+        const size_t end = std::min(m_count + count, m_desc.capacity);
+        for (size_t i = m_count; i < end; ++i)
+        {
+            Spawn(i);
+        }
+        m_count = end;
+    }
+
+    // Emit, Integrate over [0, GetCount()) and Compact, as ParticleSimulation::Update does
+    // for each emitter.
+    void Update(float elapsedTime)
+    {
+        Emit(elapsedTime);
+        Integrate(elapsedTime, 0, m_count);
+        Compact();
+    }
+
+    // Spawns the particles due from the spawn rate.
+    void Emit(float elapsedTime)
+    {
+        m_spawnAccumulator += m_desc.spawnRate * elapsedTime;
+        if (m_spawnAccumulator >= 1.f)
+        {
+            const auto spawn = size_t(m_spawnAccumulator);
+            m_spawnAccumulator -= float(spawn);
+            Burst(spawn);
+        }
+    }
+
+    // Advances particles [begin, end) by dt. 'begin' must be a multiple of Width and 'end'
+    // either a multiple of Width or GetCount(); the padded streams let the last vector run
+    // past the count. Disjoint ranges may be integrated on different threads.
+    void Integrate(float dt, size_t begin, size_t end) noexcept
+    {
+        float* px = Stream(PosX);
+        float* py = Stream(PosY);
+        float* vx = Stream(VelX);
+        float* vy = Stream(VelY);
+        float* age = Stream(Age);
+        float* rot = Stream(Rotation);
+        const float* rotSpeed = Stream(RotationSpeed);
+
+        const float accelX = m_desc.acceleration.x * dt;
+        const float accelY = m_desc.acceleration.y * dt;
+
+        size_t i = begin;
+
+    #if defined(PARTICLESIMULATION_AVX)
+        const __m256 vdt = _mm256_set1_ps(dt);
+        const __m256 ax = _mm256_set1_ps(accelX);
+        const __m256 ay = _mm256_set1_ps(accelY);
+
+        for (; i < end; i += 8)
+        {
+            const __m256 velX = _mm256_add_ps(_mm256_loadu_ps(vx + i), ax);
+            const __m256 velY = _mm256_add_ps(_mm256_loadu_ps(vy + i), ay);
+            _mm256_storeu_ps(vx + i, velX);
+            _mm256_storeu_ps(vy + i, velY);
+            _mm256_storeu_ps(px + i, _mm256_add_ps(_mm256_mul_ps(velX, vdt), _mm256_loadu_ps(px + i)));
+            _mm256_storeu_ps(py + i, _mm256_add_ps(_mm256_mul_ps(velY, vdt), _mm256_loadu_ps(py + i)));
+            _mm256_storeu_ps(rot + i, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(rotSpeed + i), vdt), _mm256_loadu_ps(rot + i)));
+
+            _mm256_storeu_ps(age + i, _mm256_add_ps(_mm256_loadu_ps(age + i), vdt));
+        }
+    #elif defined(PARTICLESIMULATION_SSE2)
+        const __m128 vdt = _mm_set1_ps(dt);
+        const __m128 ax = _mm_set1_ps(accelX);
+        const __m128 ay = _mm_set1_ps(accelY);
+
+        for (; i < end; i += 4)
+        {
+            const __m128 velX = _mm_add_ps(_mm_loadu_ps(vx + i), ax);
+            const __m128 velY = _mm_add_ps(_mm_loadu_ps(vy + i), ay);
+            _mm_storeu_ps(vx + i, velX);
+            _mm_storeu_ps(vy + i, velY);
+            _mm_storeu_ps(px + i, _mm_add_ps(_mm_mul_ps(velX, vdt), _mm_loadu_ps(px + i)));
+            _mm_storeu_ps(py + i, _mm_add_ps(_mm_mul_ps(velY, vdt), _mm_loadu_ps(py + i)));
+            _mm_storeu_ps(rot + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(rotSpeed + i), vdt), _mm_loadu_ps(rot + i)));
+
+            _mm_storeu_ps(age + i, _mm_add_ps(_mm_loadu_ps(age + i), vdt));
+        }
+    #endif
+
+        for (; i < end; ++i)
+        {
+            vx[i] += accelX;
+            vy[i] += accelY;
+            px[i] += vx[i] * dt;
+            py[i] += vy[i] * dt;
+            rot[i] += rotSpeed[i] * dt;
+            age[i] += dt;
+        }
+    }
+
+    // Removes expired particles by moving the last live particle into the hole.
+    void Compact() noexcept
+    {
+        const float* age = Stream(Age);
+        const float* invLife = Stream(InvLifetime);
+
+        size_t i = 0;
+        while (i < m_count)
+        {
+            if (age[i] * invLife[i] < 1.f)
+            {
+                ++i;
+                continue;
+            }
+
+            --m_count;
+            if (i != m_count)
+            {
+                for (auto& it : m_streams)
+                {
+                    it[i] = it[m_count];
+                }
+            }
+        }
+    }
+
+    size_t GetCount() const noexcept { return m_count; }
+    size_t GetCapacity() const noexcept { return m_desc.capacity; }
+    float GetScale() const noexcept { return m_desc.scale; }
+
+    // Per-particle streams for drawing, GetCount() entries each.
+    const float* GetPositionX() const noexcept { return Stream(PosX); }
+    const float* GetPositionY() const noexcept { return Stream(PosY); }
+    const float* GetVelocityX() const noexcept { return Stream(VelX); }
+    const float* GetVelocityY() const noexcept { return Stream(VelY); }
+    const float* GetRotation() const noexcept { return Stream(Rotation); }
+    const float* GetAge() const noexcept { return Stream(Age); }
+    const float* GetInvLifetime() const noexcept { return Stream(InvLifetime); }
+
+    // Color of particle i, from colorStart to colorEnd over its lifetime. Colors are only
+    // needed for drawing, so they are computed here rather than stored and integrated.
+    ParticleFloat4 GetColor(size_t i) const noexcept
+    {
+        const ParticleFloat4& c0 = m_desc.colorStart;
+        const ParticleFloat4& c1 = m_desc.colorEnd;
+        const float t = std::min(Stream(Age)[i] * Stream(InvLifetime)[i], 1.f);
+        return ParticleFloat4{ (c1.x - c0.x) * t + c0.x, (c1.y - c0.y) * t + c0.y,
+            (c1.z - c0.z) * t + c0.z, (c1.w - c0.w) * t + c0.w };
+    }
+
+private:
+    enum StreamId
+    {
+        PosX = 0,
+        PosY,
+        VelX,
+        VelY,
+        Age,
+        InvLifetime,
+        Rotation,
+        RotationSpeed,
+        StreamCount
+    };
+
+    float* Stream(StreamId id) noexcept { return m_streams[id].data(); }
+    const float* Stream(StreamId id) const noexcept { return m_streams[id].data(); }
+
+    float Random(float minValue, float maxValue) noexcept
+    {
+        // xorshift32
+        m_random ^= m_random << 13;
+        m_random ^= m_random >> 17;
+        m_random ^= m_random << 5;
+        const float t = float(m_random >> 8) * (1.f / 16777216.f);
+        return minValue + (maxValue - minValue) * t;
+    }
+
+    void Spawn(size_t i) noexcept
+    {
+        Stream(PosX)[i] = m_desc.position.x + Random(-m_desc.positionVariance.x, m_desc.positionVariance.x);
+        Stream(PosY)[i] = m_desc.position.y + Random(-m_desc.positionVariance.y, m_desc.positionVariance.y);
+        Stream(VelX)[i] = Random(m_desc.velocityMin.x, m_desc.velocityMax.x);
+        Stream(VelY)[i] = Random(m_desc.velocityMin.y, m_desc.velocityMax.y);
+        Stream(Age)[i] = 0.f;
+        Stream(InvLifetime)[i] = 1.f / Random(m_desc.lifetimeMin, m_desc.lifetimeMax);
+        Stream(Rotation)[i] = 0.f;
+        Stream(RotationSpeed)[i] = Random(m_desc.rotationSpeedMin, m_desc.rotationSpeedMax);
+    }
+
+    ParticleEmitterDesc     m_desc;
+    size_t                  m_count;
+    float                   m_spawnAccumulator;
+    uint32_t                m_random;
+    std::vector<float>      m_streams[StreamCount];
+};
+
+class ParticleSimulation
+{
+public:
+    // Particles per integrate block handed to a worker; a multiple of ParticleEmitter::Width.
+    static constexpr size_t BlockSize = 16384;
+
+    // A null pool updates everything on the calling thread.
+    explicit ParticleSimulation(DX::WorkerPool* pool = nullptr) noexcept :
+        m_pool(pool)
+    {
+    }
+
+    ParticleSimulation(ParticleSimulation&&) = default;
+    ParticleSimulation& operator= (ParticleSimulation&&) = default;
+
+    ParticleSimulation(ParticleSimulation const&) = delete;
+    ParticleSimulation& operator= (ParticleSimulation const&) = delete;
+
+    ParticleEmitter* AddEmitter(const ParticleEmitterDesc& desc)
+    {
+        m_emitters.emplace_back(std::make_unique<ParticleEmitter>(desc, uint32_t(m_emitters.size() * 7919 + 1)));
+        return m_emitters.back().get();
+    }
+
+    void Clear() { m_emitters.clear(); }
+
+    void Update(float elapsedTime)
+    {
+        // Spawning draws from each emitter's random sequence, so it stays on this thread.
+        m_blocks.clear();
+        for (auto& it : m_emitters)
+        {
+            it->Emit(elapsedTime);
+
+            for (size_t begin = 0; begin < it->GetCount(); begin += BlockSize)
+            {
+                m_blocks.push_back(Block{ it.get(), begin, std::min(begin + BlockSize, it->GetCount()) });
+            }
+        }
+
+        auto integrate = [&](size_t begin, size_t end, size_t)
+        {
+            for (size_t j = begin; j < end; ++j)
+            {
+                m_blocks[j].emitter->Integrate(elapsedTime, m_blocks[j].begin, m_blocks[j].end);
+            }
+        };
+
+        auto compact = [&](size_t begin, size_t end, size_t)
+        {
+            for (size_t j = begin; j < end; ++j)
+            {
+                m_emitters[j]->Compact();
+            }
+        };
+
+        if (m_pool)
+        {
+            m_pool->Run(m_blocks.size(), 1, integrate);
+            m_pool->Run(m_emitters.size(), 1, compact);
+        }
+        else
+        {
+            integrate(0, m_blocks.size(), 0);
+            compact(0, m_emitters.size(), 0);
+        }
+    }
+
+    size_t GetEmitterCount() const noexcept { return m_emitters.size(); }
+    const ParticleEmitter& GetEmitter(size_t index) const { return *m_emitters.at(index); }
+
+    size_t GetParticleCount() const noexcept
+    {
+        size_t count = 0;
+        for (const auto& it : m_emitters)
+        {
+            count += it->GetCount();
+        }
+        return count;
+    }
+
+private:
+    struct Block
+    {
+        ParticleEmitter*    emitter;
+        size_t              begin;
+        size_t              end;
+    };
+
+    DX::WorkerPool*                                 m_pool;
+    std::vector<std::unique_ptr<ParticleEmitter>>   m_emitters;
+    std::vector<Block>                              m_blocks;
+};
@@ -0,0 +1,316 @@
+//--------------------------------------------------------------------------------------
+// File: ParticleSimulationCheck.cpp
+//
+// Checks ParticleSimulation.h: the vector integrate loop matches a scalar reference for
+// every count (including partial vectors), updating on a WorkerPool gives the same bits
+// as updating on one thread, compaction keeps exactly the live particles, and spawning
+// stops at the emitter capacity. Then 1M particles are updated for a number of frames on
+// one thread and on a WorkerPool, against a 2 ms per frame budget.
+//
+// This is a standalone console tool with no Windows or Direct3D dependencies:
+//
+//   g++ -std=c++14 -O2 -mavx -pthread -I.. -I../../Common -o ParticleSimulationCheck ParticleSimulationCheck.cpp
+//   cl /std:c++14 /O2 /EHsc /I.. /I..\..\Common ParticleSimulationCheck.cpp
+//
+// Drop -mavx (g++) to measure the SSE2 path the /arch:SSE2 sample projects use, or add
+// /arch:AVX (cl) for the AVX path. Pass -nobench to skip the timing.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "ParticleSimulation.h"
+#include "CheckHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    ParticleEmitterDesc MakeDesc(size_t capacity, float lifetimeMin, float lifetimeMax, float spawnRate)
+    {
+        ParticleEmitterDesc desc = {};
+        desc.position = { 512.f, 700.f };
+        desc.positionVariance = { 16.f, 4.f };
+        desc.velocityMin = { -60.f, -320.f };
+        desc.velocityMax = { 60.f, -200.f };
+        desc.acceleration = { 0.f, 98.f };
+        desc.colorStart = { 1.f, 0.8f, 0.3f, 1.f };
+        desc.colorEnd = { 0.5f, 0.1f, 0.f, 0.f };
+        desc.lifetimeMin = lifetimeMin;
+        desc.lifetimeMax = lifetimeMax;
+        desc.rotationSpeedMin = -3.14159265f;
+        desc.rotationSpeedMax = 3.14159265f;
+        desc.scale = 0.25f;
+        desc.spawnRate = spawnRate;
+        desc.capacity = capacity;
+        return desc;
+    }
+
+    struct Snapshot
+    {
+        std::vector<float> x, y, rotation, age, invLifetime;
+
+        explicit Snapshot(const ParticleEmitter& emitter)
+        {
+            const size_t n = emitter.GetCount();
+            x.assign(emitter.GetPositionX(), emitter.GetPositionX() + n);
+            y.assign(emitter.GetPositionY(), emitter.GetPositionY() + n);
+            rotation.assign(emitter.GetRotation(), emitter.GetRotation() + n);
+            age.assign(emitter.GetAge(), emitter.GetAge() + n);
+            invLifetime.assign(emitter.GetInvLifetime(), emitter.GetInvLifetime() + n);
+        }
+
+        bool operator== (const Snapshot& other) const
+        {
+            return x == other.x && y == other.y && rotation == other.rotation
+                && age == other.age && invLifetime == other.invLifetime;
+        }
+    };
+
+    bool Close(float a, float b)
+    {
+        return std::fabs(a - b) <= 1e-4f * std::max(1.f, std::fabs(b));
+    }
+
+    void CheckIntegrate()
+    {
+        const ParticleEmitterDesc desc = MakeDesc(1000, 1.f, 2.5f, 0.f);
+        constexpr float dt = 1.f / 60.f;
+
+        const float ax = desc.acceleration.x * dt;
+        const float ay = desc.acceleration.y * dt;
+        const ParticleFloat4& c0 = desc.colorStart;
+        const ParticleFloat4& c1 = desc.colorEnd;
+
+        bool motion = true;
+        bool color = true;
+        for (size_t count = 1; count <= 67; ++count)
+        {
+            ParticleEmitter emitter(desc, uint32_t(count));
+            emitter.Burst(count);
+
+            std::vector<float> vx(emitter.GetVelocityX(), emitter.GetVelocityX() + count);
+            std::vector<float> vy(emitter.GetVelocityY(), emitter.GetVelocityY() + count);
+            std::vector<float> px(emitter.GetPositionX(), emitter.GetPositionX() + count);
+            std::vector<float> py(emitter.GetPositionY(), emitter.GetPositionY() + count);
+            std::vector<float> t1(count);
+
+            for (int step = 1; step <= 3; ++step)
+            {
+                emitter.Integrate(dt, 0, emitter.GetCount());
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    // Scalar reference: v += a dt, x += v dt.
+                    vx[i] += ax;
+                    vy[i] += ay;
+                    px[i] += vx[i] * dt;
+                    py[i] += vy[i] * dt;
+
+                    if (!Close(emitter.GetVelocityX()[i], vx[i]) || !Close(emitter.GetVelocityY()[i], vy[i])
+                        || !Close(emitter.GetPositionX()[i], px[i]) || !Close(emitter.GetPositionY()[i], py[i])
+                        || !Close(emitter.GetAge()[i], dt * float(step)))
+                        motion = false;
+
+                    // Every channel sits at the same point t between colorStart and colorEnd,
+                    // and t grows linearly with age.
+                    const ParticleFloat4 c = emitter.GetColor(i);
+                    const float t = (c.w - c0.w) / (c1.w - c0.w);
+                    if (!Close(c.x, c0.x + (c1.x - c0.x) * t)
+                        || !Close(c.y, c0.y + (c1.y - c0.y) * t)
+                        || !Close(c.z, c0.z + (c1.z - c0.z) * t))
+                        color = false;
+
+                    if (step == 1)
+                    {
+                        t1[i] = t;
+                        if (!(t > 0.f) || t > dt / desc.lifetimeMin * 1.001f || t < dt / desc.lifetimeMax * 0.999f)
+                            color = false;
+                    }
+                    else if (std::fabs(t - t1[i] * float(step)) > 1e-4f)
+                    {
+                        color = false;
+                    }
+                }
+            }
+
+            if (emitter.GetCount() != count)
+                motion = false;
+        }
+        Check(motion, "Vector integrate matches the scalar velocity, position and age update for every count");
+        Check(color, "Colors are interpolated by age over the lifetime");
+
+        // Integrating in aligned blocks gives the same bits as one call over everything.
+        ParticleEmitter whole(desc, 5);
+        ParticleEmitter blocks(desc, 5);
+        whole.Burst(1000);
+        blocks.Burst(1000);
+
+        whole.Integrate(dt, 0, whole.GetCount());
+        for (size_t begin = 0; begin < blocks.GetCount(); begin += 64)
+        {
+            blocks.Integrate(dt, begin, std::min<size_t>(begin + 64, blocks.GetCount()));
+        }
+        Check(Snapshot(whole) == Snapshot(blocks), "Integrating in blocks matches one pass");
+    }
+
+    void CheckCompactAndCapacity()
+    {
+        ParticleEmitter emitter(MakeDesc(500, 0.1f, 1.f, 0.f), 9);
+        emitter.Burst(700);
+        Check(emitter.GetCount() == 500, "Burst stops at the capacity");
+
+        const ParticleEmitterDesc desc = MakeDesc(500, 0.1f, 1.f, 0.f);
+        size_t lastCount = emitter.GetCount();
+        bool shrinking = true;
+        bool live = true;
+        for (int frame = 0; frame < 80; ++frame)
+        {
+            emitter.Update(1.f / 60.f);
+            if (emitter.GetCount() > lastCount)
+                shrinking = false;
+            lastCount = emitter.GetCount();
+
+            // Every remaining particle has age below its lifetime, which is at most lifetimeMax.
+            for (size_t i = 0; i < emitter.GetCount(); ++i)
+            {
+                if (!(emitter.GetAge()[i] < desc.lifetimeMax))
+                    live = false;
+            }
+        }
+        Check(shrinking && live, "Compaction removes expired particles and keeps live ones");
+        Check(emitter.GetCount() == 0, "All particles expire after their longest lifetime");
+
+        // Spawn rate: 600 per second for half a second, far from the capacity.
+        ParticleEmitter spawner(MakeDesc(10000, 5.f, 5.f, 600.f), 3);
+        for (int frame = 0; frame < 30; ++frame)
+        {
+            spawner.Update(1.f / 60.f);
+        }
+        Check(spawner.GetCount() >= 299 && spawner.GetCount() <= 300, "Spawn rate is honored");
+
+        Check([]()
+            {
+                try
+                {
+                    ParticleEmitter bad(MakeDesc(0, 1.f, 2.f, 0.f));
+                }
+                catch (const std::invalid_argument&)
+                {
+                    return true;
+                }
+                return false;
+            }(), "Zero capacity throws");
+    }
+
+    void BuildScene(ParticleSimulation& simulation, size_t bigCount)
+    {
+        // One large emitter and a few small ones with uneven counts.
+        ParticleEmitter* big = simulation.AddEmitter(MakeDesc(bigCount, 1.f, 3.f, float(bigCount) / 2.f));
+        big->Burst(bigCount * 3 / 4 + 5);
+
+        for (size_t j = 0; j < 6; ++j)
+        {
+            ParticleEmitter* small = simulation.AddEmitter(MakeDesc(5000 + j * 777, 0.5f, 2.f, 3000.f));
+            small->Burst(1000 + j * 333);
+        }
+    }
+
+    void CheckThreading()
+    {
+        ParticleSimulation serial;
+        WorkerPool pool(4);
+        ParticleSimulation threaded(&pool);
+
+        BuildScene(serial, 100003);
+        BuildScene(threaded, 100003);
+
+        bool same = true;
+        for (int frame = 0; frame < 120; ++frame)
+        {
+            serial.Update(1.f / 60.f);
+            threaded.Update(1.f / 60.f);
+
+            if (serial.GetParticleCount() != threaded.GetParticleCount())
+                same = false;
+        }
+
+        for (size_t j = 0; j < serial.GetEmitterCount(); ++j)
+        {
+            if (!(Snapshot(serial.GetEmitter(j)) == Snapshot(threaded.GetEmitter(j))))
+                same = false;
+        }
+        Check(same, "Updating on a WorkerPool matches a single thread bit for bit");
+        Check(serial.GetParticleCount() > 50000, "Threading test keeps a large live count");
+    }
+
+    double TimeFrames(ParticleSimulation& simulation, int frames)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (int j = 0; j < frames; ++j)
+        {
+            simulation.Update(1.f / 60.f);
+        }
+        const auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count() / frames;
+    }
+
+    void Benchmark()
+    {
+        constexpr size_t count = 1000000;
+        constexpr int frames = 120;
+
+    #if defined(PARTICLESIMULATION_AVX)
+        const char* path = "AVX";
+    #elif defined(PARTICLESIMULATION_SSE2)
+        const char* path = "SSE2";
+    #else
+        const char* path = "scalar";
+    #endif
+
+        // Long lifetimes and a matching spawn rate keep the count near 1M.
+        auto make = [](ParticleSimulation& simulation)
+        {
+            ParticleEmitter* emitter = simulation.AddEmitter(MakeDesc(count, 20.f, 40.f, float(count) / 30.f));
+            emitter->Burst(count);
+        };
+
+        ParticleSimulation serial;
+        make(serial);
+        serial.Update(1.f / 60.f);
+        const double serialTime = TimeFrames(serial, frames);
+
+        WorkerPool pool;
+        ParticleSimulation threaded(&pool);
+        make(threaded);
+        threaded.Update(1.f / 60.f);
+        const double threadedTime = TimeFrames(threaded, frames);
+
+        printf("%zu particles (%s): %.3f ms per frame on one thread, %.3f ms on a %zu thread WorkerPool (budget 2 ms)\n",
+            threaded.GetParticleCount(), path, serialTime, threadedTime, pool.GetThreadCount());
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const bool bench = !(argc > 1 && strcmp(argv[1], "-nobench") == 0);
+
+    return RunChecks([&]()
+    {
+        CheckIntegrate();
+        CheckCompactAndCapacity();
+        CheckThreading();
+
+        if (bench)
+        {
+            Benchmark();
+        }
+    });
+}
@@ -0,0 +1,86 @@
+//--------------------------------------------------------------------------------------
+// File: ParticleSystem.h
+//
+// Renders the CPU particles of ParticleSimulation.h through SpriteBatch using SpriteSheet
+// frames, one frame per emitter. The simulation runs on a WorkerPool owned by the caller.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "SpriteBatch.h"
+#include "SpriteSheet.h"
+#include "ParticleSimulation.h"
+
+class ParticleSystem
+{
+public:
+    // A null pool updates the particles on the calling thread.
+    explicit ParticleSystem(DX::WorkerPool* pool = nullptr) noexcept :
+        m_simulation(pool)
+    {
+    }
+
+    ParticleSystem(ParticleSystem&&) = default;
+    ParticleSystem& operator= (ParticleSystem&&) = default;
+
+    ParticleSystem(ParticleSystem const&) = delete;
+    ParticleSystem& operator= (ParticleSystem const&) = delete;
+
+    // Emitters without a frame are simulated but not drawn.
+    ParticleEmitter* AddEmitter(const ParticleEmitterDesc& desc, const SpriteSheet::SpriteFrame* frame)
+    {
+        m_frames.reserve(m_frames.size() + 1);
+        ParticleEmitter* emitter = m_simulation.AddEmitter(desc);
+        m_frames.push_back(frame);
+        return emitter;
+    }
+
+    void Clear()
+    {
+        m_simulation.Clear();
+        m_frames.clear();
+    }
+
+    void Update(float elapsedTime)
+    {
+        m_simulation.Update(elapsedTime);
+    }
+
+    void Draw(DirectX::SpriteBatch* batch, const SpriteSheet& sheet) const
+    {
+        for (size_t j = 0; j < m_frames.size(); ++j)
+        {
+            if (!m_frames[j])
+                continue;
+
+            const ParticleEmitter& emitter = m_simulation.GetEmitter(j);
+
+            const float* px = emitter.GetPositionX();
+            const float* py = emitter.GetPositionY();
+            const float* rot = emitter.GetRotation();
+            const float scale = emitter.GetScale();
+
+            for (size_t i = 0; i < emitter.GetCount(); ++i)
+            {
+                const ParticleFloat4 color = emitter.GetColor(i);
+                sheet.Draw(batch, *m_frames[j], DirectX::XMFLOAT2(px[i], py[i]),
+                    DirectX::XMVectorSet(color.x, color.y, color.z, color.w), rot[i], scale);
+            }
+        }
+    }
+
+    size_t GetParticleCount() const noexcept { return m_simulation.GetParticleCount(); }
+
+private:
+    ParticleSimulation                          m_simulation;
+    std::vector<const SpriteSheet::SpriteFrame*> m_frames;
+};
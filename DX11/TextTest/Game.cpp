@@ -12,7 +12,11 @@ using namespace DirectX::SimpleMath;
 
 using Microsoft::WRL::ComPtr;
 
-Game::Game() noexcept(false)
+// Define to fill a 5000 line TextBlock and scroll it as new lines are appended.
+//#define USE_LOG
+
+Game::Game() noexcept(false) :
+    m_logClip{}
 {
     m_deviceResources = std::make_unique<DX::DeviceResources>();
     m_deviceResources->RegisterDeviceNotify(this);
@@ -79,33 +83,41 @@ void Game::Render()
 #if 1
     const wchar_t* output = L"Hello World";
 
-    Vector2 origin = m_font->MeasureString(output) / 2.f;
+    const TextLayout& layout = m_textCache.Get(m_font.get(), output);
 
-    m_font->DrawString(m_spriteBatch.get(), output, m_fontPos, Colors::White, 0.f, origin);
+    Vector2 origin = Vector2(layout.size) / 2.f;
+
+    DrawTextLayout(m_spriteBatch.get(), m_fontTexture.Get(), layout, m_fontPos, Colors::White, 0.f, origin);
 #endif
 
 #if 0
     const wchar_t* output = L"Hello World";
 
-    Vector2 origin = m_font->MeasureString(output) / 2.f;
+    // Every pass replays the same cached layout.
+    const TextLayout& layout = m_textCache.Get(m_font.get(), output);
 
-    m_font->DrawString(m_spriteBatch.get(), output, m_fontPos + Vector2(1.f, 1.f), Colors::Black, 0.f, origin);
-    m_font->DrawString(m_spriteBatch.get(), output, m_fontPos + Vector2(-1.f, 1.f), Colors::Black, 0.f, origin);
+    Vector2 origin = Vector2(layout.size) / 2.f;
 
-    m_font->DrawString(m_spriteBatch.get(), output, m_fontPos, Colors::White, 0.f, origin);
+    DrawTextLayout(m_spriteBatch.get(), m_fontTexture.Get(), layout, m_fontPos + Vector2(1.f, 1.f), Colors::Black, 0.f, origin);
+    DrawTextLayout(m_spriteBatch.get(), m_fontTexture.Get(), layout, m_fontPos + Vector2(-1.f, 1.f), Colors::Black, 0.f, origin);
+
+    DrawTextLayout(m_spriteBatch.get(), m_fontTexture.Get(), layout, m_fontPos, Colors::White, 0.f, origin);
 #endif
 
 #if 0
     const wchar_t* output = L"Hello World";
 
-    Vector2 origin = m_font->MeasureString(output) / 2.f;
+    // Every pass replays the same cached layout.
+    const TextLayout& layout = m_textCache.Get(m_font.get(), output);
 
-    m_font->DrawString(m_spriteBatch.get(), output, m_fontPos + Vector2(1.f, 1.f), Colors::Black, 0.f, origin);
-    m_font->DrawString(m_spriteBatch.get(), output, m_fontPos + Vector2(-1.f, 1.f), Colors::Black, 0.f, origin);
-    m_font->DrawString(m_spriteBatch.get(), output, m_fontPos + Vector2(-1.f, -1.f), Colors::Black, 0.f, origin);
-    m_font->DrawString(m_spriteBatch.get(), output, m_fontPos + Vector2(1.f, -1.f), Colors::Black, 0.f, origin);
+    Vector2 origin = Vector2(layout.size) / 2.f;
 
-    m_font->DrawString(m_spriteBatch.get(), output, m_fontPos, Colors::White, 0.f, origin);
+    DrawTextLayout(m_spriteBatch.get(), m_fontTexture.Get(), layout, m_fontPos + Vector2(1.f, 1.f), Colors::Black, 0.f, origin);
+    DrawTextLayout(m_spriteBatch.get(), m_fontTexture.Get(), layout, m_fontPos + Vector2(-1.f, 1.f), Colors::Black, 0.f, origin);
+    DrawTextLayout(m_spriteBatch.get(), m_fontTexture.Get(), layout, m_fontPos + Vector2(-1.f, -1.f), Colors::Black, 0.f, origin);
+    DrawTextLayout(m_spriteBatch.get(), m_fontTexture.Get(), layout, m_fontPos + Vector2(1.f, -1.f), Colors::Black, 0.f, origin);
+
+    DrawTextLayout(m_spriteBatch.get(), m_fontTexture.Get(), layout, m_fontPos, Colors::White, 0.f, origin);
 #endif
 
 #if 0
@@ -119,17 +131,50 @@ void Game::Render()
 #if 0
     const char *ascii = "Hello World";
 
-    std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
-    std::wstring output = converter.from_bytes(ascii);
+    // Decodes into per-frame storage; replaces std::wstring_convert<std::codecvt_utf8<wchar_t>>.
+    const wchar_t* output = m_utf8Arena.Decode(ascii);
 
-    Vector2 origin = m_font->MeasureString(output.c_str()) / 2.f;
+    Vector2 origin = m_font->MeasureString(output) / 2.f;
 
-    m_font->DrawString(m_spriteBatch.get(), output.c_str(), m_fontPos, Colors::White, 0.f, origin);
+    m_font->DrawString(m_spriteBatch.get(), output, m_fontPos, Colors::White, 0.f, origin);
+
+#endif
+
+#if 0
+    // One distance field atlas drawn at a continuously changing scale.
+    m_spriteBatch->End();
+
+    const float scale = 1.5f + std::sin(float(m_timer.GetTotalSeconds())) * 1.25f;
+    m_sdfText->Begin(m_spriteBatch.get(), m_deviceResources->GetD3DDeviceContext(), scale);
+
+    const wchar_t* output = L"Hello World";
+
+    Vector2 origin = Vector2(m_sdfText->MeasureString(output)) / 2.f;
+
+    m_sdfText->DrawString(m_spriteBatch.get(), output, m_fontPos, Colors::White, 0.f, origin);
+    m_sdfText->Trim();
+#endif
+
+#ifdef USE_LOG
+    // Appending lays out only the new line; Draw emits only the lines inside the clip.
+    wchar_t line[64] = {};
+    swprintf_s(line, L"Frame %u: appended to a %zu line log", m_timer.GetFrameCount(), m_log.GetParagraphCount());
+    m_log.AppendLine(line);
+    if (m_log.GetParagraphCount() > 5000)
+    {
+        m_log.RemoveFront(1);
+    }
 
+    m_log.Update();
+    const float scroll = std::max(0.f, m_log.GetHeight() - float(m_logClip.bottom - m_logClip.top));
+    m_log.Draw(m_spriteBatch.get(), m_logClip, scroll);
 #endif
 
     m_spriteBatch->End();
 
+    m_textCache.Trim();
+    m_utf8Arena.Reset();
+
     m_deviceResources->PIXEndEvent();
 
     // Show the new frame.
@@ -215,6 +260,22 @@ void Game::CreateDeviceDependentResources()
 
     // TODO: Initialize device dependent objects here (independent of window size).
     m_font = std::make_unique<SpriteFont>(device, L"myfile.spritefont");
+    m_font->GetSpriteSheet(m_fontTexture.ReleaseAndGetAddressOf());
+
+    // Generated from myfile.spritefont with MakeSDFFont (spread 4).
+    m_sdfFont = std::make_unique<SpriteFont>(device, L"myfile_sdf.spritefont");
+    m_sdfText = std::make_unique<SdfText>(device, m_sdfFont.get(), 4);
+
+#ifdef USE_LOG
+    m_log.SetFont(m_font.get());
+    for (int i = 0; i < 5000; ++i)
+    {
+        wchar_t line[64] = {};
+        swprintf_s(line, L"Log line %d with enough words to need wrapping in a narrow panel", i);
+        m_log.AppendLine(line);
+    }
+#endif
+
     auto context = m_deviceResources->GetD3DDeviceContext();
     m_spriteBatch = std::make_unique<SpriteBatch>(context);
 }
@@ -226,11 +287,19 @@ void Game::CreateWindowSizeDependentResources()
     auto size = m_deviceResources->GetOutputSize();
     m_fontPos.x = float(size.right) / 2.f;
     m_fontPos.y = float(size.bottom) / 2.f;
+
+    m_logClip = { 16, 16, std::max<LONG>(17, size.right / 2), std::max<LONG>(17, size.bottom - 16) };
+    m_log.SetWrapWidth(float(m_logClip.right - m_logClip.left));
 }
 
 void Game::OnDeviceLost()
 {
     // TODO: Add Direct3D resource cleanup here.
+    m_textCache.Clear();
+    m_log = TextBlock();
+    m_fontTexture.Reset();
+    m_sdfText.reset();
+    m_sdfFont.reset();
     m_font.reset();
     m_spriteBatch.reset();
 }
@@ -6,6 +6,10 @@
 
 #include "DeviceResources.h"
 #include "StepTimer.h"
+#include "SdfText.h"
+#include "TextBlock.h"
+#include "TextLayout.h"
+#include "Utf8Decoder.h"
 
 
 // A basic game implementation that creates a D3D11 device and
@@ -65,4 +69,13 @@ private:
     DirectX::SimpleMath::Vector2            m_fontPos;
     std::unique_ptr<DirectX::SpriteBatch>   m_spriteBatch;
 
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_fontTexture;
+    TextLayoutCache                         m_textCache;
+    Utf8::DecodeArena                       m_utf8Arena;
+    TextBlock                               m_log;
+    RECT                                    m_logClip;
+
+    std::unique_ptr<DirectX::SpriteFont>    m_sdfFont;
+    std::unique_ptr<SdfText>                m_sdfText;
+
 };
\ No newline at end of file
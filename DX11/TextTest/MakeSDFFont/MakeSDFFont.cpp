@@ -0,0 +1,572 @@
+//--------------------------------------------------------------------------------------
+// File: MakeSDFFont.cpp
+//
+// Converts a .spritefont bitmap font into a single signed distance field atlas which
+// SdfText can draw at any scale. Each glyph gets an exact Euclidean distance transform of
+// its coverage; glyphs are processed in parallel. The output is a regular .spritefont with
+// an A8_UNORM texture whose glyph subrects exclude the distance padding, so the layout
+// metrics are those of the source font divided by the downsample factor.
+//
+// -preview renders a string through the CPU reference of SDFText.hlsl to a PGM image.
+//
+// This is a standalone console tool with no Windows or Direct3D dependencies:
+//
+//   g++ -std=c++14 -O2 -pthread -o MakeSDFFont MakeSDFFont.cpp
+//   cl /std:c++14 /O2 /EHsc MakeSDFFont.cpp
+//
+//   MakeSDFFont <input.spritefont> <output.spritefont> [-spread N] [-downsample N]
+//               [-preview <text> <scale> <output.pgm>]
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "../SdfReference.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const char SpriteFontMagic[] = "DXTKfont";
+
+    // Subset of DXGI_FORMAT used by MakeSpriteFont output.
+    enum Format : uint32_t
+    {
+        Format_R8G8B8A8_UNORM = 28,
+        Format_R8G8B8A8_UNORM_SRGB = 29,
+        Format_A8_UNORM = 65,
+        Format_BC2_UNORM = 74,
+        Format_BC3_UNORM = 77,
+        Format_B8G8R8A8_UNORM = 87,
+        Format_B8G8R8A8_UNORM_SRGB = 91,
+    };
+
+    // Matches SpriteFont::Glyph.
+    struct Glyph
+    {
+        uint32_t    character;
+        int32_t     subrect[4];     // left, top, right, bottom
+        float       xOffset;
+        float       yOffset;
+        float       xAdvance;
+    };
+
+    static_assert(sizeof(Glyph) == 32, "Glyph size mismatch");
+
+    struct FontData
+    {
+        std::vector<Glyph>      glyphs;
+        float                   lineSpacing;
+        uint32_t                defaultCharacter;
+        uint32_t                width;
+        uint32_t                height;
+        uint32_t                format;
+        uint32_t                stride;
+        uint32_t                rows;
+        std::vector<uint8_t>    texels;
+    };
+
+    template<typename T>
+    void Read(std::istream& in, T& value)
+    {
+        in.read(reinterpret_cast<char*>(&value), sizeof(T));
+        if (!in)
+            throw std::runtime_error("Truncated .spritefont file");
+    }
+
+    FontData LoadSpriteFont(const char* fileName)
+    {
+        std::ifstream in(fileName, std::ios::in | std::ios::binary);
+        if (!in)
+            throw std::runtime_error("Failed to open input file");
+
+        char magic[8] = {};
+        in.read(magic, sizeof(magic));
+        if (!in || memcmp(magic, SpriteFontMagic, sizeof(magic)) != 0)
+            throw std::runtime_error("Not a .spritefont file");
+
+        FontData font = {};
+
+        uint32_t glyphCount = 0;
+        Read(in, glyphCount);
+        font.glyphs.resize(glyphCount);
+        if (glyphCount)
+        {
+            in.read(reinterpret_cast<char*>(font.glyphs.data()), std::streamsize(glyphCount * sizeof(Glyph)));
+        }
+
+        Read(in, font.lineSpacing);
+        Read(in, font.defaultCharacter);
+        Read(in, font.width);
+        Read(in, font.height);
+        Read(in, font.format);
+        Read(in, font.stride);
+        Read(in, font.rows);
+
+        font.texels.resize(size_t(font.stride) * font.rows);
+        in.read(reinterpret_cast<char*>(font.texels.data()), std::streamsize(font.texels.size()));
+        if (!in)
+            throw std::runtime_error("Truncated .spritefont file");
+
+        for (const auto& glyph : font.glyphs)
+        {
+            if (glyph.subrect[0] < 0 || glyph.subrect[1] < 0
+                || glyph.subrect[2] < glyph.subrect[0] || glyph.subrect[3] < glyph.subrect[1]
+                || uint32_t(glyph.subrect[2]) > font.width || uint32_t(glyph.subrect[3]) > font.height)
+                throw std::runtime_error("Glyph outside of texture");
+        }
+
+        return font;
+    }
+
+    void SaveSpriteFont(const char* fileName, const FontData& font)
+    {
+        std::ofstream out(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out)
+            throw std::runtime_error("Failed to create output file");
+
+        out.write(SpriteFontMagic, 8);
+
+        const auto glyphCount = uint32_t(font.glyphs.size());
+        out.write(reinterpret_cast<const char*>(&glyphCount), sizeof(glyphCount));
+        out.write(reinterpret_cast<const char*>(font.glyphs.data()), std::streamsize(glyphCount * sizeof(Glyph)));
+
+        const uint32_t header[5] = { font.width, font.height, font.format, font.stride, font.rows };
+        out.write(reinterpret_cast<const char*>(&font.lineSpacing), sizeof(float));
+        out.write(reinterpret_cast<const char*>(&font.defaultCharacter), sizeof(uint32_t));
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(font.texels.data()), std::streamsize(font.texels.size()));
+
+        if (!out)
+            throw std::runtime_error("Failed to write output file");
+    }
+
+    // Extracts the alpha channel, which holds glyph coverage in MakeSpriteFont output.
+    std::vector<uint8_t> DecodeCoverage(const FontData& font)
+    {
+        const size_t width = font.width;
+        const size_t height = font.height;
+        std::vector<uint8_t> alpha(width * height);
+
+        switch (font.format)
+        {
+        case Format_A8_UNORM:
+            for (size_t y = 0; y < height; ++y)
+            {
+                memcpy(&alpha[y * width], &font.texels[y * font.stride], width);
+            }
+            break;
+
+        case Format_R8G8B8A8_UNORM:
+        case Format_R8G8B8A8_UNORM_SRGB:
+        case Format_B8G8R8A8_UNORM:
+        case Format_B8G8R8A8_UNORM_SRGB:
+            for (size_t y = 0; y < height; ++y)
+            {
+                for (size_t x = 0; x < width; ++x)
+                {
+                    alpha[y * width + x] = font.texels[y * font.stride + x * 4 + 3];
+                }
+            }
+            break;
+
+        case Format_BC2_UNORM:
+        case Format_BC3_UNORM:
+            for (size_t by = 0; by < (height + 3) / 4; ++by)
+            {
+                for (size_t bx = 0; bx < (width + 3) / 4; ++bx)
+                {
+                    const uint8_t* block = &font.texels[by * font.stride + bx * 16];
+
+                    uint8_t values[16];
+                    if (font.format == Format_BC2_UNORM)
+                    {
+                        // Explicit 4-bit alpha.
+                        for (size_t i = 0; i < 16; ++i)
+                        {
+                            const uint8_t nibble = (block[i / 2] >> ((i & 1) * 4)) & 0xF;
+                            values[i] = uint8_t(nibble * 17);
+                        }
+                    }
+                    else
+                    {
+                        // Interpolated alpha with 3-bit indices.
+                        const uint32_t a0 = block[0];
+                        const uint32_t a1 = block[1];
+                        uint32_t palette[8] = { a0, a1 };
+                        for (uint32_t i = 1; i < 7; ++i)
+                        {
+                            palette[i + 1] = (a0 > a1)
+                                ? ((7 - i) * a0 + i * a1) / 7
+                                : (i < 5 ? ((5 - i) * a0 + i * a1) / 5 : (i == 5 ? 0u : 255u));
+                        }
+
+                        uint64_t bits = 0;
+                        for (size_t i = 0; i < 6; ++i)
+                        {
+                            bits |= uint64_t(block[2 + i]) << (8 * i);
+                        }
+
+                        for (size_t i = 0; i < 16; ++i)
+                        {
+                            values[i] = uint8_t(palette[(bits >> (3 * i)) & 7]);
+                        }
+                    }
+
+                    for (size_t i = 0; i < 16; ++i)
+                    {
+                        const size_t x = bx * 4 + (i & 3);
+                        const size_t y = by * 4 + (i >> 2);
+                        if (x < width && y < height)
+                        {
+                            alpha[y * width + x] = values[i];
+                        }
+                    }
+                }
+            }
+            break;
+
+        default:
+            throw std::runtime_error("Unsupported texture format (use MakeSpriteFont /TextureFormat:Rgba32 or CompressedMono)");
+        }
+
+        return alpha;
+    }
+
+    struct Placement
+    {
+        uint32_t    x;
+        uint32_t    y;
+        uint32_t    width;
+        uint32_t    height;
+    };
+
+    // Shelf packing by decreasing height; returns the atlas height for the given width.
+    uint32_t PackGlyphs(const std::vector<Placement>& sizes, uint32_t atlasWidth, std::vector<Placement>& placements)
+    {
+        std::vector<size_t> order(sizes.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            order[i] = i;
+        }
+
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+        {
+            return sizes[a].height > sizes[b].height;
+        });
+
+        placements = sizes;
+
+        // One empty texel between glyphs keeps bilinear filtering from reading neighbors.
+        const uint32_t gap = 1;
+        uint32_t x = 0;
+        uint32_t y = 0;
+        uint32_t shelfHeight = 0;
+
+        for (size_t i : order)
+        {
+            Placement& p = placements[i];
+            if (!p.width || !p.height)
+            {
+                p.x = p.y = 0;
+                continue;
+            }
+
+            if (p.width > atlasWidth)
+                return UINT32_MAX;
+
+            if (x + p.width > atlasWidth)
+            {
+                x = 0;
+                y += shelfHeight + gap;
+                shelfHeight = 0;
+            }
+
+            p.x = x;
+            p.y = y;
+            x += p.width + gap;
+            shelfHeight = std::max(shelfHeight, p.height);
+        }
+
+        return y + shelfHeight;
+    }
+
+    // Draws text with the output font using the CPU reference of SDFText.hlsl, following the
+    // SpriteFont layout rules, and writes the coverage as a binary PGM.
+    void RenderPreview(const FontData& font, int spread, const char* text, float scale, const char* fileName)
+    {
+        auto lookup = [&](uint32_t character) -> const Glyph*
+        {
+            auto it = std::lower_bound(font.glyphs.cbegin(), font.glyphs.cend(), character,
+                [](const Glyph& glyph, uint32_t c) { return glyph.character < c; });
+            return (it != font.glyphs.cend() && it->character == character) ? &*it : nullptr;
+        };
+
+        auto findGlyph = [&](uint32_t character) -> const Glyph*
+        {
+            const Glyph* glyph = lookup(character);
+            return (!glyph && font.defaultCharacter) ? lookup(font.defaultCharacter) : glyph;
+        };
+
+        struct Quad { const Glyph* glyph; float x; float y; };
+        std::vector<Quad> quads;
+
+        float x = 0.f;
+        float y = 0.f;
+        float maxX = 0.f;
+        for (const char* c = text; *c; ++c)
+        {
+            if (*c == '\n')
+            {
+                x = 0.f;
+                y += font.lineSpacing;
+                continue;
+            }
+
+            const Glyph* glyph = findGlyph(uint8_t(*c));
+            if (!glyph)
+                throw std::runtime_error("Preview text uses a character missing from the font");
+
+            x += glyph->xOffset;
+            if (x < 0.f)
+                x = 0.f;
+
+            const float w = float(glyph->subrect[2] - glyph->subrect[0]);
+            quads.push_back(Quad{ glyph, x, y + glyph->yOffset });
+            x += w + glyph->xAdvance;
+            maxX = std::max(maxX, x);
+        }
+
+        const float margin = float(spread);
+        const int imageWidth = int(std::ceil((maxX + 2.f * margin) * scale));
+        const int imageHeight = int(std::ceil((y + font.lineSpacing + 2.f * margin) * scale));
+        std::vector<float> image(size_t(imageWidth) * size_t(imageHeight), 0.f);
+
+        const float distanceScale = Sdf::DistanceScale(float(spread), scale);
+
+        for (const auto& quad : quads)
+        {
+            // SdfText draws the subrect grown by the padding.
+            const float left = float(quad.glyph->subrect[0] - spread);
+            const float top = float(quad.glyph->subrect[1] - spread);
+            const float w = float(quad.glyph->subrect[2] - quad.glyph->subrect[0] + 2 * spread);
+            const float h = float(quad.glyph->subrect[3] - quad.glyph->subrect[1] + 2 * spread);
+            if (w <= 2.f * float(spread) || h <= 2.f * float(spread))
+                continue;
+
+            const float dx = (quad.x - float(spread) + margin) * scale;
+            const float dy = (quad.y - float(spread) + margin) * scale;
+
+            const int x0 = std::max(0, int(std::floor(dx)));
+            const int y0 = std::max(0, int(std::floor(dy)));
+            const int x1 = std::min(imageWidth, int(std::ceil(dx + w * scale)));
+            const int y1 = std::min(imageHeight, int(std::ceil(dy + h * scale)));
+
+            for (int py = y0; py < y1; ++py)
+            {
+                const float v = (float(py) + 0.5f - dy) / scale;
+                if (v < 0.f || v >= h)
+                    continue;
+
+                for (int px = x0; px < x1; ++px)
+                {
+                    const float u = (float(px) + 0.5f - dx) / scale;
+                    if (u < 0.f || u >= w)
+                        continue;
+
+                    const float d = Sdf::SampleBilinear(font.texels.data(), int(font.width), int(font.height), font.stride, left + u, top + v);
+                    const float alpha = Sdf::Shade(d, distanceScale);
+
+                    // Premultiplied alpha blending of white text over black.
+                    float& dest = image[size_t(py) * size_t(imageWidth) + size_t(px)];
+                    dest = alpha + dest * (1.f - alpha);
+                }
+            }
+        }
+
+        std::ofstream out(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out)
+            throw std::runtime_error("Failed to create preview file");
+
+        const std::string header = "P5\n" + std::to_string(imageWidth) + " " + std::to_string(imageHeight) + "\n255\n";
+        out.write(header.data(), std::streamsize(header.size()));
+        for (float value : image)
+        {
+            out.put(char(uint8_t(std::min(std::max(value, 0.f), 1.f) * 255.f + 0.5f)));
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        printf("Usage: MakeSDFFont <input.spritefont> <output.spritefont> [-spread N] [-downsample N]\n"
+               "                  [-preview <text> <scale> <output.pgm>]\n");
+        return 1;
+    }
+
+    int spread = 4;
+    int downsample = 1;
+    const char* previewText = nullptr;
+    float previewScale = 1.f;
+    const char* previewFile = nullptr;
+
+    for (int i = 3; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-spread") && i + 1 < argc)
+        {
+            spread = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-downsample") && i + 1 < argc)
+        {
+            downsample = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-preview") && i + 3 < argc)
+        {
+            previewText = argv[++i];
+            previewScale = float(atof(argv[++i]));
+            previewFile = argv[++i];
+        }
+        else
+        {
+            printf("ERROR: Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (spread < 1 || spread > 64 || downsample < 1 || downsample > 16 || previewScale <= 0.f)
+    {
+        printf("ERROR: Invalid -spread, -downsample or -preview scale\n");
+        return 1;
+    }
+
+    try
+    {
+        const FontData source = LoadSpriteFont(argv[1]);
+        const std::vector<uint8_t> coverage = DecodeCoverage(source);
+
+        const auto start = std::chrono::high_resolution_clock::now();
+
+        // Padded output size of each glyph.
+        std::vector<Placement> sizes(source.glyphs.size());
+        uint64_t area = 0;
+        for (size_t i = 0; i < sizes.size(); ++i)
+        {
+            const int32_t* r = source.glyphs[i].subrect;
+            sizes[i].width = uint32_t(Sdf::GlyphGenerator::OutputSize(r[2] - r[0], downsample, spread));
+            sizes[i].height = uint32_t(Sdf::GlyphGenerator::OutputSize(r[3] - r[1], downsample, spread));
+            area += uint64_t(sizes[i].width + 1) * (sizes[i].height + 1);
+        }
+
+        // Smallest power of two width that gives a roughly square atlas.
+        uint32_t atlasWidth = 64;
+        while (uint64_t(atlasWidth) * atlasWidth < area && atlasWidth < 16384)
+        {
+            atlasWidth *= 2;
+        }
+
+        std::vector<Placement> placements;
+        uint32_t atlasHeight = PackGlyphs(sizes, atlasWidth, placements);
+        while (atlasHeight > atlasWidth && atlasWidth < 16384)
+        {
+            atlasWidth *= 2;
+            atlasHeight = PackGlyphs(sizes, atlasWidth, placements);
+        }
+
+        if (atlasHeight > 16384)
+            throw std::runtime_error("Glyphs do not fit in a 16384 texture");
+
+        FontData output = {};
+        output.glyphs = source.glyphs;
+        output.lineSpacing = source.lineSpacing / float(downsample);
+        output.defaultCharacter = source.defaultCharacter;
+        output.width = atlasWidth;
+        output.height = std::max(atlasHeight, 1u);
+        output.format = Format_A8_UNORM;
+        output.stride = atlasWidth;
+        output.rows = output.height;
+        output.texels.assign(size_t(output.stride) * output.rows, 0);
+
+        // Each worker writes its glyphs into their own region of the atlas.
+        std::atomic<size_t> next(0);
+        auto worker = [&]()
+        {
+            Sdf::GlyphGenerator generator;
+            for (size_t i = next++; i < source.glyphs.size(); i = next++)
+            {
+                const int32_t* r = source.glyphs[i].subrect;
+                const Placement& p = placements[i];
+                if (!p.width || !p.height)
+                    continue;
+
+                generator.Generate(&coverage[size_t(r[1]) * source.width + size_t(r[0])], r[2] - r[0], r[3] - r[1],
+                    source.width, downsample, spread, &output.texels[size_t(p.y) * output.stride + p.x], output.stride);
+            }
+        };
+
+        const size_t threadCount = std::max(1u, std::min(std::thread::hardware_concurrency(), 64u));
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < threadCount; ++t)
+        {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        // Subrects exclude the padding and metrics scale with the downsample factor.
+        for (size_t i = 0; i < output.glyphs.size(); ++i)
+        {
+            const Glyph& src = source.glyphs[i];
+            Glyph& glyph = output.glyphs[i];
+            const Placement& p = placements[i];
+
+            const int32_t srcWidth = src.subrect[2] - src.subrect[0];
+            const int32_t width = p.width ? int32_t(p.width) - 2 * spread : 0;
+            const int32_t height = p.height ? int32_t(p.height) - 2 * spread : 0;
+
+            glyph.subrect[0] = p.width ? int32_t(p.x) + spread : 0;
+            glyph.subrect[1] = p.height ? int32_t(p.y) + spread : 0;
+            glyph.subrect[2] = glyph.subrect[0] + width;
+            glyph.subrect[3] = glyph.subrect[1] + height;
+            glyph.xOffset = src.xOffset / float(downsample);
+            glyph.yOffset = src.yOffset / float(downsample);
+            glyph.xAdvance = (float(srcWidth) + src.xAdvance) / float(downsample) - float(width);
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        SaveSpriteFont(argv[2], output);
+
+        printf("%zu glyphs, %ux%u atlas, spread %d, downsample %d, %zu threads, %.1f ms\n",
+            output.glyphs.size(), output.width, output.height, spread, downsample, threadCount, seconds * 1e3);
+        printf("Draw with SdfText using a spread of %d\n", spread);
+
+        if (previewText)
+        {
+            RenderPreview(output, spread, previewText, previewScale, previewFile);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        printf("ERROR: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+Texture2D<float4> Texture : register(t0);
+sampler TextureSampler : register(s0);
+
+cbuffer SDF_PARAMETERS : register(b0)
+{
+    // Screen pixels per unit of encoded distance: 2 * spread * scale.
+    float DistanceScale;
+}
+
+// The atlas stores 0.5 + distance / (2 * spread); 0.5 is the glyph edge. Sdf::Shade in
+// SdfReference.h is the CPU reference of this shader.
+float4 main(float4 color : COLOR0, float2 texCoord : TEXCOORD0) : SV_Target0
+{
+    float distance = Texture.Sample(TextureSampler, texCoord).a;
+    float alpha = saturate((distance - 0.5) * DistanceScale + 0.5);
+    return color * alpha;
+}
@@ -0,0 +1,251 @@
+//--------------------------------------------------------------------------------------
+// File: SdfReference.h
+//
+// Signed distance field helpers shared by the MakeSDFFont tool and the SDF text draw path:
+// an exact Euclidean distance transform (Felzenszwalb & Huttenlocher), glyph SDF
+// generation, and a CPU reference of SDFText.hlsl for testing. This header has no Windows
+// dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace Sdf
+{
+    // Distances are stored as 0.5 + distance / (2 * spread), so 0.5 is the glyph edge and
+    // texels further than spread from the edge saturate.
+    inline uint8_t EncodeDistance(float distance, float spread) noexcept
+    {
+        const float v = 0.5f + distance / (2.f * spread);
+        return uint8_t(std::min(std::max(v, 0.f), 1.f) * 255.f + 0.5f);
+    }
+
+    class DistanceTransform
+    {
+    public:
+        DistanceTransform() = default;
+
+        DistanceTransform(DistanceTransform&&) = default;
+        DistanceTransform& operator= (DistanceTransform&&) = default;
+
+        DistanceTransform(DistanceTransform const&) = delete;
+        DistanceTransform& operator= (DistanceTransform const&) = delete;
+
+        // In-place squared Euclidean distance transform. Feature cells are 0 on input, all
+        // others Infinity(); on output each cell holds the squared distance to the nearest
+        // feature cell. Exact, and linear in the number of cells.
+        void Transform(float* grid, int width, int height)
+        {
+            const int n = std::max(width, height);
+            m_f.resize(size_t(n));
+            m_d.resize(size_t(n));
+            m_v.resize(size_t(n));
+            m_z.resize(size_t(n) + 1);
+
+            for (int x = 0; x < width; ++x)
+            {
+                for (int y = 0; y < height; ++y)
+                {
+                    m_f[size_t(y)] = grid[size_t(y) * size_t(width) + size_t(x)];
+                }
+                Transform1D(height);
+                for (int y = 0; y < height; ++y)
+                {
+                    grid[size_t(y) * size_t(width) + size_t(x)] = m_d[size_t(y)];
+                }
+            }
+
+            for (int y = 0; y < height; ++y)
+            {
+                float* row = grid + size_t(y) * size_t(width);
+                std::copy(row, row + width, m_f.begin());
+                Transform1D(width);
+                std::copy(m_d.begin(), m_d.begin() + width, row);
+            }
+        }
+
+        static float Infinity() noexcept { return 1e20f; }
+
+    private:
+        // Lower envelope of parabolas rooted at each sample.
+        void Transform1D(int n)
+        {
+            int k = 0;
+            m_v[0] = 0;
+            m_z[0] = -std::numeric_limits<float>::infinity();
+            m_z[1] = std::numeric_limits<float>::infinity();
+
+            for (int q = 1; q < n; ++q)
+            {
+                const float fq = m_f[size_t(q)] + float(q) * float(q);
+                float s = Intersect(fq, q, m_v[size_t(k)]);
+                while (s <= m_z[size_t(k)])
+                {
+                    --k;
+                    s = Intersect(fq, q, m_v[size_t(k)]);
+                }
+
+                ++k;
+                m_v[size_t(k)] = q;
+                m_z[size_t(k)] = s;
+                m_z[size_t(k) + 1] = std::numeric_limits<float>::infinity();
+            }
+
+            k = 0;
+            for (int q = 0; q < n; ++q)
+            {
+                while (m_z[size_t(k) + 1] < float(q))
+                    ++k;
+
+                const float d = float(q - m_v[size_t(k)]);
+                m_d[size_t(q)] = d * d + m_f[size_t(m_v[size_t(k)])];
+            }
+        }
+
+        float Intersect(float fq, int q, int p) const noexcept
+        {
+            return (fq - (m_f[size_t(p)] + float(p) * float(p))) / float(2 * (q - p));
+        }
+
+        std::vector<float>  m_f;
+        std::vector<float>  m_d;
+        std::vector<int>    m_v;
+        std::vector<float>  m_z;
+    };
+
+    // Builds the distance field of one glyph. coverage is width x height with texels >= 128
+    // inside. The output is (ceil(width / downsample) + 2 * spread) texels wide (likewise
+    // for height), so the glyph starts spread texels in from the top-left.
+    class GlyphGenerator
+    {
+    public:
+        GlyphGenerator() = default;
+
+        GlyphGenerator(GlyphGenerator&&) = default;
+        GlyphGenerator& operator= (GlyphGenerator&&) = default;
+
+        GlyphGenerator(GlyphGenerator const&) = delete;
+        GlyphGenerator& operator= (GlyphGenerator const&) = delete;
+
+        static int OutputSize(int size, int downsample, int spread) noexcept
+        {
+            return size > 0 ? (size + downsample - 1) / downsample + 2 * spread : 0;
+        }
+
+        void Generate(const uint8_t* coverage, int width, int height, size_t pitch, int downsample, int spread,
+            uint8_t* out, size_t outPitch)
+        {
+            if (downsample < 1 || spread < 1)
+                throw std::invalid_argument("GlyphGenerator");
+
+            const int outWidth = OutputSize(width, downsample, spread);
+            const int outHeight = OutputSize(height, downsample, spread);
+            if (!outWidth || !outHeight)
+                return;
+
+            // Work in source texels over the padded output footprint.
+            const int pad = spread * downsample;
+            const int w = outWidth * downsample;
+            const int h = outHeight * downsample;
+            const size_t count = size_t(w) * size_t(h);
+
+            m_inside.assign(count, 0);
+            for (int y = 0; y < height; ++y)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    m_inside[size_t(y + pad) * size_t(w) + size_t(x + pad)] = coverage[size_t(y) * pitch + size_t(x)] >= 128 ? 1 : 0;
+                }
+            }
+
+            // Squared distance from each texel to the nearest inside and outside texel.
+            m_toInside.resize(count);
+            m_toOutside.resize(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                m_toInside[i] = m_inside[i] ? 0.f : DistanceTransform::Infinity();
+                m_toOutside[i] = m_inside[i] ? DistanceTransform::Infinity() : 0.f;
+            }
+
+            m_transform.Transform(m_toInside.data(), w, h);
+            m_transform.Transform(m_toOutside.data(), w, h);
+
+            // Average each downsample x downsample block of signed distances. Texel centers
+            // are half a texel from the edge they border.
+            const float scale = 1.f / (float(downsample) * float(downsample) * float(downsample));
+            for (int oy = 0; oy < outHeight; ++oy)
+            {
+                for (int ox = 0; ox < outWidth; ++ox)
+                {
+                    float sum = 0.f;
+                    for (int sy = 0; sy < downsample; ++sy)
+                    {
+                        const size_t row = size_t(oy * downsample + sy) * size_t(w);
+                        for (int sx = 0; sx < downsample; ++sx)
+                        {
+                            const size_t i = row + size_t(ox * downsample + sx);
+                            sum += m_inside[i]
+                                ? (std::sqrt(m_toOutside[i]) - 0.5f)
+                                : -(std::sqrt(m_toInside[i]) - 0.5f);
+                        }
+                    }
+
+                    out[size_t(oy) * outPitch + size_t(ox)] = EncodeDistance(sum * scale, float(spread));
+                }
+            }
+        }
+
+    private:
+        DistanceTransform       m_transform;
+        std::vector<uint8_t>    m_inside;
+        std::vector<float>      m_toInside;
+        std::vector<float>      m_toOutside;
+    };
+
+    // Texture.Sample with a linear filter and clamp addressing; u and v are in texels.
+    inline float SampleBilinear(const uint8_t* texels, int width, int height, size_t pitch, float u, float v) noexcept
+    {
+        const float x = u - 0.5f;
+        const float y = v - 0.5f;
+        const float fx = std::floor(x);
+        const float fy = std::floor(y);
+        const float tx = x - fx;
+        const float ty = y - fy;
+
+        auto fetch = [&](int px, int py)
+        {
+            px = std::min(std::max(px, 0), width - 1);
+            py = std::min(std::max(py, 0), height - 1);
+            return float(texels[size_t(py) * pitch + size_t(px)]) * (1.f / 255.f);
+        };
+
+        const int x0 = int(fx);
+        const int y0 = int(fy);
+        const float top = fetch(x0, y0) + (fetch(x0 + 1, y0) - fetch(x0, y0)) * tx;
+        const float bottom = fetch(x0, y0 + 1) + (fetch(x0 + 1, y0 + 1) - fetch(x0, y0 + 1)) * tx;
+        return top + (bottom - top) * ty;
+    }
+
+    // Matches the constant SdfText computes for SDFText.hlsl: screen pixels per unit of
+    // encoded distance at the given draw scale.
+    inline float DistanceScale(float spread, float scale) noexcept
+    {
+        return 2.f * spread * scale;
+    }
+
+    // CPU reference of SDFText.hlsl: coverage for an encoded distance sample.
+    inline float Shade(float distance, float distanceScale) noexcept
+    {
+        const float alpha = (distance - 0.5f) * distanceScale + 0.5f;
+        return std::min(std::max(alpha, 0.f), 1.f);
+    }
+}
@@ -0,0 +1,117 @@
+//--------------------------------------------------------------------------------------
+// File: SdfText.h
+//
+// Draws text from a signed distance field font made by MakeSDFFont. One atlas serves every
+// scale: SDFText.hlsl turns the filtered distance into coverage with a transition one
+// screen pixel wide at the scale passed to Begin.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <stdexcept>
+
+#include "ReadData.h"
+#include "SdfReference.h"
+#include "TextLayout.h"
+
+class SdfText
+{
+public:
+    // spread must match the value MakeSDFFont used for the font.
+    SdfText(ID3D11Device* device, const DirectX::SpriteFont* font, int spread) :
+        m_font(font),
+        m_spread(spread),
+        m_scale(1.f)
+    {
+        if (!device || !font || spread < 1)
+            throw std::invalid_argument("SdfText");
+
+        font->GetSpriteSheet(m_texture.GetAddressOf());
+
+        auto blob = DX::ReadData(L"SDFText.cso");
+        DX::ThrowIfFailed(device->CreatePixelShader(blob.data(), blob.size(), nullptr, m_pixelShader.ReleaseAndGetAddressOf()));
+
+        CD3D11_BUFFER_DESC cbDesc(sizeof(Parameters), D3D11_BIND_CONSTANT_BUFFER);
+        DX::ThrowIfFailed(device->CreateBuffer(&cbDesc, nullptr, m_parameters.ReleaseAndGetAddressOf()));
+    }
+
+    SdfText(SdfText&&) = default;
+    SdfText& operator= (SdfText&&) = default;
+
+    SdfText(SdfText const&) = delete;
+    SdfText& operator= (SdfText const&) = delete;
+
+    // Starts a batch drawing text at the given scale. Text in one batch shares the scale so
+    // the edge width stays one pixel.
+    void XM_CALLCONV Begin(DirectX::SpriteBatch* batch, ID3D11DeviceContext* context, float scale,
+        ID3D11BlendState* blendState = nullptr,
+        DirectX::FXMMATRIX transformMatrix = DirectX::XMMatrixIdentity())
+    {
+        if (scale <= 0.f)
+            throw std::invalid_argument("Begin");
+
+        m_scale = scale;
+
+        const Parameters parameters = { Sdf::DistanceScale(float(m_spread), scale), {} };
+        context->UpdateSubresource(m_parameters.Get(), 0, nullptr, &parameters, 0, 0);
+
+        batch->Begin(DirectX::SpriteSortMode_Deferred, blendState, nullptr, nullptr, nullptr,
+            [=]()
+            {
+                context->PSSetConstantBuffers(0, 1, m_parameters.GetAddressOf());
+                context->PSSetShader(m_pixelShader.Get(), nullptr, 0);
+            },
+            transformMatrix);
+    }
+
+    // Unscaled size of the text; multiply by the Begin scale for pixels.
+    DirectX::XMFLOAT2 MeasureString(const wchar_t* text)
+    {
+        return m_layouts.Get(m_font, text).size;
+    }
+
+    // origin is in unscaled font units, as for SpriteFont::DrawString.
+    void XM_CALLCONV DrawString(DirectX::SpriteBatch* batch, const wchar_t* text, DirectX::XMFLOAT2 const& position,
+        DirectX::FXMVECTOR color = DirectX::Colors::White, float rotation = 0,
+        DirectX::XMFLOAT2 const& origin = DirectX::XMFLOAT2(0, 0), float layerDepth = 0)
+    {
+        const TextLayout& layout = m_layouts.Get(m_font, text);
+
+        const auto spread = LONG(m_spread);
+        for (const auto& quad : layout.quads)
+        {
+            // Grow each glyph by the distance padding around its subrect in the atlas.
+            const RECT source = { quad.subrect.left - spread, quad.subrect.top - spread,
+                quad.subrect.right + spread, quad.subrect.bottom + spread };
+
+            const DirectX::XMFLOAT2 glyphOrigin(origin.x - quad.offset.x + float(spread), origin.y - quad.offset.y + float(spread));
+
+            batch->Draw(m_texture.Get(), position, &source, color, rotation, glyphOrigin, m_scale, DirectX::SpriteEffects_None, layerDepth);
+        }
+    }
+
+    // Call once per frame to release layouts of strings no longer drawn.
+    void Trim() { m_layouts.Trim(); }
+
+    int GetSpread() const noexcept { return m_spread; }
+
+private:
+    struct Parameters
+    {
+        float   distanceScale;
+        float   padding[3];
+    };
+
+    static_assert((sizeof(Parameters) % 16) == 0, "CB size not padded correctly");
+
+    const DirectX::SpriteFont*                          m_font;
+    int                                                 m_spread;
+    float                                               m_scale;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_texture;
+    Microsoft::WRL::ComPtr<ID3D11PixelShader>           m_pixelShader;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>                m_parameters;
+    TextLayoutCache                                     m_layouts;
+};
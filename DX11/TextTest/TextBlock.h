@@ -0,0 +1,308 @@
+//--------------------------------------------------------------------------------------
+// File: TextBlock.h
+//
+// Multi-line, word-wrapped text for logs and tooltips. Each appended paragraph is laid out
+// once with BuildTextLayout; appending or removing paragraphs does not touch the others.
+// Drawing emits only the lines inside the scrolled clip rectangle.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <string>
+
+#include "TextLayout.h"
+
+class TextBlock
+{
+public:
+    enum Alignment
+    {
+        Alignment_Left,
+        Alignment_Center,
+        Alignment_Right,
+    };
+
+    TextBlock() noexcept :
+        m_font(nullptr),
+        m_wrapWidth(0.f),
+        m_lineSpacing(0.f),
+        m_alignment(Alignment_Left),
+        m_dirty(false),
+        m_removedLines(0),
+        m_glyphCount(0),
+        m_drawnGlyphs(0),
+        m_drawnLines(0)
+    {
+    }
+
+    TextBlock(TextBlock&&) = default;
+    TextBlock& operator= (TextBlock&&) = default;
+
+    TextBlock(TextBlock const&) = delete;
+    TextBlock& operator= (TextBlock const&) = delete;
+
+    // Changing the font or wrap width re-lays out every paragraph on the next Update or Draw;
+    // the line and glyph counts are stale until then.
+    void SetFont(const DirectX::SpriteFont* font)
+    {
+        if (!font)
+            throw std::invalid_argument("SetFont");
+
+        if (font != m_font)
+        {
+            m_font = font;
+            font->GetSpriteSheet(m_texture.ReleaseAndGetAddressOf());
+            m_dirty = !m_paragraphs.empty();
+        }
+    }
+
+    // A width of zero disables wrapping.
+    void SetWrapWidth(float width) noexcept
+    {
+        if (width != m_wrapWidth)
+        {
+            m_wrapWidth = width;
+            m_dirty = !m_paragraphs.empty();
+        }
+    }
+
+    // Zero uses SpriteFont::GetLineSpacing. Does not require a relayout.
+    void SetLineSpacing(float spacing) noexcept { m_lineSpacing = spacing; }
+
+    void SetAlignment(Alignment alignment) noexcept { m_alignment = alignment; }
+
+    void AppendLine(const wchar_t* text)
+    {
+        AppendLine(text, text ? wcslen(text) : 0);
+    }
+
+    void AppendLine(const wchar_t* text, size_t length)
+    {
+        if (!m_font)
+            throw std::logic_error("TextBlock needs a font before AppendLine");
+
+        m_firstLine.push_back(GetLineCount() + m_removedLines);
+
+        m_paragraphs.emplace_back();
+        Paragraph& paragraph = m_paragraphs.back();
+        paragraph.text.assign(text ? text : L"", length);
+
+        if (!m_dirty)
+        {
+            Layout(paragraph);
+        }
+    }
+
+    // Drops the oldest paragraphs, e.g. to cap a log at a fixed number of entries.
+    void RemoveFront(size_t count)
+    {
+        count = std::min(count, m_paragraphs.size());
+        for (size_t j = 0; j < count; ++j)
+        {
+            const Paragraph& paragraph = m_paragraphs.front();
+            m_removedLines += paragraph.lineCount;
+            m_glyphCount -= paragraph.layout.quads.size();
+
+            m_paragraphs.pop_front();
+            m_firstLine.pop_front();
+        }
+    }
+
+    void Clear() noexcept
+    {
+        m_paragraphs.clear();
+        m_firstLine.clear();
+        m_removedLines = 0;
+        m_glyphCount = 0;
+    }
+
+    // Lays out any paragraphs invalidated by SetFont or SetWrapWidth.
+    void Update()
+    {
+        if (!m_dirty || !m_font)
+            return;
+
+        m_glyphCount = 0;
+        m_removedLines = 0;
+
+        size_t line = 0;
+        for (size_t j = 0; j < m_paragraphs.size(); ++j)
+        {
+            m_firstLine[j] = line;
+            Layout(m_paragraphs[j]);
+            line += m_paragraphs[j].lineCount;
+        }
+
+        m_dirty = false;
+    }
+
+    // Draws the lines visible through clip, with the text scrolled up by scrollY pixels.
+    // Glyphs straddling the clip edges are trimmed through their source rectangles.
+    void XM_CALLCONV Draw(DirectX::SpriteBatch* batch, RECT const& clip, float scrollY,
+        DirectX::FXMVECTOR color = DirectX::Colors::White, float layerDepth = 0)
+    {
+        m_drawnGlyphs = 0;
+        m_drawnLines = 0;
+
+        Update();
+
+        if (m_paragraphs.empty())
+            return;
+
+        const float lineHeight = GetLineHeight();
+        const float fontSpacing = m_font->GetLineSpacing();
+        const float clipHeight = float(clip.bottom - clip.top);
+        const float clipWidth = float(clip.right - clip.left);
+        const float alignWidth = (m_wrapWidth > 0.f) ? m_wrapWidth : clipWidth;
+
+        const size_t lineCount = GetLineCount();
+        const float firstVisible = std::max(0.f, std::floor(scrollY / lineHeight));
+        if (size_t(firstVisible) >= lineCount)
+            return;
+
+        const size_t first = size_t(firstVisible);
+        const size_t last = std::min(lineCount, size_t(std::ceil((scrollY + clipHeight) / lineHeight)));
+
+        // Find the paragraph holding the first visible line.
+        const size_t absoluteFirst = first + m_removedLines;
+        auto it = std::upper_bound(m_firstLine.cbegin(), m_firstLine.cend(), absoluteFirst);
+        size_t p = size_t(it - m_firstLine.cbegin()) - 1;
+
+        for (size_t line = first; line < last && p < m_paragraphs.size(); ++p)
+        {
+            const Paragraph& paragraph = m_paragraphs[p];
+            size_t local = line + m_removedLines - m_firstLine[p];
+
+            for (; local < paragraph.lineCount && line < last; ++local, ++line)
+            {
+                ++m_drawnLines;
+
+                if (paragraph.layout.lines.empty())
+                    continue;
+
+                const auto& textLine = paragraph.layout.lines[local];
+
+                float alignX = 0.f;
+                switch (m_alignment)
+                {
+                case Alignment_Center:  alignX = std::floor((alignWidth - textLine.width) * 0.5f); break;
+                case Alignment_Right:   alignX = alignWidth - textLine.width; break;
+                default: break;
+                }
+
+                const float lineX = float(clip.left) + alignX;
+                const float lineY = float(clip.top) + float(line) * lineHeight - scrollY - float(local) * fontSpacing;
+
+                for (uint32_t k = 0; k < textLine.quadCount; ++k)
+                {
+                    const auto& quad = paragraph.layout.quads[textLine.firstQuad + k];
+                    DrawClipped(batch, quad, lineX, lineY, clip, color, layerDepth);
+                }
+            }
+        }
+    }
+
+    float GetLineHeight() const noexcept
+    {
+        return (m_lineSpacing > 0.f) ? m_lineSpacing : (m_font ? m_font->GetLineSpacing() : 0.f);
+    }
+
+    // Total height of the laid-out text, for scroll bars and scrolling to the end.
+    float GetHeight() const noexcept { return float(GetLineCount()) * GetLineHeight(); }
+
+    size_t GetParagraphCount() const noexcept { return m_paragraphs.size(); }
+
+    // Wrapped (visual) lines and glyphs across all paragraphs.
+    size_t GetLineCount() const noexcept
+    {
+        return m_paragraphs.empty() ? 0 : (m_firstLine.back() + m_paragraphs.back().lineCount - m_removedLines);
+    }
+
+    size_t GetGlyphCount() const noexcept { return m_glyphCount; }
+
+    // Counts from the last Draw.
+    size_t GetDrawnLineCount() const noexcept { return m_drawnLines; }
+    size_t GetDrawnGlyphCount() const noexcept { return m_drawnGlyphs; }
+
+private:
+    struct Paragraph
+    {
+        Paragraph() noexcept : lineCount(0), layout{} {}
+
+        std::wstring    text;
+        size_t          lineCount;
+        TextLayout      layout;
+    };
+
+    void Layout(Paragraph& paragraph)
+    {
+        BuildTextLayout(*m_font, paragraph.text.c_str(), paragraph.text.size(), m_wrapWidth, paragraph.layout);
+
+        // An empty paragraph still occupies a line.
+        paragraph.lineCount = std::max<size_t>(1, paragraph.layout.lines.size());
+        m_glyphCount += paragraph.layout.quads.size();
+    }
+
+    void XM_CALLCONV DrawClipped(DirectX::SpriteBatch* batch, TextLayout::GlyphQuad const& quad, float lineX, float lineY,
+        RECT const& clip, DirectX::FXMVECTOR color, float layerDepth)
+    {
+        float left = lineX + quad.offset.x;
+        float top = lineY + quad.offset.y;
+        RECT subrect = quad.subrect;
+
+        const float right = left + float(subrect.right - subrect.left);
+        const float bottom = top + float(subrect.bottom - subrect.top);
+
+        if (right <= float(clip.left) || left >= float(clip.right) || bottom <= float(clip.top) || top >= float(clip.bottom))
+            return;
+
+        if (left < float(clip.left))
+        {
+            const auto cut = LONG(std::ceil(float(clip.left) - left));
+            subrect.left += cut;
+            left += float(cut);
+        }
+        if (top < float(clip.top))
+        {
+            const auto cut = LONG(std::ceil(float(clip.top) - top));
+            subrect.top += cut;
+            top += float(cut);
+        }
+        if (right > float(clip.right))
+        {
+            subrect.right -= LONG(std::ceil(right - float(clip.right)));
+        }
+        if (bottom > float(clip.bottom))
+        {
+            subrect.bottom -= LONG(std::ceil(bottom - float(clip.bottom)));
+        }
+
+        if (subrect.right <= subrect.left || subrect.bottom <= subrect.top)
+            return;
+
+        batch->Draw(m_texture.Get(), DirectX::XMFLOAT2(left, top), &subrect, color, 0.f, DirectX::XMFLOAT2(0, 0), 1.f,
+            DirectX::SpriteEffects_None, layerDepth);
+        ++m_drawnGlyphs;
+    }
+
+    const DirectX::SpriteFont*                          m_font;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_texture;
+    float                                               m_wrapWidth;
+    float                                               m_lineSpacing;
+    Alignment                                           m_alignment;
+    bool                                                m_dirty;
+    size_t                                              m_removedLines;
+    size_t                                              m_glyphCount;
+    size_t                                              m_drawnGlyphs;
+    size_t                                              m_drawnLines;
+    std::deque<Paragraph>                               m_paragraphs;
+    std::deque<size_t>                                  m_firstLine;     // First line of each paragraph, counting removed lines
+};
@@ -0,0 +1,294 @@
+//--------------------------------------------------------------------------------------
+// File: TextLayout.h
+//
+// Cached text layout for SpriteFont. A layout stores the positioned glyph quads and the
+// measured bounds of a string, so strings which are drawn every frame (or several times
+// per frame for shadows and outlines) only do the glyph lookup and layout once.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "SpriteBatch.h"
+#include "SpriteFont.h"
+
+#include <wrl/client.h>
+
+struct TextLayout
+{
+    struct GlyphQuad
+    {
+        RECT                subrect;
+        DirectX::XMFLOAT2   offset;     // Top-left of the glyph relative to the layout origin
+    };
+
+    struct Line
+    {
+        uint32_t            firstQuad;
+        uint32_t            quadCount;
+        float               width;
+    };
+
+    std::vector<GlyphQuad>  quads;
+    std::vector<Line>       lines;
+    DirectX::XMFLOAT2       size;       // Bounds of the glyphs, at least lineCount * GetLineSpacing() high
+    uint32_t                lineCount;
+
+    void Clear() noexcept
+    {
+        quads.clear();
+        lines.clear();
+        size = DirectX::XMFLOAT2(0.f, 0.f);
+        lineCount = 0;
+    }
+};
+
+// Lays out text following the same rules as SpriteFont::DrawString. If wrapWidth is greater
+// than zero, lines are broken at the last whitespace before the width is exceeded.
+inline void BuildTextLayout(const DirectX::SpriteFont& font, const wchar_t* text, size_t length, float wrapWidth, TextLayout& layout)
+{
+    layout.Clear();
+
+    if (!text || !length)
+        return;
+
+    const float lineSpacing = font.GetLineSpacing();
+
+    float x = 0.f;
+    float y = 0.f;
+    layout.lineCount = 1;
+    layout.lines.push_back(TextLayout::Line{ 0, 0, 0.f });
+
+    // Most recent wrap opportunity on the current line.
+    size_t breakQuad = SIZE_MAX;
+    float breakX = 0.f;
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        const wchar_t character = text[i];
+
+        switch (character)
+        {
+        case L'\r':
+            continue;
+
+        case L'\n':
+            x = 0.f;
+            y += lineSpacing;
+            breakQuad = SIZE_MAX;
+            ++layout.lineCount;
+            layout.lines.push_back(TextLayout::Line{ uint32_t(layout.quads.size()), 0, 0.f });
+            continue;
+
+        default:
+            break;
+        }
+
+        const auto glyph = font.FindGlyph(character);
+
+        x += glyph->XOffset;
+        if (x < 0.f)
+            x = 0.f;
+
+        const float width = float(glyph->Subrect.right - glyph->Subrect.left);
+        const float height = float(glyph->Subrect.bottom - glyph->Subrect.top);
+        const float advance = width + glyph->XAdvance;
+        const bool whitespace = iswspace(character) != 0;
+
+        if (wrapWidth > 0.f && !whitespace && (x + width) > wrapWidth && breakQuad != SIZE_MAX && breakX > 0.f)
+        {
+            // Move everything after the break to the start of the next line.
+            y += lineSpacing;
+            for (size_t j = breakQuad; j < layout.quads.size(); ++j)
+            {
+                layout.quads[j].offset.x -= breakX;
+                layout.quads[j].offset.y += lineSpacing;
+            }
+            x -= breakX;
+            ++layout.lineCount;
+            layout.lines.push_back(TextLayout::Line{ uint32_t(breakQuad), 0, 0.f });
+            breakQuad = SIZE_MAX;
+        }
+
+        if (!whitespace || width > 1.f || height > 1.f)
+        {
+            TextLayout::GlyphQuad quad;
+            quad.subrect = glyph->Subrect;
+            quad.offset = DirectX::XMFLOAT2(x, y + glyph->YOffset);
+            layout.quads.push_back(quad);
+        }
+
+        x += advance;
+
+        if (whitespace)
+        {
+            breakQuad = layout.quads.size();
+            breakX = x;
+        }
+    }
+
+    // Measure after wrapping has settled the final positions.
+    float maxX = 0.f;
+    float maxY = float(layout.lineCount) * lineSpacing;
+    for (size_t j = 0; j < layout.lines.size(); ++j)
+    {
+        auto& line = layout.lines[j];
+        const size_t end = (j + 1 < layout.lines.size()) ? layout.lines[j + 1].firstQuad : layout.quads.size();
+        line.quadCount = uint32_t(end - line.firstQuad);
+
+        for (size_t k = line.firstQuad; k < end; ++k)
+        {
+            const auto& quad = layout.quads[k];
+            const float right = quad.offset.x + float(quad.subrect.right - quad.subrect.left);
+            const float bottom = quad.offset.y + float(quad.subrect.bottom - quad.subrect.top);
+            line.width = std::max(line.width, right);
+            maxY = std::max(maxY, bottom);
+        }
+
+        maxX = std::max(maxX, line.width);
+    }
+
+    layout.size = DirectX::XMFLOAT2(maxX, maxY);
+}
+
+// Replays a layout with a transform and color; equivalent to SpriteFont::DrawString with
+// SpriteEffects_None.
+inline void XM_CALLCONV DrawTextLayout(DirectX::SpriteBatch* batch, ID3D11ShaderResourceView* texture, const TextLayout& layout,
+    DirectX::XMFLOAT2 const& position, DirectX::FXMVECTOR color = DirectX::Colors::White, float rotation = 0,
+    DirectX::XMFLOAT2 const& origin = DirectX::XMFLOAT2(0, 0), float scale = 1, float layerDepth = 0)
+{
+    for (const auto& quad : layout.quads)
+    {
+        const DirectX::XMFLOAT2 glyphOrigin(origin.x - quad.offset.x, origin.y - quad.offset.y);
+
+        batch->Draw(texture, position, &quad.subrect, color, rotation, glyphOrigin, scale, DirectX::SpriteEffects_None, layerDepth);
+    }
+}
+
+class TextLayoutCache
+{
+public:
+    TextLayoutCache() noexcept :
+        m_frame(0),
+        m_hits(0),
+        m_misses(0)
+    {
+    }
+
+    TextLayoutCache(TextLayoutCache&&) = default;
+    TextLayoutCache& operator= (TextLayoutCache&&) = default;
+
+    TextLayoutCache(TextLayoutCache const&) = delete;
+    TextLayoutCache& operator= (TextLayoutCache const&) = delete;
+
+    // Returns the layout for the string, building it on first use. The reference is valid
+    // until the next call to Get or Trim.
+    const TextLayout& Get(const DirectX::SpriteFont* font, const wchar_t* text, float wrapWidth = 0.f)
+    {
+        const size_t length = text ? wcslen(text) : 0;
+        const uint64_t key = Hash(font, text, length, wrapWidth);
+
+        Entry& entry = m_entries[key];
+        entry.lastUsed = m_frame;
+
+        if (entry.font == font && entry.wrapWidth == wrapWidth
+            && entry.text.size() == length && (!length || !memcmp(entry.text.data(), text, length * sizeof(wchar_t))))
+        {
+            ++m_hits;
+            return entry.layout;
+        }
+
+        // New entry, or a hash collision which simply replaces the old layout.
+        ++m_misses;
+        entry.font = font;
+        entry.wrapWidth = wrapWidth;
+        entry.text.assign(text ? text : L"", length);
+        BuildTextLayout(*font, entry.text.c_str(), length, wrapWidth, entry.layout);
+
+        return entry.layout;
+    }
+
+    void XM_CALLCONV DrawString(DirectX::SpriteBatch* batch, const DirectX::SpriteFont* font, const wchar_t* text,
+        DirectX::XMFLOAT2 const& position, DirectX::FXMVECTOR color = DirectX::Colors::White, float rotation = 0,
+        DirectX::XMFLOAT2 const& origin = DirectX::XMFLOAT2(0, 0), float scale = 1, float layerDepth = 0, float wrapWidth = 0.f)
+    {
+        const TextLayout& layout = Get(font, text, wrapWidth);
+
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture;
+        font->GetSpriteSheet(texture.GetAddressOf());
+
+        DrawTextLayout(batch, texture.Get(), layout, position, color, rotation, origin, scale, layerDepth);
+    }
+
+    // Call once per frame; layouts not used for maxIdleFrames frames are released.
+    void Trim(uint32_t maxIdleFrames = 60)
+    {
+        for (auto it = m_entries.begin(); it != m_entries.end();)
+        {
+            if ((m_frame - it->second.lastUsed) > maxIdleFrames)
+                it = m_entries.erase(it);
+            else
+                ++it;
+        }
+
+        ++m_frame;
+    }
+
+    void Clear() noexcept { m_entries.clear(); }
+
+    size_t GetCount() const noexcept { return m_entries.size(); }
+    uint64_t GetHitCount() const noexcept { return m_hits; }
+    uint64_t GetMissCount() const noexcept { return m_misses; }
+
+private:
+    struct Entry
+    {
+        Entry() noexcept : font(nullptr), wrapWidth(0.f), lastUsed(0), layout{} {}
+
+        const DirectX::SpriteFont*  font;
+        float                       wrapWidth;
+        uint32_t                    lastUsed;
+        std::wstring                text;
+        TextLayout                  layout;
+    };
+
+    static uint64_t Hash(const DirectX::SpriteFont* font, const wchar_t* text, size_t length, float wrapWidth) noexcept
+    {
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](const void* data, size_t size)
+        {
+            auto bytes = static_cast<const uint8_t*>(data);
+            for (size_t i = 0; i < size; ++i)
+            {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+        };
+
+        mix(&font, sizeof(font));
+        mix(&wrapWidth, sizeof(wrapWidth));
+        if (length)
+        {
+            mix(text, length * sizeof(wchar_t));
+        }
+
+        return hash;
+    }
+
+    uint32_t                                m_frame;
+    uint64_t                                m_hits;
+    uint64_t                                m_misses;
+    std::unordered_map<uint64_t, Entry>     m_entries;
+};
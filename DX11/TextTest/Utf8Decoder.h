@@ -0,0 +1,354 @@
+//--------------------------------------------------------------------------------------
+// File: Utf8Decoder.h
+//
+// Validating UTF-8 to wchar_t decoder. Runs of ASCII are widened 16 bytes per step with
+// SSE2 (32 with AVX2); other sequences go through a scalar decoder that rejects overlong
+// forms, surrogates, out of range values and truncated sequences.
+//
+// wchar_t output is UTF-16 where wchar_t is 16 bits (Windows), and UTF-32 where it is
+// 32 bits (Linux). This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define UTF8_DECODER_SSE2
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace Utf8
+{
+    enum ErrorMode
+    {
+        ErrorMode_Fail,         // Stop at the first malformed sequence
+        ErrorMode_Replace,      // Emit U+FFFD for each maximal malformed subpart
+    };
+
+    struct DecodeResult
+    {
+        size_t  written;        // wchar_t units written (not counting a terminator)
+        size_t  consumed;       // Input bytes consumed
+        bool    valid;          // False if malformed input was seen
+    };
+
+    // Upper bound on output units for len input bytes; true for both UTF-16 and UTF-32.
+    inline size_t MaxDecodedLength(size_t len) noexcept { return len; }
+
+    namespace Internal
+    {
+        inline unsigned CountTrailingZeros(uint32_t mask) noexcept
+        {
+        #ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return unsigned(index);
+        #else
+            return unsigned(__builtin_ctz(mask));
+        #endif
+        }
+
+        inline wchar_t* EmitCodePoint(wchar_t* dst, uint32_t cp) noexcept
+        {
+        #if WCHAR_MAX <= 0xFFFF
+            if (cp >= 0x10000)
+            {
+                cp -= 0x10000;
+                *dst++ = wchar_t(0xD800 + (cp >> 10));
+                *dst++ = wchar_t(0xDC00 + (cp & 0x3FF));
+                return dst;
+            }
+        #endif
+            *dst++ = wchar_t(cp);
+            return dst;
+        }
+
+        // Widens ASCII bytes from src while they last; returns the number of bytes copied.
+        inline size_t WidenAscii(const uint8_t* src, size_t len, wchar_t* dst) noexcept
+        {
+            size_t i = 0;
+
+        #ifdef UTF8_DECODER_SSE2
+            const __m128i zero = _mm_setzero_si128();
+
+        #if defined(__AVX2__)
+            for (; i + 32 <= len; i += 32)
+            {
+                const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                const uint32_t mask = uint32_t(_mm256_movemask_epi8(bytes));
+                if (mask)
+                {
+                    const unsigned n = CountTrailingZeros(mask);
+                    for (unsigned j = 0; j < n; ++j)
+                    {
+                        dst[i + j] = wchar_t(src[i + j]);
+                    }
+                    return i + n;
+                }
+
+            #if WCHAR_MAX <= 0xFFFF
+                const __m256i wide0 = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes));
+                const __m256i wide1 = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), wide0);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 16), wide1);
+            #else
+                const __m128i lo = _mm256_castsi256_si128(bytes);
+                const __m128i hi = _mm256_extracti128_si256(bytes, 1);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_cvtepu8_epi32(lo));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 16), _mm256_cvtepu8_epi32(hi));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 24), _mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)));
+            #endif
+            }
+        #endif
+
+            for (; i + 16 <= len; i += 16)
+            {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                const uint32_t mask = uint32_t(_mm_movemask_epi8(bytes));
+                if (mask)
+                {
+                    const unsigned n = CountTrailingZeros(mask);
+                    for (unsigned j = 0; j < n; ++j)
+                    {
+                        dst[i + j] = wchar_t(src[i + j]);
+                    }
+                    return i + n;
+                }
+
+                const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+                const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+            #if WCHAR_MAX <= 0xFFFF
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), lo);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), hi);
+            #else
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(lo, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(lo, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpacklo_epi16(hi, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 12), _mm_unpackhi_epi16(hi, zero));
+            #endif
+            }
+        #endif
+
+            for (; i < len && src[i] < 0x80; ++i)
+            {
+                dst[i] = wchar_t(src[i]);
+            }
+
+            return i;
+        }
+
+        // Decodes one non-ASCII sequence at src (Unicode 3.9, Table 3-7). Returns the number
+        // of bytes used, or the negated length of the maximal malformed subpart.
+        inline ptrdiff_t DecodeSequence(const uint8_t* src, size_t len, uint32_t& cp) noexcept
+        {
+            const uint8_t lead = src[0];
+
+            size_t count;
+            uint8_t lo = 0x80;
+            uint8_t hi = 0xBF;
+
+            if (lead >= 0xC2 && lead <= 0xDF)
+            {
+                count = 2;
+                cp = lead & 0x1Fu;
+            }
+            else if (lead >= 0xE0 && lead <= 0xEF)
+            {
+                count = 3;
+                cp = lead & 0x0Fu;
+                if (lead == 0xE0) lo = 0xA0;        // Overlong
+                else if (lead == 0xED) hi = 0x9F;   // Surrogates
+            }
+            else if (lead >= 0xF0 && lead <= 0xF4)
+            {
+                count = 4;
+                cp = lead & 0x07u;
+                if (lead == 0xF0) lo = 0x90;        // Overlong
+                else if (lead == 0xF4) hi = 0x8F;   // Above U+10FFFF
+            }
+            else
+            {
+                return -1;
+            }
+
+            for (size_t j = 1; j < count; ++j)
+            {
+                if (j >= len)
+                    return -ptrdiff_t(j);
+
+                const uint8_t c = src[j];
+                if (c < lo || c > hi)
+                    return -ptrdiff_t(j);
+
+                cp = (cp << 6) | (c & 0x3Fu);
+                lo = 0x80;
+                hi = 0xBF;
+            }
+
+            return ptrdiff_t(count);
+        }
+    }
+
+    // Decodes len bytes into dst, which must hold at least MaxDecodedLength(len) units.
+    // No terminator is written.
+    inline DecodeResult Decode(const char* text, size_t len, wchar_t* dst, ErrorMode mode = ErrorMode_Replace) noexcept
+    {
+        const auto src = reinterpret_cast<const uint8_t*>(text);
+        wchar_t* out = dst;
+        bool valid = true;
+
+        size_t i = 0;
+        while (i < len)
+        {
+            const size_t ascii = Internal::WidenAscii(src + i, len - i, out);
+            i += ascii;
+            out += ascii;
+
+            // Decode non-ASCII sequences until the next ASCII byte.
+            while (i < len && src[i] >= 0x80)
+            {
+                uint32_t cp = 0;
+                const ptrdiff_t used = Internal::DecodeSequence(src + i, len - i, cp);
+                if (used > 0)
+                {
+                    out = Internal::EmitCodePoint(out, cp);
+                    i += size_t(used);
+                    continue;
+                }
+
+                valid = false;
+                if (mode == ErrorMode_Fail)
+                    return DecodeResult{ size_t(out - dst), i, false };
+
+                *out++ = wchar_t(0xFFFD);
+                i += size_t(-used);
+            }
+        }
+
+        return DecodeResult{ size_t(out - dst), i, valid };
+    }
+
+    // Decodes into a vector, resizing it to fit. The vector keeps its capacity, so reusing
+    // it avoids allocations once it has grown.
+    inline DecodeResult Decode(const char* text, size_t len, std::vector<wchar_t>& output, ErrorMode mode = ErrorMode_Replace)
+    {
+        output.resize(MaxDecodedLength(len) + 1);
+        DecodeResult result = Decode(text, len, output.data(), mode);
+        output[result.written] = 0;
+        output.resize(result.written + 1);
+        return result;
+    }
+
+    // Per-frame storage for decoded strings. Pointers returned by Decode stay valid until
+    // Reset; memory is kept between frames so steady-state use does not allocate.
+    class DecodeArena
+    {
+    public:
+        explicit DecodeArena(size_t blockSize = 64 * 1024) :
+            m_blockSize(blockSize),
+            m_block(0),
+            m_offset(0)
+        {
+            if (!blockSize)
+                throw std::invalid_argument("DecodeArena");
+        }
+
+        DecodeArena(DecodeArena&&) = default;
+        DecodeArena& operator= (DecodeArena&&) = default;
+
+        DecodeArena(DecodeArena const&) = delete;
+        DecodeArena& operator= (DecodeArena const&) = delete;
+
+        // Returns a null-terminated string, or nullptr if the input is malformed and mode is
+        // ErrorMode_Fail.
+        const wchar_t* Decode(const char* text, ErrorMode mode = ErrorMode_Replace)
+        {
+            return Decode(text, text ? strlen(text) : 0, mode);
+        }
+
+        const wchar_t* Decode(const char* text, size_t len, ErrorMode mode = ErrorMode_Replace)
+        {
+            wchar_t* dst = Allocate(MaxDecodedLength(len) + 1);
+
+            const DecodeResult result = Utf8::Decode(text, len, dst, mode);
+            if (!result.valid && mode == ErrorMode_Fail)
+                return nullptr;
+
+            dst[result.written] = 0;
+            m_offset -= (MaxDecodedLength(len) - result.written);
+            return dst;
+        }
+
+        void Reset() noexcept
+        {
+            m_block = 0;
+            m_offset = 0;
+        }
+
+        size_t GetCapacity() const noexcept
+        {
+            size_t total = 0;
+            for (const auto& block : m_blocks)
+            {
+                total += block.size;
+            }
+            return total;
+        }
+
+    private:
+        struct Block
+        {
+            std::unique_ptr<wchar_t[]>  data;
+            size_t                      size;
+        };
+
+        wchar_t* Allocate(size_t count)
+        {
+            while (m_block < m_blocks.size())
+            {
+                Block& block = m_blocks[m_block];
+                if (m_offset + count <= block.size)
+                {
+                    wchar_t* ptr = block.data.get() + m_offset;
+                    m_offset += count;
+                    return ptr;
+                }
+
+                ++m_block;
+                m_offset = 0;
+            }
+
+            Block block;
+            block.size = (count > m_blockSize) ? count : m_blockSize;
+            block.data.reset(new wchar_t[block.size]);
+            m_blocks.push_back(std::move(block));
+
+            m_block = m_blocks.size() - 1;
+            m_offset = count;
+            return m_blocks.back().data.get();
+        }
+
+        size_t              m_blockSize;
+        size_t              m_block;
+        size_t              m_offset;
+        std::vector<Block>  m_blocks;
+    };
+}
@@ -0,0 +1,533 @@
+//--------------------------------------------------------------------------------------
+// File: Utf8DecoderCheck.cpp
+//
+// Checks Utf8Decoder.h against a reference decoder built from an encoder: a sequence is
+// valid when it re-encodes to the same bytes, and a malformed subpart is maximal when it
+// is the longest prefix of some valid encoding. Valid text, random bytes and valid text
+// with damaged bytes must decode to exactly the reference units, with one U+FFFD for each
+// maximal malformed subpart; ErrorMode_Fail must stop at the first of them. ASCII runs of
+// every length up to a few vectors end at every offset, so the SIMD loops hand over to the
+// scalar decoder at every position, and nothing may be written past MaxDecodedLength.
+// Then times decoding ASCII and mixed text.
+//
+// This is a standalone console tool with no Windows or Direct3D dependencies. The decoder
+// widens ASCII with AVX2, SSE2 or plain C++ depending on the target, so build it once for
+// each; every build prints the same digest of its outputs:
+//
+//   g++ -std=c++14 -O2 -mavx2 -I.. -I../../Common -o Utf8DecoderCheck Utf8DecoderCheck.cpp
+//   g++ -std=c++14 -O2 -msse2 -I.. -I../../Common -o Utf8DecoderCheck Utf8DecoderCheck.cpp
+//   g++ -std=c++14 -O2 -mno-sse2 -I.. -I../../Common -o Utf8DecoderCheck Utf8DecoderCheck.cpp
+//   cl /std:c++14 /O2 /EHsc /arch:AVX2 /I.. /I..\..\Common Utf8DecoderCheck.cpp
+//
+// Pass -nobench to skip the timing.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "Utf8Decoder.h"
+#include "CheckHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    const wchar_t c_replacement = wchar_t(0xFFFD);
+
+    // Guard units past MaxDecodedLength that Decode must leave alone.
+    constexpr size_t c_guard = 64;
+    const wchar_t c_sentinel = wchar_t(0x5A5A);
+
+#if defined(__AVX2__)
+    const char* const c_path = "AVX2";
+#elif defined(UTF8_DECODER_SSE2)
+    const char* const c_path = "SSE2";
+#else
+    const char* const c_path = "scalar";
+#endif
+
+    // The shortest encoding of a scalar value, or 0 bytes for surrogates and values past
+    // U+10FFFF.
+    size_t Encode(uint32_t cp, uint8_t bytes[4]) noexcept
+    {
+        if (cp < 0x80)
+        {
+            bytes[0] = uint8_t(cp);
+            return 1;
+        }
+        if (cp < 0x800)
+        {
+            bytes[0] = uint8_t(0xC0 | (cp >> 6));
+            bytes[1] = uint8_t(0x80 | (cp & 0x3F));
+            return 2;
+        }
+        if (cp >= 0xD800 && cp <= 0xDFFF)
+            return 0;
+        if (cp < 0x10000)
+        {
+            bytes[0] = uint8_t(0xE0 | (cp >> 12));
+            bytes[1] = uint8_t(0x80 | ((cp >> 6) & 0x3F));
+            bytes[2] = uint8_t(0x80 | (cp & 0x3F));
+            return 3;
+        }
+        if (cp <= 0x10FFFF)
+        {
+            bytes[0] = uint8_t(0xF0 | (cp >> 18));
+            bytes[1] = uint8_t(0x80 | ((cp >> 12) & 0x3F));
+            bytes[2] = uint8_t(0x80 | ((cp >> 6) & 0x3F));
+            bytes[3] = uint8_t(0x80 | (cp & 0x3F));
+            return 4;
+        }
+        return 0;
+    }
+
+    void AppendUnits(std::vector<wchar_t>& out, uint32_t cp)
+    {
+    #if WCHAR_MAX <= 0xFFFF
+        if (cp >= 0x10000)
+        {
+            out.push_back(wchar_t(0xD800 + ((cp - 0x10000) >> 10)));
+            out.push_back(wchar_t(0xDC00 + ((cp - 0x10000) & 0x3FF)));
+            return;
+        }
+    #endif
+        out.push_back(wchar_t(cp));
+    }
+
+    class ReferenceDecoder
+    {
+    public:
+        // Marks every proper prefix of every valid encoding: one, two and three bytes.
+        ReferenceDecoder() :
+            m_prefix1(256),
+            m_prefix2(size_t(1) << 16),
+            m_prefix3(size_t(1) << 24)
+        {
+            for (uint32_t cp = 0; cp <= 0x10FFFF; ++cp)
+            {
+                uint8_t bytes[4];
+                const size_t n = Encode(cp, bytes);
+                if (n > 1)
+                    m_prefix1[bytes[0]] = 1;
+                if (n > 2)
+                    m_prefix2[size_t(bytes[0]) << 8 | bytes[1]] = 1;
+                if (n > 3)
+                    m_prefix3[size_t(bytes[0]) << 16 | size_t(bytes[1]) << 8 | bytes[2]] = 1;
+            }
+        }
+
+        // Appends the units of text to out and returns how many U+FFFD stand for malformed
+        // subparts. firstError receives the offset of the first one, or len.
+        size_t Decode(const uint8_t* text, size_t len, std::vector<wchar_t>& out, size_t& firstError) const
+        {
+            size_t replaced = 0;
+            firstError = len;
+
+            size_t i = 0;
+            while (i < len)
+            {
+                // A whole sequence decodes and re-encodes to the same bytes.
+                bool decoded = false;
+                for (size_t n = 1; n <= 4 && i + n <= len && !decoded; ++n)
+                {
+                    uint32_t cp = 0;
+                    if (!Assemble(text + i, n, cp))
+                        continue;
+
+                    uint8_t bytes[4];
+                    if (Encode(cp, bytes) == n && memcmp(bytes, text + i, n) == 0)
+                    {
+                        AppendUnits(out, cp);
+                        i += n;
+                        decoded = true;
+                    }
+                }
+                if (decoded)
+                    continue;
+
+                // Otherwise the longest prefix of some valid encoding, at least one byte,
+                // becomes a single U+FFFD.
+                size_t subpart = 1;
+                if (i + 1 <= len && m_prefix1[text[i]])
+                {
+                    subpart = 1;
+                    if (i + 2 <= len && m_prefix2[size_t(text[i]) << 8 | text[i + 1]])
+                    {
+                        subpart = 2;
+                        if (i + 3 <= len && m_prefix3[size_t(text[i]) << 16 | size_t(text[i + 1]) << 8 | text[i + 2]])
+                        {
+                            subpart = 3;
+                        }
+                    }
+                }
+
+                if (!replaced)
+                {
+                    firstError = i;
+                }
+                out.push_back(c_replacement);
+                ++replaced;
+                i += subpart;
+            }
+
+            return replaced;
+        }
+
+    private:
+        // The value of n bytes read with the bit patterns of a sequence of that length.
+        static bool Assemble(const uint8_t* bytes, size_t n, uint32_t& cp) noexcept
+        {
+            static const uint8_t leadMask[5] = { 0, 0x80, 0xE0, 0xF0, 0xF8 };
+            static const uint8_t leadBits[5] = { 0, 0x00, 0xC0, 0xE0, 0xF0 };
+
+            if ((bytes[0] & leadMask[n]) != leadBits[n])
+                return false;
+
+            cp = bytes[0] & uint8_t(~leadMask[n]);
+            for (size_t j = 1; j < n; ++j)
+            {
+                if ((bytes[j] & 0xC0) != 0x80)
+                    return false;
+                cp = (cp << 6) | (bytes[j] & 0x3Fu);
+            }
+            return true;
+        }
+
+        std::vector<uint8_t> m_prefix1;
+        std::vector<uint8_t> m_prefix2;
+        std::vector<uint8_t> m_prefix3;
+    };
+
+    // FNV-1a over the units of every decode, so builds with different paths can be compared.
+    uint32_t g_digest = 2166136261u;
+
+    void AddToDigest(const wchar_t* units, size_t count)
+    {
+        for (size_t j = 0; j < count; ++j)
+        {
+            const uint32_t unit = uint32_t(units[j]);
+            for (unsigned shift = 0; shift < 32; shift += 8)
+            {
+                g_digest = (g_digest ^ ((unit >> shift) & 0xFF)) * 16777619u;
+            }
+        }
+    }
+
+    // Decodes text both ways and compares units, counts and the fail mode; returns false
+    // on the first mismatch so that callers can stop after one report.
+    bool CheckText(const ReferenceDecoder& reference, const std::string& text, const char* what)
+    {
+        const auto bytes = reinterpret_cast<const uint8_t*>(text.data());
+
+        std::vector<wchar_t> expected;
+        size_t firstError;
+        const size_t replaced = reference.Decode(bytes, text.size(), expected, firstError);
+
+        const size_t capacity = Utf8::MaxDecodedLength(text.size());
+        std::vector<wchar_t> output(capacity + c_guard, c_sentinel);
+
+        const auto result = Utf8::Decode(text.data(), text.size(), output.data(), Utf8::ErrorMode_Replace);
+        AddToDigest(output.data(), result.written);
+
+        if (result.written != expected.size() || !std::equal(expected.begin(), expected.end(), output.begin()))
+        {
+            size_t at = 0;
+            while (at < expected.size() && at < result.written && expected[at] == output[at])
+                ++at;
+            Fail("%s: %s decodes %zu bytes to %zu units, the reference to %zu; first difference at unit %zu",
+                what, c_path, text.size(), result.written, expected.size(), at);
+            return false;
+        }
+
+        const size_t found = size_t(std::count(output.begin(), output.begin() + ptrdiff_t(result.written), c_replacement));
+        const size_t genuine = size_t(std::count(expected.begin(), expected.end(), c_replacement)) - replaced;
+        if (found - genuine != replaced || result.valid != (replaced == 0) || result.consumed != text.size())
+        {
+            Fail("%s: %zu replacements (valid %d, consumed %zu of %zu), the reference has %zu",
+                what, found - genuine, int(result.valid), result.consumed, text.size(), replaced);
+            return false;
+        }
+
+        if (!std::all_of(output.begin() + ptrdiff_t(capacity), output.end(), [](wchar_t c) { return c == c_sentinel; }))
+        {
+            Fail("%s: Decode writes past MaxDecodedLength", what);
+            return false;
+        }
+
+        // The fail mode stops at the first malformed subpart with everything before it.
+        std::vector<wchar_t> prefix;
+        size_t ignored;
+        reference.Decode(bytes, firstError, prefix, ignored);
+
+        std::fill(output.begin(), output.end(), c_sentinel);
+        const auto failed = Utf8::Decode(text.data(), text.size(), output.data(), Utf8::ErrorMode_Fail);
+        if (failed.valid != (replaced == 0) || failed.consumed != firstError || failed.written != prefix.size()
+            || !std::equal(prefix.begin(), prefix.end(), output.begin()))
+        {
+            Fail("%s: ErrorMode_Fail stops after %zu bytes and %zu units, expected %zu and %zu",
+                what, failed.consumed, failed.written, firstError, prefix.size());
+            return false;
+        }
+
+        return true;
+    }
+
+    // The examples of maximal subparts in the Unicode Standard, section 3.9, and the edges
+    // of Table 3-7.
+    void CheckKnownSequences(const ReferenceDecoder& reference)
+    {
+        struct Case
+        {
+            const char* text;
+            size_t      replacements;
+        };
+
+        static const Case cases[] =
+        {
+            { "\x61\xF1\x80\x80\xE1\x80\xC2\x62\x80\x63\x80\xBF\x64", 6 },
+            { "\xC0\xAF", 2 },                  // Overlong '/'
+            { "\xE0\x80\xAF", 3 },
+            { "\xE0\x9F\xBF", 3 },
+            { "\xE0\xA0\x80", 0 },              // U+0800
+            { "\xED\x9F\xBF", 0 },              // U+D7FF
+            { "\xED\xA0\x80", 3 },              // U+D800
+            { "\xED\xBF\xBF", 3 },              // U+DFFF
+            { "\xEE\x80\x80", 0 },              // U+E000
+            { "\xEF\xBF\xBD", 0 },              // A genuine U+FFFD
+            { "\xF0\x8F\xBF\xBF", 4 },
+            { "\xF0\x90\x80\x80", 0 },          // U+10000
+            { "\xF4\x8F\xBF\xBF", 0 },          // U+10FFFF
+            { "\xF4\x90\x80\x80", 4 },          // U+110000
+            { "\xF5\x80\x80\x80", 4 },
+            { "\xFE\xFF", 2 },
+            { "\xE2\x82", 1 },                  // Truncated U+20AC
+            { "\xF0\x9F\x98", 1 },              // Truncated U+1F600
+            { "\xC3", 1 },
+            { "\x80\xBF", 2 },                  // Lone continuation bytes
+        };
+
+        for (const auto& it : cases)
+        {
+            const std::string text(it.text);
+            if (!CheckText(reference, text, "Known sequence"))
+                continue;
+
+            std::vector<wchar_t> expected;
+            size_t firstError;
+            const size_t replaced = reference.Decode(reinterpret_cast<const uint8_t*>(text.data()), text.size(), expected, firstError);
+            if (replaced != it.replacements)
+            {
+                Fail("Reference decoder finds %zu malformed subparts in a known sequence, not %zu", replaced, it.replacements);
+            }
+        }
+    }
+
+    std::string RandomValidText(std::mt19937& rng, size_t codePoints)
+    {
+        std::string text;
+        while (codePoints--)
+        {
+            uint32_t cp;
+            switch (rng() % 8)
+            {
+            case 0: cp = 0x80 + rng() % 0x780; break;
+            case 1: cp = 0x800 + rng() % 0xF800; break;
+            case 2: cp = 0x10000 + rng() % 0x100000; break;
+            default: cp = rng() % 0x80; break;
+            }
+
+            uint8_t bytes[4];
+            const size_t n = Encode(cp, bytes);
+            text.append(reinterpret_cast<const char*>(bytes), n);
+
+            // Long ASCII runs keep the vector loops busy.
+            if (rng() % 16 == 0)
+            {
+                text.append(rng() % 100, char('a' + rng() % 26));
+            }
+        }
+        return text;
+    }
+
+    void CheckRandomText(const ReferenceDecoder& reference)
+    {
+        std::mt19937 rng(2024);
+
+        for (int j = 0; j < 2000; ++j)
+        {
+            if (!CheckText(reference, RandomValidText(rng, rng() % 300), "Random valid text"))
+                return;
+        }
+
+        for (int j = 0; j < 2000; ++j)
+        {
+            std::string text(rng() % 200, '\0');
+            for (auto& c : text)
+            {
+                // Mostly bytes that can start or continue sequences.
+                c = char((rng() % 4) ? 0x80 + rng() % 0x80 : rng() % 0x100);
+            }
+            if (!CheckText(reference, text, "Random bytes"))
+                return;
+        }
+
+        for (int j = 0; j < 4000; ++j)
+        {
+            std::string text = RandomValidText(rng, 1 + rng() % 200);
+            for (size_t damage = 1 + rng() % 4; damage--; )
+            {
+                const size_t at = rng() % text.size();
+                switch (rng() % 4)
+                {
+                case 0: text[at] = char(rng() % 0x100); break;
+                case 1: text.erase(at, 1); break;
+                case 2: text.insert(at, 1, char(0x80 + rng() % 0x80)); break;
+                default: text.resize(at); break;
+                }
+                if (text.empty())
+                    text = "\xC3";
+            }
+            if (!CheckText(reference, text, "Damaged text"))
+                return;
+        }
+    }
+
+    // An ASCII run of each length, at each offset from an aligned start, ended by a
+    // sequence that is valid, malformed or cut off.
+    void CheckBoundaries(const ReferenceDecoder& reference)
+    {
+        static const char* const tails[] = { "", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\x80", "\xE2\x82", "\xED\xA0\x80" };
+
+        for (size_t offset = 0; offset < 32; ++offset)
+        {
+            for (size_t run = 0; run <= 100; ++run)
+            {
+                for (const char* tail : tails)
+                {
+                    std::string text(offset, 'x');
+                    text.append(run, 'a');
+                    text.append(tail);
+                    text.append(run % 7, 'b');
+
+                    if (!CheckText(reference, text, "ASCII run boundary"))
+                        return;
+                }
+            }
+        }
+    }
+
+    void CheckArena(const ReferenceDecoder& reference)
+    {
+        std::mt19937 rng(7);
+        Utf8::DecodeArena arena(256);
+
+        std::vector<std::string> texts;
+        for (int j = 0; j < 200; ++j)
+        {
+            texts.push_back(RandomValidText(rng, rng() % 100));
+        }
+        texts.push_back("bad \xF0\x9F byte");
+
+        size_t capacity = 0;
+        for (int frame = 0; frame < 3; ++frame)
+        {
+            arena.Reset();
+
+            std::vector<const wchar_t*> decoded;
+            for (const auto& text : texts)
+            {
+                decoded.push_back(arena.Decode(text.data(), text.size()));
+            }
+
+            // Every string stays intact until Reset.
+            for (size_t j = 0; j < texts.size(); ++j)
+            {
+                std::vector<wchar_t> expected;
+                size_t firstError;
+                reference.Decode(reinterpret_cast<const uint8_t*>(texts[j].data()), texts[j].size(), expected, firstError);
+                expected.push_back(0);
+
+                if (!std::equal(expected.begin(), expected.end(), decoded[j]))
+                {
+                    Fail("DecodeArena string %zu changed before Reset", j);
+                    return;
+                }
+            }
+
+            Check(arena.Decode(texts.back().c_str(), Utf8::ErrorMode_Fail) == nullptr, "DecodeArena returns null for malformed text in ErrorMode_Fail");
+
+            if (frame == 0)
+            {
+                capacity = arena.GetCapacity();
+            }
+            else
+            {
+                Check(arena.GetCapacity() == capacity, "DecodeArena grows again for the same strings after Reset");
+            }
+        }
+    }
+
+    void CheckPerformance(bool bench)
+    {
+        if (!bench)
+            return;
+
+        std::mt19937 rng(11);
+
+        std::string ascii(1 << 20, ' ');
+        for (auto& c : ascii)
+        {
+            c = char(' ' + rng() % 95);
+        }
+
+        std::string mixed;
+        while (mixed.size() < (1 << 20))
+        {
+            mixed += RandomValidText(rng, 64);
+        }
+
+        std::vector<wchar_t> output;
+        for (const auto* text : { &ascii, &mixed })
+        {
+            output.resize(Utf8::MaxDecodedLength(text->size()));
+
+            constexpr int iterations = 50;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int j = 0; j < iterations; ++j)
+            {
+                Utf8::Decode(text->data(), text->size(), output.data());
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+
+            const double seconds = std::chrono::duration<double>(end - start).count() / iterations;
+            printf("%s, %s: %.0f MB/s\n", c_path, (text == &ascii) ? "ASCII" : "mixed text", double(text->size()) / seconds / 1e6);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const bool bench = !(argc > 1 && strcmp(argv[1], "-nobench") == 0);
+
+    return RunChecks([&]()
+    {
+        const ReferenceDecoder reference;
+
+        CheckKnownSequences(reference);
+        CheckRandomText(reference);
+        CheckBoundaries(reference);
+        CheckArena(reference);
+
+        printf("%s path, %zu-bit wchar_t, digest %08x\n", c_path, sizeof(wchar_t) * 8, g_digest);
+
+        CheckPerformance(bench);
+    });
+}
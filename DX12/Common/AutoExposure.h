@@ -0,0 +1,475 @@
+//--------------------------------------------------------------------------------------
+// File: AutoExposure.h
+//
+// Histogram-based automatic exposure. LuminanceHistogram bins the log2 luminance of an
+// R32G32B32A32_FLOAT or R16G16B16A16_FLOAT image (typically a downscaled copy of the HDR
+// scene) with SSE2, splitting rows across a WorkerPool. AutoExposure averages the bins
+// between a low and a high percentile and moves the exposure toward the value that maps
+// that average to the key value, with separate speeds for opening up and stopping down.
+//
+// Neither class allocates after construction. This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define AUTOEXPOSURE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(AUTOEXPOSURE_SSE2) && (defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__)))
+#define AUTOEXPOSURE_F16C
+#include <immintrin.h>
+#endif
+
+#include "ParallelFor.h"
+
+namespace DX
+{
+    class LuminanceHistogram
+    {
+    public:
+        static constexpr size_t BinCount = 64;
+
+        // DXGI_FORMAT values.
+        enum Format : uint32_t
+        {
+            Format_R32G32B32A32_FLOAT = 2,
+            Format_R16G16B16A16_FLOAT = 10,
+        };
+
+        // A null pool builds the histogram on the calling thread.
+        explicit LuminanceHistogram(WorkerPool* pool = nullptr, float minLog2 = -10.f, float maxLog2 = 6.f) :
+            m_pool(pool),
+            m_minLog2(0.f),
+            m_maxLog2(0.f),
+            m_scale(0.f),
+            m_sampleCount(0),
+            m_bins{}
+        {
+            SetRange(minLog2, maxLog2);
+
+            const size_t workers = pool ? pool->GetThreadCount() : 1;
+            m_laneBins.resize(workers * Lanes * BinCount);
+        }
+
+        LuminanceHistogram(LuminanceHistogram&&) = default;
+        LuminanceHistogram& operator= (LuminanceHistogram&&) = default;
+
+        LuminanceHistogram(LuminanceHistogram const&) = delete;
+        LuminanceHistogram& operator= (LuminanceHistogram const&) = delete;
+
+        // Luminance below 2^minLog2 (including zero, negative and NaN) is counted in the first
+        // bin, and luminance above 2^maxLog2 in the last.
+        void SetRange(float minLog2, float maxLog2)
+        {
+            if (!(minLog2 < maxLog2) || !std::isfinite(minLog2) || !std::isfinite(maxLog2))
+                throw std::invalid_argument("Invalid histogram range");
+
+            m_minLog2 = minLog2;
+            m_maxLog2 = maxLog2;
+            m_scale = float(BinCount) / (maxLog2 - minLog2);
+        }
+
+        // Samples every step-th pixel of every step-th row.
+        void Build(const void* pixels, size_t rowPitch, size_t width, size_t height, Format format, size_t step = 1)
+        {
+            if (!pixels && width && height)
+                throw std::invalid_argument("Invalid pixels");
+
+            if (format != Format_R32G32B32A32_FLOAT && format != Format_R16G16B16A16_FLOAT)
+                throw std::invalid_argument("Unsupported pixel format");
+
+            step = std::max<size_t>(step, 1);
+
+            const size_t bytesPerPixel = (format == Format_R32G32B32A32_FLOAT) ? 16 : 8;
+            if (rowPitch < width * bytesPerPixel)
+                throw std::invalid_argument("Row pitch is too small");
+
+            std::fill(m_laneBins.begin(), m_laneBins.end(), 0u);
+
+            const size_t columns = (width + step - 1) / step;
+            const size_t rows = (height + step - 1) / step;
+
+            auto build = [&](size_t begin, size_t end, size_t worker)
+            {
+                uint32_t* bins = &m_laneBins[worker * Lanes * BinCount];
+                for (size_t y = begin; y < end; ++y)
+                {
+                    auto row = static_cast<const uint8_t*>(pixels) + y * step * rowPitch;
+                    if (format == Format_R32G32B32A32_FLOAT)
+                    {
+                        BuildRow<false>(row, columns, step * bytesPerPixel, bins);
+                    }
+                    else
+                    {
+                        BuildRow<true>(row, columns, step * bytesPerPixel, bins);
+                    }
+                }
+            };
+
+            if (m_pool)
+            {
+                m_pool->Run(rows, 16, build);
+            }
+            else
+            {
+                build(0, rows, 0);
+            }
+
+            for (size_t bin = 0; bin < BinCount; ++bin)
+            {
+                uint32_t count = 0;
+                for (size_t j = 0; j < m_laneBins.size(); j += BinCount)
+                {
+                    count += m_laneBins[j + bin];
+                }
+                m_bins[bin] = count;
+            }
+
+            m_sampleCount = uint64_t(columns) * uint64_t(rows);
+        }
+
+        // The bin that Build counts a luminance value in.
+        size_t GetBin(float luminance) const noexcept
+        {
+            luminance = (luminance > FLT_MIN) ? luminance : FLT_MIN;
+
+            float t = (FastLog2(luminance) - m_minLog2) * m_scale;
+            t = std::min(std::max(t, 0.f), float(BinCount - 1));
+            return size_t(t);
+        }
+
+        // Mean log2 luminance of the samples ranked between the two fractions of the sample
+        // count, each bin standing for its center. Returns the middle of the range if empty.
+        float GetAverageLog2(float lowPercentile, float highPercentile) const noexcept
+        {
+            const double low = double(lowPercentile) * double(m_sampleCount);
+            const double high = double(highPercentile) * double(m_sampleCount);
+
+            double sum = 0;
+            double weight = 0;
+            double rank = 0;
+            for (size_t bin = 0; bin < BinCount; ++bin)
+            {
+                const double next = rank + double(m_bins[bin]);
+                const double count = std::min(next, high) - std::max(rank, low);
+                if (count > 0)
+                {
+                    sum += count * double(GetBinLog2(bin));
+                    weight += count;
+                }
+                rank = next;
+            }
+
+            return (weight > 0) ? float(sum / weight) : (m_minLog2 + m_maxLog2) * 0.5f;
+        }
+
+        // log2 luminance at the center of a bin.
+        float GetBinLog2(size_t bin) const noexcept
+        {
+            return m_minLog2 + (float(bin) + 0.5f) / m_scale;
+        }
+
+        const uint32_t* GetBins() const noexcept { return m_bins; }
+        uint64_t GetSampleCount() const noexcept { return m_sampleCount; }
+        float GetMinLog2() const noexcept { return m_minLog2; }
+        float GetMaxLog2() const noexcept { return m_maxLog2; }
+
+    private:
+        // Four sub-histograms per worker, one per SIMD lane, so the increments of neighboring
+        // pixels do not wait on each other.
+        static constexpr size_t Lanes = 4;
+
+        static constexpr float LumR = 0.2126f;
+        static constexpr float LumG = 0.7152f;
+        static constexpr float LumB = 0.0722f;
+
+        // log2(1 + m) ~ m + m(1 - m)(c0 + m(c1 + m c2)) for the mantissa m in [0, 1), exact at
+        // both ends and within 1.5e-4 in between.
+        static constexpr float Log2C0 = 0.43807325f;
+        static constexpr float Log2C1 = -0.23669342f;
+        static constexpr float Log2C2 = 0.08030730f;
+
+        // For normal positive values only.
+        static float FastLog2(float value) noexcept
+        {
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+
+            const float exponent = float(int32_t(bits >> 23) - 127);
+
+            bits = (bits & 0x007fffff) | 0x3f800000;
+            float m;
+            memcpy(&m, &bits, sizeof(m));
+            m -= 1.f;
+
+            return exponent + (m + (m * (1.f - m)) * (Log2C0 + m * (Log2C1 + m * Log2C2)));
+        }
+
+        static float HalfToFloat(uint16_t value) noexcept
+        {
+            const uint32_t sign = uint32_t(value & 0x8000) << 16;
+            const uint32_t exponent = (value >> 10) & 0x1f;
+            const uint32_t mantissa = value & 0x3ff;
+
+            uint32_t bits;
+            if (exponent == 0x1f)
+            {
+                bits = sign | 0x7f800000 | (mantissa << 13);
+            }
+            else if (exponent)
+            {
+                bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+            }
+            else
+            {
+                const float magnitude = float(mantissa) * (1.f / 16777216.f);
+                return sign ? -magnitude : magnitude;
+            }
+
+            float result;
+            memcpy(&result, &bits, sizeof(result));
+            return result;
+        }
+
+        template<bool Half>
+        static void LoadPixel(const uint8_t* pixel, float rgb[3]) noexcept
+        {
+            if (Half)
+            {
+                uint16_t half[3];
+                memcpy(half, pixel, sizeof(half));
+                rgb[0] = HalfToFloat(half[0]);
+                rgb[1] = HalfToFloat(half[1]);
+                rgb[2] = HalfToFloat(half[2]);
+            }
+            else
+            {
+                memcpy(rgb, pixel, sizeof(float) * 3);
+            }
+        }
+
+    #if defined(AUTOEXPOSURE_SSE2)
+        template<bool Half>
+        static __m128 LoadPixel(const uint8_t* pixel) noexcept
+        {
+            if (Half)
+            {
+            #if defined(AUTOEXPOSURE_F16C)
+                return _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pixel)));
+            #else
+                float rgb[3];
+                LoadPixel<true>(pixel, rgb);
+                return _mm_setr_ps(rgb[0], rgb[1], rgb[2], 0.f);
+            #endif
+            }
+            else
+            {
+                return _mm_loadu_ps(reinterpret_cast<const float*>(pixel));
+            }
+        }
+    #endif
+
+        template<bool Half>
+        void BuildRow(const uint8_t* row, size_t count, size_t stride, uint32_t* bins) const noexcept
+        {
+            size_t x = 0;
+
+        #if defined(AUTOEXPOSURE_SSE2)
+            const __m128 lumR = _mm_set1_ps(LumR);
+            const __m128 lumG = _mm_set1_ps(LumG);
+            const __m128 lumB = _mm_set1_ps(LumB);
+            const __m128 minimum = _mm_set1_ps(FLT_MIN);
+            const __m128 one = _mm_set1_ps(1.f);
+            const __m128 c0 = _mm_set1_ps(Log2C0);
+            const __m128 c1 = _mm_set1_ps(Log2C1);
+            const __m128 c2 = _mm_set1_ps(Log2C2);
+            const __m128 offset = _mm_set1_ps(m_minLog2);
+            const __m128 scale = _mm_set1_ps(m_scale);
+            const __m128 last = _mm_set1_ps(float(BinCount - 1));
+            const __m128i mantissaMask = _mm_set1_epi32(0x007fffff);
+            const __m128i bias = _mm_set1_epi32(127);
+
+            for (; x + 4 <= count; x += 4)
+            {
+                __m128 p0 = LoadPixel<Half>(row);
+                __m128 p1 = LoadPixel<Half>(row + stride);
+                __m128 p2 = LoadPixel<Half>(row + stride * 2);
+                __m128 p3 = LoadPixel<Half>(row + stride * 3);
+                row += stride * 4;
+
+                _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+
+                __m128 y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, lumR), _mm_mul_ps(p1, lumG)), _mm_mul_ps(p2, lumB));
+
+                // maxps returns its second operand for NaN.
+                y = _mm_max_ps(y, minimum);
+
+                const __m128i bits = _mm_castps_si128(y);
+                const __m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), bias));
+                __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, mantissaMask), _mm_castps_si128(one)));
+                m = _mm_sub_ps(m, one);
+
+                __m128 poly = _mm_add_ps(c1, _mm_mul_ps(m, c2));
+                poly = _mm_add_ps(c0, _mm_mul_ps(m, poly));
+                poly = _mm_mul_ps(_mm_mul_ps(m, _mm_sub_ps(one, m)), poly);
+                const __m128 log2 = _mm_add_ps(exponent, _mm_add_ps(m, poly));
+
+                __m128 t = _mm_mul_ps(_mm_sub_ps(log2, offset), scale);
+                t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), last);
+
+                alignas(16) int32_t index[4];
+                _mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_cvttps_epi32(t));
+
+                ++bins[index[0]];
+                ++bins[BinCount + index[1]];
+                ++bins[BinCount * 2 + index[2]];
+                ++bins[BinCount * 3 + index[3]];
+            }
+        #endif
+
+            for (; x < count; ++x)
+            {
+                float rgb[3];
+                LoadPixel<Half>(row, rgb);
+                row += stride;
+
+                const float y = rgb[0] * LumR + rgb[1] * LumG + rgb[2] * LumB;
+                ++bins[(x & 3) * BinCount + GetBin(y)];
+            }
+        }
+
+        WorkerPool*             m_pool;
+        float                   m_minLog2;
+        float                   m_maxLog2;
+        float                   m_scale;
+        uint64_t                m_sampleCount;
+        uint32_t                m_bins[BinCount];
+        std::vector<uint32_t>   m_laneBins;
+    };
+
+    // Exposure values are in stops, as taken by ToneMapPostProcess::SetExposure.
+    class AutoExposure
+    {
+    public:
+        AutoExposure() noexcept :
+            m_lowPercentile(0.5f),
+            m_highPercentile(0.95f),
+            m_keyValue(0.18f),
+            m_minExposure(-8.f),
+            m_maxExposure(8.f),
+            m_speedUp(1.f),
+            m_speedDown(3.f),
+            m_averageLog2(0.f),
+            m_target(0.f),
+            m_exposure(0.f),
+            m_valid(false)
+        {
+        }
+
+        AutoExposure(AutoExposure&&) = default;
+        AutoExposure& operator= (AutoExposure&&) = default;
+
+        AutoExposure(AutoExposure const&) = default;
+        AutoExposure& operator= (AutoExposure const&) = default;
+
+        // Samples ranked below low or above high, as fractions of the histogram, are ignored.
+        void SetPercentiles(float low, float high)
+        {
+            if (!(low >= 0.f && low < high && high <= 1.f))
+                throw std::invalid_argument("Invalid percentiles");
+
+            m_lowPercentile = low;
+            m_highPercentile = high;
+        }
+
+        // The linear luminance the average is exposed to.
+        void SetKeyValue(float key)
+        {
+            if (!(key > 0.f) || !std::isfinite(key))
+                throw std::invalid_argument("Invalid key value");
+
+            m_keyValue = key;
+        }
+
+        void SetExposureRange(float minExposure, float maxExposure)
+        {
+            if (!(minExposure <= maxExposure))
+                throw std::invalid_argument("Invalid exposure range");
+
+            m_minExposure = minExposure;
+            m_maxExposure = maxExposure;
+            m_exposure = std::min(std::max(m_exposure, minExposure), maxExposure);
+        }
+
+        // Rates per second: speedUp applies while the exposure rises (the scene got darker),
+        // speedDown while it falls. Zero holds the exposure in that direction.
+        void SetAdaptationSpeed(float speedUp, float speedDown)
+        {
+            if (!(speedUp >= 0.f) || !(speedDown >= 0.f))
+                throw std::invalid_argument("Invalid adaptation speed");
+
+            m_speedUp = speedUp;
+            m_speedDown = speedDown;
+        }
+
+        // The next Update jumps straight to its target.
+        void Reset() noexcept { m_valid = false; }
+
+        // Returns the new exposure. An empty histogram leaves it unchanged.
+        float Update(const LuminanceHistogram& histogram, float elapsedSeconds) noexcept
+        {
+            if (!histogram.GetSampleCount())
+                return m_exposure;
+
+            m_averageLog2 = histogram.GetAverageLog2(m_lowPercentile, m_highPercentile);
+
+            m_target = std::log2(m_keyValue) - m_averageLog2;
+            m_target = std::min(std::max(m_target, m_minExposure), m_maxExposure);
+
+            if (!m_valid)
+            {
+                m_exposure = m_target;
+                m_valid = true;
+            }
+            else
+            {
+                const float speed = (m_target > m_exposure) ? m_speedUp : m_speedDown;
+                const float t = 1.f - std::exp(-std::max(elapsedSeconds, 0.f) * speed);
+                m_exposure += (m_target - m_exposure) * t;
+            }
+
+            return m_exposure;
+        }
+
+        float GetExposure() const noexcept { return m_exposure; }
+        float GetTargetExposure() const noexcept { return m_target; }
+        float GetAverageLog2Luminance() const noexcept { return m_averageLog2; }
+
+    private:
+        float   m_lowPercentile;
+        float   m_highPercentile;
+        float   m_keyValue;
+        float   m_minExposure;
+        float   m_maxExposure;
+        float   m_speedUp;
+        float   m_speedDown;
+        float   m_averageLog2;
+        float   m_target;
+        float   m_exposure;
+        bool    m_valid;
+    };
+}
@@ -0,0 +1,810 @@
+//--------------------------------------------------------------------------------------
+// File: FrameGraph.h
+//
+// Render pass frame graph. Each frame passes declare the resources they read and write; the
+// graph then culls passes that contribute nothing to an imported resource, orders the rest,
+// assigns transient resources to slots that are shared by resources with disjoint lifetimes,
+// and plans the resource barriers for the frame, batched per pass and split across idle
+// passes where possible.
+//
+// The compile step has no Windows dependencies; resource states use the D3D12 values.
+// FrameGraphCommandList at the end of this header records the plan on a D3D12 command list
+// and is only available when d3d12.h has been included.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//-------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace DX
+{
+    using ResourceStates = uint32_t;
+
+    // D3D12_RESOURCE_STATES values.
+    namespace ResourceState
+    {
+        constexpr ResourceStates Common = 0;
+        constexpr ResourceStates Present = 0;
+        constexpr ResourceStates VertexAndConstantBuffer = 0x1;
+        constexpr ResourceStates IndexBuffer = 0x2;
+        constexpr ResourceStates RenderTarget = 0x4;
+        constexpr ResourceStates UnorderedAccess = 0x8;
+        constexpr ResourceStates DepthWrite = 0x10;
+        constexpr ResourceStates DepthRead = 0x20;
+        constexpr ResourceStates NonPixelShaderResource = 0x40;
+        constexpr ResourceStates PixelShaderResource = 0x80;
+        constexpr ResourceStates CopyDest = 0x400;
+        constexpr ResourceStates CopySource = 0x800;
+        constexpr ResourceStates ResolveDest = 0x1000;
+        constexpr ResourceStates ResolveSource = 0x2000;
+
+        // States that can be combined, since the resource is only read in them.
+        constexpr ResourceStates ReadOnly = VertexAndConstantBuffer | IndexBuffer | DepthRead
+            | NonPixelShaderResource | PixelShaderResource | CopySource | ResolveSource;
+
+        // Import final state that leaves a resource in the state of its last use.
+        constexpr ResourceStates Unchanged = UINT32_MAX;
+
+        inline bool IsReadOnly(ResourceStates state) noexcept
+        {
+            return state != Common && !(state & ~ReadOnly);
+        }
+    }
+
+    class FrameGraph
+    {
+    public:
+        // Identifies one version of a resource: Write returns a new version, and passes that
+        // read it are ordered after the writer.
+        using Handle = uint32_t;
+
+        static constexpr uint32_t Invalid = UINT32_MAX;
+
+        struct TransientDesc
+        {
+            uint32_t        width;
+            uint32_t        height;
+            uint32_t        format;         // DXGI_FORMAT
+            ResourceStates  initialState;   // State the application creates slot textures in
+
+            bool Matches(const TransientDesc& other) const noexcept
+            {
+                return width == other.width && height == other.height && format == other.format;
+            }
+        };
+
+        enum class BarrierType : uint8_t
+        {
+            Transition,
+            UnorderedAccess,
+        };
+
+        enum class BarrierSplit : uint8_t
+        {
+            None,
+            Begin,
+            End,
+        };
+
+        struct Barrier
+        {
+            uint32_t        resource;       // Resource index, see GetExternal
+            ResourceStates  before;
+            ResourceStates  after;
+            BarrierType     type;
+            BarrierSplit    split;
+        };
+
+        FrameGraph() noexcept :
+            m_compiled(false)
+        {
+        }
+
+        FrameGraph(FrameGraph&&) = default;
+        FrameGraph& operator= (FrameGraph&&) = default;
+
+        FrameGraph(FrameGraph const&) = delete;
+        FrameGraph& operator= (FrameGraph const&) = delete;
+
+        // Starts declaring a new frame. Transient slots and their states carry over.
+        void Reset() noexcept
+        {
+            m_passes.clear();
+            m_resources.clear();
+            m_versions.clear();
+            m_schedule.clear();
+            m_barriers.clear();
+            m_batchOffsets.clear();
+            m_compiled = false;
+        }
+
+        // Drops the transient slots as well, for example when the device is lost or the
+        // window is resized. The application releases the slot textures.
+        void ResetTransients() noexcept
+        {
+            Reset();
+            m_slots.clear();
+        }
+
+        // A resource owned by the application, in the given state. After the frame it is left
+        // in finalState, if given. Names must outlive the frame.
+        Handle Import(const char* name, void* external, ResourceStates state, ResourceStates finalState = ResourceState::Unchanged)
+        {
+            CheckDeclaring();
+
+            Resource resource = {};
+            resource.name = name;
+            resource.external = external;
+            resource.initialState = state;
+            resource.finalState = finalState;
+            resource.slot = Invalid;
+            return AddResource(resource);
+        }
+
+        // A resource that only lives within the frame. Compile assigns it a slot.
+        Handle Create(const char* name, const TransientDesc& desc)
+        {
+            CheckDeclaring();
+
+            if (!desc.width || !desc.height)
+                throw std::invalid_argument("Create");
+
+            Resource resource = {};
+            resource.name = name;
+            resource.desc = desc;
+            resource.finalState = ResourceState::Unchanged;
+            resource.slot = Invalid;
+            resource.transient = true;
+            return AddResource(resource);
+        }
+
+        // Returns the pass index for Read, Write and SetSideEffect. Passes run in declaration
+        // order unless their dependencies require otherwise.
+        uint32_t AddPass(const char* name, std::function<void()> execute = nullptr)
+        {
+            CheckDeclaring();
+
+            Pass pass = {};
+            pass.name = name;
+            pass.execute = std::move(execute);
+            m_passes.push_back(std::move(pass));
+            return uint32_t(m_passes.size() - 1);
+        }
+
+        void Read(uint32_t pass, Handle handle, ResourceStates state = ResourceState::PixelShaderResource)
+        {
+            CheckDeclaring();
+
+            if (pass >= m_passes.size() || handle >= m_versions.size())
+                throw std::out_of_range("Read");
+
+            AddAccess(pass, handle, state, false);
+        }
+
+        // Returns the new version of the resource. Only its latest version can be written.
+        // Writes keep the previous contents, so the writer of the version written over is
+        // ordered before this pass and kept alive by it.
+        Handle Write(uint32_t pass, Handle handle, ResourceStates state = ResourceState::RenderTarget)
+        {
+            CheckDeclaring();
+
+            if (pass >= m_passes.size() || handle >= m_versions.size())
+                throw std::out_of_range("Write");
+
+            auto& resource = m_resources[m_versions[handle].resource];
+            if (resource.latest != handle)
+                throw std::logic_error("Write to a stale resource version");
+
+            AddAccess(pass, handle, state, true);
+
+            m_versions.push_back(Version{ m_versions[handle].resource, pass });
+            resource.latest = Handle(m_versions.size() - 1);
+            return resource.latest;
+        }
+
+        // Keeps a pass that writes no imported resource, such as a readback or a query.
+        void SetSideEffect(uint32_t pass)
+        {
+            if (pass >= m_passes.size())
+                throw std::out_of_range("SetSideEffect");
+
+            m_passes[pass].sideEffect = true;
+        }
+
+        // Plans the frame. Transient slot states advance as if the plan is executed.
+        void Compile()
+        {
+            CheckDeclaring();
+
+            BuildEdges();
+            CullPasses();
+            SortPasses();
+            AssignSlots();
+            PlanBarriers();
+
+            m_compiled = true;
+        }
+
+        // Calls sink.ResourceBarriers(const Barrier*, size_t) for each non-empty batch, and
+        // the pass callbacks in between.
+        template<typename Sink>
+        void Execute(Sink& sink) const
+        {
+            if (!m_compiled)
+                throw std::logic_error("Execute before Compile");
+
+            for (size_t batch = 0; batch <= m_schedule.size(); ++batch)
+            {
+                const size_t count = GetBarrierCount(batch);
+                if (count)
+                {
+                    sink.ResourceBarriers(GetBarriers(batch), count);
+                }
+
+                if (batch < m_schedule.size())
+                {
+                    const auto& pass = m_passes[m_schedule[batch]];
+                    if (pass.execute)
+                    {
+                        pass.execute();
+                    }
+                }
+            }
+        }
+
+        // Pass indices in execution order.
+        const std::vector<uint32_t>& GetSchedule() const noexcept { return m_schedule; }
+
+        bool IsCulled(uint32_t pass) const { return m_passes.at(pass).culled; }
+        const char* GetPassName(uint32_t pass) const { return m_passes.at(pass).name; }
+        size_t GetPassCount() const noexcept { return m_passes.size(); }
+
+        // Batch i is recorded before scheduled pass i; the last batch is after the last pass.
+        size_t GetBatchCount() const noexcept { return m_batchOffsets.empty() ? 0 : m_batchOffsets.size() - 1; }
+        const Barrier* GetBarriers(size_t batch) const { return m_barriers.data() + m_batchOffsets.at(batch); }
+        size_t GetBarrierCount(size_t batch) const { return m_batchOffsets.at(batch + 1) - m_batchOffsets.at(batch); }
+        size_t GetTotalBarrierCount() const noexcept { return m_barriers.size(); }
+
+        uint32_t GetResourceIndex(Handle handle) const { return m_versions.at(handle).resource; }
+        size_t GetResourceCount() const noexcept { return m_resources.size(); }
+        const char* GetResourceName(uint32_t resource) const { return m_resources.at(resource).name; }
+        bool IsTransient(uint32_t resource) const { return m_resources.at(resource).transient; }
+
+        // Invalid for transient resources that are not used by any scheduled pass.
+        uint32_t GetSlot(uint32_t resource) const { return m_resources.at(resource).slot; }
+
+        // The imported pointer, or the transient slot's pointer set with SetSlotExternal.
+        void* GetExternal(uint32_t resource) const
+        {
+            const auto& r = m_resources.at(resource);
+            if (!r.transient)
+                return r.external;
+
+            return (r.slot != Invalid) ? m_slots[r.slot].external : nullptr;
+        }
+
+        // The state a resource is left in by the frame.
+        ResourceStates GetFinalState(Handle handle) const { return m_resources[GetResourceIndex(handle)].endState; }
+
+        // Slots are added by Compile with no external pointer; the application creates a
+        // texture for them in the slot's initialState.
+        size_t GetSlotCount() const noexcept { return m_slots.size(); }
+        const TransientDesc& GetSlotDesc(uint32_t slot) const { return m_slots.at(slot).desc; }
+        void* GetSlotExternal(uint32_t slot) const { return m_slots.at(slot).external; }
+        void SetSlotExternal(uint32_t slot, void* external) { m_slots.at(slot).external = external; }
+
+    private:
+        struct Resource
+        {
+            const char*     name;
+            void*           external;
+            TransientDesc   desc;
+            ResourceStates  initialState;
+            ResourceStates  finalState;
+            ResourceStates  endState;
+            Handle          latest;
+            uint32_t        slot;
+            bool            transient;
+        };
+
+        struct Version
+        {
+            uint32_t    resource;
+            uint32_t    producer;       // Pass that wrote it, or Invalid for the initial contents
+        };
+
+        struct Access
+        {
+            Handle          version;    // Version read, or the version written over
+            ResourceStates  state;
+            bool            write;
+        };
+
+        struct Pass
+        {
+            const char*             name;
+            std::function<void()>   execute;
+            std::vector<Access>     accesses;
+            bool                    sideEffect;
+            bool                    culled;
+        };
+
+        struct Slot
+        {
+            TransientDesc   desc;
+            ResourceStates  state;
+            void*           external;
+            uint32_t        busyUntil;
+            bool            busy;
+        };
+
+        // One use of a physical resource (an import or a slot) by a scheduled pass.
+        struct Use
+        {
+            uint32_t        physical;
+            uint32_t        resource;
+            ResourceStates  state;
+            ResourceStates  groupState; // Combined state of this and following consecutive reads
+            bool            write;
+        };
+
+        void CheckDeclaring() const
+        {
+            if (m_compiled)
+                throw std::logic_error("FrameGraph already compiled; call Reset");
+        }
+
+        Handle AddResource(Resource& resource)
+        {
+            const auto index = uint32_t(m_resources.size());
+            m_versions.push_back(Version{ index, Invalid });
+            resource.latest = Handle(m_versions.size() - 1);
+            m_resources.push_back(resource);
+            return resource.latest;
+        }
+
+        // A pass uses a resource in one state. Reads combine into one read-only state;
+        // otherwise reads and writes of the same resource must agree.
+        void AddAccess(uint32_t pass, Handle version, ResourceStates state, bool write)
+        {
+            if (state == ResourceState::Unchanged || (write && ResourceState::IsReadOnly(state)))
+                throw std::invalid_argument("Invalid resource state for access");
+
+            const uint32_t resource = m_versions[version].resource;
+            for (auto& access : m_passes[pass].accesses)
+            {
+                if (m_versions[access.version].resource != resource || access.state == state)
+                    continue;
+
+                if (access.write || write || !ResourceState::IsReadOnly(access.state) || !ResourceState::IsReadOnly(state))
+                    throw std::logic_error("Pass uses a resource in conflicting states");
+            }
+
+            m_passes[pass].accesses.push_back(Access{ version, state, write });
+        }
+
+        // Read after write, write after write and write after read dependencies.
+        void BuildEdges()
+        {
+            m_edges.clear();
+
+            for (uint32_t p = 0; p < m_passes.size(); ++p)
+            {
+                for (const auto& access : m_passes[p].accesses)
+                {
+                    const uint32_t producer = m_versions[access.version].producer;
+                    if (producer != Invalid && producer != p)
+                    {
+                        m_edges.emplace_back(producer, p);
+                    }
+
+                    if (!access.write)
+                        continue;
+
+                    for (uint32_t q = 0; q < m_passes.size(); ++q)
+                    {
+                        if (q == p)
+                            continue;
+
+                        for (const auto& other : m_passes[q].accesses)
+                        {
+                            if (!other.write && other.version == access.version)
+                            {
+                                m_edges.emplace_back(q, p);
+                            }
+                        }
+                    }
+                }
+            }
+
+            std::sort(m_edges.begin(), m_edges.end());
+            m_edges.erase(std::unique(m_edges.begin(), m_edges.end()), m_edges.end());
+        }
+
+        // Keeps passes with side effects or writes to imported resources, and the passes they
+        // depend on.
+        void CullPasses()
+        {
+            std::vector<uint32_t> stack;
+
+            for (uint32_t p = 0; p < m_passes.size(); ++p)
+            {
+                auto& pass = m_passes[p];
+                pass.culled = !pass.sideEffect;
+
+                for (const auto& access : pass.accesses)
+                {
+                    if (access.write && !m_resources[m_versions[access.version].resource].transient)
+                    {
+                        pass.culled = false;
+                    }
+                }
+
+                if (!pass.culled)
+                {
+                    stack.push_back(p);
+                }
+            }
+
+            while (!stack.empty())
+            {
+                const uint32_t p = stack.back();
+                stack.pop_back();
+
+                for (const auto& access : m_passes[p].accesses)
+                {
+                    const uint32_t producer = m_versions[access.version].producer;
+                    if (producer != Invalid && m_passes[producer].culled)
+                    {
+                        m_passes[producer].culled = false;
+                        stack.push_back(producer);
+                    }
+                }
+            }
+        }
+
+        // Topological sort that picks the earliest declared ready pass first, so that a graph
+        // declared in a valid order runs in that order.
+        void SortPasses()
+        {
+            std::vector<uint32_t> inDegree(m_passes.size(), 0);
+            for (const auto& edge : m_edges)
+            {
+                if (!m_passes[edge.first].culled && !m_passes[edge.second].culled)
+                {
+                    ++inDegree[edge.second];
+                }
+            }
+
+            std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> ready;
+            size_t live = 0;
+            for (uint32_t p = 0; p < m_passes.size(); ++p)
+            {
+                if (m_passes[p].culled)
+                    continue;
+
+                ++live;
+                if (!inDegree[p])
+                {
+                    ready.push(p);
+                }
+            }
+
+            m_schedule.clear();
+            while (!ready.empty())
+            {
+                const uint32_t p = ready.top();
+                ready.pop();
+                m_schedule.push_back(p);
+
+                auto edge = std::lower_bound(m_edges.cbegin(), m_edges.cend(), std::make_pair(p, 0u));
+                for (; edge != m_edges.cend() && edge->first == p; ++edge)
+                {
+                    if (!m_passes[edge->second].culled && !--inDegree[edge->second])
+                    {
+                        ready.push(edge->second);
+                    }
+                }
+            }
+
+            if (m_schedule.size() != live)
+                throw std::logic_error("FrameGraph has a dependency cycle");
+        }
+
+        // First fit in order of first use, so assignments are stable from frame to frame.
+        void AssignSlots()
+        {
+            std::vector<uint32_t> firstUse(m_resources.size(), UINT32_MAX);
+            std::vector<uint32_t> lastUse(m_resources.size(), 0);
+
+            for (uint32_t i = 0; i < m_schedule.size(); ++i)
+            {
+                for (const auto& access : m_passes[m_schedule[i]].accesses)
+                {
+                    const uint32_t r = m_versions[access.version].resource;
+                    firstUse[r] = std::min(firstUse[r], i);
+                    lastUse[r] = i;
+                }
+            }
+
+            std::vector<uint32_t> order;
+            for (uint32_t r = 0; r < m_resources.size(); ++r)
+            {
+                if (m_resources[r].transient && firstUse[r] != Invalid)
+                {
+                    order.push_back(r);
+                }
+            }
+
+            std::stable_sort(order.begin(), order.end(), [&firstUse](uint32_t a, uint32_t b)
+            {
+                return firstUse[a] < firstUse[b];
+            });
+
+            for (auto& slot : m_slots)
+            {
+                slot.busy = false;
+            }
+
+            for (const uint32_t r : order)
+            {
+                auto& resource = m_resources[r];
+
+                uint32_t s = 0;
+                for (; s < m_slots.size(); ++s)
+                {
+                    const auto& slot = m_slots[s];
+                    if (slot.desc.Matches(resource.desc) && (!slot.busy || slot.busyUntil < firstUse[r]))
+                        break;
+                }
+
+                if (s == m_slots.size())
+                {
+                    m_slots.push_back(Slot{ resource.desc, resource.desc.initialState, nullptr, 0, false });
+                }
+
+                resource.slot = s;
+                m_slots[s].busy = true;
+                m_slots[s].busyUntil = lastUse[r];
+            }
+        }
+
+        // Tracks each import and slot through the schedule. A transition is needed when the
+        // next use is in another state; consecutive reads share one combined read state. If the
+        // resource is idle for one or more passes before the transition, it is split so the
+        // GPU can start it at the end of the last use.
+        void PlanBarriers()
+        {
+            const size_t physicalCount = m_resources.size() + m_slots.size();
+            const auto Physical = [this](uint32_t r)
+            {
+                return m_resources[r].transient ? uint32_t(m_resources.size()) + m_resources[r].slot : r;
+            };
+
+            // Merge the accesses of each pass into one use per physical resource.
+            std::vector<Use> uses;
+            std::vector<size_t> useOffsets(1, 0);
+            for (const uint32_t p : m_schedule)
+            {
+                const size_t begin = uses.size();
+                for (const auto& access : m_passes[p].accesses)
+                {
+                    const uint32_t r = m_versions[access.version].resource;
+                    const uint32_t physical = Physical(r);
+
+                    auto use = std::find_if(uses.begin() + std::ptrdiff_t(begin), uses.end(),
+                        [physical](const Use& u) { return u.physical == physical; });
+                    if (use == uses.end())
+                    {
+                        uses.push_back(Use{ physical, r, access.state, 0, access.write });
+                    }
+                    else
+                    {
+                        use->state |= access.state;
+                        use->write |= access.write;
+                    }
+                }
+                useOffsets.push_back(uses.size());
+            }
+
+            // Backward: combine each read with the consecutive reads after it.
+            std::vector<ResourceStates> pendingReads(physicalCount, 0);
+            for (size_t i = uses.size(); i-- > 0;)
+            {
+                auto& use = uses[i];
+                if (ResourceState::IsReadOnly(use.state))
+                {
+                    pendingReads[use.physical] |= use.state;
+                    use.groupState = pendingReads[use.physical];
+                }
+                else
+                {
+                    pendingReads[use.physical] = 0;
+                    use.groupState = use.state;
+                }
+            }
+
+            // Forward: place the transitions.
+            std::vector<ResourceStates> states(physicalCount);
+            std::vector<uint32_t> nextBatch(physicalCount, 0);   // First batch after the last use
+            std::vector<bool> used(physicalCount, false);
+            for (uint32_t r = 0; r < m_resources.size(); ++r)
+            {
+                states[r] = m_resources[r].initialState;
+            }
+            for (size_t s = 0; s < m_slots.size(); ++s)
+            {
+                states[m_resources.size() + s] = m_slots[s].state;
+            }
+
+            std::vector<std::pair<uint32_t, Barrier>> planned;
+            const auto Transition = [&](uint32_t resource, uint32_t physical, ResourceStates after, uint32_t batch)
+            {
+                const ResourceStates before = states[physical];
+                if (nextBatch[physical] < batch)
+                {
+                    planned.emplace_back(nextBatch[physical], Barrier{ resource, before, after, BarrierType::Transition, BarrierSplit::Begin });
+                    planned.emplace_back(batch, Barrier{ resource, before, after, BarrierType::Transition, BarrierSplit::End });
+                }
+                else
+                {
+                    planned.emplace_back(batch, Barrier{ resource, before, after, BarrierType::Transition, BarrierSplit::None });
+                }
+                states[physical] = after;
+            };
+
+            for (uint32_t batch = 0; batch < m_schedule.size(); ++batch)
+            {
+                for (size_t i = useOffsets[batch]; i < useOffsets[batch + 1]; ++i)
+                {
+                    const auto& use = uses[i];
+                    const ResourceStates current = states[use.physical];
+
+                    const bool satisfied = (current == use.groupState)
+                        || (ResourceState::IsReadOnly(use.groupState) && ResourceState::IsReadOnly(current)
+                            && (current & use.groupState) == use.groupState);
+
+                    if (!satisfied)
+                    {
+                        Transition(use.resource, use.physical, use.groupState, batch);
+                    }
+                    else if (current == ResourceState::UnorderedAccess && used[use.physical])
+                    {
+                        planned.emplace_back(batch, Barrier{ use.resource, current, current, BarrierType::UnorderedAccess, BarrierSplit::None });
+                    }
+
+                    used[use.physical] = true;
+                    nextBatch[use.physical] = batch + 1;
+                }
+            }
+
+            const auto endBatch = uint32_t(m_schedule.size());
+            for (uint32_t r = 0; r < m_resources.size(); ++r)
+            {
+                auto& resource = m_resources[r];
+                if (resource.transient)
+                    continue;
+
+                if (resource.finalState != ResourceState::Unchanged && states[r] != resource.finalState)
+                {
+                    Transition(r, r, resource.finalState, endBatch);
+                }
+                resource.endState = states[r];
+            }
+
+            for (uint32_t s = 0; s < m_slots.size(); ++s)
+            {
+                m_slots[s].state = states[m_resources.size() + s];
+            }
+
+            for (auto& resource : m_resources)
+            {
+                if (resource.transient)
+                {
+                    resource.endState = (resource.slot != Invalid) ? m_slots[resource.slot].state : resource.desc.initialState;
+                }
+            }
+
+            std::stable_sort(planned.begin(), planned.end(),
+                [](const std::pair<uint32_t, Barrier>& a, const std::pair<uint32_t, Barrier>& b)
+                {
+                    return a.first < b.first;
+                });
+
+            m_barriers.clear();
+            m_batchOffsets.assign(m_schedule.size() + 2, 0);
+            for (const auto& barrier : planned)
+            {
+                ++m_batchOffsets[barrier.first + 1];
+                m_barriers.push_back(barrier.second);
+            }
+            for (size_t i = 1; i < m_batchOffsets.size(); ++i)
+            {
+                m_batchOffsets[i] += m_batchOffsets[i - 1];
+            }
+        }
+
+        bool                                        m_compiled;
+        std::vector<Pass>                           m_passes;
+        std::vector<Resource>                       m_resources;
+        std::vector<Version>                        m_versions;
+        std::vector<std::pair<uint32_t, uint32_t>>  m_edges;
+        std::vector<uint32_t>                       m_schedule;
+        std::vector<Barrier>                        m_barriers;
+        std::vector<size_t>                         m_batchOffsets;
+        std::vector<Slot>                           m_slots;
+    };
+
+#if defined(__d3d12_h__)
+    static_assert(ResourceState::RenderTarget == D3D12_RESOURCE_STATE_RENDER_TARGET, "ResourceState mismatch");
+    static_assert(ResourceState::UnorderedAccess == D3D12_RESOURCE_STATE_UNORDERED_ACCESS, "ResourceState mismatch");
+    static_assert(ResourceState::DepthWrite == D3D12_RESOURCE_STATE_DEPTH_WRITE, "ResourceState mismatch");
+    static_assert(ResourceState::PixelShaderResource == D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, "ResourceState mismatch");
+    static_assert(ResourceState::CopySource == D3D12_RESOURCE_STATE_COPY_SOURCE, "ResourceState mismatch");
+    static_assert(ResourceState::ResolveSource == D3D12_RESOURCE_STATE_RESOLVE_SOURCE, "ResourceState mismatch");
+
+    // Records a compiled frame graph's barriers with one ResourceBarrier call per batch. The
+    // graph's external pointers are ID3D12Resource*.
+    class FrameGraphCommandList
+    {
+    public:
+        FrameGraphCommandList(_In_ ID3D12GraphicsCommandList* commandList, const FrameGraph& graph) :
+            m_commandList(commandList),
+            m_graph(graph)
+        {
+        }
+
+        FrameGraphCommandList(FrameGraphCommandList const&) = delete;
+        FrameGraphCommandList& operator= (FrameGraphCommandList const&) = delete;
+
+        void ResourceBarriers(const FrameGraph::Barrier* barriers, size_t count)
+        {
+            m_barriers.resize(count);
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                const auto& barrier = barriers[i];
+                auto resource = static_cast<ID3D12Resource*>(m_graph.GetExternal(barrier.resource));
+                if (!resource)
+                    throw std::logic_error("Frame graph resource has no D3D12 resource");
+
+                auto& d3dBarrier = m_barriers[i];
+                d3dBarrier = {};
+
+                if (barrier.type == FrameGraph::BarrierType::UnorderedAccess)
+                {
+                    d3dBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+                    d3dBarrier.UAV.pResource = resource;
+                    continue;
+                }
+
+                d3dBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+                d3dBarrier.Flags = (barrier.split == FrameGraph::BarrierSplit::Begin) ? D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY
+                    : (barrier.split == FrameGraph::BarrierSplit::End) ? D3D12_RESOURCE_BARRIER_FLAG_END_ONLY
+                    : D3D12_RESOURCE_BARRIER_FLAG_NONE;
+                d3dBarrier.Transition.pResource = resource;
+                d3dBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+                d3dBarrier.Transition.StateBefore = D3D12_RESOURCE_STATES(barrier.before);
+                d3dBarrier.Transition.StateAfter = D3D12_RESOURCE_STATES(barrier.after);
+            }
+
+            m_commandList->ResourceBarrier(static_cast<UINT>(count), m_barriers.data());
+        }
+
+    private:
+        ID3D12GraphicsCommandList*          m_commandList;
+        const FrameGraph&                   m_graph;
+        std::vector<D3D12_RESOURCE_BARRIER> m_barriers;
+    };
+#endif
+}
@@ -0,0 +1,169 @@
+//--------------------------------------------------------------------------------------
+// File: FrameRingAllocator.h
+//
+// Bookkeeping for suballocating per-frame dynamic data from one large buffer used as a
+// ring. Allocations are made at the head; EndFrame closes the frame's allocations under a
+// fence value, and Retire frees every closed frame whose fence value the GPU has reached,
+// moving the tail up. An allocation that does not fit before the end of the buffer wraps
+// to offset 0 and the skipped bytes are freed with the frame.
+//
+// The allocator only deals in offsets and fence values. On Direct3D 11 the buffer is
+// mapped with NO_OVERWRITE and the fence is an event query per frame; on Direct3D 12 it
+// is a persistently mapped upload heap and an ID3D12Fence.
+//
+// This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace DX
+{
+    class FrameRingAllocator
+    {
+    public:
+        // Returned by Allocate when the ring is too full.
+        static constexpr size_t Invalid = SIZE_MAX;
+
+        explicit FrameRingAllocator(size_t capacity = 0, size_t maxFramesInFlight = 8) :
+            m_capacity(capacity),
+            m_head(0),
+            m_tail(0),
+            m_used(0),
+            m_frameBytes(0),
+            m_frames(maxFramesInFlight),
+            m_firstFrame(0),
+            m_frameCount(0)
+        {
+            if (!maxFramesInFlight)
+                throw std::invalid_argument("Invalid frame count");
+        }
+
+        FrameRingAllocator(FrameRingAllocator&&) = default;
+        FrameRingAllocator& operator= (FrameRingAllocator&&) = default;
+
+        FrameRingAllocator(FrameRingAllocator const&) = default;
+        FrameRingAllocator& operator= (FrameRingAllocator const&) = default;
+
+        // Returns the offset of size bytes aligned to alignment (a power of 2), or Invalid
+        // if they do not fit until more frames are retired.
+        size_t Allocate(size_t size, size_t alignment = 16)
+        {
+            if (!alignment || (alignment & (alignment - 1)))
+                throw std::invalid_argument("Alignment must be a power of 2");
+
+            if (!size || size > m_capacity)
+                throw std::invalid_argument("Invalid allocation size");
+
+            if (!m_used)
+            {
+                // Nothing is in flight, so start over at the beginning.
+                m_head = m_tail = 0;
+            }
+
+            size_t offset = AlignUp(m_head, alignment);
+            size_t end = offset + size;
+
+            const bool wrapped = (m_head < m_tail) || (m_head == m_tail && m_used);
+            if (wrapped)
+            {
+                // The free space is between the head and the tail.
+                if (end > m_tail)
+                    return Invalid;
+            }
+            else if (end > m_capacity)
+            {
+                // Skip the rest of the buffer and continue from the start.
+                offset = 0;
+                end = size;
+                if (end > m_tail)
+                    return Invalid;
+            }
+
+            const size_t consumed = (end >= m_head) ? (end - m_head) : (m_capacity - m_head + end);
+            m_used += consumed;
+            m_frameBytes += consumed;
+            m_head = (end == m_capacity) ? 0 : end;
+            return offset;
+        }
+
+        // Closes the allocations made since the last EndFrame; they stay live until Retire
+        // sees fenceValue. Fence values must increase.
+        void EndFrame(uint64_t fenceValue)
+        {
+            if (!m_frameBytes)
+                return;
+
+            if (m_frameCount == m_frames.size())
+                throw std::logic_error("Too many frames in flight");
+
+            if (m_frameCount && fenceValue <= m_frames[(m_firstFrame + m_frameCount - 1) % m_frames.size()].fenceValue)
+                throw std::invalid_argument("Fence values must increase");
+
+            m_frames[(m_firstFrame + m_frameCount) % m_frames.size()] = { fenceValue, m_frameBytes };
+            ++m_frameCount;
+            m_frameBytes = 0;
+        }
+
+        // Frees the frames whose fence value is at or below completedValue.
+        void Retire(uint64_t completedValue) noexcept
+        {
+            while (m_frameCount && m_frames[m_firstFrame].fenceValue <= completedValue)
+            {
+                const size_t bytes = m_frames[m_firstFrame].bytes;
+                m_tail = (m_tail + bytes) % m_capacity;
+                m_used -= bytes;
+                m_firstFrame = (m_firstFrame + 1) % m_frames.size();
+                --m_frameCount;
+            }
+        }
+
+        // Forgets every allocation, e.g. after the buffer was discarded or the GPU idled.
+        void Reset() noexcept
+        {
+            m_head = m_tail = 0;
+            m_used = 0;
+            m_frameBytes = 0;
+            m_firstFrame = 0;
+            m_frameCount = 0;
+        }
+
+        // The fence value that frees the oldest frame in flight, or 0 if there is none.
+        uint64_t GetOldestFenceValue() const noexcept
+        {
+            return m_frameCount ? m_frames[m_firstFrame].fenceValue : 0;
+        }
+
+        size_t GetCapacity() const noexcept { return m_capacity; }
+        size_t GetUsedBytes() const noexcept { return m_used; }
+        size_t GetFramesInFlight() const noexcept { return m_frameCount; }
+
+    private:
+        struct Frame
+        {
+            uint64_t    fenceValue;
+            size_t      bytes;
+        };
+
+        static size_t AlignUp(size_t value, size_t alignment) noexcept
+        {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        size_t              m_capacity;
+        size_t              m_head;
+        size_t              m_tail;
+        size_t              m_used;
+        size_t              m_frameBytes;
+        std::vector<Frame>  m_frames;
+        size_t              m_firstFrame;
+        size_t              m_frameCount;
+    };
+}
@@ -0,0 +1,83 @@
+//--------------------------------------------------------------------------------------
+// File: Frustum.h
+//
+// View frustum as six planes extracted from a view-projection matrix (Gribb/Hartmann).
+// The matrix is 16 floats in the row-major, row-vector layout of DirectXMath and
+// SimpleMath (clip = v * M), with Direct3D's [0, w] depth range, so &viewProj._11 of a
+// SimpleMath::Matrix can be passed as is. Planes are normalized and point inward: a point
+// is inside when a * x + b * y + c * z + d >= 0 for all six.
+//
+// This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+namespace DX
+{
+    struct Frustum
+    {
+        enum Plane
+        {
+            Left,
+            Right,
+            Bottom,
+            Top,
+            Near,
+            Far,
+            PlaneCount
+        };
+
+        float planes[PlaneCount][4];
+
+        static Frustum FromViewProjection(const float m[16]) noexcept
+        {
+            // Column j of the matrix is m[j], m[4 + j], m[8 + j], m[12 + j].
+            Frustum frustum = {};
+            for (size_t j = 0; j < 4; ++j)
+            {
+                const float c0 = m[j * 4];
+                const float c1 = m[j * 4 + 1];
+                const float c2 = m[j * 4 + 2];
+                const float c3 = m[j * 4 + 3];
+
+                frustum.planes[Left][j] = c3 + c0;
+                frustum.planes[Right][j] = c3 - c0;
+                frustum.planes[Bottom][j] = c3 + c1;
+                frustum.planes[Top][j] = c3 - c1;
+                frustum.planes[Near][j] = c2;
+                frustum.planes[Far][j] = c3 - c2;
+            }
+
+            for (auto& plane : frustum.planes)
+            {
+                const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+                if (length > 0.f)
+                {
+                    for (size_t j = 0; j < 4; ++j)
+                    {
+                        plane[j] /= length;
+                    }
+                }
+            }
+
+            return frustum;
+        }
+
+        // False only when the sphere is entirely outside one of the planes.
+        bool IntersectsSphere(float x, float y, float z, float radius) const noexcept
+        {
+            for (const auto& plane : planes)
+            {
+                if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < -radius)
+                    return false;
+            }
+            return true;
+        }
+    };
+}
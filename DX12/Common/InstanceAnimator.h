@@ -0,0 +1,617 @@
+//--------------------------------------------------------------------------------------
+// File: InstanceAnimator.h
+//
+// Batched generator for animated per-instance transforms, written straight into mapped
+// upload or dynamic buffers. This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define INSTANCEANIMATOR_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(INSTANCEANIMATOR_SSE2) && defined(__AVX__)
+#define INSTANCEANIMATOR_AVX
+#include <immintrin.h>
+#endif
+
+#include "ParallelFor.h"
+#include "QuantizedInstance.h"
+#include "SphereCuller.h"
+
+namespace DX
+{
+    // Instances sit on a grid in the XY plane and bob in Z by
+    // amplitude * cos(time + x * frequency) * sin(time + y * frequency).
+    class InstanceAnimator
+    {
+    public:
+        // Instances evaluated per step.
+        static constexpr size_t BatchSize = 8;
+
+        // Floats written per instance: three rows of an XMFLOAT3X4.
+        static constexpr size_t TransformFloats = 12;
+
+        explicit InstanceAnimator(WorkerPool* pool = nullptr) noexcept :
+            m_pool(pool),
+            m_columns(0),
+            m_rows(0),
+            m_originX(0.f),
+            m_originY(0.f),
+            m_spacing(1.f),
+            m_frequency(0.78539816f),
+            m_amplitude(2.f),
+            m_culler(pool)
+        {
+        }
+
+        InstanceAnimator(InstanceAnimator&&) = default;
+        InstanceAnimator& operator= (InstanceAnimator&&) = default;
+
+        InstanceAnimator(InstanceAnimator const&) = default;
+        InstanceAnimator& operator= (InstanceAnimator const&) = default;
+
+        // Instance j is at column j % columns and row j / columns. Scratch memory is
+        // allocated here; Write and WriteVisible do not allocate.
+        void SetGrid(size_t columns, size_t rows, float originX, float originY, float spacing)
+        {
+            if (!columns || !rows || columns > INT32_MAX || rows > INT32_MAX || columns > SIZE_MAX / rows)
+                throw std::invalid_argument("Invalid grid size");
+
+            m_columns = columns;
+            m_rows = rows;
+            m_originX = originX;
+            m_originY = originY;
+            m_spacing = spacing;
+            UpdateClusters();
+        }
+
+        // Radians of phase per unit of distance, and the height of the wave.
+        void SetWave(float frequency, float amplitude)
+        {
+            m_frequency = frequency;
+            m_amplitude = amplitude;
+            UpdateClusters();
+        }
+
+        size_t GetCount() const noexcept { return m_columns * m_rows; }
+
+        size_t GetSizeInBytes() const noexcept { return GetCount() * TransformFloats * sizeof(float); }
+
+        size_t GetQuantizedSizeInBytes() const noexcept { return GetCount() * sizeof(QuantizedInstance); }
+
+        // The clusters WriteVisibleQuantized refers to, one per chunk of instances. They
+        // change only with SetGrid and SetWave.
+        const std::vector<InstanceCluster>& GetClusters() const noexcept { return m_clusters; }
+
+        // Writes GetCount() transforms to dest, which must be 16-byte aligned. Eight instances
+        // are evaluated per step with a vectorized sin/cos, two SSE2 halves or one AVX register
+        // when the build targets AVX, and the rows are streamed into dest: the stores bypass
+        // the cache, so nothing is read back from write-combined memory. Large counts are
+        // split across the WorkerPool.
+        void Write(float time, void* dest) const
+        {
+            if (reinterpret_cast<uintptr_t>(dest) & 15)
+                throw std::invalid_argument("Destination must be 16-byte aligned");
+
+            const size_t count = GetCount();
+            auto out = static_cast<float*>(dest);
+
+            auto write = [&](size_t begin, size_t end, size_t)
+            {
+                WriteRange(time, begin * BatchSize, std::min(end * BatchSize, count), out);
+            };
+
+            const size_t batches = (count + BatchSize - 1) / BatchSize;
+            if (m_pool)
+            {
+                m_pool->Run(batches, c_minBatches, write);
+            }
+            else
+            {
+                write(0, batches, 0);
+            }
+        }
+
+        // Writes the transforms of the instances whose bounding sphere of the given radius
+        // intersects the frustum, packed from dest, which must be 16-byte aligned and have
+        // room for GetCount(). Returns how many were written. The instances are grouped by
+        // the level lods picks, level 0 first; levelCounts, if given, receives lods.levels
+        // counts.
+        //
+        // The positions go to a SphereCuller, which drops whole chunks by their bounds, the
+        // grid cells they cover and the height of the wave, then culls, buckets and compacts
+        // the rest. Only the chunks it keeps are evaluated.
+        size_t WriteVisible(float time, const Frustum& frustum, float radius, void* dest,
+            const LodSelector& lods = LodSelector(), size_t* levelCounts = nullptr)
+        {
+            if (reinterpret_cast<uintptr_t>(dest) & 15)
+                throw std::invalid_argument("Destination must be 16-byte aligned");
+
+            auto out = static_cast<float*>(dest);
+            return m_culler.Cull(frustum, radius, lods, levelCounts, Centers{ this, time }, [&](size_t, const float* visible, size_t offset, size_t n)
+            {
+                CopyVisible(visible, n, out + offset * TransformFloats);
+            });
+        }
+
+        // As WriteVisible, in the quantized format with identity rotation and unit scale, for
+        // a third of the bandwidth. Each chunk is its own cluster.
+        size_t WriteVisibleQuantized(float time, const Frustum& frustum, float radius, void* dest,
+            const LodSelector& lods = LodSelector(), size_t* levelCounts = nullptr)
+        {
+            if (reinterpret_cast<uintptr_t>(dest) & 15)
+                throw std::invalid_argument("Destination must be 16-byte aligned");
+
+            auto out = static_cast<QuantizedInstance*>(dest);
+            return m_culler.Cull(frustum, radius, lods, levelCounts, Centers{ this, time }, [&](size_t chunk, const float* visible, size_t offset, size_t n)
+            {
+                QuantizedInstance::EncodeInstances(m_clusters[chunk], uint32_t(chunk), n, visible, nullptr, nullptr, out + offset);
+            });
+        }
+
+        // A single transform, for reference. This is the scalar path used without SSE2; it
+        // evaluates the same polynomials.
+        void GetTransform(size_t index, float time, float transform[TransformFloats]) const
+        {
+            if (index >= GetCount())
+                throw std::out_of_range("Invalid instance");
+
+            float x, y;
+            GetPosition(index, x, y);
+
+            const float z = m_amplitude * Cos(time + x * m_frequency) * Sin(time + y * m_frequency);
+            SetTransform(transform, x, y, z);
+        }
+
+    private:
+        // 16K instances a thread at least; fewer are not worth the wake up.
+        static constexpr size_t c_minBatches = 2048;
+
+        static_assert(BatchSize == SphereCuller::BatchSize, "WriteCenters fills whole culler batches");
+
+        // Hands SphereCuller::Cull the positions of each chunk it keeps.
+        struct Centers
+        {
+            const InstanceAnimator* animator;
+            float                   time;
+
+            void operator() (size_t begin, size_t end, float* x, float* y, float* z) const noexcept
+            {
+                animator->WriteCenters(time, begin, end, x, y, z);
+            }
+        };
+
+        // A cluster bounds the rows, or the part of a row, that its chunk covers, and the
+        // height of the wave. The culler gets the same bounds, padded for rounding.
+        void UpdateClusters()
+        {
+            const size_t count = GetCount();
+            const size_t chunks = SphereCuller::GetChunkCount(count);
+            const float amplitude = std::abs(m_amplitude);
+            const float pad = (std::abs(m_spacing) + amplitude) * 1e-3f;
+
+            std::vector<AxisAlignedBox> boxes(chunks);
+            m_clusters.resize(chunks);
+            for (size_t chunk = 0; chunk < chunks; ++chunk)
+            {
+                const size_t first = chunk * SphereCuller::ChunkSize;
+                const size_t last = std::min(first + SphereCuller::ChunkSize, count) - 1;
+
+                size_t firstColumn = first % m_columns;
+                size_t lastColumn = last % m_columns;
+                if (first / m_columns != last / m_columns)
+                {
+                    firstColumn = 0;
+                    lastColumn = m_columns - 1;
+                }
+
+                float minimum[3], maximum[3];
+                GetPosition(first / m_columns * m_columns + firstColumn, minimum[0], minimum[1]);
+                GetPosition(last / m_columns * m_columns + lastColumn, maximum[0], maximum[1]);
+                for (size_t j = 0; j < 2; ++j)
+                {
+                    if (minimum[j] > maximum[j])
+                    {
+                        std::swap(minimum[j], maximum[j]);
+                    }
+                }
+                minimum[2] = -amplitude;
+                maximum[2] = amplitude;
+
+                m_clusters[chunk] = InstanceCluster::FromBounds(minimum, maximum);
+
+                for (size_t j = 0; j < 3; ++j)
+                {
+                    boxes[chunk].minimum[j] = minimum[j] - pad;
+                    boxes[chunk].maximum[j] = maximum[j] + pad;
+                }
+            }
+
+            m_culler.SetSpheres(count, boxes.data());
+        }
+
+        void GetPosition(size_t index, float& x, float& y) const noexcept
+        {
+            x = m_originX + m_spacing * float(index % m_columns);
+            y = m_originY + m_spacing * float(index / m_columns);
+        }
+
+        static void SetTransform(float* transform, float x, float y, float z) noexcept
+        {
+            const float rows[TransformFloats] =
+            {
+                1.f, 0.f, 0.f, x,
+                0.f, 1.f, 0.f, y,
+                0.f, 0.f, 1.f, z,
+            };
+            memcpy(transform, rows, sizeof(rows));
+        }
+
+        // Minimax polynomials as in XMScalarSinCos. The angle is brought into [-pi, pi] by
+        // subtracting 2pi in two parts, the first exact for quotients up to 2^16, so phases of
+        // a large grid keep their precision; then reflected into [-pi/2, pi/2], which flips
+        // the sign of the cosine.
+        static float Reduce(float angle, float& sign) noexcept
+        {
+            // Rounds half to even, as the SIMD conversions do.
+            const float quotient = std::nearbyint(angle * 0.15915494f);
+            float x = (angle - 6.28125f * quotient) - 0.0019353072f * quotient;
+
+            sign = 1.f;
+            if (x > 1.57079633f)
+            {
+                x = 3.14159265f - x;
+                sign = -1.f;
+            }
+            else if (x < -1.57079633f)
+            {
+                x = -3.14159265f - x;
+                sign = -1.f;
+            }
+            return x;
+        }
+
+        static float Sin(float angle) noexcept
+        {
+            float sign;
+            const float x = Reduce(angle, sign);
+            const float x2 = x * x;
+            return (((((-2.3889859e-08f * x2 + 2.7525562e-06f) * x2 - 0.00019840874f) * x2
+                + 0.0083333310f) * x2 - 0.16666667f) * x2 + 1.f) * x;
+        }
+
+        static float Cos(float angle) noexcept
+        {
+            float sign;
+            const float x = Reduce(angle, sign);
+            const float x2 = x * x;
+            return (((((-2.6051615e-07f * x2 + 2.4760495e-05f) * x2 - 0.0013888378f) * x2
+                + 0.041666638f) * x2 - 0.5f) * x2 + 1.f) * sign;
+        }
+
+    #if defined(INSTANCEANIMATOR_SSE2)
+        // Writes the four instances held in the lanes of x, y and z.
+        static void StoreInstances(float* dest, __m128 x, __m128 y, __m128 z) noexcept
+        {
+            StoreInstance<0>(dest, x, y, z);
+            StoreInstance<1>(dest + TransformFloats, x, y, z);
+            StoreInstance<2>(dest + TransformFloats * 2, x, y, z);
+            StoreInstance<3>(dest + TransformFloats * 3, x, y, z);
+        }
+
+        template<int Lane>
+        static void StoreInstance(float* dest, __m128 x, __m128 y, __m128 z) noexcept
+        {
+            const __m128 maskW = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+            const __m128 row0 = _mm_setr_ps(1.f, 0.f, 0.f, 0.f);
+            const __m128 row1 = _mm_setr_ps(0.f, 1.f, 0.f, 0.f);
+            const __m128 row2 = _mm_setr_ps(0.f, 0.f, 1.f, 0.f);
+
+            _mm_stream_ps(dest, _mm_or_ps(row0, _mm_and_ps(_mm_shuffle_ps(x, x, _MM_SHUFFLE(Lane, Lane, Lane, Lane)), maskW)));
+            _mm_stream_ps(dest + 4, _mm_or_ps(row1, _mm_and_ps(_mm_shuffle_ps(y, y, _MM_SHUFFLE(Lane, Lane, Lane, Lane)), maskW)));
+            _mm_stream_ps(dest + 8, _mm_or_ps(row2, _mm_and_ps(_mm_shuffle_ps(z, z, _MM_SHUFFLE(Lane, Lane, Lane, Lane)), maskW)));
+        }
+    #endif
+
+    #if defined(INSTANCEANIMATOR_AVX)
+        static __m256 Select(__m256 mask, __m256 a, __m256 b) noexcept
+        {
+            return _mm256_blendv_ps(b, a, mask);
+        }
+
+        static __m256 Reduce(__m256 angle, __m256& sign) noexcept
+        {
+            const __m256 quotient = _mm256_round_ps(_mm256_mul_ps(angle, _mm256_set1_ps(0.15915494f)),
+                _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            __m256 x = _mm256_sub_ps(angle, _mm256_mul_ps(quotient, _mm256_set1_ps(6.28125f)));
+            x = _mm256_sub_ps(x, _mm256_mul_ps(quotient, _mm256_set1_ps(0.0019353072f)));
+
+            const __m256 high = _mm256_cmp_ps(x, _mm256_set1_ps(1.57079633f), _CMP_GT_OQ);
+            const __m256 low = _mm256_cmp_ps(x, _mm256_set1_ps(-1.57079633f), _CMP_LT_OQ);
+            x = Select(high, _mm256_sub_ps(_mm256_set1_ps(3.14159265f), x), x);
+            x = Select(low, _mm256_sub_ps(_mm256_set1_ps(-3.14159265f), x), x);
+            sign = Select(_mm256_or_ps(high, low), _mm256_set1_ps(-1.f), _mm256_set1_ps(1.f));
+            return x;
+        }
+
+        static __m256 MulAdd(__m256 a, __m256 b, float c) noexcept
+        {
+            return _mm256_add_ps(_mm256_mul_ps(a, b), _mm256_set1_ps(c));
+        }
+
+        static __m256 Sin(__m256 angle) noexcept
+        {
+            __m256 sign;
+            const __m256 x = Reduce(angle, sign);
+            const __m256 x2 = _mm256_mul_ps(x, x);
+            __m256 p = MulAdd(_mm256_set1_ps(-2.3889859e-08f), x2, 2.7525562e-06f);
+            p = MulAdd(p, x2, -0.00019840874f);
+            p = MulAdd(p, x2, 0.0083333310f);
+            p = MulAdd(p, x2, -0.16666667f);
+            p = MulAdd(p, x2, 1.f);
+            return _mm256_mul_ps(p, x);
+        }
+
+        static __m256 Cos(__m256 angle) noexcept
+        {
+            __m256 sign;
+            const __m256 x = Reduce(angle, sign);
+            const __m256 x2 = _mm256_mul_ps(x, x);
+            __m256 p = MulAdd(_mm256_set1_ps(-2.6051615e-07f), x2, 2.4760495e-05f);
+            p = MulAdd(p, x2, -0.0013888378f);
+            p = MulAdd(p, x2, 0.041666638f);
+            p = MulAdd(p, x2, -0.5f);
+            p = MulAdd(p, x2, 1.f);
+            return _mm256_mul_ps(p, sign);
+        }
+    #elif defined(INSTANCEANIMATOR_SSE2)
+        static __m128 Select(__m128 mask, __m128 a, __m128 b) noexcept
+        {
+            return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+        }
+
+        static __m128 Reduce(__m128 angle, __m128& sign) noexcept
+        {
+            // Conversion rounds to nearest under the default rounding mode.
+            const __m128 quotient = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(angle, _mm_set1_ps(0.15915494f))));
+            __m128 x = _mm_sub_ps(angle, _mm_mul_ps(quotient, _mm_set1_ps(6.28125f)));
+            x = _mm_sub_ps(x, _mm_mul_ps(quotient, _mm_set1_ps(0.0019353072f)));
+
+            const __m128 high = _mm_cmpgt_ps(x, _mm_set1_ps(1.57079633f));
+            const __m128 low = _mm_cmplt_ps(x, _mm_set1_ps(-1.57079633f));
+            x = Select(high, _mm_sub_ps(_mm_set1_ps(3.14159265f), x), x);
+            x = Select(low, _mm_sub_ps(_mm_set1_ps(-3.14159265f), x), x);
+            sign = Select(_mm_or_ps(high, low), _mm_set1_ps(-1.f), _mm_set1_ps(1.f));
+            return x;
+        }
+
+        static __m128 MulAdd(__m128 a, __m128 b, float c) noexcept
+        {
+            return _mm_add_ps(_mm_mul_ps(a, b), _mm_set1_ps(c));
+        }
+
+        static __m128 Sin(__m128 angle) noexcept
+        {
+            __m128 sign;
+            const __m128 x = Reduce(angle, sign);
+            const __m128 x2 = _mm_mul_ps(x, x);
+            __m128 p = MulAdd(_mm_set1_ps(-2.3889859e-08f), x2, 2.7525562e-06f);
+            p = MulAdd(p, x2, -0.00019840874f);
+            p = MulAdd(p, x2, 0.0083333310f);
+            p = MulAdd(p, x2, -0.16666667f);
+            p = MulAdd(p, x2, 1.f);
+            return _mm_mul_ps(p, x);
+        }
+
+        static __m128 Cos(__m128 angle) noexcept
+        {
+            __m128 sign;
+            const __m128 x = Reduce(angle, sign);
+            const __m128 x2 = _mm_mul_ps(x, x);
+            __m128 p = MulAdd(_mm_set1_ps(-2.6051615e-07f), x2, 2.4760495e-05f);
+            p = MulAdd(p, x2, -0.0013888378f);
+            p = MulAdd(p, x2, 0.041666638f);
+            p = MulAdd(p, x2, -0.5f);
+            p = MulAdd(p, x2, 1.f);
+            return _mm_mul_ps(p, sign);
+        }
+    #endif
+
+    #if defined(INSTANCEANIMATOR_AVX)
+        struct Batch
+        {
+            __m256 x, y, z;
+        };
+    #elif defined(INSTANCEANIMATOR_SSE2)
+        struct Batch
+        {
+            __m128 x[2], y[2], z[2];
+        };
+    #endif
+
+    #if defined(INSTANCEANIMATOR_SSE2)
+        // Evaluates the eight instances from column, row on, and moves those on by n. Lanes
+        // from n on hold positions past the range and are not to be used.
+        void Evaluate(float time, size_t& column, size_t& row, size_t n, Batch& batch) const noexcept
+        {
+            alignas(32) float xs[BatchSize];
+            alignas(32) float ys[BatchSize];
+
+            for (size_t k = 0; k < BatchSize; ++k)
+            {
+                xs[k] = m_originX + m_spacing * float(int32_t(column));
+                ys[k] = m_originY + m_spacing * float(int32_t(row));
+                if (k < n && ++column == m_columns)
+                {
+                    column = 0;
+                    ++row;
+                }
+            }
+
+        #if defined(INSTANCEANIMATOR_AVX)
+            const __m256 vtime = _mm256_set1_ps(time);
+            const __m256 frequency = _mm256_set1_ps(m_frequency);
+
+            batch.x = _mm256_load_ps(xs);
+            batch.y = _mm256_load_ps(ys);
+            batch.z = _mm256_mul_ps(_mm256_set1_ps(m_amplitude),
+                _mm256_mul_ps(Cos(_mm256_add_ps(vtime, _mm256_mul_ps(batch.x, frequency))),
+                    Sin(_mm256_add_ps(vtime, _mm256_mul_ps(batch.y, frequency)))));
+        #else
+            const __m128 vtime = _mm_set1_ps(time);
+            const __m128 frequency = _mm_set1_ps(m_frequency);
+            const __m128 amplitude = _mm_set1_ps(m_amplitude);
+
+            for (size_t k = 0; k < 2; ++k)
+            {
+                batch.x[k] = _mm_load_ps(xs + k * 4);
+                batch.y[k] = _mm_load_ps(ys + k * 4);
+                batch.z[k] = _mm_mul_ps(amplitude,
+                    _mm_mul_ps(Cos(_mm_add_ps(vtime, _mm_mul_ps(batch.x[k], frequency))),
+                        Sin(_mm_add_ps(vtime, _mm_mul_ps(batch.y[k], frequency)))));
+            }
+        #endif
+        }
+
+        static void StoreBatch(float* dest, const Batch& batch) noexcept
+        {
+        #if defined(INSTANCEANIMATOR_AVX)
+            StoreInstances(dest, _mm256_castps256_ps128(batch.x), _mm256_castps256_ps128(batch.y), _mm256_castps256_ps128(batch.z));
+            StoreInstances(dest + TransformFloats * 4,
+                _mm256_extractf128_ps(batch.x, 1), _mm256_extractf128_ps(batch.y, 1), _mm256_extractf128_ps(batch.z, 1));
+        #else
+            StoreInstances(dest, batch.x[0], batch.y[0], batch.z[0]);
+            StoreInstances(dest + TransformFloats * 4, batch.x[1], batch.y[1], batch.z[1]);
+        #endif
+        }
+
+        void WriteRange(float time, size_t begin, size_t end, float* dest) const noexcept
+        {
+            alignas(16) float tail[BatchSize * TransformFloats];
+
+            size_t column = begin % m_columns;
+            size_t row = begin / m_columns;
+
+            for (size_t j = begin; j < end; j += BatchSize)
+            {
+                const size_t n = std::min(end - j, size_t(BatchSize));
+
+                Batch batch;
+                Evaluate(time, column, row, n, batch);
+
+                if (n == BatchSize)
+                {
+                    StoreBatch(dest + j * TransformFloats, batch);
+                }
+                else
+                {
+                    StoreBatch(tail, batch);
+                    memcpy(dest + j * TransformFloats, tail, n * TransformFloats * sizeof(float));
+                }
+            }
+
+            // Streaming stores are weakly ordered; make them visible before the GPU reads.
+            _mm_sfence();
+        }
+
+        // Writes the centers of [begin, end) to x, y and z, rounded up to whole batches.
+        void WriteCenters(float time, size_t begin, size_t end, float* x, float* y, float* z) const noexcept
+        {
+            size_t column = begin % m_columns;
+            size_t row = begin / m_columns;
+
+            for (size_t j = 0; j < end - begin; j += BatchSize)
+            {
+                Batch batch;
+                Evaluate(time, column, row, std::min(end - begin - j, size_t(BatchSize)), batch);
+
+            #if defined(INSTANCEANIMATOR_AVX)
+                _mm256_storeu_ps(x + j, batch.x);
+                _mm256_storeu_ps(y + j, batch.y);
+                _mm256_storeu_ps(z + j, batch.z);
+            #else
+                for (size_t k = 0; k < 2; ++k)
+                {
+                    _mm_storeu_ps(x + j + k * 4, batch.x[k]);
+                    _mm_storeu_ps(y + j + k * 4, batch.y[k]);
+                    _mm_storeu_ps(z + j + k * 4, batch.z[k]);
+                }
+            #endif
+            }
+        }
+
+        // Writes count packed positions as transforms.
+        static void CopyVisible(const float* visible, size_t count, float* dest) noexcept
+        {
+            const __m128 maskW = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+            const __m128 row0 = _mm_setr_ps(1.f, 0.f, 0.f, 0.f);
+            const __m128 row1 = _mm_setr_ps(0.f, 1.f, 0.f, 0.f);
+            const __m128 row2 = _mm_setr_ps(0.f, 0.f, 1.f, 0.f);
+
+            for (size_t j = 0; j < count; ++j, visible += 4, dest += TransformFloats)
+            {
+                const __m128 p = _mm_loadu_ps(visible);
+                _mm_stream_ps(dest, _mm_or_ps(row0, _mm_and_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0)), maskW)));
+                _mm_stream_ps(dest + 4, _mm_or_ps(row1, _mm_and_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)), maskW)));
+                _mm_stream_ps(dest + 8, _mm_or_ps(row2, _mm_and_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2)), maskW)));
+            }
+
+            _mm_sfence();
+        }
+    #else
+        void WriteRange(float time, size_t begin, size_t end, float* dest) const noexcept
+        {
+            for (size_t j = begin; j < end; ++j)
+            {
+                float x, y;
+                GetPosition(j, x, y);
+                SetTransform(dest + j * TransformFloats, x, y, m_amplitude * Cos(time + x * m_frequency) * Sin(time + y * m_frequency));
+            }
+        }
+
+        void WriteCenters(float time, size_t begin, size_t end, float* x, float* y, float* z) const noexcept
+        {
+            for (size_t j = begin; j < end; ++j, ++x, ++y, ++z)
+            {
+                GetPosition(j, *x, *y);
+                *z = m_amplitude * Cos(time + *x * m_frequency) * Sin(time + *y * m_frequency);
+            }
+        }
+
+        static void CopyVisible(const float* visible, size_t count, float* dest) noexcept
+        {
+            for (size_t j = 0; j < count; ++j, visible += 4, dest += TransformFloats)
+            {
+                SetTransform(dest, visible[0], visible[1], visible[2]);
+            }
+        }
+    #endif
+
+        WorkerPool* m_pool;
+        size_t      m_columns;
+        size_t      m_rows;
+        float       m_originX;
+        float       m_originY;
+        float       m_spacing;
+        float       m_frequency;
+        float       m_amplitude;
+
+        // Quantization bounds of each chunk, and the culler that has the same chunks.
+        std::vector<InstanceCluster> m_clusters;
+        SphereCuller                m_culler;
+    };
+}
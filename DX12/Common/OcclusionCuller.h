@@ -0,0 +1,780 @@
+//--------------------------------------------------------------------------------------
+// File: OcclusionCuller.h
+//
+// CPU occlusion culling of bounding boxes against a small depth buffer of occluder
+// triangles, in the style of masked occlusion culling.
+//
+// This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define OCCLUSIONCULLER_SSE2
+#include <emmintrin.h>
+#if defined(__AVX__)
+#define OCCLUSIONCULLER_AVX
+#include <immintrin.h>
+#endif
+#endif
+
+#include "BoundingVolumeHierarchy.h"
+#include "ParallelFor.h"
+
+namespace DX
+{
+    // Depth is Direct3D's z / w in [0, 1], smaller nearer. Matrices are 16 floats, row-major
+    // with row vectors as in Frustum.h, so &worldViewProj._11 of a SimpleMath::Matrix can be
+    // passed as is. Screen y grows downward, and Direct3D's default front faces, clockwise on
+    // screen, are the ones kept when back faces are culled.
+    class OcclusionCuller
+    {
+    public:
+        static constexpr size_t TileWidth = 8;
+        static constexpr size_t TileHeight = 4;
+
+        enum class CullMode
+        {
+            None,
+            BackFaces,      // counterclockwise on screen
+        };
+
+        enum class Visibility
+        {
+            Visible,
+            Occluded,
+            ViewCulled,
+        };
+
+        // width and height are multiples of the tile size, up to 8192.
+        OcclusionCuller(size_t width, size_t height, WorkerPool* pool = nullptr) :
+            m_pool(pool),
+            m_width(width),
+            m_height(height),
+            m_tilesX(width / TileWidth),
+            m_tilesY(height / TileHeight)
+        {
+            if (!width || !height || width % TileWidth || height % TileHeight || width > 8192 || height > 8192)
+                throw std::invalid_argument("Size must be a nonzero multiple of the tile size, up to 8192");
+
+            m_masks.resize(m_tilesX * m_tilesY);
+            m_depth0.resize(m_tilesX * m_tilesY);
+            m_depth1.resize(m_tilesX * m_tilesY);
+            Clear();
+        }
+
+        OcclusionCuller(OcclusionCuller&&) = default;
+        OcclusionCuller& operator= (OcclusionCuller&&) = default;
+
+        OcclusionCuller(OcclusionCuller const&) = default;
+        OcclusionCuller& operator= (OcclusionCuller const&) = default;
+
+        size_t GetWidth() const noexcept { return m_width; }
+        size_t GetHeight() const noexcept { return m_height; }
+
+        // Empties the depth buffer and drops triangles not yet flushed.
+        void Clear() noexcept
+        {
+            std::fill(m_masks.begin(), m_masks.end(), 0u);
+            std::fill(m_depth0.begin(), m_depth0.end(), std::numeric_limits<float>::infinity());
+            std::fill(m_depth1.begin(), m_depth1.end(), 0.f);
+            m_triangles.clear();
+        }
+
+        // Transforms, clips and sets up the triangles of an indexed mesh, such as the vertices
+        // and indices GeometricPrimitive::CreateBox fills in or a simplified hull of a model,
+        // and queues them for Flush. positions points at the x, y, z of the first vertex, and
+        // stride is the distance in bytes between vertices.
+        template<typename Index>
+        void RenderOccluder(const float* positions, size_t stride, size_t vertexCount,
+            const Index* indices, size_t indexCount, const float worldViewProj[16], CullMode cull = CullMode::BackFaces)
+        {
+            if (indexCount % 3)
+                throw std::invalid_argument("Index count must be a multiple of 3");
+
+            if (stride < 3 * sizeof(float))
+                throw std::invalid_argument("Stride must cover a position");
+
+            for (size_t j = 0; j < indexCount; ++j)
+            {
+                if (size_t(indices[j]) >= vertexCount)
+                    throw std::out_of_range("Index out of range");
+            }
+
+            m_clip.resize(vertexCount * 4);
+            auto vertex = reinterpret_cast<const uint8_t*>(positions);
+            for (size_t j = 0; j < vertexCount; ++j, vertex += stride)
+            {
+                Transform(reinterpret_cast<const float*>(vertex), worldViewProj, &m_clip[j * 4]);
+            }
+
+            for (size_t j = 0; j < indexCount; j += 3)
+            {
+                AddTriangle(&m_clip[size_t(indices[j]) * 4], &m_clip[size_t(indices[j + 1]) * 4], &m_clip[size_t(indices[j + 2]) * 4], cull);
+            }
+        }
+
+        // Rasterizes the queued triangles in order, split into bands of tile rows across the
+        // WorkerPool. Each pixel row of a tile is tested against the three edges at once, as
+        // one AVX register or two SSE2 halves.
+        void Flush()
+        {
+            auto rasterize = [&](size_t begin, size_t end, size_t)
+            {
+                for (const auto& triangle : m_triangles)
+                {
+                    const size_t first = std::max<size_t>(triangle.tileY0, begin);
+                    const size_t last = std::min<size_t>(size_t(triangle.tileY1) + 1, end);
+                    for (size_t ty = first; ty < last; ++ty)
+                    {
+                        RasterizeRow(triangle, ty);
+                    }
+                }
+            };
+
+            if (m_pool)
+            {
+                m_pool->Run(m_tilesY, c_minBandRows, rasterize);
+            }
+            else
+            {
+                rasterize(0, m_tilesY, 0);
+            }
+
+            m_triangles.clear();
+        }
+
+        size_t GetQueuedTriangleCount() const noexcept { return m_triangles.size(); }
+
+        // Occluded when minDepth is at or behind the tile depth of every tile the pixel
+        // rectangle [left, right] x [top, bottom] touches.
+        Visibility TestRect(float left, float top, float right, float bottom, float minDepth) const noexcept
+        {
+            if (!(right >= 0.f && bottom >= 0.f && left < float(m_width) && top < float(m_height)))
+                return Visibility::ViewCulled;
+
+            const size_t x0 = size_t(std::max(left, 0.f)) / TileWidth;
+            const size_t y0 = size_t(std::max(top, 0.f)) / TileHeight;
+            const size_t x1 = size_t(std::min(right, float(m_width - 1))) / TileWidth;
+            const size_t y1 = size_t(std::min(bottom, float(m_height - 1))) / TileHeight;
+
+            for (size_t ty = y0; ty <= y1; ++ty)
+            {
+                if (!BehindRow(&m_depth0[ty * m_tilesX], x0, x1 + 1, minDepth))
+                    return Visibility::Visible;
+            }
+            return Visibility::Occluded;
+        }
+
+        // Tests the box after transforming it by worldViewProj: its corners give a pixel
+        // rectangle and a nearest depth for TestRect. Boxes that cross the near plane are
+        // visible.
+        Visibility TestBox(const AxisAlignedBox& box, const float worldViewProj[16]) const noexcept
+        {
+            float bounds[5];
+            uint32_t outside;
+            bool crossesNear;
+            ProjectBox(box, worldViewProj, bounds, outside, crossesNear);
+
+            if (outside)
+                return Visibility::ViewCulled;
+
+            if (crossesNear)
+                return Visibility::Visible;
+
+            return TestRect(bounds[0], bounds[1], bounds[2], bounds[3], bounds[4]);
+        }
+
+        // Writes the candidates whose boxes are not occluded or outside the view to
+        // visible, in order, and returns how many there are; visible may be candidates.
+        size_t CullOccluded(const AxisAlignedBox* boxes, const uint32_t* candidates, size_t count,
+            const float worldViewProj[16], uint32_t* visible) const noexcept
+        {
+            uint32_t* out = visible;
+            for (size_t j = 0; j < count; ++j)
+            {
+                const uint32_t index = candidates[j];
+                if (TestBox(boxes[index], worldViewProj) == Visibility::Visible)
+                {
+                    *out++ = index;
+                }
+            }
+            return size_t(out - visible);
+        }
+
+        // The depth the buffer holds for a pixel, for debugging: the working layer where it
+        // covers the pixel and is nearer, otherwise the tile depth.
+        float GetPixelDepth(size_t x, size_t y) const
+        {
+            if (x >= m_width || y >= m_height)
+                throw std::out_of_range("Pixel out of range");
+
+            const size_t tile = (y / TileHeight) * m_tilesX + x / TileWidth;
+            const uint32_t bit = 1u << ((y % TileHeight) * TileWidth + x % TileWidth);
+            return (m_masks[tile] & bit) ? std::min(m_depth0[tile], m_depth1[tile]) : m_depth0[tile];
+        }
+
+    private:
+        // Rows of tiles below which a band is not split further.
+        static constexpr size_t c_minBandRows = 4;
+
+        // The clip-space planes -w <= x <= w, -w <= y <= w and 0 <= z <= w.
+        static constexpr size_t c_planes = 6;
+
+        // Edges have interior E(x, y) = a * x + b * y + c >= 0 and depth is
+        // z = depthA * x + depthB * y + depthC, at pixel centers.
+        struct Triangle
+        {
+            float       edgeA[3];
+            float       edgeB[3];
+            float       edgeC[3];
+            float       depthA;
+            float       depthB;
+            float       depthC;
+            float       depthMax;
+            uint16_t    tileX0;
+            uint16_t    tileX1;
+            uint16_t    tileY0;
+            uint16_t    tileY1;
+        };
+
+        static void Transform(const float position[3], const float m[16], float clip[4]) noexcept
+        {
+            for (size_t j = 0; j < 4; ++j)
+            {
+                clip[j] = position[0] * m[j] + position[1] * m[4 + j] + position[2] * m[8 + j] + m[12 + j];
+            }
+        }
+
+        void Project(const float clip[4], float& x, float& y, float& z) const noexcept
+        {
+            const float inverse = 1.f / clip[3];
+            x = (clip[0] * inverse * 0.5f + 0.5f) * float(m_width);
+            y = (0.5f - clip[1] * inverse * 0.5f) * float(m_height);
+            z = clip[2] * inverse;
+        }
+
+        static float GetDistance(size_t plane, const float v[4]) noexcept
+        {
+            switch (plane)
+            {
+            case 0: return v[3] + v[0];
+            case 1: return v[3] - v[0];
+            case 2: return v[3] + v[1];
+            case 3: return v[3] - v[1];
+            case 4: return v[2];
+            default: return v[3] - v[2];
+            }
+        }
+
+        // Clips against the view volume, then sets up the triangles of the fan that remains.
+        void AddTriangle(const float* a, const float* b, const float* c, CullMode cull)
+        {
+            bool inside = true;
+            for (size_t plane = 0; plane < c_planes; ++plane)
+            {
+                const float da = GetDistance(plane, a);
+                const float db = GetDistance(plane, b);
+                const float dc = GetDistance(plane, c);
+                if (da < 0.f && db < 0.f && dc < 0.f)
+                    return;
+
+                inside &= (da >= 0.f && db >= 0.f && dc >= 0.f);
+            }
+
+            if (inside)
+            {
+                SetupTriangle(a, b, c, cull);
+                return;
+            }
+
+            // Each plane adds at most one vertex.
+            float polygons[2][3 + c_planes][4];
+            size_t count = 3;
+            for (size_t k = 0; k < 4; ++k)
+            {
+                polygons[0][0][k] = a[k];
+                polygons[0][1][k] = b[k];
+                polygons[0][2][k] = c[k];
+            }
+
+            size_t source = 0;
+            for (size_t plane = 0; plane < c_planes && count >= 3; ++plane)
+            {
+                const auto& in = polygons[source];
+                auto& out = polygons[source ^ 1];
+                size_t kept = 0;
+                for (size_t j = 0; j < count; ++j)
+                {
+                    const float* current = in[j];
+                    const float* next = in[(j + 1) % count];
+                    const float dc = GetDistance(plane, current);
+                    const float dn = GetDistance(plane, next);
+                    if (dc >= 0.f)
+                    {
+                        std::copy(current, current + 4, out[kept++]);
+                    }
+                    if ((dc >= 0.f) != (dn >= 0.f))
+                    {
+                        const float t = dc / (dc - dn);
+                        for (size_t k = 0; k < 4; ++k)
+                        {
+                            out[kept][k] = current[k] + (next[k] - current[k]) * t;
+                        }
+                        ++kept;
+                    }
+                }
+                count = kept;
+                source ^= 1;
+            }
+
+            for (size_t j = 2; j < count; ++j)
+            {
+                SetupTriangle(polygons[source][0], polygons[source][j - 1], polygons[source][j], cull);
+            }
+        }
+
+        void SetupTriangle(const float* a, const float* b, const float* c, CullMode cull)
+        {
+            const float* clip[3] = { a, b, c };
+            float x[3], y[3], z[3];
+            for (size_t j = 0; j < 3; ++j)
+            {
+                if (!(clip[j][3] > 0.f))
+                    return;
+
+                Project(clip[j], x[j], y[j], z[j]);
+            }
+
+            float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+            if (!(area != 0.f))
+                return;
+
+            if (area < 0.f)
+            {
+                if (cull == CullMode::BackFaces)
+                    return;
+
+                std::swap(x[1], x[2]);
+                std::swap(y[1], y[2]);
+                std::swap(z[1], z[2]);
+                area = -area;
+            }
+
+            // Pixel centers covered by the bounds.
+            const float minX = std::ceil(std::min({ x[0], x[1], x[2] }) - 0.5f);
+            const float maxX = std::floor(std::max({ x[0], x[1], x[2] }) - 0.5f);
+            const float minY = std::ceil(std::min({ y[0], y[1], y[2] }) - 0.5f);
+            const float maxY = std::floor(std::max({ y[0], y[1], y[2] }) - 0.5f);
+            if (!(minX <= maxX && minY <= maxY) || maxX < 0.f || maxY < 0.f || minX >= float(m_width) || minY >= float(m_height))
+                return;
+
+            Triangle triangle;
+            for (size_t j = 0; j < 3; ++j)
+            {
+                const size_t k = (j + 1) % 3;
+                triangle.edgeA[j] = y[j] - y[k];
+                triangle.edgeB[j] = x[k] - x[j];
+                triangle.edgeC[j] = -(triangle.edgeA[j] * x[j] + triangle.edgeB[j] * y[j]);
+            }
+
+            const float dx1 = x[1] - x[0];
+            const float dy1 = y[1] - y[0];
+            const float dx2 = x[2] - x[0];
+            const float dy2 = y[2] - y[0];
+            const float dz1 = z[1] - z[0];
+            const float dz2 = z[2] - z[0];
+            triangle.depthA = (dz1 * dy2 - dz2 * dy1) / area;
+            triangle.depthB = (dx1 * dz2 - dx2 * dz1) / area;
+            triangle.depthC = z[0] - triangle.depthA * x[0] - triangle.depthB * y[0];
+            triangle.depthMax = std::max({ z[0], z[1], z[2] });
+
+            triangle.tileX0 = uint16_t(size_t(std::max(minX, 0.f)) / TileWidth);
+            triangle.tileX1 = uint16_t(std::min(size_t(maxX), m_width - 1) / TileWidth);
+            triangle.tileY0 = uint16_t(size_t(std::max(minY, 0.f)) / TileHeight);
+            triangle.tileY1 = uint16_t(std::min(size_t(maxY), m_height - 1) / TileHeight);
+
+            m_triangles.push_back(triangle);
+        }
+
+        void RasterizeRow(const Triangle& triangle, size_t ty) noexcept
+        {
+            const float top = float(ty * TileHeight) + 0.5f;
+            const float bottom = top + float(TileHeight - 1);
+
+            // The edge terms that depend only on the pixel row.
+            float rows[TileHeight][3];
+            for (size_t r = 0; r < TileHeight; ++r)
+            {
+                const float y = top + float(r);
+                for (size_t e = 0; e < 3; ++e)
+                {
+                    rows[r][e] = triangle.edgeB[e] * y + triangle.edgeC[e];
+                }
+            }
+
+            const float depthY = std::max(triangle.depthB * top, triangle.depthB * bottom) + triangle.depthC;
+
+            for (size_t tx = triangle.tileX0; tx <= triangle.tileX1; ++tx)
+            {
+                const uint32_t mask = GetCoverage(triangle, rows, tx * TileWidth);
+                if (!mask)
+                    continue;
+
+                // The farthest the triangle's plane gets over the tile, but no farther than
+                // its farthest vertex.
+                const float left = float(tx * TileWidth) + 0.5f;
+                const float right = left + float(TileWidth - 1);
+                const float depth = std::min(std::max(triangle.depthA * left, triangle.depthA * right) + depthY, triangle.depthMax);
+
+                UpdateTile(ty * m_tilesX + tx, mask, depth);
+            }
+        }
+
+        // Merges a triangle's coverage of a tile, as masked occlusion culling does. The
+        // triangle joins the working layer; once the layer covers the tile, it becomes the
+        // tile depth. A layer that falls too far behind a new triangle is dropped. Depths
+        // stay conservative: no pixel is ever recorded nearer than the occluders there.
+        void UpdateTile(size_t tile, uint32_t mask, float depth) noexcept
+        {
+            float& depth0 = m_depth0[tile];
+            float& depth1 = m_depth1[tile];
+            uint32_t& covered = m_masks[tile];
+
+            if (depth >= depth0)
+                return;
+
+            // Drop the working layer when the triangle is nearer the tile depth than it.
+            if (depth - depth1 > depth0 - depth)
+            {
+                depth1 = 0.f;
+                covered = 0;
+            }
+
+            depth1 = std::max(depth1, depth);
+            covered |= mask;
+            if (covered == ~0u)
+            {
+                depth0 = std::min(depth0, depth1);
+                depth1 = 0.f;
+                covered = 0;
+            }
+        }
+
+    #if defined(OCCLUSIONCULLER_SSE2)
+        // The smallest or largest of four lanes.
+        static float Reduce(__m128 v, bool maximum) noexcept
+        {
+            const __m128 swapped = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2));
+            v = maximum ? _mm_max_ps(v, swapped) : _mm_min_ps(v, swapped);
+            const __m128 next = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+            return _mm_cvtss_f32(maximum ? _mm_max_ps(v, next) : _mm_min_ps(v, next));
+        }
+    #endif
+
+    #if defined(OCCLUSIONCULLER_AVX)
+        // Bit r * 8 + k is set when the center of pixel k of row r is inside all three edges.
+        static uint32_t GetCoverage(const Triangle& triangle, const float rows[TileHeight][3], size_t x) noexcept
+        {
+            const __m256 xs = _mm256_add_ps(_mm256_set1_ps(float(x)), _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+            const __m256 a0 = _mm256_mul_ps(_mm256_set1_ps(triangle.edgeA[0]), xs);
+            const __m256 a1 = _mm256_mul_ps(_mm256_set1_ps(triangle.edgeA[1]), xs);
+            const __m256 a2 = _mm256_mul_ps(_mm256_set1_ps(triangle.edgeA[2]), xs);
+            const __m256 zero = _mm256_setzero_ps();
+
+            uint32_t mask = 0;
+            for (size_t r = 0; r < TileHeight; ++r)
+            {
+                const __m256 e0 = _mm256_add_ps(a0, _mm256_set1_ps(rows[r][0]));
+                const __m256 e1 = _mm256_add_ps(a1, _mm256_set1_ps(rows[r][1]));
+                const __m256 e2 = _mm256_add_ps(a2, _mm256_set1_ps(rows[r][2]));
+                const __m256 inside = _mm256_and_ps(_mm256_and_ps(
+                    _mm256_cmp_ps(e0, zero, _CMP_GE_OQ), _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)), _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+                mask |= uint32_t(_mm256_movemask_ps(inside)) << (r * TileWidth);
+            }
+            return mask;
+        }
+
+        // The bounds left, top, right, bottom and nearest depth of the corners of a box in
+        // front of the near plane; bits of the planes all corners are outside of; whether
+        // some corner is not in front of the near plane. Corners are eight lanes.
+        void ProjectBox(const AxisAlignedBox& box, const float m[16], float bounds[5], uint32_t& outside, bool& crossesNear) const noexcept
+        {
+            const __m256 xs = _mm256_setr_ps(box.minimum[0], box.maximum[0], box.minimum[0], box.maximum[0],
+                box.minimum[0], box.maximum[0], box.minimum[0], box.maximum[0]);
+            const __m256 ys = _mm256_setr_ps(box.minimum[1], box.minimum[1], box.maximum[1], box.maximum[1],
+                box.minimum[1], box.minimum[1], box.maximum[1], box.maximum[1]);
+            const __m256 zs = _mm256_setr_ps(box.minimum[2], box.minimum[2], box.minimum[2], box.minimum[2],
+                box.maximum[2], box.maximum[2], box.maximum[2], box.maximum[2]);
+
+            __m256 clip[4];
+            for (size_t c = 0; c < 4; ++c)
+            {
+                clip[c] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+                    _mm256_mul_ps(xs, _mm256_set1_ps(m[c])), _mm256_mul_ps(ys, _mm256_set1_ps(m[4 + c]))),
+                    _mm256_mul_ps(zs, _mm256_set1_ps(m[8 + c]))), _mm256_set1_ps(m[12 + c]));
+            }
+
+            const __m256 zero = _mm256_setzero_ps();
+            const __m256 w = clip[3];
+            const __m256 negativeW = _mm256_sub_ps(zero, w);
+            const __m256 planes[c_planes] =
+            {
+                _mm256_cmp_ps(clip[0], negativeW, _CMP_LT_OQ),
+                _mm256_cmp_ps(clip[0], w, _CMP_GT_OQ),
+                _mm256_cmp_ps(clip[1], negativeW, _CMP_LT_OQ),
+                _mm256_cmp_ps(clip[1], w, _CMP_GT_OQ),
+                _mm256_cmp_ps(clip[2], zero, _CMP_LT_OQ),
+                _mm256_cmp_ps(clip[2], w, _CMP_GT_OQ),
+            };
+            outside = 0;
+            for (size_t plane = 0; plane < c_planes; ++plane)
+            {
+                outside |= (_mm256_movemask_ps(planes[plane]) == 0xff) ? (1u << plane) : 0u;
+            }
+
+            const __m256 inFront = _mm256_and_ps(_mm256_cmp_ps(clip[2], zero, _CMP_GT_OQ), _mm256_cmp_ps(w, zero, _CMP_GT_OQ));
+            crossesNear = (_mm256_movemask_ps(inFront) != 0xff);
+            if (crossesNear)
+                return;
+
+            const __m256 inverse = _mm256_div_ps(_mm256_set1_ps(1.f), w);
+            const __m256 half = _mm256_set1_ps(0.5f);
+            const __m256 x = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(clip[0], inverse), half), half), _mm256_set1_ps(float(m_width)));
+            const __m256 y = _mm256_mul_ps(_mm256_sub_ps(half, _mm256_mul_ps(_mm256_mul_ps(clip[1], inverse), half)), _mm256_set1_ps(float(m_height)));
+            const __m256 z = _mm256_mul_ps(clip[2], inverse);
+
+            bounds[0] = Reduce(_mm_min_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1)), false);
+            bounds[1] = Reduce(_mm_min_ps(_mm256_castps256_ps128(y), _mm256_extractf128_ps(y, 1)), false);
+            bounds[2] = Reduce(_mm_max_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1)), true);
+            bounds[3] = Reduce(_mm_max_ps(_mm256_castps256_ps128(y), _mm256_extractf128_ps(y, 1)), true);
+            bounds[4] = Reduce(_mm_min_ps(_mm256_castps256_ps128(z), _mm256_extractf128_ps(z, 1)), false);
+        }
+
+        // Whether minDepth is at or behind depths[begin, end).
+        static bool BehindRow(const float* depths, size_t begin, size_t end, float minDepth) noexcept
+        {
+            const __m256 nearest = _mm256_set1_ps(minDepth);
+            size_t j = begin;
+            for (; j + 8 <= end; j += 8)
+            {
+                if (_mm256_movemask_ps(_mm256_cmp_ps(nearest, _mm256_loadu_ps(depths + j), _CMP_LT_OQ)))
+                    return false;
+            }
+            for (; j < end; ++j)
+            {
+                if (minDepth < depths[j])
+                    return false;
+            }
+            return true;
+        }
+    #elif defined(OCCLUSIONCULLER_SSE2)
+        static uint32_t GetCoverage(const Triangle& triangle, const float rows[TileHeight][3], size_t x) noexcept
+        {
+            const __m128 base = _mm_set1_ps(float(x));
+            const __m128 xs[2] =
+            {
+                _mm_add_ps(base, _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f)),
+                _mm_add_ps(base, _mm_setr_ps(4.5f, 5.5f, 6.5f, 7.5f)),
+            };
+            const __m128 zero = _mm_setzero_ps();
+
+            uint32_t mask = 0;
+            for (size_t half = 0; half < 2; ++half)
+            {
+                const __m128 a0 = _mm_mul_ps(_mm_set1_ps(triangle.edgeA[0]), xs[half]);
+                const __m128 a1 = _mm_mul_ps(_mm_set1_ps(triangle.edgeA[1]), xs[half]);
+                const __m128 a2 = _mm_mul_ps(_mm_set1_ps(triangle.edgeA[2]), xs[half]);
+                for (size_t r = 0; r < TileHeight; ++r)
+                {
+                    const __m128 e0 = _mm_add_ps(a0, _mm_set1_ps(rows[r][0]));
+                    const __m128 e1 = _mm_add_ps(a1, _mm_set1_ps(rows[r][1]));
+                    const __m128 e2 = _mm_add_ps(a2, _mm_set1_ps(rows[r][2]));
+                    const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+                    mask |= uint32_t(_mm_movemask_ps(inside)) << (r * TileWidth + half * 4);
+                }
+            }
+            return mask;
+        }
+
+        // The near and far faces of the box as two halves.
+        void ProjectBox(const AxisAlignedBox& box, const float m[16], float bounds[5], uint32_t& outside, bool& crossesNear) const noexcept
+        {
+            const __m128 xs = _mm_setr_ps(box.minimum[0], box.maximum[0], box.minimum[0], box.maximum[0]);
+            const __m128 ys = _mm_setr_ps(box.minimum[1], box.minimum[1], box.maximum[1], box.maximum[1]);
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 half = _mm_set1_ps(0.5f);
+
+            int planes[c_planes] = { 0xf, 0xf, 0xf, 0xf, 0xf, 0xf };
+            int inFront = 0xf;
+            const __m128 infinity = _mm_set1_ps(std::numeric_limits<float>::infinity());
+            __m128 lows[3] = { infinity, infinity, infinity };
+            const __m128 negativeInfinity = _mm_sub_ps(zero, infinity);
+            __m128 highs[2] = { negativeInfinity, negativeInfinity };
+            for (size_t face = 0; face < 2; ++face)
+            {
+                const __m128 zs = _mm_set1_ps(face ? box.maximum[2] : box.minimum[2]);
+
+                __m128 clip[4];
+                for (size_t c = 0; c < 4; ++c)
+                {
+                    clip[c] = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                        _mm_mul_ps(xs, _mm_set1_ps(m[c])), _mm_mul_ps(ys, _mm_set1_ps(m[4 + c]))),
+                        _mm_mul_ps(zs, _mm_set1_ps(m[8 + c]))), _mm_set1_ps(m[12 + c]));
+                }
+
+                const __m128 w = clip[3];
+                const __m128 negativeW = _mm_sub_ps(zero, w);
+                planes[0] &= _mm_movemask_ps(_mm_cmplt_ps(clip[0], negativeW));
+                planes[1] &= _mm_movemask_ps(_mm_cmpgt_ps(clip[0], w));
+                planes[2] &= _mm_movemask_ps(_mm_cmplt_ps(clip[1], negativeW));
+                planes[3] &= _mm_movemask_ps(_mm_cmpgt_ps(clip[1], w));
+                planes[4] &= _mm_movemask_ps(_mm_cmplt_ps(clip[2], zero));
+                planes[5] &= _mm_movemask_ps(_mm_cmpgt_ps(clip[2], w));
+                inFront &= _mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(clip[2], zero), _mm_cmpgt_ps(w, zero)));
+
+                const __m128 inverse = _mm_div_ps(_mm_set1_ps(1.f), w);
+                const __m128 x = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(clip[0], inverse), half), half), _mm_set1_ps(float(m_width)));
+                const __m128 y = _mm_mul_ps(_mm_sub_ps(half, _mm_mul_ps(_mm_mul_ps(clip[1], inverse), half)), _mm_set1_ps(float(m_height)));
+                const __m128 z = _mm_mul_ps(clip[2], inverse);
+                lows[0] = _mm_min_ps(lows[0], x);
+                lows[1] = _mm_min_ps(lows[1], y);
+                lows[2] = _mm_min_ps(lows[2], z);
+                highs[0] = _mm_max_ps(highs[0], x);
+                highs[1] = _mm_max_ps(highs[1], y);
+            }
+
+            outside = 0;
+            for (size_t plane = 0; plane < c_planes; ++plane)
+            {
+                outside |= (planes[plane] == 0xf) ? (1u << plane) : 0u;
+            }
+
+            crossesNear = (inFront != 0xf);
+            if (crossesNear)
+                return;
+
+            bounds[0] = Reduce(lows[0], false);
+            bounds[1] = Reduce(lows[1], false);
+            bounds[2] = Reduce(highs[0], true);
+            bounds[3] = Reduce(highs[1], true);
+            bounds[4] = Reduce(lows[2], false);
+        }
+
+        static bool BehindRow(const float* depths, size_t begin, size_t end, float minDepth) noexcept
+        {
+            const __m128 nearest = _mm_set1_ps(minDepth);
+            size_t j = begin;
+            for (; j + 4 <= end; j += 4)
+            {
+                if (_mm_movemask_ps(_mm_cmplt_ps(nearest, _mm_loadu_ps(depths + j))))
+                    return false;
+            }
+            for (; j < end; ++j)
+            {
+                if (minDepth < depths[j])
+                    return false;
+            }
+            return true;
+        }
+    #else
+        static uint32_t GetCoverage(const Triangle& triangle, const float rows[TileHeight][3], size_t x) noexcept
+        {
+            uint32_t mask = 0;
+            for (size_t k = 0; k < TileWidth; ++k)
+            {
+                const float px = float(x) + (float(k) + 0.5f);
+                const float a0 = triangle.edgeA[0] * px;
+                const float a1 = triangle.edgeA[1] * px;
+                const float a2 = triangle.edgeA[2] * px;
+                for (size_t r = 0; r < TileHeight; ++r)
+                {
+                    if (a0 + rows[r][0] >= 0.f && a1 + rows[r][1] >= 0.f && a2 + rows[r][2] >= 0.f)
+                    {
+                        mask |= 1u << (r * TileWidth + k);
+                    }
+                }
+            }
+            return mask;
+        }
+
+        void ProjectBox(const AxisAlignedBox& box, const float m[16], float bounds[5], uint32_t& outside, bool& crossesNear) const noexcept
+        {
+            bounds[0] = bounds[1] = bounds[4] = std::numeric_limits<float>::infinity();
+            bounds[2] = bounds[3] = -std::numeric_limits<float>::infinity();
+            outside = (1u << c_planes) - 1;
+            crossesNear = false;
+            for (size_t j = 0; j < 8; ++j)
+            {
+                const float x = (j & 1) ? box.maximum[0] : box.minimum[0];
+                const float y = (j & 2) ? box.maximum[1] : box.minimum[1];
+                const float z = (j & 4) ? box.maximum[2] : box.minimum[2];
+                float clip[4];
+                for (size_t c = 0; c < 4; ++c)
+                {
+                    clip[c] = x * m[c] + y * m[4 + c] + z * m[8 + c] + m[12 + c];
+                }
+
+                uint32_t planes = 0;
+                for (size_t plane = 0; plane < c_planes; ++plane)
+                {
+                    planes |= (GetDistance(plane, clip) < 0.f) ? (1u << plane) : 0u;
+                }
+                outside &= planes;
+
+                if (!(clip[2] > 0.f && clip[3] > 0.f))
+                {
+                    crossesNear = true;
+                    continue;
+                }
+
+                float sx, sy, sz;
+                Project(clip, sx, sy, sz);
+                bounds[0] = std::min(bounds[0], sx);
+                bounds[1] = std::min(bounds[1], sy);
+                bounds[2] = std::max(bounds[2], sx);
+                bounds[3] = std::max(bounds[3], sy);
+                bounds[4] = std::min(bounds[4], sz);
+            }
+        }
+
+        static bool BehindRow(const float* depths, size_t begin, size_t end, float minDepth) noexcept
+        {
+            for (size_t j = begin; j < end; ++j)
+            {
+                if (minDepth < depths[j])
+                    return false;
+            }
+            return true;
+        }
+    #endif
+
+        WorkerPool*             m_pool;
+        size_t                  m_width;
+        size_t                  m_height;
+        size_t                  m_tilesX;
+        size_t                  m_tilesY;
+
+        // Per tile, row-major: coverage of the working layer, bit r * 8 + k for pixel k of
+        // row r; the tile depth, the farthest of the whole tile; the working layer depth, the
+        // farthest of the pixels it covers.
+        std::vector<uint32_t>   m_masks;
+        std::vector<float>      m_depth0;
+        std::vector<float>      m_depth1;
+
+        std::vector<Triangle>   m_triangles;
+        std::vector<float>      m_clip;
+    };
+}
@@ -0,0 +1,406 @@
+//--------------------------------------------------------------------------------------
+// File: SphereCuller.h
+//
+// Frustum culling and compaction for large sets of bounding spheres of one radius, with
+// the visible spheres grouped by level of detail. This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define SPHERECULLER_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(SPHERECULLER_SSE2) && defined(__AVX__)
+#define SPHERECULLER_AVX
+#include <immintrin.h>
+#endif
+
+#include "BoundingVolumeHierarchy.h"
+#include "Frustum.h"
+#include "LodSelector.h"
+#include "ParallelFor.h"
+
+namespace DX
+{
+    class SphereCuller
+    {
+    public:
+        // Spheres tested per step.
+        static constexpr size_t BatchSize = 8;
+
+        // Spheres culled and packed together; a multiple of BatchSize.
+        static constexpr size_t ChunkSize = 4096;
+
+        explicit SphereCuller(WorkerPool* pool = nullptr) noexcept :
+            m_pool(pool),
+            m_count(0)
+        {
+        }
+
+        SphereCuller(SphereCuller&&) = default;
+        SphereCuller& operator= (SphereCuller&&) = default;
+
+        SphereCuller(SphereCuller const&) = default;
+        SphereCuller& operator= (SphereCuller const&) = default;
+
+        static size_t GetChunkCount(size_t count) noexcept { return (count + ChunkSize - 1) / ChunkSize; }
+
+        // Sets up for count spheres. chunkBounds holds GetChunkCount(count) boxes; box j must
+        // contain every center chunk j can report, spheres j * ChunkSize on. Scratch memory is
+        // allocated here; Cull does not allocate.
+        void SetSpheres(size_t count, const AxisAlignedBox* chunkBounds)
+        {
+            if (count > UINT32_MAX)
+                throw std::invalid_argument("Too many spheres");
+
+            const size_t chunks = GetChunkCount(count);
+            m_chunkTree.Build(chunkBounds, chunks);
+
+            m_count = count;
+            m_visible.resize(count * 4);
+            m_scratch.resize(chunks * ChunkSize * 4);
+            m_chunkCounts.resize(chunks * LodSelector::MaxLevels);
+            m_chunkOffsets.resize(chunks * LodSelector::MaxLevels);
+            m_chunkList.resize(chunks);
+        }
+
+        size_t GetCount() const noexcept { return m_count; }
+
+        // Culls the spheres of the given radius against the frustum and returns how many are
+        // visible; levelCounts, if given, receives lods.levels counts.
+        //
+        // Chunks whose bounds are outside the frustum are dropped by a BoundingVolumeHierarchy.
+        // Each remaining chunk, on the WorkerPool when there is one, tests eight spheres at a
+        // time against the six planes (two SSE2 halves, or one AVX register when the build
+        // targets AVX), counts its survivors per level and sorts them by level. A prefix sum
+        // over the counts, level by level, then gives each run its place in the output, so
+        // each level's spheres are contiguous and the count is known before the draw.
+        //
+        // centers(begin, end, x, y, z) writes the centers of spheres [begin, end), one chunk,
+        // to the three arrays, which have room for end - begin rounded up to BatchSize and
+        // need not be aligned; values past end are ignored. copy(chunk, visible, offset, n)
+        // then receives each run of one level in a chunk as n packed x, y, z, level floats,
+        // with its place in the output, level 0 first. Both are called from the pool threads
+        // for different chunks at the same time.
+        template<typename Centers, typename Copy>
+        size_t Cull(const Frustum& frustum, float radius, const LodSelector& lods, size_t* levelCounts,
+            Centers&& centers, Copy&& copy)
+        {
+            const size_t levels = lods.levels;
+            if (!levels || levels > LodSelector::MaxLevels)
+                throw std::invalid_argument("Invalid level count");
+
+            const size_t chunks = m_chunkList.size();
+
+            // Chunks entirely outside the frustum, planes moved out by the radius, are skipped.
+            Frustum grown = frustum;
+            for (auto& plane : grown.planes)
+            {
+                plane[3] += radius;
+            }
+
+            const size_t listed = m_chunkTree.CullFrustum(grown, m_chunkList.data());
+            std::fill(m_chunkCounts.begin(), m_chunkCounts.end(), size_t(0));
+
+            auto cull = [&](size_t begin, size_t end, size_t)
+            {
+                for (size_t j = begin; j < end; ++j)
+                {
+                    const size_t chunk = m_chunkList[j];
+                    const size_t first = chunk * ChunkSize;
+                    const size_t last = std::min(first + ChunkSize, m_count);
+
+                    // The centers go where the sorted survivors will, which is free until then.
+                    float* x = m_scratch.data() + first * 4;
+                    centers(first, last, x, x + ChunkSize, x + ChunkSize * 2);
+
+                    size_t* counts = m_chunkCounts.data() + chunk * LodSelector::MaxLevels;
+                    CullRange(first, last, x, frustum, radius, lods, counts);
+                    if (levels > 1)
+                    {
+                        SortRange(first, counts, levels);
+                    }
+                }
+            };
+
+            auto write = [&](size_t begin, size_t end, size_t)
+            {
+                for (size_t chunk = begin; chunk < end; ++chunk)
+                {
+                    const float* visible = ((levels > 1) ? m_scratch.data() : m_visible.data()) + chunk * ChunkSize * 4;
+                    for (size_t level = 0; level < levels; ++level)
+                    {
+                        const size_t n = m_chunkCounts[chunk * LodSelector::MaxLevels + level];
+                        if (n)
+                        {
+                            copy(chunk, visible, m_chunkOffsets[chunk * LodSelector::MaxLevels + level], n);
+                            visible += n * 4;
+                        }
+                    }
+                }
+            };
+
+            Run(listed, cull);
+
+            // Exclusive prefix sum, level by level, so each level is contiguous in the output.
+            size_t total = 0;
+            for (size_t level = 0; level < levels; ++level)
+            {
+                const size_t levelStart = total;
+                for (size_t chunk = 0; chunk < chunks; ++chunk)
+                {
+                    m_chunkOffsets[chunk * LodSelector::MaxLevels + level] = total;
+                    total += m_chunkCounts[chunk * LodSelector::MaxLevels + level];
+                }
+
+                if (levelCounts)
+                {
+                    levelCounts[level] = total - levelStart;
+                }
+            }
+
+            Run(chunks, write);
+
+            return total;
+        }
+
+    private:
+        static constexpr size_t c_minChunks = 4;
+
+        template<typename Func>
+        void Run(size_t chunks, Func& func) const
+        {
+            if (m_pool)
+            {
+                m_pool->Run(chunks, c_minChunks, func);
+            }
+            else
+            {
+                func(0, chunks, 0);
+            }
+        }
+
+        // Moves the survivors of the chunk at begin from m_visible to m_scratch, grouped by
+        // the level in their fourth float and otherwise in order.
+        void SortRange(size_t begin, const size_t* counts, size_t levels) noexcept
+        {
+            size_t starts[LodSelector::MaxLevels] = {};
+            size_t survivors = counts[0];
+            for (size_t level = 1; level < levels; ++level)
+            {
+                starts[level] = starts[level - 1] + counts[level - 1];
+                survivors += counts[level];
+            }
+
+            const float* visible = m_visible.data() + begin * 4;
+            float* sorted = m_scratch.data() + begin * 4;
+            for (size_t j = 0; j < survivors; ++j, visible += 4)
+            {
+                const size_t level = size_t(visible[3]);
+                memcpy(sorted + starts[level]++ * 4, visible, 4 * sizeof(float));
+            }
+        }
+
+    #if defined(SPHERECULLER_AVX)
+        struct Batch
+        {
+            __m256 x, y, z;
+
+            void Load(const float* xs, const float* ys, const float* zs) noexcept
+            {
+                x = _mm256_loadu_ps(xs);
+                y = _mm256_loadu_ps(ys);
+                z = _mm256_loadu_ps(zs);
+            }
+        };
+    #elif defined(SPHERECULLER_SSE2)
+        struct Batch
+        {
+            __m128 x[2], y[2], z[2];
+
+            void Load(const float* xs, const float* ys, const float* zs) noexcept
+            {
+                for (size_t k = 0; k < 2; ++k)
+                {
+                    x[k] = _mm_loadu_ps(xs + k * 4);
+                    y[k] = _mm_loadu_ps(ys + k * 4);
+                    z[k] = _mm_loadu_ps(zs + k * 4);
+                }
+            }
+        };
+    #endif
+
+    #if defined(SPHERECULLER_SSE2)
+        // Bit k is set when sphere k reaches inside all the planes.
+        static uint32_t VisibleMask(const Batch& batch, const Frustum& frustum, float radius) noexcept
+        {
+        #if defined(SPHERECULLER_AVX)
+            const __m256 limit = _mm256_set1_ps(-radius);
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (const auto& plane : frustum.planes)
+            {
+                __m256 distance = _mm256_add_ps(_mm256_mul_ps(batch.x, _mm256_set1_ps(plane[0])), _mm256_mul_ps(batch.y, _mm256_set1_ps(plane[1])));
+                distance = _mm256_add_ps(_mm256_add_ps(distance, _mm256_mul_ps(batch.z, _mm256_set1_ps(plane[2]))), _mm256_set1_ps(plane[3]));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, limit, _CMP_NLT_UQ));
+            }
+            return uint32_t(_mm256_movemask_ps(inside));
+        #else
+            const __m128 limit = _mm_set1_ps(-radius);
+            uint32_t mask = 0;
+            for (size_t k = 0; k < 2; ++k)
+            {
+                __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                for (const auto& plane : frustum.planes)
+                {
+                    __m128 distance = _mm_add_ps(_mm_mul_ps(batch.x[k], _mm_set1_ps(plane[0])), _mm_mul_ps(batch.y[k], _mm_set1_ps(plane[1])));
+                    distance = _mm_add_ps(_mm_add_ps(distance, _mm_mul_ps(batch.z[k], _mm_set1_ps(plane[2]))), _mm_set1_ps(plane[3]));
+                    inside = _mm_and_ps(inside, _mm_cmpnlt_ps(distance, limit));
+                }
+                mask |= uint32_t(_mm_movemask_ps(inside)) << (k * 4);
+            }
+            return mask;
+        #endif
+        }
+
+        // The level of each sphere, as a float, as LodSelector::Select picks it.
+        static void StoreLevels(const Batch& batch, const LodSelector& lods, float* levels) noexcept
+        {
+        #if defined(SPHERECULLER_AVX)
+            const __m256 dx = _mm256_sub_ps(batch.x, _mm256_set1_ps(lods.eye[0]));
+            const __m256 dy = _mm256_sub_ps(batch.y, _mm256_set1_ps(lods.eye[1]));
+            const __m256 dz = _mm256_sub_ps(batch.z, _mm256_set1_ps(lods.eye[2]));
+            const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+
+            __m256 level = _mm256_setzero_ps();
+            for (size_t j = 0; j + 1 < lods.levels; ++j)
+            {
+                level = _mm256_add_ps(level, _mm256_and_ps(_mm256_cmp_ps(distance, _mm256_set1_ps(lods.limits[j]), _CMP_GE_OQ), _mm256_set1_ps(1.f)));
+            }
+            _mm256_store_ps(levels, level);
+        #else
+            for (size_t k = 0; k < 2; ++k)
+            {
+                const __m128 dx = _mm_sub_ps(batch.x[k], _mm_set1_ps(lods.eye[0]));
+                const __m128 dy = _mm_sub_ps(batch.y[k], _mm_set1_ps(lods.eye[1]));
+                const __m128 dz = _mm_sub_ps(batch.z[k], _mm_set1_ps(lods.eye[2]));
+                const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+                __m128 level = _mm_setzero_ps();
+                for (size_t j = 0; j + 1 < lods.levels; ++j)
+                {
+                    level = _mm_add_ps(level, _mm_and_ps(_mm_cmpge_ps(distance, _mm_set1_ps(lods.limits[j])), _mm_set1_ps(1.f)));
+                }
+                _mm_store_ps(levels + k * 4, level);
+            }
+        #endif
+        }
+
+        // Packs the centers and levels of the visible spheres of [begin, end), whose centers
+        // are at x, x + ChunkSize and x + 2 * ChunkSize, into m_visible from begin on, and
+        // counts them per level.
+        void CullRange(size_t begin, size_t end, const float* x, const Frustum& frustum, float radius,
+            const LodSelector& lods, size_t* counts) noexcept
+        {
+            alignas(32) float ls[BatchSize] = {};
+
+            for (size_t level = 0; level < lods.levels; ++level)
+            {
+                counts[level] = 0;
+            }
+
+            // A local copy, so the stores below cannot alias the planes.
+            const Frustum planes = frustum;
+
+            const float* y = x + ChunkSize;
+            const float* z = y + ChunkSize;
+            float* visible = m_visible.data() + begin * 4;
+
+            for (size_t j = 0; j < end - begin; j += BatchSize)
+            {
+                const size_t n = std::min(end - begin - j, size_t(BatchSize));
+
+                Batch batch;
+                batch.Load(x + j, y + j, z + j);
+
+                uint32_t mask = VisibleMask(batch, planes, radius) & ((1u << n) - 1u);
+                if (!mask)
+                    continue;
+
+                if (lods.levels > 1)
+                {
+                    StoreLevels(batch, lods, ls);
+                }
+
+                for (size_t k = 0; mask; ++k, mask >>= 1)
+                {
+                    if (mask & 1)
+                    {
+                        visible[0] = x[j + k];
+                        visible[1] = y[j + k];
+                        visible[2] = z[j + k];
+                        visible[3] = ls[k];
+                        ++counts[size_t(ls[k])];
+                        visible += 4;
+                    }
+                }
+            }
+        }
+    #else
+        void CullRange(size_t begin, size_t end, const float* x, const Frustum& frustum, float radius,
+            const LodSelector& lods, size_t* counts) noexcept
+        {
+            for (size_t level = 0; level < lods.levels; ++level)
+            {
+                counts[level] = 0;
+            }
+
+            const float* y = x + ChunkSize;
+            const float* z = y + ChunkSize;
+            float* visible = m_visible.data() + begin * 4;
+
+            for (size_t j = 0; j < end - begin; ++j)
+            {
+                if (frustum.IntersectsSphere(x[j], y[j], z[j], radius))
+                {
+                    const size_t level = lods.Select(x[j], y[j], z[j]);
+                    visible[0] = x[j];
+                    visible[1] = y[j];
+                    visible[2] = z[j];
+                    visible[3] = float(level);
+                    ++counts[level];
+                    visible += 4;
+                }
+            }
+        }
+    #endif
+
+        WorkerPool* m_pool;
+        size_t      m_count;
+
+        // Packed x, y, z and level of the visible spheres, at the offset of their chunk.
+        std::vector<float>  m_visible;
+
+        // The centers of each chunk while it is culled, then its survivors sorted by level.
+        std::vector<float>  m_scratch;
+
+        // Visible count of each level in chunk j from j * MaxLevels on, and where they go.
+        std::vector<size_t> m_chunkCounts;
+        std::vector<size_t> m_chunkOffsets;
+
+        // A tree over the chunk bounds for culling whole chunks.
+        BoundingVolumeHierarchy     m_chunkTree;
+        std::vector<uint32_t>       m_chunkList;
+    };
+}
@@ -0,0 +1,378 @@
+//--------------------------------------------------------------------------------------
+// File: ExposureCheck.cpp
+//
+// Checks AutoExposure.h: the binning against an exact log2, the SIMD histogram against the
+// scalar GetBin for both formats and several sampling steps, the percentile window, and
+// the adaptation toward a target that follows the sample's 1 + cos(t) scene brightness,
+// and that a WorkerPool passes exceptions back to its caller.
+// -bench times Build on a quarter-size 1080p buffer.
+//
+// This is a standalone console tool with no Windows or Direct3D dependencies:
+//
+//   g++ -std=c++14 -O2 -mf16c -pthread -I../../Common -o ExposureCheck ExposureCheck.cpp
+//   cl /std:c++14 /O2 /EHsc /I..\..\Common ExposureCheck.cpp
+//
+//   ExposureCheck [-bench N]
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "AutoExposure.h"
+#include "CheckHarness.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    uint16_t ToHalf(float value)
+    {
+        // Truncating conversion; only used to produce test data.
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        const uint32_t sign = (bits >> 16) & 0x8000;
+        const int32_t exponent = int32_t((bits >> 23) & 0xff) - 112;
+        if (exponent <= 0)
+            return uint16_t(sign);
+        if (exponent >= 31)
+            return uint16_t(sign | 0x7bff);
+        return uint16_t(sign | (uint32_t(exponent) << 10) | ((bits >> 13) & 0x3ff));
+    }
+
+    float FromHalf(uint16_t value)
+    {
+        const uint32_t sign = uint32_t(value & 0x8000) << 16;
+        const uint32_t exponent = (value >> 10) & 0x1f;
+        const uint32_t bits = exponent ? (sign | ((exponent + 112) << 23) | (uint32_t(value & 0x3ff) << 13)) : sign;
+        float result;
+        memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+
+    void CheckBinning()
+    {
+        LuminanceHistogram histogram(nullptr, -10.f, 6.f);
+        const float scale = float(LuminanceHistogram::BinCount) / 16.f;
+
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> ev(-14.f, 10.f);
+
+        size_t mismatches = 0;
+        bool adjacent = true;
+        for (int j = 0; j < 1000000; ++j)
+        {
+            const float y = std::exp2(ev(rng));
+            double exact = std::floor((std::log2(double(y)) + 10.0) * scale);
+            exact = std::min(std::max(exact, 0.0), double(LuminanceHistogram::BinCount - 1));
+
+            const size_t bin = histogram.GetBin(y);
+            if (double(bin) != exact)
+            {
+                ++mismatches;
+                adjacent &= std::fabs(double(bin) - exact) <= 1.0;
+            }
+        }
+
+        printf("Binning: %zu of 1000000 differ from exact log2 by one bin\n", mismatches);
+        Check(adjacent, "GetBin is more than one bin from exact log2");
+        Check(mismatches < 1000, "GetBin differs from exact log2 too often");
+
+        Check(histogram.GetBin(0.f) == 0, "Zero is not in the first bin");
+        Check(histogram.GetBin(-1.f) == 0, "Negative is not in the first bin");
+        Check(histogram.GetBin(std::nanf("")) == 0, "NaN is not in the first bin");
+        Check(histogram.GetBin(INFINITY) == LuminanceHistogram::BinCount - 1, "Infinity is not in the last bin");
+        Check(histogram.GetBin(1.f) == 40, "1.0 is not at the start of bin 40");
+    }
+
+    void CheckSIMD()
+    {
+        const size_t width = 203;
+        const size_t height = 77;
+
+        std::mt19937 rng(2);
+        std::uniform_real_distribution<float> ev(-12.f, 8.f);
+        std::uniform_int_distribution<int> special(0, 50);
+
+        std::vector<float> pixels(width * height * 4);
+        for (size_t j = 0; j < width * height; ++j)
+        {
+            for (size_t c = 0; c < 3; ++c)
+            {
+                float value = std::exp2(ev(rng));
+                switch (special(rng))
+                {
+                case 0: value = 0.f; break;
+                case 1: value = -value; break;
+                case 2: value = std::nanf(""); break;
+                default: break;
+                }
+                pixels[j * 4 + c] = value;
+            }
+            pixels[j * 4 + 3] = 1.f;
+        }
+
+        std::vector<uint16_t> halves(pixels.size());
+        std::vector<float> rounded(pixels.size());
+        for (size_t j = 0; j < pixels.size(); ++j)
+        {
+            halves[j] = std::isnan(pixels[j]) ? uint16_t(0x7e00) : ToHalf(pixels[j]);
+            rounded[j] = std::isnan(pixels[j]) ? pixels[j] : FromHalf(halves[j]);
+        }
+
+        WorkerPool pool(4);
+        LuminanceHistogram histogram(&pool);
+
+        for (size_t step = 1; step <= 3; ++step)
+        {
+            for (int half = 0; half < 2; ++half)
+            {
+                const float* source = half ? rounded.data() : pixels.data();
+
+                uint32_t expected[LuminanceHistogram::BinCount] = {};
+                for (size_t y = 0; y < height; y += step)
+                {
+                    for (size_t x = 0; x < width; x += step)
+                    {
+                        const float* p = source + (y * width + x) * 4;
+                        ++expected[histogram.GetBin(p[0] * 0.2126f + p[1] * 0.7152f + p[2] * 0.0722f)];
+                    }
+                }
+
+                if (half)
+                {
+                    histogram.Build(halves.data(), width * 8, width, height, LuminanceHistogram::Format_R16G16B16A16_FLOAT, step);
+                }
+                else
+                {
+                    histogram.Build(pixels.data(), width * 16, width, height, LuminanceHistogram::Format_R32G32B32A32_FLOAT, step);
+                }
+
+                const bool same = memcmp(expected, histogram.GetBins(), sizeof(expected)) == 0;
+                const size_t samples = ((width + step - 1) / step) * ((height + step - 1) / step);
+                printf("Histogram %s step %zu: %s\n", half ? "half " : "float", step, same ? "matches scalar" : "DIFFERS");
+                Check(same, "SIMD histogram differs from scalar");
+                Check(histogram.GetSampleCount() == samples, "Wrong sample count");
+            }
+        }
+    }
+
+    void CheckPercentiles()
+    {
+        // 60% black, 35% at 2^-2, 5% at 2^5. The default window [0.5, 0.95] keeps 10/45 black
+        // and 35/45 mid-grey; [0.6, 0.95] keeps only mid-grey.
+        const size_t count = 1000;
+        std::vector<float> pixels(count * 4, 0.f);
+        for (size_t j = 600; j < count; ++j)
+        {
+            const float value = (j < 950) ? 0.25f : 32.f;
+            pixels[j * 4] = pixels[j * 4 + 1] = pixels[j * 4 + 2] = value;
+        }
+
+        LuminanceHistogram histogram;
+        histogram.Build(pixels.data(), count * 16, count, 1, LuminanceHistogram::Format_R32G32B32A32_FLOAT);
+
+        const float grey = histogram.GetBinLog2(histogram.GetBin(0.25f));
+        const float black = histogram.GetBinLog2(0);
+
+        const float narrow = histogram.GetAverageLog2(0.6f, 0.95f);
+        printf("Average log2 [0.60, 0.95]: %.3f (expected %.3f)\n", narrow, grey);
+        Check(std::fabs(narrow - grey) < 1e-4f, "Percentile window includes ignored samples");
+
+        const float wide = histogram.GetAverageLog2(0.5f, 0.95f);
+        const float expected = (black * 100.f + grey * 350.f) / 450.f;
+        printf("Average log2 [0.50, 0.95]: %.3f (expected %.3f)\n", wide, expected);
+        Check(std::fabs(wide - expected) < 1e-4f, "Wrong percentile weighting");
+
+        AutoExposure exposure;
+        exposure.SetPercentiles(0.6f, 0.95f);
+        const float ev = exposure.Update(histogram, 0.f);
+        printf("Exposure: %.3f (expected %.3f)\n", ev, std::log2(0.18f) - grey);
+        Check(std::fabs(ev - (std::log2(0.18f) - grey)) < 1e-4f, "First update does not snap to the target");
+    }
+
+    void CheckAdaptation()
+    {
+        // The scene scales a unit-luminance image by 1 + cos(t), as HDRTest does.
+        const size_t width = 64;
+        const size_t height = 32;
+        std::vector<float> pixels(width * height * 4);
+
+        LuminanceHistogram histogram;
+        AutoExposure exposure;
+        exposure.SetPercentiles(0.f, 1.f);
+        exposure.SetExposureRange(-6.f, 6.f);
+
+        const float dt = 1.f / 60.f;
+        bool bounded = true;
+        float lagUp = 0.f;
+        float lagDown = 0.f;
+        for (int frame = 0; frame <= 60 * 12; ++frame)
+        {
+            const float time = float(frame) * dt;
+            const float scale = 1.f + std::cos(time);
+            for (size_t j = 0; j < width * height; ++j)
+            {
+                pixels[j * 4] = pixels[j * 4 + 1] = pixels[j * 4 + 2] = scale;
+            }
+
+            histogram.Build(pixels.data(), width * 16, width, height, LuminanceHistogram::Format_R32G32B32A32_FLOAT);
+
+            const float previous = exposure.GetExposure();
+            const float ev = exposure.Update(histogram, dt);
+            const float target = exposure.GetTargetExposure();
+
+            // Each step moves toward the target without passing it.
+            if (frame > 0)
+            {
+                bounded &= (ev - previous) * (target - previous) >= 0.f;
+                bounded &= std::fabs(target - ev) <= std::fabs(target - previous) + 1e-5f;
+            }
+
+            if (target > ev)
+                lagUp = std::max(lagUp, target - ev);
+            else
+                lagDown = std::max(lagDown, ev - target);
+
+            if (!(frame % 60))
+            {
+                printf("t=%5.2f scene %.3f target %+.3f exposure %+.3f\n", time, scale, target, ev);
+            }
+        }
+
+        printf("Largest lag opening up %.3f EV, stopping down %.3f EV\n", lagUp, lagDown);
+        Check(bounded, "Adaptation overshoots the target");
+        Check(lagDown < lagUp, "Stopping down is not faster than opening up");
+
+        // A step change settles within a few time constants of the speed.
+        exposure.Reset();
+        std::fill(pixels.begin(), pixels.end(), 1.f);
+        histogram.Build(pixels.data(), width * 16, width, height, LuminanceHistogram::Format_R32G32B32A32_FLOAT);
+        exposure.Update(histogram, dt);
+        std::fill(pixels.begin(), pixels.end(), 0.0625f);
+        histogram.Build(pixels.data(), width * 16, width, height, LuminanceHistogram::Format_R32G32B32A32_FLOAT);
+        for (int frame = 0; frame < 60 * 5; ++frame)
+        {
+            exposure.Update(histogram, dt);
+        }
+        printf("Step to 1/16 after 5s: %.3f of %.3f EV\n", exposure.GetExposure(), exposure.GetTargetExposure());
+        Check(std::fabs(exposure.GetExposure() - exposure.GetTargetExposure()) < 0.05f, "Step change does not settle");
+    }
+
+    // A throw on the calling thread or on a worker reaches the caller after every range
+    // has run, and the pool keeps working.
+    void CheckPoolErrors()
+    {
+        WorkerPool pool(4);
+        std::atomic<size_t> done(0);
+
+        for (size_t thrower : { size_t(0), size_t(2) })
+        {
+            done = 0;
+            auto work = [&](size_t begin, size_t end, size_t worker)
+            {
+                done += end - begin;
+                if (worker == thrower)
+                    throw std::runtime_error("range failed");
+            };
+
+            bool thrown = false;
+            try
+            {
+                pool.Run(400, 1, work);
+            }
+            catch (const std::runtime_error&)
+            {
+                thrown = true;
+            }
+            Check(thrown, "WorkerPool::Run does not rethrow");
+            Check(done == 400, "WorkerPool::Run returns before every range has run");
+        }
+
+        done = 0;
+        auto count = [&](size_t begin, size_t end, size_t) { done += end - begin; };
+        pool.Run(400, 1, count);
+        Check(done == 400, "WorkerPool does not recover after a throw");
+
+        bool thrown = false;
+        try
+        {
+            ParallelFor(400, 1, [&](size_t begin, size_t)
+            {
+                if (begin)
+                    throw std::runtime_error("range failed");
+            });
+        }
+        catch (const std::runtime_error&)
+        {
+            thrown = true;
+        }
+        Check(thrown || GetWorkerCount() == 1, "ParallelFor does not rethrow");
+    }
+
+    void Bench(int iterations)
+    {
+        const size_t width = 480;
+        const size_t height = 270;
+
+        std::mt19937 rng(3);
+        std::uniform_real_distribution<float> ev(-8.f, 4.f);
+        std::vector<uint16_t> pixels(width * height * 4);
+        for (auto& it : pixels)
+        {
+            it = ToHalf(std::exp2(ev(rng)));
+        }
+
+        WorkerPool pool;
+        LuminanceHistogram histogram(&pool);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int j = 0; j < iterations; ++j)
+        {
+            histogram.Build(pixels.data(), width * 8, width, height, LuminanceHistogram::Format_R16G16B16A16_FLOAT);
+        }
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start);
+
+        printf("Build %zux%zu half on %zu threads: %.3f ms\n", width, height, pool.GetThreadCount(), elapsed.count() / iterations);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int bench = 0;
+    for (int j = 1; j < argc; ++j)
+    {
+        if (!strcmp(argv[j], "-bench") && j + 1 < argc)
+        {
+            bench = atoi(argv[++j]);
+        }
+        else
+        {
+            printf("Usage: ExposureCheck [-bench N]\n");
+            return 1;
+        }
+    }
+
+    return RunChecks([&]()
+    {
+        CheckBinning();
+        CheckSIMD();
+        CheckPercentiles();
+        CheckAdaptation();
+        CheckPoolErrors();
+
+        if (bench > 0)
+        {
+            Bench(bench);
+        }
+    });
+}
@@ -12,7 +12,10 @@ using namespace DirectX::SimpleMath;
 
 using Microsoft::WRL::ComPtr;
 
-Game::Game() noexcept(false)
+Game::Game() noexcept(false) :
+    m_exposureReadbackValid{},
+    m_exposureFootprint{},
+    m_histogram(&m_workerPool)
 {
 #if 0
     m_deviceResources = std::make_unique<DX::DeviceResources>(DXGI_FORMAT_R10G10B10A2_UNORM);
@@ -37,6 +40,8 @@ Game::Game() noexcept(false)
     XMVECTORF32 color;
     color.v = XMColorSRGBToRGB(Colors::CornflowerBlue);
     m_hdrScene->SetClearColor(color);
+
+    m_exposureTarget = std::make_unique<DX::RenderTexture>(DXGI_FORMAT_R16G16B16A16_FLOAT);
 }
 
 Game::~Game()
@@ -107,7 +112,9 @@ void Game::Render()
 
     // Prepare the command list to render a new frame.
     m_deviceResources->Prepare();
-    
+
+    UpdateExposure();
+
     auto commandList = m_deviceResources->GetCommandList();
     m_hdrScene->BeginScene(commandList);
 
@@ -126,13 +133,48 @@ void Game::Render()
 
     PIXEndEvent(commandList);
 
+    ID3D12DescriptorHeap* heaps[] = { m_resourceDescriptors->Heap() };
+    commandList->SetDescriptorHeaps(static_cast<UINT>(std::size(heaps)), heaps);
+
+    PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Exposure");
+
+    // Downscale the scene and queue a copy for the CPU histogram.
+    {
+        m_exposureTarget->BeginScene(commandList);
+
+        const auto exposureDescriptor = m_renderDescriptors->GetCpuHandle(RTDescriptors::ExposureRT);
+        commandList->OMSetRenderTargets(1, &exposureDescriptor, FALSE, nullptr);
+
+        const D3D12_VIEWPORT viewport = { 0.f, 0.f,
+            float(m_exposureFootprint.Footprint.Width), float(m_exposureFootprint.Footprint.Height), 0.f, 1.f };
+        const D3D12_RECT scissorRect = { 0, 0,
+            LONG(m_exposureFootprint.Footprint.Width), LONG(m_exposureFootprint.Footprint.Height) };
+        commandList->RSSetViewports(1, &viewport);
+        commandList->RSSetScissorRects(1, &scissorRect);
+
+        m_downScale->Process(commandList);
+
+        m_exposureTarget->TransitionTo(commandList, D3D12_RESOURCE_STATE_COPY_SOURCE);
+
+        const UINT frameIndex = m_deviceResources->GetCurrentFrameIndex();
+        const CD3DX12_TEXTURE_COPY_LOCATION dest(m_exposureReadback[frameIndex].Get(), m_exposureFootprint);
+        const CD3DX12_TEXTURE_COPY_LOCATION src(m_exposureTarget->GetResource(), 0);
+        commandList->CopyTextureRegion(&dest, 0, 0, 0, &src, nullptr);
+
+        m_exposureReadbackValid[frameIndex] = true;
+    }
+
+    PIXEndEvent(commandList);
+
     PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Tonemap");
 
     const auto rtvDescriptor = m_deviceResources->GetRenderTargetView();
     commandList->OMSetRenderTargets(1, &rtvDescriptor, FALSE, nullptr);
 
-    ID3D12DescriptorHeap* heaps[] = { m_resourceDescriptors->Heap() };
-    commandList->SetDescriptorHeaps(static_cast<UINT>(std::size(heaps)), heaps);
+    const auto viewport = m_deviceResources->GetScreenViewport();
+    const auto scissorRect = m_deviceResources->GetScissorRect();
+    commandList->RSSetViewports(1, &viewport);
+    commandList->RSSetScissorRects(1, &scissorRect);
 
 #if 0
     m_toneMap->Process(commandList);
@@ -188,6 +230,33 @@ void Game::Clear()
 
     PIXEndEvent(commandList);
 }
+
+// Histograms the scene copied the last time this frame index was rendered, which Prepare
+// has waited for, and adapts the tone-map exposure.
+void Game::UpdateExposure()
+{
+    const UINT frameIndex = m_deviceResources->GetCurrentFrameIndex();
+    if (!m_exposureReadbackValid[frameIndex])
+        return;
+
+    auto readback = m_exposureReadback[frameIndex].Get();
+
+    const auto& footprint = m_exposureFootprint.Footprint;
+    const D3D12_RANGE readRange = { 0, size_t(footprint.RowPitch) * footprint.Height };
+    void* data = nullptr;
+    DX::ThrowIfFailed(readback->Map(0, &readRange, &data));
+
+    m_histogram.Build(data, footprint.RowPitch, footprint.Width, footprint.Height,
+        DX::LuminanceHistogram::Format_R16G16B16A16_FLOAT);
+
+    const D3D12_RANGE writeRange = {};
+    readback->Unmap(0, &writeRange);
+
+    const float exposure = m_autoExposure.Update(m_histogram, static_cast<float>(m_timer.GetElapsedSeconds()));
+
+    // The HDR10 and linear paths use the None operator, which does not apply exposure.
+    m_toneMap->SetExposure(exposure);
+}
 #pragma endregion
 
 #pragma region Message Handlers
@@ -276,6 +345,14 @@ void Game::CreateDeviceDependentResources()
         m_resourceDescriptors->GetCpuHandle(Descriptors::SceneTex),
         m_renderDescriptors->GetCpuHandle(RTDescriptors::HDRScene));
 
+    m_exposureTarget->SetDevice(device,
+        m_resourceDescriptors->GetCpuHandle(Descriptors::ExposureTex),
+        m_renderDescriptors->GetCpuHandle(RTDescriptors::ExposureRT));
+
+    m_downScale = std::make_unique<BasicPostProcess>(device,
+        RenderTargetState(m_exposureTarget->GetFormat(), DXGI_FORMAT_UNKNOWN),
+        BasicPostProcess::DownScale_4x4);
+
     RenderTargetState rtState(m_deviceResources->GetBackBufferFormat(),
         DXGI_FORMAT_UNKNOWN);
 
@@ -347,6 +424,36 @@ void Game::CreateWindowSizeDependentResources()
     m_toneMapHDR10->SetHDRSourceTexture(sceneTex);
     m_toneMapLinear->SetHDRSourceTexture(sceneTex);
 
+    // Auto-exposure reads back a quarter-size copy of the scene.
+    {
+        auto device = m_deviceResources->GetD3DDevice();
+
+        const auto width = std::max<UINT>(UINT(size.right - size.left) / 4, 1);
+        const auto height = std::max<UINT>(UINT(size.bottom - size.top) / 4, 1);
+        m_exposureTarget->SizeResources(width, height);
+
+        m_downScale->SetSourceTexture(sceneTex, m_hdrScene->GetResource());
+
+        const auto desc = m_exposureTarget->GetResource()->GetDesc();
+        UINT64 totalBytes = 0;
+        device->GetCopyableFootprints(&desc, 0, 1, 0, &m_exposureFootprint, nullptr, nullptr, &totalBytes);
+
+        const CD3DX12_HEAP_PROPERTIES readbackHeap(D3D12_HEAP_TYPE_READBACK);
+        const auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(totalBytes);
+
+        for (size_t j = 0; j < c_maxFramesInFlight; ++j)
+        {
+            DX::ThrowIfFailed(device->CreateCommittedResource(&readbackHeap, D3D12_HEAP_FLAG_NONE,
+                &bufferDesc,
+                D3D12_RESOURCE_STATE_COPY_DEST,
+                nullptr,
+                IID_PPV_ARGS(m_exposureReadback[j].ReleaseAndGetAddressOf())));
+
+            m_exposureReadback[j]->SetName(L"Exposure Readback");
+            m_exposureReadbackValid[j] = false;
+        }
+    }
+
     m_view = Matrix::CreateLookAt(Vector3(2.f, 2.f, 2.f),
         Vector3::Zero, Vector3::UnitY);
     m_proj = Matrix::CreatePerspectiveFieldOfView(XM_PI / 4.f,
@@ -357,6 +464,14 @@ void Game::OnDeviceLost()
 {
     // TODO: Add Direct3D resource cleanup here.
     m_hdrScene->ReleaseDevice();
+    m_exposureTarget->ReleaseDevice();
+    m_downScale.reset();
+    for (size_t j = 0; j < c_maxFramesInFlight; ++j)
+    {
+        m_exposureReadback[j].Reset();
+        m_exposureReadbackValid[j] = false;
+    }
+    m_autoExposure.Reset();
     m_toneMap.reset();
     m_resourceDescriptors.reset();
     m_renderDescriptors.reset();
@@ -7,6 +7,7 @@
 #include "DeviceResources.h"
 #include "StepTimer.h"
 #include "RenderTexture.h"
+#include "AutoExposure.h"
 
 
 // A basic game implementation that creates a D3D12 device and
@@ -52,6 +53,7 @@ private:
     void Render();
 
     void Clear();
+    void UpdateExposure();
 
     void CreateDeviceDependentResources();
     void CreateWindowSizeDependentResources();
@@ -72,15 +74,31 @@ private:
     std::unique_ptr<DirectX::ToneMapPostProcess> m_toneMapHDR10;
     std::unique_ptr<DirectX::ToneMapPostProcess> m_toneMapLinear;
 
+    // Automatic exposure: the scene is downscaled 4x4 and copied to a readback buffer for
+    // each frame in flight, which is histogrammed once that frame index comes around again.
+    static constexpr size_t c_maxFramesInFlight = 3;
+
+    std::unique_ptr<DX::RenderTexture> m_exposureTarget;
+    std::unique_ptr<DirectX::BasicPostProcess> m_downScale;
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_exposureReadback[c_maxFramesInFlight];
+    bool m_exposureReadbackValid[c_maxFramesInFlight];
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT m_exposureFootprint;
+
+    DX::WorkerPool m_workerPool;
+    DX::LuminanceHistogram m_histogram;
+    DX::AutoExposure m_autoExposure;
+
     enum Descriptors
     {
         SceneTex,
+        ExposureTex,
         Count
     };
 
     enum RTDescriptors
     {
         HDRScene,
+        ExposureRT,
         RTCount
     };
 
@@ -0,0 +1,472 @@
+//--------------------------------------------------------------------------------------
+// File: HeadlessToneMap.cpp
+//
+// Tone maps HDR images on the CPU with ToneMapCPU.h, for captures and thumbnails on machines
+// without a GPU. Inputs are PFM (RGB float) files; each is written next to its input, or to
+// -outdir, as an 8-bit PAM for sRGB, a 10-bit PAM holding the R10G10B10A2 code values for
+// HDR10, or a PFM for linear. Without inputs a synthetic ramp of the given size is used,
+// which together with -bench measures throughput. -compare reports the largest difference
+// between the LUT and exact paths in output code values.
+//
+// This is a standalone console tool with no Windows or Direct3D dependencies:
+//
+//   g++ -std=c++14 -O2 -mavx2 -mf16c -pthread -I../../Common -o HeadlessToneMap HeadlessToneMap.cpp
+//   cl /std:c++14 /O2 /arch:AVX2 /EHsc /I..\..\Common HeadlessToneMap.cpp
+//
+//   HeadlessToneMap [-op none|saturate|reinhard|aces] [-transfer linear|srgb|hdr10] [-exposure EV]
+//       [-paperwhite nits] [-lut] [-half] [-outdir <dir>] [-size WxH] [-bench N] [-compare] [files...]
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "../ToneMapCPU.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace HDR;
+
+namespace
+{
+    const char* OperatorNames[] = { "none", "saturate", "reinhard", "aces" };
+    const char* TransferNames[] = { "linear", "srgb", "hdr10" };
+
+    struct Image
+    {
+        uint32_t            width;
+        uint32_t            height;
+        std::vector<float>  pixels;     // RGBA, top row first
+    };
+
+    Image LoadPFM(const std::string& fileName)
+    {
+        std::ifstream in(fileName, std::ios::in | std::ios::binary);
+        if (!in)
+            throw std::runtime_error("Failed to open " + fileName);
+
+        std::string magic;
+        Image image = {};
+        float scale = 0.f;
+        in >> magic >> image.width >> image.height >> scale;
+        in.get();
+
+        if (magic != "PF" && magic != "Pf")
+            throw std::runtime_error(fileName + " is not a PFM image");
+
+        if (!in || !image.width || !image.height || image.width > 16384 || image.height > 16384)
+            throw std::runtime_error(fileName + " has an invalid size");
+
+        if (scale > 0.f)
+            throw std::runtime_error(fileName + " is big-endian, which is not supported");
+
+        const size_t channels = (magic == "PF") ? 3 : 1;
+        std::vector<float> data(size_t(image.width) * image.height * channels);
+        in.read(reinterpret_cast<char*>(data.data()), std::streamsize(data.size() * sizeof(float)));
+        if (!in)
+            throw std::runtime_error(fileName + " is truncated");
+
+        // PFM rows are stored bottom to top.
+        image.pixels.resize(size_t(image.width) * image.height * 4);
+        for (size_t y = 0; y < image.height; ++y)
+        {
+            const float* src = data.data() + (image.height - 1 - y) * image.width * channels;
+            float* dst = image.pixels.data() + y * image.width * 4;
+            for (size_t x = 0; x < image.width; ++x)
+            {
+                for (size_t c = 0; c < 3; ++c)
+                {
+                    dst[x * 4 + c] = src[x * channels + ((channels == 3) ? c : 0)];
+                }
+                dst[x * 4 + 3] = 1.f;
+            }
+        }
+
+        return image;
+    }
+
+    void SavePFM(const std::string& fileName, uint32_t width, uint32_t height, const std::vector<float>& pixels)
+    {
+        std::ofstream out(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out)
+            throw std::runtime_error("Failed to create " + fileName);
+
+        const std::string header = "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n-1.0\n";
+        out.write(header.data(), std::streamsize(header.size()));
+
+        std::vector<float> row(size_t(width) * 3);
+        for (size_t y = height; y-- > 0;)
+        {
+            for (size_t x = 0; x < width; ++x)
+            {
+                for (size_t c = 0; c < 3; ++c)
+                {
+                    row[x * 3 + c] = pixels[(y * width + x) * 4 + c];
+                }
+            }
+            out.write(reinterpret_cast<const char*>(row.data()), std::streamsize(row.size() * sizeof(float)));
+        }
+
+        if (!out)
+            throw std::runtime_error("Failed to write " + fileName);
+    }
+
+    // R8G8B8A8 as 8-bit RGB_ALPHA, or R10G10B10A2 as RGB with 10-bit samples.
+    void SavePAM(const std::string& fileName, uint32_t width, uint32_t height, const std::vector<uint32_t>& pixels, bool tenBit)
+    {
+        std::ofstream out(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out)
+            throw std::runtime_error("Failed to create " + fileName);
+
+        const std::string header = "P7\nWIDTH " + std::to_string(width) + "\nHEIGHT " + std::to_string(height)
+            + (tenBit ? "\nDEPTH 3\nMAXVAL 1023\nTUPLTYPE RGB\nENDHDR\n" : "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n");
+        out.write(header.data(), std::streamsize(header.size()));
+
+        std::vector<uint8_t> data;
+        data.reserve(pixels.size() * 6);
+        for (const uint32_t pixel : pixels)
+        {
+            if (tenBit)
+            {
+                for (uint32_t c = 0; c < 3; ++c)
+                {
+                    const uint32_t value = (pixel >> (c * 10)) & 0x3ff;
+                    data.push_back(uint8_t(value >> 8));
+                    data.push_back(uint8_t(value & 0xff));
+                }
+            }
+            else
+            {
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    data.push_back(uint8_t(pixel >> (c * 8)));
+                }
+            }
+        }
+        out.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+
+        if (!out)
+            throw std::runtime_error("Failed to write " + fileName);
+    }
+
+    // Horizontal exposure ramp over 20 stops with a hue sweep down the image.
+    Image MakeTestPattern(uint32_t width, uint32_t height)
+    {
+        Image image = { width, height, std::vector<float>(size_t(width) * height * 4) };
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            const float hue = float(y) / float(height) * 6.f;
+            const float r = std::min(std::max(std::abs(hue - 3.f) - 1.f, 0.f), 1.f);
+            const float g = std::min(std::max(2.f - std::abs(hue - 2.f), 0.f), 1.f);
+            const float b = std::min(std::max(2.f - std::abs(hue - 4.f), 0.f), 1.f);
+
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                const float intensity = std::exp2(float(x) / float(width) * 20.f - 12.f);
+                float* p = &image.pixels[(size_t(y) * width + x) * 4];
+                p[0] = (0.05f + r) * intensity;
+                p[1] = (0.05f + g) * intensity;
+                p[2] = (0.05f + b) * intensity;
+                p[3] = 1.f;
+            }
+        }
+        return image;
+    }
+
+    int FindName(const char* value, const char* const* names, int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            if (!strcmp(value, names[i]))
+                return i;
+        }
+        return -1;
+    }
+
+    PixelFormat OutputFormat(TransferFunction transfer)
+    {
+        switch (transfer)
+        {
+        case Transfer_SRGB:     return PixelFormat_R8G8B8A8_UNORM;
+        case Transfer_ST2084:   return PixelFormat_R10G10B10A2_UNORM;
+        default:                return PixelFormat_R32G32B32A32_FLOAT;
+        }
+    }
+
+    std::string OutputName(const std::string& input, const char* outDir, TransferFunction transfer)
+    {
+        std::string name = input;
+        const size_t slash = name.find_last_of("/\\");
+        if (outDir)
+        {
+            name = std::string(outDir) + "/" + ((slash != std::string::npos) ? name.substr(slash + 1) : name);
+        }
+
+        const size_t dot = name.find_last_of('.');
+        const size_t newSlash = name.find_last_of("/\\");
+        if (dot != std::string::npos && (newSlash == std::string::npos || dot > newSlash))
+        {
+            name.erase(dot);
+        }
+
+        return name + ((transfer == Transfer_Linear) ? "_tonemapped.pfm" : ".pam");
+    }
+
+    // The source in the processing format: float, or converted to half.
+    struct Source
+    {
+        const void*             data;
+        size_t                  pitch;
+        PixelFormat             format;
+        std::vector<uint16_t>   halfPixels;
+    };
+
+    Source MakeSource(const Image& image, bool half)
+    {
+        Source source = { image.pixels.data(), size_t(image.width) * 16, PixelFormat_R32G32B32A32_FLOAT, {} };
+        if (half)
+        {
+            source.halfPixels.resize(image.pixels.size());
+            for (size_t i = 0; i < image.pixels.size(); ++i)
+            {
+                source.halfPixels[i] = FloatToHalf(image.pixels[i]);
+            }
+            source.data = source.halfPixels.data();
+            source.pitch = size_t(image.width) * 8;
+            source.format = PixelFormat_R16G16B16A16_FLOAT;
+        }
+        return source;
+    }
+
+    // Largest difference between the exact and LUT paths, in output code values for the
+    // UNORM formats or relative to max(1, |exact|) for float.
+    double CompareLUT(ToneMapProcessor& toneMap, const Image& image, const Source& source)
+    {
+        const PixelFormat format = OutputFormat(toneMap.GetTransferFunction());
+        const bool isFloat = (format == PixelFormat_R32G32B32A32_FLOAT);
+        const size_t pitch = size_t(image.width) * BytesPerPixel(format);
+
+        std::vector<uint8_t> exact(pitch * image.height);
+        std::vector<uint8_t> lut(pitch * image.height);
+
+        const bool useLUT = toneMap.GetUseLUT();
+        toneMap.SetUseLUT(false);
+        toneMap.Process(source.data, source.pitch, source.format, exact.data(), pitch, format, image.width, image.height);
+        toneMap.SetUseLUT(true);
+        toneMap.Process(source.data, source.pitch, source.format, lut.data(), pitch, format, image.width, image.height);
+        toneMap.SetUseLUT(useLUT);
+
+        double worst = 0.0;
+        for (size_t i = 0; i < size_t(image.width) * image.height; ++i)
+        {
+            if (isFloat)
+            {
+                for (size_t c = 0; c < 4; ++c)
+                {
+                    float a, b;
+                    memcpy(&a, &exact[i * 16 + c * 4], sizeof(a));
+                    memcpy(&b, &lut[i * 16 + c * 4], sizeof(b));
+                    worst = std::max(worst, double(std::abs(a - b)) / std::max(1.0, double(std::abs(a))));
+                }
+                continue;
+            }
+
+            uint32_t a, b;
+            memcpy(&a, &exact[i * 4], sizeof(a));
+            memcpy(&b, &lut[i * 4], sizeof(b));
+
+            const uint32_t bits = (format == PixelFormat_R10G10B10A2_UNORM) ? 10 : 8;
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                const int va = int((a >> (c * bits)) & ((1u << bits) - 1));
+                const int vb = int((b >> (c * bits)) & ((1u << bits) - 1));
+                worst = std::max(worst, double(std::abs(va - vb)));
+            }
+        }
+        return worst;
+    }
+
+    void WriteOutput(const std::string& fileName, ToneMapProcessor& toneMap, const Image& image, const Source& source)
+    {
+        const TransferFunction transfer = toneMap.GetTransferFunction();
+        if (transfer == Transfer_Linear)
+        {
+            std::vector<float> result(image.pixels.size());
+            toneMap.Process(source.data, source.pitch, source.format, result.data(), size_t(image.width) * 16,
+                PixelFormat_R32G32B32A32_FLOAT, image.width, image.height);
+            SavePFM(fileName, image.width, image.height, result);
+        }
+        else
+        {
+            std::vector<uint32_t> result(size_t(image.width) * image.height);
+            toneMap.Process(source.data, source.pitch, source.format, result.data(), size_t(image.width) * 4,
+                OutputFormat(transfer), image.width, image.height);
+            SavePAM(fileName, image.width, image.height, result, transfer == Transfer_ST2084);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int op = Operator_ACESFilmic;
+    int transfer = Transfer_SRGB;
+    float exposure = 0.f;
+    float paperWhite = DEFAULT_PAPER_WHITE_NITS;
+    bool lut = false;
+    bool half = false;
+    bool compare = false;
+    const char* outDir = nullptr;
+    uint32_t width = 3840;
+    uint32_t height = 2160;
+    int iterations = 0;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-op") && i + 1 < argc)
+        {
+            op = FindName(argv[++i], OperatorNames, Operator_Count);
+            if (op < 0)
+            {
+                printf("ERROR: -op must be none, saturate, reinhard or aces\n");
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-transfer") && i + 1 < argc)
+        {
+            transfer = FindName(argv[++i], TransferNames, Transfer_Count);
+            if (transfer < 0)
+            {
+                printf("ERROR: -transfer must be linear, srgb or hdr10\n");
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-exposure") && i + 1 < argc)
+        {
+            exposure = float(atof(argv[++i]));
+        }
+        else if (!strcmp(argv[i], "-paperwhite") && i + 1 < argc)
+        {
+            paperWhite = float(atof(argv[++i]));
+        }
+        else if (!strcmp(argv[i], "-lut"))
+        {
+            lut = true;
+        }
+        else if (!strcmp(argv[i], "-half"))
+        {
+            half = true;
+        }
+        else if (!strcmp(argv[i], "-compare"))
+        {
+            compare = true;
+        }
+        else if (!strcmp(argv[i], "-outdir") && i + 1 < argc)
+        {
+            outDir = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-size") && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%ux%u", &width, &height) != 2 || !width || !height)
+            {
+                printf("ERROR: -size expects WxH\n");
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-bench") && i + 1 < argc)
+        {
+            iterations = std::max(atoi(argv[++i]), 1);
+        }
+        else if (argv[i][0] != '-')
+        {
+            inputs.push_back(argv[i]);
+        }
+        else
+        {
+            printf("Usage: HeadlessToneMap [-op none|saturate|reinhard|aces] [-transfer linear|srgb|hdr10] [-exposure EV]\n"
+                "    [-paperwhite nits] [-lut] [-half] [-outdir <dir>] [-size WxH] [-bench N] [-compare] [files...]\n");
+            return 1;
+        }
+    }
+
+    try
+    {
+        ToneMapProcessor toneMap;
+        toneMap.SetOperator(ToneMapOperator(op));
+        toneMap.SetTransferFunction(TransferFunction(transfer));
+        toneMap.SetExposure(exposure);
+        toneMap.SetPaperWhiteNits(paperWhite);
+        toneMap.SetUseLUT(lut);
+
+        const PixelFormat outFormat = OutputFormat(TransferFunction(transfer));
+        const size_t outPitch = size_t(width) * BytesPerPixel(outFormat);
+
+        if (inputs.empty())
+        {
+            const Image image = MakeTestPattern(width, height);
+            const Source source = MakeSource(image, half);
+
+            if (compare)
+            {
+                printf("%s/%s: LUT differs from exact by at most %g\n", OperatorNames[op], TransferNames[transfer],
+                    CompareLUT(toneMap, image, source));
+            }
+
+            if (iterations)
+            {
+                std::vector<uint8_t> result(outPitch * height);
+                toneMap.Process(source.data, source.pitch, source.format, result.data(), outPitch, outFormat, width, height);
+
+                double best = 1e30;
+                double total = 0;
+                for (int k = 0; k < iterations; ++k)
+                {
+                    const auto start = std::chrono::high_resolution_clock::now();
+                    toneMap.Process(source.data, source.pitch, source.format, result.data(), outPitch, outFormat, width, height);
+                    const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+                    best = std::min(best, seconds);
+                    total += seconds;
+                }
+
+            #if defined(__AVX2__)
+                const char* simd = "AVX2";
+            #else
+                const char* simd = "scalar";
+            #endif
+
+                printf("%ux%u %s/%s %s %s (%s, %zu threads): best %.3f ms, average %.3f ms, %.1f Mpixels/s\n",
+                    width, height, OperatorNames[op], TransferNames[transfer], half ? "fp16" : "fp32", lut ? "LUT" : "exact",
+                    simd, DX::GetWorkerCount(), best * 1e3, total / iterations * 1e3, double(width) * height / best * 1e-6);
+            }
+        }
+
+        for (const auto& input : inputs)
+        {
+            const Image image = LoadPFM(input);
+            const Source source = MakeSource(image, half);
+
+            if (compare)
+            {
+                printf("%s: LUT differs from exact by at most %g\n", input.c_str(), CompareLUT(toneMap, image, source));
+            }
+
+            const std::string output = OutputName(input, outDir, TransferFunction(transfer));
+            WriteOutput(output, toneMap, image, source);
+            printf("%s -> %s\n", input.c_str(), output.c_str());
+        }
+    }
+    catch (const std::exception& e)
+    {
+        printf("ERROR: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,605 @@
+//--------------------------------------------------------------------------------------
+// File: ToneMapCPU.h
+//
+// CPU implementation of the ToneMapPostProcess modes used by this sample: the None,
+// Saturate, Reinhard and ACES filmic operators with the linear, sRGB or ST.2084 (HDR10)
+// transfer function, which rotates Rec.709 to Rec.2020 and applies the PQ curve at the
+// paper white level. Sources and destinations are R32G32B32A32_FLOAT or R16G16B16A16_FLOAT
+// buffers, with R10G10B10A2_UNORM and R8G8B8A8_UNORM also accepted as destinations.
+//
+// The exact path evaluates the curves per pixel. SetUseLUT switches to per-channel lookup
+// tables indexed by the float's exponent and top mantissa bits, 64 linear segments per
+// octave, which is vectorized with AVX2. Work is split into row bands across threads.
+//
+// This header has no Windows dependencies.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define TONEMAP_F16C
+#endif
+
+#if defined(__AVX2__) || defined(TONEMAP_F16C)
+#include <immintrin.h>
+#endif
+
+#include "ParallelFor.h"
+
+namespace HDR
+{
+    enum ToneMapOperator
+    {
+        Operator_None,          // Pass-through
+        Operator_Saturate,      // Clamp [0,1]
+        Operator_Reinhard,      // x/(1+x)
+        Operator_ACESFilmic,
+        Operator_Count
+    };
+
+    enum TransferFunction
+    {
+        Transfer_Linear,        // Pass-through
+        Transfer_SRGB,          // sRGB (Rec.709 and linear-to-gamma)
+        Transfer_ST2084,        // HDR10 (Rec.2020 color primaries and ST.2084 curve)
+        Transfer_Count
+    };
+
+    // DXGI_FORMAT values.
+    enum PixelFormat : uint32_t
+    {
+        PixelFormat_R32G32B32A32_FLOAT = 2,
+        PixelFormat_R16G16B16A16_FLOAT = 10,
+        PixelFormat_R10G10B10A2_UNORM = 24,
+        PixelFormat_R8G8B8A8_UNORM = 28,
+    };
+
+    constexpr float DEFAULT_PAPER_WHITE_NITS = 200.f;
+
+    // Largest R16G16B16A16_FLOAT value. The lookup tables clamp their inputs to [2^-24, this],
+    // so unlike the exact path negative values map to black.
+    constexpr float HALF_MAX = 65504.f;
+
+    inline size_t BytesPerPixel(PixelFormat format)
+    {
+        switch (format)
+        {
+        case PixelFormat_R32G32B32A32_FLOAT:    return 16;
+        case PixelFormat_R16G16B16A16_FLOAT:    return 8;
+        case PixelFormat_R10G10B10A2_UNORM:
+        case PixelFormat_R8G8B8A8_UNORM:        return 4;
+        default:                                throw std::invalid_argument("Unsupported pixel format");
+        }
+    }
+
+    // Round to nearest even, like the F16C instructions and the GPU.
+    inline uint16_t FloatToHalf(float value) noexcept
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+
+        const auto sign = uint16_t((bits >> 16) & 0x8000);
+        bits &= 0x7fffffff;
+
+        if (bits >= 0x7f800000)
+            return uint16_t(sign | 0x7c00 | ((bits > 0x7f800000) ? 0x200 : 0));
+
+        if (bits >= 0x477ff000)
+            return uint16_t(sign | 0x7c00);
+
+        if (bits < 0x38800000)
+        {
+            // Subnormal; scaling by 2^24 is exact, and the rounding mode rounds to even.
+            float magnitude;
+            memcpy(&magnitude, &bits, sizeof(magnitude));
+            return uint16_t(sign | uint16_t(std::nearbyint(magnitude * 16777216.f)));
+        }
+
+        const uint32_t rounded = bits + 0xfff + ((bits >> 13) & 1);
+        return uint16_t(sign | ((rounded - 0x38000000) >> 13));
+    }
+
+    inline float HalfToFloat(uint16_t value) noexcept
+    {
+        const uint32_t sign = uint32_t(value & 0x8000) << 16;
+        const uint32_t exponent = (value >> 10) & 0x1f;
+        const uint32_t mantissa = value & 0x3ff;
+
+        uint32_t bits;
+        if (exponent == 0x1f)
+        {
+            bits = sign | 0x7f800000 | (mantissa << 13);
+        }
+        else if (exponent)
+        {
+            bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+        }
+        else
+        {
+            const float magnitude = float(mantissa) * (1.f / 16777216.f);
+            return sign ? -magnitude : magnitude;
+        }
+
+        float result;
+        memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+
+    // The curves in ToneMap.fx and Utilities.fxh.
+    inline float ToneMapReinhard(float x) noexcept
+    {
+        return x / (1.f + x);
+    }
+
+    inline float ToneMapACESFilmic(float x) noexcept
+    {
+        constexpr float a = 2.51f;
+        constexpr float b = 0.03f;
+        constexpr float c = 2.43f;
+        constexpr float d = 0.59f;
+        constexpr float e = 0.14f;
+        return std::min(std::max((x * (a * x + b)) / (x * (c * x + d) + e), 0.f), 1.f);
+    }
+
+    inline float LinearToSRGBEst(float x) noexcept
+    {
+        return std::pow(std::abs(x), 1.f / 2.2f);
+    }
+
+    // x is linear light normalized to 10,000 nits.
+    inline float LinearToST2084(float x) noexcept
+    {
+        const float p = std::pow(std::abs(x), 0.1593017578f);
+        return std::pow((0.8359375f + 18.8515625f * p) / (1.f + 18.6875f * p), 78.84375f);
+    }
+
+    constexpr float c_from709to2020[3][3] =
+    {
+        { 0.6274040f, 0.3292820f, 0.0433136f },
+        { 0.0690970f, 0.9195400f, 0.0113612f },
+        { 0.0163916f, 0.0880132f, 0.8955950f },
+    };
+
+    class ToneMapProcessor
+    {
+    public:
+        ToneMapProcessor() noexcept :
+            m_operator(Operator_ACESFilmic),
+            m_transfer(Transfer_SRGB),
+            m_exposure(0.f),
+            m_paperWhiteNits(DEFAULT_PAPER_WHITE_NITS),
+            m_useLUT(false),
+            m_tablesValid(false),
+            m_hasOperatorTable(false)
+        {
+        }
+
+        ToneMapProcessor(ToneMapProcessor&&) = default;
+        ToneMapProcessor& operator= (ToneMapProcessor&&) = default;
+
+        ToneMapProcessor(ToneMapProcessor const&) = delete;
+        ToneMapProcessor& operator= (ToneMapProcessor const&) = delete;
+
+        void SetOperator(ToneMapOperator op)
+        {
+            if (op < 0 || op >= Operator_Count)
+                throw std::out_of_range("SetOperator");
+
+            m_operator = op;
+            m_tablesValid = false;
+        }
+
+        void SetTransferFunction(TransferFunction transfer)
+        {
+            if (transfer < 0 || transfer >= Transfer_Count)
+                throw std::out_of_range("SetTransferFunction");
+
+            m_transfer = transfer;
+            m_tablesValid = false;
+        }
+
+        // In stops; scales the input of the Reinhard and ACES filmic operators.
+        void SetExposure(float exposureValue) noexcept
+        {
+            m_exposure = exposureValue;
+            m_tablesValid = false;
+        }
+
+        // Brightness of 1.0 for the ST.2084 curve.
+        void SetPaperWhiteNits(float paperWhiteNits)
+        {
+            if (!(paperWhiteNits > 0.f))
+                throw std::invalid_argument("SetPaperWhiteNits");
+
+            m_paperWhiteNits = paperWhiteNits;
+            m_tablesValid = false;
+        }
+
+        void SetUseLUT(bool useLUT) noexcept { m_useLUT = useLUT; }
+
+        ToneMapOperator GetOperator() const noexcept { return m_operator; }
+        TransferFunction GetTransferFunction() const noexcept { return m_transfer; }
+        bool GetUseLUT() const noexcept { return m_useLUT; }
+
+        // Exact tone map of one color; alpha is not affected.
+        void ToneMap(float rgb[3]) const noexcept
+        {
+            const float scale = std::exp2(m_exposure);
+
+            for (size_t i = 0; i < 3; ++i)
+            {
+                rgb[i] = ApplyOperator(rgb[i], scale);
+            }
+
+            if (m_transfer == Transfer_ST2084)
+            {
+                Rotate709To2020(rgb);
+
+                const float nits = m_paperWhiteNits / 10000.f;
+                for (size_t i = 0; i < 3; ++i)
+                {
+                    rgb[i] = LinearToST2084(rgb[i] * nits);
+                }
+            }
+            else if (m_transfer == Transfer_SRGB)
+            {
+                for (size_t i = 0; i < 3; ++i)
+                {
+                    rgb[i] = LinearToSRGBEst(rgb[i]);
+                }
+            }
+        }
+
+        void Process(const void* source, size_t sourcePitch, PixelFormat sourceFormat,
+            void* dest, size_t destPitch, PixelFormat destFormat, uint32_t width, uint32_t height)
+        {
+            if (sourceFormat != PixelFormat_R32G32B32A32_FLOAT && sourceFormat != PixelFormat_R16G16B16A16_FLOAT)
+                throw std::invalid_argument("Source must be R32G32B32A32_FLOAT or R16G16B16A16_FLOAT");
+
+            if (!source || !dest || !width || !height
+                || sourcePitch < width * BytesPerPixel(sourceFormat) || destPitch < width * BytesPerPixel(destFormat))
+                throw std::invalid_argument("Process");
+
+            if (m_useLUT && !m_tablesValid)
+            {
+                BuildTables();
+            }
+
+            DX::ParallelFor(height, 16, [&](size_t begin, size_t end)
+            {
+                std::vector<float> row(size_t(width) * 4);
+
+                for (size_t y = begin; y < end; ++y)
+                {
+                    LoadRow(static_cast<const uint8_t*>(source) + y * sourcePitch, sourceFormat, row.data(), width);
+
+                    if (m_useLUT)
+                    {
+                        ToneMapRowLUT(row.data(), width);
+                    }
+                    else
+                    {
+                        ToneMapRowExact(row.data(), width);
+                    }
+
+                    StoreRow(row.data(), width, static_cast<uint8_t*>(dest) + y * destPitch, destFormat);
+                }
+            });
+        }
+
+    private:
+        // Each table covers [2^-24, 2^16) with 2^LUT_SEGMENT_BITS linear segments per octave.
+        static constexpr uint32_t LUT_SEGMENT_BITS = 6;
+        static constexpr uint32_t LUT_FRACTION_BITS = 23 - LUT_SEGMENT_BITS;
+        static constexpr uint32_t LUT_MIN_BITS = 0x33800000;    // 2^-24
+        static constexpr uint32_t LUT_OCTAVES = 40;
+        static constexpr size_t LUT_SIZE = (size_t(LUT_OCTAVES) << LUT_SEGMENT_BITS) + 1;
+
+        float ApplyOperator(float x, float scale) const noexcept
+        {
+            switch (m_operator)
+            {
+            case Operator_Saturate:     return std::min(std::max(x, 0.f), 1.f);
+            case Operator_Reinhard:     return ToneMapReinhard(x * scale);
+            case Operator_ACESFilmic:   return ToneMapACESFilmic(x * scale);
+            default:                    return x;
+            }
+        }
+
+        static void Rotate709To2020(float rgb[3]) noexcept
+        {
+            const float r = rgb[0];
+            const float g = rgb[1];
+            const float b = rgb[2];
+            for (size_t i = 0; i < 3; ++i)
+            {
+                rgb[i] = c_from709to2020[i][0] * r + c_from709to2020[i][1] * g + c_from709to2020[i][2] * b;
+            }
+        }
+
+        void ToneMapRowExact(float* pixels, uint32_t width) const noexcept
+        {
+            for (size_t x = 0; x < width; ++x)
+            {
+                ToneMap(pixels + x * 4);
+            }
+        }
+
+        // The operator and, except for ST.2084, the transfer function are per channel and go
+        // in the first table. ST.2084 rotates the result to Rec.2020, then applies the second.
+        void BuildTables()
+        {
+            const float scale = std::exp2(m_exposure);
+            const float nits = m_paperWhiteNits / 10000.f;
+
+            m_hasOperatorTable = (m_operator != Operator_None) || (m_transfer == Transfer_SRGB);
+            m_operatorTable.resize(m_hasOperatorTable ? LUT_SIZE : 0);
+            m_transferTable.resize((m_transfer == Transfer_ST2084) ? LUT_SIZE : 0);
+
+            for (size_t i = 0; i < LUT_SIZE; ++i)
+            {
+                const uint32_t bits = LUT_MIN_BITS + uint32_t(i << LUT_FRACTION_BITS);
+                float x;
+                memcpy(&x, &bits, sizeof(x));
+
+                if (m_hasOperatorTable)
+                {
+                    const float value = ApplyOperator(x, scale);
+                    m_operatorTable[i] = (m_transfer == Transfer_SRGB) ? LinearToSRGBEst(value) : value;
+                }
+
+                if (m_transfer == Transfer_ST2084)
+                {
+                    m_transferTable[i] = LinearToST2084(x * nits);
+                }
+            }
+
+            m_tablesValid = true;
+        }
+
+        static float Lookup(const float* table, float x) noexcept
+        {
+            // NaN clamps to the minimum, like the AVX2 path.
+            x = (x > 5.9604645e-8f) ? std::min(x, HALF_MAX) : 5.9604645e-8f;
+
+            uint32_t bits;
+            memcpy(&bits, &x, sizeof(bits));
+
+            const uint32_t offset = bits - LUT_MIN_BITS;
+            const uint32_t index = offset >> LUT_FRACTION_BITS;
+            const float t = float(offset & ((1u << LUT_FRACTION_BITS) - 1)) * (1.f / float(1u << LUT_FRACTION_BITS));
+            return table[index] + (table[index + 1] - table[index]) * t;
+        }
+
+        void ToneMapRowLUT(float* pixels, uint32_t width) const noexcept
+        {
+            size_t x = 0;
+
+        #if defined(__AVX2__)
+            // Two pixels per register; alpha is blended back after each step.
+            const __m256 minValue = _mm256_set1_ps(5.9604645e-8f);
+            const __m256 maxValue = _mm256_set1_ps(HALF_MAX);
+            const __m256i minBits = _mm256_set1_epi32(int(LUT_MIN_BITS));
+            const __m256i fractionMask = _mm256_set1_epi32(int((1u << LUT_FRACTION_BITS) - 1));
+            const __m256 fractionScale = _mm256_set1_ps(1.f / float(1u << LUT_FRACTION_BITS));
+
+            const auto lookup = [&](const float* table, __m256 v)
+            {
+                v = _mm256_min_ps(_mm256_max_ps(v, minValue), maxValue);
+                const __m256i offset = _mm256_sub_epi32(_mm256_castps_si256(v), minBits);
+                const __m256i index = _mm256_srli_epi32(offset, LUT_FRACTION_BITS);
+                const __m256 t = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(offset, fractionMask)), fractionScale);
+                const __m256 v0 = _mm256_i32gather_ps(table, index, 4);
+                const __m256 v1 = _mm256_i32gather_ps(table + 1, index, 4);
+                return _mm256_add_ps(v0, _mm256_mul_ps(_mm256_sub_ps(v1, v0), t));
+            };
+
+            const __m256 m0 = _mm256_setr_ps(c_from709to2020[0][0], c_from709to2020[1][0], c_from709to2020[2][0], 0.f,
+                c_from709to2020[0][0], c_from709to2020[1][0], c_from709to2020[2][0], 0.f);
+            const __m256 m1 = _mm256_setr_ps(c_from709to2020[0][1], c_from709to2020[1][1], c_from709to2020[2][1], 0.f,
+                c_from709to2020[0][1], c_from709to2020[1][1], c_from709to2020[2][1], 0.f);
+            const __m256 m2 = _mm256_setr_ps(c_from709to2020[0][2], c_from709to2020[1][2], c_from709to2020[2][2], 0.f,
+                c_from709to2020[0][2], c_from709to2020[1][2], c_from709to2020[2][2], 0.f);
+
+            for (; x + 2 <= width; x += 2)
+            {
+                float* p = pixels + x * 4;
+                const __m256 source = _mm256_loadu_ps(p);
+                __m256 v = source;
+
+                if (m_hasOperatorTable)
+                {
+                    v = lookup(m_operatorTable.data(), v);
+                }
+
+                if (m_transfer == Transfer_ST2084)
+                {
+                    v = _mm256_add_ps(
+                        _mm256_add_ps(
+                            _mm256_mul_ps(_mm256_permute_ps(v, 0x00), m0),
+                            _mm256_mul_ps(_mm256_permute_ps(v, 0x55), m1)),
+                        _mm256_mul_ps(_mm256_permute_ps(v, 0xAA), m2));
+                    v = lookup(m_transferTable.data(), v);
+                }
+
+                _mm256_storeu_ps(p, _mm256_blend_ps(v, source, 0x88));
+            }
+        #endif
+
+            for (; x < width; ++x)
+            {
+                float* p = pixels + x * 4;
+
+                if (m_hasOperatorTable)
+                {
+                    for (size_t i = 0; i < 3; ++i)
+                    {
+                        p[i] = Lookup(m_operatorTable.data(), p[i]);
+                    }
+                }
+
+                if (m_transfer == Transfer_ST2084)
+                {
+                    Rotate709To2020(p);
+                    for (size_t i = 0; i < 3; ++i)
+                    {
+                        p[i] = Lookup(m_transferTable.data(), p[i]);
+                    }
+                }
+            }
+        }
+
+        static void LoadRow(const uint8_t* source, PixelFormat format, float* row, uint32_t width) noexcept
+        {
+            if (format == PixelFormat_R32G32B32A32_FLOAT)
+            {
+                memcpy(row, source, size_t(width) * 16);
+                return;
+            }
+
+            const size_t count = size_t(width) * 4;
+            size_t i = 0;
+
+        #if defined(TONEMAP_F16C)
+            for (; i + 8 <= count; i += 8)
+            {
+                const __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 2));
+                _mm256_storeu_ps(row + i, _mm256_cvtph_ps(half));
+            }
+        #endif
+
+            for (; i < count; ++i)
+            {
+                uint16_t half;
+                memcpy(&half, source + i * 2, sizeof(half));
+                row[i] = HalfToFloat(half);
+            }
+        }
+
+        static void StoreRow(const float* row, uint32_t width, uint8_t* dest, PixelFormat format) noexcept
+        {
+            const size_t count = size_t(width) * 4;
+
+            switch (format)
+            {
+            case PixelFormat_R32G32B32A32_FLOAT:
+                memcpy(dest, row, count * 4);
+                break;
+
+            case PixelFormat_R16G16B16A16_FLOAT:
+            {
+                size_t i = 0;
+
+            #if defined(TONEMAP_F16C)
+                for (; i + 8 <= count; i += 8)
+                {
+                    const __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(row + i), _MM_FROUND_TO_NEAREST_INT);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i * 2), half);
+                }
+            #endif
+
+                for (; i < count; ++i)
+                {
+                    const uint16_t half = FloatToHalf(row[i]);
+                    memcpy(dest + i * 2, &half, sizeof(half));
+                }
+                break;
+            }
+
+            case PixelFormat_R10G10B10A2_UNORM:
+            {
+                size_t x = 0;
+
+            #if defined(__AVX2__)
+                // Two pixels per register: shift each channel into place, then OR the four
+                // channels of each pixel together.
+                const __m256 scale = _mm256_setr_ps(1023.f, 1023.f, 1023.f, 3.f, 1023.f, 1023.f, 1023.f, 3.f);
+                const __m256i shifts = _mm256_setr_epi32(0, 10, 20, 30, 0, 10, 20, 30);
+                const __m256i gather = _mm256_setr_epi32(0, 4, 0, 4, 0, 4, 0, 4);
+                for (; x + 2 <= width; x += 2)
+                {
+                    __m256i v = _mm256_sllv_epi32(ToUnorm(_mm256_loadu_ps(row + x * 4), scale), shifts);
+                    v = _mm256_or_si256(v, _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+                    v = _mm256_or_si256(v, _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+                    v = _mm256_permutevar8x32_epi32(v, gather);
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(dest + x * 4), _mm256_castsi256_si128(v));
+                }
+            #endif
+
+                for (; x < width; ++x)
+                {
+                    const float* p = row + x * 4;
+                    const uint32_t packed = ToUnorm(p[0], 1023.f)
+                        | (ToUnorm(p[1], 1023.f) << 10)
+                        | (ToUnorm(p[2], 1023.f) << 20)
+                        | (ToUnorm(p[3], 3.f) << 30);
+                    memcpy(dest + x * 4, &packed, sizeof(packed));
+                }
+                break;
+            }
+
+            default:
+            {
+                size_t i = 0;
+
+            #if defined(__AVX2__)
+                // Byte 0 of each 32-bit value, gathered into the low 8 bytes.
+                const __m256 scale = _mm256_set1_ps(255.f);
+                const __m256i bytes = _mm256_setr_epi8(
+                    0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                    0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+                const __m256i gather = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+                for (; i + 8 <= count; i += 8)
+                {
+                    __m256i v = _mm256_shuffle_epi8(ToUnorm(_mm256_loadu_ps(row + i), scale), bytes);
+                    v = _mm256_permutevar8x32_epi32(v, gather);
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(dest + i), _mm256_castsi256_si128(v));
+                }
+            #endif
+
+                for (; i < count; ++i)
+                {
+                    dest[i] = uint8_t(ToUnorm(row[i], 255.f));
+                }
+                break;
+            }
+            }
+        }
+
+        static uint32_t ToUnorm(float value, float scale) noexcept
+        {
+            // NaN becomes 0.
+            const float clamped = (value > 0.f) ? std::min(value, 1.f) : 0.f;
+            return uint32_t(clamped * scale + 0.5f);
+        }
+
+    #if defined(__AVX2__)
+        static __m256i ToUnorm(__m256 value, __m256 scale) noexcept
+        {
+            const __m256 clamped = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+            return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(clamped, scale), _mm256_set1_ps(0.5f)));
+        }
+    #endif
+
+        ToneMapOperator     m_operator;
+        TransferFunction    m_transfer;
+        float               m_exposure;
+        float               m_paperWhiteNits;
+        bool                m_useLUT;
+        bool                m_tablesValid;
+        bool                m_hasOperatorTable;
+        std::vector<float>  m_operatorTable;
+        std::vector<float>  m_transferTable;
+    };
+}
@@ -12,8 +12,39 @@ using namespace DirectX::SimpleMath;
 
 using Microsoft::WRL::ComPtr;
 
+namespace
+{
+    // The grid is c_gridSize instances square; raise it (e.g. to 1024 for 1M instances) to
+    // stress the per-frame instance update.
+    constexpr size_t c_gridSize = 8;
+    constexpr float c_gridSpacing = 1.5f;
+
+    // Bounding sphere of GeometricPrimitive::CreateSphere's unit diameter.
+    constexpr float c_instanceRadius = 0.5f;
+
+    // Tessellation of each level of detail, and the projected size (fraction of the view
+    // height) below which each level after the first takes over. Drop entries from both to use
+    // fewer levels. The size is about c_instanceRadius * m_proj._22 / distance, with _22 about
+    // 2.41, and the instances are 10 to 16 units from the eye. These switch levels at about
+    // 12, 13 and 14 units, near the quartiles of those distances, so each level draws about
+    // a quarter of the grid. Rescale them if the camera or the grid changes.
+    constexpr size_t c_lodTessellation[] = { 16, 10, 6, 4 };
+    constexpr float c_lodScreenSizes[] = { 0.1f, 0.093f, 0.087f };
+
+    static_assert(std::size(c_lodScreenSizes) + 1 == std::size(c_lodTessellation), "One tessellation per level");
+    static_assert(std::size(c_lodTessellation) <= DX::LodSelector::MaxLevels, "Too many levels of detail");
+
+    // Frames between reports of the cull ratio.
+    constexpr uint64_t c_cullReportFrames = 300;
+}
+
 Game::Game() noexcept(false) :
-    m_instanceCount(0)
+    m_instanceCount(0),
+    m_visibleCount(0),
+    m_levelCounts{},
+    m_animator(&m_workerPool),
+    m_instanceData(nullptr),
+    m_ringFenceValue(0)
 {
     m_deviceResources = std::make_unique<DX::DeviceResources>();
     m_deviceResources->RegisterDeviceNotify(this);
@@ -68,27 +99,6 @@ void Game::Update(DX::StepTimer const& timer)
     // TODO: Add your game logic here.
     elapsedTime;
 
-#if 1
-    auto time = static_cast<float>(m_timer.GetTotalSeconds());
-
-    size_t j = 0;
-    for (float y = -6.f; y < 6.f; y += 1.5f)
-    {
-        for (float x = -6.f; x < 6.f; x += 1.5f)
-        {
-            XMMATRIX m = XMMatrixTranslation(x,
-                y,
-                cos(time + float(x) * XM_PIDIV4)
-                * sin(time + float(y) * XM_PIDIV4)
-                * 2.f);
-            XMStoreFloat3x4(&m_instanceTransforms[j], m);
-            ++j;
-        }
-    }
-
-    assert(j == m_instanceCount);
-#endif
-
     PIXEndEvent();
 }
 #pragma endregion
@@ -114,19 +124,71 @@ void Game::Render()
     ID3D12DescriptorHeap* heaps[] = { m_resourceDescriptors->Heap(), m_states->Heap() };
     commandList->SetDescriptorHeaps(static_cast<UINT>(std::size(heaps)), heaps);
 
-    const size_t instBytes = m_instanceCount * sizeof(XMFLOAT3X4);
-    GraphicsResource inst = m_graphicsMemory->Allocate(instBytes);
-    memcpy(inst.Memory(), m_instanceTransforms.get(), instBytes);
+    // Instances are quantized straight into the ring, 16 bytes each.
+    const size_t instBytes = m_animator.GetQuantizedSizeInBytes();
+    m_instanceRing.Retire(m_ringFence->GetCompletedValue());
+
+    size_t instOffset = m_instanceRing.Allocate(instBytes);
+    while (instOffset == DX::FrameRingAllocator::Invalid && m_instanceRing.GetFramesInFlight())
+    {
+        // Full: wait for the oldest frame still reading from the ring.
+        const uint64_t fenceValue = m_instanceRing.GetOldestFenceValue();
+        if (m_ringFence->GetCompletedValue() < fenceValue)
+        {
+            DX::ThrowIfFailed(m_ringFence->SetEventOnCompletion(fenceValue, m_ringFenceEvent.Get()));
+            std::ignore = WaitForSingleObjectEx(m_ringFenceEvent.Get(), INFINITE, FALSE);
+        }
+
+        m_instanceRing.Retire(m_ringFence->GetCompletedValue());
+        instOffset = m_instanceRing.Allocate(instBytes);
+    }
+
+    // Only the instances in view are written, packed from the start of the allocation and
+    // grouped by level of detail.
+    const Matrix viewProj = m_view * m_proj;
+    const auto frustum = DX::Frustum::FromViewProjection(&viewProj._11);
+
+    const Vector3 eye = m_view.Invert().Translation();
+    const auto lods = DX::LodSelector::FromScreenSizes(&eye.x, m_proj._22, c_instanceRadius,
+        c_lodScreenSizes, std::size(c_lodScreenSizes));
+
+    m_visibleCount = static_cast<UINT>(m_animator.WriteVisibleQuantized(static_cast<float>(m_timer.GetTotalSeconds()),
+        frustum, c_instanceRadius, m_instanceData + instOffset, lods, m_levelCounts));
+
+    if (!(m_timer.GetFrameCount() % c_cullReportFrames))
+    {
+        char buff[160] = {};
+        sprintf_s(buff, "Culling: %u of %u instances visible (%.1f%% culled), per LOD %zu/%zu/%zu/%zu\n",
+            m_visibleCount, m_instanceCount,
+            m_instanceCount ? 100.0 * double(m_instanceCount - m_visibleCount) / double(m_instanceCount) : 0.0,
+            m_levelCounts[0], m_levelCounts[1], m_levelCounts[2], m_levelCounts[3]);
+        OutputDebugStringA(buff);
+    }
 
+    // The instances are read from the ring as they were written and decoded by the vertex
+    // shader.
     D3D12_VERTEX_BUFFER_VIEW vertexBufferInst = {};
-    vertexBufferInst.BufferLocation = inst.GpuAddress();
-    vertexBufferInst.SizeInBytes = static_cast<UINT>(instBytes);
-    vertexBufferInst.StrideInBytes = sizeof(XMFLOAT3X4);
+    vertexBufferInst.BufferLocation = m_instanceBuffer->GetGPUVirtualAddress() + instOffset;
+    vertexBufferInst.SizeInBytes = m_visibleCount * static_cast<UINT>(sizeof(DX::QuantizedInstance));
+    vertexBufferInst.StrideInBytes = sizeof(DX::QuantizedInstance);
     commandList->IASetVertexBuffers(1, 1, &vertexBufferInst);
 
     m_effect->Apply(commandList);
 
-    m_shape->DrawInstanced(commandList, m_instanceCount);
+    if (m_visibleCount)
+    {
+        // One draw per level of detail, each from its range of the frame's instances.
+        UINT startInstance = 0;
+        for (size_t level = 0; level < std::size(c_lodTessellation); ++level)
+        {
+            const auto count = static_cast<UINT>(m_levelCounts[level]);
+            if (count)
+            {
+                m_shapes[level]->DrawInstanced(commandList, count, startInstance);
+                startInstance += count;
+            }
+        }
+    }
 
     PIXEndEvent(commandList);
 
@@ -134,6 +196,9 @@ void Game::Render()
     PIXBeginEvent(PIX_COLOR_DEFAULT, L"Present");
     m_deviceResources->Present();
     m_graphicsMemory->Commit(m_deviceResources->GetCommandQueue());
+
+    DX::ThrowIfFailed(m_deviceResources->GetCommandQueue()->Signal(m_ringFence.Get(), ++m_ringFenceValue));
+    m_instanceRing.EndFrame(m_ringFenceValue);
     PIXEndEvent();
 }
 
@@ -230,19 +295,20 @@ void Game::CreateDeviceDependentResources()
     // TODO: Initialize device dependent objects here (independent of window size).
     m_graphicsMemory = std::make_unique<GraphicsMemory>(device);
 
-    m_shape = GeometricPrimitive::CreateSphere();
+    for (size_t level = 0; level < std::size(c_lodTessellation); ++level)
+    {
+        m_shapes[level] = GeometricPrimitive::CreateSphere(1.f, c_lodTessellation[level]);
+    }
 
     RenderTargetState rtState(m_deviceResources->GetBackBufferFormat(),
         m_deviceResources->GetDepthBufferFormat());
 
     const D3D12_INPUT_ELEMENT_DESC c_InputElements[] =
     {
-        { "SV_Position", 0, DXGI_FORMAT_R32G32B32_FLOAT,    0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,   0 },
-        { "NORMAL",      0, DXGI_FORMAT_R32G32B32_FLOAT,    0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,   0 },
-        { "TEXCOORD",    0, DXGI_FORMAT_R32G32_FLOAT,       0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,   0 },
-        { "InstMatrix",  0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
-        { "InstMatrix",  1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
-        { "InstMatrix",  2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+        { "SV_Position",   0, DXGI_FORMAT_R32G32B32_FLOAT,    0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,   0 },
+        { "NORMAL",        0, DXGI_FORMAT_R32G32B32_FLOAT,    0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,   0 },
+        { "TEXCOORD",      0, DXGI_FORMAT_R32G32_FLOAT,       0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,   0 },
+        { "InstQuantized", 0, DXGI_FORMAT_R32G32B32A32_UINT,  1, 0,                            D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
     };
 
     const D3D12_INPUT_LAYOUT_DESC layout = { c_InputElements, static_cast<UINT>(std::size(c_InputElements)) };
@@ -254,8 +320,7 @@ void Game::CreateDeviceDependentResources()
         CommonStates::CullNone,
         rtState);
 
-    m_effect = std::make_unique<NormalMapEffect>(device,
-        EffectFlags::Specular | EffectFlags::Instancing, pd);
+    m_effect = std::make_unique<DX::QuantizedInstanceEffect>(device, pd);
     m_effect->EnableDefaultLighting();
 
     m_resourceDescriptors = std::make_unique<DescriptorHeap>(device,
@@ -267,7 +332,10 @@ void Game::CreateDeviceDependentResources()
 
     resourceUpload.Begin();
 
-    m_shape->LoadStaticBuffers(device, resourceUpload);
+    for (size_t level = 0; level < std::size(c_lodTessellation); ++level)
+    {
+        m_shapes[level]->LoadStaticBuffers(device, resourceUpload);
+    }
 
     DX::ThrowIfFailed(CreateDDSTextureFromFile(device, resourceUpload, L"spnza_bricks_a.DDS",
         m_brickDiffuse.ReleaseAndGetAddressOf()));
@@ -299,32 +367,71 @@ void Game::CreateDeviceDependentResources()
 
     // Create instance transforms.
     {
-        size_t j = 0;
-        for (float y = -6.f; y < 6.f; y += 1.5f)
-        {
-            for (float x = -6.f; x < 6.f; x += 1.5f)
-            {
-                ++j;
-            }
-        }
-        m_instanceCount = static_cast<UINT>(j);
+        const float origin = -c_gridSpacing * float(c_gridSize) * 0.5f;
+        m_animator.SetGrid(c_gridSize, c_gridSize, origin, origin, c_gridSpacing);
+        m_animator.SetWave(XM_PIDIV4, 2.f);
+
+        m_instanceCount = static_cast<UINT>(m_animator.GetCount());
+
+        static_assert(sizeof(DX::QuantizedInstance) == 4 * sizeof(uint32_t), "Instance layout mismatch");
+
+        // Room for a frame of instances per frame in flight, mapped for the buffer's lifetime.
+        const size_t ringBytes = m_animator.GetQuantizedSizeInBytes() * c_ringFrames;
+        m_instanceRing = DX::FrameRingAllocator(ringBytes, c_ringFrames);
+
+        const CD3DX12_HEAP_PROPERTIES uploadHeap(D3D12_HEAP_TYPE_UPLOAD);
+        const auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(ringBytes);
 
-        m_instanceTransforms = std::make_unique<XMFLOAT3X4[]>(j);
+        DX::ThrowIfFailed(device->CreateCommittedResource(&uploadHeap, D3D12_HEAP_FLAG_NONE,
+            &bufferDesc,
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            IID_PPV_ARGS(m_instanceBuffer.ReleaseAndGetAddressOf())));
 
-        constexpr XMFLOAT3X4 s_identity = { 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f };
+        m_instanceBuffer->SetName(L"Instance Ring");
 
-        j = 0;
-        for (float y = -6.f; y < 6.f; y += 1.5f)
+        const CD3DX12_RANGE readRange(0, 0);
+        void* data = nullptr;
+        DX::ThrowIfFailed(m_instanceBuffer->Map(0, &readRange, &data));
+        m_instanceData = static_cast<uint8_t*>(data);
+
+        m_ringFenceValue = 0;
+        DX::ThrowIfFailed(device->CreateFence(m_ringFenceValue, D3D12_FENCE_FLAG_NONE,
+            IID_PPV_ARGS(m_ringFence.ReleaseAndGetAddressOf())));
+
+        if (!m_ringFenceEvent.IsValid())
         {
-            for (float x = -6.f; x < 6.f; x += 1.5f)
-            {
-                m_instanceTransforms[j] = s_identity;
-                m_instanceTransforms[j]._14 = x;
-                m_instanceTransforms[j]._24 = y;
-                ++j;
-            }
+            m_ringFenceEvent.Attach(CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE));
+            if (!m_ringFenceEvent.IsValid())
+                throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()), "CreateEventEx");
         }
     }
+
+    // Create the cluster table.
+    {
+        // The clusters only change with the grid, and are small enough to read from the upload heap.
+        const auto& clusters = m_animator.GetClusters();
+        const size_t clusterBytes = clusters.size() * sizeof(DX::InstanceCluster);
+
+        const CD3DX12_HEAP_PROPERTIES uploadHeap(D3D12_HEAP_TYPE_UPLOAD);
+        auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(clusterBytes);
+
+        DX::ThrowIfFailed(device->CreateCommittedResource(&uploadHeap, D3D12_HEAP_FLAG_NONE,
+            &bufferDesc,
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            IID_PPV_ARGS(m_clusterBuffer.ReleaseAndGetAddressOf())));
+
+        m_clusterBuffer->SetName(L"Instance Clusters");
+
+        const CD3DX12_RANGE readRange(0, 0);
+        void* data = nullptr;
+        DX::ThrowIfFailed(m_clusterBuffer->Map(0, &readRange, &data));
+        memcpy(data, clusters.data(), clusterBytes);
+        m_clusterBuffer->Unmap(0, nullptr);
+
+        m_effect->SetClusters(m_clusterBuffer->GetGPUVirtualAddress());
+    }
 }
 
 // Allocate all memory resources that change on a window SizeChanged event.
@@ -348,7 +455,14 @@ void Game::OnDeviceLost()
     m_resourceDescriptors.reset();
     m_states.reset();
     m_effect.reset();
-    m_shape.reset();
+    for (auto& shape : m_shapes)
+    {
+        shape.reset();
+    }
+    m_instanceBuffer.Reset();
+    m_instanceData = nullptr;
+    m_ringFence.Reset();
+    m_clusterBuffer.Reset();
     m_brickDiffuse.Reset();
     m_brickNormal.Reset();
     m_brickSpecular.Reset();
@@ -6,6 +6,9 @@
 
 #include "DeviceResources.h"
 #include "StepTimer.h"
+#include "InstanceAnimator.h"
+#include "FrameRingAllocator.h"
+#include "QuantizedInstanceEffect.h"
 
 
 // A basic game implementation that creates a D3D12 device and
@@ -68,15 +71,36 @@ private:
     std::unique_ptr<DirectX::DescriptorHeap> m_resourceDescriptors;
     std::unique_ptr<DirectX::CommonStates> m_states;
 
-    std::unique_ptr<DirectX::NormalMapEffect> m_effect;
-    std::unique_ptr<DirectX::GeometricPrimitive> m_shape;
+    std::unique_ptr<DX::QuantizedInstanceEffect> m_effect;
+
+    // Spheres from most to least detailed; instances are bucketed by projected size and
+    // each level is drawn from its own contiguous range of the frame's instances.
+    std::unique_ptr<DirectX::GeometricPrimitive> m_shapes[DX::LodSelector::MaxLevels];
 
     Microsoft::WRL::ComPtr<ID3D12Resource> m_brickDiffuse;
     Microsoft::WRL::ComPtr<ID3D12Resource> m_brickNormal;
     Microsoft::WRL::ComPtr<ID3D12Resource> m_brickSpecular;
 
     UINT m_instanceCount;
-    std::unique_ptr<DirectX::XMFLOAT3X4[]> m_instanceTransforms;
+    UINT m_visibleCount;
+    size_t m_levelCounts[DX::LodSelector::MaxLevels];
+    DX::WorkerPool m_workerPool;
+    DX::InstanceAnimator m_animator;
+
+    // Quantized instances are suballocated from a persistently mapped upload heap used as a
+    // ring, and drawn straight from it as 16-byte instance data that the effect's vertex
+    // shader decodes. m_ringFence is signaled after each frame and retires its region.
+    static constexpr size_t c_ringFrames = 4;
+
+    DX::FrameRingAllocator m_instanceRing;
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_instanceBuffer;
+    uint8_t* m_instanceData;
+    Microsoft::WRL::ComPtr<ID3D12Fence> m_ringFence;
+    uint64_t m_ringFenceValue;
+    Microsoft::WRL::Wrappers::Event m_ringFenceEvent;
+
+    // The position origin and step of each cluster, read by the vertex shader.
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_clusterBuffer;
 
     enum Descriptors
     {
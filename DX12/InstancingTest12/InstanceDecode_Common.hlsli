@@ -0,0 +1,51 @@
+//--------------------------------------------------------------------------------------
+// InstanceDecode_Common.hlsli
+//
+// Decoding of the QuantizedInstance.h format for QuantizedInstanceEffect_VS.hlsl.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#ifndef __INSTANCEDECODE_COMMON_HLSLI__
+#define __INSTANCEDECODE_COMMON_HLSLI__
+
+struct InstanceCluster
+{
+    float4 origin;
+    float4 step;
+};
+
+// Smallest three: the largest component's index in the top two bits, the other three in
+// 10 bits each around 511, scaled by 511 * sqrt(2).
+float4 UnpackRotation(uint packed)
+{
+    const uint largest = packed >> 30;
+    const float3 others = (float3(uint3(packed >> 20, packed >> 10, packed) & 0x3ff) - 511.f) * (1.f / 722.66315f);
+    const float w = sqrt(max(1.f - dot(others, others), 0.f));
+
+    switch (largest)
+    {
+        case 0:  return float4(w, others.x, others.y, others.z);
+        case 1:  return float4(others.x, w, others.y, others.z);
+        case 2:  return float4(others.x, others.y, w, others.z);
+        default: return float4(others.x, others.y, others.z, w);
+    }
+}
+
+// The words are (x | y << 16, z | scale << 16, rotation, cluster).
+void DecodeInstance(uint4 instance, InstanceCluster cluster, out float4 rows[3])
+{
+    const int3 steps = int3(instance.x & 0xffff, instance.x >> 16, instance.y & 0xffff) - 32768;
+    const float3 position = cluster.origin.xyz + float3(steps) * cluster.step.xyz;
+    const float scale = f16tof32(instance.y >> 16);
+
+    const float4 q = UnpackRotation(instance.z);
+    const float3 q2 = q.xyz + q.xyz;
+
+    rows[0] = float4(float3(1.f - q.y * q2.y - q.z * q2.z, q.x * q2.y - q.w * q2.z, q.x * q2.z + q.w * q2.y) * scale, position.x);
+    rows[1] = float4(float3(q.x * q2.y + q.w * q2.z, 1.f - q.x * q2.x - q.z * q2.z, q.y * q2.z - q.w * q2.x) * scale, position.y);
+    rows[2] = float4(float3(q.x * q2.z - q.w * q2.y, q.y * q2.z + q.w * q2.x, 1.f - q.x * q2.x - q.y * q2.y) * scale, position.z);
+}
+
+#endif
@@ -0,0 +1,218 @@
+//--------------------------------------------------------------------------------------
+// QuantizedInstanceEffect.cpp
+//
+// A normal mapped effect for DirectX 12 that decodes QuantizedInstance.h instances in the
+// vertex shader.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "pch.h"
+#include "QuantizedInstanceEffect.h"
+
+#include "DirectXHelpers.h"
+#include "GraphicsMemory.h"
+
+#include "ReadData.h"
+
+#include <stdexcept>
+
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+    constexpr uint32_t DirtyConstantBuffer = 0x1;
+    constexpr uint32_t DirtyViewProjMatrix = 0x2;
+
+    constexpr float c_specularPower = 16.f;
+}
+
+QuantizedInstanceEffect::QuantizedInstanceEffect(
+    _In_ ID3D12Device* device,
+    const EffectPipelineStateDescription& pipelineStateDesc) :
+        m_device(device),
+        m_texture{},
+        m_textureSampler{},
+        m_normalTexture{},
+        m_specularTexture{},
+        m_clusters(0),
+        m_dirtyFlags(uint32_t(-1)),
+        m_constants{}
+{
+    static_assert((sizeof(QuantizedInstanceEffect::QuantizedInstanceEffectConstants) % 16) == 0, "CB size alignment");
+
+    // Create root signature
+    D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags =
+        D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS;
+
+    CD3DX12_DESCRIPTOR_RANGE textureSRV(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+    CD3DX12_DESCRIPTOR_RANGE normalSRV(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1);
+    CD3DX12_DESCRIPTOR_RANGE specularSRV(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 2);
+    CD3DX12_DESCRIPTOR_RANGE textureSampler(D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, 1, 0);
+
+    CD3DX12_ROOT_PARAMETER rootParameters[Count] = {};
+    rootParameters[TextureSRV].InitAsDescriptorTable(1, &textureSRV, D3D12_SHADER_VISIBILITY_PIXEL);
+    rootParameters[NormalSRV].InitAsDescriptorTable(1, &normalSRV, D3D12_SHADER_VISIBILITY_PIXEL);
+    rootParameters[SpecularSRV].InitAsDescriptorTable(1, &specularSRV, D3D12_SHADER_VISIBILITY_PIXEL);
+    rootParameters[TextureSampler].InitAsDescriptorTable(1, &textureSampler, D3D12_SHADER_VISIBILITY_PIXEL);
+    rootParameters[ConstantBuffer].InitAsConstantBufferView(0, 0, D3D12_SHADER_VISIBILITY_ALL);
+    rootParameters[ClustersSRV].InitAsShaderResourceView(3, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+
+    CD3DX12_ROOT_SIGNATURE_DESC rsigDesc = {};
+    rsigDesc.Init(static_cast<UINT>(std::size(rootParameters)), rootParameters,
+        0, nullptr, rootSignatureFlags);
+
+    DX::ThrowIfFailed(
+        CreateRootSignature(device, &rsigDesc, m_rootSig.ReleaseAndGetAddressOf())
+    );
+
+    // Get shaders
+    auto vsBlob = DX::ReadData(L"QuantizedInstanceEffect_VS.cso");
+    D3D12_SHADER_BYTECODE vs = { vsBlob.data(), vsBlob.size() };
+
+    auto psBlob = DX::ReadData(L"QuantizedInstanceEffect_PS.cso");
+    D3D12_SHADER_BYTECODE ps = { psBlob.data(), psBlob.size() };
+
+    pipelineStateDesc.CreatePipelineState(device, m_rootSig.Get(), vs, ps,
+        m_pso.ReleaseAndGetAddressOf());
+}
+
+
+// IEffect methods.
+void QuantizedInstanceEffect::Apply(_In_ ID3D12GraphicsCommandList* commandList)
+{
+    if (m_dirtyFlags & DirtyViewProjMatrix)
+    {
+        m_constants.viewProj = XMMatrixTranspose(XMMatrixMultiply(m_view, m_proj));
+
+        const XMMATRIX invView = XMMatrixInverse(nullptr, m_view);
+        m_constants.eyePosition = XMVectorSetW(invView.r[3], c_specularPower);
+
+        m_dirtyFlags &= ~DirtyViewProjMatrix;
+        m_dirtyFlags |= DirtyConstantBuffer;
+    }
+
+    if (m_dirtyFlags & DirtyConstantBuffer)
+    {
+        auto cb = GraphicsMemory::Get(m_device.Get()).AllocateConstant<QuantizedInstanceEffectConstants>();
+
+        memcpy(cb.Memory(), &m_constants, cb.Size());
+        std::swap(m_constantBuffer, cb);
+
+        m_dirtyFlags &= ~DirtyConstantBuffer;
+    }
+
+    // Set the root signature & parameters
+    commandList->SetGraphicsRootSignature(m_rootSig.Get());
+
+    if (!m_texture.ptr || !m_textureSampler.ptr || !m_normalTexture.ptr || !m_specularTexture.ptr || !m_clusters)
+    {
+        throw std::runtime_error("QuantizedInstanceEffect");
+    }
+
+    commandList->SetGraphicsRootDescriptorTable(TextureSRV, m_texture);
+    commandList->SetGraphicsRootDescriptorTable(NormalSRV, m_normalTexture);
+    commandList->SetGraphicsRootDescriptorTable(SpecularSRV, m_specularTexture);
+    commandList->SetGraphicsRootDescriptorTable(TextureSampler, m_textureSampler);
+    commandList->SetGraphicsRootConstantBufferView(ConstantBuffer, m_constantBuffer.GpuAddress());
+    commandList->SetGraphicsRootShaderResourceView(ClustersSRV, m_clusters);
+
+    // Set the pipeline state
+    commandList->SetPipelineState(m_pso.Get());
+}
+
+
+// Camera settings.
+void QuantizedInstanceEffect::SetWorld(FXMMATRIX /*value*/)
+{
+}
+
+void QuantizedInstanceEffect::SetView(FXMMATRIX value)
+{
+    m_view = value;
+    m_dirtyFlags |= DirtyViewProjMatrix;
+}
+
+void QuantizedInstanceEffect::SetProjection(FXMMATRIX value)
+{
+    m_proj = value;
+    m_dirtyFlags |= DirtyViewProjMatrix;
+}
+
+void QuantizedInstanceEffect::SetMatrices(FXMMATRIX /*world*/, CXMMATRIX view, CXMMATRIX projection)
+{
+    m_view = view;
+    m_proj = projection;
+    m_dirtyFlags |= DirtyViewProjMatrix;
+}
+
+
+// Light settings.
+void QuantizedInstanceEffect::EnableDefaultLighting()
+{
+    static const XMVECTORF32 defaultDirections[3] =
+    {
+        { { { -0.5265408f, -0.5735765f, -0.6275069f, 0 } } },
+        { { {  0.7198464f,  0.3420201f,  0.6040227f, 0 } } },
+        { { {  0.4545195f, -0.7660444f,  0.4545195f, 0 } } },
+    };
+
+    static const XMVECTORF32 defaultDiffuse[3] =
+    {
+        { { { 1.0000000f, 0.9607844f, 0.8078432f, 0 } } },
+        { { { 0.9647059f, 0.7607844f, 0.4078432f, 0 } } },
+        { { { 0.3231373f, 0.3607844f, 0.3937255f, 0 } } },
+    };
+
+    static const XMVECTORF32 defaultSpecular[3] =
+    {
+        { { { 1.0000000f, 0.9607844f, 0.8078432f, 0 } } },
+        { { { 0.0000000f, 0.0000000f, 0.0000000f, 0 } } },
+        { { { 0.3231373f, 0.3607844f, 0.3937255f, 0 } } },
+    };
+
+    static const XMVECTORF32 defaultAmbient = { { { 0.05333332f, 0.09882354f, 0.1819608f, 0 } } };
+
+    for (size_t j = 0; j < 3; ++j)
+    {
+        m_constants.lightDirection[j] = defaultDirections[j];
+        m_constants.lightDiffuseColor[j] = defaultDiffuse[j];
+        m_constants.lightSpecularColor[j] = defaultSpecular[j];
+    }
+    m_constants.ambientColor = defaultAmbient;
+
+    m_dirtyFlags |= DirtyConstantBuffer;
+}
+
+
+// Texture settings.
+void QuantizedInstanceEffect::SetTexture(
+    _In_ D3D12_GPU_DESCRIPTOR_HANDLE srvDescriptor,
+    _In_ D3D12_GPU_DESCRIPTOR_HANDLE samplerDescriptor)
+{
+    m_texture = srvDescriptor;
+    m_textureSampler = samplerDescriptor;
+}
+
+void QuantizedInstanceEffect::SetNormalTexture(_In_ D3D12_GPU_DESCRIPTOR_HANDLE srvDescriptor)
+{
+    m_normalTexture = srvDescriptor;
+}
+
+void QuantizedInstanceEffect::SetSpecularTexture(_In_ D3D12_GPU_DESCRIPTOR_HANDLE srvDescriptor)
+{
+    m_specularTexture = srvDescriptor;
+}
+
+
+// Instance settings.
+void QuantizedInstanceEffect::SetClusters(D3D12_GPU_VIRTUAL_ADDRESS value)
+{
+    m_clusters = value;
+}
@@ -0,0 +1,93 @@
+//--------------------------------------------------------------------------------------
+// QuantizedInstanceEffect.h
+//
+// A normal mapped effect for DirectX 12 that decodes QuantizedInstance.h instances in the
+// vertex shader. Each instance is one 16-byte R32G32B32A32_UINT element, InstQuantized,
+// and the clusters are read from a structured buffer of InstanceCluster. The instances
+// carry the world transform, so SetWorld is ignored.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <Effects.h>
+#include <SimpleMath.h>
+
+
+namespace DX
+{
+    class QuantizedInstanceEffect : public DirectX::IEffect, public DirectX::IEffectMatrices
+    {
+    public:
+        QuantizedInstanceEffect(_In_ ID3D12Device* device, const DirectX::EffectPipelineStateDescription& pipelineStateDesc);
+
+        QuantizedInstanceEffect(QuantizedInstanceEffect&&) = default;
+        QuantizedInstanceEffect& operator= (QuantizedInstanceEffect&&) = default;
+
+        QuantizedInstanceEffect(QuantizedInstanceEffect const&) = delete;
+        QuantizedInstanceEffect& operator= (QuantizedInstanceEffect const&) = delete;
+
+        // IEffect methods.
+        void __cdecl Apply(_In_ ID3D12GraphicsCommandList* commandList) override;
+
+        // Camera settings.
+        void XM_CALLCONV SetWorld(DirectX::FXMMATRIX value) override;
+        void XM_CALLCONV SetView(DirectX::FXMMATRIX value) override;
+        void XM_CALLCONV SetProjection(DirectX::FXMMATRIX value) override;
+        void XM_CALLCONV SetMatrices(DirectX::FXMMATRIX world, DirectX::CXMMATRIX view, DirectX::CXMMATRIX projection) override;
+
+        // Light settings, the same three lights as IEffectLights::EnableDefaultLighting.
+        void __cdecl EnableDefaultLighting();
+
+        // Texture settings.
+        void __cdecl SetTexture(_In_ D3D12_GPU_DESCRIPTOR_HANDLE srvDescriptor,
+            _In_ D3D12_GPU_DESCRIPTOR_HANDLE samplerDescriptor);
+        void __cdecl SetNormalTexture(_In_ D3D12_GPU_DESCRIPTOR_HANDLE srvDescriptor);
+        void __cdecl SetSpecularTexture(_In_ D3D12_GPU_DESCRIPTOR_HANDLE srvDescriptor);
+
+        // Instance settings: the address of the InstanceCluster table.
+        void __cdecl SetClusters(D3D12_GPU_VIRTUAL_ADDRESS value);
+
+    private:
+        enum Descriptors
+        {
+            TextureSRV,
+            NormalSRV,
+            SpecularSRV,
+            TextureSampler,
+            ConstantBuffer,
+            ClustersSRV,
+            Count
+        };
+
+        Microsoft::WRL::ComPtr<ID3D12Device>        m_device;
+        Microsoft::WRL::ComPtr<ID3D12RootSignature> m_rootSig;
+        Microsoft::WRL::ComPtr<ID3D12PipelineState> m_pso;
+
+        D3D12_GPU_DESCRIPTOR_HANDLE m_texture;
+        D3D12_GPU_DESCRIPTOR_HANDLE m_textureSampler;
+        D3D12_GPU_DESCRIPTOR_HANDLE m_normalTexture;
+        D3D12_GPU_DESCRIPTOR_HANDLE m_specularTexture;
+        D3D12_GPU_VIRTUAL_ADDRESS   m_clusters;
+
+        uint32_t m_dirtyFlags;
+
+        DirectX::SimpleMath::Matrix m_view;
+        DirectX::SimpleMath::Matrix m_proj;
+
+        struct __declspec(align(16)) QuantizedInstanceEffectConstants
+        {
+            DirectX::XMMATRIX viewProj;
+            DirectX::XMVECTOR eyePosition;
+            DirectX::XMVECTOR ambientColor;
+            DirectX::XMVECTOR lightDirection[3];
+            DirectX::XMVECTOR lightDiffuseColor[3];
+            DirectX::XMVECTOR lightSpecularColor[3];
+        };
+
+        QuantizedInstanceEffectConstants m_constants;
+        DirectX::GraphicsResource        m_constantBuffer;
+    };
+}
@@ -0,0 +1,44 @@
+//--------------------------------------------------------------------------------------
+// QuantizedInstanceEffect_Common.hlsli
+//
+// A normal mapped effect for DirectX 12 that decodes QuantizedInstance.h instances in the
+// vertex shader.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#ifndef __QUANTIZEDINSTANCEEFFECT_COMMON_HLSLI__
+#define __QUANTIZEDINSTANCEEFFECT_COMMON_HLSLI__
+
+#define QuantizedInstanceRS \
+"RootFlags ( ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |" \
+"            DENY_DOMAIN_SHADER_ROOT_ACCESS |" \
+"            DENY_GEOMETRY_SHADER_ROOT_ACCESS |" \
+"            DENY_HULL_SHADER_ROOT_ACCESS )," \
+"DescriptorTable ( SRV(t0), visibility = SHADER_VISIBILITY_PIXEL )," \
+"DescriptorTable ( SRV(t1), visibility = SHADER_VISIBILITY_PIXEL )," \
+"DescriptorTable ( SRV(t2), visibility = SHADER_VISIBILITY_PIXEL )," \
+"DescriptorTable ( Sampler(s0), visibility = SHADER_VISIBILITY_PIXEL )," \
+"CBV(b0)," \
+"SRV(t3, visibility = SHADER_VISIBILITY_VERTEX)"
+
+cbuffer Parameters : register(b0)
+{
+    float4x4 ViewProj;
+    float4 EyePosition;         // w is the specular power
+    float4 AmbientColor;
+    float4 LightDirection[3];
+    float4 LightDiffuseColor[3];
+    float4 LightSpecularColor[3];
+}
+
+struct VSOutput
+{
+    float3 PositionWS : TEXCOORD0;
+    float3 NormalWS : TEXCOORD1;
+    float2 TexCoord : TEXCOORD2;
+    float4 PositionPS : SV_Position;
+};
+
+#endif
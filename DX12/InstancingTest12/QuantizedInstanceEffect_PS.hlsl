@@ -0,0 +1,65 @@
+//--------------------------------------------------------------------------------------
+// QuantizedInstanceEffect_PS.hlsl
+//
+// A normal mapped effect for DirectX 12 that decodes QuantizedInstance.h instances in the
+// vertex shader.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "QuantizedInstanceEffect_Common.hlsli"
+
+Texture2D<float4> Texture : register(t0);
+Texture2D<float4> NormalTexture : register(t1);
+Texture2D<float4> SpecularTexture : register(t2);
+SamplerState Sampler : register(s0);
+
+// The vertices have no tangents, so the frame comes from the screen-space derivatives of
+// position and texture coordinate.
+float3x3 CotangentFrame(float3 normal, float3 position, float2 texCoord)
+{
+    const float3 dp1 = ddx(position);
+    const float3 dp2 = ddy(position);
+    const float2 duv1 = ddx(texCoord);
+    const float2 duv2 = ddy(texCoord);
+
+    const float3 dp2perp = cross(dp2, normal);
+    const float3 dp1perp = cross(normal, dp1);
+    const float3 tangent = dp2perp * duv1.x + dp1perp * duv2.x;
+    const float3 bitangent = dp2perp * duv1.y + dp1perp * duv2.y;
+
+    const float invmax = rsqrt(max(dot(tangent, tangent), dot(bitangent, bitangent)));
+    return float3x3(tangent * invmax, bitangent * invmax, normal);
+}
+
+[RootSignature(QuantizedInstanceRS)]
+float4 main(VSOutput pin) : SV_TARGET0
+{
+    // Two channel normal map, as NormalMapEffect reads it.
+    float3 localNormal;
+    localNormal.xy = NormalTexture.Sample(Sampler, pin.TexCoord).xy * 2.f - 1.f;
+    localNormal.z = sqrt(saturate(1.f - dot(localNormal.xy, localNormal.xy)));
+
+    const float3 normal = normalize(pin.NormalWS);
+    const float3 N = normalize(mul(localNormal, CotangentFrame(normal, pin.PositionWS, pin.TexCoord)));
+    const float3 eyeVector = normalize(EyePosition.xyz - pin.PositionWS);
+
+    float3 diffuse = AmbientColor.rgb;
+    float3 specular = 0;
+
+    [unroll]
+    for (int i = 0; i < 3; ++i)
+    {
+        const float3 L = -LightDirection[i].xyz;
+        const float dotL = dot(L, N);
+        const float dotH = dot(normalize(eyeVector + L), N);
+        const float zeroL = step(0.f, dotL);
+
+        diffuse += LightDiffuseColor[i].rgb * (zeroL * dotL);
+        specular += LightSpecularColor[i].rgb * (pow(max(dotH, 0.f) * zeroL, EyePosition.w) * dotL);
+    }
+
+    const float4 color = Texture.Sample(Sampler, pin.TexCoord);
+    return float4(color.rgb * diffuse + specular * SpecularTexture.Sample(Sampler, pin.TexCoord).rgb, color.a);
+}
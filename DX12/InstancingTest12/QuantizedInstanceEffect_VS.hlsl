@@ -0,0 +1,42 @@
+//--------------------------------------------------------------------------------------
+// QuantizedInstanceEffect_VS.hlsl
+//
+// A normal mapped effect for DirectX 12 that decodes QuantizedInstance.h instances in the
+// vertex shader.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "QuantizedInstanceEffect_Common.hlsli"
+#include "InstanceDecode_Common.hlsli"
+
+StructuredBuffer<InstanceCluster> Clusters : register(t3);
+
+struct VSInput
+{
+    float4 Position : SV_Position;
+    float3 Normal : NORMAL;
+    float2 TexCoord : TEXCOORD0;
+    uint4 Instance : InstQuantized;
+};
+
+[RootSignature(QuantizedInstanceRS)]
+VSOutput main(VSInput vin)
+{
+    float4 rows[3];
+    DecodeInstance(vin.Instance, Clusters[vin.Instance.w], rows);
+
+    const float4 position = float4(vin.Position.xyz, 1.f);
+    const float3 positionWS = float3(dot(rows[0], position), dot(rows[1], position), dot(rows[2], position));
+
+    // The scale is uniform, so the rotation rows also transform normals.
+    const float3 normalWS = float3(dot(rows[0].xyz, vin.Normal), dot(rows[1].xyz, vin.Normal), dot(rows[2].xyz, vin.Normal));
+
+    VSOutput vout;
+    vout.PositionWS = positionWS;
+    vout.NormalWS = normalize(normalWS);
+    vout.TexCoord = vin.TexCoord;
+    vout.PositionPS = mul(float4(positionWS, 1.f), ViewProj);
+    return vout;
+}
@@ -12,7 +12,19 @@ using namespace DirectX::SimpleMath;
 
 using Microsoft::WRL::ComPtr;
 
-Game::Game() noexcept(false)
+// Comment out to draw every mesh in the frustum, hidden or not.
+#define USE_OCCLUSION_CULLING
+
+namespace
+{
+    // The occlusion buffer is much smaller than the window; it only has to be fine enough
+    // for the panels to hide whole meshes.
+    constexpr size_t c_occlusionWidth = 256;
+    constexpr size_t c_occlusionHeight = 144;
+}
+
+Game::Game() noexcept(false) :
+    m_occlusion(c_occlusionWidth, c_occlusionHeight)
 {
     m_deviceResources = std::make_unique<DX::DeviceResources>();
     m_deviceResources->RegisterDeviceNotify(this);
@@ -67,6 +79,17 @@ void Game::Update(DX::StepTimer const& timer)
 
     m_world = Matrix::CreateRotationZ(cosf(time) * 2.f);
 
+    // Halfway to the eye, facing it: one panel sweeps across the view, the other up and down.
+    const Vector3 eye(2.f, 2.f, 2.f);
+    const Vector3 forward = -eye / eye.Length();
+    Vector3 right = forward.Cross(Vector3::UnitY);
+    right.Normalize();
+    const Vector3 up = right.Cross(forward);
+
+    const float sweep = sinf(time * 0.5f) * 1.2f;
+    m_occluderWorld[0] = Matrix::CreateWorld(eye * 0.5f + right * sweep, forward, up);
+    m_occluderWorld[1] = Matrix::CreateWorld(eye * 0.5f - up * sweep, forward, up);
+
     PIXEndEvent();
 }
 #pragma endregion
@@ -92,18 +115,25 @@ void Game::Render()
     ID3D12DescriptorHeap* heaps[] = { m_modelResources->Heap(), m_states->Heap() };
     commandList->SetDescriptorHeaps(static_cast<UINT>(std::size(heaps)), heaps);
 
+    for (const auto& world : m_occluderWorld)
+    {
+        m_occluderEffect->SetMatrices(world, m_view, m_proj);
+        m_occluderEffect->Apply(commandList);
+        m_occluder->Draw(commandList);
+    }
+
 #if 1
     Model::UpdateEffectMatrices(m_modelNormal, m_world, m_view, m_proj);
 
-    m_model->Draw(commandList, m_modelNormal.cbegin());
+    DrawVisibleMeshes(commandList, m_modelNormal);
 #elif 0
     Model::UpdateEffectMatrices(m_modelWireframe, m_world, m_view, m_proj);
 
-    m_model->Draw(commandList, m_modelWireframe.cbegin());
+    DrawVisibleMeshes(commandList, m_modelWireframe);
 #else
     Model::UpdateEffectMatrices(m_modelFog, m_world, m_view, m_proj);
 
-    m_model->Draw(commandList, m_modelFog.cbegin());
+    DrawVisibleMeshes(commandList, m_modelFog);
 #endif
 
     PIXEndEvent(commandList);
@@ -115,6 +145,38 @@ void Game::Render()
     PIXEndEvent();
 }
 
+// Draws the meshes whose bounds intersect the view frustum and are not hidden behind the
+// occluder panels, as Model::Draw does: opaque parts first, then alpha.
+void Game::DrawVisibleMeshes(ID3D12GraphicsCommandList* commandList, const Model::EffectCollection& effects)
+{
+    const Matrix worldViewProj = m_world * m_view * m_proj;
+    const auto frustum = DX::Frustum::FromViewProjection(&worldViewProj._11);
+    size_t visible = m_meshTree.CullFrustum(frustum, m_visibleMeshes.data());
+
+#ifdef USE_OCCLUSION_CULLING
+    m_occlusion.Clear();
+    for (const auto& world : m_occluderWorld)
+    {
+        const Matrix occluderWorldViewProj = world * m_view * m_proj;
+        m_occlusion.RenderOccluder(&m_occluderVertices[0].position.x, sizeof(VertexPositionNormalTexture), m_occluderVertices.size(),
+            m_occluderIndices.data(), m_occluderIndices.size(), &occluderWorldViewProj._11);
+    }
+    m_occlusion.Flush();
+
+    visible = m_occlusion.CullOccluded(m_meshBoxes.data(), m_visibleMeshes.data(), visible, &worldViewProj._11, m_visibleMeshes.data());
+#endif
+
+    for (size_t j = 0; j < visible; ++j)
+    {
+        m_model->meshes[m_visibleMeshes[j]]->DrawOpaque(commandList, effects.cbegin());
+    }
+
+    for (size_t j = 0; j < visible; ++j)
+    {
+        m_model->meshes[m_visibleMeshes[j]]->DrawAlpha(commandList, effects.cbegin());
+    }
+}
+
 // Helper method to clear the back buffers.
 void Game::Clear()
 {
@@ -212,6 +274,19 @@ void Game::CreateDeviceDependentResources()
 
     m_model = Model::CreateFromSDKMESH(device, L"cup.sdkmesh");
 
+    m_meshBoxes.clear();
+    for (const auto& mesh : m_model->meshes)
+    {
+        m_meshBoxes.push_back(DX::AxisAlignedBox::FromCenterExtents(&mesh->boundingBox.Center.x, &mesh->boundingBox.Extents.x));
+    }
+    m_meshTree.Build(m_meshBoxes.data(), m_meshBoxes.size());
+    m_visibleMeshes.resize(m_meshBoxes.size());
+
+    // The same box is drawn and rasterized as an occluder. Its default winding is front
+    // facing, so the culler can drop its back faces.
+    GeometricPrimitive::CreateBox(m_occluderVertices, m_occluderIndices, XMFLOAT3(0.8f, 0.8f, 0.02f));
+    m_occluder = GeometricPrimitive::CreateCustom(m_occluderVertices, m_occluderIndices, device);
+
     ResourceUploadBatch resourceUpload(device);
 
     resourceUpload.Begin();
@@ -220,6 +295,8 @@ void Game::CreateDeviceDependentResources()
     m_model->LoadStaticBuffers(device, resourceUpload);
 #endif
 
+    m_occluder->LoadStaticBuffers(device, resourceUpload);
+
     m_modelResources = m_model->LoadTextures(device, resourceUpload);
 
     m_fxFactory = std::make_unique<EffectFactory>(m_modelResources->Heap(), m_states->Heap());
@@ -261,6 +338,17 @@ void Game::CreateDeviceDependentResources()
 
     m_modelWireframe = m_model->CreateEffects(*m_fxFactory, pdWire, pdWire);
 
+    EffectPipelineStateDescription pdOccluder(
+        &VertexPositionNormalTexture::InputLayout,
+        CommonStates::Opaque,
+        CommonStates::DepthDefault,
+        CommonStates::CullNone,
+        rtState);
+
+    m_occluderEffect = std::make_unique<BasicEffect>(device, EffectFlags::Lighting, pdOccluder);
+    m_occluderEffect->EnableDefaultLighting();
+    m_occluderEffect->SetDiffuseColor(Colors::DimGray);
+
 #if 0
     m_fxFactory->EnableFogging(true);
     m_fxFactory->EnablePerPixelLighting(true);
@@ -311,6 +399,8 @@ void Game::OnDeviceLost()
     m_modelNormal.clear();
     m_modelWireframe.clear();
     m_modelFog.clear();
+    m_occluder.reset();
+    m_occluderEffect.reset();
     m_states.reset();
     m_graphicsMemory.reset();
 }
@@ -0,0 +1,688 @@
+//--------------------------------------------------------------------------------------
+// File: FrameGraphCheck.cpp
+//
+// Compiles frame graphs with FrameGraph.h on the CPU and checks the plans: the bloom graph
+// of this sample, synthetic graphs for culling, ordering, transient slots, read merging and
+// UAV barriers, and random graphs. Every plan is replayed against a state tracker that fails
+// if a pass uses a resource in the wrong state, a barrier's before state is wrong, or a split
+// barrier is left open. -v prints the plans.
+//
+// This is a standalone console tool with no Windows or Direct3D dependencies:
+//
+//   g++ -std=c++14 -O2 -I../../Common -o FrameGraphCheck FrameGraphCheck.cpp
+//   cl /std:c++14 /O2 /EHsc /I..\..\Common FrameGraphCheck.cpp
+//
+//   FrameGraphCheck [-v] [-random N]
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "FrameGraph.h"
+#include "CheckHarness.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace DX;
+namespace State = DX::ResourceState;
+
+namespace
+{
+    bool g_verbose = false;
+
+    void Check(bool condition, const char* test, const char* what)
+    {
+        if (!condition)
+        {
+            Fail("%s: %s", test, what);
+        }
+    }
+
+    std::string StateName(ResourceStates state)
+    {
+        struct { ResourceStates state; const char* name; } const names[] =
+        {
+            { State::VertexAndConstantBuffer, "VB" },
+            { State::IndexBuffer, "IB" },
+            { State::RenderTarget, "RT" },
+            { State::UnorderedAccess, "UAV" },
+            { State::DepthWrite, "DEPTH_WRITE" },
+            { State::DepthRead, "DEPTH_READ" },
+            { State::NonPixelShaderResource, "NON_PS_SRV" },
+            { State::PixelShaderResource, "PS_SRV" },
+            { State::CopyDest, "COPY_DEST" },
+            { State::CopySource, "COPY_SRC" },
+            { State::ResolveDest, "RESOLVE_DEST" },
+            { State::ResolveSource, "RESOLVE_SRC" },
+        };
+
+        if (state == State::Common)
+            return "COMMON";
+
+        std::string result;
+        for (const auto& entry : names)
+        {
+            if (state & entry.state)
+            {
+                if (!result.empty())
+                    result += '|';
+                result += entry.name;
+            }
+        }
+        return result;
+    }
+
+    // Declares a graph through FrameGraph and remembers each access, so the replay can check
+    // the state of every resource as each pass runs.
+    class Harness
+    {
+    public:
+        struct Use
+        {
+            uint32_t        resource;
+            ResourceStates  state;
+        };
+
+        explicit Harness(FrameGraph& graph) : graph(graph), ran(0)
+        {
+            graph.Reset();
+        }
+
+        FrameGraph::Handle Import(const char* name, ResourceStates state, ResourceStates finalState = State::Unchanged)
+        {
+            const auto handle = graph.Import(name, nullptr, state, finalState);
+            imported.push_back(std::make_pair(graph.GetResourceIndex(handle), state));
+            return handle;
+        }
+
+        uint32_t AddPass(const char* name)
+        {
+            const auto pass = uint32_t(passUses.size());
+            passUses.emplace_back();
+            const uint32_t index = graph.AddPass(name, [this, pass]() { RunPass(pass); });
+            Check(index == pass, name, "pass index");
+            return index;
+        }
+
+        void Read(uint32_t pass, FrameGraph::Handle handle, ResourceStates state = State::PixelShaderResource)
+        {
+            graph.Read(pass, handle, state);
+            passUses[pass].push_back(Use{ graph.GetResourceIndex(handle), state });
+        }
+
+        FrameGraph::Handle Write(uint32_t pass, FrameGraph::Handle handle, ResourceStates state = State::RenderTarget)
+        {
+            const auto result = graph.Write(pass, handle, state);
+            passUses[pass].push_back(Use{ graph.GetResourceIndex(handle), state });
+            return result;
+        }
+
+        // Compiles and replays the plan. Slot states are tracked across frames by the caller.
+        void Run(const char* test, std::vector<ResourceStates>& slotStates)
+        {
+            name = test;
+            graph.Compile();
+
+            const size_t physicalCount = graph.GetResourceCount() + graph.GetSlotCount();
+            states.assign(physicalCount, State::Unchanged);
+            open.assign(physicalCount, false);
+
+            for (const auto& entry : imported)
+            {
+                states[entry.first] = entry.second;
+            }
+
+            slotStates.resize(graph.GetSlotCount(), State::Unchanged);
+            for (uint32_t s = 0; s < graph.GetSlotCount(); ++s)
+            {
+                if (slotStates[s] == State::Unchanged)
+                {
+                    slotStates[s] = graph.GetSlotDesc(s).initialState;
+                }
+                states[graph.GetResourceCount() + s] = slotStates[s];
+            }
+
+            if (g_verbose)
+            {
+                printf("%s:\n", test);
+            }
+
+            ran = 0;
+            graph.Execute(*this);
+
+            Check(ran == graph.GetSchedule().size(), test, "not every scheduled pass ran");
+
+            for (size_t p = 0; p < physicalCount; ++p)
+            {
+                Check(!open[p], test, "split barrier left open at the end of the frame");
+            }
+
+            for (uint32_t r = 0; r < graph.GetResourceCount(); ++r)
+            {
+                if (!graph.IsTransient(r))
+                {
+                    Check(graph.GetFinalState(FindHandle(r)) == states[r], test, "final state mismatch");
+                }
+            }
+
+            for (uint32_t s = 0; s < graph.GetSlotCount(); ++s)
+            {
+                slotStates[s] = states[graph.GetResourceCount() + s];
+            }
+        }
+
+        // FrameGraph::Execute sink.
+        void ResourceBarriers(const FrameGraph::Barrier* barriers, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                const auto& barrier = barriers[i];
+                const uint32_t p = Physical(barrier.resource);
+
+                if (g_verbose)
+                {
+                    const char* split = (barrier.split == FrameGraph::BarrierSplit::Begin) ? " (begin)"
+                        : (barrier.split == FrameGraph::BarrierSplit::End) ? " (end)" : "";
+                    if (barrier.type == FrameGraph::BarrierType::UnorderedAccess)
+                        printf("    UAV barrier %s\n", graph.GetResourceName(barrier.resource));
+                    else
+                        printf("    %s: %s -> %s%s\n", graph.GetResourceName(barrier.resource),
+                            StateName(barrier.before).c_str(), StateName(barrier.after).c_str(), split);
+                }
+
+                if (barrier.type == FrameGraph::BarrierType::UnorderedAccess)
+                {
+                    Check(states[p] == State::UnorderedAccess && !open[p], name, "UAV barrier outside the UAV state");
+                    continue;
+                }
+
+                Check(barrier.before != barrier.after, name, "no-op transition");
+                Check(barrier.before == states[p], name, "transition before state is not the current state");
+
+                switch (barrier.split)
+                {
+                case FrameGraph::BarrierSplit::Begin:
+                    Check(!open[p], name, "split barrier begun twice");
+                    open[p] = true;
+                    break;
+
+                case FrameGraph::BarrierSplit::End:
+                    Check(open[p], name, "split barrier ended without a begin");
+                    open[p] = false;
+                    states[p] = barrier.after;
+                    break;
+
+                default:
+                    Check(!open[p], name, "transition during a split barrier");
+                    states[p] = barrier.after;
+                    break;
+                }
+            }
+        }
+
+        FrameGraph&     graph;
+
+    private:
+        uint32_t Physical(uint32_t resource) const
+        {
+            return graph.IsTransient(resource) ? uint32_t(graph.GetResourceCount()) + graph.GetSlot(resource) : resource;
+        }
+
+        FrameGraph::Handle FindHandle(uint32_t resource) const
+        {
+            // Version handles are allocated in order, and each resource's first version is
+            // created by Import or Create, so the first handle for a resource is found by search.
+            for (FrameGraph::Handle h = 0;; ++h)
+            {
+                if (graph.GetResourceIndex(h) == resource)
+                    return h;
+            }
+        }
+
+        void RunPass(uint32_t pass)
+        {
+            ++ran;
+
+            if (g_verbose)
+            {
+                printf("  %s\n", graph.GetPassName(pass));
+            }
+
+            for (const auto& use : passUses[pass])
+            {
+                const uint32_t p = Physical(use.resource);
+                Check(!open[p], name, "resource used during a split barrier");
+
+                const bool ok = (states[p] == use.state)
+                    || (State::IsReadOnly(use.state) && State::IsReadOnly(states[p]) && (states[p] & use.state) == use.state);
+                if (!ok)
+                {
+                    Fail("%s: pass %s uses %s as %s but it is %s", name, graph.GetPassName(pass),
+                        graph.GetResourceName(use.resource), StateName(use.state).c_str(), StateName(states[p]).c_str());
+                }
+            }
+        }
+
+        const char*                                         name = "";
+        uint32_t                                            ran;
+        std::vector<std::vector<Use>>                       passUses;
+        std::vector<std::pair<uint32_t, ResourceStates>>    imported;
+        std::vector<ResourceStates>                         states;
+        std::vector<bool>                                   open;
+    };
+
+    size_t CountSplits(const FrameGraph& graph)
+    {
+        size_t splits = 0;
+        for (size_t b = 0; b < graph.GetBatchCount(); ++b)
+        {
+            for (size_t i = 0; i < graph.GetBarrierCount(b); ++i)
+            {
+                splits += (graph.GetBarriers(b)[i].split == FrameGraph::BarrierSplit::Begin) ? 1 : 0;
+            }
+        }
+        return splits;
+    }
+
+    size_t CountBatches(const FrameGraph& graph)
+    {
+        size_t batches = 0;
+        for (size_t b = 0; b < graph.GetBatchCount(); ++b)
+        {
+            batches += graph.GetBarrierCount(b) ? 1 : 0;
+        }
+        return batches;
+    }
+
+    // The graph Game::Render builds: scene, extract, blur H, blur V and combine, with the
+    // three render textures and the back buffer imported. Frame two starts from the states
+    // frame one left the textures in.
+    void CheckBloomGraph()
+    {
+        FrameGraph graph;
+        std::vector<ResourceStates> slots;
+        ResourceStates sceneState = State::RenderTarget;
+        ResourceStates blur1State = State::RenderTarget;
+        ResourceStates blur2State = State::RenderTarget;
+
+        for (int frame = 0; frame < 2; ++frame)
+        {
+            Harness h(graph);
+            const auto backBuffer = h.Import("Back buffer", State::Present, State::Present);
+            auto scene = h.Import("Scene", sceneState);
+            auto blur1 = h.Import("Blur 1", blur1State);
+            auto blur2 = h.Import("Blur 2", blur2State);
+
+            const auto scenePass = h.AddPass("Scene");
+            scene = h.Write(scenePass, scene);
+
+            const auto extract = h.AddPass("Bloom extract");
+            h.Read(extract, scene);
+            blur1 = h.Write(extract, blur1);
+
+            const auto blurH = h.AddPass("Blur horizontal");
+            h.Read(blurH, blur1);
+            blur2 = h.Write(blurH, blur2);
+
+            const auto blurV = h.AddPass("Blur vertical");
+            h.Read(blurV, blur2);
+            blur1 = h.Write(blurV, blur1);
+
+            const auto combine = h.AddPass("Bloom combine");
+            h.Read(combine, scene);
+            h.Read(combine, blur1);
+            h.Write(combine, backBuffer);
+
+            h.Run(frame ? "bloom (frame 2)" : "bloom (frame 1)", slots);
+
+            const std::vector<uint32_t> expected = { scenePass, extract, blurH, blurV, combine };
+            Check(graph.GetSchedule() == expected, "bloom", "schedule is not declaration order");
+
+            sceneState = graph.GetFinalState(scene);
+            blur1State = graph.GetFinalState(blur1);
+            blur2State = graph.GetFinalState(blur2);
+
+            Check(graph.GetFinalState(backBuffer) == State::Present, "bloom", "back buffer not returned to PRESENT");
+            Check(sceneState == State::PixelShaderResource, "bloom", "scene final state");
+
+            // The hand-placed version issues 10 transitions in 10 ResourceBarrier calls. The
+            // graph issues the same 10 in 6 batches, with the back buffer, blur 1 and blur 2
+            // transitions split over the passes that don't use them. In the first frame the
+            // textures are still render targets from creation, which saves 3.
+            if (frame)
+            {
+                Check(graph.GetTotalBarrierCount() - CountSplits(graph) == 10, "bloom", "transition count");
+                Check(CountBatches(graph) == 6, "bloom", "batch count");
+                Check(CountSplits(graph) == 3, "bloom", "split barrier count");
+            }
+            else
+            {
+                Check(graph.GetTotalBarrierCount() - CountSplits(graph) == 7, "bloom", "first frame transition count");
+            }
+
+            if (g_verbose)
+            {
+                printf("  %zu transitions (%zu split) in %zu batches\n",
+                    graph.GetTotalBarrierCount() - CountSplits(graph), CountSplits(graph), CountBatches(graph));
+            }
+        }
+    }
+
+    // The bloom None preset copies the scene to the back buffer.
+    void CheckCopyGraph()
+    {
+        FrameGraph graph;
+        std::vector<ResourceStates> slots;
+
+        Harness h(graph);
+        const auto backBuffer = h.Import("Back buffer", State::Present, State::Present);
+        auto scene = h.Import("Scene", State::PixelShaderResource);
+
+        const auto scenePass = h.AddPass("Scene");
+        scene = h.Write(scenePass, scene);
+
+        const auto copy = h.AddPass("Copy");
+        h.Read(copy, scene, State::CopySource);
+        h.Write(copy, backBuffer, State::CopyDest);
+
+        h.Run("copy", slots);
+
+        Check(graph.GetTotalBarrierCount() - CountSplits(graph) == 4, "copy", "transition count");
+        Check(CountSplits(graph) == 1, "copy", "back buffer transition should be split");
+        Check(graph.GetFinalState(scene) == State::CopySource, "copy", "scene final state");
+    }
+
+    // Passes that only feed unread transients are culled, along with their producers.
+    void CheckCulling()
+    {
+        FrameGraph graph;
+        std::vector<ResourceStates> slots;
+
+        Harness h(graph);
+        const auto output = h.Import("Output", State::RenderTarget);
+        const FrameGraph::TransientDesc desc = { 256, 256, 28, State::RenderTarget };
+
+        auto debug = graph.Create("Debug", desc);
+        auto temp = graph.Create("Temp", desc);
+
+        const auto producer = h.AddPass("Debug producer");
+        temp = h.Write(producer, temp);
+
+        const auto unused = h.AddPass("Debug view");
+        h.Read(unused, temp);
+        debug = h.Write(unused, debug);
+
+        const auto main = h.AddPass("Main");
+        const auto rendered = h.Write(main, output);
+
+        const auto readback = h.AddPass("Readback");
+        h.Read(readback, rendered, State::CopySource);
+        graph.SetSideEffect(readback);
+
+        h.Run("culling", slots);
+
+        Check(graph.IsCulled(producer) && graph.IsCulled(unused), "culling", "unused passes not culled");
+        Check(!graph.IsCulled(main) && !graph.IsCulled(readback), "culling", "used pass culled");
+
+        const std::vector<uint32_t> expected = { main, readback };
+        Check(graph.GetSchedule() == expected, "culling", "readback not after main");
+        Check(graph.GetSlot(graph.GetResourceIndex(debug)) == FrameGraph::Invalid, "culling", "culled transient got a slot");
+        Check(graph.GetSlotCount() == 0, "culling", "slot allocated for culled passes");
+    }
+
+    // A pass declared before the pass producing its input runs after it, and a pass that
+    // overwrites a resource runs after the passes reading the previous contents.
+    void CheckOrdering()
+    {
+        FrameGraph graph;
+        std::vector<ResourceStates> slots;
+
+        Harness h(graph);
+        auto a = h.Import("A", State::RenderTarget, State::PixelShaderResource);
+        auto b = h.Import("B", State::RenderTarget);
+
+        const auto consumer = h.AddPass("Consumer");
+        const auto producer = h.AddPass("Producer");
+        const auto overwrite = h.AddPass("Overwrite");
+
+        const auto a1 = h.Write(producer, a);
+        h.Read(consumer, a1);
+        h.Write(consumer, b);
+        h.Write(overwrite, a1);
+
+        h.Run("ordering", slots);
+
+        const std::vector<uint32_t> expected = { producer, consumer, overwrite };
+        Check(graph.GetSchedule() == expected, "ordering", "dependencies not respected");
+
+        FrameGraph cyclic;
+        auto x = cyclic.Import("X", nullptr, State::RenderTarget);
+        auto y = cyclic.Import("Y", nullptr, State::RenderTarget);
+        const auto p0 = cyclic.AddPass("P0");
+        const auto p1 = cyclic.AddPass("P1");
+        const auto x1 = cyclic.Write(p0, x);
+        const auto y1 = cyclic.Write(p1, y);
+        cyclic.Read(p0, y1);
+        cyclic.Read(p1, x1);
+
+        bool threw = false;
+        try
+        {
+            cyclic.Compile();
+        }
+        catch (const std::logic_error&)
+        {
+            threw = true;
+        }
+        Check(threw, "ordering", "cycle not detected");
+
+        FrameGraph conflict;
+        auto z = conflict.Import("Z", nullptr, State::RenderTarget);
+        const auto p = conflict.AddPass("P");
+        threw = false;
+        try
+        {
+            conflict.Read(p, z);
+            conflict.Write(p, z);
+        }
+        catch (const std::logic_error&)
+        {
+            threw = true;
+        }
+        Check(threw, "ordering", "conflicting states in one pass not rejected");
+    }
+
+    // Transients with disjoint lifetimes share a slot, and slot states carry over frames.
+    void CheckTransients()
+    {
+        FrameGraph graph;
+        std::vector<ResourceStates> slots;
+
+        for (int frame = 0; frame < 3; ++frame)
+        {
+            Harness h(graph);
+            const auto output = h.Import("Output", State::Present, State::Present);
+            const FrameGraph::TransientDesc half = { 960, 540, 10, State::RenderTarget };
+            const FrameGraph::TransientDesc quarter = { 480, 270, 10, State::RenderTarget };
+
+            auto t0 = graph.Create("Half 0", half);
+            auto t1 = graph.Create("Half 1", half);
+            auto t2 = graph.Create("Half 2", half);
+            auto q0 = graph.Create("Quarter 0", quarter);
+
+            const auto p0 = h.AddPass("Half 0");
+            t0 = h.Write(p0, t0);
+
+            const auto p1 = h.AddPass("Half 1");
+            h.Read(p1, t0);
+            t1 = h.Write(p1, t1);
+
+            const auto p2 = h.AddPass("Quarter");
+            h.Read(p2, t1);
+            q0 = h.Write(p2, q0);
+
+            const auto p3 = h.AddPass("Half 2");
+            h.Read(p3, q0);
+            t2 = h.Write(p3, t2);
+
+            const auto p4 = h.AddPass("Output");
+            h.Read(p4, t2);
+            h.Write(p4, output);
+
+            h.Run("transients", slots);
+
+            Check(graph.GetSlotCount() == 3, "transients", "expected two half and one quarter slot");
+            Check(graph.GetSlot(graph.GetResourceIndex(t0)) == graph.GetSlot(graph.GetResourceIndex(t2)),
+                "transients", "disjoint lifetimes should share a slot");
+            Check(graph.GetSlot(graph.GetResourceIndex(t0)) != graph.GetSlot(graph.GetResourceIndex(t1)),
+                "transients", "overlapping lifetimes share a slot");
+        }
+    }
+
+    // Consecutive reads in different read states take one combined transition, and
+    // consecutive UAV passes get UAV barriers instead of transitions.
+    void CheckReadsAndUav()
+    {
+        FrameGraph graph;
+        std::vector<ResourceStates> slots;
+
+        Harness h(graph);
+        auto buffer = h.Import("Buffer", State::UnorderedAccess, State::UnorderedAccess);
+        auto output = h.Import("Output", State::RenderTarget);
+
+        const auto c0 = h.AddPass("Compute 0");
+        buffer = h.Write(c0, buffer, State::UnorderedAccess);
+
+        const auto c1 = h.AddPass("Compute 1");
+        h.Read(c1, buffer, State::UnorderedAccess);
+        buffer = h.Write(c1, buffer, State::UnorderedAccess);
+
+        const auto r0 = h.AddPass("Vertex read");
+        h.Read(r0, buffer, State::NonPixelShaderResource);
+        output = h.Write(r0, output);
+
+        const auto r1 = h.AddPass("Pixel read");
+        h.Read(r1, buffer, State::PixelShaderResource);
+        output = h.Write(r1, output);
+
+        h.Run("reads and UAV", slots);
+
+        size_t transitions = 0;
+        size_t uavBarriers = 0;
+        for (size_t b = 0; b < graph.GetBatchCount(); ++b)
+        {
+            for (size_t i = 0; i < graph.GetBarrierCount(b); ++i)
+            {
+                const auto& barrier = graph.GetBarriers(b)[i];
+                if (barrier.type == FrameGraph::BarrierType::UnorderedAccess)
+                    ++uavBarriers;
+                else if (barrier.split != FrameGraph::BarrierSplit::End)
+                    ++transitions;
+            }
+        }
+
+        Check(uavBarriers == 1, "reads and UAV", "expected one UAV barrier");
+        Check(transitions == 2, "reads and UAV", "expected one combined read transition and one back to UAV");
+    }
+
+    // Random graphs over imports and transients, replayed over several frames.
+    void CheckRandom(int count)
+    {
+        std::mt19937 rng(12345);
+        const ResourceStates readStates[] = { State::PixelShaderResource, State::NonPixelShaderResource, State::CopySource };
+        const ResourceStates writeStates[] = { State::RenderTarget, State::UnorderedAccess, State::CopyDest };
+        const char* names[] = { "R0", "R1", "R2", "R3", "R4", "R5", "R6", "R7" };
+
+        FrameGraph graph;
+        std::vector<ResourceStates> slots;
+
+        for (int n = 0; n < count; ++n)
+        {
+            Harness h(graph);
+
+            std::vector<FrameGraph::Handle> latest;
+            const int imports = 1 + int(rng() % 3);
+            for (int i = 0; i < imports; ++i)
+            {
+                const ResourceStates finalState = (rng() % 2) ? State::Present : State::Unchanged;
+                latest.push_back(h.Import(names[i], State::Common, finalState));
+            }
+
+            const int transients = int(rng() % 5);
+            for (int i = 0; i < transients; ++i)
+            {
+                const FrameGraph::TransientDesc desc = { 64u << (rng() % 2), 64, 10, State::RenderTarget };
+                latest.push_back(graph.Create(names[imports + i], desc));
+            }
+
+            const int passes = 2 + int(rng() % 10);
+            for (int p = 0; p < passes; ++p)
+            {
+                const uint32_t pass = h.AddPass("P");
+                std::vector<bool> touched(latest.size(), false);
+
+                const int reads = int(rng() % 3);
+                for (int i = 0; i < reads; ++i)
+                {
+                    const size_t r = rng() % latest.size();
+                    if (!touched[r])
+                    {
+                        touched[r] = true;
+                        h.Read(pass, latest[r], readStates[rng() % 3]);
+                    }
+                }
+
+                const size_t w = rng() % latest.size();
+                if (!touched[w])
+                {
+                    latest[w] = h.Write(pass, latest[w], writeStates[rng() % 3]);
+                }
+
+                if (!(rng() % 8))
+                {
+                    graph.SetSideEffect(pass);
+                }
+            }
+
+            h.Run("random", slots);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int randomCount = 2000;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-v"))
+        {
+            g_verbose = true;
+        }
+        else if (!strcmp(argv[i], "-random") && i + 1 < argc)
+        {
+            randomCount = atoi(argv[++i]);
+        }
+        else
+        {
+            printf("Usage: FrameGraphCheck [-v] [-random N]\n");
+            return 1;
+        }
+    }
+
+    return RunChecks([&]()
+    {
+        CheckBloomGraph();
+        CheckCopyGraph();
+        CheckCulling();
+        CheckOrdering();
+        CheckTransients();
+        CheckReadsAndUav();
+        CheckRandom(randomCount);
+    });
+}
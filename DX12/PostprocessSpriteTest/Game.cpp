@@ -208,26 +208,50 @@ void Game::Render()
     auto commandList = m_deviceResources->GetCommandList();
     PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Render");
 
+    // The passes declare the textures they read and write, and the frame graph places the
+    // resource barriers between them.
+    m_frameGraph.Reset();
+
+    const auto backBuffer = m_frameGraph.Import("Back buffer", m_deviceResources->GetRenderTarget(),
+        D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT);
+
+    static const char* s_targetNames[RTCount] = { "Scene", "Blur 1", "Blur 2" };
+    DX::RenderTexture* targets[RTCount] = { m_offscreenTexture.get(), m_renderTarget1.get(), m_renderTarget2.get() };
+    for (size_t i = 0; i < RTCount; ++i)
+    {
+        m_graphTargets[i] = m_frameGraph.Import(s_targetNames[i], targets[i]->GetResource(), targets[i]->GetCurrentState());
+    }
+
     // TODO: Add your rendering code here.
-    m_offscreenTexture->BeginScene(commandList);
+    const auto scenePass = m_frameGraph.AddPass("Scene", [=]()
+    {
+        m_spriteBatch->Begin(commandList);
+        m_spriteBatch->Draw(
+            m_resourceDescriptors->GetGpuHandle(Descriptors::Background),
+            GetTextureSize(m_background.Get()),
+            m_fullscreenRect);
+        m_spriteBatch->End();
 
-    ID3D12DescriptorHeap* heaps[] = { m_resourceDescriptors->Heap(), m_states->Heap() };
-    commandList->SetDescriptorHeaps(static_cast<UINT>(std::size(heaps)), heaps);
+        m_effect->SetMatrices(m_world, m_view, m_projection);
+        m_effect->Apply(commandList);
+        m_shape->Draw(commandList);
+    });
+    const auto scene = m_frameGraph.Write(scenePass, m_graphTargets[OffscreenRT]);
+
+    PostProcess(commandList, scene, backBuffer);
 
-    m_spriteBatch->Begin(commandList);
-    m_spriteBatch->Draw(
-        m_resourceDescriptors->GetGpuHandle(Descriptors::Background),
-        GetTextureSize(m_background.Get()),
-        m_fullscreenRect);
-    m_spriteBatch->End();
+    m_frameGraph.Compile();
 
-    m_effect->SetMatrices(m_world, m_view, m_projection);
-    m_effect->Apply(commandList);
-    m_shape->Draw(commandList);
+    ID3D12DescriptorHeap* heaps[] = { m_resourceDescriptors->Heap(), m_states->Heap() };
+    commandList->SetDescriptorHeaps(static_cast<UINT>(std::size(heaps)), heaps);
 
-    m_offscreenTexture->EndScene(commandList);
+    DX::FrameGraphCommandList graphCommandList(commandList, m_frameGraph);
+    m_frameGraph.Execute(graphCommandList);
 
-    PostProcess(commandList);
+    for (size_t i = 0; i < RTCount; ++i)
+    {
+        targets[i]->UpdateState(static_cast<D3D12_RESOURCE_STATES>(m_frameGraph.GetFinalState(m_graphTargets[i])));
+    }
 
     PIXEndEvent(commandList);
 
@@ -265,25 +289,18 @@ void Game::Clear()
     PIXEndEvent(commandList);
 }
 
-void Game::PostProcess(_In_ ID3D12GraphicsCommandList* commandList)
+void Game::PostProcess(_In_ ID3D12GraphicsCommandList* commandList,
+    DX::FrameGraph::Handle scene, DX::FrameGraph::Handle backBuffer)
 {
     if (g_Bloom == None)
     {
-        auto renderTarget = m_deviceResources->GetRenderTarget();
-        auto offscreenTarget = m_offscreenTexture->GetResource();
-
-        ScopedBarrier barriers(commandList,
-            {
-                CD3DX12_RESOURCE_BARRIER::Transition(renderTarget,
-                    D3D12_RESOURCE_STATE_PRESENT,
-                    D3D12_RESOURCE_STATE_COPY_DEST, 0),
-                CD3DX12_RESOURCE_BARRIER::Transition(offscreenTarget,
-                    D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-                    D3D12_RESOURCE_STATE_COPY_SOURCE, 0)
-            });
-
         // Pass-through test
-        commandList->CopyResource(renderTarget, offscreenTarget);
+        const auto copyPass = m_frameGraph.AddPass("Copy", [=]()
+        {
+            commandList->CopyResource(m_deviceResources->GetRenderTarget(), m_offscreenTexture->GetResource());
+        });
+        m_frameGraph.Read(copyPass, scene, D3D12_RESOURCE_STATE_COPY_SOURCE);
+        m_frameGraph.Write(copyPass, backBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
     }
     else
     {
@@ -296,145 +313,88 @@ void Game::PostProcess(_In_ ID3D12GraphicsCommandList* commandList)
         };
 
         // scene -> RT1 (downsample)
-        m_renderTarget1->BeginScene(commandList);
-
-        auto rtvDescriptor = m_renderDescriptors->GetCpuHandle(Blur1RT);
-        commandList->OMSetRenderTargets(1, &rtvDescriptor, FALSE, nullptr);
-
-        auto vp = m_deviceResources->GetScreenViewport();
-
-        Viewport halfvp(vp);
-        halfvp.height /= 2.;
-        halfvp.width /= 2.;
-        commandList->RSSetViewports(1, halfvp.Get12());
-
-        m_bloomExtract->Begin(commandList, SpriteSortMode_Immediate);
-        commandList->SetGraphicsRootConstantBufferView(RootParameterIndex::MyConstantBuffer,
-            m_bloomParams.GpuAddress());
-        auto sceneTex = m_resourceDescriptors->GetGpuHandle(SceneTex);
-        m_bloomExtract->Draw(sceneTex,
-            GetTextureSize(m_offscreenTexture->GetResource()),
-            m_bloomRect);
-        m_bloomExtract->End();
-
-        m_renderTarget1->EndScene(commandList);
-
-#if 0
-        // RT1 (1st) screenshot
-        TransitionResource(commandList, m_deviceResources->GetRenderTarget(),
-            D3D12_RESOURCE_STATE_PRESENT,
-            D3D12_RESOURCE_STATE_RENDER_TARGET);
-
-        rtvDescriptor = m_deviceResources->GetRenderTargetView();
-        commandList->OMSetRenderTargets(1, &rtvDescriptor, FALSE, nullptr);
-
-        commandList->RSSetViewports(1, &vp);
-
-        m_spriteBatch->Begin(commandList);
-        m_spriteBatch->Draw(m_resourceDescriptors->GetGpuHandle(BlurTex1), GetTextureSize(m_renderTarget1->GetResource()), m_bloomRect);
-        m_spriteBatch->End();
+        const auto extractPass = m_frameGraph.AddPass("Bloom extract", [=]()
+        {
+            auto rtvDescriptor = m_renderDescriptors->GetCpuHandle(Blur1RT);
+            commandList->OMSetRenderTargets(1, &rtvDescriptor, FALSE, nullptr);
+
+            auto vp = m_deviceResources->GetScreenViewport();
+
+            Viewport halfvp(vp);
+            halfvp.height /= 2.;
+            halfvp.width /= 2.;
+            commandList->RSSetViewports(1, halfvp.Get12());
+
+            m_bloomExtract->Begin(commandList, SpriteSortMode_Immediate);
+            commandList->SetGraphicsRootConstantBufferView(RootParameterIndex::MyConstantBuffer,
+                m_bloomParams.GpuAddress());
+            auto sceneTex = m_resourceDescriptors->GetGpuHandle(SceneTex);
+            m_bloomExtract->Draw(sceneTex,
+                GetTextureSize(m_offscreenTexture->GetResource()),
+                m_bloomRect);
+            m_bloomExtract->End();
+        });
+        m_frameGraph.Read(extractPass, scene);
+        auto blur1 = m_frameGraph.Write(extractPass, m_graphTargets[Blur1RT]);
 
-        TransitionResource(commandList, m_deviceResources->GetRenderTarget(),
-            D3D12_RESOURCE_STATE_RENDER_TARGET,
-            D3D12_RESOURCE_STATE_PRESENT);
-#else
         // RT1 -> RT2 (blur horizontal)
-        m_renderTarget2->BeginScene(commandList);
-
-        rtvDescriptor = m_renderDescriptors->GetCpuHandle(Blur2RT);
-        commandList->OMSetRenderTargets(1, &rtvDescriptor, FALSE, nullptr);
-
-        m_gaussianBlur->Begin(commandList, SpriteSortMode_Immediate);
-        commandList->SetGraphicsRootConstantBufferView(RootParameterIndex::MyConstantBuffer,
-            m_blurParamsWidth.GpuAddress());
-        auto blur1Tex = m_resourceDescriptors->GetGpuHandle(BlurTex1);
-        m_gaussianBlur->Draw(blur1Tex,
-            GetTextureSize(m_renderTarget1->GetResource()),
-            m_bloomRect);
-        m_gaussianBlur->End();
-
-        m_renderTarget2->EndScene(commandList);
-
-#if 0
-        // RT2 (1st) screenshot
-        TransitionResource(commandList, m_deviceResources->GetRenderTarget(),
-            D3D12_RESOURCE_STATE_PRESENT,
-            D3D12_RESOURCE_STATE_RENDER_TARGET);
-
-        rtvDescriptor = m_deviceResources->GetRenderTargetView();
-        commandList->OMSetRenderTargets(1, &rtvDescriptor, FALSE, nullptr);
-
-        commandList->RSSetViewports(1, &vp);
-
-        m_spriteBatch->Begin(commandList);
-        m_spriteBatch->Draw(m_resourceDescriptors->GetGpuHandle(BlurTex2), GetTextureSize(m_renderTarget2->GetResource()), m_bloomRect);
-        m_spriteBatch->End();
+        const auto blurHorizontalPass = m_frameGraph.AddPass("Blur horizontal", [=]()
+        {
+            auto rtvDescriptor = m_renderDescriptors->GetCpuHandle(Blur2RT);
+            commandList->OMSetRenderTargets(1, &rtvDescriptor, FALSE, nullptr);
+
+            m_gaussianBlur->Begin(commandList, SpriteSortMode_Immediate);
+            commandList->SetGraphicsRootConstantBufferView(RootParameterIndex::MyConstantBuffer,
+                m_blurParamsWidth.GpuAddress());
+            auto blur1Tex = m_resourceDescriptors->GetGpuHandle(BlurTex1);
+            m_gaussianBlur->Draw(blur1Tex,
+                GetTextureSize(m_renderTarget1->GetResource()),
+                m_bloomRect);
+            m_gaussianBlur->End();
+        });
+        m_frameGraph.Read(blurHorizontalPass, blur1);
+        const auto blur2 = m_frameGraph.Write(blurHorizontalPass, m_graphTargets[Blur2RT]);
 
-        TransitionResource(commandList, m_deviceResources->GetRenderTarget(),
-            D3D12_RESOURCE_STATE_RENDER_TARGET,
-            D3D12_RESOURCE_STATE_PRESENT);
-#else
         // RT2 -> RT1 (blur vertical)
-        m_renderTarget1->BeginScene(commandList);
-
-        rtvDescriptor = m_renderDescriptors->GetCpuHandle(Blur1RT);
-        commandList->OMSetRenderTargets(1, &rtvDescriptor, FALSE, nullptr);
-
-        m_gaussianBlur->Begin(commandList, SpriteSortMode_Immediate);
-        commandList->SetGraphicsRootConstantBufferView(RootParameterIndex::MyConstantBuffer,
-            m_blurParamsHeight.GpuAddress());
-        auto blur2Tex = m_resourceDescriptors->GetGpuHandle(BlurTex2);
-        m_gaussianBlur->Draw(blur2Tex,
-            GetTextureSize(m_renderTarget2->GetResource()),
-            m_bloomRect);
-        m_gaussianBlur->End();
-
-        m_renderTarget1->EndScene(commandList);
-
-#if 0
-        // RT1 (2nd) screenshot
-        TransitionResource(commandList, m_deviceResources->GetRenderTarget(),
-            D3D12_RESOURCE_STATE_PRESENT,
-            D3D12_RESOURCE_STATE_RENDER_TARGET);
-
-        rtvDescriptor = m_deviceResources->GetRenderTargetView();
-        commandList->OMSetRenderTargets(1, &rtvDescriptor, FALSE, nullptr);
-
-        commandList->RSSetViewports(1, &vp);
-
-        m_spriteBatch->Begin(commandList);
-        m_spriteBatch->Draw(m_resourceDescriptors->GetGpuHandle(BlurTex2), GetTextureSize(m_renderTarget2->GetResource()), m_bloomRect);
-        m_spriteBatch->End();
+        const auto blurVerticalPass = m_frameGraph.AddPass("Blur vertical", [=]()
+        {
+            auto rtvDescriptor = m_renderDescriptors->GetCpuHandle(Blur1RT);
+            commandList->OMSetRenderTargets(1, &rtvDescriptor, FALSE, nullptr);
+
+            m_gaussianBlur->Begin(commandList, SpriteSortMode_Immediate);
+            commandList->SetGraphicsRootConstantBufferView(RootParameterIndex::MyConstantBuffer,
+                m_blurParamsHeight.GpuAddress());
+            auto blur2Tex = m_resourceDescriptors->GetGpuHandle(BlurTex2);
+            m_gaussianBlur->Draw(blur2Tex,
+                GetTextureSize(m_renderTarget2->GetResource()),
+                m_bloomRect);
+            m_gaussianBlur->End();
+        });
+        m_frameGraph.Read(blurVerticalPass, blur2);
+        blur1 = m_frameGraph.Write(blurVerticalPass, blur1);
 
-        TransitionResource(commandList, m_deviceResources->GetRenderTarget(),
-            D3D12_RESOURCE_STATE_RENDER_TARGET,
-            D3D12_RESOURCE_STATE_PRESENT);
-#else
         // RT1 + scene
-        TransitionResource(commandList, m_deviceResources->GetRenderTarget(),
-            D3D12_RESOURCE_STATE_PRESENT,
-            D3D12_RESOURCE_STATE_RENDER_TARGET);
-
-        rtvDescriptor = m_deviceResources->GetRenderTargetView();
-        commandList->OMSetRenderTargets(1, &rtvDescriptor, FALSE, nullptr);
-
-        commandList->RSSetViewports(1, &vp);
-
-        m_bloomCombine->Begin(commandList, SpriteSortMode_Immediate);
-        commandList->SetGraphicsRootConstantBufferView(RootParameterIndex::MyConstantBuffer,
-            m_bloomParams.GpuAddress());
-        commandList->SetGraphicsRootDescriptorTable(RootParameterIndex::Texture2SRV, blur1Tex);
-        m_bloomCombine->Draw(sceneTex,
-            GetTextureSize(m_offscreenTexture->GetResource()),
-            m_fullscreenRect);
-        m_bloomCombine->End();
-
-        TransitionResource(commandList, m_deviceResources->GetRenderTarget(),
-            D3D12_RESOURCE_STATE_RENDER_TARGET,
-            D3D12_RESOURCE_STATE_PRESENT);
-#endif
-#endif
-#endif
+        const auto combinePass = m_frameGraph.AddPass("Bloom combine", [=]()
+        {
+            auto rtvDescriptor = m_deviceResources->GetRenderTargetView();
+            commandList->OMSetRenderTargets(1, &rtvDescriptor, FALSE, nullptr);
+
+            auto vp = m_deviceResources->GetScreenViewport();
+            commandList->RSSetViewports(1, &vp);
+
+            m_bloomCombine->Begin(commandList, SpriteSortMode_Immediate);
+            commandList->SetGraphicsRootConstantBufferView(RootParameterIndex::MyConstantBuffer,
+                m_bloomParams.GpuAddress());
+            commandList->SetGraphicsRootDescriptorTable(RootParameterIndex::Texture2SRV,
+                m_resourceDescriptors->GetGpuHandle(BlurTex1));
+            m_bloomCombine->Draw(m_resourceDescriptors->GetGpuHandle(SceneTex),
+                GetTextureSize(m_offscreenTexture->GetResource()),
+                m_fullscreenRect);
+            m_bloomCombine->End();
+        });
+        m_frameGraph.Read(combinePass, scene);
+        m_frameGraph.Read(combinePass, blur1);
+        m_frameGraph.Write(combinePass, backBuffer);
     }
 }
 #pragma endregion
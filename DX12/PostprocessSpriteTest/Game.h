@@ -5,6 +5,7 @@
 #pragma once
 
 #include "DeviceResources.h"
+#include "FrameGraph.h"
 #include "StepTimer.h"
 #include "RenderTexture.h"
 
@@ -51,7 +52,8 @@ private:
     void Render();
 
     void Clear();
-    void PostProcess(_In_ ID3D12GraphicsCommandList* commandList);
+    void PostProcess(_In_ ID3D12GraphicsCommandList* commandList,
+        DX::FrameGraph::Handle scene, DX::FrameGraph::Handle backBuffer);
 
     void CreateDeviceDependentResources();
     void CreateWindowSizeDependentResources();
@@ -114,6 +116,9 @@ private:
         RTCount
     };
 
+    DX::FrameGraph m_frameGraph;
+    DX::FrameGraph::Handle m_graphTargets[RTCount];
+
     RECT m_bloomRect;
 #endif
 };